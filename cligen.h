@@ -56,6 +56,8 @@ extern "C" {
 #endif
     
 #include <cligen/cligen_buf.h>
+#include <cligen/cligen_arena.h>
+#include <cligen/cligen_intern.h>
 #include <cligen/cligen_cv.h>
 #include <cligen/cligen_cvec.h>
 #include <cligen/cligen_parsetree.h>
@@ -65,8 +67,13 @@ extern "C" {
 #include <cligen/cligen_print.h>
 #include <cligen/cligen_read.h>
 #include <cligen/cligen_io.h>
+#include <cligen/cligen_event.h>
+#include <cligen/cligen_session.h>
 #include <cligen/cligen_expand.h>
 #include <cligen/cligen_syntax.h>
+#include <cligen/cligen_image.h>
+#include <cligen/cligen_stats.h>
+#include <cligen/cligen_trace.h>
 #include <cligen/cligen_util.h>
 #include <cligen/cligen_regex.h>
 #include <cligen/cligen_history.h>
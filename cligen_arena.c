@@ -0,0 +1,226 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+ * CLIgen arena (region) allocator for transient evaluation state
+ * @see cligen_arena.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cligen_arena.h"              /* External API */
+
+/*
+ * Constants
+ */
+/* Default size of an arena block if 0 is given to cligen_arena_new */
+#define CLIGEN_ARENA_BLOCKSIZE 8192
+
+/* Alignment of allocations */
+#define CLIGEN_ARENA_ALIGN     16
+
+/*
+ * Types
+ */
+/*! One block of arena memory. Blocks are linked in allocation order */
+struct arena_block{
+    struct arena_block *ab_next;
+    size_t              ab_size;  /* Size of ab_data */
+    size_t              ab_used;  /* Bytes used of ab_data */
+    char               *ab_data;
+};
+
+struct cligen_arena{
+    struct arena_block *ca_head;  /* First block */
+    struct arena_block *ca_cur;   /* Current block, blocks after this are unused */
+    size_t              ca_blocksize;
+};
+
+/*! Create a new arena
+ * @param[in]  blocksize  Size of each block, 0 means default
+ * @retval     ca         Arena, free with cligen_arena_free
+ * @retval     NULL       Error
+ */
+cligen_arena *
+cligen_arena_new(size_t blocksize)
+{
+    cligen_arena *ca;
+
+    if ((ca = malloc(sizeof(*ca))) == NULL)
+	return NULL;
+    memset(ca, 0, sizeof(*ca));
+    ca->ca_blocksize = blocksize ? blocksize : CLIGEN_ARENA_BLOCKSIZE;
+    return ca;
+}
+
+/*! Free an arena and all memory allocated from it
+ * @param[in]  ca   Arena
+ */
+void
+cligen_arena_free(cligen_arena *ca)
+{
+    struct arena_block *ab;
+
+    if (ca == NULL)
+	return;
+    while ((ab = ca->ca_head) != NULL){
+	ca->ca_head = ab->ab_next;
+	free(ab);
+    }
+    free(ca);
+}
+
+/*! Return the memory allocated by an arena, including unused blocks
+ * @param[in]  ca   Arena
+ * @retval     sz   Bytes allocated
+ */
+size_t
+cligen_arena_size(cligen_arena *ca)
+{
+    struct arena_block *ab;
+    size_t              sz;
+
+    if (ca == NULL)
+	return 0;
+    sz = sizeof(*ca);
+    for (ab = ca->ca_head; ab; ab = ab->ab_next)
+	sz += (size_t)(ab->ab_data - (char*)ab) + ab->ab_size;
+    return sz;
+}
+
+/*! Allocate a new block of at least size bytes and link it after the current block
+ * @param[in]  ca   Arena
+ * @param[in]  size Minimum size of block
+ */
+static struct arena_block *
+arena_block_new(cligen_arena *ca,
+		size_t        size)
+{
+    struct arena_block *ab;
+    size_t              hdr;
+
+    if (size < ca->ca_blocksize)
+	size = ca->ca_blocksize;
+    hdr = (sizeof(*ab) + CLIGEN_ARENA_ALIGN - 1) & ~(size_t)(CLIGEN_ARENA_ALIGN - 1);
+    if ((ab = malloc(hdr + size)) == NULL)
+	return NULL;
+    ab->ab_size = size;
+    ab->ab_used = 0;
+    ab->ab_data = (char*)ab + hdr;
+    if (ca->ca_cur == NULL){
+	ab->ab_next = ca->ca_head;
+	ca->ca_head = ab;
+    }
+    else{
+	ab->ab_next = ca->ca_cur->ab_next;
+	ca->ca_cur->ab_next = ab;
+    }
+    return ab;
+}
+
+/*! Allocate zeroed memory from an arena
+ * The memory is valid until it is released by cligen_arena_release, cligen_arena_reset
+ * or cligen_arena_free. Do not call free() on it.
+ * @param[in]  ca   Arena
+ * @param[in]  size Number of bytes
+ * @retval     p    Allocated memory, aligned
+ * @retval     NULL Error
+ */
+void *
+cligen_arena_alloc(cligen_arena *ca,
+		   size_t        size)
+{
+    struct arena_block *ab;
+    void               *p;
+
+    if (ca == NULL){
+	errno = EINVAL;
+	return NULL;
+    }
+    size = (size + CLIGEN_ARENA_ALIGN - 1) & ~(size_t)(CLIGEN_ARENA_ALIGN - 1);
+    ab = ca->ca_cur;
+    if (ab == NULL || ab->ab_used + size > ab->ab_size){
+	/* Re-use next block if large enough, otherwise insert a new */
+	if (ab == NULL)
+	    ab = ca->ca_head;
+	else
+	    ab = ab->ab_next;
+	if (ab == NULL || ab->ab_size < size){
+	    if ((ab = arena_block_new(ca, size)) == NULL)
+		return NULL;
+	}
+	ab->ab_used = 0;
+	ca->ca_cur = ab;
+    }
+    p = ab->ab_data + ab->ab_used;
+    ab->ab_used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+/*! Get current position of an arena
+ * @param[in]  ca   Arena
+ * @param[out] mark Position, use in cligen_arena_release
+ */
+void
+cligen_arena_mark_get(cligen_arena      *ca,
+		      cligen_arena_mark *mark)
+{
+    mark->am_block = ca->ca_cur;
+    mark->am_used = ca->ca_cur ? ca->ca_cur->ab_used : 0;
+}
+
+/*! Release all memory allocated after a mark
+ * Marks can be nested, but must be released in reverse order
+ * @param[in]  ca   Arena
+ * @param[in]  mark Position from cligen_arena_mark_get
+ */
+void
+cligen_arena_release(cligen_arena      *ca,
+		     cligen_arena_mark *mark)
+{
+    ca->ca_cur = mark->am_block;
+    if (ca->ca_cur)
+	ca->ca_cur->ab_used = mark->am_used;
+}
+
+/*! Release all memory allocated from an arena, but keep its blocks for re-use
+ * @param[in]  ca   Arena
+ */
+void
+cligen_arena_reset(cligen_arena *ca)
+{
+    ca->ca_cur = NULL;
+}
@@ -0,0 +1,78 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+ *
+ * CLIgen arena (region) allocator for transient evaluation state
+ * Memory is allocated by bumping a pointer in large blocks and is not freed
+ * individually. Instead, all memory allocated after a mark is released at once.
+ * Blocks are kept for re-use until the arena is freed.
+ * @code
+ *   cligen_arena     *ca;
+ *   cligen_arena_mark mark;
+ *   if ((ca = cligen_arena_new(0)) == NULL)
+ *      err();
+ *   cligen_arena_mark_get(ca, &mark);
+ *   p = cligen_arena_alloc(ca, 42);
+ *   ...
+ *   cligen_arena_release(ca, &mark); // p is released
+ *   cligen_arena_free(ca);
+ * @endcode
+ */
+
+#ifndef _CLIGEN_ARENA_H
+#define _CLIGEN_ARENA_H
+
+/*
+ * Types
+ */
+typedef struct cligen_arena cligen_arena; /* fully defined in c-file */
+
+/*! Position in an arena, all memory allocated after it can be released
+ * @see cligen_arena_mark_get
+ */
+typedef struct {
+    void   *am_block;  /* Current block, or NULL if none */
+    size_t  am_used;   /* Bytes used in current block */
+} cligen_arena_mark;
+
+/*
+ * Prototypes
+ */
+cligen_arena *cligen_arena_new(size_t blocksize);
+void          cligen_arena_free(cligen_arena *ca);
+void         *cligen_arena_alloc(cligen_arena *ca, size_t size);
+void          cligen_arena_mark_get(cligen_arena *ca, cligen_arena_mark *mark);
+void          cligen_arena_release(cligen_arena *ca, cligen_arena_mark *mark);
+void          cligen_arena_reset(cligen_arena *ca);
+size_t        cligen_arena_size(cligen_arena *ca);
+
+#endif /* _CLIGEN_ARENA_H */
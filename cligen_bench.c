@@ -0,0 +1,803 @@
+/*
+  CLIgen micro-benchmarks of parse, match, completion, expansion and validation
+
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+ */
+/*
+ * Synthetic parse-trees are generated from a clispec built in memory:
+ *   bench tree: <depth> levels, each with <width> keywords k<i> and <vars> variables
+ *               (an int32 with range, the others strings with regexps)
+ *   ref<r> { @sub<r> } for <refs> referenced sub-trees,  each <width> wide
+ *   exp <e:string exp()> where the expand callback returns <expand> values
+ * Each benchmark is run on a set of pseudo-random commands and its result is
+ * written as one JSON object per line, eg:
+ *   {"bench":"cliread_parse","width":10,...,"iterations":10000,"total_ns":..,"ns_per_op":..}
+ * With -C <dir>, slow inputs of the performance-regression corpus found by cligen_latfuzz
+ * are replayed: each <dir>/<name>.in is evaluated line by line with cliread_parse in
+ * the clispec <dir>/<name>.cli, eg:
+ *   {"bench":"corpus","file":"latency.in","line":2,"len":33,"iterations":100,..,"match_object":97}
+ * Run with "make bench", parameters can be given with BENCHFLAGS
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include <netinet/in.h>
+
+#include <cligen/cligen.h>
+#include <cligen/cligen_match.h> /* internal, benchmark is built in the source tree */
+
+/* Number of generated commands */
+#define BENCH_NCMD 64
+
+/* Max length of a generated command */
+#define BENCH_CMDLEN 1024
+
+/*! Benchmark parameters */
+struct bench{
+    int   b_width;   /* Keywords per level */
+    int   b_depth;   /* Levels of bench tree */
+    int   b_vars;    /* Variables per level */
+    int   b_refs;    /* Number of tree references (fan-out) */
+    int   b_expand;  /* Number of values returned by expand callback */
+    int   b_iter;    /* Iterations of per-command benchmarks */
+    int   b_piter;   /* Iterations of spec parsing */
+    int   b_citer;   /* Iterations of each corpus input */
+    FILE *b_out;     /* Results */
+};
+
+static uint64_t
+bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+/*! Print result of one benchmark as a JSON object on one line */
+static void
+bench_report(struct bench *b,
+	     char         *name,
+	     int           n,
+	     uint64_t      ns)
+{
+    fprintf(b->b_out, "{\"bench\":\"%s\",\"width\":%d,\"depth\":%d,\"vars\":%d,"
+	    "\"refs\":%d,\"expand\":%d,\"iterations\":%d,"
+	    "\"total_ns\":%llu,\"ns_per_op\":%.1f}\n",
+	    name, b->b_width, b->b_depth, b->b_vars, b->b_refs, b->b_expand,
+	    n, (unsigned long long)ns, n?(double)ns/n:0.0);
+    fflush(b->b_out);
+}
+
+/*! Expand callback returning b_expand values e0, e1,...
+ * @param[in]  h   Userhandle, ie the bench struct
+ */
+static int
+bench_expand_cb(cligen_handle h, 
+		char         *fn_str, 
+		cvec         *cvv, 
+		cvec         *argv, 
+		cvec         *commands,
+		cvec         *helptexts)
+{
+    struct bench *b = (struct bench *)h;
+    char          name[16];
+    int           i;
+
+    for (i=0; i<b->b_expand; i++){
+	snprintf(name, sizeof(name), "e%d", i);
+	cvec_add_string(commands, NULL, name);
+	cvec_add_string(helptexts, NULL, "Expanded value");
+    }
+    return 0;
+}
+
+static expandv_cb *
+str2fn_exp(char  *name,
+	   void  *arg,
+	   char **error)
+{
+    return bench_expand_cb;
+}
+
+/*! Generate one level of the bench tree */
+static int
+bench_spec_level(cbuf         *cb,
+		 struct bench *b,
+		 int           level)
+{
+    int i;
+
+    for (i=0; i<b->b_width + b->b_vars; i++){
+	cprintf(cb, "%*s", 2*(level+1), "");
+	if (i < b->b_width)
+	    cprintf(cb, "k%d", i);
+	else if (i == b->b_width)
+	    cprintf(cb, "<n%d:int32 range[0:1000000]>", level);
+	else
+	    cprintf(cb, "<s%d:string regexp:\"x%d_[0-9]+\">", i - b->b_width, i - b->b_width);
+	if (level+1 < b->b_depth){
+	    cprintf(cb, "{\n");
+	    bench_spec_level(cb, b, level+1);
+	    cprintf(cb, "%*s}\n", 2*(level+1), "");
+	}
+	else
+	    cprintf(cb, ", cb();\n");
+    }
+    return 0;
+}
+
+/*! Generate the clispec of the benchmark */
+static cbuf *
+bench_spec(struct bench *b)
+{
+    cbuf *cb;
+    int   r;
+    int   i;
+
+    if ((cb = cbuf_new()) == NULL)
+	return NULL;
+    cprintf(cb, "treename=\"bench\";\n");
+    bench_spec_level(cb, b, 0);
+    for (r=0; r<b->b_refs; r++)
+	cprintf(cb, "  ref%d {\n    @sub%d, cb();\n  }\n", r, r);
+    if (b->b_expand)
+	cprintf(cb, "  exp <e:string exp()>, cb();\n");
+    for (r=0; r<b->b_refs; r++){
+	cprintf(cb, "treename=\"sub%d\";\n", r);
+	for (i=0; i<b->b_width; i++)
+	    cprintf(cb, "  s%d <v:int32>, cb();\n", i);
+    }
+    return cb;
+}
+
+/*! Generate pseudo-random valid commands of the bench tree */
+static int
+bench_commands(struct bench *b,
+	       char          cmds[BENCH_NCMD][BENCH_CMDLEN])
+{
+    unsigned int seed = 42;
+    int          c;
+    int          i;
+    int          level;
+    int          j;
+    char        *s;
+    size_t       len;
+
+    for (c=0; c<BENCH_NCMD; c++){
+	s = cmds[c];
+	len = BENCH_CMDLEN;
+	i = rand_r(&seed) % 8;
+	if (b->b_refs && i == 0)
+	    snprintf(s, len, "ref%d s%d %d", rand_r(&seed) % b->b_refs,
+		     rand_r(&seed) % b->b_width, rand_r(&seed) % 1000);
+	else if (b->b_expand && i == 1)
+	    snprintf(s, len, "exp e%d", rand_r(&seed) % b->b_expand);
+	else{
+	    *s = '\0';
+	    for (level=0; level<b->b_depth; level++){
+		j = rand_r(&seed) % (b->b_width + b->b_vars);
+		if (j < b->b_width)
+		    snprintf(s, len, "k%d ", j);
+		else if (j == b->b_width)
+		    snprintf(s, len, "%d ", rand_r(&seed) % 1000000);
+		else
+		    snprintf(s, len, "x%d_%d ", j - b->b_width, rand_r(&seed) % 1000);
+		len -= strlen(s);
+		s += strlen(s);
+	    }
+	    *(s-1) = '\0'; /* Strip last space */
+	}
+    }
+    return 0;
+}
+
+/*! Benchmark parsing of the clispec into parse-trees
+ * The clispec contains several trees which are added to the handle, therefore use
+ * a new handle in each iteration. Only the parsing is timed.
+ */
+static int
+bench_parse_str(struct bench *b,
+		char         *spec)
+{
+    int           retval = -1;
+    cligen_handle h = NULL;
+    uint64_t      t0;
+    uint64_t      ns = 0;
+    int           i;
+
+    for (i=0; i<b->b_piter; i++){
+	if ((h = cligen_init()) == NULL)
+	    goto done;
+	t0 = bench_now();
+	if (cligen_parse_str(h, spec, "bench", NULL, NULL) < 0)
+	    goto done;
+	ns += bench_now() - t0;
+	cligen_exit(h);
+	h = NULL;
+    }
+    bench_report(b, "cligen_parse_str", b->b_piter, ns);
+    retval = 0;
+ done:
+    if (h)
+	cligen_exit(h);
+    return retval;
+}
+
+/*! Benchmark matching of complete commands */
+static int
+bench_cliread_parse(cligen_handle h,
+		    struct bench *b,
+		    parse_tree   *pt,
+		    char          cmds[BENCH_NCMD][BENCH_CMDLEN])
+{
+    int           retval = -1;
+    cvec         *cvv = NULL;
+    cg_obj       *co;
+    cligen_result result;
+    char         *reason = NULL;
+    uint64_t      t0;
+    int           i;
+    int           nerr = 0;
+
+    if ((cvv = cvec_new(0)) == NULL)
+	goto done;
+    t0 = bench_now();
+    for (i=0; i<b->b_iter; i++){
+	if (cliread_parse(h, cmds[i%BENCH_NCMD], pt, &co, cvv, &result, &reason) < 0)
+	    goto done;
+	if (result != CG_MATCH)
+	    nerr++;
+	if (reason){
+	    free(reason);
+	    reason = NULL;
+	}
+	cvec_reset(cvv);
+    }
+    bench_report(b, "cliread_parse", b->b_iter, bench_now() - t0);
+    if (nerr)
+	fprintf(stderr, "cliread_parse: %d commands did not match\n", nerr);
+    retval = 0;
+ done:
+    if (cvv)
+	cvec_free(cvv);
+    return retval;
+}
+
+/*! Benchmark completion of the last token of commands, as TAB does */
+static int
+bench_match_complete(cligen_handle h,
+		     struct bench *b,
+		     parse_tree   *pt,
+		     char          cmds[BENCH_NCMD][BENCH_CMDLEN])
+{
+    int         retval = -1;
+    parse_tree *ptn = NULL;
+    cvec       *cvv = NULL;
+    char       *s = NULL;
+    size_t      slen = BENCH_CMDLEN;
+    char       *cmd;
+    char       *last;
+    uint64_t    t0;
+    uint64_t    ns = 0;
+    int         i;
+
+    if ((s = malloc(slen)) == NULL)
+	goto done;
+    for (i=0; i<b->b_iter; i++){
+	cmd = cmds[i%BENCH_NCMD];
+	strncpy(s, cmd, slen);
+	/* Cut last token in half */
+	last = strrchr(s, ' ');
+	last = last ? last+1 : s;
+	last[(strlen(last)+1)/2] = '\0';
+	t0 = bench_now();
+	if ((ptn = pt_new()) == NULL)
+	    goto done;
+	if ((cvv = cvec_start(s)) == NULL)
+	    goto done;
+	if (pt_expand_treeref(h, NULL, pt) < 0)
+	    goto done;
+	if (pt_expand(h, pt, cvv, 1, 0, ptn) < 0)
+	    goto done;
+	if (match_complete(h, ptn, &s, &slen, cvv) < 0)
+	    goto done;
+	pt_free(ptn, 0);
+	ptn = NULL;
+	cvec_free(cvv);
+	cvv = NULL;
+	if (pt_expand_cleanup(pt) < 0)
+	    goto done;
+	ns += bench_now() - t0;
+    }
+    bench_report(b, "match_complete", b->b_iter, ns);
+    retval = 0;
+ done:
+    if (ptn)
+	pt_free(ptn, 0);
+    if (cvv)
+	cvec_free(cvv);
+    if (s)
+	free(s);
+    return retval;
+}
+
+/*! Benchmark expansion of the top level, including calling the expand callback */
+static int
+bench_pt_expand(cligen_handle h,
+		struct bench *b,
+		parse_tree   *pt)
+{
+    int         retval = -1;
+    parse_tree *ptn = NULL;
+    cvec       *cvv = NULL;
+    uint64_t    t0;
+    int         i;
+
+    if ((cvv = cvec_start("exp ")) == NULL)
+	goto done;
+    t0 = bench_now();
+    for (i=0; i<b->b_iter; i++){
+	if ((ptn = pt_new()) == NULL)
+	    goto done;
+	if (pt_expand_treeref(h, NULL, pt) < 0)
+	    goto done;
+	if (pt_expand(h, pt, cvv, 1, 1, ptn) < 0)
+	    goto done;
+	pt_free(ptn, 0);
+	ptn = NULL;
+    }
+    bench_report(b, "pt_expand", b->b_iter, bench_now() - t0);
+    retval = 0;
+ done:
+    if (ptn)
+	pt_free(ptn, 0);
+    if (cvv)
+	cvec_free(cvv);
+    return retval;
+}
+
+/*! Benchmark parsing and validation of values of the variables on the top level */
+static int
+bench_cv_validate(cligen_handle h,
+		  struct bench *b,
+		  parse_tree   *pt)
+{
+    int       retval = -1;
+    cg_obj   *co;
+    cg_var   *cv = NULL;
+    char     *reason = NULL;
+    char      val[32];
+    uint64_t  t0;
+    uint64_t  ns = 0;
+    int       n = 0;
+    int       i;
+    int       j;
+
+    for (j=0; j<pt_len_get(pt); j++){
+	if ((co = pt_vec_i_get(pt, j)) == NULL || co->co_type != CO_VARIABLE)
+	    continue;
+	t0 = bench_now();
+	for (i=0; i<b->b_iter; i++){
+	    if (co->co_vtype == CGV_INT32)
+		snprintf(val, sizeof(val), "%d", i);
+	    else
+		snprintf(val, sizeof(val), "x%s_%d", co->co_command+1, i); /* sN -> xN_i */
+	    if ((cv = cv_new(co->co_vtype)) == NULL)
+		goto done;
+	    if (cv_parse1(val, cv, &reason) != 1 ||
+		cv_validate(h, cv, co2varspec(co), co->co_command, &reason) != 1){
+		fprintf(stderr, "cv_validate: %s: %s\n", val, reason?reason:"");
+		goto done;
+	    }
+	    cv_free(cv);
+	    cv = NULL;
+	}
+	ns += bench_now() - t0;
+	n += b->b_iter;
+    }
+    bench_report(b, "cv_validate", n, ns);
+    retval = 0;
+ done:
+    if (reason)
+	free(reason);
+    if (cv)
+	cv_free(cv);
+    return retval;
+}
+
+/*! Benchmark formatted and pre-rendered output of lines to /dev/null */
+static int
+bench_output(cligen_handle h,
+	     struct bench *b)
+{
+    int       retval = -1;
+    FILE     *f;
+    char      line[64];
+    uint64_t  t0;
+    int       len;
+    int       i;
+
+    if ((f = fopen("/dev/null", "w")) == NULL){
+	fprintf(stderr, "fopen /dev/null: %s\n", strerror(errno));
+	return -1;
+    }
+    t0 = bench_now();
+    for (i=0; i<b->b_iter; i++)
+	if (cligen_output_h(h, f, "%-20s %10d %s\n", "interface", i, "up") < 0)
+	    goto done;
+    bench_report(b, "cligen_output", b->b_iter, bench_now() - t0);
+    len = snprintf(line, sizeof(line), "%-20s %10d %s\n", "interface", 0, "up");
+    t0 = bench_now();
+    for (i=0; i<b->b_iter; i++)
+	if (cligen_output_write(h, f, line, len) < 0)
+	    goto done;
+    bench_report(b, "cligen_output_write", b->b_iter, bench_now() - t0);
+    retval = 0;
+ done:
+    fclose(f);
+    return retval;
+}
+
+/*! Benchmark name lookups and printing of a cvec with one variable per keyword of a level */
+static int
+bench_cvec(cligen_handle h,
+	   struct bench *b)
+{
+    int       retval = -1;
+    cvec     *cvv = NULL;
+    cg_var   *cv;
+    cbuf     *cb = NULL;
+    char      name[16];
+    uint64_t  t0;
+    int       i;
+
+    if ((cvv = cvec_new(0)) == NULL)
+	goto done;
+    if ((cb = cbuf_new()) == NULL)
+	goto done;
+    for (i=0; i<b->b_width; i++){
+	snprintf(name, sizeof(name), "k%d", i);
+	if ((cv = cvec_add(cvv, CGV_INT32)) == NULL)
+	    goto done;
+	cv_name_set(cv, name);
+	cv_int32_set(cv, i);
+    }
+    t0 = bench_now();
+    for (i=0; i<b->b_iter; i++){
+	snprintf(name, sizeof(name), "k%d", i % b->b_width);
+	if (cvec_find(cvv, name) == NULL){
+	    fprintf(stderr, "%s: %s not found\n", __FUNCTION__, name);
+	    goto done;
+	}
+    }
+    bench_report(b, "cvec_find", b->b_iter, bench_now() - t0);
+    t0 = bench_now();
+    for (i=0; i<b->b_iter; i++){
+	cbuf_reset(cb);
+	if (cvec2cbuf(cb, cvv) < 0)
+	    goto done;
+    }
+    bench_report(b, "cvec2cbuf", b->b_iter, bench_now() - t0);
+    retval = 0;
+ done:
+    if (cb)
+	cbuf_free(cb);
+    if (cvv)
+	cvec_free(cvv);
+    return retval;
+}
+
+/*! Select corpus input files */
+static int
+bench_corpus_filter(const struct dirent *de)
+{
+    size_t len = strlen(de->d_name);
+
+    return len > 3 && strcmp(de->d_name + len - 3, ".in") == 0;
+}
+
+/*! Replay the inputs of one corpus file in its clispec
+ * @param[in]  b     Bench parameters
+ * @param[in]  dir   Corpus directory
+ * @param[in]  name  Input file
+ */
+static int
+bench_corpus_file(struct bench *b,
+		  char         *dir,
+		  char         *name)
+{
+    int           retval = -1;
+    cligen_handle h = NULL;
+    cvec         *globals = NULL;
+    cvec         *cvv = NULL;
+    cbuf         *cb = NULL;
+    FILE         *f = NULL;
+    pt_head      *ph;
+    parse_tree   *pt;
+    cg_obj       *co;
+    cligen_result result;
+    char         *reason = NULL;
+    char         *line = NULL;
+    size_t        linecap = 0;
+    ssize_t       len;
+    char         *str = NULL;
+    cligen_stats  st;
+    uint64_t      t0;
+    uint64_t      ns;
+    int           lineno = 0;
+    int           i;
+
+    if ((cb = cbuf_new()) == NULL)
+	goto done;
+    if ((h = cligen_init()) == NULL)
+	goto done;
+    cligen_userhandle_set(h, b);
+    if ((globals = cvec_new(0)) == NULL)
+	goto done;
+    cprintf(cb, "%s/%.*s.cli", dir, (int)strlen(name)-3, name);
+    if ((f = fopen(cbuf_get(cb), "r")) == NULL){
+	fprintf(stderr, "fopen(%s): %s\n", cbuf_get(cb), strerror(errno));
+	goto done;
+    }
+    if (cligen_parse_file(h, f, cbuf_get(cb), NULL, globals) < 0)
+	goto done;
+    fclose(f);
+    f = NULL;
+    if ((str = cvec_find_str(globals, "mode")) != NULL)
+	cligen_ph_active_set(h, str);
+    if ((str = cvec_find_str(globals, "comment")) != NULL)
+	cligen_comment_set(h, *str);
+    str = NULL;
+    ph = NULL;
+    while ((ph = cligen_ph_each(h, ph)) != NULL)
+	if (cligen_expandv_str2fn(cligen_ph_parsetree_get(ph), str2fn_exp, NULL) < 0)
+	    goto done;
+    if ((pt = cligen_ph_active_get(h)) == NULL){
+	fprintf(stderr, "%s: no active parse-tree\n", cbuf_get(cb));
+	goto done;
+    }
+    cbuf_reset(cb);
+    cprintf(cb, "%s/%s", dir, name);
+    if ((f = fopen(cbuf_get(cb), "r")) == NULL){
+	fprintf(stderr, "fopen(%s): %s\n", cbuf_get(cb), strerror(errno));
+	goto done;
+    }
+    if ((cvv = cvec_new(0)) == NULL)
+	goto done;
+    while ((len = getline(&line, &linecap, f)) > 0){
+	lineno++;
+	if (line[len-1] == '\n')
+	    line[--len] = '\0';
+	if (len == 0 || *line == '#')
+	    continue;
+	/* cliread_parse modifies the string */
+	if ((str = malloc(len+1)) == NULL)
+	    goto done;
+	ns = 0;
+	for (i=0; i<b->b_citer; i++){
+	    memcpy(str, line, len+1);
+	    cligen_stats_reset(h);
+	    t0 = bench_now();
+	    if (cliread_parse(h, str, pt, &co, cvv, &result, &reason) < 0)
+		goto done;
+	    ns += bench_now() - t0;
+	    if (reason){
+		free(reason);
+		reason = NULL;
+	    }
+	    cvec_reset(cvv);
+	}
+	free(str);
+	str = NULL;
+	cligen_stats_get(h, &st);
+	fprintf(b->b_out, "{\"bench\":\"corpus\",\"file\":\"%s\",\"line\":%d,\"len\":%zd,"
+		"\"iterations\":%d,\"total_ns\":%llu,\"ns_per_op\":%.1f,\"match_object\":%llu}\n",
+		name, lineno, len, b->b_citer, (unsigned long long)ns,
+		b->b_citer?(double)ns/b->b_citer:0.0, (unsigned long long)st.cs_match_object);
+	fflush(b->b_out);
+    }
+    retval = 0;
+ done:
+    if (str)
+	free(str);
+    if (line)
+	free(line);
+    if (reason)
+	free(reason);
+    if (f)
+	fclose(f);
+    if (cvv)
+	cvec_free(cvv);
+    if (globals)
+	cvec_free(globals);
+    if (cb)
+	cbuf_free(cb);
+    if (h)
+	cligen_exit(h);
+    return retval;
+}
+
+/*! Replay all inputs of a performance-regression corpus directory, see cligen_latfuzz.c */
+static int
+bench_corpus(struct bench *b,
+	     char         *dir)
+{
+    int             retval = -1;
+    struct dirent **namelist = NULL;
+    int             n;
+    int             i;
+
+    if ((n = scandir(dir, &namelist, bench_corpus_filter, alphasort)) < 0){
+	fprintf(stderr, "scandir(%s): %s\n", dir, strerror(errno));
+	return -1;
+    }
+    for (i=0; i<n; i++)
+	if (bench_corpus_file(b, dir, namelist[i]->d_name) < 0)
+	    goto done;
+    retval = 0;
+ done:
+    for (i=0; i<n; i++)
+	free(namelist[i]);
+    free(namelist);
+    return retval;
+}
+
+static void
+usage(char *argv0)
+{
+    fprintf(stderr, "Usage:%s [-h][-w <n>][-d <n>][-v <n>][-r <n>][-e <n>][-n <n>][-p <n>][-C <dir>][-c <n>][-o <file>], where the options have the following meaning:\n"
+	    "\t-h \t\tHelp\n"
+	    "\t-w <n> \tKeywords per level (default 10)\n"
+	    "\t-d <n> \tLevels of tree (default 3)\n"
+	    "\t-v <n> \tVariables per level (default 2)\n"
+	    "\t-r <n> \tNumber of tree references (default 2)\n"
+	    "\t-e <n> \tNumber of values returned by expand callback (default 10)\n"
+	    "\t-n <n> \tIterations of match, completion, expand, validate, output and cvec (default 10000)\n"
+	    "\t-p <n> \tIterations of clispec parsing (default 10)\n"
+	    "\t-C <dir> \tReplay inputs of performance-regression corpus in dir\n"
+	    "\t-c <n> \tIterations of each corpus input (default 100)\n"
+	    "\t-o <file> \tWrite results to file (default stdout)\n",
+	    argv0);
+    exit(0);
+}
+
+int
+main(int   argc,
+     char *argv[])
+{
+    int           retval = -1;
+    cligen_handle h = NULL;
+    struct bench  b = {10, 3, 2, 2, 10, 10000, 10, 100, stdout};
+    cbuf         *spec = NULL;
+    pt_head      *ph;
+    parse_tree   *pt;
+    char        (*cmds)[BENCH_CMDLEN] = NULL;
+    char         *corpus = NULL;
+    int           c;
+
+    while ((c = getopt(argc, argv, "hw:d:v:r:e:n:p:C:c:o:")) != -1)
+	switch (c) {
+	case 'w':
+	    b.b_width = atoi(optarg);
+	    break;
+	case 'd':
+	    b.b_depth = atoi(optarg);
+	    break;
+	case 'v':
+	    b.b_vars = atoi(optarg);
+	    break;
+	case 'r':
+	    b.b_refs = atoi(optarg);
+	    break;
+	case 'e':
+	    b.b_expand = atoi(optarg);
+	    break;
+	case 'n':
+	    b.b_iter = atoi(optarg);
+	    break;
+	case 'p':
+	    b.b_piter = atoi(optarg);
+	    break;
+	case 'C':
+	    corpus = optarg;
+	    break;
+	case 'c':
+	    b.b_citer = atoi(optarg);
+	    break;
+	case 'o':
+	    if ((b.b_out = fopen(optarg, "w")) == NULL){
+		fprintf(stderr, "fopen(%s): %s\n", optarg, strerror(errno));
+		exit(1);
+	    }
+	    break;
+	case 'h':
+	default:
+	    usage(argv[0]);
+	    break;
+	}
+    if (b.b_width < 1 || b.b_depth < 1 || b.b_vars < 0 || b.b_refs < 0 || b.b_expand < 0)
+	usage(argv[0]);
+    if ((h = cligen_init()) == NULL)
+	goto done;
+    cligen_userhandle_set(h, &b);
+    if ((spec = bench_spec(&b)) == NULL)
+	goto done;
+    if ((cmds = malloc(BENCH_NCMD * sizeof(*cmds))) == NULL)
+	goto done;
+    bench_commands(&b, cmds);
+    if (bench_parse_str(&b, cbuf_get(spec)) < 0)
+	goto done;
+    /* Parse the trees used by the other benchmarks */
+    if (cligen_parse_str(h, cbuf_get(spec), "bench", NULL, NULL) < 0)
+	goto done;
+    if ((ph = cligen_ph_find(h, "bench")) == NULL ||
+	(pt = cligen_ph_parsetree_get(ph)) == NULL){
+	fprintf(stderr, "bench tree not found\n");
+	goto done;
+    }
+    cligen_ph_active_set(h, "bench");
+    if (cligen_expandv_str2fn(pt, str2fn_exp, NULL) < 0)
+	goto done;
+    if (bench_cliread_parse(h, &b, pt, cmds) < 0)
+	goto done;
+    if (bench_match_complete(h, &b, pt, cmds) < 0)
+	goto done;
+    if (bench_pt_expand(h, &b, pt) < 0)
+	goto done;
+    if (bench_cv_validate(h, &b, pt) < 0)
+	goto done;
+    if (bench_output(h, &b) < 0)
+	goto done;
+    if (bench_cvec(h, &b) < 0)
+	goto done;
+    if (corpus && bench_corpus(&b, corpus) < 0)
+	goto done;
+    retval = 0;
+ done:
+    if (cmds)
+	free(cmds);
+    if (spec)
+	cbuf_free(spec);
+    if (h)
+	cligen_exit(h);
+    if (b.b_out != stdout)
+	fclose(b.b_out);
+    return retval;
+}
@@ -52,14 +52,20 @@
 #define CBUFLEN_START 1024
 #define CBUFLEN_THRESHOLD 65536
 
+/* Max number of free cbufs kept per thread for reuse by cbuf_new */
+#define CBUF_POOL_MAX 16
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <sys/types.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "cligen_buf.h"              /* External API */
 #include "cligen_buf_internal.h"            
+#include "cligen_stats_internal.h"
 
 /*
  * Variables
@@ -74,6 +80,53 @@ static size_t cbuflen_start     = CBUFLEN_START;
  */
 static size_t cbuflen_threshold = CBUFLEN_THRESHOLD;
 
+/* Free cbufs of the default size of this thread, reused by cbuf_new so that short-lived
+ * buffers, eg of output callbacks, do not hit the heap. Linked with cb_next.
+ */
+static __thread cbuf *cbuf_pool = NULL;
+static __thread int   cbuf_pool_len = 0;
+static __thread int   cbuf_pool_reg = 0;  /* Pool is flushed when this thread exits */
+
+/* Key whose destructor flushes the pool of an exiting thread, see cbuf_pool_register */
+static pthread_key_t  cbuf_pool_key;
+static pthread_once_t cbuf_pool_once = PTHREAD_ONCE_INIT;
+static int            cbuf_pool_keyok = 0;
+
+/*! Flush the pool of an exiting thread, destructor of cbuf_pool_key
+ */
+static void
+cbuf_pool_destroy(void *arg)
+{
+    cbuf_pool_flush();
+    cbuf_pool_reg = 0; /* cbufs freed by later destructors register again */
+}
+
+/*! Create cbuf_pool_key, once per process
+ */
+static void
+cbuf_pool_key_init(void)
+{
+    if (pthread_key_create(&cbuf_pool_key, cbuf_pool_destroy) == 0)
+	cbuf_pool_keyok = 1;
+}
+
+/*! Make sure the pool of the calling thread is flushed when the thread exits
+ * @retval     0   OK
+ * @retval    -1   No thread-exit destructor, do not pool in this thread
+ */
+static int
+cbuf_pool_register(void)
+{
+    if (cbuf_pool_reg)
+	return 0;
+    pthread_once(&cbuf_pool_once, cbuf_pool_key_init);
+    if (!cbuf_pool_keyok ||
+	pthread_setspecific(cbuf_pool_key, (void*)1) != 0)
+	return -1;
+    cbuf_pool_reg = 1;
+    return 0;
+}
+
 /*! Get global cbuf initial memory allocation size
  * This is how large a cbuf is after calling cbuf_new. Note that the cbuf 
  * may grow after calls to cprintf or cbuf_alloc
@@ -105,6 +158,7 @@ cbuf_alloc_set(size_t start,
 
 /*! Allocate cligen buffer. Returned handle can be used in sprintf calls
  * which dynamically print a string.
+ * The struct and the initial buffer are allocated at once.
  * The handle should be freed by cbuf_free()
  * @param[in]   How much buffer space for initial allocation
  * @retval cb   The allocated objecyt handle on success.
@@ -116,19 +170,23 @@ cbuf_new_alloc(size_t sz)
 {
     cbuf *cb;
 
-    if ((cb = (cbuf*)malloc(sizeof(*cb))) == NULL)
+    if (sz == 0)
+	sz = 1;
+    if ((cb = (cbuf*)malloc(sizeof(*cb) + sz)) == NULL)
 	return NULL;
+    cligen_stats_global_inc(_cligen_stats_cbuf_alloc);
     memset(cb, 0, sizeof(*cb));
+    cb->cb_buffer = cb->cb_inline;
     cb->cb_buflen = sz;
-    if ((cb->cb_buffer = malloc(cb->cb_buflen)) == NULL)
-	return NULL;
-    memset(cb->cb_buffer, 0, cb->cb_buflen);
+    cb->cb_inlen = sz;
+    cb->cb_buffer[0] = '\0';
     cb->cb_strlen = 0;
     return cb;
 }
 
 /*! Allocate cligen buffer with auto buffer allocation. Returned handle can be used in sprintf calls
  * which dynamically print a string.
+ * A cbuf freed by the same thread is reused if there is one, see cbuf_free.
  * The handle should be freed by cbuf_free()
  * @retval cb   The allocated objecyt handle on success.
  * @retval NULL Error.
@@ -137,20 +195,63 @@ cbuf_new_alloc(size_t sz)
 cbuf *
 cbuf_new(void)
 {
+    cbuf *cb;
+
+    if ((cb = cbuf_pool) != NULL){
+	if (cb->cb_inlen == cbuflen_start){
+	    cbuf_pool = cb->cb_next;
+	    cbuf_pool_len--;
+	    cb->cb_next = NULL;
+	    cb->cb_strlen = 0;
+	    cb->cb_buffer[0] = '\0';
+	    return cb;
+	}
+	cbuf_pool_flush(); /* Default size changed */
+    }
     return cbuf_new_alloc(cbuflen_start);
 }
 
 /*! Free cligen buffer previously allocated with cbuf_new
+ * A cbuf of the default size is kept in a pool of the calling thread for reuse by
+ * cbuf_new. Its buffer is shrunk to the initial size if it has grown. The pool is
+ * freed when the thread exits.
  * @param[in]   cb  Cligen buffer
+ * @see cbuf_pool_flush
  */
 void
 cbuf_free(cbuf *cb)
 {
-    if (cb) {
-	if (cb->cb_buffer)
-	    free(cb->cb_buffer);
+    if (cb == NULL)
+	return;
+    if (cb->cb_buffer != cb->cb_inline){
+	free(cb->cb_buffer);
+	cb->cb_buffer = cb->cb_inline;
+	cb->cb_buflen = cb->cb_inlen;
+    }
+    if (cb->cb_inlen == cbuflen_start && cbuf_pool_len < CBUF_POOL_MAX &&
+	cbuf_pool_register() == 0){
+	cb->cb_next = cbuf_pool;
+	cbuf_pool = cb;
+	cbuf_pool_len++;
+	return;
+    }
+    free(cb);
+}
+
+/*! Free the pool of unused cbufs of the calling thread
+ * Done automatically when a thread exits with pthread_exit() or by returning from its
+ * start function. Also called by cligen_exit().
+ */
+void
+cbuf_pool_flush(void)
+{
+    cbuf *cb;
+
+    while ((cb = cbuf_pool) != NULL){
+	cbuf_pool = cb->cb_next;
 	free(cb);
     }
+    cbuf_pool_len = 0;
 }
 
 /*! Return actual byte buffer of cligen buffer
@@ -192,6 +293,25 @@ cbuf_reset(cbuf *cb)
     cb->cb_buffer[0] = '\0'; 
 }
 
+/*! Truncate a cligen buffer, ie remove all bytes after len
+ * @param[in]   cb  Cligen buffer
+ * @param[in]   len New length, must not be larger than current length
+ * @retval      0   OK
+ * @retval     -1   Error, len is larger than current length
+ */
+int
+cbuf_trunc(cbuf  *cb,
+	   size_t len)
+{
+    if (len > cb->cb_strlen){
+	errno = EINVAL;
+	return -1;
+    }
+    cb->cb_strlen = len;
+    cb->cb_buffer[len] = '\0';
+    return 0;
+}
+
 /*! Internal buffer reallocator, Ensure buffer is large enough
  * use quadratic expansion (2* size)
  * @param[in] cb   CLIgen buffer
@@ -201,31 +321,58 @@ static int
 cbuf_realloc(cbuf  *cb,
 	     size_t sz)
 {
-    int retval = -1;
-    int diff;
+    int     retval = -1;
+    ssize_t diff;
+    size_t  buflen = cb->cb_buflen;
+    char   *buf;
     
-    diff = cb->cb_buflen - (cb->cb_strlen + sz + 1);
+    diff = buflen - (cb->cb_strlen + sz + 1);
     if (diff <= 0){
 	while (diff <= 0){
-	    if (cbuflen_threshold == 0 || cb->cb_buflen < cbuflen_threshold)
-		cb->cb_buflen *= 2; /* Double the space - exponential */
+	    if (cbuflen_threshold == 0 || buflen < cbuflen_threshold)
+		buflen *= 2; /* Double the space - exponential */
 	    else
-		cb->cb_buflen += cbuflen_threshold; /* Add - linear growth*/
-	    diff = cb->cb_buflen - (cb->cb_strlen + sz + 1);
+		buflen += cbuflen_threshold; /* Add - linear growth*/
+	    diff = buflen - (cb->cb_strlen + sz + 1);
+	}
+	if (cb->cb_buffer == cb->cb_inline){ /* Move initial buffer to the heap */
+	    if ((buf = malloc(buflen)) == NULL)
+		goto done;
+	    memcpy(buf, cb->cb_buffer, cb->cb_strlen+1);
 	}
-	if ((cb->cb_buffer = realloc(cb->cb_buffer, cb->cb_buflen)) == NULL)
+	else if ((buf = realloc(cb->cb_buffer, buflen)) == NULL)
 	    goto done;
+	cb->cb_buffer = buf;
+	cb->cb_buflen = buflen;
     }
     retval = 0;
  done:
     return retval;
 }
 
+/*! Ensure there is room for more bytes in a cligen buffer
+ *
+ * Use before many appends of known total length, to grow the buffer at most once
+ * @param [in]  cb   cligen buffer allocated by cbuf_new(), may be reallocated.
+ * @param [in]  len  Number of bytes that will be appended, excluding null byte
+ * @retval      0    OK
+ * @retval     -1   Error
+ */
+int
+cbuf_reserve(cbuf  *cb,
+	     size_t len)
+{
+    return cbuf_realloc(cb, len);
+}
+
 /*! Append a cligen buf by printf like semantics
  * 
+ * Formats directly into the free space of the buffer, and only formats again if the
+ * result did not fit, see vcprintf.
  * @param [in]  cb      cligen buffer allocated by cbuf_new(), may be reallocated.
  * @param [in]  format  arguments uses printf syntax.
- * @retval      See printf
+ * @retval      0       OK
+ * @retval     -1       Error
  * @see cbuf_append_str for the optimized special case of string append
  * @note cprintf assume null-terminated string as %s, use cbuf_memcp for a raw interface
  */
@@ -233,31 +380,52 @@ int
 cprintf(cbuf       *cb, 
 	const char *format, ...)
 {
-    int     retval = -1;
+    int     retval;
     va_list ap;
+
+    va_start(ap, format);
+    retval = vcprintf(cb, format, ap);
+    va_end(ap);
+    return retval < 0 ? -1 : 0;
+}
+
+/*! Append a cligen buf by vprintf like semantics
+ *
+ * Formats directly into the free space of the buffer, and only formats again if the
+ * result did not fit.
+ * @param [in]  cb      cligen buffer allocated by cbuf_new(), may be reallocated.
+ * @param [in]  format  arguments uses printf syntax.
+ * @param [in]  ap      Variable argument list, see vprintf(3)
+ * @retval      See vprintf
+ * @see cprintf
+ */
+int
+vcprintf(cbuf       *cb, 
+	 const char *format,
+	 va_list     ap)
+{
+    va_list ap1;
     int     len;
-    int     ret;
 
     if (cb == NULL)
-	goto ok;
-    va_start(ap, format); /* dryrun */
-    if ((len = vsnprintf(NULL, 0, format, ap)) < 0) /* dryrun, just get len */
-	goto done;
-    va_end(ap);
-    /* Ensure buffer is large enough */
-    if (cbuf_realloc(cb, len) < 0)
-    	goto done;
-    va_start(ap, format); /* real */
-    if ((ret = vsnprintf(cb->cb_buffer+cb->cb_strlen, /* str */
-			 cb->cb_buflen-cb->cb_strlen, /* size */
-			 format, ap)) < 0)
-	goto done;
-    va_end(ap);
-    cb->cb_strlen += ret;
- ok:
-    retval = 0;
- done:
-    return retval;
+	return 0;
+    va_copy(ap1, ap);
+    len = vsnprintf(cb->cb_buffer+cb->cb_strlen, /* str */
+		    cb->cb_buflen-cb->cb_strlen, /* size */
+		    format, ap1);
+    va_end(ap1);
+    if (len < 0)
+	return -1;
+    if (len >= cb->cb_buflen-cb->cb_strlen){ /* Truncated, ensure buffer is large enough */
+	if (cbuf_realloc(cb, len) < 0)
+	    return -1;
+	if ((len = vsnprintf(cb->cb_buffer+cb->cb_strlen,
+			     cb->cb_buflen-cb->cb_strlen,
+			     format, ap)) < 0)
+	    return -1;
+    }
+    cb->cb_strlen += len;
+    return len;
 }
 
 /*! Append a string to a cbuf
@@ -283,7 +451,7 @@ cbuf_append_str(cbuf       *cb,
     len0 = strlen(str);
     len = cb->cb_strlen + len0;
     /* Ensure buffer is large enough */
-    if (cbuf_realloc(cb, len) < 0)
+    if (cbuf_realloc(cb, len0) < 0)
 	return -1;
     strncpy(cb->cb_buffer+cb->cb_strlen, str, len0+1);
     cb->cb_strlen = len;
@@ -333,7 +501,7 @@ cbuf_append_buf(cbuf  *cb,
     len0 = cb->cb_strlen;
     len = cb->cb_strlen + n;
     /* Ensure buffer is large enough */
-    if (cbuf_realloc(cb, len+1) < 0)
+    if (cbuf_realloc(cb, n) < 0)
 	return -1;
     memcpy(cb->cb_buffer+len0, src, n);
     cb->cb_buffer[len] = '\0'; /* Add a null byte */
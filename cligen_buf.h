@@ -63,15 +63,19 @@ cbuf    *cbuf_new(void);
 cbuf    *cbuf_new_alloc(size_t sz);
 
 void     cbuf_free(cbuf *cb);
+void     cbuf_pool_flush(void);
 char    *cbuf_get(cbuf *cb);
 int      cbuf_len(cbuf *cb); /* XXX size_t */
 int      cbuf_buflen(cbuf *cb);
+int      cbuf_reserve(cbuf *cb, size_t len);
 #if defined(__GNUC__) && __GNUC__ >= 3
 int      cprintf(cbuf *cb, const char *format, ...) __attribute__ ((format (printf, 2, 3)));
 #else
 int      cprintf(cbuf *cb, const char *format, ...);
 #endif
+int      vcprintf(cbuf *cb, const char *format, va_list ap);
 void     cbuf_reset(cbuf *cb);
+int      cbuf_trunc(cbuf *cb, size_t len);
 int      cbuf_append(cbuf *cb, int c);
 int      cbuf_append_str(cbuf *cb, char *str);
 int      cbuf_append_buf(cbuf *cb, void *src, size_t n);
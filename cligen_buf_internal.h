@@ -42,11 +42,16 @@
  * Types
  */
 /*! Internal CLIgen buffer. 
+ * The initial buffer is allocated together with the struct, in cb_inline. A buffer
+ * that grows is moved to the heap.
  */
 struct cbuf {
-    char  *cb_buffer;   /* pointer to buffer */
+    char  *cb_buffer;   /* pointer to buffer, cb_inline or on the heap */
     size_t cb_buflen;   /* allocated bytes of buffer */
     size_t cb_strlen;   /* length of string in buffer (< buflen) */
+    size_t cb_inlen;    /* allocated bytes of cb_inline */
+    struct cbuf *cb_next; /* Next free cbuf in pool, see cbuf_free */
+    char   cb_inline[]; /* initial buffer */
 };
 
 #endif /* _CLIGEN_BUF_INTERNAL_H */
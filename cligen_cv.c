@@ -56,6 +56,7 @@
 #include <errno.h>
 
 #include "cligen_buf.h"
+#include "cligen_intern.h"
 #include "cligen_cv.h"
 #include "cligen_cvec.h"
 #include "cligen_parsetree.h"
@@ -64,8 +65,16 @@
 #include "cligen_match.h"
 #include "cligen_regex.h"
 #include "cligen_getline.h"
+#include "cligen_stats.h"
 
 #include "cligen_cv_internal.h"
+#include "cligen_stats_internal.h"
+
+/*
+ * Variables
+ */
+uint64_t _cligen_cv_name_gen = 0; /* see cligen_cv_internal.h */
+
 /*
  * URL protocol strings
  */
@@ -97,8 +106,9 @@ cv_name_get(cg_var *cv)
  * Free previous string if existing.
  * @param[in] cv     CLIgen variable
  * @param[in] s0     New name
- * @retval    s0     Return the new name
+ * @retval    s1     Return the new name, an interned copy of s0
  * @retval    NULL   Error
+ * @note The name is shared with other variables and must not be modified, see cligen_intern
  */
 char *
 cv_name_set(cg_var *cv, 
@@ -109,14 +119,15 @@ cv_name_set(cg_var *cv,
     if (cv == NULL) 
 	return 0;
 
-    /* Duplicate s0. Must be done before a free, in case s0 is part of the original */
+    /* Intern s0. Must be done before a free, in case s0 is part of the original */
     if (s0){
-	if ((s1 = strdup(s0)) == NULL)
+	if ((s1 = cligen_intern(s0)) == NULL)
 	    return NULL; /* error in errno */
     }
-    if (cv->var_name != NULL)
-	free(cv->var_name);
+    cligen_intern_free(cv->var_name);
     cv->var_name = s1;
+    if (cv->var_indexed) /* Name index of its cvec is stale */
+	__atomic_add_fetch(&_cligen_cv_name_gen, 1, __ATOMIC_RELAXED);
     return s1; 
 }
 
@@ -473,10 +484,27 @@ cv_dec64_i_set(cg_var *cv,
     return (cv->var_dec64_i = x);
 }
 
+/*! Free string value of a cv, string, rest or interface, which have the same address
+ * @param[in] cv     CLIgen variable
+ */
+static void
+cv_string_free(cg_var *cv)
+{
+    if (cv->u.varu_string == NULL)
+	return;
+    if (cv->var_intern)
+	cligen_intern_free(cv->u.varu_string);
+    else
+	free(cv->u.varu_string);
+    cv->u.varu_string = NULL;
+    cv->var_intern = 0;
+}
+
 /*! Get pointer to cv string. 
  *
  * @param[in] cv     CLIgen variable
  * String can be modified in-line but must call _set function to reallocate.
+ * Except if interned with cv_string_intern.
  */
 char *
 cv_string_get(cg_var *cv)
@@ -510,8 +538,7 @@ cv_string_set(cg_var *cv,
     /* Duplicate s0. Must be done before a free, in case s0 is part of the original */
     if ((s1 = strdup(s0)) == NULL)
 	return NULL; /* error in errno */
-    if (cv->u.varu_string != NULL)
-	free(cv->u.varu_string);
+    cv_string_free(cv);
     cv->u.varu_string = s1;
     return s1; 
 }
@@ -543,12 +570,38 @@ cv_strncpy(cg_var *cv,
 	return NULL; /* error in errno */
     strncpy(s1, s0, n);
     s1[n] = '\0';
-    if (cv->u.varu_string != NULL)
-	free(cv->u.varu_string);
+    cv_string_free(cv);
     cv->u.varu_string = s1;
     return s1; 
 }
 
+/*! Replace the string value of a cv with an interned copy
+ * Used for strings that are copied often but never modified, such as help texts.
+ * The string may then not be modified in-line. Copies made by cv_cp share it.
+ * @param[in] cv     CLIgen variable of type string, rest or interface
+ * @retval    0      OK
+ * @retval   -1      Error, errno set
+ * @see cligen_intern
+ */
+int
+cv_string_intern(cg_var *cv)
+{
+    char *s;
+
+    if (cv == NULL || !cv_isstring(cv->var_type)){
+	errno = EINVAL;
+	return -1;
+    }
+    if (cv->var_intern || cv->u.varu_string == NULL)
+	return 0;
+    if ((s = cligen_intern(cv->u.varu_string)) == NULL)
+	return -1;
+    free(cv->u.varu_string);
+    cv->u.varu_string = s;
+    cv->var_intern = 1;
+    return 0;
+}
+
 /*! Get ipv4addr, pointer returned, can be used to set value.
  * @param[in] cv     CLIgen variable
  */
@@ -907,12 +960,65 @@ cv_urlpasswd_set(cg_var *cv,
     return s1; 
 }
 
-/*! Parse an int64 number with explicit base and check for errors
- * @param[in]  str     String containing number to parse
- * @parame[in] base    If base is 0 or 16, the string may include a "0x" prefix,
- *                     the number will be read in base 16; otherwise, a zero base
- *                     is taken  as 10 (decimal) unless the next character is '0',
- *                     in which case it is taken as 8 (octal).
+/*! Initialize a token classification before the token is parsed
+ * @param[in]  tc   Token class, typically on the stack of the caller
+ * @param[in]  str  Token, must remain while tc is in use
+ * @see cv_parse1_class
+ */
+void
+cv_token_class_init(cv_token_class *tc,
+		    char           *str)
+{
+    memset(tc, 0, sizeof(*tc));
+    tc->tc_str = str;
+}
+
+/*! Scan a token as a signed integer, unless already done
+ * @param[in]  tc    Token class
+ * @param[in]  base  Base as given to strtoll
+ */
+static void
+tc_scan_int(cv_token_class *tc,
+	    int             base)
+{
+    char *ep;
+
+    if (tc->tc_flags & CV_TC_INT)
+	return;
+    cligen_stats_global_inc(_cligen_stats_cv_scan);
+    errno = 0;
+    tc->tc_int = strtoll(tc->tc_str, &ep, base);
+    tc->tc_inum = (tc->tc_str[0] != '\0' && *ep == '\0');
+    tc->tc_ierrno = errno;
+    errno = 0;
+    tc->tc_flags |= CV_TC_INT;
+}
+
+/*! Scan a token as an unsigned integer, unless already done
+ * @param[in]  tc    Token class
+ * @param[in]  base  Base as given to strtoull
+ */
+static void
+tc_scan_uint(cv_token_class *tc,
+	     int             base)
+{
+    char *ep;
+
+    if (tc->tc_flags & CV_TC_UINT)
+	return;
+    cligen_stats_global_inc(_cligen_stats_cv_scan);
+    errno = 0;
+    tc->tc_uint = strtoull(tc->tc_str, &ep, base);
+    tc->tc_unum = (tc->tc_str[0] != '\0' && *ep == '\0');
+    tc->tc_uerrno = errno;
+    errno = 0;
+    /* strtoull does _not_ detect negative numbers,... */
+    tc->tc_minus = (strchr(tc->tc_str, '-') != NULL);
+    tc->tc_flags |= CV_TC_UINT;
+}
+
+/*! Parse a classified token as an int64 number and check range
+ * @param[in]  tc      Token class, scanned here in base 0 if not already done
  * @param[in]  imin    Min range (set INT64_MIN for default)    
  * @param[in]  imax    Max range (set INT64_MAX for default)
  * @param[out] val     Value on success
@@ -922,63 +1028,71 @@ cv_urlpasswd_set(cg_var *cv,
  * @retval  1 : Validation OK, value returned in val parameter
  */
 static int
-parse_int64_base(char    *str, 
-		 int      base,
-		 int64_t  imin,
-		 int64_t  imax, 
-		 int64_t *val,
-		 char   **reason)
+parse_int64_class(cv_token_class *tc,
+		  int64_t         imin,
+		  int64_t         imax, 
+		  int64_t        *val,
+		  char          **reason)
 {
-    int64_t i;
-    char    *ep;
-    int      retval = -1;
+    int retval = -1;
 
-    errno = 0;
-    i = strtoll(str, &ep, base);
-    if (str[0] == '\0' || *ep != '\0'){
+    tc_scan_int(tc, 0);
+    if (!tc->tc_inum){
 	if (reason != NULL)
-	    if ((*reason = cligen_reason("'%s' is not a number", str)) == NULL){
-		retval = -1;
+	    if ((*reason = cligen_reason("'%s' is not a number", tc->tc_str)) == NULL)
 		goto done;
-	    }
 	retval = 0;
 	goto done;
     }
-    if (errno != 0){
-	if ((i == INT64_MIN || i == INT64_MAX) && errno == ERANGE){ 
-	    errno = 0;
-	    if (reason != NULL)
-		if ((*reason = cligen_reason("Number %s out of range: %" PRId64 " - %" PRId64, str, imin, imax)) == NULL){
-		    retval = -1; /* malloc */
-		    goto done;
-		}
-	    retval = 0;
-	    goto done;
-	}
-	else{
-	    if ((*reason = cligen_reason("%s: %s", str, strerror(errno))) == NULL){
-		errno = 0;
-		retval = -1;
+    if (tc->tc_ierrno != 0 && tc->tc_ierrno != ERANGE){
+	if (reason != NULL)
+	    if ((*reason = cligen_reason("%s: %s", tc->tc_str, strerror(tc->tc_ierrno))) == NULL)
 		goto done;
-	    }
-	}
-	errno = 0;
-    } /* if errno */
-    else if (i < imin || i > imax){
+	retval = 0;
+	goto done;
+    }
+    if (tc->tc_ierrno == ERANGE || tc->tc_int < imin || tc->tc_int > imax){
 	if (reason != NULL)
-	    if ((*reason = cligen_reason("Number %s out of range: %" PRId64 " - %" PRId64, str, imin, imax)) == NULL){
-		retval = -1;
+	    if ((*reason = cligen_reason("Number %s out of range: %" PRId64 " - %" PRId64, tc->tc_str, imin, imax)) == NULL)
 		goto done;
-	    }
 	retval = 0;
 	goto done;
     }
-    *val = i;
+    *val = tc->tc_int;
     retval = 1; /* OK */
   done:
     return retval;
 }
 
+/*! Parse an int64 number with explicit base and check for errors
+ * @param[in]  str     String containing number to parse
+ * @parame[in] base    If base is 0 or 16, the string may include a "0x" prefix,
+ *                     the number will be read in base 16; otherwise, a zero base
+ *                     is taken  as 10 (decimal) unless the next character is '0',
+ *                     in which case it is taken as 8 (octal).
+ * @param[in]  imin    Min range (set INT64_MIN for default)    
+ * @param[in]  imax    Max range (set INT64_MAX for default)
+ * @param[out] val     Value on success
+ * @param[out] reason  Error string on failure
+ * @retval -1 : Error (fatal), with errno set to indicate error
+ * @retval  0 : Validation not OK, malloced reason is returned
+ * @retval  1 : Validation OK, value returned in val parameter
+ */
+static int
+parse_int64_base(char    *str, 
+		 int      base,
+		 int64_t  imin,
+		 int64_t  imax, 
+		 int64_t *val,
+		 char   **reason)
+{
+    cv_token_class tc;
+
+    cv_token_class_init(&tc, str);
+    tc_scan_int(&tc, base);
+    return parse_int64_class(&tc, imin, imax, val, reason);
+}
+
 /*! Parse an int8 number and check for errors
  * @param[in]  str     String containing number to parse
  * @param[out] val     Value on success
@@ -1064,12 +1178,8 @@ parse_int64(char    *str,
     return parse_int64_base(str, 0, INT64_MIN, INT64_MAX, val, reason);
 }
 
-/*! Parse an uint64 number and check for errors
- * @param[in]  str     String containing number to parse
- * @parame[in] base    If base is 0 or 16, the string may include a "0x" prefix,
- *                     the number will be read in base 16; otherwise, a zero base
- *                     is taken  as 10 (decimal) unless the next character is '0',
- *                     in which case it is taken as 8 (octal).
+/*! Parse a classified token as an uint64 number and check range
+ * @param[in]  tc      Token class, scanned here in base 0 if not already done
  * @param[in]  umin    Min range (set UINT64_MIN for default)    
  * @param[in]  umax    Max range (set UINT64_MAX for default)
  * @param[out] val     Value on success
@@ -1077,75 +1187,81 @@ parse_int64(char    *str,
  * @retval -1 : Error (fatal), with errno set to indicate error
  * @retval  0 : Validation not OK, malloced reason is returned
  * @retval  1 : Validation OK, value returned in val parameter
- * @note: we have to detect a minus sign ourselves,....
  */
 static int
-parse_uint64_base(char     *str, 
-		  int       base,
-		  uint64_t  umin,
-		  uint64_t  umax, 
-		  uint64_t *val, 
-		  char    **reason)
+parse_uint64_class(cv_token_class *tc,
+		   uint64_t        umin,
+		   uint64_t        umax, 
+		   uint64_t       *val, 
+		   char          **reason)
 {
-    uint64_t i;
-    char    *ep;
-    int      retval = -1;
+    int retval = -1;
 
-    errno = 0;
-    i = strtoull(str, &ep, base);
-    if (str[0] == '\0' || *ep != '\0'){
+    tc_scan_uint(tc, 0);
+    if (!tc->tc_unum){
 	if (reason != NULL)
-	    if ((*reason = cligen_reason("'%s' is not a number", str)) == NULL){
-		retval = -1; /* malloc */
+	    if ((*reason = cligen_reason("'%s' is not a number", tc->tc_str)) == NULL)
 		goto done;
-	    }
 	retval = 0;
 	goto done;
     }
-    if (errno != 0){
-	if (i == UINT64_MAX && errno == ERANGE){ 
-	    if (reason != NULL)
-		if ((*reason = cligen_reason("Number %s out of range: 0 - %" PRIu64, str, umax)) == NULL){
-		    retval = -1; /* malloc */
-		    goto done;
-		}
-	    retval = 0;
-	    goto done;
-	}
-	else{
-	    if ((*reason = cligen_reason("%s: %s", str, strerror(errno))) == NULL){
-		retval = -1; /* malloc */
+    if (tc->tc_uerrno != 0 && tc->tc_uerrno != ERANGE){
+	if (reason != NULL)
+	    if ((*reason = cligen_reason("%s: %s", tc->tc_str, strerror(tc->tc_uerrno))) == NULL)
 		goto done;
-	    }
-	    retval = 0;
-	    goto done;
-	}
+	retval = 0;
+	goto done;
     }
-    else if (i > umax){
+    if (tc->tc_uerrno == ERANGE || tc->tc_minus){
 	if (reason != NULL)
-	    if ((*reason = cligen_reason("Number %s out of range: %" PRIu64 " - %" PRIu64, str, umin, umax)) == NULL){
-		retval = -1;
+	    if ((*reason = cligen_reason("Number %s out of range: 0 - %" PRIu64, tc->tc_str, umax)) == NULL)
 		goto done;
-	    }
 	retval = 0;
 	goto done;
     }
-    /* strtoull does _not_ detect negative numbers,... */
-    if (strchr(str, '-') != NULL){
+    if (tc->tc_uint > umax){
 	if (reason != NULL)
-	    if ((*reason = cligen_reason("Number %s out of range: 0 - %" PRIu64, str, umax)) == NULL){
-		retval = -1; /* malloc */
+	    if ((*reason = cligen_reason("Number %s out of range: %" PRIu64 " - %" PRIu64, tc->tc_str, umin, umax)) == NULL)
 		goto done;
-	    }
 	retval = 0;
 	goto done;
     }
-    *val = i;
+    *val = tc->tc_uint;
     retval = 1; /* OK */
   done:
     return retval;
 }
 
+/*! Parse an uint64 number and check for errors
+ * @param[in]  str     String containing number to parse
+ * @parame[in] base    If base is 0 or 16, the string may include a "0x" prefix,
+ *                     the number will be read in base 16; otherwise, a zero base
+ *                     is taken  as 10 (decimal) unless the next character is '0',
+ *                     in which case it is taken as 8 (octal).
+ * @param[in]  umin    Min range (set UINT64_MIN for default)    
+ * @param[in]  umax    Max range (set UINT64_MAX for default)
+ * @param[out] val     Value on success
+ * @param[out] reason  Error string on failure (if given)
+ * @retval -1 : Error (fatal), with errno set to indicate error
+ * @retval  0 : Validation not OK, malloced reason is returned
+ * @retval  1 : Validation OK, value returned in val parameter
+ * @note: we have to detect a minus sign ourselves,....
+ */
+static int
+parse_uint64_base(char     *str, 
+		  int       base,
+		  uint64_t  umin,
+		  uint64_t  umax, 
+		  uint64_t *val, 
+		  char    **reason)
+{
+    cv_token_class tc;
+
+    cv_token_class_init(&tc, str);
+    tc_scan_uint(&tc, base);
+    return parse_uint64_class(&tc, umin, umax, val, reason);
+}
+
 /*! Parse an uint8 number and check for errors
  * @param[in]  str     String containing number to parse
  * @param[out] val     Value on success
@@ -1590,6 +1706,57 @@ str2urlproto(char *str)
     return 0;
 }
 
+static const char cv_hexdigit[] = "0123456789abcdef";
+
+/*! Print bytes as pairs of hex digits separated by a character
+ * @param[out] s    String with room for 3*n bytes
+ * @param[in]  b    Bytes
+ * @param[in]  n    Number of bytes
+ * @param[in]  sep  Separator, eg ':', or 0 for none
+ * @retval     len  Number of bytes written, excluding null byte
+ */
+static int
+fmt_hex(char          *s,
+	const uint8_t *b,
+	int            n,
+	char           sep)
+{
+    int len = 0;
+    int i;
+
+    for (i=0; i<n; i++){
+	if (i && sep)
+	    s[len++] = sep;
+	s[len++] = cv_hexdigit[b[i]>>4];
+	s[len++] = cv_hexdigit[b[i]&0xf];
+    }
+    s[len] = '\0';
+    return len;
+}
+
+/*! Print a uuid on the form f47ac10b-58cc-4372-a567-0e02b2c3d479
+ * @param[out] s    String with room for 37 bytes
+ * @param[in]  u    UUID
+ * @retval     len  Number of bytes written, excluding null byte
+ */
+static int
+fmt_uuid(char         *s,
+	 const uint8_t *u)
+{
+    int len;
+
+    len = fmt_hex(s, u, 4, 0);
+    s[len++] = '-';
+    len += fmt_hex(s+len, u+4, 2, 0);
+    s[len++] = '-';
+    len += fmt_hex(s+len, u+6, 2, 0);
+    s[len++] = '-';
+    len += fmt_hex(s+len, u+8, 2, 0);
+    s[len++] = '-';
+    len += fmt_hex(s+len, u+10, 6, 0);
+    return len;
+}
+
 /*! Translate uuid binary data structure to uuid ascii string
  * @param[in]  u     UUID as binary data structure
  * @param[out] fmt   Format string. 
@@ -1602,13 +1769,15 @@ uuid2str(uuid_t u,
 	 char  *fmt, 
 	 int    len)
 {
-    snprintf(fmt, len, 
-	    "%02x%02x%02x%02x-"	"%02x%02x-"	"%02x%02x-"	"%02x%02x-"  
-	    "%02x%02x%02x%02x%02x%02x", 
-	    u[0]&0xff,	    u[1]&0xff,	    u[2]&0xff,	    u[3]&0xff,
-	    u[4]&0xff,	    u[5]&0xff,	    u[6]&0xff,	    u[7]&0xff,	    
-	    u[8]&0xff,	    u[9]&0xff,	    u[10]&0xff,	    u[11]&0xff,	    
-	    u[12]&0xff,	    u[13]&0xff,	    u[14]&0xff,	    u[15]&0xff);
+    char s[37];
+
+    if (len >= sizeof(s))
+	fmt_uuid(fmt, u);
+    else if (len > 0){ /* Truncate as snprintf */
+	fmt_uuid(s, u);
+	memcpy(fmt, s, len-1);
+	fmt[len-1] = '\0';
+    }
     return 0;
 }
 
@@ -2166,160 +2335,264 @@ cv_len(cg_var *cv)
     return len;
 }
 
-/*! Print a dec64 cv to a string 
- *
- * @param[in]     cv   A cligen variable of type CGV_DEC64 to print
- * @param[out]    s0   A string that will hold the dec64
- * @param[inout]  len  A string that holds available free space in s0
- * @retval        0    OK
- * @retval        -1   Error with error msg on stderr. 
+/*! Max length of a value formatted by cv_fmt, including null byte
+ * Longest is an IPv6 prefix: 45 bytes of address, "/255" and null
+ */
+#define CV_FMT_MAX 64
+
+/*! Print an unsigned integer as decimal digits to a string, and add a null byte
+ * @param[out] s    String with room for 21 bytes
+ * @param[in]  u    Number
+ * @param[in]  w    Minimum number of digits, pad with leading zeros
+ * @retval     len  Number of digits written, excluding null byte
+ */
+static int
+fmt_uint(char    *s,
+	 uint64_t u,
+	 int      w)
+{
+    char tmp[20];
+    int  n = 0;
+    int  i;
+
+    do {
+	tmp[n++] = '0' + u%10;
+	u /= 10;
+    } while (u);
+    while (n < w && n < sizeof(tmp))
+	tmp[n++] = '0';
+    for (i=0; i<n; i++)
+	s[i] = tmp[n-1-i];
+    s[n] = '\0';
+    return n;
+}
+
+/*! Print a signed integer as decimal digits to a string, and add a null byte
+ * @param[out] s    String with room for 21 bytes
+ * @param[in]  i    Number
+ * @retval     len  Number of bytes written, excluding null byte
  */
 static int
-cv_dec64_print(cg_var *cv, 
-	       char   *s0, 
-	       int    *s0len)
+fmt_int(char   *s,
+	int64_t i)
 {
-    int      i;
-    uint8_t  n = cv->var_dec64_n;;
-    int      len;
-    int64_t di;
+    if (i < 0){
+	*s = '-';
+	return 1 + fmt_uint(s+1, -(uint64_t)i, 0);
+    }
+    return fmt_uint(s, i, 0);
+}
+
+/*! Print a dec64 value to a string, eg 1.50 if i is 150 and n is 2
+ * @param[out] s    String with room for 23 bytes
+ * @param[in]  i    Dec64 integer part, see cv_dec64_i_get
+ * @param[in]  n    Fraction digits, see cv_dec64_n_get
+ * @retval     len  Number of bytes written, excluding null byte
+ */
+static int
+fmt_dec64(char   *s,
+	  int64_t i,
+	  uint8_t n)
+{
+    int len = 0;
+    int d;
 
     assert(0<n && n<19);
-    /* Convert negative numbers to positive and prepend a '-' at the end */
-    di = cv_dec64_i_get(cv);
-    if (di<0)
-	di = -di;
-    len = snprintf(s0, *s0len, "%0*" PRId64, n+1, di);
-    assert(len>=n);
-    *s0len -= len;
-    /* Shift fraction digits right, including null character. 
-     * eg:  xyz --> x.yz (if n==2) 
-     */
-    for (i=len; i>=len-n; i--) 
-	s0[i+1] = s0[i];
-    (*s0len)--;
-    s0[len-n] = '.';
-    /* prepend a '-' if the number is negative*/    
-    if (cv_dec64_i_get(cv)<0){ 
-	for (i=len+1; i>=0; i--)
-	    s0[i+1] = s0[i];
-	s0[0] = '-';
-	(*s0len)--;
+    if (i < 0)
+	s[len++] = '-';
+    d = fmt_uint(s+len, i<0 ? -(uint64_t)i : (uint64_t)i, n+1);
+    /* Shift fraction digits right, including null byte, eg: xyz --> x.yz (if n==2) */
+    memmove(s+len+d-n+1, s+len+d-n, n+1);
+    s[len+d-n] = '.';
+    return len + d + 1;
+}
+
+/*! Print an IPv4 address in dotted decimal notation, as inet_ntoa(3) without its static buffer
+ * @param[out] s    String with room for 16 bytes
+ * @param[in]  a    Address in network byte order
+ * @retval     len  Number of bytes written, excluding null byte
+ */
+static int
+fmt_ipv4(char          *s,
+	 const uint8_t *a)
+{
+    int len = 0;
+    int i;
+
+    for (i=0; i<4; i++){
+	if (i)
+	    s[len++] = '.';
+	len += fmt_uint(s+len, a[i], 0);
     }
-    return 0;
+    return len;
+}
+
+/*! Print an IPv6 address as inet_ntop(3)
+ * The longest run of two or more zero words is replaced by "::", and IPv4-compatible
+ * and IPv4-mapped addresses end in dotted decimal notation.
+ * @param[out] s    String with room for INET6_ADDRSTRLEN bytes
+ * @param[in]  a    Address in network byte order
+ * @retval     len  Number of bytes written, excluding null byte
+ */
+static int
+fmt_ipv6(char          *s,
+	 const uint8_t *a)
+{
+    uint16_t w[8];
+    int      base = -1;
+    int      blen = 0;
+    int      cur = -1;
+    int      clen = 0;
+    int      len = 0;
+    int      i;
+    int      k;
+
+    for (i=0; i<8; i++){
+	w[i] = (a[2*i]<<8) | a[2*i+1];
+	if (w[i] == 0){
+	    if (cur == -1){
+		cur = i;
+		clen = 0;
+	    }
+	    if (++clen > blen){
+		base = cur;
+		blen = clen;
+	    }
+	}
+	else
+	    cur = -1;
+    }
+    if (blen < 2)
+	base = -1;
+    for (i=0; i<8; i++){
+	if (base != -1 && i >= base && i < base + blen){
+	    if (i == base)
+		s[len++] = ':';
+	    continue;
+	}
+	if (i)
+	    s[len++] = ':';
+	if (i == 6 && base == 0 &&
+	    (blen == 6 || (blen == 5 && w[5] == 0xffff))){
+	    len += fmt_ipv4(s+len, a+12);
+	    return len;
+	}
+	for (k=12; k>0 && (w[i]>>k) == 0; k-=4);
+	for (; k>=0; k-=4)
+	    s[len++] = cv_hexdigit[(w[i]>>k) & 0xf];
+    }
+    if (base != -1 && base + blen == 8)
+	s[len++] = ':';
+    s[len] = '\0';
+    return len;
 }
 
-/*! Print value of CLIgen variable to CLIgen buf using printf style formats.
+/*! Print value of a CLIgen variable of fixed max size to a string, without printf
+ *
+ * Covers all types except strings, rest and urls, which have no max length.
  * @param[in]   cv   CLIgen variable
- * @param[out]  cb   Value printed 
- * The params shuld be switched cb<->cv
-*/
-int
-cv2cbuf(cg_var *cv,
-	cbuf   *cb)
+ * @param[out]  s    String with room for CV_FMT_MAX bytes
+ * @retval      len  Number of bytes written, excluding null byte
+ * @retval     -1    Type has no max length, s is not written
+ */
+static int
+cv_fmt(cg_var *cv,
+       char   *s)
 {
-    char straddr[INET6_ADDRSTRLEN];
-    char ss[64];
-    int  sslen = sizeof(ss);
-    char uuidstr[37];
-    char timestr[28];
+    int len;
 
     switch (cv->var_type){
     case CGV_INT8:
-	cprintf(cb, "%" PRId8, cv->var_int8);
-	break;
+	return fmt_int(s, cv->var_int8);
     case CGV_INT16:
-	cprintf(cb, "%" PRId16, cv->var_int16);
-	break;
+	return fmt_int(s, cv->var_int16);
     case CGV_INT32:
-	cprintf(cb, "%" PRId32, cv->var_int32);
-	break;
+	return fmt_int(s, cv->var_int32);
     case CGV_INT64:
-	cprintf(cb, "%" PRId64, cv->var_int64);
-	break;
+	return fmt_int(s, cv->var_int64);
     case CGV_UINT8:
-	cprintf(cb, "%" PRIu8, cv->var_uint8);
-	break;
+	return fmt_uint(s, cv->var_uint8, 0);
     case CGV_UINT16:
-	cprintf(cb, "%" PRIu16, cv->var_uint16);
-	break;
+	return fmt_uint(s, cv->var_uint16, 0);
     case CGV_UINT32:
-	cprintf(cb, "%" PRIu32, cv->var_uint32);
-	break;
+	return fmt_uint(s, cv->var_uint32, 0);
     case CGV_UINT64:
-	cprintf(cb, "%" PRIu64, cv->var_uint64);
-	break;
+	return fmt_uint(s, cv->var_uint64, 0);
     case CGV_DEC64:
-	cv_dec64_print(cv, ss, &sslen);
-	cprintf(cb, "%s", ss);
-	break;
+	return fmt_dec64(s, cv_dec64_i_get(cv), cv->var_dec64_n);
     case CGV_BOOL:
-	if (cv->var_bool)
-	    cprintf(cb, "true");
-	else
-	    cprintf(cb, "false");
-	break;
-    case CGV_REST:
-	cprintf(cb, "%s", cv->var_rest);
-	break;
-    case CGV_STRING: 
-	cprintf(cb, "%s", cv->var_string);
-	break;
-    case CGV_INTERFACE: 
-	cprintf(cb, "%s", cv->var_interface);
-	break;
+	if (cv->var_bool){
+	    memcpy(s, "true", 5);
+	    return 4;
+	}
+	memcpy(s, "false", 6);
+	return 5;
     case CGV_IPV4ADDR:
-	cprintf(cb, "%s", inet_ntoa(cv->var_ipv4addr));
-	break;
+	return fmt_ipv4(s, (uint8_t*)&cv->var_ipv4addr);
     case CGV_IPV4PFX:
-	cprintf(cb, "%s/%u", 
-		inet_ntoa (cv->var_ipv4addr),
-		cv->var_ipv4masklen);
-	break;
+	len = fmt_ipv4(s, (uint8_t*)&cv->var_ipv4addr);
+	s[len++] = '/';
+	return len + fmt_uint(s+len, cv->var_ipv4masklen, 0);
     case CGV_IPV6ADDR:
-	if (inet_ntop(AF_INET6, &cv->var_ipv6addr, straddr, sizeof(straddr)) < 0){
-	    fprintf(stderr, "inet_ntop: %s\n", strerror(errno));
-	    return -1;
-	}
-	cprintf(cb, "%s", straddr);
-	break;
+	return fmt_ipv6(s, (uint8_t*)&cv->var_ipv6addr);
     case CGV_IPV6PFX:
-	if (inet_ntop(AF_INET6, &cv->var_ipv6addr, straddr, sizeof(straddr)) < 0){
-	    fprintf(stderr, "inet_ntop: %s\n", strerror(errno));
-	    return -1;
-	}
-	cprintf(cb, "%s/%u", straddr, cv->var_ipv6masklen);
-	break;
+	len = fmt_ipv6(s, (uint8_t*)&cv->var_ipv6addr);
+	s[len++] = '/';
+	return len + fmt_uint(s+len, cv->var_ipv6masklen, 0);
     case CGV_MACADDR:
-	cprintf(cb, "%02x:%02x:%02x:%02x:%02x:%02x", 
-		(uint8_t)cv->var_macaddr[0],
-		(uint8_t)cv->var_macaddr[1],
-		(uint8_t)cv->var_macaddr[2],
-		(uint8_t)cv->var_macaddr[3],
-		(uint8_t)cv->var_macaddr[4],
-		(uint8_t)cv->var_macaddr[5]);
-	break;
-    case CGV_URL: /* <proto>://[<user>[:<passwd>]@]<addr>[/<path>] */
-	cprintf(cb, "%s://%s%s%s%s%s/%s", 	
-		cv->var_urlproto,
-		cv->var_urluser,
-		strlen(cv->var_urlpasswd)?":":"",
-		cv->var_urlpasswd,
-		strlen(cv->var_urluser)||strlen(cv->var_urlpasswd)?"@":"",
-		cv->var_urladdr,
-		cv->var_urlpath
-	    );
-	break;
+	return fmt_hex(s, (uint8_t*)cv->var_macaddr, 6, ':');
     case CGV_UUID:
-	uuid2str(cv->var_uuid, uuidstr, sizeof(uuidstr));
-	cprintf(cb, "%s", uuidstr);
-	break;
+	return fmt_uuid(s, cv->var_uuid);
     case CGV_TIME:
-	time2str(cv->var_time, timestr, sizeof(timestr));
-	cprintf(cb, "%s", timestr);
-	break;
+	if (time2str(cv->var_time, s, CV_FMT_MAX) < 0)
+	    return -1;
+	return strlen(s);
     case CGV_VOID: /* N/A */
-    case CGV_EMPTY: 
+    case CGV_EMPTY:
+	*s = '\0';
+	return 0;
+    default:
+	break;
+    }
+    return -1;
+}
+
+/*! Print value of CLIgen variable to CLIgen buf
+ * Values of fixed size are formatted without printf, see cv_fmt
+ * @param[in]   cv   CLIgen variable
+ * @param[out]  cb   Value printed 
+ * @retval      0    OK
+ * @retval     -1    Error
+ * The params shuld be switched cb<->cv
+ * @see cv2str
+*/
+int
+cv2cbuf(cg_var *cv,
+	cbuf   *cb)
+{
+    char s[CV_FMT_MAX];
+    int  len;
+
+    if ((len = cv_fmt(cv, s)) >= 0)
+	return cbuf_append_buf(cb, s, len);
+    switch (cv->var_type){
+    case CGV_REST:
+    case CGV_STRING: 
+    case CGV_INTERFACE: 
+	if (cv->var_string && cbuf_append_str(cb, cv->var_string) < 0)
+	    return -1;
+	break;
+    case CGV_URL: /* <proto>://[<user>[:<passwd>]@]<addr>[/<path>] */
+	if (cprintf(cb, "%s://%s%s%s%s%s/%s", 	
+		    cv->var_urlproto,
+		    cv->var_urluser,
+		    strlen(cv->var_urlpasswd)?":":"",
+		    cv->var_urlpasswd,
+		    strlen(cv->var_urluser)||strlen(cv->var_urlpasswd)?"@":"",
+		    cv->var_urladdr,
+		    cv->var_urlpath
+		) < 0)
+	    return -1;
 	break;
     default:
 	break;
@@ -2327,7 +2600,7 @@ cv2cbuf(cg_var *cv,
     return 0;
 }
 
-/*! Print value of CLIgen variable using printf style formats.
+/*! Print value of CLIgen variable to a string
  *
  * You can use str=NULL to get the expected length.
  * The number of (potentially if str=NULL) written bytes is returned.
@@ -2336,6 +2609,7 @@ cv2cbuf(cg_var *cv,
  * Typically used by external code when transforming cgv:s.
  * Note, for strings, the length returned is _excluding_ the null byte, but the length
  * in supplied in the argument list is _including_ the null byte.
+ * Values of fixed size are formatted without printf, see cv_fmt.
  * @param[in]   cv   CLIgen variable
  * @param[out]  str  Value printed in this string
  * @param[in]   size Length of 'str'
@@ -2348,120 +2622,45 @@ cv2str(cg_var *cv,
        char   *str, 
        size_t  size)
 {
-    int  len = 0;
-    char straddr[INET6_ADDRSTRLEN];
-    char ss[64];
-    int  sslen = sizeof(ss);
-    char uuidstr[37];
-    char timestr[28];
+    int    len = 0;
+    char   s[CV_FMT_MAX];
+    char  *s1 = s;
+    size_t n;
 
     if (cv == NULL) 
 	return 0;
-    switch (cv->var_type){
-    case CGV_INT8:
-	len = snprintf(str, size, "%" PRId8, cv->var_int8);
-	break;
-    case CGV_INT16:
-	len = snprintf(str, size, "%" PRId16, cv->var_int16);
-	break;
-    case CGV_INT32:
-	len = snprintf(str, size, "%" PRId32, cv->var_int32);
-	break;
-    case CGV_INT64:
-	len = snprintf(str, size, "%" PRId64, cv->var_int64);
-	break;
-    case CGV_UINT8:
-	len = snprintf(str, size, "%" PRIu8, cv->var_uint8);
-	break;
-    case CGV_UINT16:
-	len = snprintf(str, size, "%" PRIu16, cv->var_uint16);
-	break;
-    case CGV_UINT32:
-	len = snprintf(str, size, "%" PRIu32, cv->var_uint32);
-	break;
-    case CGV_UINT64:
-	len = snprintf(str, size, "%" PRIu64, cv->var_uint64);
-	break;
-    case CGV_DEC64:
-	cv_dec64_print(cv, ss, &sslen);
-	len = snprintf(str, size, "%s", ss);
-	break;
-    case CGV_BOOL:
-	if (cv->var_bool)
-	    len = snprintf(str, size, "true");
-	else
-	    len = snprintf(str, size, "false");
-	break;
-    case CGV_REST:
-	len = snprintf(str, size, "%s", cv->var_rest);
-	break;
-    case CGV_STRING: 
-	len = snprintf(str, size, "%s", cv->var_string);
-	break;
-    case CGV_INTERFACE: 
-	len = snprintf(str, size, "%s", cv->var_interface);
-	break;
-    case CGV_IPV4ADDR:
-	len = snprintf(str, size, "%s", inet_ntoa(cv->var_ipv4addr));
-	break;
-    case CGV_IPV4PFX:
-	len = snprintf(str, size, "%s/%u", 
-		       inet_ntoa (cv->var_ipv4addr),
-		       cv->var_ipv4masklen);
-	break;
-    case CGV_IPV6ADDR:
-	if (inet_ntop(AF_INET6, &cv->var_ipv6addr, straddr, sizeof(straddr)) < 0){
-	    fprintf(stderr, "inet_ntop: %s\n", strerror(errno));
-	    return -1;
-	}
-	len = snprintf(str, size, "%s", straddr);
-	break;
-    case CGV_IPV6PFX:
-	if (inet_ntop(AF_INET6, &cv->var_ipv6addr, straddr, sizeof(straddr)) < 0){
-	    fprintf(stderr, "inet_ntop: %s\n", strerror(errno));
-	    return -1;
+    if ((len = cv_fmt(cv, s)) < 0){
+	switch (cv->var_type){
+	case CGV_REST:
+	case CGV_STRING: 
+	case CGV_INTERFACE: 
+	    s1 = cv->var_string ? cv->var_string : "";
+	    len = strlen(s1);
+	    break;
+	case CGV_URL: /* <proto>://[<user>[:<passwd>]@]<addr>[/<path>] */
+	    return snprintf(str, size, "%s://%s%s%s%s%s/%s", 	
+			    cv->var_urlproto,
+			    cv->var_urluser,
+			    strlen(cv->var_urlpasswd)?":":"",
+			    cv->var_urlpasswd,
+			    strlen(cv->var_urluser)||strlen(cv->var_urlpasswd)?"@":"",
+			    cv->var_urladdr,
+			    cv->var_urlpath
+		);
+	default:
+	    return 0;
 	}
-	len = snprintf(str, size, "%s/%u", straddr, cv->var_ipv6masklen);
-	break;
-    case CGV_MACADDR:
-	len = snprintf(str, size, "%02x:%02x:%02x:%02x:%02x:%02x", 
-		       (uint8_t)cv->var_macaddr[0],
-		       (uint8_t)cv->var_macaddr[1],
-		       (uint8_t)cv->var_macaddr[2],
-		       (uint8_t)cv->var_macaddr[3],
-		       (uint8_t)cv->var_macaddr[4],
-		       (uint8_t)cv->var_macaddr[5]);
-
-	break;
-    case CGV_URL: /* <proto>://[<user>[:<passwd>]@]<addr>[/<path>] */
-	len = snprintf(str, size, "%s://%s%s%s%s%s/%s", 	
-		       cv->var_urlproto,
-		       cv->var_urluser,
-		       strlen(cv->var_urlpasswd)?":":"",
-		       cv->var_urlpasswd,
-		       strlen(cv->var_urluser)||strlen(cv->var_urlpasswd)?"@":"",
-		       cv->var_urladdr,
-		       cv->var_urlpath
-	    );
-	break;
-    case CGV_UUID:
-	uuid2str(cv->var_uuid, uuidstr, sizeof(uuidstr));
-	len = snprintf(str, size, "%s", uuidstr);
-	break;
-    case CGV_TIME:
-	time2str(cv->var_time, timestr, sizeof(timestr));
-	len = snprintf(str, size, "%s", timestr);
-	break;
-    case CGV_VOID: /* N/A */
-    case CGV_EMPTY:
-	break;
-    default:
-	break;
+    }
+    /* Copy as much as fits, as snprintf */
+    if (str != NULL && size > 0){
+	n = (size_t)len < size ? len : size - 1;
+	memcpy(str, s1, n);
+	str[n] = '\0';
     }
     return len;
 }
 
-/*! Print value of CLIgen variable using printf style formats into a new string
+/*! Print value of CLIgen variable into a new string
  *
  * @param[in]   cv  CLIgen variable
  * @retval      str Malloced string containing value. Should be freed after use.
@@ -2472,15 +2671,18 @@ cv2str_dup(cg_var *cv)
 {
     int   len;
     char *str;
+    char  s[CV_FMT_MAX];
 
     if (cv == NULL) 
 	return NULL;
-    if ((len = cv2str (cv, NULL, 0)) < 0)
+    /* Format once into s, the value is usually short */
+    if ((len = cv2str(cv, s, sizeof(s))) < 0)
 	return NULL;
     if ((str = (char *)malloc(len+1)) == NULL)
 	return NULL;
-    memset(str, '\0', len+1);
-    if ((cv2str(cv, str, len+1)) < 0){
+    if (len < sizeof(s))
+	memcpy(str, s, len+1);
+    else if ((cv2str(cv, str, len+1)) < 0){
 	free(str);
 	return NULL;
     }
@@ -2497,8 +2699,7 @@ cv_print(FILE   *f,
 {
     int  len = 0;
     char straddr[INET6_ADDRSTRLEN];
-    char ss[64];
-    int  sslen = sizeof(ss);
+    char ss[CV_FMT_MAX];
     char uuidstr[37];
     char timestr[28];
 
@@ -2528,8 +2729,8 @@ cv_print(FILE   *f,
 	fprintf(f, "%" PRIu64, cv->var_uint64);
 	break;
     case CGV_DEC64:
-	cv_dec64_print(cv, ss, &sslen);
-	fprintf(f, "%s", ss);
+	cv_fmt(cv, ss);
+	fputs(ss, f);
 	break;
     case CGV_BOOL:
 	if (cv->var_bool)
@@ -2766,6 +2967,85 @@ cv_min_set(cg_var *cv)
     return 0;
 }
 
+/*! Parse a classified token as an IPv4 address
+ * @param[in]  tc         Token class, scanned here if not already done
+ * @param[out] val        IPv4 binary address
+ * @param[out] reason     if given, malloced err string (retval=0), needs freeing
+ * @retval -1             fatal error
+ * @retval 0              parse error, reason in reason
+ * @retval 1              OK
+ * @see parse_ipv4addr
+ */
+static int
+parse_ipv4addr_class(cv_token_class *tc,
+		     struct in_addr *val, 
+		     char          **reason)
+{
+    if ((tc->tc_flags & CV_TC_IPV4) == 0){
+	cligen_stats_global_inc(_cligen_stats_cv_scan);
+	if ((tc->tc_ipv4 = inet_pton(AF_INET, tc->tc_str, &tc->tc_ipv4addr)) < 0)
+	    return -1;
+	tc->tc_flags |= CV_TC_IPV4;
+    }
+    if (tc->tc_ipv4 == 0)
+	return parse_ipv4addr(tc->tc_str, val, reason);
+    *val = tc->tc_ipv4addr;
+    return 1;
+}
+
+/*! Parse a classified token as an IPv6 address
+ * @param[in]  tc         Token class, scanned here if not already done
+ * @param[out] val        IPv6 binary address
+ * @param[out] reason     if given, malloced err string (retval=0), needs freeing
+ * @retval -1             fatal error
+ * @retval 0              parse error, reason in reason
+ * @retval 1              OK
+ * @see parse_ipv6addr
+ */
+static int
+parse_ipv6addr_class(cv_token_class  *tc,
+		     struct in6_addr *val, 
+		     char           **reason)
+{
+    if ((tc->tc_flags & CV_TC_IPV6) == 0){
+	cligen_stats_global_inc(_cligen_stats_cv_scan);
+	if ((tc->tc_ipv6 = inet_pton(AF_INET6, tc->tc_str, &tc->tc_ipv6addr)) < 0)
+	    return -1;
+	tc->tc_flags |= CV_TC_IPV6;
+    }
+    if (tc->tc_ipv6 == 0)
+	return parse_ipv6addr(tc->tc_str, val, reason);
+    *val = tc->tc_ipv6addr;
+    return 1;
+}
+
+/*! Parse a classified token as a MAC address
+ * The scan is made without reason, if it fails and a reason is asked for, the
+ * token is parsed again by parse_macaddr() to tell what is wrong.
+ * @param[in]  tc         Token class, scanned here if not already done
+ * @param[out] addr       MAC address
+ * @param[out] reason     if given, malloced err string (retval=0), needs freeing
+ * @retval -1             fatal error
+ * @retval 0              parse error, reason in reason
+ * @retval 1              OK
+ */
+static int
+parse_macaddr_class(cv_token_class *tc,
+		    char            addr[MACADDR_OCTETS], 
+		    char          **reason)
+{
+    if ((tc->tc_flags & CV_TC_MAC) == 0){
+	cligen_stats_global_inc(_cligen_stats_cv_scan);
+	if ((tc->tc_mac = parse_macaddr(tc->tc_str, tc->tc_macaddr, NULL)) < 0)
+	    return -1;
+	tc->tc_flags |= CV_TC_MAC;
+    }
+    if (tc->tc_mac == 0)
+	return parse_macaddr(tc->tc_str, addr, reason);
+    memcpy(addr, tc->tc_macaddr, MACADDR_OCTETS);
+    return 1;
+}
+
 /*! Parse cv from string. 
  *
  * This function expects an initialized cv as created by cv_new() or
@@ -2793,54 +3073,116 @@ cv_min_set(cg_var *cv)
  *    cv_free(cv);
  *  free(reason);
  * @endcode
+ * @see cv_parse1_class  when the same string is parsed as several types
  */
 int
 cv_parse1(char   *str0,
 	  cg_var *cv, 
 	  char  **reason)
 {
-    int    retval = -1;
-    char  *str;
-    char  *mask;
-    int    masklen = 0;
-    int    i, j;
+    return cv_parse1_class(str0, cv, NULL, reason);
+}
+
+/*! Parse cv from string reusing an earlier classification of the string
+ *
+ * As cv_parse1() but integer, address and MAC types are parsed from a token
+ * class that is shared between calls with the same string, so that the string
+ * is scanned once per class and not once per call. These types are parsed
+ * without allocating memory, unless a reason is returned.
+ * @param[in]  str0    Input string
+ * @param[in]  cv      cligen variable, as prepared by cv_reset()/cv_new()
+ * @param[in]  tc      Token class of str0 initialized by cv_token_class_init(), or NULL
+ * @param[out] reason  If given, and if return value is 0, contains a malloced string
+ *                     describing the reason why the validation failed. If given must be NULL.
+ * @retval -1  Error (fatal), with errno set to indicate error
+ * @retval 0   Validation not OK, malloced reason is returned
+ * @retval 1   Validation OK
+ * @code
+ *  cv_token_class tc;
+ *
+ *  cv_token_class_init(&tc, str);
+ *  if (cv_parse1_class(str, cv1, &tc, NULL) == 0 &&
+ *      cv_parse1_class(str, cv2, &tc, &reason) == 0)
+ *    ...
+ * @endcode
+ */
+int
+cv_parse1_class(char           *str0,
+		cg_var         *cv, 
+		cv_token_class *tc,
+		char          **reason)
+{
+    int            retval = -1;
+    char          *str = NULL;
+    char          *mask;
+    int            masklen = 0;
+    int            i, j;
+    int64_t        i64;
+    uint64_t       u64;
+    cv_token_class tc0;
 
     if (reason && (*reason != NULL)){
 	fprintf(stderr, "reason must be NULL on calling\n");
 	return -1;
     }
-    if (str0 == NULL){
-	if ((str = strdup("")) == NULL)
-	    goto done;
+    if (str0 == NULL)
+	str0 = "";
+    if (tc == NULL){
+	cv_token_class_init(&tc0, str0);
+	tc = &tc0;
     }
-    else
-	if ((str = strdup(str0)) == NULL)
-	goto done;
+    if (tc->tc_str == NULL)
+	tc->tc_str = str0;
+    assert(tc->tc_str == str0);
+    /* Fast path: types parsed from the token class without a copy of str0 */
     switch (cv->var_type) {
     case CGV_INT8:
-	retval = parse_int8(str, &cv->var_int8, reason);
-	break;
+	if ((retval = parse_int64_class(tc, INT8_MIN, INT8_MAX, &i64, reason)) == 1)
+	    cv->var_int8 = (int8_t)i64;
+	goto done;
     case CGV_INT16:
-	retval = parse_int16(str, &cv->var_int16, reason);
-	break;
+	if ((retval = parse_int64_class(tc, INT16_MIN, INT16_MAX, &i64, reason)) == 1)
+	    cv->var_int16 = (int16_t)i64;
+	goto done;
     case CGV_INT32:
-	retval = parse_int32(str, &cv->var_int32, reason);
-	break;
+	if ((retval = parse_int64_class(tc, INT_MIN, INT_MAX, &i64, reason)) == 1)
+	    cv->var_int32 = (int32_t)i64;
+	goto done;
     case CGV_INT64:
-	retval = parse_int64(str, &cv->var_int64, reason);
-	break;
+	retval = parse_int64_class(tc, INT64_MIN, INT64_MAX, &cv->var_int64, reason);
+	goto done;
     case CGV_UINT8:
-	retval = parse_uint8(str, &cv->var_uint8, reason);
-	break;
+	if ((retval = parse_uint64_class(tc, 0, UINT8_MAX, &u64, reason)) == 1)
+	    cv->var_uint8 = (uint8_t)u64;
+	goto done;
     case CGV_UINT16:
-	retval = parse_uint16(str, &cv->var_uint16, reason);
-	break;
+	if ((retval = parse_uint64_class(tc, 0, UINT16_MAX, &u64, reason)) == 1)
+	    cv->var_uint16 = (uint16_t)u64;
+	goto done;
     case CGV_UINT32:
-	retval = parse_uint32(str, &cv->var_uint32, reason);
-	break;
+	if ((retval = parse_uint64_class(tc, 0, UINT_MAX, &u64, reason)) == 1)
+	    cv->var_uint32 = (uint32_t)u64;
+	goto done;
     case CGV_UINT64:
-	retval = parse_uint64(str, &cv->var_uint64, reason);
+	retval = parse_uint64_class(tc, 0, UINT64_MAX, &cv->var_uint64, reason);
+	goto done;
+    case CGV_IPV4ADDR: 
+	cv->var_ipv4masklen = 32;
+	retval = parse_ipv4addr_class(tc, &cv->var_ipv4addr, reason);
+	goto done;
+    case CGV_IPV6ADDR:
+	cv->var_ipv6masklen = 128;
+	retval = parse_ipv6addr_class(tc, &cv->var_ipv6addr, reason);
+	goto done;
+    case CGV_MACADDR:
+	retval = parse_macaddr_class(tc, cv->var_macaddr, reason);
+	goto done;
+    default:
 	break;
+    }
+    if ((str = strdup(str0)) == NULL)
+	goto done;
+    switch (cv->var_type) {
     case CGV_DEC64:
 	retval = parse_dec64(str, cv_dec64_n_get(cv), &cv->var_dec64_i, reason);
 	break;
@@ -2854,8 +3196,7 @@ cv_parse1(char   *str0,
 		str[j++] = str[i];
 	for (;j<strlen(str);j++)
 	    str[j] = '\0';
-	if (cv->var_rest)
-	    free(cv->var_rest);
+	cv_string_free(cv);
 	if ((cv->var_rest = strdup(str)) == NULL)
 	    goto done;
 	retval = 1;
@@ -2867,29 +3208,17 @@ cv_parse1(char   *str0,
 		str[j++] = str[i];
 	for (;j<strlen(str);j++)
 	    str[j] = '\0';
-	if (cv->var_string){
-	    free(cv->var_string);
-	    cv->var_string = NULL;
-	}
+	cv_string_free(cv);
 	if ((cv->var_string = strdup(str)) == NULL)
 	    goto done;
 	retval = 1;
 	break;
     case CGV_INTERFACE:
-	if (cv->var_interface)
-	    free(cv->var_interface);
+	cv_string_free(cv);
 	if ((cv->var_interface = strdup(str)) == NULL)
 	    goto done;
 	retval = 1;
 	break;
-    case CGV_IPV4ADDR: 
-	cv->var_ipv4masklen = 32;
-	retval = parse_ipv4addr(str, &cv->var_ipv4addr, reason);
-	break;
-    case CGV_IPV6ADDR:
-	cv->var_ipv6masklen = 128;
-	retval = parse_ipv6addr(str, &cv->var_ipv6addr, reason);
-	break;
     case CGV_IPV4PFX:
 	if ((mask = strchr (str, '/')) == NULL){
 	    retval = 0;
@@ -2932,9 +3261,6 @@ cv_parse1(char   *str0,
 	cv->var_ipv6masklen = masklen;
 	retval = parse_ipv6addr(str, &cv->var_ipv6addr, reason);
 	break;
-    case CGV_MACADDR:
-	retval = parse_macaddr(str, cv->var_macaddr, reason);
-	break;
     case CGV_URL: 
 	retval = parse_url(str, cv, reason);
 	break;
@@ -2965,6 +3291,8 @@ cv_parse1(char   *str0,
 	if (reason) 
 	    *reason = cligen_reason("Invalid variable");
 	break;
+    default: /* Parsed from token class above */
+	break;
     } /* switch */
   done:
     if (str)
@@ -3024,9 +3352,148 @@ cv_parse(char   *str,
  * @retval    1      i is in [low,upper]
  * @note need to use macro trick ## to fix different types
 */
-#define range_check(i, cvlow, cvupp, type)       \
-    (((i) >= cv_##type##_get(cvlow)) && \
-     ((i) <= cv_##type##_get(cvupp)))
+/*! One interval of a compiled range table, bounds are range keys */
+struct cv_range {
+    uint64_t r_low;
+    uint64_t r_upp;
+};
+
+/*! Compiled range table of a varspec
+ * The intervals of cgs_rangecvv_low/cgs_rangecvv_upp as native values in one
+ * allocation, sorted on lower bound and merged so that they do not overlap.
+ * @see range_compile
+ */
+struct cv_range_table {
+    int             rt_len;   /* Number of merged intervals */
+    struct cv_range rt_vec[]; /* Intervals sorted on r_low */
+};
+
+/*! Order-preserving unsigned key of an integer, decimal64 or length cv
+ * Signed values are offset so that they compare as unsigned. An empty cv, ie a
+ * range lower bound without value, is the min value of the type.
+ * @param[in]  cv   Value or range bound
+ * @retval     key  Range key
+ */
+static uint64_t
+range_key(cg_var *cv)
+{
+    int64_t  i;
+
+    switch (cv->var_type){
+    case CGV_INT8:
+	i = cv->var_int8;
+	break;
+    case CGV_INT16:
+	i = cv->var_int16;
+	break;
+    case CGV_INT32:
+	i = cv->var_int32;
+	break;
+    case CGV_INT64:
+	i = cv->var_int64;
+	break;
+    case CGV_DEC64:
+	i = cv->var_dec64_i;
+	break;
+    case CGV_UINT8:
+	return cv->var_uint8;
+    case CGV_UINT16:
+	return cv->var_uint16;
+    case CGV_UINT32:
+	return cv->var_uint32;
+    case CGV_UINT64:
+	return cv->var_uint64;
+    default: /* CGV_EMPTY */
+	return 0;
+    }
+    return (uint64_t)i ^ ((uint64_t)1 << 63);
+}
+
+/*! Sort intervals on lower bound */
+static int
+range_cmp(const void *a,
+	  const void *b)
+{
+    const struct cv_range *r1 = a;
+    const struct cv_range *r2 = b;
+
+    if (r1->r_low < r2->r_low)
+	return -1;
+    return r1->r_low > r2->r_low;
+}
+
+/*! Compile the range intervals of a varspec into a sorted and merged table
+ * Empty intervals (lower bound above upper bound) are removed, overlapping and
+ * adjacent intervals are merged.
+ * @param[in]  cs   Varspec with cgs_rangelen intervals
+ * @retval     rt   Range table, free with free()
+ * @retval     NULL Error
+ */
+static struct cv_range_table *
+range_compile(cg_varspec *cs)
+{
+    struct cv_range_table *rt;
+    struct cv_range       *r;
+    int                    n = 0;
+    int                    j;
+
+    if ((rt = malloc(sizeof(*rt) + cs->cgs_rangelen*sizeof(struct cv_range))) == NULL)
+	return NULL;
+    for (j=0; j<cs->cgs_rangelen; j++){
+	r = &rt->rt_vec[n];
+	r->r_low = range_key(cvec_i(cs->cgs_rangecvv_low, j));
+	r->r_upp = range_key(cvec_i(cs->cgs_rangecvv_upp, j));
+	if (r->r_low <= r->r_upp)
+	    n++;
+    }
+    qsort(rt->rt_vec, n, sizeof(struct cv_range), range_cmp);
+    rt->rt_len = 0;
+    r = NULL; /* Last merged interval */
+    for (j=0; j<n; j++){
+	if (r != NULL &&
+	    (r->r_upp == UINT64_MAX || rt->rt_vec[j].r_low <= r->r_upp + 1)){
+	    if (rt->rt_vec[j].r_upp > r->r_upp)
+		r->r_upp = rt->rt_vec[j].r_upp;
+	}
+	else{
+	    r = &rt->rt_vec[rt->rt_len++];
+	    *r = rt->rt_vec[j];
+	}
+    }
+    return rt;
+}
+
+/*! Check if a range key is within the ranges of a varspec
+ * The range table is compiled on first use and kept in the varspec
+ * @param[in]  cs   Varspec with cgs_rangelen intervals
+ * @param[in]  key  Range key of value, see range_key
+ * @retval    -1    Error
+ * @retval     0    Out of range
+ * @retval     1    In range
+ */
+static int
+range_table_check(cg_varspec *cs,
+		  uint64_t    key)
+{
+    struct cv_range_table *rt;
+    int                    lo = 0;
+    int                    hi;
+    int                    mid;
+
+    if ((rt = cs->cgs_rangetab) == NULL &&
+	(rt = cs->cgs_rangetab = range_compile(cs)) == NULL)
+	return -1;
+    /* Find last interval with lower bound <= key */
+    hi = rt->rt_len;
+    while (lo < hi){
+	mid = (lo + hi)/2;
+	if (rt->rt_vec[mid].r_low <= key)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo > 0 && key <= rt->rt_vec[lo-1].r_upp;
+}
 
 /*! Error messsage for int violating ranges */
 static int
@@ -3040,6 +3507,10 @@ outofrange(cg_var     *cv0,
     cg_var *cv2;
     int     i;
 
+    if (reason == NULL){ /* Only format reason if it is asked for */
+	retval = 0;
+	goto done;
+    }
     if ((cb = cbuf_new()) == NULL)
 	goto done;
     cprintf(cb, "Number ");
@@ -3075,6 +3546,10 @@ outoflength(uint64_t    u64,
     cg_var *cv2;
     int     i;
 
+    if (reason == NULL){ /* Only format reason if it is asked for */
+	retval = 0;
+	goto done;
+    }
     if ((cb = cbuf_new()) == NULL)
 	goto done;
     cprintf(cb, "String length %" PRIu64 " out of range: ", u64);
@@ -3116,146 +3591,25 @@ cv_validate(cligen_handle h,
 	    char        **reason)
 {
     int      retval = 1; /* OK */
-    int32_t  i = 0;
-    uint32_t u = 0;
-    int64_t  i64;
     uint64_t u64;
     char    *str;
     int      ok;
-    int      j;
     cg_var  *cv1;
-    cg_var  *cv2;
     
     switch (cs->cgs_vtype){
     case CGV_INT8:
-	if (!cs->cgs_rangelen)
-	    break;
-	i = cv_int8_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(i, cv1, cv2, int8)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_INT16:
-	if (!cs->cgs_rangelen)
-	    break;
-	i = cv_int16_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(i, cv1, cv2, int16)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_INT32:
-	if (!cs->cgs_rangelen)
-	    break;
-	i = cv_int32_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(i, cv1, cv2, int32)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_INT64:
-	if (!cs->cgs_rangelen)
-	    break;
-	i64 = cv_int64_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(i64, cv1, cv2, int64)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_UINT8:
-	if (!cs->cgs_rangelen)
-	    break;
-	u = cv_uint8_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(u, cv1, cv2, uint8)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_UINT16:
-	if (!cs->cgs_rangelen)
-	    break;
-	u = cv_uint16_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(u, cv1, cv2, uint16)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_UINT32:
-	if (!cs->cgs_rangelen)
-	    break;
-	u = cv_uint32_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(u, cv1, cv2, uint32)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_UINT64:
 	if (!cs->cgs_rangelen)
 	    break;
-	u64 = cv_uint64_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(u64, cv1, cv2, uint64)) != 0)
-		break;
+	if ((ok = range_table_check(cs, range_key(cv))) < 0){
+	    retval = -1;
+	    goto done;
 	}
 	if (!ok){
 	    if (outofrange(cv, cs, reason) < 0)
@@ -3272,13 +3626,9 @@ cv_validate(cligen_handle h,
 	}
 	if (!cs->cgs_rangelen)
 	    break;
-	i64 = cv_int64_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(i64, cv1, cv2, int64)) != 0)
-		break;
+	if ((ok = range_table_check(cs, range_key(cv))) < 0){
+	    retval = -1;
+	    goto done;
 	}
 	if (!ok){
 	    if (reason){
@@ -3313,12 +3663,9 @@ cv_validate(cligen_handle h,
 	if (!cs->cgs_rangelen)	/* Skip range check */
 	    break;
 	u64 = strlen(str); /* size_t */
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(u64, cv1, cv2, uint64)) != 0)
-		break;
+	if ((ok = range_table_check(cs, u64)) < 0){
+	    retval = -1;
+	    goto done;
 	}
 	if (!ok){
 	    if (outoflength(u64, cs, reason) < 0)
@@ -3457,12 +3804,9 @@ cv_cp(cg_var *new,
     int retval = -1;
 
     memcpy(new, old, sizeof(*old)); 
-    if (old->var_name)
-	if ((new->var_name = strdup(old->var_name)) == NULL)
-	    goto done;
-    if (old->var_show)
-	if ((new->var_show = strdup(old->var_show)) == NULL)
-	    goto done;
+    new->var_name = cligen_intern_dup(old->var_name);
+    new->var_indexed = 0; /* Not in an indexed cvec until added to one */
+    new->var_show = cligen_intern_dup(old->var_show);
     switch (new->var_type) {
     case CGV_ERR:
 	break;
@@ -3480,7 +3824,9 @@ cv_cp(cg_var *new,
     case CGV_REST:
     case CGV_STRING:	
     case CGV_INTERFACE:  /* All strings have the same address */
-	if (old->var_string)
+	if (old->var_intern)
+	    new->var_string = cligen_intern_dup(old->var_string);
+	else if (old->var_string)
 	    if ((new->var_string = strdup(old->var_string)) == NULL) 
 		goto done;
 	break;
@@ -3574,16 +3920,13 @@ cv_reset(cg_var *cv)
 {
     enum cv_type type = cv->var_type;
 
-    if (cv->var_name)
-	free(cv->var_name);
-    if (cv->var_show)
-	free(cv->var_show);
+    cligen_intern_free(cv->var_name);
+    cligen_intern_free(cv->var_show);
     switch (cv->var_type) {
     case CGV_REST:
     case CGV_STRING:
     case CGV_INTERFACE:
-	if (cv->var_string)
-	    free(cv->var_string);	/* All strings have the same address */
+	cv_string_free(cv);	/* All strings have the same address */
 	break;
     case CGV_URL:
 	if (cv->var_urlproto)
@@ -3624,6 +3967,19 @@ cv_free(cg_var *cv)
     return 0;
 }
 
+/*! Return the alloced memory of the compiled range table of a variable spec
+ * @param[in]  cs   Variable spec
+ * @retval     sz   Bytes allocated, 0 if the ranges are not compiled
+ * @see cv_validate  where the table is compiled on first use
+ */
+size_t
+cv_rangetab_size(struct cg_varspec *cs)
+{
+    if (cs->cgs_rangetab == NULL)
+	return 0;
+    return sizeof(struct cv_range_table) + cs->cgs_rangelen*sizeof(struct cv_range);
+}
+
 /*! Return the alloced memory of a CLIgen variable
  */
 size_t
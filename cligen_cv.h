@@ -165,6 +165,7 @@ int64_t cv_dec64_i_set(cg_var *cv, int64_t x);
 char   *cv_string_get(cg_var *cv);
 char   *cv_string_set(cg_var *cv, char *s0);
 char   *cv_strncpy(cg_var *cv, char *s0, size_t n);
+int     cv_string_intern(cg_var *cv);
 struct in_addr *cv_ipv4addr_get(cg_var *cv);
 struct in_addr *cv_ipv4addr_set(cg_var *cv, struct in_addr *addr);
 uint8_t cv_ipv4masklen_get(cg_var *cv);
@@ -233,6 +234,7 @@ int     cv_free(cg_var *cv);   /* free cgv itself */
 cg_var *cv_new(enum cv_type type);
 
 size_t  cv_size(cg_var *cv);
+size_t  cv_rangetab_size(struct cg_varspec *cs);
 
 #endif /* _CLIGEN_CV_H_ */
 
@@ -57,10 +57,12 @@
  */
 struct cg_var {
     enum cv_type var_type;  /* Type of variable appears in <name:type ...> */
-    char        *var_name;  /* Name of variable appears in <name:type ...> */
-    char        *var_show;  /* Show help-text, same as name or <name..show:<show>> */
+    char        *var_name;  /* Name of variable appears in <name:type ...> (interned) */
+    char        *var_show;  /* Show help-text, same as name or <name..show:<show>> (interned) */
     char         var_const; /* Set if the variable is a keyword */
     char         var_flag ; /* Application-specific flags, no semantics by cligen */
+    char         var_intern; /* Set if the string value is interned, see cv_string_intern */
+    char         var_indexed; /* Set if in a cvec with a name index, see cvec_find */
     union {
 	uint8_t	 varu_bool;
 	int8_t	 varu_int8;
@@ -130,4 +132,49 @@ struct cg_var {
 #define var_urluser	u.varu_url.varurl_user
 #define var_urlpasswd	u.varu_url.varurl_passwd
 
+/* Scans made on a cv_token_class, see tc_flags */
+#define CV_TC_INT	0x01	/* Signed integer scan */
+#define CV_TC_UINT	0x02	/* Unsigned integer scan */
+#define CV_TC_IPV4	0x04	/* IPv4 address scan */
+#define CV_TC_IPV6	0x08	/* IPv6 address scan */
+#define CV_TC_MAC	0x10	/* MAC address scan */
+
+/*! Lexical classification of one input token
+ * A token is scanned at most once per class (integer, address,...) and the 
+ * result is reused when the same token is parsed by cv_parse1_class() for the
+ * other variables of a parse-tree level. Reason strings are formatted from the
+ * scan result only when asked for.
+ * @see cv_token_class_init
+ */
+struct cv_token_class {
+    char           *tc_str;      /* Token, not copied */
+    int             tc_flags;    /* Scans made, CV_TC_* */
+    int             tc_inum;     /* Whole token is a signed number */
+    int             tc_ierrno;   /* errno of signed scan */
+    int64_t         tc_int;      /* Signed value */
+    int             tc_unum;     /* Whole token is an unsigned number */
+    int             tc_uerrno;   /* errno of unsigned scan */
+    int             tc_minus;    /* Token has a minus sign */
+    uint64_t        tc_uint;     /* Unsigned value */
+    int             tc_ipv4;     /* 1 if valid IPv4 address */
+    struct in_addr  tc_ipv4addr;
+    int             tc_ipv6;     /* 1 if valid IPv6 address */
+    struct in6_addr tc_ipv6addr;
+    int             tc_mac;      /* 1 if valid MAC address */
+    char            tc_macaddr[6];
+};
+typedef struct cv_token_class cv_token_class;
+
+/*
+ * Variables
+ */
+/* Incremented when a cv in a cvec with a name index is renamed, see cvec_find */
+extern uint64_t _cligen_cv_name_gen;
+
+/*
+ * Prototypes
+ */
+void cv_token_class_init(cv_token_class *tc, char *str);
+int  cv_parse1_class(char *str, cg_var *cv, cv_token_class *tc, char **reason);
+
 #endif /* _CLIGEN_CV_INTERNAL_H_ */
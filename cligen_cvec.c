@@ -60,6 +60,7 @@
 
 #include "cligen_cv_internal.h"
 #include "cligen_cvec_internal.h"
+#include "cligen_stats_internal.h"
 
 /*! A malloc version that aligns on 4 bytes. To avoid warning from valgrind */
 #define align4(s) (((s)/4)*4 + 4)
@@ -84,6 +85,32 @@ static inline char * strdup4(char *str)
  */
 static int excludekeys = 0;
 
+/*! Name index of a cvec, an open addressing hash table of positions in vr_vec
+ * Entries with the same name are found in vector order, since they are inserted
+ * in that order along the same probe sequence.
+ * @see cvec_find
+ */
+struct cvec_index {
+    uint64_t ci_gen;    /* _cligen_cv_name_gen when built, not checked if frozen */
+    int      ci_size;   /* Number of slots, a power of 2 */
+    int      ci_vec[];  /* Position in vr_vec + 1, or 0 if slot is empty */
+};
+
+/*! Free the name index of a cvec, called when cv:s are added or deleted
+ */
+static inline void
+cvec_index_free(cvec *cvv)
+{
+    int i;
+
+    if (cvv->vr_index){
+	free(cvv->vr_index);
+	cvv->vr_index = NULL;
+	for (i=0; i<cvv->vr_len; i++)
+	    cvv->vr_vec[i].var_indexed = 0;
+    }
+}
+
 /*! Create and initialize a new cligen variable vector (cvec)
  *
  * Each individual cv initialized with CGV_ERR and no value.
@@ -101,6 +128,7 @@ cvec_new(int len)
 
     if ((cvv = malloc(sizeof(*cvv))) == NULL)
 	return NULL;
+    cligen_stats_global_inc(_cligen_stats_cvec_new);
     memset(cvv, 0, sizeof(*cvv));
     if (cvec_init(cvv, len) < 0){
 	free(cvv);
@@ -146,6 +174,43 @@ cvec_free(cvec *cvv)
     return 0;
 }
 
+/*! Ensure that the vector of a cvec has room for at least size elements
+ * The first CVEC_INLINE_LEN elements are stored in the cvec itself, after that
+ * the vector is allocated and grows geometrically. The vector is never shrunk.
+ * @param[in] cvv   Cligen variable vector
+ * @param[in] size  Minimum number of elements
+ * @retval    0     OK
+ * @retval   -1     Error
+ */
+static int
+cvec_grow(cvec *cvv,
+	  int   size)
+{
+    int     newsize;
+    cg_var *vec;
+
+    if (size <= cvv->vr_size)
+	return 0;
+    if (size <= CVEC_INLINE_LEN && cvv->vr_size == 0){
+	cvv->vr_vec = cvv->vr_inline;
+	cvv->vr_size = CVEC_INLINE_LEN;
+	return 0;
+    }
+    newsize = cvv->vr_size ? cvv->vr_size : CVEC_INLINE_LEN;
+    while (newsize < size)
+	newsize *= 2;
+    if (cvv->vr_vec == cvv->vr_inline){
+	if ((vec = malloc(newsize*sizeof(cg_var))) == NULL)
+	    return -1;
+	memcpy(vec, cvv->vr_inline, cvv->vr_len*sizeof(cg_var));
+    }
+    else if ((vec = realloc(cvv->vr_vec, newsize*sizeof(cg_var))) == NULL)
+	return -1;
+    cvv->vr_vec = vec;
+    cvv->vr_size = newsize;
+    return 0;
+}
+
 /*! Initialize a cligen variable vector (cvec) with 'len' numbers of variables.
  *
  * Each individual cv initialized with CGV_ERR and no value.
@@ -158,12 +223,35 @@ int
 cvec_init(cvec *cvv,
 	  int   len)
 {
-    cvv->vr_len = len;
-    if (len && (cvv->vr_vec = calloc(cvv->vr_len, sizeof(cg_var))) == NULL)
+    if (cvec_grow(cvv, len) < 0)
 	return -1;
+    cvec_index_free(cvv);
+    cvv->vr_len = len;
+    if (len)
+	memset(cvv->vr_vec, 0, len*sizeof(cg_var));
     return 0;
 }
 
+/*! Reserve space in a cligen variable vector for at least size elements
+ *
+ * Avoids re-allocation when a known number of elements are added with cvec_add.
+ * Pointers to elements are stable as long as the length does not exceed this size.
+ * @param[in] cvv   Cligen variable vector
+ * @param[in] size  Number of cv elements
+ * @retval    0     OK
+ * @retval   -1     Error
+ */
+int
+cvec_reserve(cvec *cvv,
+	     int   size)
+{
+    if (cvv == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    return cvec_grow(cvv, size);
+}
+
 /*! Reset cligen variable vector resetting it to an initial state as returned by cvec_new
  *
  * @param[in]  cvv   Cligen variable vector
@@ -178,9 +266,10 @@ cvec_reset(cvec *cvv)
 	return 0;
     }
 
+    cvec_index_free(cvv);
     while ((cv = cvec_each(cvv, cv)) != NULL)
 	cv_reset(cv);
-    if (cvv->vr_vec)
+    if (cvv->vr_vec && cvv->vr_vec != cvv->vr_inline)
 	free(cvv->vr_vec);
     if (cvv->vr_name)
 	free(cvv->vr_name);
@@ -206,8 +295,10 @@ cvec_next(cvec   *cvv,
 	    return 0;
     }
 
-    if (cv0 == NULL)
-	cv = cvv->vr_vec;
+    if (cv0 == NULL){
+	if (cvv->vr_len > 0)
+	    cv = cvv->vr_vec;
+    }
     else {
 	i = cv0 - cvv->vr_vec;
 	if (i < cvv->vr_len-1)
@@ -237,8 +328,9 @@ cvec_add(cvec        *cvv,
     }
     len = cvv->vr_len + 1;
 
-    if ((cvv->vr_vec = realloc(cvv->vr_vec, len*sizeof(cg_var))) == NULL)
+    if (cvec_grow(cvv, len) < 0)
 	return NULL;
+    cvec_index_free(cvv);
     cvv->vr_len = len;
     cv = cvec_i(cvv, len-1);
     memset(cv, 0, sizeof(*cv));
@@ -302,7 +394,7 @@ cvec_del(cvec   *cvv,
 		(cvv->vr_len-i-1) * sizeof(cvv->vr_vec[0]));
 
     cvv->vr_len--;
-    cvv->vr_vec = realloc(cvv->vr_vec, cvv->vr_len*sizeof(cvv->vr_vec[0])); /* Shrink should not fail? */
+    cvec_index_free(cvv);
 
     return cvec_len(cvv);
 }
@@ -330,6 +422,7 @@ cvec_del_i(cvec *cvv,
 		(cvv->vr_len-i-1) * sizeof(cvv->vr_vec[0]));
 
     cvv->vr_len--;
+    cvec_index_free(cvv);
 
     return cvec_len(cvv);
 }
@@ -520,8 +613,13 @@ cvec_print(FILE *f,
 }
 
 /*! Pretty print cligen variable list to a cligen buffer
+ *
+ * Space for the whole vector is reserved once, and values are printed directly into
+ * the buffer with cv2cbuf
  * @param[out] cb   Cligen buffer (should already be initialized w cbuf_new)
  * @param[in]  cvv  Cligen variable vector to print
+ * @retval     0    OK
+ * @retval    -1    Error
  * @see cvec_print
  */
 int
@@ -530,21 +628,135 @@ cvec2cbuf(cbuf *cb,
 {
     cg_var *cv = NULL;
     int     i = 0;
-    char   *s;
+    char   *name;
+    size_t  len = 0;
 
+    /* Estimate: index and separators, name, and value. Fixed size values are
+     * assumed to fit in 32 bytes, if not the buffer grows as usual */
     while ((cv = cvec_each(cvv, cv)) != NULL) {
-	if ((s = cv2str_dup(cv)) == NULL)
+	name = cv_name_get(cv);
+	len += 16 + (name ? strlen(name) : 6) + cv_len(cv) + 32;
+    }
+    if (cbuf_reserve(cb, len) < 0)
+	return -1;
+    while ((cv = cvec_each(cvv, cv)) != NULL) {
+	if (cprintf(cb, "%d : %s = ", i++, (name = cv_name_get(cv)) ? name : "(null)") < 0)
+	    return -1;
+	if (cv2cbuf(cv, cb) < 0)
+	    return -1;
+	if (cbuf_append(cb, '\n') < 0)
 	    return -1;
-	cprintf(cb, "%d : %s = %s\n", i++, cv_name_get(cv), s);
-	free(s);
     }
     return 0;
 }
 
+/* cvec_index_find modes */
+#define CVEC_FIND_ANY     0 /* Any cv */
+#define CVEC_FIND_KEYWORD 1 /* Keyword (constant) cv:s */
+#define CVEC_FIND_VAR     2 /* Non-keyword cv:s */
+
+/*! FNV-1a hash of a name
+ */
+static inline uint32_t
+cvec_index_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+
+    while (*name){
+	h ^= (uint8_t)*name++;
+	h *= 16777619u;
+    }
+    return h;
+}
+
+/*! Build the name index of a cvec
+ * @param[in]  cvv   Cligen variable vector
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+cvec_index_build(cvec *cvv)
+{
+    struct cvec_index *ci;
+    int                size = 2*CVEC_INDEX_MIN;
+    int                i;
+    int                j;
+
+    cvec_index_free(cvv);
+    while (size < 2*cvv->vr_len)
+	size *= 2;
+    if ((ci = calloc(1, sizeof(*ci) + size*sizeof(int))) == NULL)
+	return -1;
+    ci->ci_gen = __atomic_load_n(&_cligen_cv_name_gen, __ATOMIC_RELAXED);
+    ci->ci_size = size;
+    for (i=0; i<cvv->vr_len; i++){
+	cvv->vr_vec[i].var_indexed = 1;
+	if (cvv->vr_vec[i].var_name == NULL)
+	    continue;
+	j = cvec_index_hash(cvv->vr_vec[i].var_name) & (size-1);
+	while (ci->ci_vec[j])
+	    j = (j+1) & (size-1);
+	ci->ci_vec[j] = i+1;
+    }
+    cvv->vr_index = ci;
+    return 0;
+}
+
+/*! Find first cv with a name using the name index, build the index if needed
+ * The index is rebuilt if a cv of an indexed cvec has been renamed since it was built,
+ * since it may be a cv of this cvec. The index of a frozen cvec is never built or
+ * rebuilt here, since the cvec may be searched concurrently, see cvec_freeze.
+ * @param[in]  cvv   Cligen variable vector
+ * @param[in]  name  Name to match
+ * @param[in]  mode  CVEC_FIND_ANY, CVEC_FIND_KEYWORD or CVEC_FIND_VAR
+ * @param[out] cvp   First element matching name and mode, or NULL if not found
+ * @retval     1     OK, cvp set
+ * @retval     0     Index not applicable (small vector or out of memory), scan linearly
+ */
+static int
+cvec_index_find(cvec    *cvv,
+		char    *name,
+		int      mode,
+		cg_var **cvp)
+{
+    struct cvec_index *ci;
+    cg_var            *cv;
+    int                j;
+
+    if (name == NULL || cvec_len(cvv) < CVEC_INDEX_MIN)
+	return 0;
+    if (cvv->vr_frozen){
+	if ((ci = cvv->vr_index) == NULL)
+	    return 0;
+    }
+    else if ((ci = cvv->vr_index) == NULL ||
+	     ci->ci_gen != __atomic_load_n(&_cligen_cv_name_gen, __ATOMIC_RELAXED)){
+	if (cvec_index_build(cvv) < 0)
+	    return 0;
+	ci = cvv->vr_index;
+    }
+    *cvp = NULL;
+    j = cvec_index_hash(name) & (ci->ci_size-1);
+    while (ci->ci_vec[j]){
+	cv = &cvv->vr_vec[ci->ci_vec[j]-1];
+	if (strcmp(cv->var_name, name) == 0 &&
+	    (mode == CVEC_FIND_ANY ||
+	     (mode == CVEC_FIND_KEYWORD && cv->var_const) ||
+	     (mode == CVEC_FIND_VAR && !cv->var_const))){
+	    *cvp = cv;
+	    break;
+	}
+	j = (j+1) & (ci->ci_size-1);
+    }
+    return 1;
+}
+
 /*! Return first cv in a cvec matching a name
  *
  * Given an CLIgen variable vector cvec, and the name of a variable, return the
  * first matching entry.
+ * Vectors of at least CVEC_INDEX_MIN cv:s are searched with a name index, that is
+ * built on first use and freed by cvec_add and cvec_del.
  * @param[in]  cvv   Cligen variable vector
  * @param[in]  name  Name to match (can be NULL)
  * @retval     cv    Element matching name. NULL
@@ -557,6 +769,8 @@ cvec_find(cvec *cvv,
 {
     cg_var *cv = NULL;
 
+    if (cvec_index_find(cvv, name, CVEC_FIND_ANY, &cv) == 1)
+	return cv;
     while ((cv = cvec_each(cvv, cv)) != NULL){
 	if (cv->var_name){
 	    if (name != NULL && strcmp(cv->var_name, name) == 0)
@@ -581,6 +795,8 @@ cvec_find_keyword(cvec *cvv,
 {
     cg_var *cv = NULL;
 
+    if (cvec_index_find(cvv, name, CVEC_FIND_KEYWORD, &cv) == 1)
+	return cv;
     while ((cv = cvec_each(cvv, cv)) != NULL)
 	if (cv->var_name && strcmp(cv->var_name, name) == 0 && cv->var_const)
 	    return cv;
@@ -600,12 +816,38 @@ cvec_find_var(cvec *cvv,
 {
     cg_var *cv = NULL;
 
+    if (cvec_index_find(cvv, name, CVEC_FIND_VAR, &cv) == 1)
+	return cv;
     while ((cv = cvec_each(cvv, cv)) != NULL)
 	if (cv->var_name && strcmp(cv->var_name, name) == 0 && !cv->var_const)
 	    return cv;
     return NULL;
 }
 
+/*! Mark a cvec as read-only so that it can be searched by several threads
+ *
+ * The name index is built here if the cvec is large enough, cvec_find() and friends
+ * then only read the cvec. The cvec must not be modified thereafter, only freed.
+ * Called by pt_freeze() for the cvecs of a parse-tree.
+ * @param[in]  cvv   Cligen variable vector
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+cvec_freeze(cvec *cvv)
+{
+    if (cvv == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (cvv->vr_frozen)
+	return 0;
+    if (cvec_len(cvv) >= CVEC_INDEX_MIN && cvec_index_build(cvv) < 0)
+	return -1;
+    cvv->vr_frozen = 1;
+    return 0;
+}
+
 /*! Typed version of cvec_find that returns the string value.
  *
 
@@ -666,6 +908,8 @@ cvec_name_set(cvec *cvv,
 
 /*! Changes cvec find function behaviour, exclude keywords or include them.
  * @param[in] status
+ * This is the process default, a handle may override it with
+ * cligen_exclude_keys_set()
  */
 int
 cv_exclude_keys(int status)
@@ -691,8 +935,14 @@ cvec_size(cvec *cvv)
     cg_var *cv = NULL;
 
     sz += sizeof(struct cvec);
+    if (cvv->vr_vec != cvv->vr_inline) /* Unused heap capacity, cv:s counted below */
+	sz += (cvv->vr_size - cvv->vr_len)*sizeof(cg_var);
+    else /* Inline cv:s are included in the cvec and counted again below */
+	sz -= cvv->vr_len*sizeof(cg_var);
     if (cvv->vr_name)
 	sz += strlen(cvv->vr_name)+1;
+    if (cvv->vr_index)
+	sz += sizeof(struct cvec_index) + cvv->vr_index->ci_size*sizeof(int);
     cv = NULL;
     while ((cv = cvec_each(cvv, cv)) != NULL)
 	sz += cv_size(cv);
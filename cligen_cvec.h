@@ -52,6 +52,7 @@ cvec   *cvec_new(int len);
 cvec   *cvec_from_var(cg_var *cv);
 int     cvec_free(cvec *vr);
 int     cvec_init(cvec *vr, int len);
+int     cvec_reserve(cvec *cvv, int size);
 int     cvec_reset(cvec *vr); 
 int     cvec_len(cvec *vr);
 cg_var *cvec_i(cvec *vr, int i);
@@ -76,6 +77,7 @@ char   *cvec_name_set(cvec *vr, char *name);
 int     cv_exclude_keys(int status);
 int     cv_exclude_keys_get(void);
 size_t  cvec_size(cvec *cvv);
+int     cvec_freeze(cvec *cvv);
 
 #endif /* _CLIGEN_CVEC_H_ */
 
@@ -38,13 +38,26 @@
 #ifndef _CLIGEN_CVEC_INTERNAL_H_
 #define _CLIGEN_CVEC_INTERNAL_H_
 
+/*
+ * Constants
+ */
+/* Number of cv:s stored in the cvec itself before heap allocation is made */
+#define CVEC_INLINE_LEN 4
+
+/* Minimum length of a cvec for cvec_find to build a name index */
+#define CVEC_INDEX_MIN 16
+
 /*
  * Types
  */
 struct cvec{
-    cg_var         *vr_vec;  /* vector of CLIgen variables */
+    cg_var         *vr_vec;  /* vector of CLIgen variables, vr_inline or malloc:d */
     int             vr_len;  /* length of vector */
+    int             vr_size; /* allocated length of vr_vec */
     char           *vr_name; /* name of cvec, can be NULL */
+    struct cvec_index *vr_index; /* Name index built by cvec_find, or NULL */
+    int             vr_frozen; /* Read-only and shared, see cvec_freeze */
+    cg_var          vr_inline[CVEC_INLINE_LEN]; /* Initial storage of vr_vec */
 };
 
 #endif /* _CLIGEN_CVEC_INTERNAL_H_ */
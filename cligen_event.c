@@ -0,0 +1,408 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+ *
+ * CLIgen event loop: file descriptors and timers, see cligen_event.h
+ */
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <netinet/in.h>
+
+#include "cligen_buf.h"
+#include "cligen_cv.h"
+#include "cligen_cvec.h"
+#include "cligen_parsetree.h"
+#include "cligen_pt_head.h"
+#include "cligen_object.h"
+#include "cligen_handle.h"
+#include "cligen_io.h"
+#include "cligen_event.h"
+#include "cligen_stats.h"
+#include "cligen_handle_internal.h"
+#include "cligen_stats_internal.h"
+
+/*
+ * Types
+ */
+/* Callback of a registered file descriptor, kept in parallel with the poll set */
+struct event_fd {
+    cligen_fd_cb_t *ef_cb;
+    void           *ef_arg;
+};
+
+/* One-shot timer */
+struct event_timer {
+    uint64_t           et_time;   /* Expiry time in ms, see event_now */
+    cligen_timer_cb_t *et_cb;
+    void              *et_arg;
+};
+
+/*
+ * Variables
+ */
+/* Poll set. Slot 0 is the file descriptor waited for by cligen_event_poll, the rest are
+ * registered file descriptors. Unregistered slots get fd -1, which poll ignores, and are
+ * removed before the next poll, so that callbacks may unregister while dispatching.
+ */
+static struct pollfd   *_event_pfds = NULL;
+static struct event_fd *_event_fds = NULL;
+static int              _event_nfds = 0;
+static int              _event_size = 0;
+static int              _event_dirty = 0;  /* Set if unregistered slots remain */
+
+/* Timers as a binary min-heap on expiry time */
+static struct event_timer *_event_timers = NULL;
+static int                 _event_ntimers = 0;
+static int                 _event_tsize = 0;
+
+/*! Current monotonic time in milliseconds
+ */
+static uint64_t
+event_now(void)
+{
+    return cligen_stats_ns() / 1000000;
+}
+
+/*! Make room for one more file descriptor, and create slot 0 if needed
+ */
+static int
+event_fd_grow(void)
+{
+    struct pollfd   *pfds;
+    struct event_fd *fds;
+    int              size;
+
+    if (_event_nfds + 2 <= _event_size)
+	return 0;
+    size = _event_size ? _event_size * 2 : 8;
+    if ((pfds = realloc(_event_pfds, size*sizeof(*pfds))) == NULL)
+	return -1;
+    _event_pfds = pfds;
+    if ((fds = realloc(_event_fds, size*sizeof(*fds))) == NULL)
+	return -1;
+    _event_fds = fds;
+    _event_size = size;
+    if (_event_nfds == 0){
+	memset(&_event_pfds[0], 0, sizeof(*_event_pfds));
+	memset(&_event_fds[0], 0, sizeof(*_event_fds));
+	_event_pfds[0].fd = -1;
+	_event_nfds = 1;
+    }
+    return 0;
+}
+
+/*! Remove unregistered slots from the poll set
+ */
+static void
+event_fd_compact(void)
+{
+    int i;
+    int j = 1;
+
+    for (i=1; i<_event_nfds; i++){
+	if (_event_pfds[i].fd < 0)
+	    continue;
+	if (i != j){
+	    _event_pfds[j] = _event_pfds[i];
+	    _event_fds[j] = _event_fds[i];
+	}
+	j++;
+    }
+    _event_nfds = j;
+    _event_dirty = 0;
+}
+
+/*! Register a file descriptor, its callback is called when it is readable
+ * If the file descriptor is already registered, its callback and argument are updated.
+ * @param[in]  fd   File descriptor
+ * @param[in]  cb   Callback called with fd and arg
+ * @param[in]  arg  Argument of callback
+ * @retval     0    OK
+ * @retval    -1    Error
+ * @see cligen_event_unreg_fd
+ */
+int
+cligen_event_reg_fd(int             fd,
+		    cligen_fd_cb_t *cb,
+		    void           *arg)
+{
+    int i;
+
+    for (i=1; i<_event_nfds; i++)
+	if (_event_pfds[i].fd == fd){
+	    _event_fds[i].ef_cb = cb;
+	    _event_fds[i].ef_arg = arg;
+	    return 0;
+	}
+    if (event_fd_grow() < 0)
+	return -1;
+    i = _event_nfds++;
+    _event_pfds[i].fd = fd;
+    _event_pfds[i].events = POLLIN;
+    _event_pfds[i].revents = 0;
+    _event_fds[i].ef_cb = cb;
+    _event_fds[i].ef_arg = arg;
+    return 0;
+}
+
+/*! Unregister a file descriptor
+ * May be called from a callback.
+ * @param[in]  fd   File descriptor
+ * @retval     0    OK
+ * @retval    -1    Not registered
+ * @see cligen_event_reg_fd
+ */
+int
+cligen_event_unreg_fd(int fd)
+{
+    int i;
+
+    for (i=1; i<_event_nfds; i++)
+	if (_event_pfds[i].fd == fd){
+	    _event_pfds[i].fd = -1;
+	    _event_fds[i].ef_cb = NULL;
+	    _event_dirty++;
+	    return 0;
+	}
+    return -1;
+}
+
+static void
+event_timer_swap(int i,
+		 int j)
+{
+    struct event_timer et;
+
+    et = _event_timers[i];
+    _event_timers[i] = _event_timers[j];
+    _event_timers[j] = et;
+}
+
+/*! Restore heap order of timer i, moving it up or down
+ */
+static void
+event_timer_heapify(int i)
+{
+    int c;
+
+    while (i > 0 && _event_timers[i].et_time < _event_timers[(i-1)/2].et_time){
+	event_timer_swap(i, (i-1)/2);
+	i = (i-1)/2;
+    }
+    while ((c = 2*i+1) < _event_ntimers){
+	if (c+1 < _event_ntimers && _event_timers[c+1].et_time < _event_timers[c].et_time)
+	    c++;
+	if (_event_timers[i].et_time <= _event_timers[c].et_time)
+	    break;
+	event_timer_swap(i, c);
+	i = c;
+    }
+}
+
+/*! Remove timer i
+ */
+static void
+event_timer_remove(int i)
+{
+    _event_ntimers--;
+    if (i < _event_ntimers){
+	_event_timers[i] = _event_timers[_event_ntimers];
+	event_timer_heapify(i);
+    }
+}
+
+/*! Add a one-shot timer
+ * A periodic timer adds itself again from its callback.
+ * @param[in]  ms   Milliseconds until the callback is called
+ * @param[in]  cb   Callback called with arg, an error terminates cligen_event_poll
+ * @param[in]  arg  Argument of callback
+ * @retval     0    OK
+ * @retval    -1    Error
+ * @see cligen_event_timer_del
+ */
+int
+cligen_event_timer_add(int                ms,
+		       cligen_timer_cb_t *cb,
+		       void              *arg)
+{
+    struct event_timer *timers;
+    int                 size;
+
+    if (_event_ntimers == _event_tsize){
+	size = _event_tsize ? _event_tsize * 2 : 8;
+	if ((timers = realloc(_event_timers, size*sizeof(*timers))) == NULL)
+	    return -1;
+	_event_timers = timers;
+	_event_tsize = size;
+    }
+    _event_timers[_event_ntimers].et_time = event_now() + (ms > 0 ? ms : 0);
+    _event_timers[_event_ntimers].et_cb = cb;
+    _event_timers[_event_ntimers].et_arg = arg;
+    event_timer_heapify(_event_ntimers++);
+    return 0;
+}
+
+/*! Delete timers with callback and argument
+ * @param[in]  cb   Callback
+ * @param[in]  arg  Argument of callback
+ * @retval     0    OK
+ * @retval    -1    No such timer
+ * @see cligen_event_timer_add
+ */
+int
+cligen_event_timer_del(cligen_timer_cb_t *cb,
+		       void              *arg)
+{
+    int retval = -1;
+    int i;
+
+    for (i=_event_ntimers-1; i>=0; i--)
+	if (_event_timers[i].et_cb == cb && _event_timers[i].et_arg == arg){
+	    event_timer_remove(i);
+	    retval = 0;
+	}
+    return retval;
+}
+
+/*! Call expired timers
+ * At most the timers existing on entry, so that a callback adding a timer with 0 ms
+ * does not loop.
+ * @retval     0    OK
+ * @retval    -1    Error in callback
+ */
+static int
+event_timer_run(void)
+{
+    struct event_timer et;
+    uint64_t           now = event_now();
+    int                n = _event_ntimers;
+
+    while (n-- > 0 && _event_ntimers > 0 && _event_timers[0].et_time <= now){
+	et = _event_timers[0];
+	event_timer_remove(0);
+	if (et.et_cb(et.et_arg) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/*! Dispatch events until a file descriptor is readable or a timeout
+ * Callbacks of registered file descriptors and expired timers are called.
+ * @param[in]  fd   File descriptor to wait for, eg 0 for stdin, or -1 for none
+ * @param[in]  ms   Max time to wait in milliseconds, <0: no limit
+ * @retval     1    fd is readable
+ * @retval     0    Timeout
+ * @retval    -1    Error
+ */
+int
+cligen_event_poll(int fd,
+		  int ms)
+{
+    uint64_t deadline = 0;
+    uint64_t now;
+    int      timeout;
+    int      t;
+    int      n;
+    int      i;
+    short    rev;
+
+    if (ms >= 0)
+	deadline = event_now() + ms;
+    if (event_fd_grow() < 0)
+	return -1;
+    while (1){
+	if (_event_dirty)
+	    event_fd_compact();
+	_event_pfds[0].fd = fd;
+	_event_pfds[0].events = POLLIN;
+	_event_pfds[0].revents = 0;
+	timeout = -1;
+	now = event_now();
+	if (_event_ntimers > 0)
+	    timeout = _event_timers[0].et_time > now ? _event_timers[0].et_time - now : 0;
+	if (ms >= 0){
+	    t = deadline > now ? deadline - now : 0;
+	    if (timeout < 0 || t < timeout)
+		timeout = t;
+	}
+	n = _event_nfds;
+	if (poll(_event_pfds, n, timeout) < 0){
+	    if (errno == EINTR)
+		continue;
+	    fprintf(stderr, "%s: poll: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	if (event_timer_run() < 0)
+	    return -1;
+	/* Callbacks may register and unregister, only slots polled are dispatched */
+	for (i=1; i<n; i++){
+	    if (_event_pfds[i].fd < 0 || (rev = _event_pfds[i].revents) == 0)
+		continue;
+	    if (rev & POLLNVAL){
+		fprintf(stderr, "%s: invalid file descriptor %d\n", __FUNCTION__, _event_pfds[i].fd);
+		return -1;
+	    }
+	    if (_event_fds[i].ef_cb(_event_pfds[i].fd, _event_fds[i].ef_arg) < 0)
+		return -1;
+	}
+	if (fd >= 0 && _event_pfds[0].revents != 0)
+	    return 1;
+	if (ms >= 0 && event_now() >= deadline)
+	    return 0;
+    }
+}
+
+/*! Unregister all file descriptors and timers, and free the event loop
+ * Called by cligen_exit of the default handle
+ */
+int
+cligen_event_exit(void)
+{
+    if (_event_pfds)
+	free(_event_pfds);
+    if (_event_fds)
+	free(_event_fds);
+    if (_event_timers)
+	free(_event_timers);
+    _event_pfds = NULL;
+    _event_fds = NULL;
+    _event_timers = NULL;
+    _event_nfds = _event_size = _event_dirty = 0;
+    _event_ntimers = _event_tsize = 0;
+    return 0;
+}
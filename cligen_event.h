@@ -0,0 +1,68 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+ *
+ * CLIgen event loop: file descriptors and timers
+ * File descriptors are waited on with poll(), so there is no FD_SETSIZE limit, and the
+ * poll set is only rebuilt when registrations change, not on every keystroke.
+ * Getline dispatches events while waiting for input, see gl_select. An application
+ * not using getline may call cligen_event_poll() in its own loop.
+ * Registrations are process-wide.
+ * @code
+ *   static int timer_cb(void *arg) {
+ *     ...
+ *     return cligen_event_timer_add(1000, timer_cb, arg); // periodic
+ *   }
+ *   cligen_event_timer_add(1000, timer_cb, NULL);
+ * @endcode
+ * This file requires cligen_io.h
+ */
+
+#ifndef _CLIGEN_EVENT_H
+#define _CLIGEN_EVENT_H
+
+/*
+ * Types
+ */
+/* CLIgen timer callback type */
+typedef int (cligen_timer_cb_t)(void *);
+
+/*
+ * Prototypes
+ */
+int cligen_event_reg_fd(int fd, cligen_fd_cb_t *cb, void *arg);
+int cligen_event_unreg_fd(int fd);
+int cligen_event_timer_add(int ms, cligen_timer_cb_t *cb, void *arg);
+int cligen_event_timer_del(cligen_timer_cb_t *cb, void *arg);
+int cligen_event_poll(int fd, int ms);
+int cligen_event_exit(void);
+
+#endif /* _CLIGEN_EVENT_H */
@@ -38,11 +38,14 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <poll.h>
 #include <netinet/in.h>
 
 #include "cligen_buf.h"
+#include "cligen_intern.h"
 #include "cligen_cv.h"
 #include "cligen_cvec.h"
 #include "cligen_parsetree.h"
@@ -53,6 +56,10 @@
 #include "cligen_print.h"
 #include "cligen_expand.h"
 #include "cligen_syntax.h"
+#include "cligen_io.h"
+#include "cligen_stats.h"
+#include "cligen_handle_internal.h"
+#include "cligen_stats_internal.h"
 
 /* Callback function for expand variables */
 
@@ -72,30 +79,34 @@ co_expand_sub(cg_obj  *co,
 {
     cg_obj     *con = NULL;
     parse_tree *pt;
+    struct cg_obj_ext *ext;
 
-    if ((con = co_new_only()) == NULL)
+    if ((con = co_new_only(co->co_type)) == NULL)
 	return -1;
-    memcpy(con, co, sizeof(cg_obj));
+    memcpy(con, co, co_size(co->co_type));
+    co_flags_reset(con, CO_FLAGS_FROZEN);
     /* Point to same underlying pt */
     con->co_ptvec = NULL;
     con->co_pt_len = 0;
+    con->co_ext = NULL;
+    if ((ext = co_ext_alloc(con)) == NULL)
+	return -1;
     pt = co_pt_get(co);
     if (co_pt_set(con, pt) < 0)
 	return -1;
     /* Replace all pointers */
     co_up_set(con, co_parent);
-    if (co->co_command)
-	if ((con->co_command = strdup(co->co_command)) == NULL){
-	    fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
-	    return -1;
-	}
-    if (co->co_cvec)
-	con->co_cvec = cvec_dup(co->co_cvec);
-    if (co_callback_copy(co->co_callbacks, &con->co_callbacks) < 0)
+    con->co_command = cligen_intern_dup(co->co_command);
+    if (co_cvec_get(co))
+	ext->ce_cvec = cvec_dup(co_cvec_get(co));
+    if (co_callback_copy(co_callbacks_get(co), &ext->ce_callbacks) < 0)
 	return -1;
-    if (co->co_helpvec)
-	if ((con->co_helpvec = cvec_dup(co->co_helpvec)) == NULL)
+    if (co_helpvec_get(co))
+	if ((ext->ce_helpvec = cvec_dup(co_helpvec_get(co))) == NULL)
 	    return -1;
+    ext->ce_treeref_orig = co_treeref_orig_get(co);
+    if (co_value_set(con, co_value_get(co)) < 0)
+	return -1;
     if (co->co_type == CO_VARIABLE){
 	if (co->co_expand_fn_str)
 	    if ((con->co_expand_fn_str = strdup(co->co_expand_fn_str)) == NULL){
@@ -121,6 +132,7 @@ co_expand_sub(cg_obj  *co,
 	if (co->co_rangecvv_upp)
 	    if ((con->co_rangecvv_upp = cvec_dup(co->co_rangecvv_upp)) == NULL)
 		return -1;
+	con->co_rangetab = NULL; /* compiled again on use */
 	if (co->co_choice)
 	    if ((con->co_choice = strdup(co->co_choice)) == NULL){
 		fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
@@ -132,7 +144,7 @@ co_expand_sub(cg_obj  *co,
 		return -1;
 	    }
     } /* CO_VARIABLE */
-    con->co_ref = co;
+    ext->ce_ref = co;
     *conp = con;
     return 0;
 }
@@ -141,7 +153,7 @@ co_expand_sub(cg_obj  *co,
  * Expansion of choice or expand takes a variable (<expand> <choice>)
  * and transform them to a set of commands: <string>...<string>
  * @param[in]  co        The variable to transform to a command
- * @param[in]  cmd       Command name
+ * @param[in]  cmd       Command name, malloced and freed by this function
  * @param[out] helptext  Helptext of command
  */
 int
@@ -149,16 +161,23 @@ transform_var_to_cmd(cg_obj *co,
 		     char   *cmd, 
 		     char   *helptext)
 {
-    if (co->co_command)
-	free(co->co_command);
-    co->co_command = cmd; 
+    struct cg_obj_ext *ext;
+    int                ret;
+
+    ret = co_command_set(co, cmd); /* interned */
+    if (cmd)
+	free(cmd);
+    if (ret < 0)
+	return -1;
     if (helptext){
-	if (co->co_helpvec){
-	    cvec_free(co->co_helpvec);
-	    co->co_helpvec = NULL;
+	if ((ext = co_ext_alloc(co)) == NULL)
+	    return -1;
+	if (ext->ce_helpvec){
+	    cvec_free(ext->ce_helpvec);
+	    ext->ce_helpvec = NULL;
 	}
 	/* helpstr can be on the form "txt1\n    txt2" */
-	if (cligen_txt2cvv(helptext, &co->co_helpvec) < 0)
+	if (cligen_txt2cvv(helptext, &ext->ce_helpvec) < 0)
 	    return -1;
     }
     if (co->co_expandv_fn)
@@ -187,6 +206,10 @@ transform_var_to_cmd(cg_obj *co,
 	cvec_free(co->co_rangecvv_upp);
 	co->co_rangecvv_upp = NULL;
     }
+    if (co->co_rangetab){
+	free(co->co_rangetab);
+	co->co_rangetab = NULL;
+    }
     if (co->co_choice){
 	free(co->co_choice);
 	co->co_choice = NULL;
@@ -226,6 +249,7 @@ pt_callback_reference(parse_tree         *pt,
     int                 retval = -1;
     struct cg_callback *cc;
     cg_var             *cv;
+    struct cg_obj_ext  *ext;
 		    
     for (i=0; i<pt_len_get(pt); i++){    
 	if ((co = pt_vec_i_get(pt, i)) == NULL)
@@ -234,8 +258,10 @@ pt_callback_reference(parse_tree         *pt,
 	/* Filter out non-executable non-terminals. */
 	if (pt_len_get(ptc) && pt_vec_i_get(ptc, 0) == NULL){
 	    /* Copy the callback from top */
-	    if ((cc = co->co_callbacks) == NULL){
-		if (co_callback_copy(cc0, &co->co_callbacks) < 0)
+	    if ((cc = co_callbacks_get(co)) == NULL){
+		if ((ext = co_ext_alloc(co)) == NULL)
+		    return -1;
+		if (co_callback_copy(cc0, &ext->ce_callbacks) < 0)
 		    return -1;
 	    }
 	    else {
@@ -281,9 +307,130 @@ pt_reference_trunc(parse_tree *pt)
     return retval;
 }
 
+/*! Private copy of a frozen parse-tree level with expanded tree references
+ *
+ * A frozen parse-tree (see pt_freeze) is shared between handles and can not be
+ * expanded in place. Instead, a handle makes a shallow copy of a frozen level
+ * containing tree references: the static objects are borrowed from the frozen
+ * level, the references are copied so that CO_FLAGS_REFDONE is private, and the
+ * referenced trees are inserted into the copy.
+ * Overlays are kept in the handle, most recently used first, until flushed by
+ * cligen_ph_treeref_validate().
+ */
+struct pt_overlay{
+    struct pt_overlay *po_next;
+    parse_tree        *po_frozen; /* Frozen original level (not owned) */
+    parse_tree        *po_pt;     /* Private copy, borrows objects of po_frozen */
+};
+
+/*! Free all private copies of frozen parse-tree levels of a handle
+ * @param[in]  h       CLIgen handle
+ * @see pt_overlay_get
+ */
+int
+pt_overlay_flush(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    struct pt_overlay    *po;
+
+    while ((po = ch->ch_pt_overlay) != NULL){
+	ch->ch_pt_overlay = po->po_next;
+	if (po->po_pt)
+	    pt_free(po->po_pt, 1);
+	free(po);
+    }
+    return 0;
+}
+
+/*! Get private copy of a frozen parse-tree level, create it if requested
+ * A found entry is moved first in the list.
+ * @param[in]  h       CLIgen handle
+ * @param[in]  pt      Frozen parse-tree level
+ * @param[in]  create  If not found, create it if pt has tree references
+ * @param[out] ptop    Private copy of pt, or NULL if none
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+static int
+pt_overlay_get(cligen_handle h,
+	       parse_tree   *pt,
+	       int           create,
+	       parse_tree  **ptop)
+{
+    int                   retval = -1;
+    struct cligen_handle *ch = handle(h);
+    struct pt_overlay    *po;
+    struct pt_overlay   **pop;
+    parse_tree           *ptn = NULL;
+    cg_obj               *co;
+    cg_obj               *con;
+    int                   i;
+
+    *ptop = NULL;
+    pop = (struct pt_overlay **)&ch->ch_pt_overlay;
+    while ((po = *pop) != NULL){
+	if (po->po_frozen == pt){
+	    *pop = po->po_next; /* Move to front */
+	    break;
+	}
+	pop = &po->po_next;
+    }
+    if (po == NULL){
+	if (!create)
+	    goto ok;
+	for (i=0; i<pt_len_get(pt); i++)
+	    if ((co = pt_vec_i_get(pt, i)) != NULL && co->co_type == CO_REFERENCE)
+		break;
+	if (i == pt_len_get(pt)) /* No tree references */
+	    goto ok;
+	if ((ptn = pt_new()) == NULL)
+	    goto done;
+	pt_sets_set(ptn, pt_sets_get(pt));
+	pt_borrow_set(ptn, 1);
+	for (i=0; i<pt_len_get(pt); i++){
+	    if ((co = pt_vec_i_get(pt, i)) == NULL){
+		if (pt_realloc(ptn) < 0) /* empty child */
+		    goto done;
+		continue;
+	    }
+	    if (co->co_type == CO_REFERENCE){
+		if (co_copy(co, co_up(co), &con) < 0)
+		    goto done;
+		con->co_ext->ce_ref = co; /* Owned by the copy, see pt_free. co_copy allocates co_ext */
+		co = con;
+	    }
+	    if (pt_vec_append(ptn, co) < 0){
+		if (co_ref_get(co))
+		    co_free(co, 1);
+		goto done;
+	    }
+	}
+	if ((po = malloc(sizeof(*po))) == NULL)
+	    goto done;
+	memset(po, 0, sizeof(*po));
+	po->po_frozen = pt;
+	po->po_pt = ptn;
+	ptn = NULL;
+    }
+    po->po_next = ch->ch_pt_overlay;
+    ch->ch_pt_overlay = po;
+    *ptop = po->po_pt;
+ ok:
+    retval = 0;
+ done:
+    if (ptn)
+	pt_free(ptn, 1);
+    return retval;
+}
+
 /*! Take a top-object parse-tree (pt0), and expand all tree references one level. 
  * 
  * One level only. Parse-tree is expanded itself (not copy).
+ * The expansion is kept in the parse-tree and re-used by subsequent calls, until a
+ * parse-tree or working point changes. This is checked on the top-level call
+ * (co0 is NULL) by cligen_ph_treeref_validate().
+ * A frozen parse-tree is not modified, the expansion is made in a private copy of
+ * the level instead, see struct pt_overlay.
  *
  * @param[in]     h     Handle needed to resolve tree-references (\@tree)
  * @param[in]     co0   Parent, if any
@@ -309,7 +456,17 @@ pt_expand_treeref(cligen_handle h,
     cg_obj     *co02;
     cg_obj     *cow;
     pt_head    *ph;
+    uint64_t    ncopy;
+    struct cg_obj_ext *ext;
 
+    if (co0 == NULL && cligen_ph_treeref_validate(h) < 0)
+	goto done;
+    if (pt_frozen_get(pt0) == 1){
+	if (pt_overlay_get(h, pt0, 1, &pt0) < 0)
+	    goto done;
+	if (pt0 == NULL) /* No tree references */
+	    goto ok;
+    }
  again: /* XXX ugly goto , try to replace with a loop */
     for (i=0; i<pt_len_get(pt0); i++){ /*  */
 	if ((co = pt_vec_i_get(pt0, i)) == NULL)
@@ -326,32 +483,41 @@ pt_expand_treeref(cligen_handle h,
 	    /* Get working point of tree, if any */
 	    if ((cow = cligen_ph_workpoint_get(ph)) != NULL)
 		ptref = co_pt_get(cow);
-	    else
-		ptref = cligen_ph_parsetree_get(ph);	    
+	    else if ((ptref = cligen_ph_parsetree_get(ph)) == NULL){ /* May be loaded here */
+		fprintf(stderr, "CLIgen tree '%s' could not be loaded\n", treename);
+		goto done;
+	    }
 
 	    /* make a copy of ptref -> pt1ref */
 	    co02 = co_up(co);
 
+	    cligen_stats_inc(h, cs_treeref);
+	    ncopy = _cligen_stats_co_copy;
 	    if ((pt1ref = pt_dup(ptref, co02)) == NULL) /* From ptref -> pt1ref */
 		goto done;
+	    cligen_stats_add(h, cs_treeref_copy, _cligen_stats_co_copy - ncopy);
 	    /* Recursively add extra NULLs in non-terminals */
 	    if (co_flags_get(co, CO_FLAGS_HIDE) && /* XXX: hide to trunk? */
 		pt_reference_trunc(pt1ref) < 0)
 		goto done;
 	    /* Recursively install callback all through the referenced tree */
-	    if (co->co_callbacks && 
-		pt_callback_reference(pt1ref, co->co_callbacks) < 0)
+	    if (co_callbacks_get(co) && 
+		pt_callback_reference(pt1ref, co_callbacks_get(co)) < 0)
 		goto done;
-	    /* Copy top-levels into original parse-tree */
+	    /* Move top-levels into original parse-tree, sort and merge them once */
 	    for (j=0; j<pt_len_get(pt1ref); j++)
 		if ((cot = pt_vec_i_get(pt1ref, j)) != NULL){
 		    co_flags_set(cot, CO_FLAGS_TREEREF); /* Mark expanded refd tree */
-		    cot->co_ref = co; /* Backpointer so we know where this treeref is from */
-		    if (co_insert(pt0, cot) == NULL) 
+		    if ((ext = co_ext_alloc(cot)) == NULL)
+			goto done;
+		    ext->ce_ref = co; /* Backpointer so we know where this treeref is from */
+		    if (pt_bulk_append(pt0, cot, 0) < 0) 
 			goto done;
 		    if (pt_vec_i_clear(pt1ref, j) < 0)
 			goto done;
 		}
+	    if (pt_coalesce(pt0, PT_COALESCE_INSERT) < 0)
+		goto done;
 	    /* Due to loop above, all co in vec should be moved, it should
 	       be safe to remove */
 	    co_flags_set(co, CO_FLAGS_REFDONE);
@@ -362,6 +528,7 @@ pt_expand_treeref(cligen_handle h,
 	    goto again; 
 	}
     }
+ ok:
     retval = 0;
  done:
     if (pt1ref)
@@ -423,11 +590,554 @@ cligen_escape(const char* s)
 	return copy;
 }
 
+/*! Cached result of an expand callback, see pt_expand_fnv
+ * Entries are kept in the handle, most recently used first, at most
+ * CLIGEN_EXPAND_CACHE_MAX, until they expire or are flushed.
+ * @see cligen_expand_cache_set
+ */
+struct expand_cache{
+    struct expand_cache *ec_next;
+    expandv_cb          *ec_fn;        /* Expand callback */
+    char                *ec_key;       /* Function name, arguments and variable values */
+    uint64_t             ec_time;      /* When the callback was made, in ns */
+    cvec                *ec_commands;
+    cvec                *ec_helptexts;
+    struct expand_value *ec_index;     /* Plain values sorted, see expand_cache_index */
+    int                  ec_indexlen;
+    int                 *ec_special;   /* Positions of values that are always expanded */
+    int                  ec_speciallen;
+};
+
+/*! Value of a cached expand result in the sorted index of the entry
+ */
+struct expand_value{
+    const char          *ev_value;     /* Points into ec_commands */
+    int                  ev_pos;       /* Position in ec_commands */
+};
+
+/* Max number of cached expand callback results per handle */
+#define CLIGEN_EXPAND_CACHE_MAX 64
+
+static void
+expand_cache_free(struct expand_cache *ec)
+{
+    if (ec->ec_key)
+	free(ec->ec_key);
+    if (ec->ec_commands)
+	cvec_free(ec->ec_commands);
+    if (ec->ec_helptexts)
+	cvec_free(ec->ec_helptexts);
+    if (ec->ec_index)
+	free(ec->ec_index);
+    if (ec->ec_special)
+	free(ec->ec_special);
+    free(ec);
+}
+
+/*! Check if an expanded value can be skipped if it does not start with the next token
+ * Values that are escaped or quoted are matched without their quotes and are always
+ * expanded, see cligen_escape
+ * @param[in]  value  Expanded value
+ * @retval     1      Plain value, can be compared with the token as is
+ * @retval     0      Value is always expanded
+ */
+static int
+expand_value_plain(const char *value)
+{
+    return *value != '"' && strpbrk(value, "?\\ \t") == NULL;
+}
+
+static int
+expand_value_cmp(const void *a,
+		 const void *b)
+{
+    const struct expand_value *eva = a;
+    const struct expand_value *evb = b;
+    int                        eq;
+
+    if ((eq = strcmp(eva->ev_value, evb->ev_value)) == 0)
+	eq = eva->ev_pos - evb->ev_pos;
+    return eq;
+}
+
+/*! Build sorted index of plain values of a cached expand result on first use
+ * @param[in]  ec   Cache entry
+ * @retval     0    OK
+ * @retval    -1    Error
+ * @see expand_cache_range
+ */
+static int
+expand_cache_index(struct expand_cache *ec)
+{
+    int         len;
+    int         i;
+    const char *value;
+
+    if (ec->ec_index != NULL || ec->ec_special != NULL)
+	return 0;
+    if ((len = cvec_len(ec->ec_commands)) == 0)
+	return 0;
+    if ((ec->ec_index = malloc(len*sizeof(*ec->ec_index))) == NULL ||
+	(ec->ec_special = malloc(len*sizeof(*ec->ec_special))) == NULL)
+	return -1;
+    for (i=0; i<len; i++){
+	value = cv_string_get(cvec_i(ec->ec_commands, i));
+	if (expand_value_plain(value)){
+	    ec->ec_index[ec->ec_indexlen].ev_value = value;
+	    ec->ec_index[ec->ec_indexlen++].ev_pos = i;
+	}
+	else
+	    ec->ec_special[ec->ec_speciallen++] = i;
+    }
+    qsort(ec->ec_index, ec->ec_indexlen, sizeof(*ec->ec_index), expand_value_cmp);
+    return 0;
+}
+
+/*! Find values of a cached expand result starting with a prefix, using the sorted index
+ * @param[in]  ec      Cache entry with index, see expand_cache_index
+ * @param[in]  prefix  Prefix
+ * @param[out] first   First index entry starting with prefix
+ * @retval     n       Number of index entries starting with prefix, from first
+ */
+static int
+expand_cache_range(struct expand_cache *ec,
+		   const char          *prefix,
+		   int                 *first)
+{
+    size_t plen = strlen(prefix);
+    int    lo = 0;
+    int    hi = ec->ec_indexlen;
+    int    mid;
+    int    i;
+
+    while (lo < hi){ /* Lower bound of prefix */
+	mid = (lo + hi)/2;
+	if (strcmp(ec->ec_index[mid].ev_value, prefix) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    *first = lo;
+    for (i=lo; i<ec->ec_indexlen; i++)
+	if (strncmp(ec->ec_index[i].ev_value, prefix, plen) != 0)
+	    break;
+    return i - lo;
+}
+
+/*! Free all cached expand callback results of a handle
+ * Call this when the data returned by expand callbacks has changed
+ * @param[in]  h       CLIgen handle
+ * @see cligen_expand_cache_set
+ */
+int
+cligen_expand_cache_flush(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    struct expand_cache  *ec;
+
+    while ((ec = ch->ch_expand_cache) != NULL){
+	ch->ch_expand_cache = ec->ec_next;
+	expand_cache_free(ec);
+    }
+    return 0;
+}
+
+/*! Create cache key of an expand callback: function name, arguments and variable values
+ * The first element of cvv is the whole command string and is not part of the key.
+ * @param[in]  co      Expand variable
+ * @param[in]  cvv     Variable values of the command so far
+ * @param[out] cb      Key
+ */
+static int
+expand_cache_key(cg_obj *co,
+		 cvec   *cvv,
+		 cbuf   *cb)
+{
+    cg_var *cv = NULL;
+    int     i;
+
+    cprintf(cb, "%s", co->co_expand_fn_str?co->co_expand_fn_str:"");
+    while ((cv = cvec_each(co->co_expand_fn_vec, cv)) != NULL){
+	cprintf(cb, "\n");
+	cv2cbuf(cv, cb);
+    }
+    cprintf(cb, "\n");
+    for (i=1; i<cvec_len(cvv); i++){
+	cv = cvec_i(cvv, i);
+	cprintf(cb, "\n%s=", cv_name_get(cv)?cv_name_get(cv):"");
+	cv2cbuf(cv, cb);
+    }
+    return 0;
+}
+
+/*! Get cached result of an expand callback, remove expired entries
+ * A found entry is moved first in the list.
+ * @param[in]  h       CLIgen handle
+ * @param[in]  fn      Expand callback
+ * @param[in]  key     Cache key, see expand_cache_key
+ * @retval     ec      Cached result, owned by the cache
+ * @retval     NULL    Not found
+ */
+static struct expand_cache *
+expand_cache_get(cligen_handle h,
+		 expandv_cb   *fn,
+		 char         *key)
+{
+    struct cligen_handle *ch = handle(h);
+    struct expand_cache  *ec;
+    struct expand_cache **ecp;
+    int                   ttl = ch->ch_expand_cache_ttl;
+    uint64_t              now;
+
+    now = cligen_stats_ns();
+    ecp = (struct expand_cache **)&ch->ch_expand_cache;
+    while ((ec = *ecp) != NULL){
+	if (ttl > 0 && now - ec->ec_time > (uint64_t)ttl*1000000ULL){
+	    *ecp = ec->ec_next; /* Expired */
+	    expand_cache_free(ec);
+	    continue;
+	}
+	if (ec->ec_fn == fn && strcmp(ec->ec_key, key) == 0){
+	    *ecp = ec->ec_next; /* Move to front */
+	    ec->ec_next = ch->ch_expand_cache;
+	    ch->ch_expand_cache = ec;
+	    return ec;
+	}
+	ecp = &ec->ec_next;
+    }
+    return NULL;
+}
+
+/*! Add result of an expand callback first in cache, remove last entry if full
+ * @param[in]  h         CLIgen handle
+ * @param[in]  fn        Expand callback
+ * @param[in]  key       Cache key, see expand_cache_key
+ * @param[in]  commands  Expanded commands, consumed by the cache
+ * @param[in]  helptexts Help-texts, consumed by the cache
+ * @retval     ec        Cache entry
+ * @retval     NULL      Error
+ */
+static struct expand_cache *
+expand_cache_add(cligen_handle h,
+		 expandv_cb   *fn,
+		 char         *key,
+		 cvec         *commands,
+		 cvec         *helptexts)
+{
+    struct cligen_handle *ch = handle(h);
+    struct expand_cache  *ec;
+    struct expand_cache **ecp;
+    int                   i;
+
+    if ((ec = malloc(sizeof(*ec))) == NULL)
+	return NULL;
+    memset(ec, 0, sizeof(*ec));
+    if ((ec->ec_key = strdup(key)) == NULL){
+	free(ec);
+	return NULL;
+    }
+    ec->ec_fn = fn;
+    ec->ec_time = cligen_stats_ns();
+    ec->ec_commands = commands;
+    ec->ec_helptexts = helptexts;
+    ec->ec_next = ch->ch_expand_cache;
+    ch->ch_expand_cache = ec;
+    ecp = &ec->ec_next;
+    for (i=1; *ecp != NULL && i<CLIGEN_EXPAND_CACHE_MAX; i++)
+	ecp = &(*ecp)->ec_next;
+    if (*ecp != NULL){ /* Full: remove least recently used */
+	expand_cache_free(*ecp);
+	*ecp = NULL;
+    }
+    return ec;
+}
+
+/*! Expand callback that did not finish before the completion deadline
+ * Its file descriptor is registered with cligen_regfd. When readable, the callback is
+ * called again and a complete result is added to the expand cache, see expand_async_cb.
+ * @see cligen_expand_deadline_set
+ */
+struct expand_async{
+    struct expand_async *ea_next;
+    cligen_handle        ea_h;
+    int                  ea_fd;
+    expandv_cb          *ea_fn;
+    char                *ea_fn_str;
+    cvec                *ea_argv;
+    cvec                *ea_cvv;
+    char                *ea_key;       /* Expand cache key, or NULL */
+};
+
+static void
+expand_async_free(struct expand_async *ea)
+{
+    if (ea->ea_fn_str)
+	free(ea->ea_fn_str);
+    if (ea->ea_argv)
+	cvec_free(ea->ea_argv);
+    if (ea->ea_cvv)
+	cvec_free(ea->ea_cvv);
+    if (ea->ea_key)
+	free(ea->ea_key);
+    free(ea);
+}
+
+/*! Remove pending expand callback of a file descriptor, if any
+ * @param[in]  h       CLIgen handle
+ * @param[in]  fd      File descriptor
+ */
+static int
+expand_async_remove(cligen_handle h,
+		    int           fd)
+{
+    struct cligen_handle *ch = handle(h);
+    struct expand_async  *ea;
+    struct expand_async **eap;
+
+    eap = (struct expand_async **)&ch->ch_expand_async;
+    while ((ea = *eap) != NULL){
+	if (ea->ea_fd == fd){
+	    *eap = ea->ea_next;
+#if CLIGEN_REGFD
+	    cligen_unregfd(fd);
+#endif
+	    expand_async_free(ea);
+	    break;
+	}
+	eap = &ea->ea_next;
+    }
+    return 0;
+}
+
+/*! Free all pending expand callbacks of a handle
+ * @param[in]  h       CLIgen handle
+ */
+int
+cligen_expand_async_flush(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    struct expand_async  *ea;
+
+    while ((ea = ch->ch_expand_async) != NULL)
+	expand_async_remove(h, ea->ea_fd);
+    return 0;
+}
+
+static int expand_async_cb(int fd, void *arg);
+
+/*! Move a pending expand callback to another file descriptor
+ * The old file descriptor is unregistered, and a pending callback already waiting on
+ * the new one is replaced.
+ * @param[in]  h       CLIgen handle
+ * @param[in]  ea      Pending expand callback
+ * @param[in]  fd      New file descriptor
+ * @retval     0       OK
+ * @retval    -1       Error, ea is still registered on its old file descriptor
+ */
+static int
+expand_async_move(cligen_handle        h,
+		  struct expand_async *ea,
+		  int                  fd)
+{
+    expand_async_remove(h, fd);
+#if CLIGEN_REGFD
+    if (cligen_regfd(fd, expand_async_cb, ea) < 0)
+	return -1;
+    cligen_unregfd(ea->ea_fd);
+#endif
+    ea->ea_fd = fd;
+    return 0;
+}
+
+/*! File descriptor of a pending expand callback is readable, call it again
+ * Registered with cligen_regfd, and is called from getline when waiting for input.
+ * A complete result is added to the expand cache, if enabled, otherwise it is up to
+ * the application to keep it until the next expansion.
+ * @param[in]  fd      File descriptor
+ * @param[in]  arg     struct expand_async
+ */
+static int
+expand_async_cb(int   fd,
+		void *arg)
+{
+    struct expand_async  *ea = (struct expand_async *)arg;
+    cligen_handle         h = ea->ea_h;
+    struct cligen_handle *ch = handle(h);
+    cvec                 *commands = NULL;
+    cvec                 *helptexts = NULL;
+    int                   ret;
+
+    if ((commands = cvec_new(0)) == NULL ||
+	(helptexts = cvec_new(0)) == NULL)
+	goto done;
+    cligen_stats_inc(h, cs_expand_cb);
+    ch->ch_expand_fd = -1;
+    if ((ret = (*ea->ea_fn)(cligen_userhandle(h)?cligen_userhandle(h):h,
+			    ea->ea_fn_str,
+			    ea->ea_cvv,
+			    ea->ea_argv,
+			    commands,
+			    helptexts)) < 0){
+	expand_async_remove(h, fd); /* Frees ea, else the failing callback is called again */
+	goto done;
+    }
+    if (ret == CLIGEN_EXPAND_PENDING && ch->ch_expand_fd == fd)
+	goto done; /* Still pending, keep waiting */
+    if (ret == CLIGEN_EXPAND_PENDING && ch->ch_expand_fd >= 0){
+	/* Still pending on another file descriptor, replace the registration */
+	if (expand_async_move(h, ea, ch->ch_expand_fd) < 0)
+	    expand_async_remove(h, fd);
+	goto done;
+    }
+    if (ret != CLIGEN_EXPAND_PENDING && ea->ea_key && cligen_expand_cache(h) != 0){
+	if (expand_cache_add(h, ea->ea_fn, ea->ea_key, commands, helptexts) == NULL)
+	    goto done;
+	commands = helptexts = NULL; /* Consumed by cache */
+    }
+    expand_async_remove(h, fd); /* Frees ea */
+ done:
+    if (commands)
+	cvec_free(commands);
+    if (helptexts)
+	cvec_free(helptexts);
+    return 0;
+}
+
+/*! Add pending expand callback and register its file descriptor
+ * @param[in]  h       CLIgen handle
+ * @param[in]  fd      File descriptor given to cligen_expand_wait
+ * @param[in]  co      Expand variable
+ * @param[in]  cvv     Variable values of the command
+ * @param[in]  key     Expand cache key or NULL
+ */
+static int
+expand_async_add(cligen_handle h,
+		 int           fd,
+		 cg_obj       *co,
+		 cvec         *cvv,
+		 char         *key)
+{
+    int                   retval = -1;
+    struct cligen_handle *ch = handle(h);
+    struct expand_async  *ea;
+
+    if ((ea = malloc(sizeof(*ea))) == NULL)
+	goto done;
+    memset(ea, 0, sizeof(*ea));
+    ea->ea_h = h;
+    ea->ea_fd = fd;
+    ea->ea_fn = co->co_expandv_fn;
+    if ((co->co_expand_fn_str && (ea->ea_fn_str = strdup(co->co_expand_fn_str)) == NULL) ||
+	(co->co_expand_fn_vec && (ea->ea_argv = cvec_dup(co->co_expand_fn_vec)) == NULL) ||
+	(ea->ea_cvv = cvec_dup(cvv)) == NULL ||
+	(key && (ea->ea_key = strdup(key)) == NULL)){
+	expand_async_free(ea);
+	goto done;
+    }
+#if CLIGEN_REGFD
+    if (cligen_regfd(fd, expand_async_cb, ea) < 0){
+	expand_async_free(ea);
+	goto done;
+    }
+#endif
+    ea->ea_next = ch->ch_expand_async;
+    ch->ch_expand_async = ea;
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Wait for file descriptor of a pending expand callback to become readable
+ * @param[in]  fd      File descriptor
+ * @param[in]  ms      Max time to wait in milliseconds, <0: no limit
+ * @retval     1       Readable
+ * @retval     0       Timeout
+ * @retval    -1       Error
+ */
+static int
+expand_wait(int fd,
+	    int ms)
+{
+    struct pollfd pfd;
+    int           ret;
+
+    while (1){
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if ((ret = poll(&pfd, 1, ms>=0?ms:-1)) < 0){
+	    if (errno == EINTR)
+		continue;
+	    fprintf(stderr, "%s: poll: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	return ret > 0 ? 1 : 0;
+    }
+}
+
+/*! Insert one value of an expand callback result as a command in place of variable
+ * @param[in]  h         CLIgen handle
+ * @param[in]  co        Expand variable
+ * @param[in]  co_parent CLIgen object parent
+ * @param[in]  commands  Expanded values
+ * @param[in]  helptexts Help-texts of the values
+ * @param[in]  i         Position of value in commands
+ * @param[out] ptn       Parse-tree the command is appended to
+ * @retval     0         OK
+ * @retval    -1         Error
+ */
+static int
+expand_value_add(cligen_handle h,
+		 cg_obj       *co,
+		 cg_obj       *co_parent,
+		 cvec         *commands,
+		 cvec         *helptexts,
+		 int           i,
+		 parse_tree   *ptn)
+{
+    int         retval = -1;
+    char       *helpstr = NULL;
+    cg_obj     *con = NULL;
+    const char *value;
+    const char *escaped;
+
+    if (i < cvec_len(helptexts) &&
+	(helpstr = strdup(cv_string_get(cvec_i(helptexts, i)))) == NULL)
+	goto done;
+    if (co_expand_sub(co, co_parent, &con) < 0)
+	goto done;
+    cligen_stats_inc(h, cs_expand_copy);
+    if (pt_vec_append(ptn, con) < 0)
+	goto done;
+    value = cv_string_get(cvec_i(commands, i));
+    escaped = cligen_escape(value);
+    if (escaped == value) {
+	if ((escaped = strdup(escaped)) == NULL) /* XXX: leaks memory */
+	    goto done;
+    }
+    /* 'escaped' always points to mutable string */
+    if (transform_var_to_cmd(con, (char*)escaped, helpstr) < 0)
+	goto done;
+    retval = 0;
+ done:
+    if (helpstr)
+	free(helpstr);
+    return retval;
+}
+
 /*! Call expand callback and insert expanded commands in place of variable
  * variable argument callback variant
+ * If the expand cache is enabled, a cached result of the callback with the same
+ * arguments and variable values is used instead of calling the callback.
+ * A pending callback is called again when its file descriptor is readable. On TAB
+ * and '?' at most until the expand deadline, then the partial result is used.
+ * If prefix is set, only values starting with it, ie that may match the next token, are
+ * inserted. Using the expand cache, they are found in a sorted index of the result.
+ * At least one value is inserted so that the level is not taken as the end of the syntax.
  * @param[in]  h       CLIgen handle
  * @param[in]  co      CLIgen object
  * @param[out] cvv     Cligen variable vector containing vars/values pair for completion
+ * @param[in]  prefix  Only insert values starting with prefix, or NULL for all
  * @param[out] ptn     New parse-tree initially an empty pointer, its value is returned.
  * @param[in]  co      CLIgen object parent
  * @retval     0       OK
@@ -437,64 +1147,137 @@ static int
 pt_expand_fnv(cligen_handle h, 
 	      cg_obj       *co,     
 	      cvec         *cvv,
+	      const char   *prefix,
 	      parse_tree   *ptn,
 	      cg_obj       *co_parent)
 {
-    int         retval = -1;
-    cvec       *commands = cvec_new(0);
-    cvec       *helptexts = cvec_new(0);
-    cg_var     *cv = NULL;
-    char       *helpstr;
-    cg_obj     *con = NULL;
-    int         i;
-    const char *value;
-    const char *escaped;
+    int                  retval = -1;
+    cvec                *commands = NULL;
+    cvec                *helptexts = NULL;
+    int                  i;
+    int                  len;
+    int                  n = 0; /* Inserted values */
+    int                  first;
+    size_t               plen;
+    const char          *value;
+    uint64_t             t0;
+    cbuf                *cbkey = NULL;
+    struct expand_cache *ec = NULL;
+    struct cligen_handle *ch = handle(h);
+    int                  deadline = 0;
+    int                  ms = -1;
+    int                  ret;
+    int                  fd = -1;
 
     if (cvv == NULL){
 	errno = EINVAL;
 	goto done;
     }
-    if ((*co->co_expandv_fn)(cligen_userhandle(h)?cligen_userhandle(h):h, 
-			     co->co_expand_fn_str, 
-			     cvv,
-			     co->co_expand_fn_vec,
-			     commands, 
-			     helptexts) < 0)
-	goto done;
-    i = 0;
-    while ((cv = cvec_each(commands, cv)) != NULL) {
-	if (i < cvec_len(helptexts))
-	    helpstr = strdup(cv_string_get(cvec_i(helptexts, i)));
-	else
-	    helpstr = NULL;
-	i++;
-	con = NULL;
-	if (co_expand_sub(co, co_parent, &con) < 0)
+    if (cligen_expand_cache(h) != 0){
+	if ((cbkey = cbuf_new()) == NULL)
 	    goto done;
-	if (pt_vec_append(ptn, con) < 0)
-	    goto done;
-	value = cv_string_get(cv);
-	escaped = cligen_escape(value);
-	if (escaped == value) {
-	    if ((escaped = strdup(escaped)) == NULL) /* XXX: leaks memory */
+	expand_cache_key(co, cvv, cbkey);
+	ec = expand_cache_get(h, co->co_expandv_fn, cbuf_get(cbkey));
+    }
+    if (ch->ch_completing)
+	deadline = cligen_expand_deadline(h);
+    if (ec == NULL){
+	t0 = cligen_stats_ns();
+	while (1){
+	    if (commands)
+		cvec_free(commands);
+	    if (helptexts)
+		cvec_free(helptexts);
+	    if ((commands = cvec_new(0)) == NULL ||
+		(helptexts = cvec_new(0)) == NULL)
+		goto done;
+	    cligen_stats_inc(h, cs_expand_cb);
+	    ch->ch_expand_fd = -1;
+	    if ((ret = (*co->co_expandv_fn)(cligen_userhandle(h)?cligen_userhandle(h):h, 
+					    co->co_expand_fn_str, 
+					    cvv,
+					    co->co_expand_fn_vec,
+					    commands, 
+					    helptexts)) < 0)
+		goto done;
+	    if (ret != CLIGEN_EXPAND_PENDING || (fd = ch->ch_expand_fd) < 0){
+		fd = -1;
+		break;
+	    }
+	    expand_async_remove(h, fd); /* From an earlier completion */
+	    if (deadline > 0 &&
+		(ms = deadline - (int)((cligen_stats_ns() - t0)/1000000)) < 0)
+		ms = 0;
+	    if ((ret = expand_wait(fd, ms)) < 0)
+		goto done;
+	    if (ret == 0) /* Deadline passed, fd is pending */
+		break;
+	}
+	cligen_stats_add(h, cs_expand_cb_ns, cligen_stats_ns() - t0);
+	if (fd != -1){
+	    ch->ch_expand_pending++;
+	    if (expand_async_add(h, fd, co, cvv, cbkey?cbuf_get(cbkey):NULL) < 0)
+		goto done;
+	}
+	else if (cbkey){
+	    if ((ec = expand_cache_add(h, co->co_expandv_fn, cbuf_get(cbkey),
+				       commands, helptexts)) == NULL)
 		goto done;
+	    commands = helptexts = NULL; /* Consumed by cache */
 	}
-	/* 'escaped' always points to mutable string */
-	if (transform_var_to_cmd(con, (char*)escaped, helpstr) < 0)
+    }
+    if (ec){
+	commands = ec->ec_commands;
+	helptexts = ec->ec_helptexts;
+    }
+    len = cvec_len(commands);
+    if (prefix == NULL){
+	for (i=0; i<len; i++)
+	    if (expand_value_add(h, co, co_parent, commands, helptexts, i, ptn) < 0)
+		goto done;
+	n = len;
+    }
+    else if (ec){ /* Values starting with prefix are adjacent in the sorted index */
+	if (expand_cache_index(ec) < 0)
 	    goto done;
-	if (helpstr){
-	    free(helpstr);
-	    helpstr = NULL;
+	for (i=0; i<ec->ec_speciallen; i++)
+	    if (expand_value_add(h, co, co_parent, commands, helptexts,
+				 ec->ec_special[i], ptn) < 0)
+		goto done;
+	n = ec->ec_speciallen + expand_cache_range(ec, prefix, &first);
+	for (i=first; i<first+n-ec->ec_speciallen; i++)
+	    if (expand_value_add(h, co, co_parent, commands, helptexts,
+				 ec->ec_index[i].ev_pos, ptn) < 0)
+		goto done;
+    }
+    else{
+	plen = strlen(prefix);
+	for (i=0; i<len; i++){
+	    value = cv_string_get(cvec_i(commands, i));
+	    if (expand_value_plain(value) && strncmp(value, prefix, plen) != 0)
+		continue;
+	    if (expand_value_add(h, co, co_parent, commands, helptexts, i, ptn) < 0)
+		goto done;
+	    n++;
 	}
     }
-    if (commands)
-	cvec_free(commands);
-    if (helptexts)
-	cvec_free(helptexts);
+    if (n == 0 && len > 0){ /* Keep the level, the value does not match the token */
+	if (expand_value_add(h, co, co_parent, commands, helptexts, 0, ptn) < 0)
+	    goto done;
+	n++;
+    }
+    cligen_stats_add(h, cs_expand_skip, len - n);
     retval = 0;
  done:
+    if (ec == NULL){ /* Not owned by cache */
+	if (commands)
+	    cvec_free(commands);
+	if (helptexts)
+	    cvec_free(helptexts);
+    }
+    if (cbkey)
+	cbuf_free(cbkey);
     return retval;
-
 }
 
 /*! Expand a choice rule with actual commands
@@ -542,6 +1325,13 @@ pt_expand_choice(cg_obj       *co,
  * The structure of the new parsetree ptn is a little peculiar, it only creates a new top-level
  * with new, temporary expanded cg-objects, but they in turn point back to the original
  * parse-tree. Therefore this new parse-tree cannot be free:d recursively.
+ * The original level is sorted once, see pt_sorted_get. Static objects keep its order in
+ * ptn, only objects of choice and expand variables are sorted and merged into them.
+ * In lazy mode (see cligen_expand_lazy_set), static commands are not copied, the original
+ * objects are referenced from ptn instead.
+ * Objects of a frozen parse-tree (see pt_freeze) are always copied since match flags are
+ * set in ptn, and tree references are taken from the private copy of the level made by
+ * pt_expand_treeref().
  * @param[in]  h       Cligen handle
  * @param[in]  pt      Original parse-tree consisting of a vector of cligen objects
  * @param[out] cvv     Cligen variable vector containing vars/values pair for completion
@@ -550,6 +1340,7 @@ pt_expand_choice(cg_obj       *co,
  * @param[out] ptn     New parse-tree initially an empty pointer, its value is returned.
  * @retval     0       OK
  * @retval    -1       Error
+ * @see pt_expand_match  Only expand values that may match the next token
  */
 int
 pt_expand(cligen_handle h, 
@@ -559,27 +1350,87 @@ pt_expand(cligen_handle h,
 	  int           expandvar,
 	  parse_tree   *ptn)
 {
-    int     i;
-    cg_obj *co;
-    cg_obj *con = NULL;
-    int     retval = -1;
+    return pt_expand_match(h, pt, cvv, hide, expandvar, NULL, ptn);
+}
+
+/*! Take a pattern pt and expand <variables> with values that may match the next token
+ * Same as pt_expand, but values of expand callbacks are only inserted if they start with
+ * prefix, the token that is matched against ptn next, since other values cannot match.
+ * Large expand results are then not copied into ptn for every matched level.
+ * The prefix is not used if it is empty, contains characters that are escaped, or if
+ * pt is a set, where more than one token is matched in ptn.
+ * @param[in]  h       Cligen handle
+ * @param[in]  pt      Original parse-tree consisting of a vector of cligen objects
+ * @param[out] cvv     Cligen variable vector containing vars/values pair for completion
+ * @param[in]  hide    If not set, include hidden commands. If set, do not include hidden commands. 
+ * @param[in]  expandvar Set if VARS should be expanded, eg ? <tab>
+ * @param[in]  prefix  Next token to be matched in ptn, or NULL for all values
+ * @param[out] ptn     New parse-tree initially an empty pointer, its value is returned.
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see pt_expand
+ */
+int
+pt_expand_match(cligen_handle h, 
+		parse_tree   *pt, 
+		cvec         *cvv,
+		int           hide,
+		int           expandvar,
+		const char   *prefix,
+		parse_tree   *ptn)
+{
+    int         i;
+    cg_obj     *co;
+    cg_obj     *con = NULL;
+    int         retval = -1;
+    int         lazy;
+    int         frozen;
+    parse_tree *pto;
+    int         len;
+    int         isstatic = 1; /* No choice or expand variables */
+    parse_tree *pte = NULL;   /* Objects of choice and expand variables */
 
+    cligen_stats_inc(h, cs_expand);
+    if ((frozen = (pt_frozen_get(pt) == 1)) != 0){
+	if (pt_overlay_get(h, pt, 0, &pto) < 0)
+	    goto done;
+	if (pto != NULL)
+	    pt = pto;
+    }
+    /* Original levels are sorted once, lower levels when they are first expanded */
+    if (pt_frozen_get(pt) != 1 && pt_sorted_get(pt) != 1)
+	cligen_parsetree_sort(pt, 0);
+    lazy = cligen_expand_lazy(h) && !frozen;
+    if (prefix && (*prefix == '\0' || pt_sets_get(pt) ||
+		   strpbrk(prefix, "\"?\\ \t") != NULL))
+	prefix = NULL;
     pt_sets_set(ptn, pt_sets_get(pt));
+    pt_borrow_set(ptn, lazy);
     if (pt_len_get(pt) == 0)
 	goto ok;
     for (i=0; i<pt_len_get(pt); i++){ /* Build ptn (new) from pt (orig) */
 	if ((co = pt_vec_i_get(pt, i)) != NULL){
-	    if (co_value_set(co, NULL) < 0)
+	    if (!co_flags_get(co, CO_FLAGS_FROZEN) &&
+		co_value_set(co, NULL) < 0)
 		goto done;
 	    if (hide && co_flags_get(co, CO_FLAGS_HIDE))
 		continue;
+	    /* Map expand function on first use, see cligen_str2fn_lazy_set */
+	    if (co->co_type == CO_VARIABLE && co->co_expandv_fn == NULL &&
+		cligen_expandv_bind(h, co) < 0)
+		goto done;
 	    /*
 	     * Choice variable - Insert the static choices as commands in place
 	     * of the variable
 	     */
 	    if (co->co_type == CO_VARIABLE && co->co_choice != NULL){
-		if (pt_expand_choice(co, ptn) < 0)
+		isstatic = 0;
+		if (pte == NULL && (pte = pt_new()) == NULL)
 		    goto done;
+		len = pt_len_get(pte);
+		if (pt_expand_choice(co, pte) < 0)
+		    goto done;
+		cligen_stats_add(h, cs_expand_copy, pt_len_get(pte) - len);
 	    }
 	    /* Expand variable - call expand callback and insert expanded
 	     * commands in place of the variable
@@ -594,15 +1445,26 @@ pt_expand(cligen_handle h,
 		 * MAYBE you could see if there are any other same variables on
 		 * this iteration and if not add it?
 		 */
-		if (expandvar)
-		    if (pt_expand_fnv(h, co, cvv, ptn, NULL) < 0)
+		isstatic = 0;
+		if (expandvar){
+		    if (pte == NULL && (pte = pt_new()) == NULL)
+			goto done;
+		    if (pt_expand_fnv(h, co, cvv, prefix, pte, NULL) < 0)
 			goto done;
+		}
+	    }
+	    else if (lazy && co->co_type == CO_COMMAND && co_ref_get(co) == NULL){
+		/* Reference static original cg_obj in shadow list */
+		cligen_stats_inc(h, cs_expand_borrow);
+		if (pt_vec_append(ptn, co) < 0)
+		    goto done;
 	    }
 	    else{
 		/* Copy original cg_obj to shadow list*/
 		con = NULL;
 		if (co_expand_sub(co, NULL, &con) < 0)
 		    goto done;
+		cligen_stats_inc(h, cs_expand_copy);
 		if (pt_vec_append(ptn, con) < 0)
 		    goto done;
 	    }
@@ -611,7 +1473,27 @@ pt_expand(cligen_handle h,
 	    pt_realloc(ptn); /* empty child */
 	}
     } /* for */
-    cligen_parsetree_sort(ptn, 1);
+    /* Static objects are in the order of the sorted original, only expanded
+     * objects are sorted and merged into them */
+    if (pt_sorted_get(pt) == 1){
+	pt_sorted_set(ptn, 1);
+	if (pte && pt_sort_merge(ptn, pte) < 0)
+	    goto done;
+    }
+    else{ /* Frozen level sorted in other collation */
+	for (i=0; pte && i<pt_len_get(pte); i++){
+	    if (pt_vec_append(ptn, pt_vec_i_get(pte, i)) < 0)
+		goto done;
+	    pt_vec_i_clear(pte, i);
+	}
+	cligen_parsetree_sort(ptn, 0);
+    }
+    /* Help tables of a static level can be cached, see print_help_lines */
+    if (pt_help_source_set(ptn, isstatic ? pt : NULL, hide) < 0)
+	goto done;
+    /* Children of a static level are in the same positions unless hidden or resorted */
+    if (pt_index_source_set(ptn, isstatic && pt_sorted_get(pt) == 1 ? pt : NULL) < 0)
+	goto done;
     if (cligen_logsyntax(h) > 0){
 	fprintf(stderr, "%s:\n", __FUNCTION__);
 	pt_print(stderr, ptn, 0);
@@ -619,11 +1501,15 @@ pt_expand(cligen_handle h,
  ok:
     retval = 0;
  done:
+    if (pte)
+	pt_free(pte, 0);
     return retval;
 }
 
 /*! Go through tree and clean & delete all extra memory from pt_expand_treeref()
  * More specifically, delete all expanded subtrees co_ref
+ * This is not necessary after each evaluation, since expansions are re-used
+ * until invalidated, see cligen_ph_treeref_validate()
  * @param[in] pt   Parsetree
  * @retval    0    OK
  * @retval   -1    Error
@@ -636,6 +1522,8 @@ pt_expand_treeref_cleanup(parse_tree *pt)
     int     i;
     cg_obj *co;
 
+    if (pt_frozen_get(pt) == 1) /* Never expanded in place, see pt_overlay_flush */
+	return 0;
     for (i=0; i<pt_len_get(pt); i++){
       again:
 	if ((co = pt_vec_i_get(pt, i)) != NULL){
@@ -673,6 +1561,8 @@ pt_expand_cleanup(parse_tree *pt)
     int         i;
     cg_obj     *co;
 
+    if (pt_frozen_get(pt) == 1) /* co_value is never set in a frozen tree */
+	return 0;
     for (i=0; i<pt_len_get(pt); i++){
 	if ((co = pt_vec_i_get(pt, i)) != NULL){
 	    if (co_value_set(co, NULL) < 0)
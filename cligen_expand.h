@@ -47,8 +47,13 @@
  */
 int pt_expand_treeref(cligen_handle h, cg_obj *coprev, parse_tree *pt);
 int pt_expand(cligen_handle h, parse_tree *pt, cvec *cvec, int hide, int expandv, parse_tree *ptn);
+int pt_expand_match(cligen_handle h, parse_tree *pt, cvec *cvec, int hide, int expandv,
+		    const char *prefix, parse_tree *ptn);
 int pt_expand_treeref_cleanup(parse_tree *pt);
 int pt_expand_cleanup(parse_tree *pt);
+int pt_overlay_flush(cligen_handle h);
+int cligen_expand_cache_flush(cligen_handle h);
+int cligen_expand_async_flush(cligen_handle h);
 int reference_path_match(cg_obj *co1, parse_tree *pt0, cg_obj **co0p);
 int transform_var_to_cmd(cg_obj *co, char *cmd, char *comment);
 
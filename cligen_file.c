@@ -37,10 +37,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include <errno.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/select.h>
 #include <netinet/in.h>
 
 #include <cligen/cligen.h>
@@ -121,6 +124,106 @@ callback(cligen_handle handle, cvec *cvv, cvec *argv)
     return 0;
 }
 
+/*! CLI callback that fails, used to test error reporting
+ */
+static int
+fail_cb(cligen_handle handle, cvec *cvv, cvec *argv)
+{
+    return -1;
+}
+
+/*! Print command path of a matched object, eg " a <x> y"
+ */
+static void
+trace_path_print(FILE   *f,
+		 cg_obj *co)
+{
+    if (co_up(co))
+	trace_path_print(f, co_up(co));
+    fprintf(f, co->co_type == CO_VARIABLE ? " <%s>" : " %s", co->co_command);
+}
+
+/*! Trace hook printing command path and time of each phase in ns on stderr
+ */
+static int
+trace_cb(cligen_handle h,
+	 cligen_trace *ct,
+	 void         *arg)
+{
+    int i;
+
+    fprintf(stderr, "trace \"%s\" result %d", ct->ct_cmd, ct->ct_result);
+    if (ct->ct_co){
+	fprintf(stderr, " path");
+	trace_path_print(stderr, ct->ct_co);
+    }
+    for (i=0; i<CT_NPHASES; i++)
+	if (ct->ct_phase_start[i])
+	    fprintf(stderr, " %s %" PRIu64, cligen_trace_phase2str(i), ct->ct_ns[i]);
+    fprintf(stderr, "\n");
+    return 0;
+}
+
+cgv_fnstype_t *str2fn(char *name, void *arg, char **error);
+
+/*! CLI callback adding or removing commands of a clispec fragment to a tree
+ * Format of argv:
+ *   <treename>
+ * The fragment is the last variable, eg:
+ *   delta add <spec:rest>, delta_add("dyn");
+ * @see cligen_ph_delta_add
+ */
+static int
+delta_cb(cligen_handle h,
+	 cvec         *cvv,
+	 cvec         *argv,
+	 int           add)
+{
+    int         retval = -1;
+    pt_head    *ph;
+    parse_tree *pt1 = NULL;
+    char       *treename;
+
+    if (argv == NULL || cvec_len(argv) != 1 || cvec_len(cvv) < 2){
+	fprintf(stderr, "%s: requires a treename argument and a clispec variable\n", __FUNCTION__);
+	goto done;
+    }
+    treename = cv_string_get(cvec_i(argv, 0));
+    if ((ph = cligen_ph_find(h, treename)) == NULL){
+	fprintf(stderr, "%s: tree %s not found\n", __FUNCTION__, treename);
+	goto done;
+    }
+    if ((pt1 = pt_new()) == NULL)
+	goto done;
+    if (cligen_parse_str(h, cv_string_get(cvec_i(cvv, cvec_len(cvv)-1)), "delta", pt1, NULL) < 0)
+	goto done;
+    if (cligen_callbackv_str2fn(pt1, str2fn, NULL) < 0)
+	goto done;
+    if (add){
+	if (cligen_ph_delta_add(ph, pt1) < 0)
+	    goto done;
+    }
+    else if (cligen_ph_delta_del(ph, pt1) < 0)
+	goto done;
+    retval = 0;
+ done:
+    if (pt1)
+	pt_free(pt1, 1);
+    return retval;
+}
+
+static int
+delta_add_cb(cligen_handle h, cvec *cvv, cvec *argv)
+{
+    return delta_cb(h, cvv, argv, 1);
+}
+
+static int
+delta_del_cb(cligen_handle h, cvec *cvv, cvec *argv)
+{
+    return delta_cb(h, cvv, argv, 0);
+}
+
 /*! Example of static string to function mapper
  * Note, the syntax need to something like: "a{help}, callback(42)"
  */
@@ -132,9 +235,94 @@ str2fn(char *name, void *arg, char **error)
 	return callback;
     if (strcmp(name, "cligen_exec_cb") == 0)
 	return cligen_exec_cb;
+    if (strcmp(name, "fail") == 0)
+	return fail_cb;
+    if (strcmp(name, "delta_add") == 0)
+	return delta_add_cb;
+    if (strcmp(name, "delta_del") == 0)
+	return delta_del_cb;
+    if (strcmp(name, "cligen_wp_set") == 0)
+	return cligen_wp_set;
+    if (strcmp(name, "cligen_wp_up") == 0)
+	return cligen_wp_up;
     return callback; /* allow any function (for testing) */
 }
 
+/* Latency of simulated slow backend of the slow() expand function */
+#define SLOW_MS 200
+
+static int slow_fd = -1;  /* Pending request to slow backend */
+static int slow_done = 0; /* Slow backend has replied */
+static int slow_hops = 0; /* Replies that were new requests */
+
+/*! Expansion function with a simulated slow backend, for testing expand deadlines
+ * A request is made by forking a process that replies on a pipe after SLOW_MS.
+ * Until then, slow1 is returned as partial result and the expansion is pending.
+ * @param[in]  hops  Number of times the reply is a new request on another pipe
+ * @param[in]  fail  Fail when the reply is read
+ */
+static int
+cli_expand_slow(cligen_handle h,
+		cvec         *commands,
+		cvec         *helptexts,
+		int           hops,
+		int           fail)
+{
+    int            p[2];
+    char           c;
+    fd_set         fdset;
+    struct timeval tv = {0, 0};
+    int            fd;
+    int            ret;
+
+    if (cvec_len(commands) == 0){
+	cvec_add_string(commands, NULL, "slow1"); cvec_add_string(helptexts, NULL, "Help slow1");
+    }
+    if (slow_done){
+	cvec_add_string(commands, NULL, "slow2"); cvec_add_string(helptexts, NULL, "Help slow2");
+	return 0;
+    }
+    if (slow_fd == -1){ /* Send request */
+	if (pipe(p) < 0)
+	    return -1;
+	switch (fork()){
+	case -1:
+	    return -1;
+	case 0:
+	    usleep(SLOW_MS*1000);
+	    if (write(p[1], "x", 1) < 0)
+		_exit(1);
+	    _exit(0);
+	}
+	close(p[1]);
+	slow_fd = p[0];
+    }
+    FD_ZERO(&fdset);
+    FD_SET(slow_fd, &fdset);
+    if (select(slow_fd+1, &fdset, NULL, NULL, &tv) > 0){ /* Reply */
+	if (read(slow_fd, &c, 1) < 0)
+	    return -1;
+	fd = slow_fd;
+	slow_fd = -1;
+	wait(NULL);
+	if (fail){
+	    close(fd);
+	    return -1;
+	}
+	if (slow_hops++ < hops){ /* New request on another pipe */
+	    ret = cli_expand_slow(h, commands, helptexts, hops, fail);
+	    close(fd);
+	    return ret;
+	}
+	close(fd);
+	slow_done++;
+	cvec_add_string(commands, NULL, "slow2"); cvec_add_string(helptexts, NULL, "Help slow2");
+	return 0;
+    }
+    cligen_expand_wait(h, slow_fd);
+    return CLIGEN_EXPAND_PENDING;
+}
+
 /*! Example of expansion(completion) function. 
  * It is called every time a variable of the form <expand> needs to be evaluated.
  * Note the mallocing of vectors which could probably be done in a
@@ -150,7 +338,25 @@ cli_expand_cb(cligen_handle h,
 	      cvec         *commands,     /* vector of function strings */
 	      cvec         *helptexts)   /* vector of help-texts */
 {
+    char name[16];
+    int  i;
+
 #if 1
+    if (strcmp(fn_str,"slow")==0)
+	return cli_expand_slow(h, commands, helptexts, 0, 0);
+    if (strcmp(fn_str,"slowhop")==0)
+	return cli_expand_slow(h, commands, helptexts, 1, 0);
+    if (strcmp(fn_str,"slowfail")==0)
+	return cli_expand_slow(h, commands, helptexts, 0, 1);
+    /* Large expand set: if0..if999 */
+    if (strcmp(fn_str,"many")==0){
+	for (i=0; i<1000; i++){
+	    snprintf(name, sizeof(name), "if%d", i);
+	    cvec_add_string(commands, NULL, name);
+	    cvec_add_string(helptexts, NULL, "Help many");
+	}
+	return 0;
+    }
     /* Special case for two partly overlapping expand sets */
     if (strcmp(fn_str,"exp")==0){
 	cvec_add_string(commands, NULL, "exp1"); cvec_add_string(helptexts, NULL, "Help exp1");
@@ -175,23 +381,172 @@ str2fn_exp(char *name, void *arg, char **error)
     return cli_expand_cb;
 }
 
+/*! Load a parse-tree from a clispec file on first use and map its callbacks
+ * @param[in]  h    CLIgen handle
+ * @param[in]  ph   Parse-tree header
+ * @param[in]  arg  Clispec filename
+ * @see cligen_ph_loader_file
+ */
+static int
+cligen_file_loader(cligen_handle h,
+		   pt_head      *ph,
+		   void         *arg)
+{
+    if (cligen_ph_loader_file(h, ph, arg) < 0)
+	return -1;
+    return cligen_callbackv_str2fn(cligen_ph_parsetree_get(ph), str2fn, NULL);
+}
+
+/*! Freeze parse-trees of a handle and create a second handle sharing them
+ * Used to test shared frozen parse-trees, see pt_freeze
+ * @param[in]  h0   CLIgen handle owning the parse-trees
+ * @retval     h    New CLIgen handle, free with cligen_exit
+ * @retval     NULL Error
+ */
+static cligen_handle
+cligen_file_share(cligen_handle h0)
+{
+    cligen_handle h;
+    pt_head      *ph0 = NULL;
+    pt_head      *ph;
+    parse_tree   *pt;
+    char         *name;
+
+    if ((h = cligen_init()) == NULL)
+	return NULL;
+    while ((ph0 = cligen_ph_each(h0, ph0)) != NULL){
+	if ((pt = cligen_ph_parsetree_get(ph0)) == NULL)
+	    continue;
+	name = cligen_ph_name_get(ph0);
+	if (pt_freeze(pt) < 0)
+	    goto err;
+	if ((ph = cligen_ph_add(h, name)) == NULL)
+	    goto err;
+	if (cligen_ph_parsetree_set(ph, pt) < 0)
+	    goto err;
+	if (cligen_ph_active_get(h0) == pt)
+	    cligen_ph_active_set(h, name);
+    }
+    cligen_prompt_set(h, cligen_prompt(h0));
+    cligen_comment_set(h, cligen_comment(h0));
+    cligen_tabmode_set(h, cligen_tabmode(h0));
+    cligen_line_scrolling_set(h, cligen_line_scrolling(h0));
+    cligen_preference_mode_set(h, cligen_preference_mode(h0));
+    cligen_expand_lazy_set(h, cligen_expand_lazy(h0));
+    cligen_expand_cache_set(h, cligen_expand_cache(h0));
+    cligen_expand_deadline_set(h, cligen_expand_deadline(h0));
+    cligen_batch_pipeline_set(h, cligen_batch_pipeline(h0));
+    if (cligen_trace_get(h0, NULL) &&
+	cligen_trace_set(h, trace_cb, NULL) < 0)
+	goto err;
+    return h;
+ err:
+    cligen_exit(h);
+    return NULL;
+}
+
+/*! Evaluate stdin in sessions of a handle, as a server pushing input of many users
+ * Lines of stdin are fed to the sessions in turn, and the output of each session is
+ * written on stdout after each line.
+ * Used to test the session API, see cligen_session.h
+ * @param[in]  h     CLIgen handle
+ * @param[in]  nr    Number of sessions
+ */
+static int
+cligen_file_sessions(cligen_handle h,
+		     int           nr)
+{
+    int              retval = -1;
+    cligen_session **sv = NULL;
+    char            *buf = NULL;
+    size_t           buflen = 0;
+    ssize_t          len;
+    char            *out;
+    size_t           outlen;
+    size_t           sz = 0;
+    int              i;
+    int              ev;
+    int              n;
+
+    if (nr < 1)
+	nr = 1;
+    if ((sv = calloc(nr, sizeof(*sv))) == NULL)
+	goto done;
+    for (i=0; i<nr; i++)
+	if ((sv[i] = cligen_session_new(h)) == NULL ||
+	    cligen_session_start(sv[i]) < 0)
+	    goto done;
+    n = nr; /* Sessions not ended */
+    i = 0;
+    while (n > 0 && (len = getline(&buf, &buflen, stdin)) >= 0){
+	while (sv[i] == NULL)
+	    i = (i+1) % nr;
+	if ((ev = cligen_session_feed(sv[i], buf, len)) < 0)
+	    goto done;
+	if (ev & CLIGEN_SESSION_OUTPUT){
+	    out = cligen_session_output(sv[i], &outlen);
+	    fwrite(out, 1, outlen, stdout);
+	    cligen_session_output_reset(sv[i]);
+	}
+	if (ev & CLIGEN_SESSION_EXIT){
+	    cligen_session_free(sv[i]);
+	    sv[i] = NULL;
+	    n--;
+	}
+	i = (i+1) % nr;
+    }
+    fflush(stdout);
+    for (i=0; i<nr; i++)
+	if (sv[i])
+	    sz += cligen_session_memsize(sv[i]);
+    fprintf(stderr, "session_mem %zu\n", nr?sz/nr:0);
+    retval = 0;
+ done:
+    if (sv){
+	for (i=0; i<nr; i++)
+	    if (sv[i])
+		cligen_session_free(sv[i]);
+	free(sv);
+    }
+    if (buf)
+	free(buf);
+    return retval;
+}
+
 /*
  * Global variables.
  */
 static void 
 usage(char *argv)
 {
-    fprintf(stderr, "Usage:%s [-h][-f <filename>][-1][-p][-P], where the optoions have the following meaning:\n"
+    fprintf(stderr, "Usage:%s [-h][-f <filename>][-j <nr>][-i <image>][-c <image>][-1][-b][-B][-F][-S][-p][-P], where the optoions have the following meaning:\n"
 	    "\t-h \t\tHelp\n"
-	    "\t-f <file> \tConfig-file (or stdin)\n"
+	    "\t-f <file> \tConfig-file (or stdin), may be given several times\n"
+	    "\t-j <nr> \tParse config-files in parallel with <nr> threads, 0: one per processor\n"
+	    "\t-i <file> \tLoad precompiled parse-tree image instead of config-file\n"
+	    "\t-c <file> \tCompile: write parse-tree image of config-file to file\n"
+	    "\t-T <name>=<file> Load tree <name> from clispec <file> on first use\n"
 	    "\t-1 \t\tOnce only. Do not enter interactive mode\n"
+	    "\t-b \t\tBatch mode. Evaluate commands from stdin non-interactively\n"
+	    "\t-l <nr> \tIn batch mode, parse up to <nr> lines ahead of callbacks called in a thread\n"
+	    "\t-F \t\tFreeze parse-trees and evaluate commands in a second handle sharing them\n"
+	    "\t-m <nr> \tFeed lines of stdin in turn to <nr> sessions, see cligen_session.h\n"
+	    "\t-S \t\tPrint hot-path counters of evaluations on stderr on exit\n"
+	    "\t-r \t\tTrace: print command path and ns of each evaluation phase on stderr\n"
+	    "\t-M \t\tPrint memory use of the handle and its parse-trees on stderr after loading\n"
 	    "\t-p \t\tPrint syntax\n"
 	    "\t-e \t\tSet automatic expansion/completion for all expand() functions\n"
 	    "\t-P \t\tSet preference mode to 1, ie return first if several have same pref\n"
 	    "\t-t <nr> \tSet tab mode: 1:columns, 2: same pref for vars, 4: all steps\n"
 	    "\t-s <nr> \tScrolling 0: disable line scrolling, 1: enable line scrolling (default 1)\n"
+	    "\t-L <nr> \tLazy expansion 0: copy all objects, 1: reference static commands (default 1)\n"
+	    "\t-B \t\tBind callback and expand functions when first called, not when loaded\n"
+	    "\t-x <ms> \tCache expand callback results for <ms> milliseconds, -1: forever (default 0: off)\n"
+	    "\t-D <ms> \tDeadline of expand callbacks on TAB and ?, 0: no deadline (default)\n"
+	    "\t-H <file> \tAppend each command to history file, compact it at twice the history size\n"
+	    "\t-n <nr> \tNumber of history lines (default %d)\n"
 	    ,
-	    argv);
+	    argv, CLIGEN_HISTSIZE_DEFAULT);
     exit(0);
 }
 
@@ -205,8 +560,9 @@ main(int argc, char *argv[])
     FILE       *f = stdin;
     char       *argv0 = argv[0];
     char       *filename=NULL;
-    cvec       *globals;   /* global variables from syntax */
+    cvec       *globals = NULL; /* global variables from syntax */
     cligen_handle  h;
+    cligen_handle  h1 = NULL; /* Handle sharing frozen parse-trees of h */
     char       *str;
     int         once = 0;
     int         print_syntax = 0;
@@ -214,6 +570,31 @@ main(int argc, char *argv[])
     int         set_preference = 0;
     int         tabmode = 0;
     int         scrollmode = 0;
+    int         lazy = 1;
+    int         lazybind = 0;
+    int         expand_cache = 0;
+    int         expand_deadline = 0;
+    int         pipeline = 0;
+    int         batch = 0;
+    int         nerr = 0;
+    int         freeze = 0;
+    int         stats = 0;
+    int         trace = 0;
+    int         memsize = 0;
+    cligen_memsize cm = {0,};
+    int         image = 0;
+    char       *imagefile = NULL; /* Write parse-tree image to this file */
+    FILE       *fi;
+    char       *histfile = NULL;
+    FILE       *fh = NULL;
+    char       *loadtree = NULL; /* <name>=<file> of tree loaded on demand */
+    char       *loadfile;
+    int         histlines = CLIGEN_HISTSIZE_DEFAULT;
+    char      **files = NULL; /* Config-files given with -f */
+    int         nfiles = 0;
+    int         jobs = 0;
+    int         parallel = 0;
+    int         sessions = 0;
 
     argv++;argc--;
     for (;(argc>0)&& *argv; argc--, argv++){
@@ -229,6 +610,21 @@ main(int argc, char *argv[])
 	case '1': /* quit directly */
 	    once++;
 	    break;
+	case 'b': /* batch mode */
+	    batch++;
+	    break;
+	case 'F': /* freeze and share parse-trees */
+	    freeze++;
+	    break;
+	case 'S': /* print stats */
+	    stats++;
+	    break;
+	case 'r': /* trace evaluations */
+	    trace++;
+	    break;
+	case 'M': /* print memory use */
+	    memsize++;
+	    break;
 	case 'p': /* print syntax */
 	    print_syntax++;
 	    break;
@@ -239,12 +635,33 @@ main(int argc, char *argv[])
 	    set_preference++;
 	    break;
 	case 'f' : 
+	    argc--;argv++;
+	    filename = *argv;
+	    if ((files = realloc(files, (nfiles+1)*sizeof(char *))) == NULL){
+		fprintf(stderr, "realloc: %s\n", strerror(errno));
+		exit(1);
+	    }
+	    files[nfiles++] = filename;
+	    break;
+	case 'j' : /* parse files in parallel */
+	    argc--;argv++;
+	    if (*argv == NULL)
+		usage(argv0);
+	    jobs = atoi(*argv);
+	    parallel++;
+	    break;
+	case 'i' : /* load image */
 	    argc--;argv++;
 	    filename = *argv;
 	    if ((f = fopen(filename, "r")) == NULL){
 		fprintf(stderr, "fopen(%s): %s\n", filename, strerror(errno));
 		exit(1);
 	    }
+	    image++;
+	    break;
+	case 'c' : /* compile image */
+	    argc--;argv++;
+	    imagefile = *argv;
 	    break;
 	case 's': /* line scrolling mode */
 	    argc--;argv++;
@@ -254,6 +671,45 @@ main(int argc, char *argv[])
 	    argc--;argv++;
 	    tabmode = atoi(*argv);
 	    break;
+	case 'L': /* lazy expansion mode */
+	    argc--;argv++;
+	    lazy = atoi(*argv);
+	    break;
+	case 'B': /* bind callbacks when first called */
+	    lazybind++;
+	    break;
+	case 'l': /* pipeline batch mode */
+	    argc--;argv++;
+	    pipeline = atoi(*argv);
+	    break;
+	case 'x': /* expand callback cache */
+	    argc--;argv++;
+	    expand_cache = atoi(*argv);
+	    break;
+	case 'D': /* expand callback deadline */
+	    argc--;argv++;
+	    expand_deadline = atoi(*argv);
+	    break;
+	case 'H': /* history file */
+	    argc--;argv++;
+	    histfile = *argv;
+	    break;
+	case 'T': /* tree loaded on demand */
+	    argc--;argv++;
+	    loadtree = *argv;
+	    if (loadtree == NULL || strchr(loadtree, '=') == NULL)
+		usage(argv0);
+	    break;
+	case 'm': /* sessions */
+	    argc--;argv++;
+	    if (*argv == NULL)
+		usage(argv0);
+	    sessions = atoi(*argv);
+	    break;
+	case 'n': /* history lines */
+	    argc--;argv++;
+	    histlines = atoi(*argv);
+	    break;
 	default:
 	    usage(argv0);
 	    break;
@@ -265,17 +721,74 @@ main(int argc, char *argv[])
     cligen_ignorecase_set(h, 1);
     if (set_preference)
 	cligen_preference_mode_set(h, set_preference);
+    cligen_expand_lazy_set(h, lazy);
+    cligen_expand_cache_set(h, expand_cache);
+    cligen_expand_deadline_set(h, expand_deadline);
+    cligen_batch_pipeline_set(h, pipeline);
+    if (trace && cligen_trace_set(h, trace_cb, NULL) < 0)
+	goto done;
+    if (cligen_hist_init(h, histlines) < 0)
+	goto done;
+    if (histfile){
+	if ((fh = fopen(histfile, "a+")) == NULL){
+	    fprintf(stderr, "fopen(%s): %s\n", histfile, strerror(errno));
+	    goto done;
+	}
+	if (cligen_hist_file_load(h, fh) < 0)
+	    goto done;
+	cligen_hist_file_append(h, fh, 2*histlines);
+    }
 //    cligen_parse_debug(1);
     if ((globals = cvec_new(0)) == NULL)
 	goto done;
-    if (cligen_parse_file(h, f, filename?filename:"stdin", NULL, globals) < 0)
-	goto done;
+    if (image){
+	if (cligen_image_read(h, f, globals) < 0)
+	    goto done;
+    }
+    else if (parallel || nfiles > 1){
+	if (cligen_parse_files(h, files, nfiles, jobs,
+			       lazybind?NULL:str2fn,
+			       (set_expand && !lazybind)?str2fn_exp:NULL, NULL,
+			       globals) < 0)
+	    goto done;
+    }
+    else{
+	if (nfiles && (f = fopen(files[0], "r")) == NULL){
+	    fprintf(stderr, "fopen(%s): %s\n", files[0], strerror(errno));
+	    exit(1);
+	}
+	if (cligen_parse_file(h, f, nfiles?files[0]:"stdin", NULL, globals) < 0)
+	    goto done;
+    }
+    if (imagefile){
+	if ((fi = fopen(imagefile, "w")) == NULL){
+	    fprintf(stderr, "fopen(%s): %s\n", imagefile, strerror(errno));
+	    goto done;
+	}
+	if (cligen_image_write(h, fi, globals) < 0){
+	    fclose(fi);
+	    goto done;
+	}
+	fclose(fi);
+    }
 
+    if (loadtree){
+	loadfile = strchr(loadtree, '=');
+	*loadfile++ = '\0';
+	if ((ph = cligen_ph_add(h, loadtree)) == NULL)
+	    goto done;
+	if (cligen_ph_loader_set(ph, cligen_file_loader, loadfile) < 0)
+	    goto done;
+    }
     ph = cligen_ph_i(h, 0); 
     pt = cligen_ph_parsetree_get(ph);
     
     /* map functions */
-    if (pt) {
+    if (lazybind){
+	if (cligen_str2fn_lazy_set(h, str2fn, set_expand?str2fn_exp:NULL, NULL) < 0)
+	    goto done;
+    }
+    else if (pt) {
 	if (cligen_callbackv_str2fn(pt, str2fn, NULL) < 0)   /* callback */
 	    goto done;
 	if (set_expand &&
@@ -295,19 +808,59 @@ main(int argc, char *argv[])
     if ((str = cvec_find_str(globals, "mode")) != NULL)
 	cligen_ph_active_set(h, str);
     cvec_free(globals);
+    globals = NULL;
 
     if (print_syntax){
 	pt_print(stdout, pt, 0);
 	fflush(stdout);
     }
+    if (memsize){
+	if (cligen_handle_memsize(h, &cm) < 0)
+	    goto done;
+	cligen_memsize_print(stderr, &cm);
+    }
     if (once)
 	goto done;
-    if (cligen_loop(h) < 0)
+    if (freeze && (h1 = cligen_file_share(h)) == NULL)
+	goto done;
+    if (h1 && lazybind &&
+	cligen_str2fn_lazy_set(h1, str2fn, set_expand?str2fn_exp:NULL, NULL) < 0)
+	goto done;
+    cligen_stats_reset(h1?h1:h); /* Only count evaluations */
+    if (sessions){
+	if (cligen_file_sessions(h1?h1:h, sessions) < 0)
+	    goto done;
+    }
+    else if (batch){
+	if (cligen_eval_batch(h1?h1:h, stdin, NULL, NULL, &nerr) < 0)
+	    goto done;
+	if (nerr)
+	    fprintf(stderr, "%d errors\n", nerr);
+    }
+    else if (cligen_loop(h1?h1:h) < 0)
 	goto done;
+    if (stats)
+	cligen_stats_print(stderr, h1?h1:h);
     retval = 0;
   done:
+    if (globals)
+	cvec_free(globals);
     fclose(f);
+    if (h1)
+	cligen_exit(h1);
+    if (h && freeze){ /* Frozen parse-trees are not freed by the handle */
+	ph = NULL;
+	while ((ph = cligen_ph_each(h, ph)) != NULL)
+	    if ((pt = cligen_ph_parsetree_get(ph)) != NULL && pt_frozen_get(pt) == 1){
+		cligen_ph_parsetree_set(ph, NULL);
+		pt_free(pt, 1);
+	    }
+    }
     if (h)
 	cligen_exit(h);
+    if (fh)
+	fclose(fh);
+    if (files)
+	free(files);
     return retval;
 }
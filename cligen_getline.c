@@ -19,7 +19,6 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/select.h>
 #include <netinet/in.h>
 #include <string.h>
 #include <ctype.h>
@@ -33,29 +32,24 @@
 #include "cligen_pt_head.h"
 #include "cligen_object.h"
 #include "cligen_io.h"
+#include "cligen_event.h"
 #include "cligen_handle.h"
+#include "cligen_handle_internal.h"
 #include "cligen_history_internal.h"
+#include "cligen_stats.h"
+#include "cligen_stats_internal.h"
 
 #include "cligen_getline.h" /* exported interface */
 
-/********************* exported variables ********************************/
-
-int (*gl_in_hook)() = NULL;
-int (*gl_out_hook)() = NULL;
-int (*gl_tab_hook)() = NULL;
-int (*gl_qmark_hook)() = NULL;
-int (*gl_susp_hook)() = NULL;
-int (*gl_interrupt_hook)() = NULL;
-
 /******************** internal interface *********************************/
 
+#define SEARCH_LEN 100
+#define GL_OUTBUF_SIZE 4096	/* terminal output batched per keystroke */
+#define GL_INBUF_SIZE  4096	/* terminal input read at once */
+
 /* begin forward declared internal functions */
-static void     gl_init1(void);		/* prepare to edit a line */
-static void     gl_cleanup(void);	/* to undo gl_init1 */
-void            gl_char_init(void);	/* get ready for no echo input */
-void            gl_char_cleanup(void);	/* undo gl_char_init */
-static size_t 	(*gl_strlen)() = (size_t(*)())strlen; 
-					/* returns printable prompt width */
+static void     gl_init1(cligen_handle h);	/* prepare to edit a line */
+static void     gl_cleanup(cligen_handle h);	/* to undo gl_init1 */
 
 static int      gl_addchar(cligen_handle h, int c);	/* install specified char */
 static void     gl_del(cligen_handle h, int loc);	/* del, either left (-1) or cur (0) */
@@ -65,7 +59,8 @@ static void     gl_kill(cligen_handle h, int pos);	/* delete to EOL */
 static void     gl_kill_begin(cligen_handle h, int pos);	/* delete to BEGIN of line */
 static int      gl_kill_word(cligen_handle h, int pos);	/* delete word */
 static void     gl_newline(cligen_handle);	/* handle \n or \r */
-static int      gl_puts(char *buf);	/* write a line to terminal */
+static int      gl_puts(cligen_handle h, char *buf);	/* write a line to terminal */
+static int      gl_flush(cligen_handle h);	/* write batched terminal output */
 
 static void     gl_transpose(cligen_handle h);	/* transpose two chars */
 static int      gl_yank(cligen_handle h);		/* yank killed text */
@@ -77,39 +72,6 @@ static void     search_back(cligen_handle h, int new);	/* look back for current
 static void     search_forw(cligen_handle h, int new);	/* look forw for current string */
 /* end forward declared internal functions */
 
-/* begin global variables */
-static int      gl_init_done = -1;	/* terminal mode flag  */
-static int      gl_termw = 80;		/* actual terminal width */
-static int      gl_utf8 = 0;		/* UTF-8 experimental mode */
-static int      gl_scrolling_mode = 1;	/* Scrolling on / off */
-static int      gl_scrollw = 27;	/* width of EOL scrolling region */
-static int      gl_width = 0;		/* net size available for input */
-static int      gl_extent = 0;		/* how far to redraw, 0 means all */
-static int      gl_overwrite = 0;	/* overwrite mode */
-static int      gl_pos, gl_cnt = 0;     /* position and size of input */
-
-static char     gl_intrc = 0;		/* keyboard SIGINT char (^C) */
-static char     gl_quitc = 0;		/* keyboard SIGQUIT char (^]) */
-static char     gl_suspc = 0;		/* keyboard SIGTSTP char (^Z) */
-static char     gl_dsuspc = 0;		/* delayed SIGTSTP char */
-static int      gl_search_mode = 0;	/* search mode flag */
-
-static int exitchars[8] = {0,}; /* 8 different exit chars should be enough */
-static int gl_iseof = 0;
-
-static int   fixup_gl_shift;	/* index of first on screen character */
-static int   fixup_off_right;	/* true if more text right of screen */
-static int   fixup_off_left;	/* true if more text left of screen */
-static char  fixup_last_prompt[80] = "";
-
-#define SEARCH_LEN 100
-static char  search_prompt[SEARCH_LEN+2];  /* prompt includes search string */
-static char  search_string[SEARCH_LEN];
-static int   search_pos = 0;      /* current location in search_string */
-static int   search_forw_flg = 0; /* search direction flag */
-static int   search_last = 0;	  /* last match found */
-
-/* end global variables */
 
 
 /************************ nonportable part *********************************/
@@ -142,7 +104,6 @@ static int   search_last = 0;	  /* last match found */
 #define POSIX
 #ifdef POSIX		/* use POSIX interface */
 #include <termios.h>
-struct termios  new_termios, old_termios;
 #else /* not POSIX */
 #include <sys/ioctl.h>
 #ifdef M_XENIX	/* does not really use bsd terminal interface */
@@ -150,16 +111,127 @@ struct termios  new_termios, old_termios;
 #endif /* M_XENIX */
 #ifdef TIOCSETN		/* use BSD interface */
 #include <sgtty.h>
-struct sgttyb   new_tty, old_tty;
-struct tchars   tch;
-struct ltchars  ltch;
 #else			/* use SYSV interface */
 #include <termio.h>
-struct termio   new_termio, old_termio;
 #endif /* TIOCSETN */
 #endif /* POSIX */
 #endif	/* __unix__ */
 
+/*! Getline state of one CLIgen handle
+ * Formerly global variables, now one instance per handle so that several handles
+ * may edit lines independently, see gl_state_init
+ */
+struct gl_state {
+    int      gl_init_done;		/* terminal mode flag  */
+    int      gl_termw;		/* actual terminal width */
+    int      gl_utf8;		/* UTF-8 experimental mode */
+    int      gl_scrolling_mode;	/* Scrolling on / off */
+    int      gl_scrollw;		/* width of EOL scrolling region */
+    int      gl_width;		/* net size available for input */
+    int      gl_extent;		/* how far to redraw, 0 means all */
+    int      gl_overwrite;		/* overwrite mode */
+    int      gl_pos, gl_cnt;	/* position and size of input */
+
+    char     gl_intrc;		/* keyboard SIGINT char (^C) */
+    char     gl_quitc;		/* keyboard SIGQUIT char (^]) */
+    char     gl_suspc;		/* keyboard SIGTSTP char (^Z) */
+    char     gl_dsuspc;		/* delayed SIGTSTP char */
+    int      gl_search_mode;	/* search mode flag */
+
+    int      exitchars[8];		/* 8 different exit chars should be enough */
+    int      gl_iseof;
+
+    int      fixup_gl_shift;	/* index of first on screen character */
+    int      fixup_off_right;	/* true if more text right of screen */
+    int      fixup_off_left;	/* true if more text left of screen */
+    char     fixup_last_prompt[80];
+    char    *fixup_shown;	/* input buffer as last drawn on screen */
+    int      fixup_shown_len;	/* number of valid chars in fixup_shown */
+    int      fixup_shown_size;	/* allocated size of fixup_shown */
+
+    char     search_prompt[SEARCH_LEN+2];  /* prompt includes search string */
+    char     search_string[SEARCH_LEN];
+    int      search_pos;		/* current location in search_string */
+    int      search_forw_flg;	/* search direction flag */
+    int      search_last;		/* last match found */
+
+    gl_strwidth_proc gl_strlen;	/* returns printable prompt width */
+
+    /* Terminal output is collected while gl_getline edits a line and is written
+     * with a single write() before blocking for the next keystroke */
+    char     gl_outbuf[GL_OUTBUF_SIZE];
+    int      gl_outlen;
+    int      gl_batch;		/* if set, gl_putc/gl_puts append to gl_outbuf */
+
+    /* Terminal input is read in blocks, see gl_getc. Input read ahead of the
+     * current line is consumed by the next line or by gl_pending_getc */
+    unsigned char gl_inbuf[GL_INBUF_SIZE];
+    int      gl_inlen;
+    int      gl_inpos;		/* next char of gl_inbuf to consume */
+
+    /* Hooks */
+    int    (*gl_in_hook)(void *, char *);
+    int    (*gl_out_hook)(void*, char *);
+    int    (*gl_tab_hook)(cligen_handle, int *);
+    int    (*gl_qmark_hook)(cligen_handle, char *);
+    cligen_susp_cb_t      *gl_susp_hook;
+    cligen_interrupt_cb_t *gl_interrupt_hook;
+
+#ifdef __unix__
+#ifdef POSIX
+    struct termios  new_termios, old_termios;
+#else /* not POSIX */
+#ifdef TIOCSETN		/* use BSD interface */
+    struct sgttyb   new_tty, old_tty;
+    struct tchars   tch;
+    struct ltchars  ltch;
+#else			/* use SYSV interface */
+    struct termio   new_termio, old_termio;
+#endif /* TIOCSETN */
+#endif /* POSIX */
+#endif	/* __unix__ */
+};
+
+#define gl_state(h) (handle(h)->ch_gl)
+
+/*! Allocate and initialize getline state of a handle
+ * @param[in]  h     CLIgen handle
+ * @retval     0     OK
+ * @retval    -1     Error
+ * @see gl_state_exit
+ */
+int
+gl_state_init(cligen_handle h)
+{
+    struct gl_state *gs;
+
+    if ((gs = malloc(sizeof(*gs))) == NULL)
+	return -1;
+    memset(gs, 0, sizeof(*gs));
+    gs->gl_init_done = -1;
+    gs->gl_termw = 80;
+    gs->gl_scrolling_mode = 1;
+    gs->gl_scrollw = 27;
+    gs->gl_strlen = (gl_strwidth_proc)strlen;
+    gl_state(h) = gs;
+    return 0;
+}
+
+/*! Free getline state of a handle
+ * @param[in]  h     CLIgen handle
+ * @see gl_state_init
+ */
+void
+gl_state_exit(cligen_handle h)
+{
+    if (gl_state(h)){
+	if (gl_state(h)->fixup_shown)
+	    free(gl_state(h)->fixup_shown);
+	free(gl_state(h));
+	gl_state(h) = NULL;
+    }
+}
+
 #ifdef vms
 #include <descrip.h>
 #include <ttdef.h>
@@ -172,50 +244,52 @@ struct dsc$descriptor_s descrip;     /* VMS descriptor */
 #endif
 
 void
-gl_char_init(void)			/* turn off input echo */
+gl_char_init(cligen_handle h)		/* turn off input echo */
 {
+    struct gl_state *gs = gl_state(h);
+
 #ifdef __unix__
 #ifdef POSIX
-    tcgetattr(0, &old_termios);
-    gl_intrc = old_termios.c_cc[VINTR];
-    gl_quitc = old_termios.c_cc[VQUIT];
+    tcgetattr(0, &gs->old_termios);
+    gs->gl_intrc = gs->old_termios.c_cc[VINTR];
+    gs->gl_quitc = gs->old_termios.c_cc[VQUIT];
 #ifdef VSUSP
-    gl_suspc = old_termios.c_cc[VSUSP];
+    gs->gl_suspc = gs->old_termios.c_cc[VSUSP];
 #endif
 #ifdef VDSUSP
-    gl_dsuspc = old_termios.c_cc[VDSUSP];
+    gs->gl_dsuspc = gs->old_termios.c_cc[VDSUSP];
 #endif
-    new_termios = old_termios;
-    new_termios.c_iflag &= ~(BRKINT|ISTRIP|IXON|IXOFF);
-    new_termios.c_iflag |= (IGNBRK|IGNPAR);
-    new_termios.c_lflag &= ~(ICANON|ISIG|IEXTEN|ECHO);
-    new_termios.c_cc[VMIN] = 1;
-    new_termios.c_cc[VTIME] = 0;
-    tcsetattr(0, TCSADRAIN, &new_termios);
+    gs->new_termios = gs->old_termios;
+    gs->new_termios.c_iflag &= ~(BRKINT|ISTRIP|IXON|IXOFF);
+    gs->new_termios.c_iflag |= (IGNBRK|IGNPAR);
+    gs->new_termios.c_lflag &= ~(ICANON|ISIG|IEXTEN|ECHO);
+    gs->new_termios.c_cc[VMIN] = 1;
+    gs->new_termios.c_cc[VTIME] = 0;
+    tcsetattr(0, TCSADRAIN, &gs->new_termios);
 #else				/* not POSIX */
 #ifdef TIOCSETN			/* BSD */
-    ioctl(0, TIOCGETC, &tch);
-    ioctl(0, TIOCGLTC, &ltch);
-    gl_intrc = tch.t_intrc;
-    gl_quitc = tch.t_quitc;
-    gl_suspc = ltch.t_suspc;
-    gl_dsuspc = ltch.t_dsuspc;
-    ioctl(0, TIOCGETP, &old_tty);
-    new_tty = old_tty;
-    new_tty.sg_flags |= RAW;
-    new_tty.sg_flags &= ~ECHO;
-    ioctl(0, TIOCSETN, &new_tty);
+    ioctl(0, TIOCGETC, &gs->tch);
+    ioctl(0, TIOCGLTC, &gs->ltch);
+    gs->gl_intrc = gs->tch.t_intrc;
+    gs->gl_quitc = gs->tch.t_quitc;
+    gs->gl_suspc = gs->ltch.t_suspc;
+    gs->gl_dsuspc = gs->ltch.t_dsuspc;
+    ioctl(0, TIOCGETP, &gs->old_tty);
+    gs->new_tty = gs->old_tty;
+    gs->new_tty.sg_flags |= RAW;
+    gs->new_tty.sg_flags &= ~ECHO;
+    ioctl(0, TIOCSETN, &gs->new_tty);
 #else				/* SYSV */
-    ioctl(0, TCGETA, &old_termio);
-    gl_intrc = old_termio.c_cc[VINTR];
-    gl_quitc = old_termio.c_cc[VQUIT];
-    new_termio = old_termio;
-    new_termio.c_iflag &= ~(BRKINT|ISTRIP|IXON|IXOFF);
-    new_termio.c_iflag |= (IGNBRK|IGNPAR);
-    new_termio.c_lflag &= ~(ICANON|ISIG|ECHO);
-    new_termio.c_cc[VMIN] = 1;
-    new_termio.c_cc[VTIME] = 0;
-    ioctl(0, TCSETA, &new_termio);
+    ioctl(0, TCGETA, &gs->old_termio);
+    gs->gl_intrc = gs->old_termio.c_cc[VINTR];
+    gs->gl_quitc = gs->old_termio.c_cc[VQUIT];
+    gs->new_termio = gs->old_termio;
+    gs->new_termio.c_iflag &= ~(BRKINT|ISTRIP|IXON|IXOFF);
+    gs->new_termio.c_iflag |= (IGNBRK|IGNPAR);
+    gs->new_termio.c_lflag &= ~(ICANON|ISIG|ECHO);
+    gs->new_termio.c_cc[VMIN] = 1;
+    gs->new_termio.c_cc[VTIME] = 0;
+    ioctl(0, TCSETA, &gs->new_termio);
 #endif /* TIOCSETN */
 #endif /* POSIX */
 #endif /* __unix__ */
@@ -233,16 +307,18 @@ gl_char_init(void)			/* turn off input echo */
 }
 
 void
-gl_char_cleanup(void)		/* undo effects of gl_char_init */
+gl_char_cleanup(cligen_handle h)	/* undo effects of gl_char_init */
 {
+    struct gl_state *gs = gl_state(h);
+
 #ifdef __unix__
 #ifdef POSIX 
-    tcsetattr(0, TCSADRAIN, &old_termios);
+    tcsetattr(0, TCSADRAIN, &gs->old_termios);
 #else 			/* not POSIX */
 #ifdef TIOCSETN		/* BSD */
-    ioctl(0, TIOCSETN, &old_tty);
+    ioctl(0, TIOCSETN, &gs->old_tty);
 #else			/* SYSV */
-    ioctl(0, TCSETA, &old_termio);
+    ioctl(0, TCSETA, &gs->old_termio);
 #endif /* TIOCSETN */
 #endif /* POSIX */
 #endif /* __unix__ */
@@ -275,113 +351,66 @@ int pc_keymap(int c)
 
 
 #if CLIGEN_REGFD
-struct regfd {
-    int fd;
-    int (*cb)(int, void*);
-    void *arg;
-};
-static int nextfds = 0;
-static struct regfd *extfds = NULL;
-
 /* XXX: If arg is malloced, the treatment of arg creates leaks */
 int
 gl_regfd(int fd, 
 	 cligen_fd_cb_t *cb, 
 	 void *arg)
 {
-    int i;
-    struct regfd *tmp;
-
-    for (i = 0; i < nextfds; i++) {
-	if (extfds[i].fd == fd) { /* Already registered. Update arg and cb */
-	    extfds[i].cb = cb;
-	    extfds[i].arg = arg;
-	    return 0;
-	}
-    }
-
-    if ((tmp = realloc(extfds, (nextfds+1) * sizeof(*extfds))) == NULL)
-	return -1;
-    tmp[nextfds].fd = fd;
-    tmp[nextfds].cb = cb;
-    tmp[nextfds].arg = arg;
-    extfds = tmp;
-    nextfds++;
-
-    return 0;
+    return cligen_event_reg_fd(fd, cb, arg);
 }
 
 int
 gl_unregfd(int fd)
 {
-    int i;
-
-    for (i = 0; i < nextfds; i++) {
-	if (extfds[i].fd == fd) {
-	    if (i+1 < nextfds)
-		memcpy(&extfds[i], &extfds[i+1], nextfds-i);
-	    extfds = realloc(extfds, (nextfds-1) * sizeof(*extfds));
-	    nextfds--;
-	    return 0;
-	}
-    }
-
-    return -1;
+    return cligen_event_unreg_fd(fd);
 }
 
+/*! Block until stdin is readable, dispatching registered fds and timers meanwhile
+ * @see cligen_event_poll
+ */
 int
 gl_select()
 {
-    int i;
-    fd_set fdset;
-
-    while (1){
-	FD_ZERO(&fdset);
-	FD_SET(0, &fdset);
-	for(i = 0; i < nextfds; i++)
-	    FD_SET(extfds[i].fd, &fdset);
-	if (select(FD_SETSIZE, &fdset, NULL, NULL, NULL) < 0)
-	    return -1;
-	for(i = 0; i < nextfds; i++)
-	    if (FD_ISSET(extfds[i].fd, &fdset))
-		if (extfds[i].cb(extfds[i].fd, extfds[i].arg) < 0)
-		    return -1;
-	if (FD_ISSET(0, &fdset))
-	    break;
-    }
-    return 0;
+    return cligen_event_poll(0, -1) < 0 ? -1 : 0;
 }
 #endif
 
 
 int
-gl_eof()
+gl_eof(cligen_handle h)
 {
-    return gl_iseof;
+    struct gl_state *gs = gl_state(h);
+
+    return gs->gl_iseof;
 }
 
 void
-gl_exitchar_add(char c)
+gl_exitchar_add(cligen_handle h,
+		char          c)
 {
-    int i;
+    struct gl_state *gs = gl_state(h);
+    int              i;
 
-    for (i=0;sizeof(exitchars);i++)
-	if (!exitchars[i]){
-	    exitchars[i] = c;
+    for (i=0;sizeof(gs->exitchars);i++)
+	if (!gs->exitchars[i]){
+	    gs->exitchars[i] = c;
 	    break;
 	}
 }
 
 /* check if c is an exit char */
 static int
-gl_exitchar(char c)
+gl_exitchar(cligen_handle h,
+	    char          c)
 {
-    int i;
+    struct gl_state *gs = gl_state(h);
+    int              i;
 
-    for (i=0;sizeof(exitchars);i++){
-	if (!exitchars[i])
+    for (i=0;sizeof(gs->exitchars);i++){
+	if (!gs->exitchars[i])
 	    break;
-	if (exitchars[i] == c)
+	if (gs->exitchars[i] == c)
 	    return 1;
     }
     return 0; /* ^C */
@@ -393,12 +422,13 @@ gl_exitchar(char c)
 static char *
 gl_exit(cligen_handle h)
 {
-    char *gl_buf = cligen_buf(h);
+    struct gl_state *gs = gl_state(h);
+    char            *gl_buf = cligen_buf(h);
 
-    gl_iseof++;
+    gs->gl_iseof++;
     gl_buf[0] = 0;
-    gl_cleanup();
-    gl_putc('\n');
+    gl_cleanup(h);
+    gl_putc(h, '\n');
     return gl_buf;
 }
 
@@ -408,30 +438,51 @@ gl_exit(cligen_handle h)
 static int
 gl_getc(cligen_handle h)
 {
+    struct gl_state *gs = gl_state(h);
     int             c;
+    int             batch;
 #ifdef __unix__
-    unsigned char  ch;
+    unsigned char  ch = 0;
+
+    /* Rest of a paste burst: no echo until all available input is consumed */
+    if (gs->gl_inpos < gs->gl_inlen){
+	ch = gs->gl_inbuf[gs->gl_inpos++];
+	return (ch <= 0)? -1 : ch;
+    }
 #endif
 
+    gl_flush(h); /* one write of all output caused by the previous keystroke */
+    batch = gs->gl_batch; /* callbacks and hooks may redraw while waiting */
+    gs->gl_batch = 0;
 #if CLIGEN_REGFD 
     gl_select(); /* block until something arrives on stdin */
 #endif
 #ifdef __unix__
-    while ((c = read(0, &ch, 1)) == -1) {
+    /* Read all that is available, a paste may arrive in one read */
+    while ((c = read(0, gs->gl_inbuf, sizeof(gs->gl_inbuf))) == -1) {
 	if (errno == EINTR){
-	    if (gl_interrupt_hook(h) <0)
+	    if (gs->gl_interrupt_hook && gs->gl_interrupt_hook(h) <0){
+		gs->gl_batch = batch;
 		return -1;
+	    }
 	    continue;
 	}
 	break;
     }
     if (c == 0){
-	gl_iseof++;
+	gs->gl_iseof++;
 	cligen_buf(h)[0] = 0; /* clean exit from gl? */
-	gl_cleanup();
-	gl_putc('\n');
+	gl_cleanup(h);
+	gl_putc(h, '\n');
+	gs->gl_batch = batch;
 	return -1;
     }
+    if (c > 0){
+	cligen_stats_global_inc(_cligen_stats_term_read);
+	gs->gl_inlen = c;
+	gs->gl_inpos = 1;
+	ch = gs->gl_inbuf[0];
+    }
     c = (ch <= 0)? -1 : ch;
 #endif	/* __unix__ */
 #ifdef MSDOS
@@ -468,19 +519,97 @@ gl_getc(cligen_handle h)
     (void)sys$qiow(0,chan,IO$_TTYREADALL,0,0,0,&c,1,0,0,0,0);
     c &= 0177;                        /* get a char */
 #endif
+    gs->gl_batch = batch;
     return c;
 }
 
+/*! Get a char of terminal input that was read ahead by a handle, see gl_getc
+ * Other readers of stdin, eg the --More-- prompt of cligen_output, consume this
+ * input first so that typed-ahead or pasted input is not lost.
+ * @param[in]  h     CLIgen handle
+ * @retval     c     Next char read ahead
+ * @retval    -1     No input read ahead, read from stdin
+ */
 int
-gl_putc(int c)
+gl_pending_getc(cligen_handle h)
+{
+    struct gl_state *gs = gl_state(h);
+
+    if (gs == NULL || gs->gl_inpos >= gs->gl_inlen)
+	return -1;
+    return gs->gl_inbuf[gs->gl_inpos++];
+}
+
+/*! Write batched terminal output
+ * Called before reading input, calling hooks that may write to the terminal and
+ * restoring terminal mode.
+ * @param[in]  h     CLIgen handle
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+gl_flush(cligen_handle h)
+{
+    struct gl_state *gs = gl_state(h);
+    int              i = 0;
+    int              n;
+
+    while (i < gs->gl_outlen){
+	if ((n = write(1, gs->gl_outbuf+i, gs->gl_outlen-i)) < 0){
+	    if (errno == EINTR)
+		continue;
+	    gs->gl_outlen = 0;
+	    return -1;
+	}
+	cligen_stats_global_inc(_cligen_stats_term_write);
+	i += n;
+    }
+    gs->gl_outlen = 0;
+    return 0;
+}
+
+/*! Write len bytes to terminal, or append them to the batch buffer of the handle
+ * @param[in]  h     CLIgen handle
+ * @param[in]  buf   Output
+ * @param[in]  len   Length of buf
+ */
+static int
+gl_write(cligen_handle h,
+	 char         *buf,
+	 int           len)
+{
+    struct gl_state *gs = gl_state(h);
+
+    if (gs->gl_batch){
+	if (gs->gl_outlen + len > GL_OUTBUF_SIZE && gl_flush(h) < 0)
+	    return -1;
+	if (len <= GL_OUTBUF_SIZE){
+	    memcpy(gs->gl_outbuf+gs->gl_outlen, buf, len);
+	    gs->gl_outlen += len;
+	    return 0;
+	}
+    }
+    if (write(1, buf, len) < 0)
+	return -1;
+    cligen_stats_global_inc(_cligen_stats_term_write);
+    return 0;
+}
+
+/*! Write one char to the terminal of a handle
+ * @param[in]  h     CLIgen handle
+ * @param[in]  c     Character
+ */
+int
+gl_putc(cligen_handle h,
+	int           c)
 {
     char   ch = c;
 
-    if (write(1, &ch, 1) < 0)
+    if (gl_write(h, &ch, 1) < 0)
       return -1;
     if (ch == '\n') {
 	ch = '\r'; /* RAW mode needs '\r', does not hurt */
-        if (write(1, &ch, 1) < 0)
+        if (gl_write(h, &ch, 1) < 0)
 	  return -1;
     }
     return 0;
@@ -489,13 +618,14 @@ gl_putc(int c)
 /******************** fairly portable part *********************************/
 
 static int
-gl_puts(char *buf)
+gl_puts(cligen_handle h,
+	char         *buf)
 {
     int len; 
     
     if (buf) {
         len = strlen(buf);
-        if (write(1, buf, len) < 0)
+        if (gl_write(h, buf, len) < 0)
 	  return -1;
     }
     return 0;
@@ -505,47 +635,62 @@ gl_puts(char *buf)
  * @see gl_init  cal this once first
  */
 static void
-gl_init1()
+gl_init1(cligen_handle h)
 {
-    gl_iseof = 0;
-    gl_char_init();
-    gl_init_done = 1;
+    struct gl_state *gs = gl_state(h);
+
+    gs->gl_iseof = 0;
+    gl_char_init(h);
+    gs->gl_init_done = 1;
 }
 
 /*! undo effects of gl_init1, as necessary */
 static void
-gl_cleanup()
+gl_cleanup(cligen_handle h)
 {
-    if (gl_init_done > 0)
-        gl_char_cleanup();
-    gl_init_done = 0;
+    struct gl_state *gs = gl_state(h);
+
+    gl_flush(h);
+    if (gs->gl_init_done > 0)
+        gl_char_cleanup(h);
+    gs->gl_init_done = 0;
 }
 
 int
-gl_getscrolling(void)
+gl_getscrolling(cligen_handle h)
 {
-    return gl_scrolling_mode;
+    struct gl_state *gs = gl_state(h);
+
+    return gs->gl_scrolling_mode;
 }
 
 void
-gl_setscrolling(int  mode)
+gl_setscrolling(cligen_handle h,
+		int           mode)
 {
-    gl_scrolling_mode = mode;
+    struct gl_state *gs = gl_state(h);
+
+    gs->gl_scrolling_mode = mode;
 }
 
 int
-gl_getwidth(void)
+gl_getwidth(cligen_handle h)
 {
-    return gl_termw;
+    struct gl_state *gs = gl_state(h);
+
+    return gs->gl_termw;
 }
 
 /*! Set UTF-8 experimental mode 
  * @param[in] enabled   Set to 1 to enable UTF-8 experimental mode
  */
 int
-gl_utf8_set(int mode)
+gl_utf8_set(cligen_handle h,
+	    int           mode)
 {
-    gl_utf8 = mode;
+    struct gl_state *gs = gl_state(h);
+
+    gs->gl_utf8 = mode;
     return 0;
 }
 
@@ -554,18 +699,23 @@ gl_utf8_set(int mode)
  * @retval 1 UTF-8 is enabled
  */
 int
-gl_utf8_get(void)
+gl_utf8_get(cligen_handle h)
 {
-    return gl_utf8;
+    struct gl_state *gs = gl_state(h);
+
+    return gs->gl_utf8;
 }
 
 int
-gl_setwidth(int  w)
+gl_setwidth(cligen_handle h,
+	    int           w)
 {
+    struct gl_state *gs = gl_state(h);
+
     if (w < TERM_MIN_SCREEN_WIDTH)
 	return -1;
-    gl_termw = w;
-    gl_scrollw = w / 3;
+    gs->gl_termw = w;
+    gs->gl_scrollw = w / 3;
     return 0;
 }
 
@@ -581,6 +731,7 @@ int
 gl_getline(cligen_handle h,
 	   char        **buf)
 {
+    struct gl_state *gs = gl_state(h);
     int             c, loc, tmp;
     char           *gl_prompt;
     int             escape = 0;
@@ -588,27 +739,29 @@ gl_getline(cligen_handle h,
     int	            sig;
 #endif
 
-    gl_init1();	
+    gl_init1(h);	
+    gs->gl_batch++;
     gl_prompt = (cligen_prompt(h))? cligen_prompt(h) : "";
     cligen_buf(h)[0] = 0;
-    if (gl_in_hook)
-	gl_in_hook(h, cligen_buf(h));
+    if (gs->gl_in_hook)
+	gs->gl_in_hook(h, cligen_buf(h));
     gl_fixup(h, gl_prompt, -2, cligen_buf_size(h));
     while ((c = gl_getc(h)) >= 0) {
-	gl_extent = 0;  	/* reset to full extent */
+	gs->gl_extent = 0;  	/* reset to full extent */
 	if (isprint(c) || (escape&&c=='\n')) {
 	    if (escape == 0 && c == '\\')
                escape++;
             else{
-		if (escape ==0 && c == '?' && gl_qmark_hook) {
+		if (escape ==0 && c == '?' && gs->gl_qmark_hook) {
 		    escape = 0;
-		    if ((loc = gl_qmark_hook(h, cligen_buf(h))) < 0)
+		    gl_flush(h);
+		    if ((loc = gs->gl_qmark_hook(h, cligen_buf(h))) < 0)
 			goto err;
-		    gl_fixup(h, gl_prompt, -2, gl_pos);
+		    gl_fixup(h, gl_prompt, -2, gs->gl_pos);
 		}
 		else{ 
 		    escape = 0;
-		    if (gl_search_mode)
+		    if (gs->gl_search_mode)
 			search_addchar(h, c);
 		    else
 			if (gl_addchar(h, c) < 0)
@@ -617,7 +770,7 @@ gl_getline(cligen_handle h,
 	    }
 	} else {
 	    escape = 0;
-	    if (gl_search_mode) { /* after ^S or ^R */
+	    if (gs->gl_search_mode) { /* after ^S or ^R */
 	        if (c == '\033' || c == '\016' || c == '\020') { /* ESC, ^N, ^P */
 	            search_term(h);
 	            c = 0;     		/* ignore the character */
@@ -629,7 +782,7 @@ gl_getline(cligen_handle h,
 		}
 	    }
 	    /* special exit characters */
-	    if (gl_exitchar(c))
+	    if (gl_exitchar(h, c))
 		goto exit;
 	    switch (c) {
 	    case '\n': case '\r': 			/* newline */
@@ -639,49 +792,50 @@ gl_getline(cligen_handle h,
 		break; 
 	    case '\001': gl_fixup(h, gl_prompt, -1, 0);		/* ^A */
 		break;
-	    case '\002': gl_fixup(h, gl_prompt, -1, gl_pos-1);	/* ^B */
+	    case '\002': gl_fixup(h, gl_prompt, -1, gs->gl_pos-1);	/* ^B */
 		break;
 	    case '\004':					/* ^D */
-		if (gl_cnt == 0) 
+		if (gs->gl_cnt == 0) 
 		    goto exit;
 		else 
 		    gl_del(h, 0);
 		break;
-	    case '\005': gl_fixup(h, gl_prompt, -1, gl_cnt);	/* ^E */
+	    case '\005': gl_fixup(h, gl_prompt, -1, gs->gl_cnt);	/* ^E */
 		break;
-	    case '\006': gl_fixup(h, gl_prompt, -1, gl_pos+1);	/* ^F */
+	    case '\006': gl_fixup(h, gl_prompt, -1, gs->gl_pos+1);	/* ^F */
 		break;
 	    case '\010': case '\177': gl_del(h, -1);	/* ^H and DEL */
 		break;
 	    case '\t':        				/* TAB */
-                if (gl_tab_hook) {
-		    tmp = gl_pos;
-	            if ((loc = gl_tab_hook(h, &tmp)) < 0)
+                if (gs->gl_tab_hook) {
+		    gl_flush(h);
+		    tmp = gs->gl_pos;
+	            if ((loc = gs->gl_tab_hook(h, &tmp)) < 0)
 			goto err;
 		    gl_fixup(h, gl_prompt, -2, tmp);
 #if 0
-                 if (loc != -1 || tmp != gl_pos)
+                 if (loc != -1 || tmp != gs->gl_pos)
                        gl_fixup(h, gl_prompt, loc, tmp);
 #endif
                 }
 		break;
-	    case '\013': gl_kill(h, gl_pos);			/* ^K */
+	    case '\013': gl_kill(h, gs->gl_pos);			/* ^K */
 		break;
 	    case '\014':
 		    gl_clear_screen(h);				/* ^L */
 		break;
 	    case '\016': 					/* ^N */
 		hist_copy_next(h);
-                if (gl_in_hook)
-	            gl_in_hook(h, cligen_buf(h));
+                if (gs->gl_in_hook)
+	            gs->gl_in_hook(h, cligen_buf(h));
 		gl_fixup(h, gl_prompt, 0, cligen_buf_size(h));
 		break;
-	    case '\017': gl_overwrite = !gl_overwrite;       	/* ^O */
+	    case '\017': gs->gl_overwrite = !gs->gl_overwrite;       	/* ^O */
 		break;
 	    case '\020': 					/* ^P */
 		hist_copy_prev(h);
-                if (gl_in_hook)
-	            gl_in_hook(h, cligen_buf(h));
+                if (gs->gl_in_hook)
+	            gs->gl_in_hook(h, cligen_buf(h));
 		gl_fixup(h, gl_prompt, 0, cligen_buf_size(h));
 		break;
 	    case '\022': search_back(h, 1);			/* ^R */
@@ -690,18 +844,19 @@ gl_getline(cligen_handle h,
 		break;
 	    case '\024': gl_transpose(h);			/* ^T */
 		break;
-	    case '\025': gl_kill_begin(h, gl_pos);		/* ^U */
+	    case '\025': gl_kill_begin(h, gs->gl_pos);		/* ^U */
 		break;
-	    case '\027': if (gl_kill_word(h, gl_pos) < 0) goto err;/* ^W */
+	    case '\027': if (gl_kill_word(h, gs->gl_pos) < 0) goto err;/* ^W */
 		break;
 	    case '\031': if (gl_yank(h) < 0) goto err;		/* ^Y */
 		break;
 	    case '\032':                                      /* ^Z */
-		if(gl_susp_hook) {
-		    tmp = gl_pos;
-	            loc = gl_susp_hook(cligen_userhandle(h)?cligen_userhandle(h):h,
-				       cligen_buf(h), gl_strlen(gl_prompt), &tmp);
-	            if (loc != -1 || tmp != gl_pos)
+		if(gs->gl_susp_hook) {
+		    gl_flush(h);
+		    tmp = gs->gl_pos;
+	            loc = gs->gl_susp_hook(cligen_userhandle(h)?cligen_userhandle(h):h,
+				       cligen_buf(h), gs->gl_strlen(gl_prompt), &tmp);
+	            if (loc != -1 || tmp != gs->gl_pos)
 	                gl_fixup(h, gl_prompt, loc, tmp);
 		    if (strchr (cligen_buf(h), '\n')) 
 			goto done;
@@ -714,26 +869,26 @@ gl_getline(cligen_handle h,
 		    switch(c = gl_getc(h)) {
 		    case 'A':             			/* up */
 			hist_copy_prev(h);
-                        if (gl_in_hook)
-	                    gl_in_hook(h, cligen_buf(h));
+                        if (gs->gl_in_hook)
+	                    gs->gl_in_hook(h, cligen_buf(h));
 		        gl_fixup(h, gl_prompt, 0, cligen_buf_size(h));
 		        break;
 		    case 'B':                         	/* down */
 			hist_copy_next(h);
-                        if (gl_in_hook)
-	                    gl_in_hook(h, cligen_buf(h));
+                        if (gs->gl_in_hook)
+	                    gs->gl_in_hook(h, cligen_buf(h));
 		        gl_fixup(h, gl_prompt, 0, cligen_buf_size(h));
 		        break;
-		    case 'C': gl_fixup(h, gl_prompt, -1, gl_pos+1); /* right */
+		    case 'C': gl_fixup(h, gl_prompt, -1, gs->gl_pos+1); /* right */
 		        break;
-		    case 'D': gl_fixup(h, gl_prompt, -1, gl_pos-1); /* left */
+		    case 'D': gl_fixup(h, gl_prompt, -1, gs->gl_pos-1); /* left */
 		        break;
 		    case '3': /* del */
 			if (gl_getc(h) != '~')
 			    break;
 			gl_del(h, 0);
 			break;
-		    default: gl_putc('\007');         /* who knows */
+		    default: gl_putc(h, '\007');         /* who knows */
 		        break;
 		    }
 		} else if (c == 'f' || c == 'F') {
@@ -741,14 +896,14 @@ gl_getline(cligen_handle h,
 		} else if (c == 'b' || c == 'B') {
 		    gl_word(h, -1);
 		} else
-		    gl_putc('\007');
+		    gl_putc(h, '\007');
 		break;
 	    default:		/* check for a terminal signal */
 #ifdef __unix__
 		if ((c & 0xe0) == 0xc0){ /* UTF-2 */
 		    int c2;
 		    c2 = gl_getc(h);
-		    if (gl_utf8){
+		    if (gs->gl_utf8){
 			if (gl_addchar(h, c) < 0)
 			    goto err;
 			if (gl_addchar(h, c2) < 0)
@@ -759,7 +914,7 @@ gl_getline(cligen_handle h,
 		    int c2, c3;
 		    c2 = gl_getc(h);
 		    c3 = gl_getc(h);
-		    if (gl_utf8){
+		    if (gs->gl_utf8){
 			if (gl_addchar(h, c) < 0)
 			    goto err;
 			if (gl_addchar(h, c2) < 0)
@@ -773,7 +928,7 @@ gl_getline(cligen_handle h,
 		    c2 = gl_getc(h);
 		    c3 = gl_getc(h);
 		    c4 = gl_getc(h);
-		    if (gl_utf8){
+		    if (gs->gl_utf8){
 			if (gl_addchar(h, c) < 0)
 			    goto err;
 			if (gl_addchar(h, c2) < 0)
@@ -787,21 +942,21 @@ gl_getline(cligen_handle h,
 	        if (c > 0) {	/* ignore 0 (reset above) */
 	            sig = 0;
 #ifdef SIGINT
-	            if (c == gl_intrc)
+	            if (c == gs->gl_intrc)
 	                sig = SIGINT;
 #endif
 #ifdef SIGQUIT
-	            if (c == gl_quitc)
+	            if (c == gs->gl_quitc)
 	                sig = SIGQUIT;
 #endif
 #ifdef SIGTSTP
-	            if (c == gl_suspc || c == gl_dsuspc)
+	            if (c == gs->gl_suspc || c == gs->gl_dsuspc)
 	                sig = SIGTSTP;
 #endif
                     if (sig != 0) {
-	                gl_cleanup();
+	                gl_cleanup(h);
 	                kill(0, sig);
-	                gl_init1();
+	                gl_init1(h);
 	                gl_redraw(h);
 			gl_kill(h, 0);
 			c = 0;
@@ -809,22 +964,28 @@ gl_getline(cligen_handle h,
 		}
 #endif /* __unix__ */
                 if (c > 0)
-		    gl_putc('\007');
+		    gl_putc(h, '\007');
 		break;
 	    }
 	}
     } /* while */
     cligen_buf(h)[0] = 0;
  done:
-    gl_cleanup();
+    gl_cleanup(h);
+    gs->gl_batch--;
+    gl_flush(h);
     *buf = cligen_buf(h);
     return 0;
  exit: /* ie exit from cli, not necessarily error */
     gl_exit(h);
+    gs->gl_batch--;
+    gl_flush(h);
     *buf = cligen_buf(h);
     return 0;
  err: /* fatal error */
-    gl_cleanup();
+    gl_cleanup(h);
+    gs->gl_batch--;
+    gl_flush(h);
     return -1;
 }
 
@@ -836,19 +997,20 @@ static int
 gl_addchar(cligen_handle h, 
 	   int           c)
 {
+    struct gl_state *gs = gl_state(h);
     int  i;
 
-    if (cligen_buf_increase(h, gl_cnt+1) < 0) /* assume increase enough for gl_pos-gl_cnt */
+    if (cligen_buf_increase(h, gs->gl_cnt+1) < 0) /* assume increase enough for gs->gl_pos-gs->gl_cnt */
 	return -1;
-    if (gl_overwrite == 0 || gl_pos == gl_cnt) {
-        for (i=gl_cnt; i >= gl_pos; i--)
+    if (gs->gl_overwrite == 0 || gs->gl_pos == gs->gl_cnt) {
+        for (i=gs->gl_cnt; i >= gs->gl_pos; i--)
             cligen_buf(h)[i+1] = cligen_buf(h)[i];
-        cligen_buf(h)[gl_pos] = c;
-        gl_fixup(h, cligen_prompt(h), gl_pos, gl_pos+1);
+        cligen_buf(h)[gs->gl_pos] = c;
+        gl_fixup(h, cligen_prompt(h), gs->gl_pos, gs->gl_pos+1);
     } else {
-	cligen_buf(h)[gl_pos] = c;
-	gl_extent = 1;
-        gl_fixup(h, cligen_prompt(h), gl_pos, gl_pos+1);
+	cligen_buf(h)[gs->gl_pos] = c;
+	gs->gl_extent = 1;
+        gl_fixup(h, cligen_prompt(h), gs->gl_pos, gs->gl_pos+1);
     }
     return 0;
 }
@@ -859,31 +1021,32 @@ gl_addchar(cligen_handle h,
 static int
 gl_yank(cligen_handle h)
 {
+    struct gl_state *gs = gl_state(h);
     int  i, len;
 
     len = strlen(cligen_killbuf(h));
     if (len > 0) {
-	if (gl_overwrite == 0) {
-	    if (cligen_buf_increase(h, gl_cnt + len + 1) < 0)
+	if (gs->gl_overwrite == 0) {
+	    if (cligen_buf_increase(h, gs->gl_cnt + len + 1) < 0)
 		return -1;
-            for (i=gl_cnt; i >= gl_pos; i--)
+            for (i=gs->gl_cnt; i >= gs->gl_pos; i--)
                 cligen_buf(h)[i+len] = cligen_buf(h)[i];
 	    for (i=0; i < len; i++)
-                cligen_buf(h)[gl_pos+i] = cligen_killbuf(h)[i];
-            gl_fixup(h, cligen_prompt(h), gl_pos, gl_pos+len);
+                cligen_buf(h)[gs->gl_pos+i] = cligen_killbuf(h)[i];
+            gl_fixup(h, cligen_prompt(h), gs->gl_pos, gs->gl_pos+len);
 	} else {
-	    if (gl_pos + len > gl_cnt) {
-	        if (cligen_buf_increase(h, gl_pos + len + 1) < 0)
+	    if (gs->gl_pos + len > gs->gl_cnt) {
+	        if (cligen_buf_increase(h, gs->gl_pos + len + 1) < 0)
 		    return -1;
-		cligen_buf(h)[gl_pos + len] = 0;
+		cligen_buf(h)[gs->gl_pos + len] = 0;
             }
 	    for (i=0; i < len; i++)
-                cligen_buf(h)[gl_pos+i] = cligen_killbuf(h)[i];
-	    gl_extent = len;
-            gl_fixup(h, cligen_prompt(h), gl_pos, gl_pos+len);
+                cligen_buf(h)[gs->gl_pos+i] = cligen_killbuf(h)[i];
+	    gs->gl_extent = len;
+            gl_fixup(h, cligen_prompt(h), gs->gl_pos, gs->gl_pos+len);
 	}
     } else
-	gl_putc('\007');
+	gl_putc(h, '\007');
     return 0;
 }
 
@@ -893,16 +1056,17 @@ gl_yank(cligen_handle h)
 static void
 gl_transpose(cligen_handle h)
 {
+    struct gl_state *gs = gl_state(h);
     int    c;
 
-    if (gl_pos > 0 && gl_cnt > gl_pos) {
-	c = cligen_buf(h)[gl_pos-1];
-	cligen_buf(h)[gl_pos-1] = cligen_buf(h)[gl_pos];
-	cligen_buf(h)[gl_pos] = c;
-	gl_extent = 2;
-	gl_fixup(h, cligen_prompt(h), gl_pos-1, gl_pos);
+    if (gs->gl_pos > 0 && gs->gl_cnt > gs->gl_pos) {
+	c = cligen_buf(h)[gs->gl_pos-1];
+	cligen_buf(h)[gs->gl_pos-1] = cligen_buf(h)[gs->gl_pos];
+	cligen_buf(h)[gs->gl_pos] = c;
+	gs->gl_extent = 2;
+	gl_fixup(h, cligen_prompt(h), gs->gl_pos-1, gs->gl_pos);
     } else
-	gl_putc('\007');
+	gl_putc(h, '\007');
 }
 
 /*! Cleans up entire line before returning to caller. 
@@ -913,16 +1077,17 @@ gl_transpose(cligen_handle h)
 static void
 gl_newline(cligen_handle h)
 {
-    int len = gl_cnt;
+    struct gl_state *gs = gl_state(h);
+    int len = gs->gl_cnt;
     int loc;
 
-    if (gl_scrolling_mode)
-	loc = gl_width - 5;	/* shifts line back to start position */
+    if (gs->gl_scrolling_mode)
+	loc = gs->gl_width - 5;	/* shifts line back to start position */
     else
-	loc = gl_cnt;
+	loc = gs->gl_cnt;
     
-    cligen_buf_increase(h, gl_cnt+1); /* \n\0 added */
-    if (gl_out_hook) {
+    cligen_buf_increase(h, gs->gl_cnt+1); /* \n\0 added */
+    if (gs->gl_out_hook) {
         len = strlen(cligen_buf(h));
     } 
     if (loc > len)
@@ -930,7 +1095,7 @@ gl_newline(cligen_handle h)
     gl_fixup(h, cligen_prompt(h), -1, loc);	/* must do this before appending \n */
     cligen_buf(h)[len] = '\n';
     cligen_buf(h)[len+1] = '\0';
-    gl_putc('\n');
+    gl_putc(h, '\n');
 }
 
 /*! Delete a character.  
@@ -942,14 +1107,15 @@ static void
 gl_del(cligen_handle h, 
        int           loc)
 {
+    struct gl_state *gs = gl_state(h);
     int i;
 
-    if ((loc == -1 && gl_pos > 0) || (loc == 0 && gl_pos < gl_cnt)) {
-        for (i=gl_pos+loc; i < gl_cnt; i++)
+    if ((loc == -1 && gs->gl_pos > 0) || (loc == 0 && gs->gl_pos < gs->gl_cnt)) {
+        for (i=gs->gl_pos+loc; i < gs->gl_cnt; i++)
 	    cligen_buf(h)[i] = cligen_buf(h)[i+1];
-	gl_fixup(h, cligen_prompt(h), gl_pos+loc, gl_pos+loc);
+	gl_fixup(h, cligen_prompt(h), gs->gl_pos+loc, gs->gl_pos+loc);
     } else
-	gl_putc('\007');
+	gl_putc(h, '\007');
 }
 
 /*! Delete position to end of line 
@@ -960,13 +1126,14 @@ static void
 gl_kill(cligen_handle h, 
 	int           pos)
 {
-    if (pos < gl_cnt) {
+    struct gl_state *gs = gl_state(h);
+    if (pos < gs->gl_cnt) {
         cligen_killbuf_increase(h, cligen_buf_size(h));
 	strncpy(cligen_killbuf(h), cligen_buf(h) + pos, cligen_buf_size(h));
 	cligen_buf(h)[pos] = '\0';
 	gl_fixup(h, cligen_prompt(h), pos, pos);
     } else
-	gl_putc('\007');
+	gl_putc(h, '\007');
 }
 
 /* Delete from pos to start of line 
@@ -977,6 +1144,7 @@ static void
 gl_kill_begin(cligen_handle h, 
 	      int           pos)
 {
+    struct gl_state *gs = gl_state(h);
     int i;
     int len;
 
@@ -987,11 +1155,11 @@ gl_kill_begin(cligen_handle h,
 	cligen_killbuf(h)[pos] = '\0';
 	memmove(cligen_buf(h), cligen_buf(h) + pos, len-pos+1); /* memmove may overlap */
 	gl_fixup(h, cligen_prompt(h), 0, 0);
-	for (i=gl_pos; i < gl_cnt; i++)
-            gl_putc(cligen_buf(h)[i]);
+	for (i=gs->gl_pos; i < gs->gl_cnt; i++)
+            gl_putc(h, cligen_buf(h)[i]);
 	gl_fixup(h, cligen_prompt(h), -2, 0);
     } else
-	gl_putc('\007');
+	gl_putc(h, '\007');
 }
 
 /*! Delete one previous word from pos 
@@ -1002,10 +1170,11 @@ static int
 gl_kill_word(cligen_handle h, 
 	     int           pos)
 {
+    struct gl_state *gs = gl_state(h);
     int i, wpos;
 
     if (pos == 0) 
-	gl_putc('\007');
+	gl_putc(h, '\007');
     else {
 	wpos = pos;
 	if (pos > 0)
@@ -1014,16 +1183,16 @@ gl_kill_word(cligen_handle h,
 	    pos--;
         while (!isspace((int)cligen_buf(h)[pos]) && pos > 0) 
 	    pos--;
-	if (pos < gl_cnt && isspace((int)cligen_buf(h)[pos]))   /* move onto word */
+	if (pos < gs->gl_cnt && isspace((int)cligen_buf(h)[pos]))   /* move onto word */
 	    pos++;
 	if (cligen_killbuf_increase(h, wpos-pos) < 0)
 	    return -1;
 	strncpy(cligen_killbuf(h), cligen_buf(h)+pos, wpos-pos);
 	cligen_killbuf(h)[wpos-pos] = '\0';
-	memmove(cligen_buf(h)+pos, cligen_buf(h) + wpos, gl_cnt-wpos+1);
+	memmove(cligen_buf(h)+pos, cligen_buf(h) + wpos, gs->gl_cnt-wpos+1);
 	gl_fixup(h, cligen_prompt(h), wpos, pos);
-	for (i=gl_pos; i < gl_cnt; i++)
-            gl_putc(cligen_buf(h)[i]);
+	for (i=gs->gl_pos; i < gs->gl_cnt; i++)
+            gl_putc(h, cligen_buf(h)[i]);
 	gl_fixup(h, cligen_prompt(h), -2, pos);
     }
     return 0;
@@ -1038,12 +1207,13 @@ gl_word(cligen_handle h,
 	int           direction)
 
 {
-    int pos = gl_pos;
+    struct gl_state *gs = gl_state(h);
+    int pos = gs->gl_pos;
 
     if (direction > 0) {		/* forward */
-        while (!isspace((int)cligen_buf(h)[pos]) && (pos < gl_cnt)) 
+        while (!isspace((int)cligen_buf(h)[pos]) && (pos < gs->gl_cnt)) 
 	    pos++;
-	while (isspace((int)cligen_buf(h)[pos]) && pos < gl_cnt)
+	while (isspace((int)cligen_buf(h)[pos]) && pos < gs->gl_cnt)
 	    pos++;
     } else {				/* backword */
 	if (pos > 0)
@@ -1052,74 +1222,82 @@ gl_word(cligen_handle h,
 	    pos--;
         while (!isspace((int)cligen_buf(h)[pos]) && pos > 0) 
 	    pos--;
-	if (pos < gl_cnt && isspace((int)cligen_buf(h)[pos]))   /* move onto word */
+	if (pos < gs->gl_cnt && isspace((int)cligen_buf(h)[pos]))   /* move onto word */
 	    pos++;
     }
     gl_fixup(h, cligen_prompt(h), -1, pos);
 }
 
 static int
-move_cursor_up(int nr)
+move_cursor_up(cligen_handle h,
+	       int           nr)
 {
-    gl_putc(033);
-    gl_putc('[');
-    gl_putc('1');
-    gl_putc('A');
+    gl_putc(h, 033);
+    gl_putc(h, '[');
+    gl_putc(h, '1');
+    gl_putc(h, 'A');
     return 0;
 }
 
 static int
-move_cursor_right(int nr)
+move_cursor_right(cligen_handle h,
+		  int           nr)
 {
     char str[16];
     int  i;
-    gl_putc(033);
-    gl_putc('[');
+    gl_putc(h, 033);
+    gl_putc(h, '[');
     snprintf(str, 15, "%d", nr);
     for (i=0; i<strlen(str); i++)
-	gl_putc(str[i]);
-    gl_putc('C');
+	gl_putc(h, str[i]);
+    gl_putc(h, 'C');
     return 0;
 }
 
 static int
-wrap_line()
+wrap_line(cligen_handle h)
 {
-    gl_putc('\n'); /* wrap line */
+    gl_putc(h, '\n'); /* wrap line */
     return 0;
 }
 
 static int
-unwrap_line()
+unwrap_line(cligen_handle h)
 {
-    move_cursor_up(1);
-    move_cursor_right(gl_termw-1);
+    struct gl_state *gs = gl_state(h);
+
+    move_cursor_up(h, 1);
+    move_cursor_right(h, gs->gl_termw-1);
     return 0;
 }
 
-int
-wrap(int p, 
-     int plen)
+static int
+wrap(cligen_handle h,
+     int           p, 
+     int           plen)
 {
-    return (p+plen+1)%gl_termw==0;
+    struct gl_state *gs = gl_state(h);
+
+    return (p+plen+1)%gs->gl_termw==0;
 }
 
 void gl_clear_screen(cligen_handle h)
 {
-    if (gl_init_done <= 0) {
+    struct gl_state *gs = gl_state(h);
+    if (gs->gl_init_done <= 0) {
 	return;
     }
 
-    gl_putc('\033');	/* clear */
-    gl_putc('[');
-    gl_putc('2');
-    gl_putc('J');
+    gl_putc(h, '\033');	/* clear */
+    gl_putc(h, '[');
+    gl_putc(h, '2');
+    gl_putc(h, 'J');
 
-    gl_putc('\033');	/* home */
-    gl_putc('[');
-    gl_putc('H');
+    gl_putc(h, '\033');	/* home */
+    gl_putc(h, '[');
+    gl_putc(h, 'H');
 
-    gl_fixup(h, cligen_prompt(h), -2, gl_pos);
+    gl_fixup(h, cligen_prompt(h), -2, gs->gl_pos);
 }
 
 /*! Emit a newline, reset and redraw prompt and current input line 
@@ -1128,12 +1306,68 @@ void gl_clear_screen(cligen_handle h)
 void
 gl_redraw(cligen_handle h)
 {
-    if (gl_init_done > 0) {
-        gl_putc('\n');
-        gl_fixup(h, cligen_prompt(h), -2, gl_pos);
+    struct gl_state *gs = gl_state(h);
+    if (gs->gl_init_done > 0) {
+        gl_putc(h, '\n');
+        gl_fixup(h, cligen_prompt(h), -2, gs->gl_pos);
     }
 }
 
+/*! Record that input chars [left, right) are now drawn on screen
+ * @param[in] h       CLIgen handle
+ * @param[in] left    First redrawn index of the input buffer
+ * @param[in] right   End of redraw
+ * @see gl_fixup_diff
+ */
+static void
+gl_fixup_shown(cligen_handle h,
+	       int           left,
+	       int           right)
+{
+    struct gl_state *gs = gl_state(h);
+    char            *shown;
+
+    if (gs->fixup_shown_size < cligen_buf_size(h)){
+	if ((shown = realloc(gs->fixup_shown, cligen_buf_size(h))) == NULL){
+	    gs->fixup_shown_len = 0; /* no diff, redraw as told */
+	    return;
+	}
+	gs->fixup_shown = shown;
+	gs->fixup_shown_size = cligen_buf_size(h);
+    }
+    if (left > gs->fixup_shown_len) /* gap of unknown content */
+	return;
+    if (right > left)
+	memcpy(gs->fixup_shown+left, cligen_buf(h)+left, right-left);
+    gs->fixup_shown_len = right;
+}
+
+/*! Skip the part of a change that is already on screen
+ * Compares the input buffer with what was last drawn and returns the first index
+ * that differs, so that eg a recalled history line sharing a prefix with the
+ * current line only redraws its tail. Never moves the change past the cursor.
+ * @param[in] h       CLIgen handle
+ * @param[in] prompt  Prompt, no diff if changed
+ * @param[in] change  Index of the start of changes as given to gl_fixup
+ * @retval    change  Index of the first differing char, at least change
+ */
+static int
+gl_fixup_diff(cligen_handle h,
+	      char         *prompt,
+	      int           change)
+{
+    struct gl_state *gs = gl_state(h);
+    char            *buf = cligen_buf(h);
+    int              max;
+
+    if (change < 0 || strcmp(prompt, gs->fixup_last_prompt) != 0)
+	return change;
+    max = (gs->fixup_shown_len < gs->gl_pos)? gs->fixup_shown_len : gs->gl_pos;
+    while (change < max && buf[change] && buf[change] == gs->fixup_shown[change])
+	change++;
+    return change;
+}
+
 /*! Redrawing or moving within line
  *
  * This function is used both for redrawing when input changes or for
@@ -1154,100 +1388,104 @@ gl_fixup_noscroll(cligen_handle h,
 		  int           change, 
 		  int           cursor)
 {
+    struct gl_state *gs = gl_state(h);
     int          left = 0, right = -1;		/* bounds for redraw */
     int          pad;		/* how much to erase at end of line */
     int          backup;        /* how far to backup before fixing */
     int          i;
     int          p; /* pos */
-    int          new_right = -1; /* alternate right bound, using gl_extent */
+    int          new_right = -1; /* alternate right bound, using gs->gl_extent */
     int          l1, l2;
     int          plen=strlen(prompt);
 
     if (change == -2) {   /* reset */
-	gl_pos = gl_cnt = fixup_gl_shift = fixup_off_right = fixup_off_left = 0;
-	gl_putc('\r');
-	gl_puts(prompt);
-	strncpy(fixup_last_prompt, prompt, sizeof(fixup_last_prompt)-1);
+	gs->gl_pos = gs->gl_cnt = gs->fixup_gl_shift = gs->fixup_off_right = gs->fixup_off_left = 0;
+	gl_putc(h, '\r');
+	gl_puts(h, prompt);
+	strncpy(gs->fixup_last_prompt, prompt, sizeof(gs->fixup_last_prompt)-1);
+	gs->fixup_shown_len = 0;
 	change = 0;
-        gl_width = gl_termw - gl_strlen(prompt);
-    } else if (strcmp(prompt, fixup_last_prompt) != 0) {
-	l1 = gl_strlen(fixup_last_prompt);
-	l2 = gl_strlen(prompt);
-	gl_cnt = gl_cnt + l1 - l2;
-	strncpy(fixup_last_prompt, prompt, sizeof(fixup_last_prompt)-1);
-	gl_putc('\r');
-	gl_puts(prompt);
-	gl_pos = fixup_gl_shift;
-        gl_width = gl_termw - l2;
+        gs->gl_width = gs->gl_termw - gs->gl_strlen(prompt);
+    } else if (strcmp(prompt, gs->fixup_last_prompt) != 0) {
+	l1 = gs->gl_strlen(gs->fixup_last_prompt);
+	l2 = gs->gl_strlen(prompt);
+	gs->gl_cnt = gs->gl_cnt + l1 - l2;
+	strncpy(gs->fixup_last_prompt, prompt, sizeof(gs->fixup_last_prompt)-1);
+	gl_putc(h, '\r');
+	gl_puts(h, prompt);
+	gs->gl_pos = gs->fixup_gl_shift;
+        gs->gl_width = gs->gl_termw - l2;
+	gs->fixup_shown_len = 0;
 	change = 0;
     }
-    pad = (fixup_off_right)? gl_width - 1 : gl_cnt - fixup_gl_shift;   /* old length */
-    backup = gl_pos - fixup_gl_shift;
+    pad = (gs->fixup_off_right)? gs->gl_width - 1 : gs->gl_cnt - gs->fixup_gl_shift;   /* old length */
+    backup = gs->gl_pos - gs->fixup_gl_shift;
     if (change >= 0) {
-        gl_cnt = strlen(cligen_buf(h));
-        if (change > gl_cnt)
-	    change = gl_cnt;
+        gs->gl_cnt = strlen(cligen_buf(h));
+        if (change > gs->gl_cnt)
+	    change = gs->gl_cnt;
     }
-    if (cursor > gl_cnt) {
+    if (cursor > gs->gl_cnt) {
 	if (cursor != cligen_buf_size(h))		/* cligen_buf_size(h) means end of line */
-	    gl_putc('\007');
-	cursor = gl_cnt;
+	    gl_putc(h, '\007');
+	cursor = gs->gl_cnt;
     }
     if (cursor < 0) {
-	gl_putc('\007');
+	gl_putc(h, '\007');
 	cursor = 0;
     }
     if (change >= 0) {		/* text changed */
-	if (change < fixup_gl_shift + fixup_off_left) {
-	    left = fixup_gl_shift;
+	if (change < gs->fixup_gl_shift + gs->fixup_off_left) {
+	    left = gs->fixup_gl_shift;
 	} else {
 	    left = change;
-	    backup = gl_pos - change;
+	    backup = gs->gl_pos - change;
 	}
-	right = gl_cnt;
-	new_right = (gl_extent && (right > left + gl_extent))? 
-	    left + gl_extent : right;
+	right = gs->gl_cnt;
+	new_right = (gs->gl_extent && (right > left + gs->gl_extent))? 
+	    left + gs->gl_extent : right;
     }
-    pad -= gl_cnt - fixup_gl_shift;
+    pad -= gs->gl_cnt - gs->fixup_gl_shift;
     pad = (pad < 0)? 0 : pad;
     if (left <= right) {		/* clean up screen */
+	gl_fixup_shown(h, left, new_right);
 	for (p=left+backup-1; p >= left; p--){
-	    if (wrap(p, plen))
-		unwrap_line();
+	    if (wrap(h, p, plen))
+		unwrap_line(h);
 	    else
-		gl_putc('\b');
+		gl_putc(h, '\b');
 	}
-	if (left == fixup_gl_shift && fixup_off_left) {
-	    gl_putc('$');
+	if (left == gs->fixup_gl_shift && gs->fixup_off_left) {
+	    gl_putc(h, '$');
 	    left++;
         }
 	for (p=left; p < new_right; p++){
-	    gl_putc(cligen_buf(h)[p]);
-	    if (wrap(p, plen))
-		wrap_line();
+	    gl_putc(h, cligen_buf(h)[p]);
+	    if (wrap(h, p, plen))
+		wrap_line(h);
 	}
-	gl_pos = new_right;
+	gs->gl_pos = new_right;
 	for (p=new_right; p < new_right+pad; p++){ /* erase remains of prev line */
-	    gl_putc(' ');
-	    if (wrap(p, plen))
-		wrap_line();
+	    gl_putc(h, ' ');
+	    if (wrap(h, p, plen))
+		wrap_line(h);
 	}
-	gl_pos += pad;
+	gs->gl_pos += pad;
     }
     /* move to final cursor location */
-    if (gl_pos - cursor > 0) {
-	for (p=gl_pos; p > cursor; p--){
-	    if (wrap(p-1, plen))
-		unwrap_line();
+    if (gs->gl_pos - cursor > 0) {
+	for (p=gs->gl_pos; p > cursor; p--){
+	    if (wrap(h, p-1, plen))
+		unwrap_line(h);
 	    else
-		gl_putc('\b');
+		gl_putc(h, '\b');
 	} 
     }
     else {
-	for (i=gl_pos; i < cursor; i++)
-	    gl_putc(cligen_buf(h)[i]);
+	for (i=gs->gl_pos; i < cursor; i++)
+	    gl_putc(h, cligen_buf(h)[i]);
     }
-    gl_pos = cursor;
+    gs->gl_pos = cursor;
 }
 
 
@@ -1269,109 +1507,113 @@ gl_fixup_scroll(cligen_handle h,
 		int           change, 
 		int           cursor)
 {
+    struct gl_state *gs = gl_state(h);
     int          left = 0, right = -1;		/* bounds for redraw */
     int          pad;		/* how much to erase at end of line */
     int          backup;        /* how far to backup before fixing */
     int          new_shift;     /* value of shift based on cursor */
     int          extra;         /* adjusts when shift (scroll) happens */
     int          i;
-    int          new_right = -1; /* alternate right bound, using gl_extent */
+    int          new_right = -1; /* alternate right bound, using gs->gl_extent */
     int          l1, l2;
 
     if (change == -2) {   /* reset */
-	gl_pos = gl_cnt = fixup_gl_shift = fixup_off_right = fixup_off_left = 0;
-	gl_putc('\r');
-	gl_puts(prompt);
-	strncpy(fixup_last_prompt, prompt, sizeof(fixup_last_prompt)-1);
+	gs->gl_pos = gs->gl_cnt = gs->fixup_gl_shift = gs->fixup_off_right = gs->fixup_off_left = 0;
+	gl_putc(h, '\r');
+	gl_puts(h, prompt);
+	strncpy(gs->fixup_last_prompt, prompt, sizeof(gs->fixup_last_prompt)-1);
+	gs->fixup_shown_len = 0;
 	change = 0;
-        gl_width = gl_termw - gl_strlen(prompt);
-    } else if (strcmp(prompt, fixup_last_prompt) != 0) {
-	l1 = gl_strlen(fixup_last_prompt);
-	l2 = gl_strlen(prompt);
-	gl_cnt = gl_cnt + l1 - l2;
-	strncpy(fixup_last_prompt, prompt, sizeof(fixup_last_prompt)-1);
-	gl_putc('\r');
-	gl_puts(prompt);
-	gl_pos = fixup_gl_shift;
-        gl_width = gl_termw - l2;
+        gs->gl_width = gs->gl_termw - gs->gl_strlen(prompt);
+    } else if (strcmp(prompt, gs->fixup_last_prompt) != 0) {
+	l1 = gs->gl_strlen(gs->fixup_last_prompt);
+	l2 = gs->gl_strlen(prompt);
+	gs->gl_cnt = gs->gl_cnt + l1 - l2;
+	strncpy(gs->fixup_last_prompt, prompt, sizeof(gs->fixup_last_prompt)-1);
+	gl_putc(h, '\r');
+	gl_puts(h, prompt);
+	gs->gl_pos = gs->fixup_gl_shift;
+        gs->gl_width = gs->gl_termw - l2;
+	gs->fixup_shown_len = 0;
 	change = 0;
     }
-    pad = (fixup_off_right)? gl_width - 1 : gl_cnt - fixup_gl_shift;   /* old length */
-    backup = gl_pos - fixup_gl_shift;
+    pad = (gs->fixup_off_right)? gs->gl_width - 1 : gs->gl_cnt - gs->fixup_gl_shift;   /* old length */
+    backup = gs->gl_pos - gs->fixup_gl_shift;
     if (change >= 0) {
-        gl_cnt = strlen(cligen_buf(h));
-        if (change > gl_cnt)
-	    change = gl_cnt;
+        gs->gl_cnt = strlen(cligen_buf(h));
+        if (change > gs->gl_cnt)
+	    change = gs->gl_cnt;
     }
-    if (cursor > gl_cnt) {
+    if (cursor > gs->gl_cnt) {
 	if (cursor != cligen_buf_size(h))		/* cligen_buf_size(h) means end of line */
-	    gl_putc('\007');
-	cursor = gl_cnt;
+	    gl_putc(h, '\007');
+	cursor = gs->gl_cnt;
     }
     if (cursor < 0) {
-	gl_putc('\007');
+	gl_putc(h, '\007');
 	cursor = 0;
     }
-    if (fixup_off_right || (fixup_off_left && cursor < fixup_gl_shift + gl_width - gl_scrollw / 2)){
+    if (gs->fixup_off_right || (gs->fixup_off_left && cursor < gs->fixup_gl_shift + gs->gl_width - gs->gl_scrollw / 2)){
 	extra = 2;			/* shift the scrolling boundary */
     }
     else 
 	extra = 0;
     
-    new_shift = cursor + extra + gl_scrollw - gl_width;
+    new_shift = cursor + extra + gs->gl_scrollw - gs->gl_width;
     if (new_shift > 0) {
-	new_shift /= gl_scrollw;
-	new_shift *= gl_scrollw;
+	new_shift /= gs->gl_scrollw;
+	new_shift *= gs->gl_scrollw;
     } else
 	new_shift = 0;
-    if (new_shift != fixup_gl_shift) {	/* scroll occurs */
-	fixup_gl_shift = new_shift;
-	fixup_off_left = (fixup_gl_shift)? 1 : 0;
-	fixup_off_right = (gl_cnt > fixup_gl_shift + gl_width - 1)? 1 : 0;
-	left = fixup_gl_shift;
-	new_right = right = (fixup_off_right)? fixup_gl_shift + gl_width - 2 : gl_cnt;
+    if (new_shift != gs->fixup_gl_shift) {	/* scroll occurs */
+	gs->fixup_gl_shift = new_shift;
+	gs->fixup_off_left = (gs->fixup_gl_shift)? 1 : 0;
+	gs->fixup_off_right = (gs->gl_cnt > gs->fixup_gl_shift + gs->gl_width - 1)? 1 : 0;
+	left = gs->fixup_gl_shift;
+	new_right = right = (gs->fixup_off_right)? gs->fixup_gl_shift + gs->gl_width - 2 : gs->gl_cnt;
     } else if (change >= 0) {		/* no scroll, but text changed */
-	if (change < fixup_gl_shift + fixup_off_left) {
-	    left = fixup_gl_shift;
+	if (change < gs->fixup_gl_shift + gs->fixup_off_left) {
+	    left = gs->fixup_gl_shift;
 	} else {
 	    left = change;
-	    backup = gl_pos - change;
+	    backup = gs->gl_pos - change;
 	}
-	fixup_off_right = (gl_cnt > fixup_gl_shift + gl_width - 1)? 1 : 0;
-	right = (fixup_off_right)? fixup_gl_shift + gl_width - 2 : gl_cnt;
-	new_right = (gl_extent && (right > left + gl_extent))? 
-	    left + gl_extent : right;
+	gs->fixup_off_right = (gs->gl_cnt > gs->fixup_gl_shift + gs->gl_width - 1)? 1 : 0;
+	right = (gs->fixup_off_right)? gs->fixup_gl_shift + gs->gl_width - 2 : gs->gl_cnt;
+	new_right = (gs->gl_extent && (right > left + gs->gl_extent))? 
+	    left + gs->gl_extent : right;
     }
-    pad -= (fixup_off_right)? gl_width - 1 : gl_cnt - fixup_gl_shift;
+    pad -= (gs->fixup_off_right)? gs->gl_width - 1 : gs->gl_cnt - gs->fixup_gl_shift;
     pad = (pad < 0)? 0 : pad;
     if (left <= right) {		/* clean up screen */
+	gl_fixup_shown(h, left, new_right);
 	for (i=0; i < backup; i++)
-	    gl_putc('\b');
-	if (left == fixup_gl_shift && fixup_off_left) {
-	    gl_putc('$');
+	    gl_putc(h, '\b');
+	if (left == gs->fixup_gl_shift && gs->fixup_off_left) {
+	    gl_putc(h, '$');
 	    left++;
         }
 	for (i=left; i < new_right; i++)
-	    gl_putc(cligen_buf(h)[i]);
-	gl_pos = new_right;
-	if (fixup_off_right && new_right == right) {
-	    gl_putc('$');
-	    gl_pos++;
+	    gl_putc(h, cligen_buf(h)[i]);
+	gs->gl_pos = new_right;
+	if (gs->fixup_off_right && new_right == right) {
+	    gl_putc(h, '$');
+	    gs->gl_pos++;
 	} else { 
 	    for (i=0; i < pad; i++)	/* erase remains of prev line */
-		gl_putc(' ');
-	    gl_pos += pad;
+		gl_putc(h, ' ');
+	    gs->gl_pos += pad;
 	}
     }
-    i = gl_pos - cursor;		/* move to final cursor location */
+    i = gs->gl_pos - cursor;		/* move to final cursor location */
     if (i > 0) {
 	while (i--)
-	    gl_putc('\b');
+	    gl_putc(h, '\b');
     } else {
-	for (i=gl_pos; i < cursor; i++)
-	    gl_putc(cligen_buf(h)[i]);
+	for (i=gs->gl_pos; i < cursor; i++)
+	    gl_putc(h, cligen_buf(h)[i]);
     }
-    gl_pos = cursor;
+    gs->gl_pos = cursor;
 }
 
 static inline void
@@ -1380,7 +1622,10 @@ gl_fixup(cligen_handle h,
 	 int           change, 
 	 int           cursor)
 {
-    if (gl_scrolling_mode)
+    struct gl_state *gs = gl_state(h);
+
+    change = gl_fixup_diff(h, prompt, change);
+    if (gs->gl_scrolling_mode)
 	return gl_fixup_scroll(h, prompt, change, cursor);
     else
 	return gl_fixup_noscroll(h, prompt, change, cursor);
@@ -1389,14 +1634,67 @@ gl_fixup(cligen_handle h,
 /******************* strlen stuff **************************************/
 
 void 
-gl_strwidth(size_t (*func)())
+gl_strwidth(cligen_handle    h,
+	    gl_strwidth_proc func)
 {
+    struct gl_state *gs = gl_state(h);
+
     if (func != 0) {
-	gl_strlen = func;
+	gs->gl_strlen = func;
     }
 }
 
 
+/******************* hooks **************************************/
+
+int
+gl_in_hook_set(cligen_handle h,
+	       int (*fn)(void *, char *))
+{
+    gl_state(h)->gl_in_hook = fn;
+    return 0;
+}
+
+int
+gl_out_hook_set(cligen_handle h,
+		int (*fn)(void *, char *))
+{
+    gl_state(h)->gl_out_hook = fn;
+    return 0;
+}
+
+int
+gl_tab_hook_set(cligen_handle h,
+		int (*fn)(cligen_handle, int *))
+{
+    gl_state(h)->gl_tab_hook = fn;
+    return 0;
+}
+
+int
+gl_qmark_hook_set(cligen_handle h,
+		  int (*fn)(cligen_handle, char *))
+{
+    gl_state(h)->gl_qmark_hook = fn;
+    return 0;
+}
+
+int
+gl_susp_hook_set(cligen_handle     h,
+		 cligen_susp_cb_t *fn)
+{
+    gl_state(h)->gl_susp_hook = fn;
+    return 0;
+}
+
+int
+gl_interrupt_hook_set(cligen_handle          h,
+		      cligen_interrupt_cb_t *fn)
+{
+    gl_state(h)->gl_interrupt_hook = fn;
+    return 0;
+}
+
 /******************* Search stuff **************************************/
 
 
@@ -1404,31 +1702,32 @@ static void
 search_update(cligen_handle h,
 	      int           c)
 {
+    struct gl_state *gs = gl_state(h);
     if (c == 0) {
-	search_pos = 0;
-        search_string[0] = 0;
-        search_prompt[0] = '?';
-        search_prompt[1] = ' ';
-        search_prompt[2] = 0;
+	gs->search_pos = 0;
+        gs->search_string[0] = 0;
+        gs->search_prompt[0] = '?';
+        gs->search_prompt[1] = ' ';
+        gs->search_prompt[2] = 0;
     } else if (c > 0){
-	if (search_pos+1 < SEARCH_LEN) {
-	    search_string[search_pos] = c;
-	    search_string[search_pos+1] = 0;
-	    search_prompt[search_pos] = c;
-	    search_prompt[search_pos+1] = '?';
-	    search_prompt[search_pos+2] = ' ';
-	    search_prompt[search_pos+3] = 0;
-	    search_pos++;
+	if (gs->search_pos+1 < SEARCH_LEN) {
+	    gs->search_string[gs->search_pos] = c;
+	    gs->search_string[gs->search_pos+1] = 0;
+	    gs->search_prompt[gs->search_pos] = c;
+	    gs->search_prompt[gs->search_pos+1] = '?';
+	    gs->search_prompt[gs->search_pos+2] = ' ';
+	    gs->search_prompt[gs->search_pos+3] = 0;
+	    gs->search_pos++;
 	}
     } else {
-	if (search_pos > 0) {
-	    search_pos--;
-            search_string[search_pos] = 0;
-            search_prompt[search_pos] = '?';
-            search_prompt[search_pos+1] = ' ';
-            search_prompt[search_pos+2] = 0;
+	if (gs->search_pos > 0) {
+	    gs->search_pos--;
+            gs->search_string[gs->search_pos] = 0;
+            gs->search_prompt[gs->search_pos] = '?';
+            gs->search_prompt[gs->search_pos+1] = ' ';
+            gs->search_prompt[gs->search_pos+2] = 0;
 	} else {
-	    gl_putc('\007');
+	    gl_putc(h, '\007');
 	    hist_pos_set(h, hist_last_get(h));
 	}
     }
@@ -1441,28 +1740,29 @@ static void
 search_addchar(cligen_handle h, 
 	       int           c)
 {
+    struct gl_state *gs = gl_state(h);
     char *loc;
 
     search_update(h, c);
     if (c < 0) {
-	if (search_pos > 0) {
-	    hist_pos_set(h, search_last);
+	if (gs->search_pos > 0) {
+	    hist_pos_set(h, gs->search_last);
 	} else {
 	    cligen_buf(h)[0] = 0;
 	    hist_pos_set(h, hist_last_get(h));
 	}
 	hist_copy_pos(h);
     }
-    if ((loc = strstr(cligen_buf(h), search_string)) != 0) {
-	gl_fixup(h, search_prompt, 0, loc - cligen_buf(h));
-    } else if (search_pos > 0) {
-        if (search_forw_flg) {
+    if ((loc = strstr(cligen_buf(h), gs->search_string)) != 0) {
+	gl_fixup(h, gs->search_prompt, 0, loc - cligen_buf(h));
+    } else if (gs->search_pos > 0) {
+        if (gs->search_forw_flg) {
 	    search_forw(h, 0);
         } else {
 	    search_back(h, 0);
         }
     } else {
-	gl_fixup(h, search_prompt, 0, 0);
+	gl_fixup(h, gs->search_prompt, 0, 0);
     }
 }
 
@@ -1472,12 +1772,13 @@ search_addchar(cligen_handle h,
 static void     
 search_term(cligen_handle h)
 {
-    gl_search_mode = 0;
+    struct gl_state *gs = gl_state(h);
+    gs->gl_search_mode = 0;
     if (cligen_buf(h)[0] == 0)		/* not found, reset hist list */
         hist_pos_set(h, hist_last_get(h));
-    if (gl_in_hook)
-	gl_in_hook(h, cligen_buf(h));
-    gl_fixup(h, cligen_prompt(h), 0, gl_pos);
+    if (gs->gl_in_hook)
+	gs->gl_in_hook(h, cligen_buf(h));
+    gl_fixup(h, cligen_prompt(h), 0, gs->gl_pos);
 }
 
 /*! Search backwards
@@ -1487,36 +1788,32 @@ static void
 search_back(cligen_handle h, 
 	    int           new_search)
 {
-    int    found = 0;
+    struct gl_state *gs = gl_state(h);
     char  *p, *loc;
     int    last;
 
-    search_forw_flg = 0;
-    if (gl_search_mode == 0) {
+    gs->search_forw_flg = 0;
+    if (gs->gl_search_mode == 0) {
 	last = hist_last_get(h);
 	hist_pos_set(h, last);
-	search_last = last;	
+	gs->search_last = last;	
 	search_update(h, 0);
-	gl_search_mode = 1;
+	gs->gl_search_mode = 1;
         cligen_buf(h)[0] = 0;
-	gl_fixup(h, search_prompt, 0, 0);
-    } else if (search_pos > 0) {
-	while (!found) {
-	    p = hist_prev(h);
-	    if (*p == 0) {		/* not found, done looking */
-	       cligen_buf(h)[0] = 0;
-	       gl_fixup(h, search_prompt, 0, 0);
-	       found = 1;
-	    } else if ((loc = strstr(p, search_string)) != 0) {
-		strncpy(cligen_buf(h), p, cligen_buf_size(h));
-		gl_fixup(h, search_prompt, 0, loc - p);
-	       if (new_search)
-		   search_last = hist_pos(h);
-	       found = 1;
-	    } 
+	gl_fixup(h, gs->search_prompt, 0, 0);
+    } else if (gs->search_pos > 0) {
+	p = hist_search(h, gs->search_string, 0, &loc);
+	if (*p == 0) {		/* not found, done looking */
+	    cligen_buf(h)[0] = 0;
+	    gl_fixup(h, gs->search_prompt, 0, 0);
+	} else {
+	    strncpy(cligen_buf(h), p, cligen_buf_size(h));
+	    gl_fixup(h, gs->search_prompt, 0, loc - p);
+	    if (new_search)
+		gs->search_last = hist_pos(h);
 	}
     } else {
-        gl_putc('\007');
+        gl_putc(h, '\007');
     }
 }
 
@@ -1527,37 +1824,33 @@ static void
 search_forw(cligen_handle h, 
 	    int           new_search)
 {
-    int    found = 0;
+    struct gl_state *gs = gl_state(h);
     char  *p, *loc;
     int    last;
 
-    search_forw_flg = 1;
-    if (gl_search_mode == 0) {
+    gs->search_forw_flg = 1;
+    if (gs->gl_search_mode == 0) {
 	last = hist_last_get(h);
 	hist_pos_set(h, last);
-	search_last = last;
+	gs->search_last = last;
 
 	search_update(h, 0);	
-	gl_search_mode = 1;
+	gs->gl_search_mode = 1;
         cligen_buf(h)[0] = 0;
-	gl_fixup(h, search_prompt, 0, 0);
-    } else if (search_pos > 0) {
-	while (!found) {
-	    p = hist_next(h);
-	    if (*p == 0) {		/* not found, done looking */
-	       cligen_buf(h)[0] = 0;
-	       gl_fixup(h, search_prompt, 0, 0);
-	       found = 1;
-	    } else if ((loc = strstr(p, search_string)) != 0) {
-		strncpy(cligen_buf(h), p, cligen_buf_size(h));
-		gl_fixup(h, search_prompt, 0, loc - p);
-	       if (new_search)
-		   search_last = hist_pos(h);
-	       found = 1;
-	    } 
+	gl_fixup(h, gs->search_prompt, 0, 0);
+    } else if (gs->search_pos > 0) {
+	p = hist_search(h, gs->search_string, 1, &loc);
+	if (*p == 0) {		/* not found, done looking */
+	    cligen_buf(h)[0] = 0;
+	    gl_fixup(h, gs->search_prompt, 0, 0);
+	} else {
+	    strncpy(cligen_buf(h), p, cligen_buf_size(h));
+	    gl_fixup(h, gs->search_prompt, 0, loc - p);
+	    if (new_search)
+		gs->search_last = hist_pos(h);
 	}
     } else {
-        gl_putc('\007');
+        gl_putc(h, '\007');
     }
 }
 
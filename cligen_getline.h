@@ -28,31 +28,33 @@ typedef size_t (*gl_strwidth_proc)(char *);
 /*
  * Prototypes
  */
-int     gl_eof(void);
-void    gl_exitchar_add(char c);
-void    gl_char_init(void);	
-void    gl_char_cleanup(void);	
+int     gl_state_init(cligen_handle h);
+void    gl_state_exit(cligen_handle h);
+int     gl_eof(cligen_handle h);
+void    gl_exitchar_add(cligen_handle h, char c);
+void    gl_char_init(cligen_handle h);
+void    gl_char_cleanup(cligen_handle h);
 
 int     gl_getline(cligen_handle h, char **buf); /* read a line of input */
-int     gl_init(void);
-int     gl_putc(int c);		/* write one char to terminal */
-int     gl_getscrolling(void);
-void    gl_setscrolling(int);
-int     gl_setwidth(int);		/* specify width of screen */
-int     gl_getwidth(void);		/* get width of screen */
-int     gl_utf8_set(int mode);          /* set UTF-8 experimental mode */
-int     gl_utf8_get(void);              /* get UTF-8 mode */
-void	gl_strwidth(gl_strwidth_proc);	/* to bind gl_strlen */
+int     gl_putc(cligen_handle h, int c); /* write one char to terminal */
+int     gl_pending_getc(cligen_handle h); /* char of input read ahead, or -1 */
+int     gl_getscrolling(cligen_handle h);
+void    gl_setscrolling(cligen_handle h, int);
+int     gl_setwidth(cligen_handle h, int);	/* specify width of screen */
+int     gl_getwidth(cligen_handle h);		/* get width of screen */
+int     gl_utf8_set(cligen_handle h, int mode); /* set UTF-8 experimental mode */
+int     gl_utf8_get(cligen_handle h);           /* get UTF-8 mode */
+void	gl_strwidth(cligen_handle h, gl_strwidth_proc); /* to bind gl_strlen */
 void	gl_clear_screen(cligen_handle h); /* clear sceen and redraw */
 void	gl_redraw(cligen_handle h);	/* issue \n and redraw all */
 int     gl_regfd(int, cligen_fd_cb_t *, void *);
 int     gl_unregfd(int);
 
-extern int 	(*gl_in_hook)(void *, char *);
-extern int 	(*gl_out_hook)(void*, char *);
-extern int	(*gl_tab_hook)(cligen_handle, int *);
-extern cligen_susp_cb_t *gl_susp_hook;
-extern cligen_interrupt_cb_t *gl_interrupt_hook;
-extern int	(*gl_qmark_hook)(cligen_handle, char *);
+int     gl_in_hook_set(cligen_handle h, int (*fn)(void *, char *));
+int     gl_out_hook_set(cligen_handle h, int (*fn)(void *, char *));
+int     gl_tab_hook_set(cligen_handle h, int (*fn)(cligen_handle, int *));
+int     gl_qmark_hook_set(cligen_handle h, int (*fn)(cligen_handle, char *));
+int     gl_susp_hook_set(cligen_handle h, cligen_susp_cb_t *fn);
+int     gl_interrupt_hook_set(cligen_handle h, cligen_interrupt_cb_t *fn);
 
 #endif /* CLIGEN_GETLINE_H */
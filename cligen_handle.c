@@ -52,17 +52,25 @@
 #include <sys/ioctl.h>
 
 #include "cligen_buf.h"
+#include "cligen_arena.h"
 #include "cligen_cv.h"
 #include "cligen_cvec.h"
 #include "cligen_parsetree.h"
 #include "cligen_pt_head.h"
 #include "cligen_object.h"
 #include "cligen_io.h"
+#include "cligen_event.h"
 #include "cligen_handle.h"
 #include "cligen_read.h"
 #include "cligen_parse.h"
 #include "cligen_history.h"
 #include "cligen_getline.h"
+#include "cligen_regex.h"
+#include "cligen_expand.h"
+#include "cligen_match.h"
+#include "cligen_syntax.h"
+#include "cligen_stats.h"
+#include "cligen_trace.h"
 #include "cligen_handle_internal.h"
 #include "cligen_history.h"
 #include "cligen_history_internal.h"
@@ -73,29 +81,16 @@
 #define TREENAME_KEYWORD_DEFAULT "treename"
 
 /* forward */
-static int terminal_rows_set1(int rows);
+static int terminal_rows_set1(cligen_handle h, int rows);
 
 /*
  * Variables
  */
-/* Number of terminal rows as used by cligen_output pageing routine
- * @see cligen_output
+/* The first handle created, used by functions without a handle parameter
+ * such as cligen_output(). Reset when that handle is freed.
+ * @see cligen_default_handle
  */
-static int _terminalrows = 0;
-
-/* Truncate help string on right margin mode
- * This only applies if you have really long help strings, such as when generating them from a
- * spec.
- * @see print_help_line
- */
-static int _helpstr_truncate = 0;
-
-/* Limit number of lines to show, 0 means unlimited
- * This only applies if you have multi-line help strings, such as when generating them from a
- * spec.
- * @see print_help_line
- */
-static int _helpstr_lines = 0;
+static cligen_handle _default_handle = NULL;
 
 /*! Get window size and set terminal row size
  * @param[in] h       CLIgen handle
@@ -120,16 +115,19 @@ cligen_gwinsz(cligen_handle h)
 	perror("ioctl(STDIN_FILENO,TIOCGWINSZ)");
 	return -1;
     }
-    terminal_rows_set1(ws.ws_row); /* note special treatment of 0 in sub function */
+    terminal_rows_set1(h, ws.ws_row); /* note special treatment of 0 in sub function */
     cligen_terminal_width_set(h, ws.ws_col);
 
     return 0;
 }
 
+/*! Window size change signal handler
+ * The signal interrupts read() in getline, which calls the interrupt hook of the
+ * reading handle, ie cligen_gwinsz(), which queries the new size.
+ */
 void
 sigwinch_handler(int arg)
 {
-    cligen_gwinsz(0);
 }
 
 /*! This is the first call the CLIgen API and returns a handle. 
@@ -152,7 +150,30 @@ cligen_init(void)
     ch->ch_magic = CLIGEN_MAGIC;
     ch->ch_tabmode = 0x0; /* see CLIGEN_TABMODE_* */
     ch->ch_delimiter = ' ';
+    ch->ch_expand_lazy = 1;
+    ch->ch_exclude_keys = -1;
+    ch->ch_expand_fd = -1;
+    ch->ch_buf_size = GETLINE_BUFLEN_DEFAULT;
+    ch->ch_killbuf_size = GETLINE_BUFLEN_DEFAULT;
+    if ((ch->ch_arena = cligen_arena_new(0)) == NULL){
+	free(ch);
+	goto done;
+    }
+    if ((ch->ch_stats = calloc(1, sizeof(*ch->ch_stats))) == NULL){
+	cligen_arena_free(ch->ch_arena);
+	free(ch);
+	goto done;
+    }
     h = (cligen_handle)ch;
+    if (gl_state_init(h) < 0){
+	cligen_arena_free(ch->ch_arena);
+	free(ch->ch_stats);
+	free(ch);
+	h = NULL;
+	goto done;
+    }
+    if (_default_handle == NULL)
+	_default_handle = h;
     cligen_prompt_set(h, CLIGEN_PROMPT_DEFAULT);
     /* Only if stdin and stdout refers to a terminal make win size check */
     if (isatty(0) && isatty(1)){
@@ -167,7 +188,7 @@ cligen_init(void)
 	}
     }
     else
-	terminal_rows_set1(0); 
+	terminal_rows_set1(h, 0); 
     cliread_init(h);
     cligen_buf_init(h);
     /* getline cant function without some history */
@@ -185,8 +206,28 @@ cligen_exit(cligen_handle h)
     struct cligen_handle *ch = handle(h);
     pt_head              *ph;
 
+    cligen_output_flush(h);
+    if (ch->ch_output_cb)
+	cbuf_free(ch->ch_output_cb);
     hist_exit(h);
     cligen_buf_cleanup(h);
+    gl_state_exit(h);
+    if (_default_handle == h){
+	_default_handle = NULL;
+	cligen_event_exit();
+    }
+    cligen_regex_cache_flush(h);
+    cligen_str2fn_lazy_flush(h);
+    pt_overlay_flush(h);
+    cligen_expand_cache_flush(h);
+    cligen_expand_async_flush(h);
+    match_cache_flush(h);
+    if (ch->ch_arena)
+	cligen_arena_free(ch->ch_arena);
+    if (ch->ch_stats)
+	free(ch->ch_stats);
+    if (ch->ch_trace)
+	free(ch->ch_trace);
     if (ch->ch_prompt)
 	free(ch->ch_prompt);
     if (ch->ch_nomatch)
@@ -200,9 +241,69 @@ cligen_exit(cligen_handle h)
 	cligen_ph_free(ph);
     }
     free(ch);
+    cbuf_pool_flush();
     return 0;
 }
 
+/*! Add the memory used by a handle and all its parse-trees to a memory breakdown
+ * Caches of expand callback results, tree reference expansions and compiled regexps
+ * are not included.
+ * @param[in]     h    CLIgen handle
+ * @param[in,out] cm   Memory breakdown. Sizes are added, clear it before first call
+ * @retval        0    OK
+ * @retval       -1    Error
+ * @code
+ *   cligen_memsize cm = {0,};
+ *   cligen_handle_memsize(h, &cm);
+ *   cligen_memsize_print(stdout, &cm);
+ * @endcode
+ */
+int
+cligen_handle_memsize(cligen_handle   h,
+		      cligen_memsize *cm)
+{
+    struct cligen_handle *ch = handle(h);
+    pt_head              *ph;
+
+    if (cm == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    cm->cm_handle += sizeof(*ch) + ch->ch_buf_size + ch->ch_killbuf_size;
+    if (ch->ch_stats)
+	cm->cm_handle += sizeof(*ch->ch_stats);
+    if (ch->ch_trace)
+	cm->cm_handle += sizeof(*ch->ch_trace);
+    if (ch->ch_output_cb)
+	cm->cm_handle += cbuf_buflen(ch->ch_output_cb);
+    cm->cm_handle += cligen_arena_size(ch->ch_arena);
+    if (ch->ch_prompt)
+	cm->cm_strings += strlen(ch->ch_prompt)+1;
+    if (ch->ch_nomatch)
+	cm->cm_strings += strlen(ch->ch_nomatch)+1;
+    if (ch->ch_treename_keyword)
+	cm->cm_strings += strlen(ch->ch_treename_keyword)+1;
+    if (ch->ch_fn_str)
+	cm->cm_strings += strlen(ch->ch_fn_str)+1;
+    cm->cm_history += cligen_hist_memsize(h);
+    for (ph = ch->ch_pt_head; ph; ph = ph->ph_next)
+	if (cligen_ph_memsize(ph, cm) < 0)
+	    return -1;
+    return 0;
+}
+
+/*! Return the default handle, the first handle created by cligen_init()
+ *
+ * Used by functions without a handle parameter such as cligen_output().
+ * @retval  h     CLIgen handle
+ * @retval  NULL  No handle exists
+ */
+cligen_handle
+cligen_default_handle(void)
+{
+    return _default_handle;
+}
+
 /*! Check struct magic number for sanity checks
  * @param[in] h       CLIgen handle
  * return 0 if OK, -1 if fail.
@@ -354,6 +455,61 @@ cligen_treename_keyword_set(cligen_handle h,
     return 0;
 }
 
+/* Set in a pipeline worker thread while it calls callbacks. The matched object and
+ * callback name are then kept per thread instead of in the handle, which is used
+ * concurrently by the parsing thread, see cligen_eval_local */
+static __thread int     _eval_local = 0;
+static __thread cg_obj *_eval_co_match = NULL;
+static __thread char   *_eval_fn_str = NULL;
+
+/*! Keep the matched object and callback name of this thread out of the handle
+ *
+ * Used by a pipeline worker calling callbacks while another thread parses with the
+ * same handle. cligen_co_match() and cligen_fn_str_get() called by the callbacks then
+ * return the state of the worker.
+ * @param[in] on      1: keep evaluation state in this thread, 0: use the handle again
+ * @see cligen_pipeline_new
+ */
+void
+cligen_eval_local(int on)
+{
+    _eval_local = on;
+    _eval_co_match = NULL;
+    if (_eval_fn_str){
+	free(_eval_fn_str);
+	_eval_fn_str = NULL;
+    }
+}
+
+/* Handle whose callbacks are called by this thread, see cligen_eval_handle */
+static __thread cligen_handle _eval_handle = NULL;
+
+/*! Set the handle whose callbacks are called by this thread
+ * Set and restored by cligen_eval() around the callbacks of a command
+ * @param[in] h       CLIgen handle, or NULL when done
+ * @retval    h0      Handle set before, restore it when done
+ */
+cligen_handle
+cligen_eval_handle_set(cligen_handle h)
+{
+    cligen_handle h0 = _eval_handle;
+
+    _eval_handle = h;
+    return h0;
+}
+
+/*! Return the handle whose callbacks are called by this thread
+ * Used by functions without a handle parameter such as cligen_output()
+ * @retval  h     CLIgen handle
+ * @retval  NULL  No command is evaluated in this thread
+ * @see cligen_eval
+ */
+cligen_handle
+cligen_eval_handle(void)
+{
+    return _eval_handle;
+}
+
 /*! Return CLIgen object that matched in the current callback.
  *  After an evaluation when calling a callback, a node has been matched in the
  * current parse-tree. This matching node is returned (and set) here.
@@ -364,6 +520,8 @@ cligen_co_match(cligen_handle h)
 {
     struct cligen_handle *ch = handle(h);
 
+    if (_eval_local)
+	return _eval_co_match;
     return ch->ch_co_match;
 }
 
@@ -376,7 +534,10 @@ cligen_co_match_set(cligen_handle h,
 {
     struct cligen_handle *ch = handle(h);
 
-    ch->ch_co_match = co;
+    if (_eval_local)
+	_eval_co_match = co;
+    else
+	ch->ch_co_match = co;
     return 0;
 }
 
@@ -397,6 +558,8 @@ cligen_fn_str_get(cligen_handle h)
 {
     struct cligen_handle *ch = handle(h);
 
+    if (_eval_local)
+	return _eval_fn_str;
     return ch->ch_fn_str;
 }
 
@@ -410,13 +573,15 @@ cligen_fn_str_set(cligen_handle h,
 		  char         *fn_str)
 {
     struct cligen_handle *ch = handle(h);
+    char                **fs;
 
-    if (ch->ch_fn_str){
-	free(ch->ch_fn_str);
-	ch->ch_fn_str = NULL;
+    fs = _eval_local ? &_eval_fn_str : &ch->ch_fn_str;
+    if (*fs){
+	free(*fs);
+	*fs = NULL;
     }
     if (fn_str){
-	if ((ch->ch_fn_str = strdup(fn_str)) == NULL)
+	if ((*fs = strdup(fn_str)) == NULL)
 	    return -1;
     }
     return 0;
@@ -428,9 +593,9 @@ cligen_fn_str_set(cligen_handle h,
 int 
 cligen_terminal_rows(cligen_handle h)
 {
-//    struct cligen_handle *ch = handle(h);
+    struct cligen_handle *ch = handle(h?h:_default_handle);
 
-    return _terminalrows; /* ch->ch_terminalrows; */
+    return ch ? ch->ch_terminalrows : 0;
 }
 
 /*! Set number of displayed terminal rows, internal function
@@ -438,9 +603,12 @@ cligen_terminal_rows(cligen_handle h)
  * @param[in] rows    Number of lines in a terminal (y-direction)
  */
 static int 
-terminal_rows_set1(int rows)
+terminal_rows_set1(cligen_handle h,
+		   int           rows)
 {
-    _terminalrows = rows;
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_terminalrows = rows;
     return 0;
 }
 
@@ -467,7 +635,7 @@ cligen_terminal_rows_set(cligen_handle h,
     }
     if (ws.ws_row !=0 )
 	goto ok;
-    terminal_rows_set1(rows);
+    terminal_rows_set1(h, rows);
  ok:
     retval = 0;
  done:
@@ -481,9 +649,7 @@ cligen_terminal_rows_set(cligen_handle h,
 int 
 cligen_terminal_width(cligen_handle h)
 {
-//    struct cligen_handle *ch = handle(h);
-
-    return gl_getwidth()==0xffff?80:gl_getwidth();
+    return gl_getwidth(h)==0xffff?80:gl_getwidth(h);
 }
 
 /*! Set width of a CLIgen line in characters, ie, the number of 'columns' in a line
@@ -497,7 +663,6 @@ int
 cligen_terminal_width_set(cligen_handle h, 
 			  int           width)
 {
-    //    struct cligen_handle *ch = handle(h);
     int retval = -1;
 
     /* if width = 0, then set it to 65535 to effectively disable all scrolling mechanisms 
@@ -510,7 +675,7 @@ cligen_terminal_width_set(cligen_handle h,
     /* if width < 21 set it to 21, which is getline's limit. */
     else if (width < TERM_MIN_SCREEN_WIDTH)
 	width = TERM_MIN_SCREEN_WIDTH;
-    if (gl_setwidth(width) < 0)
+    if (gl_setwidth(h, width) < 0)
 	goto done; /* shouldnt happen */
     retval = 0;
  done:
@@ -526,7 +691,7 @@ cligen_terminal_width_set(cligen_handle h,
 int 
 cligen_utf8_get(cligen_handle h)
 {
-    return gl_utf8_get();
+    return gl_utf8_get(h);
 }
 
 /*! Set cligen/getline UTF-8 experimental mode
@@ -539,7 +704,7 @@ int
 cligen_utf8_set(cligen_handle h,
 		int           mode)
 {
-    return gl_utf8_set(mode);
+    return gl_utf8_set(h, mode);
 }
 
 /*! Get line scrolling mode
@@ -551,7 +716,7 @@ cligen_utf8_set(cligen_handle h,
 int 
 cligen_line_scrolling(cligen_handle h)
 {
-    return gl_getscrolling();
+    return gl_getscrolling(h);
 }
 
 /*! Set line scrolling mode
@@ -564,9 +729,9 @@ int
 cligen_line_scrolling_set(cligen_handle h,
 			  int           mode)
 {
-    int prev = gl_getscrolling();
+    int prev = gl_getscrolling(h);
 
-    gl_setscrolling(mode);
+    gl_setscrolling(h, mode);
     return prev;
 }
 
@@ -575,7 +740,7 @@ cligen_line_scrolling_set(cligen_handle h,
  * Whether to truncate help string on right margin or wrap long help lines.
  * This only applies if you have really long help strings, such as when generating them from a
  * spec.
- * @param[in] h       CLIgen handle (dummy, need to be called where h is NULL)
+ * @param[in] h       CLIgen handle, if NULL use default handle
  * @retval    0       Do not truncate help string on right margin (wrap long help lines)
  * @retval    1       Truncate help string on right margin (do not wrap long help lines)
  * @see print_help_line
@@ -583,7 +748,9 @@ cligen_line_scrolling_set(cligen_handle h,
 int 
 cligen_helpstring_truncate(cligen_handle h)
 {
-    return _helpstr_truncate;
+    struct cligen_handle *ch = handle(h?h:_default_handle);
+
+    return ch ? ch->ch_helpstr_truncate : 0;
 }
 
 /*! Set help string truncate mode (for ?)
@@ -591,7 +758,7 @@ cligen_helpstring_truncate(cligen_handle h)
  * Whether to truncate help string on right margin or wrap long help lines.
  * This only applies if you have really long help strings, such as when generating them from a
  * spec.
- * @param[in]  h     CLIgen handle (dummy, need to be called where h is NULL)
+ * @param[in]  h     CLIgen handle, if NULL use default handle
  * @param[in]  mode  0: Wrap long help strings, 1: Truncate help string
  * @retval     0     OK
  * @see print_help_line
@@ -600,7 +767,10 @@ int
 cligen_helpstring_truncate_set(cligen_handle h,
 			       int           mode)
 {
-    _helpstr_truncate = mode;
+    struct cligen_handle *ch = handle(h?h:_default_handle);
+
+    if (ch)
+	ch->ch_helpstr_truncate = mode;
     return 0;
 }
 
@@ -608,21 +778,23 @@ cligen_helpstring_truncate_set(cligen_handle h,
  *
  * This only applies if you have multi-line help strings, such as when generating them from a
  * spec.
- * @param[in] h       CLIgen handle (dummy, need to be called where h is NULL)
+ * @param[in] h       CLIgen handle, if NULL use default handle
  * @retval    n       Number of help string lines to display per command, 0 is unlimted
  * @see print_help_line
  */
 int 
 cligen_helpstring_lines(cligen_handle h)
 {
-    return _helpstr_lines;
+    struct cligen_handle *ch = handle(h?h:_default_handle);
+
+    return ch ? ch->ch_helpstr_lines : 0;
 }
 
 /*! Set help string truncate mode (for ?)
  *
  * This only applies if you have multi-line help strings, such as when generating them from a
  * spec.
- * @param[in] h       CLIgen handle (dummy, need to be called where h is NULL)
+ * @param[in] h       CLIgen handle, if NULL use default handle
  * @retval    n       Number of help string lines to display per command, 0 means unlimited.
  * @see print_help_line
  */
@@ -630,7 +802,10 @@ int
 cligen_helpstring_lines_set(cligen_handle h,
 			       int        lines)
 {
-    _helpstr_lines = lines;
+    struct cligen_handle *ch = handle(h?h:_default_handle);
+
+    if (ch)
+	ch->ch_helpstr_lines = lines;
     return 0;
 }
 
@@ -838,9 +1013,6 @@ cligen_regex_xsd_set(cligen_handle h,
 }
 
 
-static int _getline_bufsize = GETLINE_BUFLEN_DEFAULT;
-static int _getline_killbufsize = GETLINE_BUFLEN_DEFAULT;
-
 /*!
  * @param[in] h       CLIgen handle
  */
@@ -870,7 +1042,9 @@ cligen_killbuf(cligen_handle h)
 int 
 cligen_buf_size(cligen_handle h)
 {
-    return _getline_bufsize;
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_buf_size;
 }
 
 /*! Return length cligen kill buffer
@@ -879,7 +1053,9 @@ cligen_buf_size(cligen_handle h)
 int 
 cligen_killbuf_size(cligen_handle h)
 {
-    return _getline_killbufsize;
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_killbuf_size;
 }
 
 /*!
@@ -890,16 +1066,16 @@ cligen_buf_init(cligen_handle h)
 {
     struct cligen_handle *ch = handle(h);
 
-    if ((ch->ch_buf = malloc(_getline_bufsize)) == NULL){
+    if ((ch->ch_buf = malloc(ch->ch_buf_size)) == NULL){
 	fprintf(stderr, "%s malloc: %s\n", __FUNCTION__, strerror(errno));
 	return -1;
     }
-    memset(ch->ch_buf, 0, _getline_bufsize);
-    if ((ch->ch_killbuf = malloc(_getline_killbufsize)) == NULL){
+    memset(ch->ch_buf, 0, ch->ch_buf_size);
+    if ((ch->ch_killbuf = malloc(ch->ch_killbuf_size)) == NULL){
 	fprintf(stderr, "%s malloc: %s\n", __FUNCTION__, strerror(errno));
 	return -1;
     }
-    memset(ch->ch_killbuf, 0, _getline_killbufsize);
+    memset(ch->ch_killbuf, 0, ch->ch_killbuf_size);
     return 0;
 }
 
@@ -916,17 +1092,17 @@ cligen_buf_increase(cligen_handle h,
 		    size_t        len1)
 {
     struct cligen_handle *ch = handle(h);
-    size_t                len0 = _getline_bufsize; /* orig length */
+    size_t                len0 = ch->ch_buf_size; /* orig length */
 
-    if (_getline_bufsize >= len1 + 1)
+    if (ch->ch_buf_size >= len1 + 1)
       return 0;
-    while (_getline_bufsize < len1 + 1)
-      _getline_bufsize *= 2;      
-    if ((ch->ch_buf = realloc(ch->ch_buf, _getline_bufsize)) == NULL){
+    while (ch->ch_buf_size < len1 + 1)
+      ch->ch_buf_size *= 2;      
+    if ((ch->ch_buf = realloc(ch->ch_buf, ch->ch_buf_size)) == NULL){
 	fprintf(stderr, "%s realloc: %s\n", __FUNCTION__, strerror(errno));
 	return -1;
     }
-    memset(ch->ch_buf+len0, 0, _getline_bufsize-len0);
+    memset(ch->ch_buf+len0, 0, ch->ch_buf_size-len0);
     return 0;
 }
 
@@ -939,17 +1115,17 @@ cligen_killbuf_increase(cligen_handle h,
 			size_t        len1)
 {
     struct cligen_handle *ch = handle(h);
-    int                   len0 = _getline_killbufsize;
+    int                   len0 = ch->ch_killbuf_size;
 
-    if (_getline_killbufsize >= len1 + 1)
+    if (ch->ch_killbuf_size >= len1 + 1)
       return 0;
-    while (_getline_killbufsize < len1 + 1)
-      _getline_killbufsize *= 2;      
-    if ((ch->ch_killbuf = realloc(ch->ch_killbuf, _getline_killbufsize)) == NULL){
+    while (ch->ch_killbuf_size < len1 + 1)
+      ch->ch_killbuf_size *= 2;      
+    if ((ch->ch_killbuf = realloc(ch->ch_killbuf, ch->ch_killbuf_size)) == NULL){
 	fprintf(stderr, "%s realloc: %s\n", __FUNCTION__, strerror(errno));
 	return -1;
     }
-    memset(ch->ch_killbuf+len0, 0, _getline_killbufsize-len0);
+    memset(ch->ch_killbuf+len0, 0, ch->ch_killbuf_size-len0);
     return 0;
 }
 
@@ -1020,3 +1196,225 @@ cligen_preference_mode_set(cligen_handle h,
     ch->ch_preference_mode = flag;
     return 0;
 }
+
+/*! Get lazy expansion mode
+ * @param[in] h      CLIgen handle
+ * @retval    1      pt_expand references static commands in the original parse-tree
+ * @retval    0      pt_expand copies all objects to the shadow parse-tree
+ * @see pt_expand
+ */
+int 
+cligen_expand_lazy(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_lazy;
+}
+
+/*! Set lazy expansion mode
+ * In lazy mode (default), pt_expand only creates shadow objects for variables, such as
+ * choice and expand variables. Static commands are referenced in place.
+ * @param[in] h      CLIgen handle
+ * @param[in] mode   1: lazy (default), 0: copy all objects
+ * @retval    0      OK
+ */
+int 
+cligen_expand_lazy_set(cligen_handle h,
+		       int           mode)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_expand_lazy = mode;
+    return 0;
+}
+
+/*! Get expand callback cache time-to-live
+ * @param[in] h      CLIgen handle
+ * @retval    0      Cache disabled, expand callbacks are always called
+ * @retval    ttl    Cached results are valid for ttl milliseconds
+ * @retval   <0      Cached results are valid until flushed
+ * @see cligen_expand_cache_set
+ */
+int 
+cligen_expand_cache(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_cache_ttl;
+}
+
+/*! Enable caching of expand callback results
+ * The result of an expand callback is cached with the callback function, its
+ * arguments and the values of the command variables as key, so that repeated TAB
+ * and '?' on the same command line do not call the callback again.
+ * Use cligen_expand_cache_flush() to invalidate the cache when the data changes.
+ * @param[in] h      CLIgen handle
+ * @param[in] ttl    0: disabled (default), >0: valid for ttl ms, <0: valid until flushed
+ * @retval    0      OK
+ * @see cligen_expand_cache_flush
+ */
+int 
+cligen_expand_cache_set(cligen_handle h,
+			int           ttl)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_expand_cache_ttl = ttl;
+    if (ttl == 0)
+	cligen_expand_cache_flush(h);
+    return 0;
+}
+
+/*! Get deadline of expand callbacks during completion
+ * @param[in] h      CLIgen handle
+ * @retval    0      No deadline, wait for pending expand callbacks
+ * @retval    ms     Max time in milliseconds to wait for expand callbacks on TAB and '?'
+ * @see cligen_expand_deadline_set
+ */
+int 
+cligen_expand_deadline(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_deadline;
+}
+
+/*! Set deadline of expand callbacks during completion
+ * An expand callback may start a request, call cligen_expand_wait() with a file
+ * descriptor that becomes readable when the request is done, and return
+ * CLIGEN_EXPAND_PENDING with the commands it has so far, possibly none.
+ * CLIgen then waits for the file descriptor and calls the callback again.
+ * On TAB and '?', CLIgen waits at most the deadline and then shows the partial
+ * commands and a hint. The file descriptor is registered with cligen_regfd and
+ * the callback is then called again when it is readable, and a complete result
+ * is added to the expand cache, see cligen_expand_cache_set.
+ * When a command is evaluated, CLIgen always waits for the complete result.
+ * @param[in] h      CLIgen handle
+ * @param[in] ms     Deadline in milliseconds, 0: no deadline (default)
+ * @retval    0      OK
+ * @see cligen_expand_wait
+ */
+int 
+cligen_expand_deadline_set(cligen_handle h,
+			   int           ms)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_expand_deadline = ms;
+    return 0;
+}
+
+/*! Register file descriptor of a pending expand callback
+ * Call from an expand callback returning CLIGEN_EXPAND_PENDING. When fd is readable
+ * the callback is called again with the same arguments.
+ * @param[in] h      CLIgen handle, or NULL for the default handle if the callback
+ *                   only has the user handle
+ * @param[in] fd     File descriptor
+ * @retval    0      OK
+ * @see cligen_expand_deadline_set
+ */
+int 
+cligen_expand_wait(cligen_handle h,
+		   int           fd)
+{
+    struct cligen_handle *ch = handle(h?h:_default_handle);
+
+    ch->ch_expand_fd = fd;
+    return 0;
+}
+
+/*! Get number of expand callbacks that did not finish before the deadline in the
+ * latest completion (TAB or '?')
+ * @param[in] h      CLIgen handle
+ * @retval    n      Number of pending expand callbacks
+ */
+int 
+cligen_expand_pending(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_pending;
+}
+
+/*! Get number of lines parsed ahead of callbacks in batch mode
+ * @param[in] h      CLIgen handle
+ * @retval    0      Callbacks of a line are called before the next line is parsed
+ * @retval    depth  Max number of lines parsed but not yet reported
+ * @see cligen_batch_pipeline_set
+ */
+int 
+cligen_batch_pipeline(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_batch_pipeline;
+}
+
+/*! Set number of lines parsed ahead of callbacks in batch mode
+ * If depth > 0, cligen_eval_batch() and cligen_eval_batch_vec() call the callbacks
+ * of a line in a worker thread while the following lines are parsed, see
+ * cligen_pipeline_new().
+ * Only valid for callbacks without side effects on the handle, ie callbacks that do
+ * not change parse-trees, the active tree or other handle settings, since they run
+ * while the next lines are parsed. Working point callbacks, see cligen_wp_set(), are
+ * called when all earlier lines are done, before the next line is parsed.
+ * @param[in] h      CLIgen handle
+ * @param[in] depth  Max lines parsed ahead, 0: off (default)
+ * @retval    0      OK
+ */
+int 
+cligen_batch_pipeline_set(cligen_handle h,
+			  int           depth)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_batch_pipeline = depth < 0 ? 0 : depth;
+    return 0;
+}
+
+/*! Get arena of handle, used for transient state in a single evaluation
+ * Allocations must be released with a mark, since evaluations may be nested,
+ * eg when a callback evaluates another command.
+ * @param[in] h      CLIgen handle
+ * @retval    ca     Arena
+ * @see cligen_arena_mark_get
+ */
+struct cligen_arena *
+cligen_handle_arena(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_arena;
+}
+
+/*! Get whether keywords are excluded from the variable vector passed to callbacks
+ * @param[in] h      CLIgen handle
+ * @retval    0      Keywords are included
+ * @retval    1      Keywords are excluded
+ * If not set for the handle, the process default set by cv_exclude_keys() is used
+ * @see cligen_exclude_keys_set
+ */
+int
+cligen_exclude_keys(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_exclude_keys < 0)
+	return cv_exclude_keys_get();
+    return ch->ch_exclude_keys;
+}
+
+/*! Set whether keywords are excluded from the variable vector passed to callbacks
+ * @param[in] h      CLIgen handle
+ * @param[in] status 0: include keywords, 1: exclude keywords, -1: use process default
+ * @see cv_exclude_keys  Process default
+ */
+int
+cligen_exclude_keys_set(cligen_handle h,
+			int           status)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_exclude_keys = status;
+    return 0;
+}
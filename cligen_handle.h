@@ -62,6 +62,7 @@
  */
 cligen_handle cligen_init(void);
 int cligen_exit(cligen_handle);
+int cligen_handle_memsize(cligen_handle h, cligen_memsize *cm);
 int cligen_check(cligen_handle h);
 
 int cligen_exiting(cligen_handle h);
@@ -140,4 +141,21 @@ int  cligen_delimiter_set(cligen_handle h, char delimiter);
 int cligen_preference_mode(cligen_handle h);
 int cligen_preference_mode_set(cligen_handle h, int flag);
 
+int cligen_expand_lazy(cligen_handle h);
+int cligen_expand_lazy_set(cligen_handle h, int mode);
+int cligen_expand_cache(cligen_handle h);
+int cligen_expand_cache_set(cligen_handle h, int ttl);
+int cligen_expand_deadline(cligen_handle h);
+int cligen_expand_deadline_set(cligen_handle h, int ms);
+int cligen_expand_wait(cligen_handle h, int fd);
+int cligen_expand_pending(cligen_handle h);
+int cligen_batch_pipeline(cligen_handle h);
+int cligen_batch_pipeline_set(cligen_handle h, int depth);
+
+struct cligen_arena *cligen_handle_arena(cligen_handle h);
+
+cligen_handle cligen_default_handle(void);
+int cligen_exclude_keys(cligen_handle h);
+int cligen_exclude_keys_set(cligen_handle h, int status);
+
 #endif /* _CLIGEN_HANDLE_H_ */
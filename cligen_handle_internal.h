@@ -68,6 +68,11 @@ typedef struct pt_head  { /* Linked list of cligen parse-trees */
     int              ph_active;    /* First one is active */
     cg_obj          *ph_workpt;    /* Shortcut to "working point" cligen object, or more 
                                     * specifically its parse-tree sub vector. */
+    int              ph_gen;       /* Incremented when parse-tree or working point changes */
+    cligen_handle    ph_handle;    /* Handle of the header, passed to ph_loader */
+    cligen_ph_loader_t *ph_loader; /* Loads ph_parsetree on first use, see cligen_ph_loader_set */
+    void            *ph_loader_arg; /* Argument of ph_loader */
+    int              ph_loading;   /* Set while ph_loader is called */
 } pt_head;
 
 /* CLIgen handle. Its members should be hidden and only the typedef visible */
@@ -93,6 +98,17 @@ struct cligen_handle{
 
     char       *ch_buf;          /* getline input buffer */
     char       *ch_killbuf;      /* getline killed text */
+    int         ch_buf_size;     /* allocated length of ch_buf */
+    int         ch_killbuf_size; /* allocated length of ch_killbuf */
+    struct gl_state *ch_gl;      /* getline editing state, see cligen_getline.c */
+    int         ch_terminalrows; /* Number of terminal rows used by cligen_output paging */
+    int         ch_output_lines; /* Lines printed by cligen_output since last page break */
+    struct cbuf *ch_output_cb;   /* Output not yet written, see cligen_output_flush */
+    FILE       *ch_output_f;     /* Stream of buffered output */
+    int         ch_output_defer; /* Evaluating a command: write output at end of command */
+    int         ch_helpstr_truncate; /* Truncate help string on right margin */
+    int         ch_helpstr_lines;    /* Max number of help string lines, 0 means unlimited */
+    int         ch_exclude_keys; /* Exclude keys from callback cvv, -1: use cv_exclude_keys() */
 
     int         ch_logsyntax;    /* Debug syntax by printing dynamically on stderr */
     int         ch_hist_size;    /* Number of history lines MUST be >0 */
@@ -100,12 +116,45 @@ struct cligen_handle{
     int         ch_hist_cur;     /* Current position (line) in history */
     int         ch_hist_last;    /* Last position in history */
     char       *ch_hist_pre;     /* Previous position in history */
+    uint64_t   *ch_hist_sig;     /* Signature of each history line, see hist_search */
+    FILE       *ch_hist_file;    /* Append new history lines to this file, or NULL */
+    int         ch_hist_file_max;   /* Compact history file when more lines, 0: never */
+    int         ch_hist_file_lines; /* Lines of history file */
     
     void       *ch_userhandle;   /* Use this as app-specific callback handle */
     void       *ch_userdata;     /* application-specific data (any data) */
     int         ch_regex_xsd;    /* 0: POSIX / REGEX(3); 1: LIBXML2 XSD */
+    void       *ch_regex_cache;  /* Compiled regexps, see cligen_regex.c */
+    void       *ch_str2fn_lazy;  /* Lazy mapping of callback functions, see cligen_syntax.c */
+    int         ch_tree_gen;     /* Incremented when a parse-tree or working point changes */
+    int         ch_treeref_gen;  /* ch_tree_gen when tree references were expanded */
+    void       *ch_pt_overlay;   /* Private copies of frozen parse-tree levels, see cligen_expand.c */
     char        ch_delimiter;    /* Delimiter between objects */
     int         ch_preference_mode;   /* Relaxed variable match preference handling */
+    int         ch_expand_lazy;  /* pt_expand references static commands instead of copying */
+    int         ch_expand_cache_ttl; /* Expand callback cache: 0 off, >0 ms, <0 until flushed */
+    void       *ch_expand_cache; /* Cached expand callback results, see cligen_expand.c */
+    int         ch_expand_deadline; /* Max ms to wait for pending expand callbacks on TAB/? */
+    int         ch_expand_fd;    /* Set by cligen_expand_wait() in a pending expand callback */
+    int         ch_expand_pending; /* Expand callbacks not finished in latest completion */
+    int         ch_batch_pipeline; /* Lines parsed ahead of callbacks in batch mode, 0: off */
+    void       *ch_expand_async; /* Pending expand callbacks, see cligen_expand.c */
+    int         ch_completing;   /* Set in TAB and ? hooks, ie when deadline applies */
+    void       *ch_match_cache;  /* Matched path of latest completion, see cligen_match.c */
+    struct cligen_arena *ch_arena; /* Scratch memory for transient match state */
+    struct cligen_stats *ch_stats; /* Hot-path counters, see cligen_stats.h */
+    struct cligen_trace *ch_trace; /* Trace of command being parsed if ch_trace_fn is set */
+    int       (*ch_trace_fn)(cligen_handle, struct cligen_trace *, void *); /* Trace hook */
+    void       *ch_trace_arg;    /* Argument of ch_trace_fn */
+    struct cligen_session *ch_session; /* Session bound while it is fed, see cligen_session.c */
+    struct cligen_session *ch_session_last; /* Latest bound session, only compared */
 };
 
+/*
+ * Prototypes
+ */
+void cligen_eval_local(int on);
+cligen_handle cligen_eval_handle_set(cligen_handle h);
+cligen_handle cligen_eval_handle(void);
+
 #endif /* _CLIGEN_HANDLE_INTERNAL_H_ */
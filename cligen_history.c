@@ -54,6 +54,9 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/file.h>
 #include <sys/select.h>
 #include <netinet/in.h>
 #include <string.h>
@@ -101,15 +104,179 @@ hist_save(char *p)
     return s;
 }
 
-/*! Add a line to the CLIgen history 
+/*! Signature of a string: one bit for each pair of adjacent characters
+ *
+ * A line can only contain a string if all bits of the signature of the string are set
+ * in the signature of the line. This is an index that lets history search skip most
+ * lines without comparing strings.
+ * @param[in] s     String
+ * @retval    sig   Signature, 0 if s is shorter than two characters
+ */
+static uint64_t
+hist_sig(const char *s)
+{
+    uint64_t sig = 0;
+
+    for (; s[0] && s[1]; s++)
+	sig |= (uint64_t)1 << (((unsigned char)s[0]*31 + (unsigned char)s[1]) & 63);
+    return sig;
+}
+
+/*! Check if a line of a history file is blank, blank lines are not added, see hist_add1
+ * @param[in] p    Start of line
+ * @param[in] q    End of line, excluding newline
+ */
+static int
+hist_blank(char *p,
+	   char *q)
+{
+    for (; p < q; p++)
+	if (*p != ' ' && *p != '\t')
+	    return 0;
+    return 1;
+}
+
+/*! Find the start of the last lines of a history file that are added to the history
+ *
+ * Blank lines, and lines equal to the line before them, are not added, see hist_add1.
+ * The file is searched from the end so that the history is filled with the last n
+ * lines that are added.
+ * @param[in] start  Contents of file
+ * @param[in] end    End of contents
+ * @param[in] n      Number of lines to add
+ * @retval    p      Start of the n:th last added line, or start if there are fewer
+ */
+static char *
+hist_file_tail(char *start,
+	       char *end,
+	       int   n)
+{
+    char  *p;            /* Start of line */
+    char  *q = end;      /* End of line */
+    char  *cand = NULL;  /* Later non-blank line, added if it differs from this line */
+    size_t candlen = 0;
+    int    count = 0;
+
+    if (n <= 0)
+	return end;
+    while (1){
+	for (p = q; p > start && *(p-1) != '\n'; p--)
+	    ;
+	if (!hist_blank(p, q)){
+	    if (cand &&
+		(candlen != q - p || memcmp(cand, p, candlen) != 0) &&
+		++count == n)
+		return cand;
+	    cand = p;
+	    candlen = q - p;
+	}
+	if (p == start)
+	    break;
+	q = p - 1; /* Newline of the line before */
+    }
+    return start;
+}
+
+/*! Compact the history file to the last lines that fit in the history
+ *
+ * Lines appended by other sessions sharing the file are kept. The file is not
+ * compacted if it can not be read, ie is not opened with "a+".
+ * Called with the file locked, see hist_file_append.
  * @param[in] h   CLIgen handle
- * @param[in] buf String to add to history
  * @retval    0   OK
  * @retval   -1   Error
  */
-int
-hist_add(cligen_handle h,
-	 char         *buf)
+static int
+hist_file_compact(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    int                   retval = -1;
+    FILE                 *f = ch->ch_hist_file;
+    cbuf                 *cb = NULL;
+    char                  buf[BUFSIZ];
+    size_t                n;
+    char                 *start;
+    char                 *end;
+    char                 *p;
+    int                   lines = 0;
+
+    if ((cb = cbuf_new()) == NULL)
+	goto done;
+    if (fseek(f, 0, SEEK_SET) < 0)
+	goto done;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+	if (cbuf_append_buf(cb, buf, n) < 0)
+	    goto done;
+    if (ferror(f)){ /* Not readable: dont compact again */
+	clearerr(f);
+	ch->ch_hist_file_lines = 0;
+	goto ok;
+    }
+    /* Find start of the last lines that fit */
+    end = cbuf_get(cb) + cbuf_len(cb);
+    start = hist_file_tail(cbuf_get(cb), end, ch->ch_hist_size - 1);
+    for (p = start; (p = memchr(p, '\n', end - p)) != NULL; p++)
+	lines++;
+    if (ftruncate(fileno(f), 0) < 0)
+	goto done;
+    if (fseek(f, 0, SEEK_SET) < 0)
+	goto done;
+    n = end - start;
+    if (fwrite(start, 1, n, f) != n)
+	goto done;
+    fflush(f);
+    ch->ch_hist_file_lines = lines;
+ ok:
+    retval = 0;
+ done:
+    if (cb)
+	cbuf_free(cb);
+    return retval;
+}
+
+/*! Append a line to the history file, see cligen_hist_file_append()
+ * The file is locked while the line is appended and the file is compacted, so that
+ * lines appended by other sessions sharing the file are not lost.
+ * @param[in] h     CLIgen handle
+ * @param[in] line  History line
+ * @retval    0     OK
+ * @retval   -1     Error
+ */
+static int
+hist_file_append(cligen_handle h,
+		 char         *line)
+{
+    struct cligen_handle *ch = handle(h);
+    int                   retval = -1;
+    int                   fd = fileno(ch->ch_hist_file);
+
+    if (flock(fd, LOCK_EX) < 0)
+	return -1;
+    if (fprintf(ch->ch_hist_file, "%s\n", line) < 0)
+	goto done;
+    fflush(ch->ch_hist_file);
+    ch->ch_hist_file_lines++;
+    if (ch->ch_hist_file_max > 0 &&
+	ch->ch_hist_file_lines > ch->ch_hist_file_max &&
+	hist_file_compact(h) < 0)
+	goto done;
+    retval = 0;
+ done:
+    flock(fd, LOCK_UN);
+    return retval;
+}
+
+/*! Add a line to the CLIgen history 
+ * @param[in] h      CLIgen handle
+ * @param[in] buf    String to add to history
+ * @param[in] append Append line to history file, if set
+ * @retval    0      OK
+ * @retval   -1      Error
+ */
+static int
+hist_add1(cligen_handle h,
+	  char         *buf,
+	  int           append)
 {
     struct cligen_handle *ch = handle(h);
     int   retval = -1;
@@ -130,6 +297,10 @@ hist_add(cligen_handle h,
             if ((ch->ch_hist_buf[ch->ch_hist_last] = hist_save(buf)) == NULL)
 		goto done;
 	    ch->ch_hist_pre = ch->ch_hist_buf[ch->ch_hist_last];
+	    ch->ch_hist_sig[ch->ch_hist_last] = hist_sig(ch->ch_hist_pre);
+	    if (append && ch->ch_hist_file &&
+		hist_file_append(h, ch->ch_hist_pre) < 0)
+		goto done;
             ch->ch_hist_last = (ch->ch_hist_last + 1) % ch->ch_hist_size;
             if (ch->ch_hist_buf[ch->ch_hist_last] && *ch->ch_hist_buf[ch->ch_hist_last]) {
 	        free(ch->ch_hist_buf[ch->ch_hist_last]);
@@ -143,6 +314,19 @@ hist_add(cligen_handle h,
     return retval;
 }
 
+/*! Add a line to the CLIgen history, and to the history file in append mode
+ * @param[in] h   CLIgen handle
+ * @param[in] buf String to add to history
+ * @retval    0   OK
+ * @retval   -1   Error
+ */
+int
+hist_add(cligen_handle h,
+	 char         *buf)
+{
+    return hist_add1(h, buf, 1);
+}
+
 
 /*! Clear the history and deallocate all memory of the history
  * @param[in] h     CLIgen handle
@@ -160,10 +344,36 @@ hist_exit(cligen_handle h)
 	}
     free(ch->ch_hist_buf);
     ch->ch_hist_buf = NULL;
+    if (ch->ch_hist_sig){
+	free(ch->ch_hist_sig);
+	ch->ch_hist_sig = NULL;
+    }
     // done:
     return 0;
 }
 
+/*! Return the memory used by the history of a handle
+ * @param[in] h     CLIgen handle
+ * @retval    sz    Bytes allocated for history lines, the line vector and signatures
+ */
+size_t
+cligen_hist_memsize(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    size_t                sz = 0;
+    int                   i;
+
+    if (ch->ch_hist_buf == NULL)
+	return 0;
+    sz += ch->ch_hist_size*sizeof(char*);
+    if (ch->ch_hist_sig)
+	sz += ch->ch_hist_size*sizeof(uint64_t);
+    for (i=0; i < ch->ch_hist_size; i++)
+	if (ch->ch_hist_buf[i] && strlen(ch->ch_hist_buf[i])) /* "" is not malloced */
+	    sz += strlen(ch->ch_hist_buf[i])+1;
+    return sz;
+}
+
 /*! Loads previous hist entry into input buffer, sticks on first 
  * @param[in] h     CLIgen handle
  */
@@ -180,7 +390,7 @@ hist_prev(cligen_handle h)
     } 
     if (p == 0) {
 	p = "";
-	gl_putc('\007');
+	gl_putc(h, '\007');
     }
     return p;
 }
@@ -200,7 +410,7 @@ hist_next(cligen_handle h)
     } 
     if (p == 0) {
 	p = "";
-	gl_putc('\007');
+	gl_putc(h, '\007');
     }
     return p;
 }
@@ -241,6 +451,39 @@ hist_last_get(cligen_handle h)
     return ch->ch_hist_last;
 }
 
+/*! Search history for a string, from the current position
+ *
+ * Step backwards or forwards in history until a line containing str is found.
+ * Lines are first checked with their signature, see hist_sig().
+ * @param[in]  h       CLIgen handle
+ * @param[in]  str     String to search for
+ * @param[in]  forward Search forward (newer lines), otherwise backwards
+ * @param[out] locp    Position of str in the returned line
+ * @retval     line    History line containing str, the current position is at that line
+ * @retval     ""      Not found, the first or last line of history was reached
+ */
+char *
+hist_search(cligen_handle h,
+	    char         *str,
+	    int           forward,
+	    char        **locp)
+{
+    struct cligen_handle *ch = handle(h);
+    uint64_t              sig;
+    char                 *p;
+
+    sig = hist_sig(str);
+    while (1){
+	p = forward ? hist_next(h) : hist_prev(h);
+	if (*p == '\0')
+	    break;
+	if ((ch->ch_hist_sig[ch->ch_hist_cur] & sig) == sig &&
+	    (*locp = strstr(p, str)) != NULL)
+	    break;
+    }
+    return p;
+}
+
 /*! Copy history line/pos to cligen buffer 
  * @param[in] h   CLIgen handle
  * @param[in] pos Line number to copy from history to cligen main buffer
@@ -323,6 +566,10 @@ cligen_hist_init(cligen_handle h,
 	}
     if ((ch->ch_hist_buf = (char**)realloc(ch->ch_hist_buf, ch->ch_hist_size*sizeof(char*))) == NULL)
 	goto done;
+    if (ch->ch_hist_sig)
+	free(ch->ch_hist_sig);
+    if ((ch->ch_hist_sig = calloc(ch->ch_hist_size, sizeof(uint64_t))) == NULL)
+	goto done;
     ch->ch_hist_cur = 0;
     ch->ch_hist_last = 0;
     ch->ch_hist_pre = 0;
@@ -335,9 +582,12 @@ cligen_hist_init(cligen_handle h,
 }
 
 /*! Read history entries from file
+ *
+ * The file is read in blocks and only the last lines that fit in the history are added.
  * @param[in] h  CLIgen handle
  * @param[in] f  Open file for read
  * @see cligen_hist_init must be called before
+ * @see cligen_hist_file_append to append new lines to the same file
  * @note open file f instead of filename so that caller can have better error 
  *       control if file not found or lacking permissions
  */
@@ -346,34 +596,80 @@ cligen_hist_file_load(cligen_handle h,
 		      FILE         *f)
 	    
 {
-    int           retval = -1;
-    int           ret;
-    unsigned char ch;
-    cbuf         *cb = NULL;
+    struct cligen_handle *ch = handle(h);
+    int                   retval = -1;
+    cbuf                 *cb = NULL;
+    char                  buf[BUFSIZ];
+    size_t                n;
+    char                 *p;
+    char                 *end;
+    char                 *nl;
+    int                   lines = 0;
+    int                   locked = 0;
 
     if ((cb = cbuf_new()) == NULL)
 	goto done;
-    while (1){
-	ret = fgetc(f);
-	if (ret == EOF)
-	    break; /* eof or error */
-	ch = (unsigned char)ret;
-	if (ch == '\n'){
-	    if (hist_add(h, cbuf_get(cb)) < 0)
-		goto done;
-	    cbuf_reset(cb);
-	}
-	else
-	    if (cbuf_append(cb, ch) < 0)
-		goto done;
+    /* Not a partly compacted file of another session */
+    locked = flock(fileno(f), LOCK_SH) == 0;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) /* eof or error */
+	if (cbuf_append_buf(cb, buf, n) < 0)
+	    goto done;
+    if (locked){
+	flock(fileno(f), LOCK_UN);
+	locked = 0;
     }
+    end = cbuf_get(cb) + cbuf_len(cb);
+    for (p = cbuf_get(cb); (nl = memchr(p, '\n', end - p)) != NULL; p = nl + 1)
+	lines++;
+    /* Older lines would be overwritten in the circular buffer */
+    for (p = hist_file_tail(cbuf_get(cb), end, ch->ch_hist_size - 1);
+	 (nl = memchr(p, '\n', end - p)) != NULL;
+	 p = nl + 1){
+	*nl = '\0';
+	if (hist_add1(h, p, 0) < 0)
+	    goto done;
+    }
+    ch->ch_hist_file_lines = lines;
     retval = 0;
  done:
+    if (locked)
+	flock(fileno(f), LOCK_UN);
     if (cb)
 	cbuf_free(cb);
     return retval;
 }
 
+/*! Append each new history line to a history file
+ *
+ * Each accepted line is written immediately instead of saving all history on exit, so
+ * that several sessions can share a file and no lines are lost on crash.
+ * When the file has more than max lines, it is rewritten with the last lines that fit
+ * in the history.
+ * @param[in] h    CLIgen handle
+ * @param[in] f    File opened with "a+", or NULL to stop appending. Not closed by CLIgen
+ * @param[in] max  Compact the file when it has more than max lines, 0: never compact
+ * @retval    0    OK
+ * @code
+ *   if ((f = fopen(file, "a+")) != NULL){
+ *      cligen_hist_file_load(h, f);
+ *      cligen_hist_file_append(h, f, 2*lines);
+ *   }
+ * @endcode
+ * @see cligen_hist_file_load  Call before this function, it counts the lines of the file
+ * @see cligen_hist_file_save  Not needed in append mode
+ */
+int
+cligen_hist_file_append(cligen_handle h,
+			FILE         *f,
+			int           max)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_hist_file = f;
+    ch->ch_hist_file_max = max;
+    return 0;
+}
+
 /*! Write history entries back to file
  * @param[in] h         CLIgen handle
  * @param[in] filename  Name of history file (or NULL if no history file)
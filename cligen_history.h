@@ -58,5 +58,7 @@
 int cligen_hist_init(cligen_handle h, int lines);
 int cligen_hist_file_load(cligen_handle h, FILE *f);
 int cligen_hist_file_save(cligen_handle h, FILE *f);
+int cligen_hist_file_append(cligen_handle h, FILE *f, int max);
+size_t cligen_hist_memsize(cligen_handle h);
 
 #endif /* CLIGEN_HISTORY_H */
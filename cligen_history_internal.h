@@ -62,6 +62,7 @@ char *hist_prev(cligen_handle h);
 int   hist_pos_set(cligen_handle h, int pos);
 int   hist_pos(cligen_handle h);
 int   hist_last_get(cligen_handle h);
+char *hist_search(cligen_handle h, char *str, int forward, char **locp);
 int   hist_copy_pos(cligen_handle h);
 int   hist_copy_prev(cligen_handle h);
 int   hist_copy_next(cligen_handle h);
@@ -0,0 +1,937 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+ * CLIgen parse-tree images, see cligen_image.h
+ *
+ * Format, all integers are unsigned LEB128 varints, signed integers are zigzag
+ * encoded first:
+ *   image   ::= magic version globals ntrees { name tree }
+ *   tree    ::= sets len { 0 | 1 object }          (0 is an empty child)
+ *   object  ::= type flags command callbacks cvec helpvec [varspec] (0 | 1 tree)
+ *   varspec ::= vtype show expand_fn_str expand_fn_vec translate_fn_str choice
+ *               rangelen rangecvv_low rangecvv_upp regex dec64_n
+ *   cvec    ::= 0 | len+1 name { cv }
+ *   cv      ::= type name show const flag value
+ *   string  ::= 0 | len+1 bytes                    (0 is NULL)
+ * Tree reference expansions, match state and function pointers are not stored.
+ */
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#include "cligen_buf.h"
+#include "cligen_intern.h"
+#include "cligen_cv.h"
+#include "cligen_cvec.h"
+#include "cligen_parsetree.h"
+#include "cligen_pt_head.h"
+#include "cligen_object.h"
+#include "cligen_handle.h"
+#include "cligen_image.h"
+#include "cligen_cv_internal.h"
+
+/*
+ * Constants
+ */
+#define CLIGEN_IMAGE_MAGIC    "CLIGENIM"
+#define CLIGEN_IMAGE_MAGICLEN 8
+
+/* Object flags that are part of the clispec, the others are evaluation state */
+#define CLIGEN_IMAGE_FLAGS (CO_FLAGS_HIDE|CO_FLAGS_HIDE_DATABASE|CO_FLAGS_OPTION)
+
+/* Max nesting of parse-trees when reading, a deeper image is invalid */
+#define CLIGEN_IMAGE_MAXDEPTH 1024
+
+/*
+ * Types
+ */
+/*! Read position in an image buffer */
+struct image_rd{
+    const uint8_t *ir_p;   /* Next byte to read */
+    const uint8_t *ir_end; /* End of image */
+};
+
+/*------------------------------ Write -----------------------------*/
+
+static int
+img_put_uint(cbuf    *cb,
+	     uint64_t v)
+{
+    uint8_t buf[10];
+    int     i = 0;
+
+    do {
+	buf[i] = v & 0x7f;
+	v >>= 7;
+	if (v)
+	    buf[i] |= 0x80;
+	i++;
+    } while (v);
+    return cbuf_append_buf(cb, buf, i);
+}
+
+static int
+img_put_int(cbuf   *cb,
+	    int64_t v)
+{
+    return img_put_uint(cb, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static int
+img_put_str(cbuf *cb,
+	    char *str)
+{
+    size_t len;
+
+    if (str == NULL)
+	return img_put_uint(cb, 0);
+    len = strlen(str);
+    if (img_put_uint(cb, len + 1) < 0)
+	return -1;
+    return cbuf_append_buf(cb, str, len);
+}
+
+/*! Write value of a cligen variable
+ * Pointer values (CGV_VOID) are not stored
+ */
+static int
+img_put_cv(cbuf   *cb,
+	   cg_var *cv)
+{
+    if (img_put_uint(cb, cv->var_type) < 0 ||
+	img_put_str(cb, cv->var_name) < 0 ||
+	img_put_str(cb, cv->var_show) < 0 ||
+	img_put_uint(cb, (uint8_t)cv->var_const) < 0 ||
+	img_put_uint(cb, (uint8_t)cv->var_flag) < 0)
+	return -1;
+    switch (cv->var_type){
+    case CGV_INT8:
+	return img_put_int(cb, cv->u.varu_int8);
+    case CGV_INT16:
+	return img_put_int(cb, cv->u.varu_int16);
+    case CGV_INT32:
+	return img_put_int(cb, cv->u.varu_int32);
+    case CGV_INT64:
+	return img_put_int(cb, cv->u.varu_int64);
+    case CGV_UINT8:
+	return img_put_uint(cb, cv->u.varu_uint8);
+    case CGV_UINT16:
+	return img_put_uint(cb, cv->u.varu_uint16);
+    case CGV_UINT32:
+	return img_put_uint(cb, cv->u.varu_uint32);
+    case CGV_UINT64:
+	return img_put_uint(cb, cv->u.varu_uint64);
+    case CGV_BOOL:
+	return img_put_uint(cb, cv->u.varu_bool);
+    case CGV_DEC64:
+	if (img_put_int(cb, cv->u.varu_dec64.vardec64_i) < 0)
+	    return -1;
+	return img_put_uint(cb, cv->u.varu_dec64.vardec64_n);
+    case CGV_REST:
+    case CGV_STRING:
+    case CGV_INTERFACE:
+	return img_put_str(cb, cv->u.varu_string);
+    case CGV_IPV4ADDR:
+    case CGV_IPV4PFX:
+	if (cbuf_append_buf(cb, &cv->u.varu_ipv4addr.varipv4_ipv4addr, 4) < 0)
+	    return -1;
+	return img_put_uint(cb, cv->u.varu_ipv4addr.varipv4_masklen);
+    case CGV_IPV6ADDR:
+    case CGV_IPV6PFX:
+	if (cbuf_append_buf(cb, &cv->u.varu_ipv6addr.varipv6_ipv6addr, 16) < 0)
+	    return -1;
+	return img_put_uint(cb, cv->u.varu_ipv6addr.varipv6_masklen);
+    case CGV_MACADDR:
+	return cbuf_append_buf(cb, cv->u.varu_macaddr, 6);
+    case CGV_URL:
+	if (img_put_str(cb, cv->u.varu_url.varurl_proto) < 0 ||
+	    img_put_str(cb, cv->u.varu_url.varurl_addr) < 0 ||
+	    img_put_str(cb, cv->u.varu_url.varurl_path) < 0 ||
+	    img_put_str(cb, cv->u.varu_url.varurl_user) < 0)
+	    return -1;
+	return img_put_str(cb, cv->u.varu_url.varurl_passwd);
+    case CGV_UUID:
+	return cbuf_append_buf(cb, cv->u.varu_uuid, 16);
+    case CGV_TIME:
+	if (img_put_int(cb, cv->u.varu_time.tv_sec) < 0)
+	    return -1;
+	return img_put_int(cb, cv->u.varu_time.tv_usec);
+    default: /* CGV_ERR, CGV_VOID, CGV_EMPTY: no value */
+	break;
+    }
+    return 0;
+}
+
+static int
+img_put_cvec(cbuf *cb,
+	     cvec *cvv)
+{
+    cg_var *cv = NULL;
+
+    if (cvv == NULL)
+	return img_put_uint(cb, 0);
+    if (img_put_uint(cb, cvec_len(cvv) + 1) < 0 ||
+	img_put_str(cb, cvec_name_get(cvv)) < 0)
+	return -1;
+    while ((cv = cvec_each(cvv, cv)) != NULL)
+	if (img_put_cv(cb, cv) < 0)
+	    return -1;
+    return 0;
+}
+
+static int img_put_pt(cbuf *cb, parse_tree *pt);
+
+static int
+img_put_obj(cbuf   *cb,
+	    cg_obj *co)
+{
+    struct cg_callback *cc;
+    int                 n = 0;
+
+    if (img_put_uint(cb, co->co_type) < 0 ||
+	img_put_uint(cb, co->co_flags & CLIGEN_IMAGE_FLAGS) < 0 ||
+	img_put_str(cb, co->co_command) < 0)
+	return -1;
+    for (cc = co_callbacks_get(co); cc; cc = cc->cc_next)
+	n++;
+    if (img_put_uint(cb, n) < 0)
+	return -1;
+    for (cc = co_callbacks_get(co); cc; cc = cc->cc_next)
+	if (img_put_str(cb, cc->cc_fn_str) < 0 ||
+	    img_put_cvec(cb, cc->cc_cvec) < 0)
+	    return -1;
+    if (img_put_cvec(cb, co_cvec_get(co)) < 0 ||
+	img_put_cvec(cb, co_helpvec_get(co)) < 0)
+	return -1;
+    if (co->co_type == CO_VARIABLE){
+	if (img_put_uint(cb, co->co_vtype) < 0 ||
+	    img_put_str(cb, co->co_show) < 0 ||
+	    img_put_str(cb, co->co_expand_fn_str) < 0 ||
+	    img_put_cvec(cb, co->co_expand_fn_vec) < 0 ||
+	    img_put_str(cb, co->co_translate_fn_str) < 0 ||
+	    img_put_str(cb, co->co_choice) < 0 ||
+	    img_put_uint(cb, co->co_rangelen) < 0 ||
+	    img_put_cvec(cb, co->co_rangecvv_low) < 0 ||
+	    img_put_cvec(cb, co->co_rangecvv_upp) < 0 ||
+	    img_put_cvec(cb, co->co_regex) < 0 ||
+	    img_put_uint(cb, co->co_dec64_n) < 0)
+	    return -1;
+    }
+    if (co_pt_get(co) == NULL)
+	return img_put_uint(cb, 0);
+    if (img_put_uint(cb, 1) < 0)
+	return -1;
+    return img_put_pt(cb, co_pt_get(co));
+}
+
+/*! Write a parse-tree, tree reference expansions are skipped as in pt_copy */
+static int
+img_put_pt(cbuf       *cb,
+	   parse_tree *pt)
+{
+    cg_obj *co;
+    int     i;
+    int     n = 0;
+
+    for (i=0; i<pt_len_get(pt); i++)
+	if ((co = pt_vec_i_get(pt, i)) == NULL || !co_flags_get(co, CO_FLAGS_TREEREF))
+	    n++;
+    if (img_put_uint(cb, pt_sets_get(pt)) < 0 ||
+	img_put_uint(cb, n) < 0)
+	return -1;
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL){
+	    if (img_put_uint(cb, 0) < 0)
+		return -1;
+	}
+	else if (!co_flags_get(co, CO_FLAGS_TREEREF)){
+	    if (img_put_uint(cb, 1) < 0 ||
+		img_put_obj(cb, co) < 0)
+		return -1;
+	}
+    }
+    return 0;
+}
+
+/*------------------------------ Read -----------------------------*/
+
+static int
+img_get_uint(struct image_rd *ir,
+	     uint64_t        *vp)
+{
+    uint64_t v = 0;
+    int      shift = 0;
+    uint8_t  b;
+
+    do {
+	if (ir->ir_p >= ir->ir_end || shift > 63)
+	    goto err;
+	b = *ir->ir_p++;
+	v |= (uint64_t)(b & 0x7f) << shift;
+	shift += 7;
+    } while (b & 0x80);
+    *vp = v;
+    return 0;
+ err:
+    errno = EINVAL;
+    return -1;
+}
+
+static int
+img_get_int(struct image_rd *ir,
+	    int64_t         *vp)
+{
+    uint64_t v;
+
+    if (img_get_uint(ir, &v) < 0)
+	return -1;
+    *vp = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    return 0;
+}
+
+/*! Get a small non-negative number, eg a length or enum */
+static int
+img_get_len(struct image_rd *ir,
+	    int             *lenp)
+{
+    uint64_t v;
+
+    if (img_get_uint(ir, &v) < 0)
+	return -1;
+    if (v > INT32_MAX){
+	errno = EINVAL;
+	return -1;
+    }
+    *lenp = (int)v;
+    return 0;
+}
+
+static int
+img_get_bytes(struct image_rd *ir,
+	      void            *dst,
+	      size_t           n)
+{
+    if (ir->ir_end - ir->ir_p < (ptrdiff_t)n){
+	errno = EINVAL;
+	return -1;
+    }
+    memcpy(dst, ir->ir_p, n);
+    ir->ir_p += n;
+    return 0;
+}
+
+/*! Get a string
+ * @param[in]  ir   Image read position
+ * @param[out] strp malloc:d string or NULL
+ */
+static int
+img_get_str(struct image_rd *ir,
+	    char           **strp)
+{
+    int   len;
+    char *str;
+
+    *strp = NULL;
+    if (img_get_len(ir, &len) < 0)
+	return -1;
+    if (len-- == 0)
+	return 0;
+    if (ir->ir_end - ir->ir_p < len){
+	errno = EINVAL;
+	return -1;
+    }
+    if ((str = malloc(len + 1)) == NULL)
+	return -1;
+    memcpy(str, ir->ir_p, len);
+    str[len] = '\0';
+    ir->ir_p += len;
+    *strp = str;
+    return 0;
+}
+
+/*! Get an interned string, see cligen_intern
+ */
+static int
+img_get_istr(struct image_rd *ir,
+	     char           **strp)
+{
+    int len;
+
+    *strp = NULL;
+    if (img_get_len(ir, &len) < 0)
+	return -1;
+    if (len-- == 0)
+	return 0;
+    if (ir->ir_end - ir->ir_p < len){
+	errno = EINVAL;
+	return -1;
+    }
+    if ((*strp = cligen_intern_n((const char *)ir->ir_p, len)) == NULL)
+	return -1;
+    ir->ir_p += len;
+    return 0;
+}
+
+static int
+img_get_cv(struct image_rd *ir,
+	   cvec            *cvv)
+{
+    int      type;
+    int      c;
+    uint64_t u;
+    int64_t  i;
+    cg_var  *cv;
+
+    if (img_get_len(ir, &type) < 0)
+	return -1;
+    if (type > CGV_EMPTY){
+	errno = EINVAL;
+	return -1;
+    }
+    if ((cv = cvec_add(cvv, type)) == NULL)
+	return -1;
+    if (img_get_istr(ir, &cv->var_name) < 0 ||
+	img_get_istr(ir, &cv->var_show) < 0)
+	return -1;
+    if (img_get_len(ir, &c) < 0)
+	return -1;
+    cv->var_const = c;
+    if (img_get_len(ir, &c) < 0)
+	return -1;
+    cv->var_flag = c;
+    switch (cv->var_type){
+    case CGV_INT8:
+    case CGV_INT16:
+    case CGV_INT32:
+    case CGV_INT64:
+	if (img_get_int(ir, &i) < 0)
+	    return -1;
+	if (cv->var_type == CGV_INT8)
+	    cv->u.varu_int8 = i;
+	else if (cv->var_type == CGV_INT16)
+	    cv->u.varu_int16 = i;
+	else if (cv->var_type == CGV_INT32)
+	    cv->u.varu_int32 = i;
+	else
+	    cv->u.varu_int64 = i;
+	break;
+    case CGV_UINT8:
+    case CGV_UINT16:
+    case CGV_UINT32:
+    case CGV_UINT64:
+    case CGV_BOOL:
+	if (img_get_uint(ir, &u) < 0)
+	    return -1;
+	if (cv->var_type == CGV_UINT8)
+	    cv->u.varu_uint8 = u;
+	else if (cv->var_type == CGV_UINT16)
+	    cv->u.varu_uint16 = u;
+	else if (cv->var_type == CGV_UINT32)
+	    cv->u.varu_uint32 = u;
+	else if (cv->var_type == CGV_UINT64)
+	    cv->u.varu_uint64 = u;
+	else
+	    cv->u.varu_bool = u;
+	break;
+    case CGV_DEC64:
+	if (img_get_int(ir, &cv->u.varu_dec64.vardec64_i) < 0 ||
+	    img_get_uint(ir, &u) < 0)
+	    return -1;
+	cv->u.varu_dec64.vardec64_n = u;
+	break;
+    case CGV_REST:
+    case CGV_STRING:
+    case CGV_INTERFACE:
+	return img_get_str(ir, &cv->u.varu_string);
+    case CGV_IPV4ADDR:
+    case CGV_IPV4PFX:
+	if (img_get_bytes(ir, &cv->u.varu_ipv4addr.varipv4_ipv4addr, 4) < 0 ||
+	    img_get_uint(ir, &u) < 0)
+	    return -1;
+	cv->u.varu_ipv4addr.varipv4_masklen = u;
+	break;
+    case CGV_IPV6ADDR:
+    case CGV_IPV6PFX:
+	if (img_get_bytes(ir, &cv->u.varu_ipv6addr.varipv6_ipv6addr, 16) < 0 ||
+	    img_get_uint(ir, &u) < 0)
+	    return -1;
+	cv->u.varu_ipv6addr.varipv6_masklen = u;
+	break;
+    case CGV_MACADDR:
+	return img_get_bytes(ir, cv->u.varu_macaddr, 6);
+    case CGV_URL:
+	if (img_get_str(ir, &cv->u.varu_url.varurl_proto) < 0 ||
+	    img_get_str(ir, &cv->u.varu_url.varurl_addr) < 0 ||
+	    img_get_str(ir, &cv->u.varu_url.varurl_path) < 0 ||
+	    img_get_str(ir, &cv->u.varu_url.varurl_user) < 0 ||
+	    img_get_str(ir, &cv->u.varu_url.varurl_passwd) < 0)
+	    return -1;
+	break;
+    case CGV_UUID:
+	return img_get_bytes(ir, cv->u.varu_uuid, 16);
+    case CGV_TIME:
+	if (img_get_int(ir, &i) < 0)
+	    return -1;
+	cv->u.varu_time.tv_sec = i;
+	if (img_get_int(ir, &i) < 0)
+	    return -1;
+	cv->u.varu_time.tv_usec = i;
+	break;
+    default:
+	break;
+    }
+    return 0;
+}
+
+/*! Get a variable vector
+ * @param[in]  ir   Image read position
+ * @param[out] cvvp New cvec, or NULL if none was stored
+ */
+static int
+img_get_cvec(struct image_rd *ir,
+	     cvec           **cvvp)
+{
+    int   len;
+    int   i;
+    char *name = NULL;
+    cvec *cvv;
+
+    *cvvp = NULL;
+    if (img_get_len(ir, &len) < 0)
+	return -1;
+    if (len-- == 0)
+	return 0;
+    if (ir->ir_end - ir->ir_p < len){ /* Each cv is at least one byte */
+	errno = EINVAL;
+	return -1;
+    }
+    if ((cvv = cvec_new(0)) == NULL)
+	return -1;
+    *cvvp = cvv;
+    if (cvec_reserve(cvv, len) < 0)
+	return -1;
+    if (img_get_str(ir, &name) < 0)
+	return -1;
+    if (name){
+	cvec_name_set(cvv, name);
+	free(name);
+    }
+    for (i=0; i<len; i++)
+	if (img_get_cv(ir, cvv) < 0)
+	    return -1;
+    return 0;
+}
+
+static int img_get_pt(struct image_rd *ir, cg_obj *parent, parse_tree *pt, int depth);
+
+/*! Get an object. On error, a partially read object is returned in *cop for freeing
+ * @param[in]  ir     Image read position
+ * @param[in]  parent Parent object, or NULL
+ * @param[out] cop    New object
+ * @param[in]  depth  Nesting of the parse-tree of the object
+ */
+static int
+img_get_obj(struct image_rd *ir,
+	    cg_obj          *parent,
+	    cg_obj         **cop,
+	    int              depth)
+{
+    cg_obj              *co;
+    struct cg_callback  *cc;
+    struct cg_callback **ccp;
+    parse_tree          *pt;
+    cvec                *cvv = NULL;
+    cvec                *helpvec = NULL;
+    cg_var              *cv;
+    int                  n;
+    int                  i;
+
+    if (img_get_len(ir, &n) < 0)
+	return -1;
+    if (n != CO_COMMAND && n != CO_VARIABLE && n != CO_REFERENCE){
+	errno = EINVAL;
+	return -1;
+    }
+    if ((co = co_new_only(n)) == NULL)
+	return -1;
+    *cop = co;
+    co_up_set(co, parent);
+    if (img_get_len(ir, &n) < 0)
+	return -1;
+    co->co_flags = n & CLIGEN_IMAGE_FLAGS;
+    if (img_get_istr(ir, &co->co_command) < 0)
+	return -1;
+    if (img_get_len(ir, &n) < 0)
+	return -1;
+    if (n){
+	if (co_ext_alloc(co) == NULL)
+	    return -1;
+	ccp = &co->co_ext->ce_callbacks;
+    }
+    for (i=0; i<n; i++){
+	if ((cc = malloc(sizeof(*cc))) == NULL)
+	    return -1;
+	memset(cc, 0, sizeof(*cc));
+	*ccp = cc;
+	ccp = &cc->cc_next;
+	if (img_get_str(ir, &cc->cc_fn_str) < 0 ||
+	    img_get_cvec(ir, &cc->cc_cvec) < 0)
+	    return -1;
+    }
+    if (img_get_cvec(ir, &cvv) < 0 ||
+	img_get_cvec(ir, &helpvec) < 0){
+	if (cvv)
+	    cvec_free(cvv);
+	if (helpvec)
+	    cvec_free(helpvec);
+	return -1;
+    }
+    cv = NULL;
+    while ((cv = cvec_each(helpvec, cv)) != NULL) /* Share help texts as txt2cvv does */
+	if (cv_isstring(cv_type_get(cv)) && cv_string_intern(cv) < 0){
+	    cvec_free(helpvec);
+	    if (cvv)
+		cvec_free(cvv);
+	    return -1;
+	}
+    if (cvv || helpvec){ /* Only allocate rarely used fields if present */
+	if (co_ext_alloc(co) == NULL){
+	    if (cvv)
+		cvec_free(cvv);
+	    if (helpvec)
+		cvec_free(helpvec);
+	    return -1;
+	}
+	co->co_ext->ce_cvec = cvv;
+	co->co_ext->ce_helpvec = helpvec;
+    }
+    if (co->co_type == CO_VARIABLE){
+	if (img_get_len(ir, &n) < 0)
+	    return -1;
+	if (n > CGV_EMPTY){
+	    errno = EINVAL;
+	    return -1;
+	}
+	co->co_vtype = n;
+	if (img_get_str(ir, &co->co_show) < 0 ||
+	    img_get_str(ir, &co->co_expand_fn_str) < 0 ||
+	    img_get_cvec(ir, &co->co_expand_fn_vec) < 0 ||
+	    img_get_str(ir, &co->co_translate_fn_str) < 0 ||
+	    img_get_str(ir, &co->co_choice) < 0 ||
+	    img_get_len(ir, &co->co_rangelen) < 0 ||
+	    img_get_cvec(ir, &co->co_rangecvv_low) < 0 ||
+	    img_get_cvec(ir, &co->co_rangecvv_upp) < 0 ||
+	    img_get_cvec(ir, &co->co_regex) < 0 ||
+	    img_get_len(ir, &n) < 0)
+	    return -1;
+	co->co_dec64_n = n;
+	if (co->co_rangelen > cvec_len(co->co_rangecvv_low) || /* Ranges are indexed by co_rangelen */
+	    co->co_rangelen > cvec_len(co->co_rangecvv_upp)){
+	    errno = EINVAL;
+	    return -1;
+	}
+	if (cov_pref_update(co) < 0)
+	    return -1;
+    }
+    if (img_get_len(ir, &n) < 0)
+	return -1;
+    if (n){
+	if ((pt = pt_new()) == NULL)
+	    return -1;
+	if (co_pt_set(co, pt) < 0){
+	    pt_free(pt, 1);
+	    return -1;
+	}
+	if (img_get_pt(ir, co, pt, depth+1) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/*! Get a parse-tree
+ * @param[in]  ir     Image read position
+ * @param[in]  parent Parent object of the tree, or NULL for a top-level tree
+ * @param[in]  pt     Parse-tree to add objects to
+ * @param[in]  depth  Nesting of the tree, limits recursion on corrupt images
+ */
+static int
+img_get_pt(struct image_rd *ir,
+	   cg_obj          *parent,
+	   parse_tree      *pt,
+	   int              depth)
+{
+    int     sets;
+    int     len;
+    int     i;
+    int     tag;
+    cg_obj *co;
+
+    if (depth > CLIGEN_IMAGE_MAXDEPTH){
+	errno = EINVAL;
+	return -1;
+    }
+    if (img_get_len(ir, &sets) < 0 ||
+	img_get_len(ir, &len) < 0)
+	return -1;
+    pt_sets_set(pt, sets);
+    for (i=0; i<len; i++){
+	if (img_get_len(ir, &tag) < 0)
+	    return -1;
+	if (tag == 0){
+	    if (pt_realloc(pt) < 0) /* empty child */
+		return -1;
+	    continue;
+	}
+	co = NULL;
+	if (img_get_obj(ir, parent, &co, depth) < 0){
+	    if (co)
+		co_free(co, 1);
+	    return -1;
+	}
+	if (pt_vec_append(pt, co) < 0){
+	    co_free(co, 1);
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+/*----------------------------- API -----------------------------*/
+
+/*! Check if a buffer starts with a CLIgen parse-tree image
+ * @param[in]  buf   Buffer
+ * @param[in]  len   Length of buffer
+ * @retval     1     Buffer is an image
+ * @retval     0     Buffer is not an image, eg a clispec
+ */
+int
+cligen_image_check(char  *buf,
+		   size_t len)
+{
+    return len >= CLIGEN_IMAGE_MAGICLEN &&
+	memcmp(buf, CLIGEN_IMAGE_MAGIC, CLIGEN_IMAGE_MAGICLEN) == 0;
+}
+
+/*! Write an image of all parse-trees of a handle and the global variables to a file
+ * @param[in]  h       CLIgen handle
+ * @param[in]  f       Open file
+ * @param[in]  globals Global variables of the clispec, eg prompt, or NULL
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see cligen_image_read
+ */
+int
+cligen_image_write(cligen_handle h,
+		   FILE         *f,
+		   cvec         *globals)
+{
+    int      retval = -1;
+    cbuf    *cb = NULL;
+    pt_head *ph;
+    int      n = 0;
+
+    if ((cb = cbuf_new()) == NULL){
+	fprintf(stderr, "%s: cbuf_new: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    for (ph = cligen_ph_each(h, NULL); ph; ph = cligen_ph_each(h, ph))
+	n++;
+    if (cbuf_append_buf(cb, CLIGEN_IMAGE_MAGIC, CLIGEN_IMAGE_MAGICLEN) < 0 ||
+	img_put_uint(cb, CLIGEN_IMAGE_VERSION) < 0 ||
+	img_put_cvec(cb, globals) < 0 ||
+	img_put_uint(cb, n) < 0)
+	goto done;
+    for (ph = cligen_ph_each(h, NULL); ph; ph = cligen_ph_each(h, ph)){
+	if (img_put_str(cb, cligen_ph_name_get(ph)) < 0)
+	    goto done;
+	if (cligen_ph_parsetree_get(ph) == NULL){
+	    if (img_put_uint(cb, 0) < 0 || img_put_uint(cb, 0) < 0)
+		goto done;
+	}
+	else if (img_put_pt(cb, cligen_ph_parsetree_get(ph)) < 0)
+	    goto done;
+    }
+    if (fwrite(cbuf_get(cb), 1, cbuf_len(cb), f) != cbuf_len(cb)){
+	fprintf(stderr, "%s: fwrite: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    retval = 0;
+ done:
+    if (cb)
+	cbuf_free(cb);
+    return retval;
+}
+
+/*! Load parse-trees and global variables from an image in memory
+ * A new parse-tree header is added to the handle for each tree in the image, as
+ * cligen_parse_str() does for each treename. The image is not referenced after return.
+ * @param[in]  h       CLIgen handle
+ * @param[in]  buf     Image, eg read or mmap:ed from a file or compiled in
+ * @param[in]  len     Length of image
+ * @param[out] globals Global variables are added to this vector, if not NULL
+ * @retval     0       OK
+ * @retval    -1       Error, eg invalid image or wrong version
+ */
+int
+cligen_image_parse(cligen_handle h,
+		   char         *buf,
+		   size_t        len,
+		   cvec         *globals)
+{
+    int             retval = -1;
+    struct image_rd ir;
+    uint64_t        version;
+    cvec           *cvv = NULL;
+    cg_var         *cv = NULL;
+    int             n;
+    int             i;
+    char           *name = NULL;
+    parse_tree     *pt = NULL;
+    pt_head        *ph;
+
+    if (!cligen_image_check(buf, len)){
+	fprintf(stderr, "%s: Not a CLIgen image\n", __FUNCTION__);
+	goto done;
+    }
+    ir.ir_p = (uint8_t *)buf + CLIGEN_IMAGE_MAGICLEN;
+    ir.ir_end = (uint8_t *)buf + len;
+    if (img_get_uint(&ir, &version) < 0)
+	goto err;
+    if (version != CLIGEN_IMAGE_VERSION){
+	fprintf(stderr, "%s: Image version %d, expected %d\n", __FUNCTION__,
+		(int)version, CLIGEN_IMAGE_VERSION);
+	goto done;
+    }
+    if (img_get_cvec(&ir, &cvv) < 0)
+	goto err;
+    if (globals && cvv)
+	while ((cv = cvec_each(cvv, cv)) != NULL)
+	    if (cvec_append_var(globals, cv) == NULL)
+		goto done;
+    if (img_get_len(&ir, &n) < 0)
+	goto err;
+    for (i=0; i<n; i++){
+	if (img_get_str(&ir, &name) < 0 || name == NULL)
+	    goto err;
+	if ((pt = pt_new()) == NULL)
+	    goto done;
+	if (img_get_pt(&ir, NULL, pt, 0) < 0)
+	    goto err;
+	if ((ph = cligen_ph_add(h, name)) == NULL)
+	    goto done;
+	if (cligen_ph_parsetree_set(ph, pt) < 0)
+	    goto done;
+	pt = NULL;
+	free(name);
+	name = NULL;
+    }
+    retval = 0;
+ done:
+    if (pt)
+	pt_free(pt, 1);
+    if (name)
+	free(name);
+    if (cvv)
+	cvec_free(cvv);
+    return retval;
+ err:
+    fprintf(stderr, "%s: Invalid CLIgen image at offset %d\n", __FUNCTION__,
+	    (int)(ir.ir_p - (uint8_t *)buf));
+    goto done;
+}
+
+/*! Load parse-trees and global variables from an image file
+ * A regular file is mapped into memory, other files, eg pipes, are read.
+ * @param[in]  h       CLIgen handle
+ * @param[in]  f       Open file positioned at the start of the image
+ * @param[out] globals Global variables are added to this vector, if not NULL
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see cligen_image_write
+ */
+int
+cligen_image_read(cligen_handle h,
+		  FILE         *f,
+		  cvec         *globals)
+{
+    int         retval = -1;
+    struct stat st;
+    char       *buf = NULL;
+    void       *map = MAP_FAILED;
+    size_t      len = 0;
+    size_t      buflen;
+    size_t      n;
+
+    if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && 
+	st.st_size > 0 && ftell(f) == 0){
+	if ((map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0)) != MAP_FAILED){
+	    buf = map;
+	    len = st.st_size;
+	}
+    }
+    if (map == MAP_FAILED){
+	buflen = 8192;
+	if ((buf = malloc(buflen)) == NULL){
+	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	    goto done;
+	}
+	while ((n = fread(buf + len, 1, buflen - len, f)) > 0){
+	    len += n;
+	    if (len == buflen){
+		buflen *= 2;
+		if ((buf = realloc(buf, buflen)) == NULL){
+		    fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+		    goto done;
+		}
+	    }
+	}
+    }
+    if (cligen_image_parse(h, buf, len, globals) < 0)
+	goto done;
+    retval = 0;
+ done:
+    if (map != MAP_FAILED)
+	munmap(map, len);
+    else if (buf)
+	free(buf);
+    return retval;
+}
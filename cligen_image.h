@@ -0,0 +1,66 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+
+ *
+ * CLIgen parse-tree images: a compact binary form of parsed clispecs
+ * An image contains the parse-trees of a handle with their names and the global
+ * variables of the clispec. It is made once, eg at build time, and loaded without
+ * running the clispec parser. Function pointers are not stored, only callback,
+ * expand and translate function names, which are resolved after loading using
+ * cligen_callbackv_str2fn() and friends as for parsed clispecs.
+ * @code
+ *   // Build time
+ *   cligen_parse_file(h, f, "spec", NULL, globals);
+ *   cligen_image_write(h, fimg, globals);
+ *   // Run time
+ *   cligen_image_read(h, fimg, globals);
+ *   cligen_callbackv_str2fn(cligen_ph_parsetree_get(cligen_ph_i(h, 0)), str2fn, NULL);
+ * @endcode
+ */
+
+#ifndef _CLIGEN_IMAGE_H
+#define _CLIGEN_IMAGE_H
+
+/*
+ * Constants
+ */
+/* Version of image format, images of another version are rejected */
+#define CLIGEN_IMAGE_VERSION 1
+
+/*
+ * Prototypes
+ */
+int cligen_image_check(char *buf, size_t len);
+int cligen_image_write(cligen_handle h, FILE *f, cvec *globals);
+int cligen_image_parse(cligen_handle h, char *buf, size_t len, cvec *globals);
+int cligen_image_read(cligen_handle h, FILE *f, cvec *globals);
+
+#endif /* _CLIGEN_IMAGE_H */
@@ -0,0 +1,316 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+ *
+ * CLIgen interned strings, see cligen_intern.h
+ * Strings are kept in a chained hash table. Each string is allocated together with its
+ * header, and the string pointer is returned to the caller.
+ * References are counted atomically so that strings in a frozen parse-tree can be copied
+ * in several threads. The table itself is protected by a spin lock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cligen_intern.h"              /* External API */
+
+/*
+ * Constants
+ */
+/* Initial number of buckets of the table, doubled when there are more strings than buckets */
+#define CLIGEN_INTERN_BUCKETS 1024
+
+/*
+ * Types
+ */
+/*! An interned string and its header */
+struct intern_str{
+    struct intern_str *is_next;   /* Next string in hash bucket */
+    uint32_t           is_hash;   /* Hash of is_str */
+    uint32_t           is_refs;   /* Number of references, accessed atomically */
+    size_t             is_len;    /* Length of is_str, excluding NULL */
+    char              *is_key[CLIGEN_INTERN_KEYS]; /* Derived keys or NULL, see cligen_intern_key */
+    char               is_str[];  /* NULL-terminated string */
+};
+
+/* Header of an interned string */
+#define intern_hdr(s) ((struct intern_str *)((s) - offsetof(struct intern_str, is_str)))
+
+/*
+ * Variables
+ */
+static struct intern_str **_intern_vec = NULL; /* Hash buckets */
+static size_t              _intern_size = 0;   /* Number of buckets, power of 2 */
+static size_t              _intern_len = 0;    /* Number of strings */
+static size_t              _intern_bytes = 0;  /* Allocated bytes of strings and headers */
+static char                _intern_lock = 0;
+
+static inline void
+intern_lock(void)
+{
+    while (__atomic_test_and_set(&_intern_lock, __ATOMIC_ACQUIRE))
+	;
+}
+
+static inline void
+intern_unlock(void)
+{
+    __atomic_clear(&_intern_lock, __ATOMIC_RELEASE);
+}
+
+/*! FNV-1a hash of a string of given length
+ */
+static uint32_t
+intern_hash(const char *str,
+	    size_t      n)
+{
+    uint32_t h = 2166136261u;
+    size_t   i;
+
+    for (i=0; i<n; i++){
+	h ^= (uint8_t)str[i];
+	h *= 16777619u;
+    }
+    return h;
+}
+
+/*! Double the number of buckets, or allocate them the first time. Called with lock held
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+intern_grow(void)
+{
+    struct intern_str **vec;
+    struct intern_str  *is;
+    size_t              size;
+    size_t              i;
+
+    size = _intern_size ? 2*_intern_size : CLIGEN_INTERN_BUCKETS;
+    if ((vec = calloc(size, sizeof(*vec))) == NULL)
+	return -1;
+    for (i=0; i<_intern_size; i++)
+	while ((is = _intern_vec[i]) != NULL){
+	    _intern_vec[i] = is->is_next;
+	    is->is_next = vec[is->is_hash & (size-1)];
+	    vec[is->is_hash & (size-1)] = is;
+	}
+    if (_intern_vec)
+	free(_intern_vec);
+    _intern_vec = vec;
+    _intern_size = size;
+    return 0;
+}
+
+/*! Intern the first n characters of a string
+ * @param[in]  str   String, need not be NULL-terminated
+ * @param[in]  n     Number of characters of str
+ * @retval     istr  Interned string, free with cligen_intern_free
+ * @retval     NULL  Error
+ * @see cligen_intern
+ */
+char *
+cligen_intern_n(const char *str,
+		size_t      n)
+{
+    struct intern_str *is;
+    uint32_t           h;
+
+    if (str == NULL){
+	errno = EINVAL;
+	return NULL;
+    }
+    h = intern_hash(str, n);
+    intern_lock();
+    if (_intern_len >= _intern_size && intern_grow() < 0)
+	goto fail;
+    for (is = _intern_vec[h & (_intern_size-1)]; is; is = is->is_next)
+	if (is->is_hash == h && is->is_len == n && memcmp(is->is_str, str, n) == 0){
+	    __atomic_add_fetch(&is->is_refs, 1, __ATOMIC_RELAXED);
+	    goto ok;
+	}
+    if ((is = malloc(sizeof(*is) + n + 1)) == NULL)
+	goto fail;
+    memcpy(is->is_str, str, n);
+    is->is_str[n] = '\0';
+    is->is_len = n;
+    is->is_hash = h;
+    is->is_refs = 1;
+    memset(is->is_key, 0, sizeof(is->is_key));
+    is->is_next = _intern_vec[h & (_intern_size-1)];
+    _intern_vec[h & (_intern_size-1)] = is;
+    _intern_len++;
+    _intern_bytes += sizeof(*is) + n + 1;
+ ok:
+    intern_unlock();
+    return is->is_str;
+ fail:
+    intern_unlock();
+    return NULL;
+}
+
+/*! Intern a string
+ * Return the interned copy of str, adding it to the table if not already present.
+ * @param[in]  str   NULL-terminated string
+ * @retval     istr  Interned string, free with cligen_intern_free
+ * @retval     NULL  Error, errno is EINVAL if str is NULL
+ */
+char *
+cligen_intern(const char *str)
+{
+    if (str == NULL){
+	errno = EINVAL;
+	return NULL;
+    }
+    return cligen_intern_n(str, strlen(str));
+}
+
+/*! Add a reference to an interned string
+ * Use this instead of strdup when copying an interned string. No table lookup is made.
+ * @param[in]  istr  Interned string, or NULL
+ * @retval     istr  Same string
+ */
+char *
+cligen_intern_dup(char *istr)
+{
+    if (istr != NULL)
+	__atomic_add_fetch(&intern_hdr(istr)->is_refs, 1, __ATOMIC_RELAXED);
+    return istr;
+}
+
+/*! Release a reference to an interned string, free it if it was the last
+ * @param[in]  istr  Interned string, or NULL
+ * @note The last reference is released with the lock held, since cligen_intern may
+ *       find the string concurrently.
+ */
+void
+cligen_intern_free(char *istr)
+{
+    struct intern_str  *is;
+    struct intern_str **isp;
+    uint32_t            refs;
+    int                 i;
+
+    if (istr == NULL)
+	return;
+    is = intern_hdr(istr);
+    refs = __atomic_load_n(&is->is_refs, __ATOMIC_RELAXED);
+    while (refs > 1)
+	if (__atomic_compare_exchange_n(&is->is_refs, &refs, refs-1, 0,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+	    return;
+    intern_lock();
+    if (__atomic_sub_fetch(&is->is_refs, 1, __ATOMIC_ACQ_REL) == 0){
+	isp = &_intern_vec[is->is_hash & (_intern_size-1)];
+	while (*isp != is)
+	    isp = &(*isp)->is_next;
+	*isp = is->is_next;
+	_intern_len--;
+	_intern_bytes -= sizeof(*is) + is->is_len + 1;
+	for (i=0; i<CLIGEN_INTERN_KEYS; i++)
+	    if (is->is_key[i]){
+		_intern_bytes -= strlen(is->is_key[i]) + 1;
+		free(is->is_key[i]);
+	    }
+	free(is);
+	if (_intern_len == 0){ /* Table is empty, free buckets */
+	    free(_intern_vec);
+	    _intern_vec = NULL;
+	    _intern_size = 0;
+	}
+    }
+    intern_unlock();
+}
+
+/*! Get number of interned strings and their allocated size
+ * @param[out] nstr    Number of strings in the table (if not NULL)
+ * @param[out] nbytes  Bytes allocated for strings and their headers (if not NULL)
+ * @retval     0       OK
+ */
+int
+cligen_intern_stats(uint64_t *nstr,
+		    uint64_t *nbytes)
+{
+    intern_lock();
+    if (nstr)
+	*nstr = _intern_len;
+    if (nbytes)
+	*nbytes = _intern_bytes;
+    intern_unlock();
+    return 0;
+}
+
+/*! Get a key derived from an interned string, computed once and kept with the string
+ *
+ * Used for keys that are expensive to compute and compared often, such as collation
+ * keys. The key is computed by fn on first use, and freed with the string. Keys for
+ * different purposes are kept in different slots, at most CLIGEN_INTERN_KEYS.
+ * The key may be computed concurrently in several threads, then only one is kept.
+ * @param[in]  istr  Interned string
+ * @param[in]  i     Key slot, 0 <= i < CLIGEN_INTERN_KEYS
+ * @param[in]  fn    Function computing the key of slot i
+ * @retval     key   Derived key, owned by the interned string
+ * @retval     NULL  Error
+ */
+char *
+cligen_intern_key(char                *istr,
+		  int                  i,
+		  cligen_intern_keyfn *fn)
+{
+    struct intern_str *is;
+    char              *key;
+
+    if (istr == NULL || i < 0 || i >= CLIGEN_INTERN_KEYS){
+	errno = EINVAL;
+	return NULL;
+    }
+    is = intern_hdr(istr);
+    if ((key = __atomic_load_n(&is->is_key[i], __ATOMIC_ACQUIRE)) != NULL)
+	return key;
+    if ((key = fn(istr, i)) == NULL)
+	return NULL;
+    intern_lock();
+    if (is->is_key[i] == NULL){
+	__atomic_store_n(&is->is_key[i], key, __ATOMIC_RELEASE);
+	_intern_bytes += strlen(key) + 1;
+    }
+    else{ /* Computed by another thread */
+	free(key);
+	key = is->is_key[i];
+    }
+    intern_unlock();
+    return key;
+}
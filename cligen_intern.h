@@ -0,0 +1,76 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+ *
+ * CLIgen interned strings
+ * Keywords, help texts and variable names are stored once in a process-wide table and
+ * shared by all parse-tree objects and variables referring to them. An interned string
+ * is immutable and reference counted: copying it only increments the count, and it is
+ * removed from the table when the last reference is released.
+ * Since the strings are unique, two interned strings are equal if their pointers are.
+ * The table is protected by a lock and can be used by handles in different threads.
+ * @code
+ *   char *s;
+ *   if ((s = cligen_intern("interface")) == NULL)
+ *      err();
+ *   s2 = cligen_intern_dup(s);     // s2 == s
+ *   cligen_intern_free(s2);
+ *   cligen_intern_free(s);         // removed from table
+ * @endcode
+ */
+
+#ifndef _CLIGEN_INTERN_H
+#define _CLIGEN_INTERN_H
+
+/*
+ * Constants
+ */
+/* Number of derived keys kept with each interned string, see cligen_intern_key */
+#define CLIGEN_INTERN_KEYS 2
+
+/*
+ * Types
+ */
+/* Function computing a derived key of a string, returns a malloced string or NULL */
+typedef char *(cligen_intern_keyfn)(const char *str, int i);
+
+/*
+ * Prototypes
+ */
+char  *cligen_intern(const char *str);
+char  *cligen_intern_n(const char *str, size_t n);
+char  *cligen_intern_dup(char *istr);
+void   cligen_intern_free(char *istr);
+int    cligen_intern_stats(uint64_t *nstr, uint64_t *nbytes);
+char  *cligen_intern_key(char *istr, int i, cligen_intern_keyfn *fn);
+
+#endif /* _CLIGEN_INTERN_H */
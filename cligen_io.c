@@ -61,6 +61,10 @@
 #include "cligen_print.h"
 #include "cligen_io.h"
 #include "cligen_getline.h"
+#include "cligen_stats.h"
+#include "cligen_session.h"
+#include "cligen_handle_internal.h"
+#include "cligen_stats_internal.h"
 
 /*
  * Constants
@@ -75,21 +79,175 @@
  */
 #define CLIGEN_HELP_LEFT_MARGIN 3
 
-/*
- * Local variables
- */
-static int d_lines=0; /* XXX: global */
+/* Buffered output of a command is written when it grows beyond this size */
+#define CLIGEN_OUTPUT_BUFSIZE (64*1024)
 
+/*! Reset paging line count of the handle evaluating a command in this thread
+ * Or of the default handle if no command is evaluated
+ * @see cligen_output_reset
+ */
 int
 cli_output_reset(void)
 {
-    d_lines = 0;
+    cligen_handle h;
+
+    if ((h = cligen_eval_handle()) != NULL ||
+	(h = cligen_default_handle()) != NULL)
+	return cligen_output_reset(h);
+    return 0;
+}
+
+/*! Reset paging line count of a handle, eg before a new command
+ * @param[in] h       CLIgen handle
+ */
+int
+cligen_output_reset(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_output_lines = 0;
+    return 0;
+}
+
+/*! Write buffered output of a handle to its stream
+ *
+ * Output is buffered while a command is evaluated and written in large writes at page
+ * breaks and when the command is done, see cligen_eval().
+ * If a session is bound to the handle the output is written to the session whatever
+ * the stream, see cligen_session_feed.
+ * Call this function before writing directly to the same stream in a callback, eg with
+ * printf, to keep the order of the output.
+ * @param[in] h       CLIgen handle
+ * @retval    0       OK
+ * @retval   -1       Error
+ */
+int
+cligen_output_flush(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    cbuf                 *cb;
+
+    if (ch == NULL || (cb = ch->ch_output_cb) == NULL || cbuf_len(cb) == 0)
+	return 0;
+    if (ch->ch_session){
+	if (cligen_session_write(ch->ch_session, cbuf_get(cb), cbuf_len(cb)) < 0)
+	    return -1;
+    }
+    else if (ch->ch_output_f){
+	if (fwrite(cbuf_get(cb), 1, cbuf_len(cb), ch->ch_output_f) != cbuf_len(cb))
+	    return -1;
+	fflush(ch->ch_output_f);
+    }
+    cbuf_reset(cb);
+    return 0;
+}
+
+/*! Get the output buffer of a handle for appending output to a stream
+ * Output buffered for another stream is first written
+ * @param[in] h       CLIgen handle
+ * @param[in] f       Open stdio FILE pointer
+ * @retval    cb      Output buffer
+ * @retval    NULL    Error
+ */
+static cbuf *
+cligen_output_cbuf(cligen_handle h,
+		   FILE         *f)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_output_f != f){
+	if (cligen_output_flush(h) < 0)
+	    return NULL;
+	ch->ch_output_f = f;
+    }
+    if (ch->ch_output_cb == NULL &&
+	(ch->ch_output_cb = cbuf_new()) == NULL){
+	fprintf(stderr, "%s: cbuf_new: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    return ch->ch_output_cb;
+}
+
+/*! Page output appended to the output buffer of a handle, and write it unless buffered
+ *
+ * Lines are counted from start to end of the buffer. If terminal rows are set and
+ * output is to stdout, the buffer is written and a --More-- prompt is shown when a
+ * page is full.
+ * @param[in] h       CLIgen handle
+ * @param[in] f       Open stdio FILE pointer
+ * @param[in] start   Offset in output buffer of new output
+ * @see cligen_output
+ */
+static int
+cligen_output_page(cligen_handle h,
+		   FILE         *f,
+		   size_t        start)
+{
+    struct cligen_handle *ch = handle(h);
+    cbuf                 *cb = ch->ch_output_cb;
+    char                 *buf;
+    char                 *p;
+    char                 *nl;
+    size_t                len;
+    int                   c;
+    int                   paged = 0;
+    int                   term_rows;
+    int                  *d_lines;
+
+    term_rows = cligen_terminal_rows(h);
+    /* if writing to stdout, format output. Sessions are not paged
+     */
+    if ((term_rows) && (f == stdout) && ch->ch_session == NULL){
+	d_lines = &ch->ch_output_lines;
+	buf = cbuf_get(cb);
+	len = cbuf_len(cb);
+	p = buf + start;
+	while (*d_lines >= 0 && (nl = memchr(p, '\n', buf + len - p)) != NULL){
+	    (*d_lines)++;
+	    p = nl + 1;
+	    if (*d_lines < (term_rows -1))
+		continue;
+	    /* Page is full: write it and keep the rest in the buffer */
+	    if (fwrite(buf, 1, p - buf, f) != p - buf)
+		return -1;
+	    len -= p - buf;
+	    memmove(buf, p, len);
+	    cbuf_trunc(cb, len);
+	    p = buf;
+	    paged++;
+	    gl_char_init(h);
+	    fprintf(f, "--More--");
+	    fflush(f);
+	    /* Input typed ahead may already have been read by getline */
+	    if ((c = gl_pending_getc(h)) < 0)
+		c = fgetc(stdin);
+	    if (c == '\n')
+		(*d_lines)--;
+	    else if (c == ' ')
+		*d_lines = 0;
+	    else if (c == 'q' || c == 3) /* ^c */
+		*d_lines = -1;
+	    else if (c == '?')
+		fprintf(f, "Press CR for one more line, SPACE for next page, q to quit\n");
+	    else 
+		*d_lines = 0;  
+	    fprintf(f, "        ");
+	    gl_char_cleanup(h);
+	}
+	if (*d_lines < 0) /* Quit: skip output until reset, keep output before this call */
+	    cbuf_trunc(cb, paged ? 0 : start);
+    }
+    if (ch->ch_output_defer == 0 || cbuf_len(cb) >= CLIGEN_OUTPUT_BUFSIZE)
+	return cligen_output_flush(h);
     return 0;
 }
 
 /*! CLIgen output function. All printf-style output should be made via this function.
  * 
  * It deals with formatting, page breaks, etc. 
+ * Called from a callback, output is buffered and paged by the handle evaluating the
+ * command in the calling thread, see cligen_eval(). Otherwise it is written directly
+ * without paging. Use cligen_output_h() to page with a specific handle.
  * @param[in] f           Open stdio FILE pointer
  * @param[in] template... See man printf(3)
  * @note: There has been a debate whether this function is the right solution to the
@@ -105,91 +263,135 @@ cli_output_reset(void)
  * @note: There has also been a discussion on the use of handles in this code (it relies on a
  * global variable _terminalrows). However, the signature needs to be the same as fprintf in
  * order to make compatible printing code.
+ * @note Output made while a command is evaluated is buffered, see cligen_output_flush()
  */
 int
 cligen_output(FILE       *f,
 	      const char *template,
 	      ... )
 {
-    int     retval = -1;
+    int     retval;
     va_list args;
-    char   *buf = NULL;
-    char   *start;
-    char   *end;
-    char   *bufend;
-    char    c;
-    int     term_rows;
-    int     len;
-
-    term_rows = cligen_terminal_rows(NULL);
-    /* form a string in buf from all args */
 
     va_start(args, template);
-    len = vsnprintf(NULL, 0, template, args);
+    retval = cligen_output_v(cligen_eval_handle(), f, template, args);
     va_end(args);
-    len++;
-    if ((buf = malloc(len)) == NULL){
-	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
-	goto done;
-    }
+    return retval;
+}
+
+/*! CLIgen output function using paging state of a specific handle
+ *
+ * Same as cligen_output() but paging is made using terminal rows and line count of h
+ * @param[in] h           CLIgen handle
+ * @param[in] f           Open stdio FILE pointer
+ * @param[in] template... See man printf(3)
+ * @see cligen_output
+ */
+int
+cligen_output_h(cligen_handle h,
+		FILE         *f,
+		const char   *template,
+		... )
+{
+    int     retval;
+    va_list args;
+
     va_start(args, template);
-    vsnprintf(buf, len, template, args);
+    retval = cligen_output_v(h, f, template, args);
     va_end(args);
+    return retval;
+}
 
-    /* if writing to stdout, format output
-     */
-    if ((term_rows) && (f == stdout)){
-	start = end = buf;
-	bufend = buf + strlen(buf);
-	while (end < bufend){
-	    end = strstr(start, "\n");
-	    if (end) /* got a NL */{
-		if (d_lines >= 0)
-		    d_lines++;
-		*end = '\0';
-		if (d_lines > -1)
-		    fprintf(f, "%s\n", start);
-	      
-		if (end < bufend)
-		    start = end+1;
-	      
-		if (d_lines >= (term_rows -1)){		    
-		    gl_char_init();
-
-		    fprintf(f, "--More--");
-		    c = fgetc(stdin);
-		    if (c == '\n')
-			d_lines--;
-		    else if (c == ' ')
-			    d_lines = 0;
-		    else if (c == 'q' || c == 3) /* ^c */
-			d_lines = -1;
-		    else if (c == '?')
-			fprintf(f, "Press CR for one more line, SPACE for next page, q to quit\n");
-		    else 
-			d_lines = 0;  
-		    fprintf(f, "        ");
-		    gl_char_cleanup();
-		}
-	    } /* NL */
-	    else{
-		/* do only print if we have data */
-		if (d_lines >=0 && *start != '\0')
-		    fprintf(f, "%s", start);
-		end = start + strlen(start);
-		start = end;
-	    }
-	}
+/*! CLIgen output function with a va_list argument
+ *
+ * The output is formatted directly into the output buffer of the handle
+ * @param[in] h           CLIgen handle, or NULL for no paging and buffering
+ * @param[in] f           Open stdio FILE pointer
+ * @param[in] template    See man printf(3)
+ * @param[in] args        Variable argument list
+ * @see cligen_output
+ */
+int
+cligen_output_v(cligen_handle h,
+		FILE         *f,
+		const char   *template,
+		va_list       args)
+{
+    cbuf   *cb;
+    size_t  start;
+
+    if (h == NULL){
+	if (vfprintf(f, template, args) < 0)
+	    return -1;
+	fflush(f);
+	return 0;
+    }
+    if ((cb = cligen_output_cbuf(h, f)) == NULL)
+	return -1;
+    start = cbuf_len(cb);
+    if (vcprintf(cb, template, args) < 0){
+	fprintf(stderr, "%s: vcprintf: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    return cligen_output_page(h, f, start);
+}
+
+/*! Write pre-rendered output with paging, without formatting
+ *
+ * Same as cligen_output_h() with a "%s" template, but buf need not be null-terminated
+ * @param[in] h       CLIgen handle, or NULL for no paging and buffering
+ * @param[in] f       Open stdio FILE pointer
+ * @param[in] buf     Output data
+ * @param[in] len     Length of buf
+ * @see cligen_output_h
+ */
+int
+cligen_output_write(cligen_handle h,
+		    FILE         *f,
+		    const char   *buf,
+		    size_t        len)
+{
+    cbuf   *cb;
+    size_t  start;
+
+    if (h == NULL){
+	if (fwrite(buf, 1, len, f) != len)
+	    return -1;
+	fflush(f);
+	return 0;
     }
-    else{
-	fprintf(f, "%s", buf);
-    }  
+    if ((cb = cligen_output_cbuf(h, f)) == NULL)
+	return -1;
+    start = cbuf_len(cb);
+    if (cbuf_append_buf(cb, (void*)buf, len) < 0){
+	fprintf(stderr, "%s: cbuf_append_buf: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    return cligen_output_page(h, f, start);
+}
+
+/*! Write help output of TAB and '?' to a stream, or to the session bound to a handle
+ * @param[in] h       CLIgen handle
+ * @param[in] f       Open stdio FILE pointer, used if no session is bound
+ * @param[in] buf     Output data
+ * @param[in] len     Length of buf
+ * @retval    0       OK
+ * @retval   -1       Error
+ */
+int
+cligen_help_write(cligen_handle h,
+		  FILE         *f,
+		  const char   *buf,
+		  size_t        len)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_session)
+	return cligen_session_write(ch->ch_session, buf, len);
+    if (fwrite(buf, 1, len, f) != len)
+	return -1;
     fflush(f);
-    retval = 0;
- done:
-    if (buf)
-	free(buf);
-    return retval;
+    return 0;
 }
 
 #ifdef notyet
@@ -241,7 +443,7 @@ int
 cligen_susp_hook(cligen_handle     h, 
 		 cligen_susp_cb_t *fn)
 {
-    gl_susp_hook = fn; /* XXX global */
+    gl_susp_hook_set(h, fn);
     return 0;
 }
 
@@ -251,7 +453,7 @@ int
 cligen_interrupt_hook(cligen_handle          h, 
 		      cligen_interrupt_cb_t *fn)
 {
-    gl_interrupt_hook = fn; 
+    gl_interrupt_hook_set(h, fn);
     return 0;
 }
 
@@ -261,20 +463,20 @@ void
 cligen_exitchar_add(cligen_handle h, 
 		    char          c)
 {
-    gl_exitchar_add(c); /* XXX global */
+    gl_exitchar_add(h, c);
 }
 
 /*! Display multi help lines on query (?)
  * Function handles multiple options on how to display help strings at query (?)
  * This includes indentation, limit on lines, truncation, etc.
  * @param[in]  h             Cligen handle
- * @param[in]  fout          File to print to, eg stdout
+ * @param[in]  cb            Buffer to render the line in
  * @param[in]  column_width  Space for first, command width
  * @param[in]  ch            Help command and string struct
  */
 static int
 print_help_line(cligen_handle    h,
-		FILE            *fout,
+		cbuf            *cb,
 		int              column_width,
 		struct cmd_help *ch)
 {
@@ -289,7 +491,7 @@ print_help_line(cligen_handle    h,
     int     truncate;
 	    
     /* First print command */
-    fprintf(fout, "  %*s", -column_width, ch->ch_cmd);
+    cprintf(cb, "  %*s", -column_width, ch->ch_cmd);
     /* Then print help */
     if (ch->ch_helpvec && cvec_len(ch->ch_helpvec)){
 	linesmax = cligen_helpstring_lines(h);
@@ -301,31 +503,34 @@ print_help_line(cligen_handle    h,
 	    w = termwidth - column_width - CLIGEN_HELP_LEFT_MARGIN;
 	    str = cv_string_get(cv);
 	    if (j > 0) /* skip first line */
-		fprintf(fout, "  %*s", -column_width, "");
+		cprintf(cb, "  %*s", -column_width, "");
 	    if (truncate == 0 ||
 		strlen(str) < w){
-		fprintf(fout, " %*s", -w, str);
+		cprintf(cb, " %*s", -w, str);
 	    }
 	    else {
 		if ((str2 = strdup(str)) == NULL)
 		    goto done;
 		str2[w] = '\0';
-		fprintf(fout, " %*s", -w, str2);
+		cprintf(cb, " %*s", -w, str2);
 		free(str2);
 		str2 = NULL;
 	    }
-	    fprintf(fout, "\n");
+	    cprintf(cb, "\n");
 	    j++;
 	}
     }
     else
-	fprintf(fout, "\n");
+	cprintf(cb, "\n");
     retval = 0;
  done:
     return retval;
 }
 
 /*! Print help lines for subset of a parsetree vector
+ * The rendered lines of a static level are cached in the original parse-tree, and
+ * printed without rendering them again if the same commands are matched with the
+ * same terminal width and help settings, see pt_help_get.
  * @param[in] fout     File to print to, eg stdout
  * @param[in] ptvec    Cligen parse-node vector
  * @param[in] matchvec Array of indexes into ptvec to match (the subset)
@@ -350,10 +555,27 @@ print_help_lines(cligen_handle h,
     int              nrcmd = 0;
     int              column_width;
     int              vi;
-
-    if ((cb = cbuf_new()) == NULL){
+    pt_help_key      hk = {PT_HELP_LINES, 0, 0, 0};
+    char            *buf;
+    size_t           len;
+    cbuf            *cbh = NULL;
+    int              ret;
+
+    hk.hk_width = cligen_terminal_width(h);
+    hk.hk_lines = cligen_helpstring_lines(h);
+    hk.hk_truncate = cligen_helpstring_truncate(h);
+    if ((ret = pt_help_get(ptmatch, &hk, matchvec, matchlen, &buf, &len)) < 0)
+	goto done;
+    if (ret == 1){
+	cligen_stats_inc(h, cs_help_cached);
+	if (cligen_help_write(h, fout, buf, len) < 0)
+	    goto done;
+	retval = 0;
+	goto done;
+    }
+    if ((cb = cbuf_new()) == NULL || (cbh = cbuf_new()) == NULL){
 	fprintf(stderr, "cbuf_new: %s\n", strerror(errno));
-	return -1;
+	goto done;
     }
     /* Go through match vector and collect commands and helps */
     if ((chvec = calloc(matchlen, sizeof(struct cmd_help))) ==NULL){
@@ -385,26 +607,33 @@ print_help_lines(cligen_handle h,
 	    continue;
 	    break;
 	}
-	if (prev && strcmp(cmd, prev)==0)
+	if (prev && strcmp(cmd, prev)==0){
+	    free(cmd);
 	    continue;
+	}
 	ch = &chvec[nrcmd++];
 	ch->ch_cmd = cmd;
-	ch->ch_helpvec = co->co_helpvec;
+	ch->ch_helpvec = co_helpvec_get(co);
 	prev = cmd;
 	/* Compute longest command */
 	maxlen = strlen(cmd)>maxlen?strlen(cmd):maxlen;
     }
     maxlen++;
     column_width = maxlen<COLUMN_MIN_WIDTH?COLUMN_MIN_WIDTH:maxlen;
-    /* Actually print */
+    /* Render and print */
     for (i = 0; i<nrcmd; i++){
 	ch = &chvec[i];
-	if (print_help_line(h, fout, column_width, ch) < 0)
+	if (print_help_line(h, cbh, column_width, ch) < 0)
 	    goto done;
     }
-    fflush(fout);
+    if (cligen_help_write(h, fout, cbuf_get(cbh), cbuf_len(cbh)) < 0)
+	goto done;
+    if (pt_help_set(ptmatch, &hk, matchvec, matchlen, cbuf_get(cbh), cbuf_len(cbh)) < 0)
+	goto done;
     retval = 0;
  done:
+    if (cbh)
+	cbuf_free(cbh);
     if (chvec){
 	for (i=0; i<nrcmd; i++){
 	    if (chvec[i].ch_cmd)
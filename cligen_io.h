@@ -59,11 +59,18 @@ typedef int (cligen_fd_cb_t)(int, void*);
  * Prototypes
  */
 int  cli_output_reset(void);
+int  cligen_output_reset(cligen_handle h);
 #if defined(__GNUC__) && __GNUC__ >= 3
 int  cligen_output(FILE *f, const char *templ, ... ) __attribute__ ((format (printf, 2, 3)));
+int  cligen_output_h(cligen_handle h, FILE *f, const char *templ, ... ) __attribute__ ((format (printf, 3, 4)));
 #else
 int  cligen_output(FILE *f, const char *templ, ... );
+int  cligen_output_h(cligen_handle h, FILE *f, const char *templ, ... );
 #endif
+int  cligen_output_v(cligen_handle h, FILE *f, const char *templ, va_list args);
+int  cligen_output_write(cligen_handle h, FILE *f, const char *buf, size_t len);
+int  cligen_help_write(cligen_handle h, FILE *f, const char *buf, size_t len);
+int  cligen_output_flush(cligen_handle h);
 int  cligen_regfd(int fd, cligen_fd_cb_t *cb, void *arg);
 int  cligen_unregfd(int fd);
 void cligen_redraw(cligen_handle h);
@@ -0,0 +1,931 @@
+/*
+  CLIgen worst-case latency fuzzer of the matcher
+
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+ */
+/*
+ * In-process fuzzer looking for slow inputs of cliread_parse, in contrast to
+ * the AFL driver in fuzz/ which looks for crashes.
+ * Inputs are generated by random walks of the parse-tree of a clispec and then
+ * mutated: token spans are repeated (eg deep sets), tokens are made long (eg REST)
+ * or cut to prefixes (ambiguity), keywords and values are inserted or removed.
+ * Each input is evaluated in-process, and its time (the best of a few runs) and
+ * number of match_object calls are recorded. Inputs more expensive than their
+ * parent are kept as seeds for further mutation.
+ * The slowest inputs are minimized, ie tokens are removed and shortened as long as
+ * most of the cost remains, and written as one JSON object per line, eg:
+ *   {"input":"a 1 2 3 b b2","len":12,"ns":8123,"match_object":97}
+ * With -o <dir> they are also saved as a performance-regression corpus:
+ *   <dir>/<name>.cli   A copy of the clispec
+ *   <dir>/<name>.in    The slowest inputs, one per line
+ * which is replayed by "make bench", see cligen_bench -C.
+ * Run with eg: make latfuzz LATFUZZFLAGS="-f fuzz/specs/latency.cli -o fuzz/perf"
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <libgen.h>
+#include <netinet/in.h>
+
+#include <cligen/cligen.h>
+
+/* Max number of tokens of a generated input */
+#define LF_TOKENS 64
+
+/* Max number of inputs kept as seeds for mutation */
+#define LF_POOL 256
+
+/* Candidate of minimization must keep this percentage of the cost */
+#define LF_MINIMIZE_PCT 90
+
+/* Max number of evaluations when minimizing one input */
+#define LF_MINIMIZE_MAX 2000
+
+/* Values returned by the expand callback */
+#define LF_EXPAND 8
+
+/*! One evaluated input */
+struct lf_input{
+    char     *li_str;    /* Command string */
+    uint64_t  li_ns;     /* Best time of cliread_parse in nanoseconds */
+    uint64_t  li_match;  /* Calls to match_object */
+};
+
+/*! Fuzzer state */
+struct latfuzz{
+    cligen_handle    lf_h;
+    parse_tree      *lf_pt;      /* Active parse-tree */
+    unsigned int     lf_seed;    /* Random seed */
+    int              lf_iter;    /* Number of inputs to generate */
+    int              lf_repeat;  /* Runs of each input, the best time is used */
+    size_t           lf_maxlen;  /* Max length of an input */
+    char            *lf_buf;     /* Work buffer, cliread_parse modifies the string */
+    char           **lf_vocab;   /* All keywords of the clispec */
+    int              lf_nvocab;
+    struct lf_input *lf_pool;    /* Seeds of mutation */
+    int              lf_npool;
+    struct lf_input *lf_top;     /* Slowest inputs sorted on time, slowest first */
+    int              lf_ntop;
+    int              lf_k;       /* Number of slowest inputs to keep */
+};
+
+static uint64_t
+lf_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+/*! Expand callback returning LF_EXPAND values v0, v1,... */
+static int
+lf_expand_cb(cligen_handle h,
+	     char         *fn_str,
+	     cvec         *cvv,
+	     cvec         *argv,
+	     cvec         *commands,
+	     cvec         *helptexts)
+{
+    char name[16];
+    int  i;
+
+    for (i=0; i<LF_EXPAND; i++){
+	snprintf(name, sizeof(name), "v%d", i);
+	cvec_add_string(commands, NULL, name);
+	cvec_add_string(helptexts, NULL, "Expanded value");
+    }
+    return 0;
+}
+
+static expandv_cb *
+str2fn_exp(char  *name,
+	   void  *arg,
+	   char **error)
+{
+    return lf_expand_cb;
+}
+
+/*! Evaluate one input and measure its cost
+ * @param[in]  lf      Fuzzer state
+ * @param[in]  str     Command string, not modified
+ * @param[out] ns      Best time of lf_repeat runs in nanoseconds
+ * @param[out] match   Calls to match_object in one run
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+static int
+lf_eval(struct latfuzz *lf,
+	char           *str,
+	uint64_t       *ns,
+	uint64_t       *match)
+{
+    int           retval = -1;
+    cvec         *cvv = NULL;
+    cg_obj       *co;
+    cligen_result result;
+    char         *reason = NULL;
+    cligen_stats  st;
+    uint64_t      t0;
+    uint64_t      t;
+    int           i;
+
+    if ((cvv = cvec_new(0)) == NULL)
+	goto done;
+    *ns = UINT64_MAX;
+    for (i=0; i<lf->lf_repeat; i++){
+	strncpy(lf->lf_buf, str, lf->lf_maxlen);
+	lf->lf_buf[lf->lf_maxlen] = '\0';
+	cligen_stats_reset(lf->lf_h);
+	t0 = lf_now();
+	if (cliread_parse(lf->lf_h, lf->lf_buf, lf->lf_pt, &co, cvv, &result, &reason) < 0)
+	    goto done;
+	t = lf_now() - t0;
+	if (t < *ns)
+	    *ns = t;
+	cligen_stats_get(lf->lf_h, &st);
+	*match = st.cs_match_object;
+	if (reason){
+	    free(reason);
+	    reason = NULL;
+	}
+	cvec_reset(cvv);
+    }
+    retval = 0;
+ done:
+    if (reason)
+	free(reason);
+    if (cvv)
+	cvec_free(cvv);
+    return retval;
+}
+
+/*! Add keywords of a parse-tree and its children to the vocabulary
+ * Tree references are not followed, their keywords are added from their own trees
+ */
+static int
+lf_vocab_add(struct latfuzz *lf,
+	     parse_tree     *pt,
+	     int             depth)
+{
+    cg_obj *co;
+    int     i;
+    int     j;
+
+    if (pt == NULL || depth > LF_TOKENS)
+	return 0;
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL)
+	    continue;
+	if (co->co_type == CO_COMMAND){
+	    for (j=0; j<lf->lf_nvocab; j++)
+		if (strcmp(lf->lf_vocab[j], co->co_command) == 0)
+		    break;
+	    if (j == lf->lf_nvocab){
+		if ((lf->lf_vocab = realloc(lf->lf_vocab, (lf->lf_nvocab+1)*sizeof(char*))) == NULL)
+		    return -1;
+		if ((lf->lf_vocab[lf->lf_nvocab++] = strdup(co->co_command)) == NULL)
+		    return -1;
+	    }
+	}
+	if (lf_vocab_add(lf, co_pt_get(co), depth+1) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/*! Generate a value of a variable type, sometimes also an invalid or a long one */
+static void
+lf_value(struct latfuzz *lf,
+	 enum cv_type    type,
+	 cbuf           *cb)
+{
+    unsigned int *seed = &lf->lf_seed;
+    int           i;
+    int           n;
+
+    switch (rand_r(seed) % 8){
+    case 0: /* Long string */
+	n = 1 + rand_r(seed) % 256;
+	for (i=0; i<n; i++)
+	    cprintf(cb, "%c", 'a' + rand_r(seed) % 26);
+	return;
+    case 1: /* Keyword */
+	if (lf->lf_nvocab){
+	    cprintf(cb, "%s", lf->lf_vocab[rand_r(seed) % lf->lf_nvocab]);
+	    return;
+	}
+	break;
+    default:
+	break;
+    }
+    if (cv_isint(type) || type == CGV_DEC64)
+	cprintf(cb, "%d", rand_r(seed) % 1000 - (type == CGV_DEC64 ? 500 : 0));
+    else if (type == CGV_BOOL)
+	cprintf(cb, "%s", rand_r(seed) % 2 ? "true" : "false");
+    else if (type == CGV_IPV4ADDR || type == CGV_IPV4PFX)
+	cprintf(cb, "10.%d.%d.%d%s", rand_r(seed) % 256, rand_r(seed) % 256, rand_r(seed) % 256,
+		type == CGV_IPV4PFX ? "/24" : "");
+    else if (type == CGV_IPV6ADDR || type == CGV_IPV6PFX)
+	cprintf(cb, "2001:db8::%x%s", rand_r(seed) % 65536, type == CGV_IPV6PFX ? "/64" : "");
+    else if (type == CGV_MACADDR)
+	cprintf(cb, "00:11:22:33:44:%02x", rand_r(seed) % 256);
+    else if (type == CGV_REST){
+	n = 1 + rand_r(seed) % 8;
+	for (i=0; i<n; i++)
+	    cprintf(cb, "%sr%d", i?" ":"", rand_r(seed) % 100);
+    }
+    else
+	cprintf(cb, "x%d", rand_r(seed) % 100);
+}
+
+/*! Generate an input by a random walk of the parse-tree */
+static int
+lf_generate(struct latfuzz *lf,
+	    cbuf           *cb)
+{
+    parse_tree *pt = lf->lf_pt;
+    cg_obj     *co;
+    int         ntok = 1 + rand_r(&lf->lf_seed) % LF_TOKENS;
+    int         len;
+    int         i;
+
+    for (i=0; i<ntok && pt && (len = pt_len_get(pt)) > 0; i++){
+	if ((co = pt_vec_i_get(pt, rand_r(&lf->lf_seed) % len)) == NULL)
+	    break; /* End of command */
+	if (i)
+	    cprintf(cb, " ");
+	switch (co->co_type){
+	case CO_COMMAND:
+	    if (rand_r(&lf->lf_seed) % 8 == 0) /* Prefix */
+		cprintf(cb, "%.*s", 1 + (int)(rand_r(&lf->lf_seed) % strlen(co->co_command)),
+			co->co_command);
+	    else
+		cprintf(cb, "%s", co->co_command);
+	    break;
+	case CO_VARIABLE:
+	    lf_value(lf, co->co_vtype, cb);
+	    break;
+	case CO_REFERENCE:
+	    if (lf->lf_nvocab)
+		cprintf(cb, "%s", lf->lf_vocab[rand_r(&lf->lf_seed) % lf->lf_nvocab]);
+	    break;
+	}
+	pt = co_pt_get(co);
+    }
+    return 0;
+}
+
+/*! Split an input into tokens
+ * @param[in]  str   Input string, modified
+ * @param[out] tokv  Vector of tokens pointing into str, room for strlen(str)/2+1 tokens
+ * @retval     n     Number of tokens
+ */
+static int
+lf_tokens(char *str,
+	  char *tokv[])
+{
+    char *s;
+    int   n = 0;
+
+    for (s = strtok(str, " "); s; s = strtok(NULL, " "))
+	tokv[n++] = s;
+    return n;
+}
+
+/*! Write a token, repeated within itself rep times, followed by a space */
+static void
+lf_token_put(cbuf *cb,
+	     char *tok,
+	     int   len,
+	     int   rep)
+{
+    int i;
+
+    if (len == 0)
+	return;
+    for (i=0; i<rep; i++)
+	cprintf(cb, "%.*s", len, tok);
+    cprintf(cb, " ");
+}
+
+/*! Mutate an input
+ * @param[in]  lf    Fuzzer state
+ * @param[in]  str   Input to mutate, not modified
+ * @param[out] cb    Mutated input
+ */
+static int
+lf_mutate(struct latfuzz *lf,
+	  char           *str,
+	  cbuf           *cb)
+{
+    int           retval = -1;
+    unsigned int *seed = &lf->lf_seed;
+    char         *copy = NULL;
+    char        **tokv = NULL;
+    int          *lenv = NULL;       /* Token length, 0 if deleted */
+    int          *repv = NULL;       /* Token is repeated this many times within itself */
+    char         *ins = NULL;        /* Inserted keyword */
+    int           insi = -1;         /* Insert before this token, random walk if no keyword */
+    int           span0 = 0;         /* First token of repeated span */
+    int           span1 = -1;        /* Last token of repeated span */
+    int           nspan = 0;         /* Times span is repeated */
+    int           n;
+    int           i;
+    int           r;
+    int           t;
+
+    if ((copy = strdup(str)) == NULL)
+	goto done;
+    n = strlen(copy)/2 + 1;
+    if ((tokv = malloc(n*sizeof(char*))) == NULL ||
+	(lenv = malloc(n*sizeof(int))) == NULL ||
+	(repv = malloc(n*sizeof(int))) == NULL)
+	goto done;
+    n = lf_tokens(copy, tokv);
+    for (i=0; i<n; i++){
+	lenv[i] = strlen(tokv[i]);
+	repv[i] = 1;
+    }
+    i = n ? rand_r(seed) % n : 0;
+    switch (n ? rand_r(seed) % 7 : 6){
+    case 0: /* Repeat a span of tokens, eg set elements */
+	span0 = i;
+	span1 = i + rand_r(seed) % (n - i);
+	nspan = 1 + rand_r(seed) % 8;
+	break;
+    case 1: /* Long token */
+	repv[i] = 2 + rand_r(seed) % 16;
+	break;
+    case 2: /* Prefix of token */
+	if (lenv[i] > 1)
+	    lenv[i] = 1 + rand_r(seed) % (lenv[i] - 1);
+	break;
+    case 3: /* Insert keyword */
+	if (lf->lf_nvocab){
+	    insi = rand_r(seed) % (n+1);
+	    ins = lf->lf_vocab[rand_r(seed) % lf->lf_nvocab];
+	}
+	break;
+    case 4: /* Delete token */
+	lenv[i] = 0;
+	break;
+    case 5: /* Replace token with keyword */
+	if (lf->lf_nvocab){
+	    tokv[i] = lf->lf_vocab[rand_r(seed) % lf->lf_nvocab];
+	    lenv[i] = strlen(tokv[i]);
+	}
+	break;
+    default: /* Append a random walk */
+	insi = n;
+	break;
+    }
+    for (i=0; i<=n; i++){
+	if (i == insi){
+	    if (ins)
+		cprintf(cb, "%s ", ins);
+	    else if (lf_generate(lf, cb) < 0)
+		goto done;
+	}
+	if (i == n)
+	    break;
+	lf_token_put(cb, tokv[i], lenv[i], repv[i]);
+	if (i == span1)
+	    for (r=0; r<nspan; r++)
+		for (t=span0; t<=span1; t++)
+		    lf_token_put(cb, tokv[t], lenv[t], repv[t]);
+    }
+    retval = 0;
+ done:
+    if (tokv)
+	free(tokv);
+    if (lenv)
+	free(lenv);
+    if (repv)
+	free(repv);
+    if (copy)
+	free(copy);
+    return retval;
+}
+
+/*! Add an input to the slowest inputs if it is slower than any of them
+ * @param[in]  lf   Fuzzer state
+ * @param[in]  li   Evaluated input, the string is copied
+ */
+static int
+lf_top_add(struct latfuzz  *lf,
+	   struct lf_input *li)
+{
+    int i;
+    int j;
+
+    for (i=0; i<lf->lf_ntop; i++)
+	if (strcmp(lf->lf_top[i].li_str, li->li_str) == 0){
+	    if (li->li_ns > lf->lf_top[i].li_ns) /* Remeasured, keep the slowest */
+		lf->lf_top[i].li_ns = li->li_ns;
+	    return 0;
+	}
+    for (i=0; i<lf->lf_ntop; i++)
+	if (li->li_ns > lf->lf_top[i].li_ns)
+	    break;
+    if (i == lf->lf_k)
+	return 0;
+    if (lf->lf_ntop == lf->lf_k)
+	free(lf->lf_top[--lf->lf_ntop].li_str);
+    for (j=lf->lf_ntop; j>i; j--)
+	lf->lf_top[j] = lf->lf_top[j-1];
+    lf->lf_top[i] = *li;
+    if ((lf->lf_top[i].li_str = strdup(li->li_str)) == NULL)
+	return -1;
+    lf->lf_ntop++;
+    return 0;
+}
+
+/*! Add an input to the seeds of mutation, replacing a random one if full */
+static int
+lf_pool_add(struct latfuzz  *lf,
+	    struct lf_input *li)
+{
+    int i;
+
+    if (lf->lf_npool < LF_POOL)
+	i = lf->lf_npool++;
+    else{
+	i = rand_r(&lf->lf_seed) % LF_POOL;
+	free(lf->lf_pool[i].li_str);
+    }
+    lf->lf_pool[i] = *li;
+    if ((lf->lf_pool[i].li_str = strdup(li->li_str)) == NULL)
+	return -1;
+    return 0;
+}
+
+/*! Evaluate a candidate of minimization
+ * @retval  1   The candidate keeps at least LF_MINIMIZE_PCT percent of the cost of li
+ * @retval  0   It does not
+ * @retval -1   Error
+ */
+static int
+lf_keeps_cost(struct latfuzz  *lf,
+	      char            *cand,
+	      struct lf_input *li,
+	      struct lf_input *lc)
+{
+    if (lf_eval(lf, cand, &lc->li_ns, &lc->li_match) < 0)
+	return -1;
+    return lc->li_ns*100 >= li->li_ns*LF_MINIMIZE_PCT &&
+	lc->li_match*100 >= li->li_match*LF_MINIMIZE_PCT;
+}
+
+/*! Minimize an input: remove spans of tokens and then shorten tokens, while the cost remains
+ * @param[in]     lf   Fuzzer state
+ * @param[in,out] li   Input, replaced by the minimized input and its cost
+ * Tokens are removed in spans of decreasing size as in delta debugging, a token is
+ * shortened by halving its length.
+ */
+static int
+lf_minimize(struct latfuzz  *lf,
+	    struct lf_input *li)
+{
+    int             retval = -1;
+    char           *copy = NULL;
+    char          **tokv = NULL;
+    int            *lenv = NULL;
+    int             n;
+    int             span;
+    int             i;
+    int             j;
+    int             len;
+    int             ret;
+    int             nevals = 0;
+    cbuf           *cb = NULL;
+    struct lf_input lc;
+
+    if ((cb = cbuf_new()) == NULL)
+	goto done;
+    if ((copy = strdup(li->li_str)) == NULL)
+	goto done;
+    n = strlen(copy)/2 + 1;
+    if ((tokv = malloc(n*sizeof(char*))) == NULL ||
+	(lenv = malloc(n*sizeof(int))) == NULL)
+	goto done;
+    n = lf_tokens(copy, tokv);
+    for (i=0; i<n; i++)
+	lenv[i] = strlen(tokv[i]);
+    /* Remove spans of tokens */
+    for (span = n/2 ? n/2 : 1; span > 0 && nevals < LF_MINIMIZE_MAX; span /= 2){
+	i = 0;
+	while (i < n && n > span && nevals < LF_MINIMIZE_MAX){
+	    cbuf_reset(cb);
+	    for (j=0; j<n; j++)
+		if (j < i || j >= i+span)
+		    cprintf(cb, "%s%.*s", cbuf_len(cb)?" ":"", lenv[j], tokv[j]);
+	    nevals++;
+	    if ((ret = lf_keeps_cost(lf, cbuf_get(cb), li, &lc)) < 0)
+		goto done;
+	    if (ret){
+		for (j=i; j+span<n; j++){
+		    tokv[j] = tokv[j+span];
+		    lenv[j] = lenv[j+span];
+		}
+		n -= span;
+	    }
+	    else
+		i += span;
+	}
+    }
+    /* Shorten tokens */
+    for (i=0; i<n && nevals < LF_MINIMIZE_MAX; i++)
+	while ((len = lenv[i]/2) > 0 && nevals < LF_MINIMIZE_MAX){
+	    cbuf_reset(cb);
+	    for (j=0; j<n; j++)
+		cprintf(cb, "%s%.*s", j?" ":"", j==i?len:lenv[j], tokv[j]);
+	    nevals++;
+	    if ((ret = lf_keeps_cost(lf, cbuf_get(cb), li, &lc)) < 0)
+		goto done;
+	    if (!ret)
+		break;
+	    lenv[i] = len;
+	}
+    cbuf_reset(cb);
+    for (j=0; j<n; j++)
+	cprintf(cb, "%s%.*s", j?" ":"", lenv[j], tokv[j]);
+    if (lf_eval(lf, cbuf_get(cb), &li->li_ns, &li->li_match) < 0)
+	goto done;
+    free(li->li_str);
+    if ((li->li_str = strdup(cbuf_get(cb))) == NULL)
+	goto done;
+    retval = 0;
+ done:
+    if (tokv)
+	free(tokv);
+    if (lenv)
+	free(lenv);
+    if (copy)
+	free(copy);
+    if (cb)
+	cbuf_free(cb);
+    return retval;
+}
+
+/*! Print a string as a JSON string */
+static void
+lf_json_str(FILE *f,
+	    char *str)
+{
+    char *s;
+
+    fprintf(f, "\"");
+    for (s = str; *s; s++)
+	if (*s == '"' || *s == '\\')
+	    fprintf(f, "\\%c", *s);
+	else if ((unsigned char)*s < 0x20)
+	    fprintf(f, "\\u%04x", *s);
+	else
+	    fprintf(f, "%c", *s);
+    fprintf(f, "\"");
+}
+
+/*! Save the slowest inputs and a copy of the clispec in a corpus directory
+ * @param[in]  lf    Fuzzer state
+ * @param[in]  spec  Clispec filename
+ * @param[in]  dir   Corpus directory
+ * @param[in]  seed  Random seed of the run
+ * The files are named as the clispec without its suffix: <dir>/<name>.cli and <dir>/<name>.in
+ */
+static int
+lf_save(struct latfuzz *lf,
+	char           *spec,
+	char           *dir,
+	unsigned int    seed)
+{
+    int    retval = -1;
+    char  *specdup = NULL;
+    char  *name;
+    char  *s;
+    cbuf  *cb = NULL;
+    FILE  *fi = NULL;
+    FILE  *fo = NULL;
+    char   buf[BUFSIZ];
+    size_t len;
+    int    i;
+
+    if ((cb = cbuf_new()) == NULL)
+	goto done;
+    if ((specdup = strdup(spec)) == NULL)
+	goto done;
+    name = basename(specdup);
+    if ((s = strrchr(name, '.')) != NULL)
+	*s = '\0';
+    cprintf(cb, "%s/%s.cli", dir, name);
+    if ((fi = fopen(spec, "r")) == NULL){
+	fprintf(stderr, "fopen(%s): %s\n", spec, strerror(errno));
+	goto done;
+    }
+    if ((fo = fopen(cbuf_get(cb), "w")) == NULL){
+	fprintf(stderr, "fopen(%s): %s\n", cbuf_get(cb), strerror(errno));
+	goto done;
+    }
+    while ((len = fread(buf, 1, sizeof(buf), fi)) > 0)
+	if (fwrite(buf, 1, len, fo) != len){
+	    fprintf(stderr, "fwrite(%s): %s\n", cbuf_get(cb), strerror(errno));
+	    goto done;
+	}
+    fclose(fo);
+    fclose(fi);
+    fi = NULL;
+    cbuf_reset(cb);
+    cprintf(cb, "%s/%s.in", dir, name);
+    if ((fo = fopen(cbuf_get(cb), "w")) == NULL){
+	fprintf(stderr, "fopen(%s): %s\n", cbuf_get(cb), strerror(errno));
+	goto done;
+    }
+    fprintf(fo, "# Slowest inputs of %s.cli found by cligen_latfuzz -s %u\n", name, seed);
+    for (i=0; i<lf->lf_ntop; i++)
+	fprintf(fo, "%s\n", lf->lf_top[i].li_str);
+    retval = 0;
+ done:
+    if (fo)
+	fclose(fo);
+    if (fi)
+	fclose(fi);
+    if (specdup)
+	free(specdup);
+    if (cb)
+	cbuf_free(cb);
+    return retval;
+}
+
+/*! Read seed inputs, one per line, empty lines and lines starting with '#' are skipped */
+static int
+lf_seeds_read(struct latfuzz *lf,
+	      FILE           *f)
+{
+    char           *line = NULL;
+    size_t          linecap = 0;
+    ssize_t         len;
+    struct lf_input li;
+
+    while ((len = getline(&line, &linecap, f)) > 0){
+	if (line[len-1] == '\n')
+	    line[--len] = '\0';
+	if (len == 0 || *line == '#')
+	    continue;
+	if (len > lf->lf_maxlen)
+	    line[lf->lf_maxlen] = '\0';
+	li.li_str = line;
+	if (lf_eval(lf, line, &li.li_ns, &li.li_match) < 0)
+	    goto done;
+	if (lf_pool_add(lf, &li) < 0 || lf_top_add(lf, &li) < 0)
+	    goto done;
+    }
+    free(line);
+    return 0;
+ done:
+    free(line);
+    return -1;
+}
+
+/*! Generate and mutate inputs, keep the slowest */
+static int
+lf_run(struct latfuzz *lf)
+{
+    int              retval = -1;
+    cbuf            *cb = NULL;
+    struct lf_input *parent;
+    struct lf_input  li;
+    int              i;
+
+    if ((cb = cbuf_new()) == NULL)
+	goto done;
+    for (i=0; i<lf->lf_iter; i++){
+	cbuf_reset(cb);
+	/* Every fourth input is a new random walk, the others mutations of a seed */
+	if (lf->lf_npool == 0 || rand_r(&lf->lf_seed) % 4 == 0){
+	    parent = NULL;
+	    if (lf_generate(lf, cb) < 0)
+		goto done;
+	}
+	else {
+	    parent = &lf->lf_pool[rand_r(&lf->lf_seed) % lf->lf_npool];
+	    if (lf_mutate(lf, parent->li_str, cb) < 0)
+		goto done;
+	}
+	if (cbuf_len(cb) > lf->lf_maxlen)
+	    cbuf_trunc(cb, lf->lf_maxlen);
+	li.li_str = cbuf_get(cb);
+	if (lf_eval(lf, li.li_str, &li.li_ns, &li.li_match) < 0)
+	    goto done;
+	if (parent == NULL ||
+	    li.li_match > parent->li_match || li.li_ns > parent->li_ns)
+	    if (lf_pool_add(lf, &li) < 0)
+		goto done;
+	if (lf_top_add(lf, &li) < 0)
+	    goto done;
+    }
+    retval = 0;
+ done:
+    if (cb)
+	cbuf_free(cb);
+    return retval;
+}
+
+static void
+usage(char *argv0)
+{
+    fprintf(stderr, "Usage:%s [-h] -f <file> [-i <file>][-n <n>][-k <n>][-r <n>][-l <n>][-s <n>][-o <dir>], where the options have the following meaning:\n"
+	    "\t-h \t\tHelp\n"
+	    "\t-f <file> \tClispec file\n"
+	    "\t-i <file> \tSeed inputs, one per line (default random walks of the parse-tree)\n"
+	    "\t-n <n> \tNumber of inputs to generate (default 10000)\n"
+	    "\t-k <n> \tNumber of slowest inputs to minimize and save (default 10)\n"
+	    "\t-r <n> \tRuns of each input, the best time is used (default 3)\n"
+	    "\t-l <n> \tMax length of an input (default 1024)\n"
+	    "\t-s <n> \tRandom seed (default 42)\n"
+	    "\t-o <dir> \tSave clispec and slowest inputs in corpus directory\n",
+	    argv0);
+    exit(0);
+}
+
+int
+main(int   argc,
+     char *argv[])
+{
+    int             retval = -1;
+    struct latfuzz  lf = {0,};
+    char           *spec = NULL;
+    char           *seeds = NULL;
+    char           *dir = NULL;
+    FILE           *f = NULL;
+    cvec           *globals = NULL;
+    pt_head        *ph;
+    char           *str;
+    unsigned int    seed;
+    int             c;
+    int             i;
+    int             j;
+
+    lf.lf_seed = seed = 42;
+    lf.lf_iter = 10000;
+    lf.lf_repeat = 3;
+    lf.lf_maxlen = 1024;
+    lf.lf_k = 10;
+    while ((c = getopt(argc, argv, "hf:i:n:k:r:l:s:o:")) != -1)
+	switch (c) {
+	case 'f':
+	    spec = optarg;
+	    break;
+	case 'i':
+	    seeds = optarg;
+	    break;
+	case 'n':
+	    lf.lf_iter = atoi(optarg);
+	    break;
+	case 'k':
+	    lf.lf_k = atoi(optarg);
+	    break;
+	case 'r':
+	    lf.lf_repeat = atoi(optarg);
+	    break;
+	case 'l':
+	    lf.lf_maxlen = atoi(optarg);
+	    break;
+	case 's':
+	    lf.lf_seed = seed = atoi(optarg);
+	    break;
+	case 'o':
+	    dir = optarg;
+	    break;
+	case 'h':
+	default:
+	    usage(argv[0]);
+	    break;
+	}
+    if (spec == NULL || lf.lf_k < 1 || lf.lf_repeat < 1 || lf.lf_maxlen < 1)
+	usage(argv[0]);
+    if ((lf.lf_h = cligen_init()) == NULL)
+	goto done;
+    if ((globals = cvec_new(0)) == NULL)
+	goto done;
+    if ((f = fopen(spec, "r")) == NULL){
+	fprintf(stderr, "fopen(%s): %s\n", spec, strerror(errno));
+	goto done;
+    }
+    if (cligen_parse_file(lf.lf_h, f, spec, NULL, globals) < 0)
+	goto done;
+    fclose(f);
+    f = NULL;
+    if ((str = cvec_find_str(globals, "mode")) != NULL)
+	cligen_ph_active_set(lf.lf_h, str);
+    if ((str = cvec_find_str(globals, "comment")) != NULL)
+	cligen_comment_set(lf.lf_h, *str);
+    ph = NULL;
+    while ((ph = cligen_ph_each(lf.lf_h, ph)) != NULL){
+	if (cligen_expandv_str2fn(cligen_ph_parsetree_get(ph), str2fn_exp, NULL) < 0)
+	    goto done;
+	if (lf_vocab_add(&lf, cligen_ph_parsetree_get(ph), 0) < 0)
+	    goto done;
+    }
+    if ((lf.lf_pt = cligen_ph_active_get(lf.lf_h)) == NULL){
+	fprintf(stderr, "%s: no active parse-tree\n", spec);
+	goto done;
+    }
+    if ((lf.lf_buf = malloc(lf.lf_maxlen+1)) == NULL ||
+	(lf.lf_pool = calloc(LF_POOL, sizeof(struct lf_input))) == NULL ||
+	(lf.lf_top = calloc(lf.lf_k, sizeof(struct lf_input))) == NULL)
+	goto done;
+    if (seeds){
+	if ((f = fopen(seeds, "r")) == NULL){
+	    fprintf(stderr, "fopen(%s): %s\n", seeds, strerror(errno));
+	    goto done;
+	}
+	if (lf_seeds_read(&lf, f) < 0)
+	    goto done;
+	fclose(f);
+	f = NULL;
+    }
+    if (lf_run(&lf) < 0)
+	goto done;
+    for (i=0; i<lf.lf_ntop; i++){
+	if (lf_minimize(&lf, &lf.lf_top[i]) < 0)
+	    goto done;
+	/* Different inputs may be minimized to the same */
+	for (j=0; j<i; j++)
+	    if (strcmp(lf.lf_top[j].li_str, lf.lf_top[i].li_str) == 0)
+		break;
+	if (j < i){
+	    free(lf.lf_top[i].li_str);
+	    for (j=i; j+1<lf.lf_ntop; j++)
+		lf.lf_top[j] = lf.lf_top[j+1];
+	    lf.lf_ntop--;
+	    i--;
+	    continue;
+	}
+	fprintf(stdout, "{\"input\":");
+	lf_json_str(stdout, lf.lf_top[i].li_str);
+	fprintf(stdout, ",\"len\":%zu,\"ns\":%llu,\"match_object\":%llu}\n",
+		strlen(lf.lf_top[i].li_str),
+		(unsigned long long)lf.lf_top[i].li_ns,
+		(unsigned long long)lf.lf_top[i].li_match);
+    }
+    if (dir && lf_save(&lf, spec, dir, seed) < 0)
+	goto done;
+    retval = 0;
+ done:
+    if (f)
+	fclose(f);
+    if (globals)
+	cvec_free(globals);
+    for (i=0; i<lf.lf_npool; i++)
+	free(lf.lf_pool[i].li_str);
+    for (i=0; i<lf.lf_ntop; i++)
+	free(lf.lf_top[i].li_str);
+    for (i=0; i<lf.lf_nvocab; i++)
+	free(lf.lf_vocab[i]);
+    if (lf.lf_vocab)
+	free(lf.lf_vocab);
+    if (lf.lf_pool)
+	free(lf.lf_pool);
+    if (lf.lf_top)
+	free(lf.lf_top);
+    if (lf.lf_buf)
+	free(lf.lf_buf);
+    if (lf.lf_h)
+	cligen_exit(lf.lf_h);
+    return retval;
+}
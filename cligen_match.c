@@ -55,6 +55,7 @@
 #include <arpa/inet.h>
 
 #include "cligen_buf.h"
+#include "cligen_arena.h"
 #include "cligen_cv.h"
 #include "cligen_cvec.h"
 #include "cligen_parsetree.h"
@@ -64,6 +65,12 @@
 #include "cligen_expand.h"
 #include "cligen_read.h"
 #include "cligen_match.h"
+#include "cligen_stats.h"
+#include "cligen_trace.h"
+#include "cligen_handle_internal.h"
+#include "cligen_stats_internal.h"
+#include "cligen_trace_internal.h"
+#include "cligen_cv_internal.h"
 
 #ifndef MIN
 #define MIN(x,y) ((x)<(y)?(x):(y))
@@ -71,9 +78,21 @@
 
 #define ISREST(co) ((co)->co_type == CO_VARIABLE && (co)->co_vtype == CGV_REST)
 
+/* Positions already matched in a level of a set, one bit per object of the level.
+ * Allocated in the handle arena for each set level that is iterated, so that nothing
+ * needs to be cleared and the parse-tree is not modified. NULL if not a set level.
+ * @see match_pattern_sets
+ */
+#define MATCHED_WORDS(len) (((len)+63)/64)
+#define matched_get(m, i)  ((m) != NULL && ((m)[(i)/64] >> ((i)%64)) & 1)
+#define matched_set(m, i)  do {if (m) (m)[(i)/64] |= 1ULL << ((i)%64);} while (0)
+
 /*! Result vector from match_pattern_* family of functions
+ * The struct and mr_vec are allocated in the handle arena and released when
+ * match_pattern returns
  */
 struct match_result{
+    cligen_arena *mr_arena; /* Arena where mr and mr_vec are allocated */
     uint32_t     mr_len;    /* Length of mr_vec (significant entries) */
     uint32_t     mr_size;   /* Size of allocated space of mr_vec */
     int         *mr_vec;    /* (Indirect) vector of integers that identify indexes into mr_parsetree */
@@ -90,6 +109,7 @@ typedef struct match_result match_result;
  * @param[in]  string  Input string to match
  * @param[in]  pvt     variable type (from definition)
  * @param[in]  cmd     variable string (from definition) - can contain range
+ * @param[in]  tc      Token class of string shared between variables, or NULL
  * 
  * @retval     -1      Error (print msg on stderr)
  * @retval     0       Not match and reason returned as malloced string.
@@ -98,25 +118,33 @@ typedef struct match_result match_result;
  * @see cvec_match where actual allocation of variables is made not only sanity
  */
 static int
-match_variable(cligen_handle h,
-	       cg_obj       *co, 
-	       char         *str, 
-	       char        **reason)
+match_variable(cligen_handle   h,
+	       cg_obj         *co, 
+	       char           *str, 
+	       cv_token_class *tc,
+	       char          **reason)
 {
     int         retval = -1;
     cg_var     *cv; /* Just a temporary cv for validation */
     cg_varspec *cs;
+    cligen_trace *tr;
+    uint64_t    t = 0;
 
     cs = &co->u.cou_var;
     if ((cv = cv_new(co->co_vtype)) == NULL)
 	goto done;
     if (co->co_vtype == CGV_DEC64) /* XXX: Seems misplaced? / too specific */
 	cv_dec64_n_set(cv, cs->cgs_dec64_n);
-    if ((retval = cv_parse1(str, cv, reason)) <= 0) 
+    if ((retval = cv_parse1_class(str, cv, tc, reason)) <= 0) 
 	goto done;
     /* here retval should be 1 */
     /* Validate value */
-    if ((retval = cv_validate(h, cv, cs, co->co_command, reason)) <= 0)
+    if ((tr = cligen_trace_rec(h)) != NULL)
+	t = cligen_stats_ns();
+    retval = cv_validate(h, cv, cs, co->co_command, reason);
+    if (tr)
+	cligen_trace_phase(tr, CT_VALIDATE, t);
+    if (retval <= 0)
 	goto done;
     /* here retval should be 1 */
   done:
@@ -130,6 +158,7 @@ match_variable(cligen_handle h,
  * @param[in]  co      cligen object
  * @param[in]  best    Only return best match (for command evaluation) instead of all possible options
  * @param[out] exact   1 if match is exact (CO_COMMANDS). VARS is 0.
+ * @param[in]  tc      Token class of str shared between objects, or NULL
  * @param[out] reason  if not match and co type is 0, reason points to a (malloced) 
  *                     string containing an error explanation string. If reason is
  *                     NULL no such string will be malloced. This string needs to
@@ -139,16 +168,18 @@ match_variable(cligen_handle h,
  * @retval   1         Match
  */
 static int 
-match_object(cligen_handle h,
-	     char         *str,
-	     cg_obj       *co,
-	     int           best, 
-	     int          *exact,
-	     char        **reason)
+match_object(cligen_handle   h,
+	     char           *str,
+	     cg_obj         *co,
+	     int             best, 
+	     int            *exact,
+	     cv_token_class *tc,
+	     char          **reason)
 {
   int    match = 0;
   size_t len = 0;
 
+  cligen_stats_inc(h, cs_match_object);
   if (str)
       len = strlen(str);
   if (exact)
@@ -180,7 +211,7 @@ match_object(cligen_handle h,
       if (str == NULL || len==0)
 	  match++;
       else
-	  if ((match = match_variable(h, co, str, reason)) < 0)
+	  if ((match = match_variable(h, co, str, tc, reason)) < 0)
 	      return -1;
     break;
   case CO_REFERENCE: /* This should never match, it is an abstract object that is expanded */
@@ -199,31 +230,29 @@ match_object(cligen_handle h,
       return 1;
 }
 
-/*! Given a string (s0), return the next token. 
- * The string is modified to return
- * the remainder of the string after the identified token.
+/*! Given a string (s0), find the next token without copying it
+ * The string is not modified, s0 is set to the remainder after the identified token.
  * A token is found either as characters delimited by one or many delimiters.
  * Or as a pair of double-quotes(") with any characters in between.
- * if there are trailing spaces after the token, trail is set to one.
- * If string is NULL or "", NULL is returned.
- * If empty token found, s0 is NULL
- * @param[in]  s0       String, the string is modified like strtok
- * @param[out] token0   A malloced token.  NOTE: token must be freed after use.
- * @param[out] rest0    A remaining (rest) string.  NOTE: NOT malloced.
- * @param[out] leading0 If leading delimiters eg " thisisatoken"
+ * If string is "", or only delimiters, no token is found
+ * @param[in,out] s0       String, set to remainder, or NULL if no token found
+ * @param[out]    tok0     Start of token, NULL if no token found
+ * @param[out]    len0     Length of token
+ * @param[out]    rest0    A remaining (rest) string, starting at the token
+ * @param[out]    leading0 If leading delimiters eg " thisisatoken"
  * Example:
  *   s0 = "  foo bar"
- * results in token="foo", leading=1
+ * results in token="foo", len=3, rest="foo bar", leading=2
  */
 static int
-next_token(char **s0, 
-	   char **token0,
-	   char **rest0, 
-	   int   *leading0)
+next_token(char  **s0, 
+	   char  **tok0,
+	   size_t *len0,
+	   char  **rest0, 
+	   int    *leading0)
 {
     char  *s;
     char  *st;
-    char  *token = NULL;
     size_t len;
     int    quote=0;
     int    leading=0;
@@ -266,10 +295,6 @@ next_token(char **s0,
     }
     if (quote && *s){
 	s++;
-	// fprintf(stderr, "s=\"%s\" %d %s\n", s, *s, index(CLIGEN_DELIMITERS, *s));
-	if (*s && index(CLIGEN_DELIMITERS, *s) == NULL){
-	    ;//	cligen_reason("Quote token error");
-	}
 	len = (s-st)-1;
     }
     else{
@@ -278,24 +303,221 @@ next_token(char **s0,
 	}
 	len = (s-st);
 	if (!len){
-	    token = NULL;
+	    st = NULL;
 	    *s0 = NULL;
 	    goto done;
 	}
     }
-    if ((token=malloc(len+1)) == NULL){
-	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
-	return -1;
-    }
-    memcpy(token, st, len);
-    token[len] = '\0';
     *s0 = s;
  done:
     *leading0 = leading;
-    *token0 = token;
+    *tok0 = st;
+    *len0 = len;
     return 0;
 }
 
+/*
+ * Tokenized command line
+ * Tokens and rests are spans into one copy of the line, made by cligen_str2tokens.
+ * Element 0 is the whole line, as in cligen_str2cvv.
+ */
+/* Number of spans stored in cligen_tokens itself before heap allocation is made */
+#define CLIGEN_TOKENS_INLINE_LEN 8
+
+struct token_span {
+    int   ts_tok;    /* Offset of NUL-terminated token in ct_buf */
+    int   ts_len;    /* Length of token */
+    int   ts_rest;   /* Offset of rest in ct_buf, ie in the copy of the line */
+};
+
+struct cligen_tokens {
+    char              *ct_buf;  /* Copy of line followed by NUL-terminated tokens */
+    int                ct_len;  /* Number of spans */
+    int                ct_size; /* Allocated spans */
+    struct token_span *ct_vec;  /* ct_inline or malloc:d */
+    struct token_span  ct_inline[CLIGEN_TOKENS_INLINE_LEN];
+};
+
+static int
+tokens_add(cligen_tokens *ct,
+	   int            tok,
+	   int            len,
+	   int            rest)
+{
+    struct token_span *vec;
+    int                size;
+
+    if (ct->ct_len == ct->ct_size){
+	size = ct->ct_size * 2;
+	if (ct->ct_vec == ct->ct_inline){
+	    if ((vec = malloc(size*sizeof(*vec))) == NULL)
+		return -1;
+	    memcpy(vec, ct->ct_inline, sizeof(ct->ct_inline));
+	}
+	else if ((vec = realloc(ct->ct_vec, size*sizeof(*vec))) == NULL)
+	    return -1;
+	ct->ct_vec = vec;
+	ct->ct_size = size;
+    }
+    ct->ct_vec[ct->ct_len].ts_tok = tok;
+    ct->ct_vec[ct->ct_len].ts_len = len;
+    ct->ct_vec[ct->ct_len].ts_rest = rest;
+    ct->ct_len++;
+    return 0;
+}
+
+/*! Split a CLIgen command string into token and rest spans of one copy of the string
+ *
+ * Same tokens as cligen_str2cvv but the line is copied once and tokens are not
+ * allocated one by one. A rest is an offset into the copy of the line.
+ * @param[in]  string String to split
+ * @param[out] ctp    Tokens, free with cligen_tokens_free
+ * @retval     0      OK
+ * @retval    -1      Error
+ * @code
+ *   cligen_tokens *ct = NULL;
+ *   if (cligen_str2tokens("aa bb cc", &ct) < 0)
+ *     err;
+ *   cligen_tokens_i(ct, 2);    // "bb"
+ *   cligen_tokens_rest(ct, 2); // "bb cc"
+ *   cligen_tokens_free(ct);
+ * @endcode
+ * @see cligen_str2cvv
+ */
+int
+cligen_str2tokens(char           *string, 
+		  cligen_tokens **ctp)
+{
+    int            retval = -1;
+    cligen_tokens *ct = NULL;
+    size_t         slen;
+    char          *s;
+    char          *sr;
+    char          *t;
+    size_t         len;
+    int            trail;
+    int            i;
+    int            off;
+
+    slen = strlen(string);
+    if ((ct = malloc(sizeof(*ct))) == NULL)
+	goto done;
+    memset(ct, 0, sizeof(*ct));
+    ct->ct_vec = ct->ct_inline;
+    ct->ct_size = CLIGEN_TOKENS_INLINE_LEN;
+    /* A token is at most its chars in the line plus NUL, and there are at most
+     * slen+2 tokens, including empty ones */
+    if ((ct->ct_buf = malloc(3*slen+4)) == NULL)
+	goto done;
+    memcpy(ct->ct_buf, string, slen+1);
+    if (tokens_add(ct, 0, slen, 0) < 0)
+	goto done;
+    off = slen+1; /* Tokens are written after the line */
+    s = ct->ct_buf;
+    i = 0;
+    while (s != NULL) {
+	if (next_token(&s, &t, &len, &sr, &trail) < 0)
+	    goto done;
+	/* If there is no token, stop, 
+	 * unless it is the intial token (empty string) OR there are trailing whitespace
+	 * In these cases insert an empty "" token.
+	 */
+	if (t == NULL && !trail && i > 0)
+	    break;
+	if (t)
+	    memcpy(ct->ct_buf+off, t, len);
+	else
+	    len = 0;
+	ct->ct_buf[off+len] = '\0';
+	if (tokens_add(ct, off, len, sr - ct->ct_buf) < 0)
+	    goto done;
+	off += len+1;
+	i++;
+    }
+    *ctp = ct;
+    ct = NULL;
+    retval = 0;
+ done:
+    if (ct)
+	cligen_tokens_free(ct);
+    return retval;
+}
+
+/*! Free tokens
+ * @param[in]  ct   Tokens created by cligen_str2tokens
+ */
+int
+cligen_tokens_free(cligen_tokens *ct)
+{
+    if (ct->ct_buf)
+	free(ct->ct_buf);
+    if (ct->ct_vec != ct->ct_inline)
+	free(ct->ct_vec);
+    free(ct);
+    return 0;
+}
+
+/*! Number of tokens, including element 0 which is the whole line
+ * @param[in]  ct   Tokens
+ */
+int
+cligen_tokens_len(cligen_tokens *ct)
+{
+    return ct->ct_len;
+}
+
+/*! Return token i as NUL-terminated string, or NULL if out of range
+ * @param[in]  ct   Tokens
+ * @param[in]  i    Index, 0 is the whole line, 1 the first token
+ */
+char *
+cligen_tokens_i(cligen_tokens *ct,
+		int            i)
+{
+    if (i < 0 || i >= ct->ct_len)
+	return NULL;
+    return ct->ct_buf + ct->ct_vec[i].ts_tok;
+}
+
+/*! Return the remaining line starting at token i, or NULL if out of range
+ * @param[in]  ct   Tokens
+ * @param[in]  i    Index, 0 is the whole line, 1 the first token
+ */
+char *
+cligen_tokens_rest(cligen_tokens *ct,
+		   int            i)
+{
+    if (i < 0 || i >= ct->ct_len)
+	return NULL;
+    return ct->ct_buf + ct->ct_vec[i].ts_rest;
+}
+
+/*! Remove all tokens after the first len tokens
+ * @param[in]  ct   Tokens
+ * @param[in]  len  New number of tokens
+ */
+int
+cligen_tokens_trunc(cligen_tokens *ct,
+		    int            len)
+{
+    if (len >= 0 && len < ct->ct_len)
+	ct->ct_len = len;
+    return 0;
+}
+
+/*! Returns the number of "levels" of tokens, see cligen_cvv_levels
+ * @param[in] ct    Tokens
+ * @retval    0-n   Number of levels
+ * @retval    -1    Error
+ */
+int
+cligen_tokens_levels(cligen_tokens *ct)
+{
+    if (ct == NULL || ct->ct_len == 0)
+	return -1;
+    return ct->ct_len - 2;
+}
+
 /*! Split a CLIgen command string into a cligen variable vector using delimeters and escape quotes
  *
  * @param[in]  string String to split
@@ -316,51 +538,35 @@ next_token(char **s0,
  *   cvp : ["aa bb cc", "aa", "bb", "cc"]
  *   cvr : ["aa bb cc", "aa bb cc", "bb cc", "cc"]
  * @note both out cvv:s should be freed with cvec_free()
+ * @note Matching uses cligen_str2tokens which does not copy each token and rest
  */
 int
 cligen_str2cvv(char  *string, 
 	       cvec **cvtp,
     	       cvec **cvrp)
 {
-    int     retval = -1;
-    char   *s;
-    char   *sr;
-    char   *s0 = NULL;;
-    cvec   *cvt = NULL; /* token vector */
-    cvec   *cvr = NULL; /* rest vector */
-    cg_var *cv;
-    char   *t;
-    int     trail;
-    int     i;
+    int            retval = -1;
+    cligen_tokens *ct = NULL;
+    cvec          *cvt = NULL; /* token vector */
+    cvec          *cvr = NULL; /* rest vector */
+    cg_var        *cv;
+    int            i;
 
-    if ((s0 = strdup(string)) == NULL)
+    if (cligen_str2tokens(string, &ct) < 0)
 	goto done;
-    s = s0;
     if ((cvt = cvec_start(string)) ==NULL)
 	goto done;
     if ((cvr = cvec_start(string)) ==NULL)
 	goto done;
-    i = 0;
-    while (s != NULL) {
-	if (next_token(&s, &t, &sr, &trail) < 0)
-	    goto done;
-	/* If there is no token, stop, 
-	 * unless it is the intial token (empty string) OR there are trailing whitespace
-	 * In these cases insert an empty "" token.
-	 */
-	if (t == NULL && !trail && i > 0)
-	    break;
+    for (i=1; i<cligen_tokens_len(ct); i++){
 	if ((cv = cvec_add(cvr, CGV_STRING)) == NULL)
 	    goto done;
-	if (cv_string_set(cv, sr?sr:"") == NULL) /* XXX memleak */
+	if (cv_string_set(cv, cligen_tokens_rest(ct, i)) == NULL)
 	    goto done;
 	if ((cv = cvec_add(cvt, CGV_STRING)) == NULL)
 	    goto done;
-	if (cv_string_set(cv, t?t:"") == NULL) /* XXX memleak */
+	if (cv_string_set(cv, cligen_tokens_i(ct, i)) == NULL)
 	    goto done;
-	if (t)
-	    free(t);
-	i++;
     }
     retval = 0;
     assert(cvec_len(cvt)>1); /* XXX */
@@ -374,8 +580,8 @@ cligen_str2cvv(char  *string,
 	cvr = NULL;
     }
  done:
-    if (s0)
-	free(s0);
+    if (ct)
+	cligen_tokens_free(ct);
     if (cvt)
 	cvec_free(cvt);
     if (cvr)
@@ -420,6 +626,8 @@ cligen_txt2cvv(char  *str,
 		goto done;
 	    if (cv_strncpy(cv, &str[i0], i-i0) == NULL)
 		goto done;
+	    if (cv_string_intern(cv) < 0) /* Help texts are shared by expanded copies */
+		goto done;
 	    i0 = i+1;
 	    whitespace = 1;
 	}
@@ -432,6 +640,8 @@ cligen_txt2cvv(char  *str,
 	    goto done;
 	if (cv_strncpy(cv, &str[i0], i-i0) == NULL)
 	    goto done;
+	if (cv_string_intern(cv) < 0)
+	    goto done;
     }
     if (cvp){
 	assert(*cvp == NULL); /* XXX */
@@ -469,12 +679,12 @@ cligen_cvv_levels(cvec *cvv)
 /*! Termination criterium foir command string
  */
 static int
-last_level(cvec *cvt,
-	   int   level)
+last_level(cligen_tokens *ct,
+	   int            level)
 {
     int levels;
     
-    assert((levels = cligen_cvv_levels(cvt)) >= 0);
+    assert((levels = cligen_tokens_levels(ct)) >= 0);
     if (level >= levels)
 	return 1;
     return 0;
@@ -520,7 +730,7 @@ pt_onlyvars(parse_tree *pt)
     for (i=0; i<pt_len_get(pt); i++){ 
 	if ((co = pt_vec_i_get(pt, i)) == NULL)
 	    continue;
-	if (co->co_type != CO_VARIABLE && co->co_ref == NULL){
+	if (co->co_type != CO_VARIABLE && co_ref_get(co) == NULL){
 	    onlyvars = 0;
 	    break;
 	}
@@ -545,7 +755,10 @@ add_cov_to_cvec(cligen_handle h,
 		char         *cmd, 
 		cvec         *cvv)
 {
-    cg_var *cv = NULL;
+    cg_var       *cv = NULL;
+    cligen_trace *tr;
+    uint64_t      t;
+    int           ret;
 
     if ((cv = cvec_add(cvv, co->co_vtype)) == NULL)
 	return NULL;
@@ -560,31 +773,65 @@ add_cov_to_cvec(cligen_handle h,
     //    if (co->co_show)
     //	cv->var_show = strdup4(co->co_show);
     /* If translator function defined, here translate value */
-    if (co->co_translate_fn != NULL &&
-	co->co_translate_fn(h, cv) < 0)
-	return NULL;
+    if (co->co_translate_fn != NULL){
+	if ((tr = cligen_trace_rec(h)) == NULL)
+	    ret = co->co_translate_fn(h, cv);
+	else{
+	    t = cligen_stats_ns();
+	    ret = co->co_translate_fn(h, cv);
+	    cligen_trace_phase(tr, CT_TRANSLATE, t);
+	}
+	if (ret < 0)
+	    return NULL;
+    }
     return cv;
 }
 
 /*! Append int vector with one index
+ * The vector is doubled in the arena when full, old space is released with the arena
  */
 static int
 mr_vec_append(match_result *mr,
 	      int           index)
 {
-    int retval = -1;
+    int      retval = -1;
+    int     *vec;
+    uint32_t size;
 
     if (mr->mr_size <= mr->mr_len){ /* need increased size */
-	if ((mr->mr_vec = realloc(mr->mr_vec, (mr->mr_len+1)*sizeof(int))) == NULL)
+	size = mr->mr_size ? 2*mr->mr_size : 4;
+	if ((vec = cligen_arena_alloc(mr->mr_arena, size*sizeof(int))) == NULL)
 	    goto done;
+	if (mr->mr_len)
+	    memcpy(vec, mr->mr_vec, mr->mr_len*sizeof(int));
+	mr->mr_vec = vec;
+	mr->mr_size = size;
     }
     mr->mr_vec[mr->mr_len++] = index;
-    mr->mr_size = mr->mr_len;
     retval = 0;
  done:
     return retval;
 }
 
+/*! Sort matchvec in vector order
+ * Insertion sort, there are usually few matches
+ * @param[in,out]  mr  Match result struct
+ */
+static void
+mr_vec_sort(match_result *mr)
+{
+    int      i;
+    uint32_t j;
+    uint32_t k;
+
+    for (k=1; k<mr->mr_len; k++){
+	i = mr->mr_vec[k];
+	for (j=k; j>0 && mr->mr_vec[j-1] > i; j--)
+	    mr->mr_vec[j] = mr->mr_vec[j-1];
+	mr->mr_vec[j] = i;
+    }
+}
+
 /*! Reset/empty matchvec of indexes by g and incrementing vector
  * @param[in,out]  mr  Match result struct
  */
@@ -635,36 +882,333 @@ mr_mv_reason(match_result *from,
     return 0;
 }
 
+/*! Create a match result in the handle arena
+ * @param[in]  h   CLIgen handle
+ */
 static match_result *
-mr_new(void)
+mr_new(cligen_handle h)
 {
     match_result *mr;
-    
-    if ((mr = malloc(sizeof(*mr))) == NULL)
+    cligen_arena *ca;
+
+    ca = cligen_handle_arena(h);
+    if ((mr = cligen_arena_alloc(ca, sizeof(*mr))) == NULL)
 	return NULL;
-    memset(mr, 0, sizeof(*mr));
+    mr->mr_arena = ca;
     return mr;
 }
 
 /*! Free a return structure
  * Dont free the parse tree mr_parsetree
+ * The struct itself and mr_vec are released with the arena
  */
 static int
 mr_free(match_result *mr)
 {
-    if (mr->mr_vec)
-	free(mr->mr_vec);
-    if (mr->mr_reason)
+    if (mr->mr_reason){
 	free(mr->mr_reason);
-    free(mr);
+	mr->mr_reason = NULL;
+    }
+    return 0;
+}
+
+/*! One level of the matched path of the latest completion
+ * Entry i is the non-last token i+1 and the expanded children of the object it matched
+ */
+struct match_level {
+    char       *ml_token;  /* Token matched at this level */
+    parse_tree *ml_pt;     /* Expanded children of the matched object, owned by cache */
+    char       *ml_filter; /* Expand values of ml_pt start with this next token, or NULL */
+    cvec       *ml_cvv;    /* Variables bound when matching the token */
+};
+
+/*! Matched path of the latest completed line, see match_cache_resume
+ * Only used in TAB/? completion of the active tree, dropped when the line 
+ * is done or when a parse-tree changes.
+ */
+struct match_cache {
+    parse_tree         *mc_root;   /* Active (unexpanded) parse-tree */
+    int                 mc_gen;    /* ch_tree_gen of handle when cached */
+    int                 mc_record; /* Append matched levels in this match_pattern call */
+    int                 mc_len;    /* Number of cached levels */
+    int                 mc_max;    /* Allocated levels */
+    struct match_level *mc_vec;    /* Vector of levels */
+};
+
+/*! Remove all cached levels from len and deeper
+ */
+static int
+match_cache_truncate(struct match_cache *mc,
+		     int                 len)
+{
+    struct match_level *ml;
+
+    while (mc->mc_len > len){
+	ml = &mc->mc_vec[--mc->mc_len];
+	if (ml->ml_token)
+	    free(ml->ml_token);
+	if (ml->ml_filter)
+	    free(ml->ml_filter);
+	if (ml->ml_pt)
+	    pt_free(ml->ml_pt, 0);
+	if (ml->ml_cvv)
+	    cvec_free(ml->ml_cvv);
+	memset(ml, 0, sizeof(*ml));
+    }
+    return 0;
+}
+
+/*! Free the completion match cache
+ * Called when a line is done and when tree references are invalidated since
+ * the cached levels reference objects of the original parse-trees.
+ * @param[in]  h   CLIgen handle
+ * @retval     0   OK
+ */
+int
+match_cache_flush(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    struct match_cache   *mc;
+
+    if ((mc = ch->ch_match_cache) != NULL){
+	match_cache_truncate(mc, 0);
+	if (mc->mc_vec)
+	    free(mc->mc_vec);
+	free(mc);
+	ch->ch_match_cache = NULL;
+    }
+    return 0;
+}
+
+/*! Check if a parse-tree is owned by the completion match cache
+ * A ptmatch returned by match_pattern may be a cached level, it must then not be freed
+ * @param[in]  h   CLIgen handle
+ * @param[in]  pt  Parse-tree
+ * @retval     1   pt is cached, do not free
+ * @retval     0   pt is not cached
+ */
+int
+match_cache_pt(cligen_handle h,
+	       parse_tree   *pt)
+{
+    struct match_cache *mc;
+    int                 i;
+
+    if ((mc = handle(h)->ch_match_cache) != NULL)
+	for (i=0; i<mc->mc_len; i++)
+	    if (mc->mc_vec[i].ml_pt == pt)
+		return 1;
     return 0;
 }
 
-/*! Match a parse-tree (pt) with a command vector (cvt/cvr)
+/*! Check if a parse-tree level has variables with expand callbacks
+ * Levels expanded from them are only cached if expand results are, otherwise the
+ * callbacks are called again on each completion, see cligen_expand_cache_set
+ * @param[in]  pt  Parse-tree level, not expanded
+ */
+static int
+match_cache_expandv(parse_tree *pt)
+{
+    cg_obj *co;
+    int     i;
+
+    for (i=0; i<pt_len_get(pt); i++)
+	if ((co = pt_vec_i_get(pt, i)) != NULL &&
+	    co->co_type == CO_VARIABLE && co->co_expandv_fn != NULL)
+	    return 1;
+    return 0;
+}
+
+/*! Append a matched level to the cache, the cache takes ownership of pt
+ * @param[in]  mc      Match cache
+ * @param[in]  token   Token matched at this level
+ * @param[in]  pt      Expanded children of matched object
+ * @param[in]  filter  Prefix the expand values of pt were filtered with, or NULL
+ * @param[in]  cvv     Variable vector, variables from cvvlen were bound by this token
+ * @param[in]  cvvlen  Length of cvv before the token was matched
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+static int
+match_cache_push(struct match_cache *mc,
+		 char               *token,
+		 parse_tree         *pt,
+		 char               *filter,
+		 cvec               *cvv,
+		 int                 cvvlen)
+{
+    struct match_level *ml;
+    int                 max;
+    int                 i;
+
+    if (mc->mc_len == mc->mc_max){
+	max = mc->mc_max?2*mc->mc_max:8;
+	if ((ml = realloc(mc->mc_vec, max*sizeof(*ml))) == NULL)
+	    return -1;
+	mc->mc_vec = ml;
+	mc->mc_max = max;
+    }
+    ml = &mc->mc_vec[mc->mc_len];
+    memset(ml, 0, sizeof(*ml));
+    if ((ml->ml_token = strdup(token)) == NULL)
+	goto err;
+    if (filter && (ml->ml_filter = strdup(filter)) == NULL)
+	goto err;
+    if ((ml->ml_cvv = cvec_new(0)) == NULL)
+	goto err;
+    for (i=cvvlen; i<cvec_len(cvv); i++)
+	if (cvec_append_var(ml->ml_cvv, cvec_i(cvv, i)) == NULL)
+	    goto err;
+    ml->ml_pt = pt;
+    mc->mc_len++;
+    return 0;
+ err:
+    if (ml->ml_token)
+	free(ml->ml_token);
+    if (ml->ml_filter)
+	free(ml->ml_filter);
+    if (ml->ml_cvv)
+	cvec_free(ml->ml_cvv);
+    memset(ml, 0, sizeof(*ml));
+    return -1;
+}
+
+/*! Find the deepest cached level that can be reused when completing a line
+ *
+ * Levels are reused as long as their tokens are unchanged, the first modified token
+ * and all levels after it are removed. A level whose expand values were filtered by the
+ * next token is also removed if the next token no longer starts with the filter. Variables bound by reused levels are appended to
+ * cvv as if they were matched again. The levels matched after the resumed level are
+ * then appended to the cache by match_pattern_sets.
+ * @param[in]  h      CLIgen handle
+ * @param[in]  ct     Tokenized string
+ * @param[in]  cvv    Variable vector for completion
+ * @param[out] ptp    Expanded parse-tree to continue matching in (if retval > 0)
+ * @retval     n      Number of reused levels, ie the level to continue matching at
+ * @retval    -1      Error
+ */
+static int
+match_cache_resume(cligen_handle  h,
+		   cligen_tokens *ct,
+		   cvec         *cvv,
+		   parse_tree  **ptp)
+{
+    struct cligen_handle *ch = handle(h);
+    struct match_cache   *mc;
+    parse_tree           *root;
+    struct match_level   *ml;
+    cg_var               *cv;
+    char                 *token;
+    int                   levels;
+    int                   i;
+
+    *ptp = NULL;
+    if (!ch->ch_completing || cvv == NULL)
+	return 0;
+    root = cligen_ph_active_get(h);
+    if ((mc = ch->ch_match_cache) != NULL &&
+	(mc->mc_root != root || mc->mc_gen != ch->ch_tree_gen)){
+	match_cache_flush(h);
+	mc = NULL;
+    }
+    if (mc == NULL){
+	if ((mc = calloc(1, sizeof(*mc))) == NULL)
+	    return -1;
+	mc->mc_root = root;
+	mc->mc_gen = ch->ch_tree_gen;
+	ch->ch_match_cache = mc;
+    }
+    /* The last token is always matched, the line may be modified before it */
+    levels = cligen_tokens_levels(ct);
+    for (i=0; i<mc->mc_len && i<levels; i++){
+	ml = &mc->mc_vec[i];
+	if (strcmp(ml->ml_token, cligen_tokens_i(ct, i+1)) != 0)
+	    break;
+	if (ml->ml_filter &&
+	    ((token = cligen_tokens_i(ct, i+2)) == NULL ||
+	     strncmp(token, ml->ml_filter, strlen(ml->ml_filter)) != 0))
+	    break;
+    }
+    match_cache_truncate(mc, i);
+    for (i=0; i<mc->mc_len; i++){
+	cv = NULL;
+	while ((cv = cvec_each(mc->mc_vec[i].ml_cvv, cv)) != NULL)
+	    if (cvec_append_var(cvv, cv) == NULL)
+		return -1;
+    }
+    mc->mc_record = 1;
+    if (mc->mc_len)
+	*ptp = mc->mc_vec[mc->mc_len-1].ml_pt;
+    cligen_stats_add(h, cs_match_resume, mc->mc_len);
+    return mc->mc_len;
+}
+
+/*! Position of the k:th candidate given by the keyword index, see pt_index_lookup
+ * Commands with the token as prefix are first, followed by non-indexed children
+ */
+static inline int
+match_pir_pos(pt_index_range *pir,
+	      int             k)
+{
+    return k < pir->pir_cmdlen ? pir->pir_cmdvec[k] : pir->pir_othervec[k - pir->pir_cmdlen];
+}
+
+/*! Order candidates of a parse-tree level for a best match
+ *
+ * Commands and references are first, followed by variables in falling preference,
+ * and in vector order if equal. The scan can stop at the first variable with lower
+ * preference than the best match.
+ * @param[in]  pt     Parse tree
+ * @param[in]  pir    Candidates given by keyword index, or NULL for all of pt
+ * @param[in,out] lenp In: number of candidates. Out: length of ovec
+ * @param[in]  ca     Arena where the vector is allocated
+ * @retval     ovec   Vector of positions, empty positions are left out
+ * @retval     NULL   Error
+ * @see co_pref
+ */
+static int *
+match_vec_order(parse_tree     *pt,
+		pt_index_range *pir,
+		int            *lenp,
+		cligen_arena   *ca)
+{
+    int    *ovec;
+    int     ilen = *lenp;
+    int     n = 0;
+    int     nvar;
+    int     i;
+    int     j;
+    int     k;
+    cg_obj *co;
+
+    if ((ovec = cligen_arena_alloc(ca, (ilen+1)*sizeof(int))) == NULL)
+	return NULL;
+    for (k=0; k<ilen; k++){
+	i = pir ? match_pir_pos(pir, k) : k;
+	if ((co = pt_vec_i_get(pt, i)) != NULL && co->co_type != CO_VARIABLE)
+	    ovec[n++] = i;
+    }
+    nvar = n;
+    /* Insertion sort of variables, there are usually few on a level */
+    for (k=0; k<ilen; k++){
+	i = pir ? match_pir_pos(pir, k) : k;
+	if ((co = pt_vec_i_get(pt, i)) == NULL || co->co_type != CO_VARIABLE)
+	    continue;
+	for (j=n; j>nvar && pt_vec_i_get(pt, ovec[j-1])->co_vpref < co->co_vpref; j--)
+	    ovec[j] = ovec[j-1];
+	ovec[j] = i;
+	n++;
+    }
+    *lenp = n;
+    return ovec;
+}
+
+/*! Match a parse-tree (pt) with a token
  * @param[in]  h        CLIgen handle
+ * @param[in]  pt       Vector of commands (array of cligen object pointers (cg_obj)
+ * @param[in]  matched  Positions of pt already matched if pt is a set, or NULL
  * @param[in]  token    Token to match at this level
  * @param[in]  resttokens Rest of tokens at this level (special case if type is REST)
- * @param[in]  pt       Vector of commands (array of cligen object pointers (cg_obj)
  * @param[in]  best     Only return best match (for command evaluation) instead of 
  *                      all possible options
  * @param[out] mr       Match result, when retval = 0
@@ -674,6 +1218,7 @@ mr_free(match_result *mr)
 static int
 match_vec(cligen_handle h,
 	  parse_tree   *pt,
+	  uint64_t     *matched,
 	  char         *token,
 	  char         *resttokens,
 	  int           best,
@@ -688,26 +1233,72 @@ match_vec(cligen_handle h,
     int     i;
     cg_obj *co;
     int     match;
+    pt_index_range pir;    /* Candidates given by keyword index */
+    int     ilen;
+    int     ii;
+    int     indexed;
+    int     want;          /* Reason of a nomatch may be reported */
+    cv_token_class tc;     /* Token is scanned once for all typed variables */
+    int    *ovec = NULL;   /* Candidates in preference order, see match_vec_order */
 
+    cv_token_class_init(&tc, token);
+    /* On set levels, a keyword equal to the token that is not already matched is
+     * the best match, also if the token is a prefix of other keywords of the set.
+     */
+    if (best && pt_sets_get(pt)){
+	if ((match = pt_index_exact(pt, token, &i)) < 0)
+	    goto done;
+	if (match && !matched_get(matched, i)){
+	    co = pt_vec_i_get(pt, i);
+	    if ((match = match_object(h, token, co, best, &exact, &tc, NULL)) < 0)
+		goto done;
+	    if (match && exact){
+		if (mr_vec_append(mr, i) < 0)
+		    goto done;
+		mr_reason_set(mr, NULL);
+		retval = 0;
+		goto done;
+	    }
+	}
+    }
+    /* On large levels, use keyword index to skip commands that cannot match */
+    if ((indexed = pt_index_lookup(pt, token, &pir)) < 0)
+	goto done;
+    ilen = indexed ? pir.pir_cmdlen + pir.pir_otherlen : pt_len_get(pt);
+    /* When only the best match is returned, visit variables last in falling preference */
+    if (best && matched == NULL &&
+	(ovec = match_vec_order(pt, indexed ? &pir : NULL, &ilen, mr->mr_arena)) == NULL)
+	goto done;
     /* Loop through parse-tree at this level to find matches */
-    for (i=0; i<pt_len_get(pt); i++){
+    for (ii=0; ii<ilen; ii++){
+	i = ovec ? ovec[ii] : indexed ? match_pir_pos(&pir, ii) : ii;
 	if ((co = pt_vec_i_get(pt, i)) == NULL)
 	    continue;
+	/* Remaining variables have lower preference than a match: none can be best */
+	if (ovec && co->co_type == CO_VARIABLE && co->co_vpref < pref_upper)
+	    break;
+	/* Only a variable with lower preference than earlier nomatches may
+	 * report its reason, do not format it otherwise. Preference of a variable
+	 * does not depend on exact.
+	 */
+	want = (co->co_type == CO_VARIABLE && co->co_vpref < pref_lower);
 	/* Return -1: error, 0: nomatch, 1: match */
 	tmpreason = NULL;
 	if ((match = match_object(h,
 				  ISREST(co)?resttokens:token,
 				  co, best, &exact,
-				  &tmpreason      /* if match == 0 */
+				  ISREST(co)?NULL:&tc,
+				  want?&tmpreason:NULL /* if match == 0 */
 				  )) < 0)
 	    goto done;
-	p = co_pref(co, exact); /* get match preferences (higher is better match) */
+	/* get match preferences (higher is better match) */
+	p = co_pref_shadow(co, exact, pt_borrow_get(pt) == 1);
 	if (match == 0){ /* No match */
-	    assert(tmpreason != NULL);
+	    assert(!want || tmpreason != NULL);
 	    /* If all fails, save lowest(widest) preference error message,
 	     * for variables only
 	     */
-	    if (p < pref_lower && co->co_type == CO_VARIABLE){
+	    if (want){
 		pref_lower = p;
 		mr_reason_set(mr, tmpreason);
 		tmpreason = NULL;
@@ -719,7 +1310,7 @@ match_vec(cligen_handle h,
 	}
 #if 1
 	/* An alternative is to sort away these after the call in match_pattern_sets_local */
-	else if (co_flags_get(co, CO_FLAGS_MATCH)){
+	else if (matched_get(matched, i)){
 	    p = 1; /* XXX lower than any variables*/
 	    if (p < pref_lower){
 		char *r;
@@ -757,6 +1348,9 @@ match_vec(cligen_handle h,
     /* Only return reason if matches == 0 */
     if (mr->mr_len != 0)
 	mr_reason_set(mr, NULL);
+    /* Candidates of the index are in keyword order, return matches in vector order */
+    if (indexed)
+	mr_vec_sort(mr);
     retval = 0;
  done:
     return retval;
@@ -781,7 +1375,7 @@ match_bindvars(cligen_handle h,
     cg_obj *co_orig;
 
     /* co_orig is original object in case of expansion */
-    co_orig = co->co_ref?co->co_ref: co;
+    co_orig = co_ref_get(co)?co_ref_get(co): co;
     if (co->co_type == CO_VARIABLE){
 	if (add_cov_to_cvec(h, co, token, cvv) == NULL)
 	    goto done;
@@ -795,8 +1389,8 @@ match_bindvars(cligen_handle h,
 		goto done;
     }
     else{
-	if (!cv_exclude_keys_get() && cvvall){
-	    if ((cv = cvec_add(cvvall, co_orig->co_vtype)) == NULL)
+	if (!cligen_exclude_keys(h) && cvvall){
+	    if ((cv = cvec_add(cvvall, CGV_STRING)) == NULL)
 		goto done;
 	    cv_name_set(cv, co_orig->co_command);
 	    cv_type_set(cv, CGV_STRING);
@@ -809,21 +1403,12 @@ match_bindvars(cligen_handle h,
     return retval;
 }
 
-static int
-co_clearflag(cg_obj *co,
-	     void   *arg)
-{
-    co_flags_reset(co, (intptr_t)arg);
-    return 0;
-}
-
 /*! Matchpattern sets local
  *
  * @param[in]     h         CLIgen handle
- * @param[in]     cvt       Tokenized string: vector of tokens
- * @param[in]     cvr       Rest variant,  eg remaining string in each step
+ * @param[in]     ct        Tokenized string, tokens and remaining string in each step
  * @param[in]     pt        Vector of commands. Array of cligen object pointers
- * @param[in]     pt_max    Length of the pt array
+ * @param[in]     matched   Positions of pt already matched if pt is a set, or NULL
  * @param[in]     level     Current command level
  * @param[in]     best      Only return best match (for command evaluation) instead of 
  *                          all possible options. Only called from match_pattern_exact()
@@ -835,9 +1420,9 @@ co_clearflag(cg_obj *co,
  */
 static int 
 match_pattern_sets_local(cligen_handle h, 
-			 cvec         *cvt,
-			 cvec         *cvr,
+			 cligen_tokens *ct,
 			 parse_tree   *pt,
+			 uint64_t     *matched,
 			 int           level,
 			 int           best,
 			 cvec         *cvv,
@@ -852,20 +1437,20 @@ match_pattern_sets_local(cligen_handle h,
     char       *resttokens;
     match_result *mr0 = NULL;
 
-    if ((mr0 = mr_new()) == NULL)
+    if ((mr0 = mr_new(h)) == NULL)
 	goto done;
     /* Tokens of this level */
-    token = cvec_i_str(cvt, level+1);
+    token = cligen_tokens_i(ct, level+1);
     /* Is this last token? */
-    lasttoken = last_level(cvt, level); 
-    resttokens  = cvec_i_str(cvr, level+1);
+    lasttoken = last_level(ct, level); 
+    resttokens  = cligen_tokens_rest(ct, level+1);
     
     /* Return level at this point, can be overriden by recursive call */
     mr0->mr_level = level;
 
-    /* How many matches of cvt[level+1] in pt */
+    /* How many matches of token in pt */
     if (match_vec(h,
-		  pt, token, resttokens,
+		  pt, matched, token, resttokens,
 		  lasttoken?best:1, /* use best preference match in non-terminal matching*/
 		   mr0) < 0)
 	goto done;
@@ -902,10 +1487,10 @@ match_pattern_sets_local(cligen_handle h,
     /* Get the single match object */
     co_match = pt_vec_i_get(pt, mr0->mr_vec[0]);
     /* co_orig is original object in case of expansion */
-    co_orig = co_match->co_ref?co_match->co_ref: co_match;
+    co_orig = co_ref_get(co_match)?co_ref_get(co_match): co_match;
 
     /* Already matched (sets functionality) */
-    if (co_flags_get(co_match, CO_FLAGS_MATCH)){ /* XXX: orig?? */
+    if (matched_get(matched, mr0->mr_vec[0])){
 	char *r;
 	if ((r = strdup("Already matched")) == NULL)
 	    goto done;
@@ -942,9 +1527,12 @@ match_pattern_sets_local(cligen_handle h,
     case 1:
 	assert(co_match);
 	if (co_match->co_type == CO_COMMAND &&
-	    co_orig && co_orig->co_type == CO_VARIABLE)
-	    if (co_value_set(co_orig, co_match->co_command) < 0)
+	    co_orig && co_orig->co_type == CO_VARIABLE){
+	    /* A frozen original is shared, keep value in the expanded object */
+	    if (co_value_set(co_flags_get(co_orig, CO_FLAGS_FROZEN)?co_match:co_orig,
+			     co_match->co_command) < 0)
 		goto done;
+	}
 	break;
     default:
 	break;
@@ -969,10 +1557,10 @@ match_pattern_sets_local(cligen_handle h,
 /*! Matchpattern sets
  *
  * @param[in]     h         CLIgen handle
- * @param[in]     cvt       Tokenized string: vector of tokens
- * @param[in]     cvr       Rest variant,  eg remaining string in each step
+ * @param[in]     ct        Tokenized string, tokens and remaining string in each step
  * @param[in]     pt        Vector of commands. Array of cligen object pointers
- * @param[in]     pt_max    Length of the pt array
+ * @param[in,out] matched   Positions of pt already matched if pt is a set, or NULL.
+ *                          The matched position is added.
  * @param[in]     level     Current command level
  * @param[in]     best      If set, only return best match (for command evaluation) instead of 
  *                          all possible options. Match also hidden options.
@@ -986,9 +1574,9 @@ match_pattern_sets_local(cligen_handle h,
  */
 static int 
 match_pattern_sets(cligen_handle h, 
-		   cvec         *cvt,
-		   cvec         *cvr,
+		   cligen_tokens *ct,
 		   parse_tree   *pt,
+		   uint64_t     *matched,
 		   int           level,
 		   int           best,
 		   cvec         *cvv,
@@ -998,17 +1586,26 @@ match_pattern_sets(cligen_handle h,
     int           retval = -1;
     match_result *mr0 = NULL; /* Local */
     parse_tree   *ptn = NULL;   /* Expanded */
+    uint64_t     *matchedn = NULL; /* Positions of ptn matched, if it is a set */
     cg_obj       *co_match;
+    int           i_match;
     int           lastsyntax = 0;
     match_result *mrc = NULL; /* child result */
     match_result *mrcprev = NULL; /* previous succesful result */
     char         *token;
+    char         *filter;
+    struct match_cache *mc;
+    int           cvvlen;
+    int           pending;
+    int           cached = 0; /* ptn is owned by match cache */
 
-    token = cvec_i_str(cvt, level+1); /* for debugging */
+    token = cligen_tokens_i(ct, level+1); /* for debugging */
+    mc = handle(h)->ch_match_cache;
+    cvvlen = cvv?cvec_len(cvv):0;
     if (0)
 	fprintf(stderr, "%s %s\n", __FUNCTION__, token);
     /* Match the current token */
-    if (match_pattern_sets_local(h, cvt, cvr, pt, level, best, 
+    if (match_pattern_sets_local(h, ct, pt, matched, level, best, 
 				 cvv, cvvall, &mr0) < 0)
 	goto done;
     if (mr0->mr_len != 1){ /* If not unique match exit here */
@@ -1017,9 +1614,10 @@ match_pattern_sets(cligen_handle h,
 	goto ok;
     }
     /* Unique match */
-    co_match = pt_vec_i_get(pt, mr0->mr_vec[0]);
+    i_match = mr0->mr_vec[0];
+    co_match = pt_vec_i_get(pt, i_match);
     if (mr0->mr_last && (strcmp(token,"") != 0)){
-	co_flags_set(co_match, CO_FLAGS_MATCH);
+	matched_set(matched, i_match);
 	*mrp = mr0;
 	mr0 = NULL;
 	goto ok;
@@ -1028,11 +1626,20 @@ match_pattern_sets(cligen_handle h,
 	goto done;
     if ((ptn = pt_new()) == NULL)
 	goto done;
-    if (pt_expand(h, co_pt_get(co_match), cvv,
-		  !best,  /* If best is set, include hidden commands, otherwise do not */
-		  1,      /* VARS are expanded, eg ? <tab> */
-		  ptn) < 0) /* expand/choice variables */
+    pending = handle(h)->ch_expand_pending;
+    /* Only expand values that may match the next token */
+    filter = cligen_tokens_i(ct, level+2);
+    if (pt_expand_match(h, co_pt_get(co_match), cvv,
+			!best,  /* If best is set, include hidden commands, otherwise do not */
+			1,      /* VARS are expanded, eg ? <tab> */
+			filter,
+			ptn) < 0) /* expand/choice variables */
 	goto done;
+    /* Partial expand results are not cached, nor results of expand callbacks unless
+     * they are cached themselves */
+    if (mc && (handle(h)->ch_expand_pending != pending ||
+	       (cligen_expand_cache(h) == 0 && match_cache_expandv(co_pt_get(co_match)))))
+	mc->mc_record = 0;
     /* Check termination criteria */
     lastsyntax = last_pt(ptn); /* 0, 1 or 2 */
     switch (lastsyntax){
@@ -1040,7 +1647,7 @@ match_pattern_sets(cligen_handle h,
 	break;
     case 1: /* Last in syntax tree (not token) */
 	mr_parsetree_set(mr0, pt);
-	co_flags_set(co_match, CO_FLAGS_MATCH);
+	matched_set(matched, i_match);
 	*mrp = mr0;
 	mr0 = NULL;
 	goto ok;
@@ -1049,10 +1656,15 @@ match_pattern_sets(cligen_handle h,
 	break;
     }
     if (pt_sets_get(ptn)){ /* For sets, iterate */
-	while (!last_level(cvt, level)){
+	if (mc)
+	    mc->mc_record = 0; /* Sets levels depend on matched positions */
+	if ((matchedn = cligen_arena_alloc(cligen_handle_arena(h),
+					   MATCHED_WORDS(pt_len_get(ptn))*sizeof(uint64_t))) == NULL)
+	    goto done;
+	while (!last_level(ct, level)){
 	    if (mrc != NULL)
 		mrc = NULL;
-	    if (match_pattern_sets(h, cvt, cvr, ptn,
+	    if (match_pattern_sets(h, ct, ptn, matchedn,
 				   level+1,
 				   best, 
 				   cvv,
@@ -1078,12 +1690,18 @@ match_pattern_sets(cligen_handle h,
 	}
     }
     else{
-	if (last_level(cvt, level)){
+	if (last_level(ct, level)){
 	    *mrp = mr0;
 	    mr0 = NULL;
 	    goto ok;    
 	}
-	else if (match_pattern_sets(h, cvt, cvr, ptn,
+	if (mc && mc->mc_record && level == mc->mc_len){
+	    if (match_cache_push(mc, token, ptn,
+				 filter && *filter ? filter : NULL, cvv, cvvlen) < 0)
+		goto done;
+	    cached = 1;
+	}
+	if (match_pattern_sets(h, ct, ptn, NULL,
 				    level+1, 
 				    best, 
 				    cvv,
@@ -1092,27 +1710,25 @@ match_pattern_sets(cligen_handle h,
 	    goto done;
     }
     assert(mrc != NULL);
-    /* Clear all CO_FLAGS_MATCH recursively */
-    pt_apply(ptn, co_clearflag, (void*)CO_FLAGS_MATCH);
     /* If child match fails, use previous */
     if (mrc->mr_len == 0 && mrcprev){
-	/* Transfer match flags from ptn to pt if this tree has no more matches */
+	/* Mark the match in pt if this tree has no more matches */
 	if (mrc->mr_len == 0)
-	    co_flags_set(co_match, CO_FLAGS_MATCH);	    
+	    matched_set(matched, i_match);
 	mr_mv_reason(mrc, mrcprev); 	/* transfer error reason if any from child */
 	*mrp = mrcprev;
 	mrcprev = NULL;
     }
     else if (mrc->mr_len == 0 && lastsyntax == 2){ /* If no child match, then use local */
 	mr_parsetree_set(mr0, pt);
-	co_flags_set(co_match, CO_FLAGS_MATCH);
+	matched_set(matched, i_match);
 	mr_mv_reason(mrc, mr0); 	/* transfer error reason if any from child */
 	*mrp = mr0;
 	mr0 = NULL;
     }
     else{ /* child match,  use that */
 	if (mrc->mr_len == 1)
-	    co_flags_set(co_match, CO_FLAGS_MATCH);
+	    matched_set(matched, i_match);
 	*mrp = mrc;
 	if (mrcprev == mrc)
 	    mrcprev = NULL;
@@ -1133,7 +1749,7 @@ match_pattern_sets(cligen_handle h,
 	    pt_free(mrcprev->mr_parsetree, 0);
 	mr_free(mrcprev);
     }
-    if (ptn)
+    if (ptn && !cached)
 	pt_free(ptn, 0);
     if (mrc)
 	mr_free(mrc);
@@ -1145,8 +1761,7 @@ match_pattern_sets(cligen_handle h,
 /*! CLIgen object matching function
  * @param[in]  h         CLIgen handle
  * @param[in]  string    Input string to match
- * @param[in]  cvt       Tokenized string: vector of tokens
- * @param[in]  cvr       Rest variant,  eg remaining string in each step
+ * @param[in]  ct        Tokenized string, tokens and remaining string in each step
  * @param[in]  pt        Vector of commands (array of cligen object pointers (cg_obj)
  * @param[in]  best      If set, only return best match (for command evaluation) instead of 
  *                       all possible options. Match also hidden options.
@@ -1166,8 +1781,7 @@ match_pattern_sets(cligen_handle h,
  */
 int 
 match_pattern(cligen_handle h,
-	      cvec         *cvt,
-	      cvec         *cvr,
+	      cligen_tokens *ct,
 	      parse_tree   *pt, 
 	      int           best,
 	      parse_tree  **ptmatch, 
@@ -1177,27 +1791,35 @@ match_pattern(cligen_handle h,
 	      cvec         *cvvall,
 	      char        **reasonp)
 {
-    int           retval = -1;
-    match_result *mr = NULL;
-    
-    if (ptmatch == NULL || cvt == NULL || cvr == NULL || matchvec == NULL || matchlen == NULL){
+    int               retval = -1;
+    match_result     *mr = NULL;
+    cligen_arena_mark mark;
+    parse_tree       *ptr = NULL; /* Resume at this cached level */
+    int               level = 0;
+    struct match_cache *mc;
+
+    if (ptmatch == NULL || ct == NULL || matchvec == NULL || matchlen == NULL){
 	errno = EINVAL;
-	goto done;
+	return -1;
     }
     *matchlen = 0;
-
-    if (match_pattern_sets(h, cvt, cvr,
-			   pt,
-			   0,
+    /* All match results are allocated after this mark and released on return */
+    cligen_arena_mark_get(cligen_handle_arena(h), &mark);
+    /* In completion, continue after the unchanged tokens of the previous TAB/? */
+    if (!best && cvvall == NULL &&
+	(level = match_cache_resume(h, ct, cvv, &ptr)) < 0)
+	goto done;
+    if (match_pattern_sets(h, ct,
+			   ptr?ptr:pt,
+			   NULL,
+			   level,
 			   best, 
 			   cvv, cvvall,
 			   &mr) < 0)
 	goto done;
-    /* Clear all CO_FLAGS_MATCH recursively */
-    pt_apply(pt, co_clearflag, (void*)CO_FLAGS_MATCH);
 #if 1 /* XXX: should move up to callers? */
     if (mr){
-	if (!last_level(cvt, mr->mr_level)){
+	if (!last_level(ct, mr->mr_level)){
 	    cg_obj *co_match;
 	    char *r;
 	    if (mr->mr_len == 1){
@@ -1221,26 +1843,33 @@ match_pattern(cligen_handle h,
 	    }
 	}
 	*ptmatch = mr->mr_parsetree;
-	*matchvec = mr->mr_vec;
+	/* Copy vector out of arena to caller */
+	if (mr->mr_len){
+	    if ((*matchvec = malloc(mr->mr_len*sizeof(int))) == NULL)
+		goto done;
+	    memcpy(*matchvec, mr->mr_vec, mr->mr_len*sizeof(int));
+	}
 	*matchlen = mr->mr_len;
 	if (reasonp){
 	    *reasonp = mr->mr_reason;
 	}
 	else if (mr->mr_reason)
 	    free(mr->mr_reason);
-	free(mr);
+	mr->mr_reason = NULL;
     }
 #endif
     retval = 0;
  done:
+    if ((mc = handle(h)->ch_match_cache) != NULL)
+	mc->mc_record = 0;
+    cligen_arena_release(cligen_handle_arena(h), &mark);
     return retval;
 } /* match_pattern */
 
 /*! CLIgen object matching function for exact match
  * @param[in]  h         CLIgen handle
  * @param[in]  string    Input string to match
- * @param[in]  cvt       Tokenized string: vector of tokens
- * @param[in]  cvr       Rest variant,  eg remaining string in each step
+ * @param[in]  ct        Tokenized string, tokens and remaining string in each step
  * @param[in]  pt        CLIgen parse tree, vector of cligen objects.
  * @param[out] cvv       CLIgen variable vector containing vars for matching path
  * @param[out] cvvall    CLIgen variable vector containing vars and constants for matching vars
@@ -1254,8 +1883,7 @@ match_pattern(cligen_handle h,
  */
 int 
 match_pattern_exact(cligen_handle  h, 
-		    cvec          *cvt,
-		    cvec          *cvr,
+		    cligen_tokens *ct,
 		    parse_tree    *pt, 
 		    cvec          *cvv,
 		    cvec          *cvvall,
@@ -1273,7 +1901,7 @@ match_pattern_exact(cligen_handle  h,
     parse_tree   *ptc;
 
     if ((match_pattern(h,
-		       cvt, cvr, /* token string */
+		       ct,       /* token string */
 		       pt,       /* command vector */
 		       1,        /* best: Return only best option including hidden options */
 		       &ptmatch, 
@@ -1297,7 +1925,7 @@ match_pattern_exact(cligen_handle  h,
 	    int j;
 	    int allvars = 1;
 	    char *string1;
-	    string1 = cvec_i_str(cvt, cligen_cvv_levels(cvt)+1);
+	    string1 = cligen_tokens_i(ct, cligen_tokens_levels(ct)+1);
 	    for (j=0; j<matchlen; j++){
 		co = pt_vec_i_get(ptmatch,matchvec[j]);
 		/* XXX If variable dont compare co_command */
@@ -1396,8 +2024,7 @@ match_complete(cligen_handle h,
     int      minmatch;
     cg_obj  *co;
     cg_obj  *co1 = NULL;
-    cvec    *cvt = NULL;      /* Tokenized string: vector of tokens */
-    cvec    *cvr = NULL;      /* Rest variant,  eg remaining string in each step */
+    cligen_tokens *ct = NULL; /* Tokenized string: tokens and rests */
     char    *string;
     char    *s;
     char    *ss;
@@ -1410,14 +2037,14 @@ match_complete(cligen_handle h,
 
     /* ignore any leading whitespace */
     string = *stringp;
-    /* Tokenize the string and transform it into two CLIgen vectors: tokens and rests */
-    if (cligen_str2cvv(string, &cvt, &cvr) < 0)
+    /* Tokenize the string into tokens and rests */
+    if (cligen_str2tokens(string, &ct) < 0)
 	goto done;
     s = string;
     while ((strlen(s) > 0) && isblank(*s))
 	s++;
     matchlen = 0;
-    if (match_pattern(h, cvt, cvr,
+    if (match_pattern(h, ct,
 		      pt,
 		      0, /* best: Return all options, not only best, exclude hidden options */
 		      &ptmatch, 
@@ -1429,9 +2056,9 @@ match_complete(cligen_handle h,
 	retval = 0;
 	goto done; /*  No matches */
     }
-    if ((level = cligen_cvv_levels(cvt)) < 0)
+    if ((level = cligen_tokens_levels(ct)) < 0)
 	goto done;
-    ss = cvec_i_str(cvt, level+1);
+    ss = cligen_tokens_i(ct, level+1);
     slen = ss?strlen(ss):0;
 
     minmatch = slen;
@@ -1485,12 +2112,10 @@ match_complete(cligen_handle h,
     }
     retval = append?1:0;
   done:
-    if (ptmatch && pt != ptmatch)
+    if (ptmatch && pt != ptmatch && !match_cache_pt(h, ptmatch))
 	pt_free(ptmatch, 0);
-    if (cvt)
-	cvec_free(cvt);
-    if (cvr)
-	cvec_free(cvr);
+    if (ct)
+	cligen_tokens_free(ct);
     if (matchvec)
 	free(matchvec);
     return retval;
@@ -41,17 +41,23 @@
 /* Number of allowed matchings */
 #define MATCHVECTORLEN 1024
 
+/*
+ * Types
+ */
+/* Tokenized command line, see cligen_str2tokens */
+typedef struct cligen_tokens cligen_tokens;
+
 /*
  * Function Prototypes
  */
-int match_pattern(cligen_handle h, cvec *cvt, cvec *cvr, 
+int match_pattern(cligen_handle h, cligen_tokens *ct,
 		  parse_tree *pt,
 		  int best, 
 		  parse_tree  **ptmatch, 
 		  int *matchvec[], int *matchlen,
 		  cvec *cvv, cvec *cvvall,
 		  char **reasonp);
-int match_pattern_exact(cligen_handle h, cvec *cvt, cvec *cvr, 
+int match_pattern_exact(cligen_handle h, cligen_tokens *ct,
 			parse_tree    *pt,
 			cvec          *cvv,
 			cvec          *cvvall,
@@ -59,11 +65,20 @@ int match_pattern_exact(cligen_handle h, cvec *cvt, cvec *cvr,
 			parse_tree   **ptmatch,
 			cligen_result *result,
 			char         **reasonp);
+int cligen_str2tokens(char *string, cligen_tokens **ctp);
+int cligen_tokens_free(cligen_tokens *ct);
+int cligen_tokens_len(cligen_tokens *ct);
+char *cligen_tokens_i(cligen_tokens *ct, int i);
+char *cligen_tokens_rest(cligen_tokens *ct, int i);
+int cligen_tokens_trunc(cligen_tokens *ct, int len);
+int cligen_tokens_levels(cligen_tokens *ct);
 int cligen_str2cvv(char *string, cvec **cvp, cvec **cvr);
 int cligen_txt2cvv(char *str, cvec **cvp);
 int cligen_cvv_levels(cvec *cvv);
 int match_complete(cligen_handle h, parse_tree *pt,
 		   char **stringp, size_t *slen, cvec *cvec);
+int match_cache_flush(cligen_handle h);
+int match_cache_pt(cligen_handle h, parse_tree *pt);
 
 #endif /* _CLIGEN_MATCH_H */
 
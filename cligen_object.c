@@ -36,6 +36,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdarg.h>
 #include <inttypes.h>
@@ -56,6 +57,7 @@
 #endif /* HAVE_STRVERSCMP */
 #include <errno.h>
 #include "cligen_buf.h"
+#include "cligen_intern.h"
 #include "cligen_cv.h"
 #include "cligen_cvec.h"
 #include "cligen_parsetree.h"
@@ -66,6 +68,7 @@
 #include "cligen_parse.h"
 #include "cligen_handle.h"
 #include "cligen_getline.h"
+#include "cligen_stats_internal.h"
 
 /* Access macro */
 cg_obj* 
@@ -338,6 +341,27 @@ cov_pref(cg_obj *co)
     return pref;
 }
 
+/*! Compute and store the match preference of a cligen variable object
+ * The preference only depends on the variable spec: type, ranges and regexps.
+ * It is computed when the object is created, parsed or loaded from an image.
+ * Call this function if the type, ranges or regexps of a variable are changed
+ * afterwards.
+ * @param[in] co   Cligen variable object
+ * @retval    0    OK
+ * @retval   -1    Error, not a variable
+ * @see co_pref
+ */
+int
+cov_pref_update(cg_obj *co)
+{
+    if (co == NULL || co->co_type != CO_VARIABLE){
+	errno = EINVAL;
+	return -1;
+    }
+    co->co_vpref = cov_pref(co);
+    return 0;
+}
+
 /*! Assign a preference to a cligen object
  * @param[in]  co    cligen_object
  * @param[in]  exact if match was exact (only applies to CO_COMMAND)
@@ -348,22 +372,41 @@ cov_pref(cg_obj *co)
  * The preference is:
  * command > ip|mac > int > interface > string > expand > rest
  * 'expand' is a command with not exact match that is derived from a <expand> or <choice>
+ * The preference of a variable is precomputed, see cov_pref_update
  */
 int
 co_pref(cg_obj *co, 
 	int     exact)
+{
+    return co_pref_shadow(co, exact, 0);
+}
+
+/*! Assign a preference to a cligen object of a shadow parse-tree
+ * @param[in]  co       cligen_object
+ * @param[in]  exact    if match was exact (only applies to CO_COMMAND)
+ * @param[in]  borrowed co is borrowed from the original parse-tree, see pt_borrow_set
+ * @retval     pref     Preference: positive integer
+ *
+ * A borrowed command is preferred as a copy with co_ref set, so that lazy expansion
+ * gives the same preferences as copying all objects.
+ * @see co_pref
+ */
+int
+co_pref_shadow(cg_obj *co,
+	       int     exact,
+	       int     borrowed)
 {
     int pref = 0;;
 
     switch (co->co_type){
     case CO_COMMAND:
-	if (co->co_ref && !exact)
+	if ((co_ref_get(co) || borrowed) && !exact)
 	    pref = 3; /* expand */
 	else
 	    pref = 100;
 	break;
     case CO_VARIABLE:
-	pref = cov_pref(co);
+	pref = co->co_vpref;
 	break;
     case CO_REFERENCE: /* ? */
 	
@@ -372,15 +415,52 @@ co_pref(cg_obj *co,
     return pref;
 }
 
-/*! Just malloc a CLIgen object. No other allocations allowed */
+/*! Return size of a cligen object of a given type
+ * Only variables have space allocated for the variable spec
+ * @param[in]  type  Type of cligen object
+ * @retval     size  Number of bytes allocated for the object
+ */
+size_t
+co_size(enum cg_objtype type)
+{
+    if (type == CO_VARIABLE)
+	return sizeof(cg_obj);
+    return offsetof(cg_obj, u);
+}
+
+/*! Get the rarely used fields of a cligen object, allocate them if not present
+ * @param[in]  co   CLIgen object
+ * @retval     ext  Extension struct of the object
+ * @retval     NULL Error
+ * @see co_callbacks_get and other read access macros
+ */
+struct cg_obj_ext *
+co_ext_alloc(cg_obj *co)
+{
+    if (co->co_ext == NULL){
+	if ((co->co_ext = malloc(sizeof(*co->co_ext))) == NULL){
+	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	    return NULL;
+	}
+	memset(co->co_ext, 0, sizeof(*co->co_ext));
+    }
+    return co->co_ext;
+}
+
+/*! Just malloc a CLIgen object. No other allocations allowed 
+ * @param[in]  type  Type of object, the variable spec is only allocated for CO_VARIABLE
+ */
 cg_obj *
-co_new_only()
+co_new_only(enum cg_objtype type)
 {
     cg_obj *co;
+    size_t  size;
 
-    if ((co = malloc(sizeof(cg_obj))) == NULL)
+    size = co_size(type);
+    if ((co = malloc(size)) == NULL)
 	return NULL;
-    memset(co, 0, sizeof(cg_obj));
+    memset(co, 0, size);
+    co->co_type = type;
     return co;
 }
 
@@ -401,11 +481,10 @@ co_new(char   *cmd,
     cg_obj     *co;
     parse_tree *pt;
 
-    if ((co = co_new_only()) == NULL)
+    if ((co = co_new_only(CO_COMMAND)) == NULL)
 	return NULL;
-    co->co_type    = CO_COMMAND;
     if (cmd)
-	co->co_command = strdup(cmd);
+	co->co_command = cligen_intern(cmd);
     co_up_set(co, parent);
     /* parse-tree created implicitly */
     if ((pt = pt_new()) == NULL)
@@ -432,10 +511,10 @@ cov_new(enum cv_type cvtype,
     cg_obj     *co;
     parse_tree *pt;
 
-    if ((co = co_new_only()) == NULL)
+    if ((co = co_new_only(CO_VARIABLE)) == NULL)
 	return NULL;
-    co->co_type    = CO_VARIABLE;
     co->co_vtype   = cvtype;
+    co->co_vpref   = cov_pref(co);
     if (parent)
 	co_up_set(co, parent);
     co->co_dec64_n = CGV_DEC64_N_DEFAULT;
@@ -505,38 +584,41 @@ co_copy(cg_obj  *co,
     cg_obj     *con = NULL;
     parse_tree *pt;
     parse_tree *ptn;
+    struct cg_obj_ext *ext;
 
-    if ((con = co_new_only()) == NULL)
+    if ((con = co_new_only(co->co_type)) == NULL)
 	goto done;
-    memcpy(con, co, sizeof(cg_obj));
+    cligen_stats_global_inc(_cligen_stats_co_copy);
+    memcpy(con, co, co_size(co->co_type));
     con->co_ptvec = NULL;
     con->co_pt_len = 0;
-    con->co_ref = NULL;
-    if (co->co_treeref_orig)
-	con->co_treeref_orig = co->co_treeref_orig;
+    con->co_ext = NULL;
+    if ((ext = co_ext_alloc(con)) == NULL)
+	goto done;
+    if (co_treeref_orig_get(co))
+	ext->ce_treeref_orig = co_treeref_orig_get(co);
     else
-	con->co_treeref_orig = co;
+	ext->ce_treeref_orig = co;
     co_flags_reset(con, CO_FLAGS_MARK);
     co_flags_reset(con, CO_FLAGS_REFDONE);
+    co_flags_reset(con, CO_FLAGS_FROZEN);
     /* Replace all pointers */
     co_up_set(con, parent);
-    if (co->co_command)
-	if ((con->co_command = strdup(co->co_command)) == NULL)
-	    goto done;
-    if (co_callback_copy(co->co_callbacks, &con->co_callbacks) < 0)
+    con->co_command = cligen_intern_dup(co->co_command);
+    if (co_callback_copy(co_callbacks_get(co), &ext->ce_callbacks) < 0)
 	goto done;
-    if (co->co_cvec)
-	con->co_cvec = cvec_dup(co->co_cvec);
+    if (co_cvec_get(co))
+	ext->ce_cvec = cvec_dup(co_cvec_get(co));
     if ((pt = co_pt_get(co)) != NULL){
 	if ((ptn = pt_dup(pt, con)) == NULL) /* sets a new pt under con */
 	    goto done;
 	if (co_pt_set(con, ptn) < 0)
 	    goto done;
     }
-    if (co->co_helpvec)
-	if ((con->co_helpvec = cvec_dup(co->co_helpvec)) == NULL)
+    if (co_helpvec_get(co))
+	if ((ext->ce_helpvec = cvec_dup(co_helpvec_get(co))) == NULL)
 	    goto done;
-    if (co_value_set(con, co->co_value) < 0) /* XXX: free p co->co_value? */
+    if (co_value_set(con, co_value_get(co)) < 0) /* XXX: free p co_value_get(co)? */
 	goto done;
     if (co->co_type == CO_VARIABLE){
 	if (co->co_expand_fn_str)
@@ -554,6 +636,7 @@ co_copy(cg_obj  *co,
 	if (co->co_rangecvv_upp)
 	    if ((con->co_rangecvv_upp = cvec_dup(co->co_rangecvv_upp)) == NULL)
 		goto done;
+	con->co_rangetab = NULL; /* compiled again on use */
 	if (co->co_expand_fn_vec)
 	    if ((con->co_expand_fn_vec = cvec_dup(co->co_expand_fn_vec)) == NULL)
 		goto done;
@@ -592,7 +675,7 @@ static inline int
 str_cmp(char *s1, 
 	char *s2)
 {
-    if (s1 == NULL && s2 == NULL) 
+    if (s1 == s2) /* Also NULL, or same interned string */
 	return 0;
     if (s1 == NULL) /* empty string first */
 	return -1;
@@ -612,6 +695,127 @@ str_cmp(char *s1,
 #endif /* HAVE_STRVERSCMP */
 }
 
+/*! Collation of parse-tree levels, given by the lexicalorder and ignorecase options
+ * @retval CO_COLLATE_STRCMP   strcmp
+ * @retval CO_COLLATE_CASE     strcasecmp, see cligen_ignorecase_set
+ * @retval CO_COLLATE_VERSION  strverscmp, see cligen_lexicalorder_set
+ */
+int
+co_collation(void)
+{
+#ifdef  HAVE_STRVERSCMP
+    if (cligen_lexicalorder(NULL))
+	return CO_COLLATE_VERSION; /* can't combine lexicalorder and ignorecase */
+#endif /* HAVE_STRVERSCMP */
+    return cligen_ignorecase(NULL) ? CO_COLLATE_CASE : CO_COLLATE_STRCMP;
+}
+
+/*! Compute collation key of a string, keys compare with strcmp as the strings in the collation
+ * CO_COLLATE_CASE: the string in lower case, as compared by strcasecmp.
+ * CO_COLLATE_VERSION: as compared by strverscmp. A digit sequence not starting with '0'
+ * is its first digit, length and digits, so that longer numbers are greater. A
+ * sequence starting with '0' is kept, followed by a byte greater than all digits if
+ * it only contains zeros, so that "000" < "00" < "01" < "0".
+ * @param[in]  str   String
+ * @param[in]  i     Key slot: collation - 1
+ * @retval     key   Malloced key
+ * @retval     NULL  Error
+ * @see cligen_intern_key
+ */
+static char *
+co_collate_keyfn(const char *str,
+		 int         i)
+{
+    size_t      len = strlen(str);
+    char       *key;
+    char       *k;
+    const char *s = str;
+    size_t      n;
+    int         zero;
+
+    /* Worst case is single digits separated by non-digits: three bytes per digit */
+    if ((k = key = malloc(3*len + 1)) == NULL)
+	return NULL;
+    if (i+1 == CO_COLLATE_CASE){
+	while (*s)
+	    *k++ = tolower((unsigned char)*s++);
+	*k = '\0';
+	return key;
+    }
+    while (*s){
+	if (!isdigit((unsigned char)*s)){
+	    *k++ = *s++;
+	    continue;
+	}
+	for (n=0; isdigit((unsigned char)s[n]); n++)
+	    ;
+	if (*s == '0'){ /* Fractional */
+	    zero = 1;
+	    for (; n; n--){
+		if (*s != '0')
+		    zero = 0;
+		*k++ = *s++;
+	    }
+	    if (zero)
+		*k++ = '9' + 1;
+	}
+	else { /* Integral: length in bytes 1..255 never NULL */
+	    *k++ = '1';
+	    while (n >= 255){
+		*k++ = (char)0xff;
+		n -= 254;
+	    }
+	    *k++ = (char)n;
+	    while (isdigit((unsigned char)*s))
+		*k++ = *s++;
+	}
+    }
+    *k = '\0';
+    return key;
+}
+
+/*! Get collation key of an interned string, computed once and kept with the string
+ * @param[in]  istr       Interned string, eg co_command
+ * @param[in]  collation  Collation, see co_collation
+ * @retval     key        Key, istr itself for CO_COLLATE_STRCMP
+ * @retval     NULL       Error
+ */
+static inline char *
+co_collate_key(char *istr,
+	       int   collation)
+{
+    if (collation == CO_COLLATE_STRCMP)
+	return istr;
+    return cligen_intern_key(istr, collation-1, co_collate_keyfn);
+}
+
+/*! Compare two interned strings, as str_cmp but using precomputed collation keys
+ * @param[in]  s1  Interned string or NULL
+ * @param[in]  s2  Interned string or NULL
+ * @see str_cmp
+ */
+static inline int
+istr_cmp(char *s1,
+	 char *s2)
+{
+    int   collation;
+    char *k1;
+    char *k2;
+
+    if (s1 == s2) /* Also NULL */
+	return 0;
+    if (s1 == NULL) /* empty string first */
+	return -1;
+    if (s2 == NULL)
+	return 1;
+    if ((collation = co_collation()) == CO_COLLATE_STRCMP)
+	return strcmp(s1, s2);
+    if ((k1 = co_collate_key(s1, collation)) == NULL ||
+	(k2 = co_collate_key(s2, collation)) == NULL)
+	return str_cmp(s1, s2); /* Out of memory */
+    return strcmp(k1, k2);
+}
+
 /*! Check if two cligen objects (cg_obj) ar equal
  *
  * Two cligen objects are equal if they have:
@@ -644,21 +848,16 @@ co_eq(cg_obj *co1,
 	if (co2->co_type == CO_REFERENCE)
 	    eq = -1;
 	/* Here one is command and one is variable */
-	if (co1->co_type == CO_COMMAND){
-	    eq = strcmp(co1->co_command, co2->co_command);
-	    goto done;
-	}
-	else{ 	    /* co2->co_type == CO_COMMAND */
+	if (co1->co_command == co2->co_command) /* Same interned string */
+	    eq = 0;
+	else
 	    eq = strcmp(co1->co_command, co2->co_command);
-	    goto done;
-	}
-	/* shouldnt reach */
 	goto done;
     }
     switch (co1->co_type){
     case CO_COMMAND:
     case CO_REFERENCE:
-	eq = str_cmp(co1->co_command, co2->co_command);
+	eq = istr_cmp(co1->co_command, co2->co_command);
 	break;
     case CO_VARIABLE:
 	eq = (co1->co_vtype == co2->co_vtype)?0:(co1->co_vtype < co2->co_vtype)?-1:1;
@@ -726,6 +925,29 @@ co_eq(cg_obj *co1,
     return eq;
 }
 
+/*! Free the callbacks of a cligen object
+ * @param[in]  co   CLIgen object
+ * @retval     0    OK
+ */
+int
+co_callbacks_free(cg_obj *co)
+{
+    struct cg_callback *cc;
+    struct cg_obj_ext  *ext;
+
+    if ((ext = co->co_ext) == NULL)
+	return 0;
+    while ((cc = ext->ce_callbacks) != NULL){
+	if (cc->cc_cvec)	
+	    cvec_free(cc->cc_cvec);
+	if (cc->cc_fn_str)     
+	    free(cc->cc_fn_str);
+	ext->ce_callbacks = cc->cc_next;
+	free(cc);
+    }
+    return 0;
+}
+
 /*! Free an individual syntax node (cg_obj).
  * @param[in]  co         CLIgen object
  * @param[in]  recursive  If set free recursive, if 0 free only cligen object, and parsetree
@@ -740,24 +962,19 @@ int
 co_free(cg_obj *co, 
 	int     recursive)
 {
-    struct cg_callback *cc;
     parse_tree         *pt;
+    struct cg_obj_ext  *ext;
 
-    if (co->co_helpvec)
-	cvec_free(co->co_helpvec);
-    if (co->co_command)
-	free(co->co_command);
-    if (co->co_value)
-	free(co->co_value);
-    if (co->co_cvec)
-	cvec_free(co->co_cvec);
-    while ((cc = co->co_callbacks) != NULL){
-	if (cc->cc_cvec)	
-	    cvec_free(cc->cc_cvec);
-	if (cc->cc_fn_str)     
-	    free(cc->cc_fn_str);
-	co->co_callbacks = cc->cc_next;
-	free(cc);
+    cligen_intern_free(co->co_command);
+    if ((ext = co->co_ext) != NULL){
+	if (ext->ce_helpvec)
+	    cvec_free(ext->ce_helpvec);
+	if (ext->ce_value)
+	    free(ext->ce_value);
+	if (ext->ce_cvec)
+	    cvec_free(ext->ce_cvec);
+	co_callbacks_free(co);
+	free(ext);
     }
     if (co->co_type == CO_VARIABLE){
 	if (co->co_expand_fn_str)
@@ -776,6 +993,8 @@ co_free(cg_obj *co,
 	    cvec_free(co->co_rangecvv_low);
 	if (co->co_rangecvv_upp)
 	    cvec_free(co->co_rangecvv_upp);
+	if (co->co_rangetab)
+	    free(co->co_rangetab);
     }
     if (recursive && (pt = co_pt_get(co)) != NULL){ 
 	pt_free(pt, 1); /* recursive */ 
@@ -786,24 +1005,95 @@ co_free(cg_obj *co,
     return 0;
 }
 
+/*! Add the memory used by a cligen object and its sub-tree to a memory breakdown
+ * Mirrors what co_free frees. Interned strings are counted once per reference, see
+ * cligen_intern_stats for the size of the string table.
+ * @param[in]     co   CLIgen object
+ * @param[in,out] cm   Memory breakdown. Sizes are added, clear it before first call
+ * @retval        0    OK
+ * @retval       -1    Error
+ * @see pt_memsize
+ */
+int
+co_memsize(cg_obj         *co,
+	   cligen_memsize *cm)
+{
+    struct cg_callback *cc;
+    struct cg_obj_ext  *ext;
+    parse_tree         *pt;
+
+    if (co == NULL || cm == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    cm->cm_nodes += co_size(co->co_type);
+    if (co->co_command)
+	cm->cm_interned += strlen(co->co_command)+1;
+    if ((ext = co->co_ext) != NULL){
+	cm->cm_nodes += sizeof(*ext);
+	if (ext->ce_helpvec)
+	    cm->cm_cvecs += cvec_size(ext->ce_helpvec);
+	if (ext->ce_cvec)
+	    cm->cm_cvecs += cvec_size(ext->ce_cvec);
+	if (ext->ce_value)
+	    cm->cm_strings += strlen(ext->ce_value)+1;
+	for (cc = ext->ce_callbacks; cc; cc = cc->cc_next){
+	    cm->cm_callbacks += sizeof(*cc);
+	    if (cc->cc_fn_str)
+		cm->cm_callbacks += strlen(cc->cc_fn_str)+1;
+	    if (cc->cc_cvec)
+		cm->cm_callbacks += cvec_size(cc->cc_cvec);
+	}
+    }
+    if (co->co_type == CO_VARIABLE){
+	if (co->co_expand_fn_str)
+	    cm->cm_strings += strlen(co->co_expand_fn_str)+1;
+	if (co->co_translate_fn_str)
+	    cm->cm_strings += strlen(co->co_translate_fn_str)+1;
+	if (co->co_show)
+	    cm->cm_strings += strlen(co->co_show)+1;
+	if (co->co_choice)
+	    cm->cm_strings += strlen(co->co_choice)+1;
+	if (co->co_expand_fn_vec)
+	    cm->cm_varspecs += cvec_size(co->co_expand_fn_vec);
+	if (co->co_regex)
+	    cm->cm_varspecs += cvec_size(co->co_regex);
+	if (co->co_rangecvv_low)
+	    cm->cm_varspecs += cvec_size(co->co_rangecvv_low);
+	if (co->co_rangecvv_upp)
+	    cm->cm_varspecs += cvec_size(co->co_rangecvv_upp);
+	cm->cm_varspecs += cv_rangetab_size(co2varspec(co));
+    }
+    if (co->co_ptvec != NULL)
+	cm->cm_ptvecs += co->co_pt_len*sizeof(parse_tree *);
+    if ((pt = co_pt_get(co)) != NULL && pt_memsize(pt, cm) < 0)
+	return -1;
+    return 0;
+}
+
 /*! Look for a CLIgen object in a (one-level) parse-tree in interval [low,high]
- * @param[in]  pt      CLIgen parse-tree
- * @param[in]  name    Name of node
- * @param[in]  low     Lower bound
- * @param[in]  upper   Upper bound
- * @retval     co      Object found
- * @retval     NULL    Not found
+ * @param[in]  pt        CLIgen parse-tree
+ * @param[in]  name      Name of node
+ * @param[in]  key       Collation key of name, see co_collate_keyfn
+ * @param[in]  collation Collation of key, see co_collation
+ * @param[in]  low       Lower bound
+ * @param[in]  upper     Upper bound
+ * @retval     co        Object found
+ * @retval     NULL      Not found
  * @see co_insert Main function
  */
 static cg_obj *
 co_search1(parse_tree *pt, 
 	   char       *name, 
+	   char       *key,
+	   int         collation,
 	   int         low, 
 	   int         upper)
 {
     int     mid;
     int     cmp;
     cg_obj *co;
+    char   *cokey;
 
     if (upper < low)
 	return NULL; /* not found */
@@ -811,11 +1101,18 @@ co_search1(parse_tree *pt,
     if (mid >= pt_len_get(pt))  /* beyond range */
 	return NULL;
     co = pt_vec_i_get(pt, mid);
-    cmp = str_cmp(name, co ? co->co_command : NULL);
+    if (co == NULL || co->co_command == NULL)
+	cmp = name == NULL ? 0 : 1; /* NULL first */
+    else if (name == NULL)
+	cmp = -1;
+    else if ((cokey = co_collate_key(co->co_command, collation)) == NULL)
+	cmp = str_cmp(name, co->co_command); /* Out of memory */
+    else
+	cmp = strcmp(key, cokey);
     if (cmp < 0)
-	return co_search1(pt, name, low, mid-1);
+	return co_search1(pt, name, key, collation, low, mid-1);
     else if (cmp > 0)
-	return co_search1(pt, name, mid+1, upper);
+	return co_search1(pt, name, key, collation, mid+1, upper);
     else
 	return co;
 }
@@ -859,42 +1156,158 @@ co_insert_pos(parse_tree *pt,
 	return mid;
 }
 
+/*! Move callbacks and children of an object into an equal object of a parse-tree
+ *
+ * Children of co1 are added to co0 one at a time with co_insert_merge(), so that the
+ * level of co0 stays sorted and its keyword index is updated, not rebuilt.
+ * @param[in]  co0       Object that is kept
+ * @param[in]  co1       Equal object, its children are moved. Freed by caller
+ * @param[in]  callbacks Take the callbacks of co1 if co0 has none
+ * @retval     0         OK
+ * @retval    -1         Error
+ */
+static int
+co_merge(cg_obj *co0,
+	 cg_obj *co1,
+	 int     callbacks)
+{
+    struct cg_obj_ext *ext0;
+    parse_tree        *pt0;
+    parse_tree        *pt1;
+    cg_obj            *co;
+    int                i;
+
+    if (callbacks && co_callbacks_get(co0) == NULL && co_callbacks_get(co1) != NULL){
+	if ((ext0 = co_ext_alloc(co0)) == NULL)
+	    return -1;
+	ext0->ce_callbacks = co1->co_ext->ce_callbacks;
+	co1->co_ext->ce_callbacks = NULL;
+    }
+    if ((pt1 = co_pt_get(co1)) == NULL || pt_len_get(pt1) == 0)
+	return 0;
+    for (i=0; i<pt_len_get(pt1); i++)
+	if ((co = pt_vec_i_get(pt1, i)) != NULL)
+	    co_up_set(co, co0);
+    if ((pt0 = co_pt_get(co0)) == NULL){ /* Move the whole level */
+	if (co_pt_set(co0, pt1) < 0)
+	    return -1;
+	co_pt_clear(co1);
+	return 0;
+    }
+    if (pt_sorted_get(pt0) != 1) /* Levels not yet evaluated may be unsorted */
+	cligen_parsetree_sort(pt0, 0);
+    for (i=0; i<pt_len_get(pt1); i++){
+	if ((co = pt_vec_i_get(pt1, i)) != NULL &&
+	    pt_vec_i_clear(pt1, i) < 0)
+	    return -1;
+	if (co_insert_merge(pt0, co, 1, NULL) < 0){
+	    if (co)
+		co_free(co, 1);
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+/*! Add a cligen object to a sorted parse-tree level, or merge it into an equal object
+ *
+ * If the level has an object equal to co1, see co_eq, the children of co1 are merged
+ * into it recursively and co1 is freed. Otherwise co1 is inserted in order.
+ * Sorted levels stay sorted and keyword indexes are updated, see pt_vec_i_insert.
+ * Below the top level, callbacks of a merged object are used if the equal object has
+ * none, as cligen_parsetree_merge().
+ * @param[in]  pt        Parse-tree level, sorted
+ * @param[in]  co1       Object to add, or NULL for end of command. Not freed on error
+ * @param[in]  callbacks Also take callbacks of co1 at the top level if the equal
+ *                       object has none
+ * @param[out] cop       Object in pt: co1 or the equal object co1 was merged into (if set)
+ * @retval     0         OK
+ * @retval    -1         Error
+ * @see co_insert
+ * @see pt_delta_add
+ */
+int
+co_insert_merge(parse_tree *pt,
+		cg_obj     *co1,
+		int         callbacks,
+		cg_obj    **cop)
+{
+    int     pos;
+    cg_obj *co2 = NULL;
+    int     sorted;
+
+    sorted = pt_sorted_get(pt);
+    /* find closest to co in parsetree, insert after pos. */
+    pos = co_insert_pos(pt, co1, 0, pt_len_get(pt));
+    /* check if exists */
+    if (pos < pt_len_get(pt)){
+	co2 = pt_vec_i_get(pt, pos); /* insert after co2 */
+	if (co1 == NULL && co2 == NULL)
+	    goto found;
+	if (co1 && co2 && co_eq(co1, co2)==0){
+	    if (co_merge(co2, co1, callbacks) < 0)
+		return -1;
+	    co_free(co1, 1);
+	    goto found;
+	}
+    }
+    if (pt_vec_i_insert(pt, pos, co1) < 0)
+	return -1;
+    if (sorted == 1) /* Inserted in order */
+	pt_sorted_set(pt, 1);
+    co2 = co1;
+ found:
+    if (cop)
+	*cop = co2;
+    return 0;
+}
+
 /*! Add a cligen object (co1) to a parsetree(pt) alphabetically.
  * This involves searching in the parsetree for the position where it should be added,
  * Then checking whether an equivalent version already exists.
  * Then modifying the parsetree by shifting it down, and adding the new object.
+ * If an equivalent object exists, the children of co1 are merged into it.
  * There is som complexity if co == NULL.
  * @param[in] pt   Parse-tree
  * @param[in] co1  CLIgen object
- * @retval    co   object if found (old _or_ new). NOTE: you must replace calling 
+ * @retval    co   object if found (old _or_ new). NOTE: you must replace calling
  *                 cg_obj with return.
  * @retval    NULL error
  * @note co1 maye be deleted in this call. Dont use co after this call,use retval
- * XXX: pt=[a b] + co1=[b] -> [a b] but children of one b is lost,..
+ * @see co_insert_merge
  */
 cg_obj*
-co_insert(parse_tree *pt, 
+co_insert(parse_tree *pt,
 	  cg_obj     *co1)
+{
+    cg_obj *co;
+
+    if (co_insert_merge(pt, co1, 0, &co) < 0)
+	return NULL;
+    return co;
+}
+
+/*! Find the object equal to co1 in a sorted parse-tree level
+ * @param[in]  pt   Parse-tree level, sorted
+ * @param[in]  co1  Object to look for, see co_eq, or NULL for end of command
+ * @retval     pos  Position of equal object in pt
+ * @retval    -1    Not found
+ * @see co_insert
+ */
+int
+co_find_eq(parse_tree *pt,
+	   cg_obj     *co1)
 {
     int     pos;
     cg_obj *co2;
 
-    /* find closest to co in parsetree, insert after pos. */
     pos = co_insert_pos(pt, co1, 0, pt_len_get(pt));
-    /* check if exists */
-    if (pos < pt_len_get(pt)){
-	co2 = pt_vec_i_get(pt, pos); /* insert after co2 */
-	if (co1 == NULL && co2==NULL)
-	    return NULL;
-	if (co1 && co2 && co_eq(co1, co2)==0){
-	    cligen_parsetree_merge(co_pt_get(co2), co2, co_pt_get(co1));
-	    co_free(co1, 1);
-	    return co2;
-	}
-    }
-    if (pt_vec_i_insert(pt, pos, co1) < 0)
-	return NULL;
-    return co1;
+    if (pos >= pt_len_get(pt))
+	return -1;
+    co2 = pt_vec_i_get(pt, pos);
+    if (co1 == NULL || co2 == NULL)
+	return co1 == co2 ? pos : -1;
+    return co_eq(co1, co2) == 0 ? pos : -1;
 }
 
 /*! Given a parse tree, find the first CLIgen object that matches 
@@ -911,7 +1324,41 @@ cg_obj *
 co_find_one(parse_tree *pt,
 	    char       *name)
 {
-    return co_search1(pt, name, 0, pt_len_get(pt));
+    cg_obj *co;
+    char   *key = name;
+    int     collation;
+
+    /* Collation key of name is computed once for the search */
+    if ((collation = co_collation()) != CO_COLLATE_STRCMP && name != NULL &&
+	(key = co_collate_keyfn(name, collation-1)) == NULL)
+	return NULL;
+    co = co_search1(pt, name, key, collation, 0, pt_len_get(pt));
+    if (key != name)
+	free(key);
+    return co;
+}
+
+/*! Set command, ie keyword or variable name, of a CLIgen object
+ * The string is interned, and an old command is released.
+ * @param[in]  co      CLIgen object
+ * @param[in]  str     Command to set, or NULL
+ * @retval     0       OK
+ * @retval     -1      Error
+ * @see cligen_intern
+ */
+int
+co_command_set(cg_obj *co,
+	       char   *str)
+{
+    char *istr = NULL;
+
+    if (str != NULL && (istr = cligen_intern(str)) == NULL){
+	fprintf(stderr, "%s: cligen_intern: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    cligen_intern_free(co->co_command);
+    co->co_command = istr;
+    return 0;
 }
 
 /*! Set CLIgen object value
@@ -925,15 +1372,20 @@ int
 co_value_set(cg_obj *co, 
 	     char   *str)
 {
-    if (co->co_value){ /* This can happen in '?/TAB' since we call match twice */
-	free(co->co_value);
-	co->co_value = NULL;
+    struct cg_obj_ext *ext;
+
+    if ((ext = co->co_ext) != NULL && ext->ce_value){ /* This can happen in '?/TAB' since we call match twice */
+	free(ext->ce_value);
+	ext->ce_value = NULL;
     }
-    if (str != NULL)
-	if ((co->co_value = strdup(str)) == NULL){
+    if (str != NULL){
+	if ((ext = co_ext_alloc(co)) == NULL)
+	    return -1;
+	if ((ext->ce_value = strdup(str)) == NULL){
 	    fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
 	    return -1;
 	}
+    }
     return 0;
 }
 
@@ -73,8 +73,12 @@ typedef int (cgv_fnstype_t)(cligen_handle h, cvec *vars, cvec *argv);
 /* Expand callback function for vector arguments (should be in cligen_expand.h) 
    Returns 0 if handled expand, that is, it returned commands for 'name'
            1 if did not handle expand 
+           CLIGEN_EXPAND_PENDING if the commands are not complete yet, see
+             cligen_expand_wait
           -1 on error.
 */
+#define CLIGEN_EXPAND_PENDING 2
+
 typedef int (expandv_cb)(cligen_handle h,       /* handler: cligen or userhandle */
 			 char         *name,    /* name of this function (in text) */
 			 cvec         *cvv,     /* vars vector of values in command */
@@ -131,8 +135,10 @@ struct cg_varspec{
      * it means the min value of the type (eg <a:int32 range[40]> */
     cvec           *cgs_rangecvv_low;  
     cvec           *cgs_rangecvv_upp;  /* array of upper bound of intervals */
+    struct cv_range_table *cgs_rangetab; /* intervals compiled on first validation, see cv_validate */
     cvec           *cgs_regex;         /* List of regular expressions */
     uint8_t         cgs_dec64_n;       /* negative decimal exponential 1..18 */
+    uint8_t         cgs_pref;          /* match preference of the spec, see cov_pref_update */
 };
 typedef struct cg_varspec cg_varspec;
 
@@ -147,7 +153,23 @@ typedef struct cg_varspec cg_varspec;
 #define CO_FLAGS_TREEREF   0x04  /* This node is top of expanded sub-tree */
 #define CO_FLAGS_REFDONE   0x08  /* This reference has already been expanded */
 #define CO_FLAGS_OPTION    0x10  /* Generated from optional [] */
-#define CO_FLAGS_MATCH     0x20  /* For sets: avoid selecting same more than once */
+#define CO_FLAGS_MATCH     0x20  /* Not used, sets keep matched positions per level, see match_pattern_sets */
+#define CO_FLAGS_FROZEN    0x80  /* Part of a read-only shared parse-tree, see pt_freeze */
+
+/*! Rarely used fields of a cligen object, allocated on demand
+ * Not needed when matching, and not set on most keywords of a large parse-tree.
+ * @see co_ext_alloc
+ */
+struct cg_obj_ext{
+    struct cg_callback *ce_callbacks;  /* linked list of callbacks and arguments */
+    cvec               *ce_cvec;       /* List of cligen variables (XXX: not visible to
+					  callbacks) */
+    cvec               *ce_helpvec;    /* Vector of CLIgen helptexts */
+    struct cg_obj      *ce_ref;        /* Ref to original (if this is expanded) */
+    struct cg_obj      *ce_treeref_orig; /* Ref to original (if this is a tree reference) */
+    char               *ce_value;      /* Expanded value can be a string with a constant. 
+					  Store the constant in the original variable. */
+};
 
 /*! cligen gen object is a parse-tree node. A cg_obj is either a command or a variable
  * A cg_obj 
@@ -161,24 +183,20 @@ typedef struct cg_varspec cg_varspec;
  *    v v  v
  *    o o  o   <--- cg_obj
  * @endcode
+ * The fields used when matching come first. Other fields are in co_ext which is only
+ * allocated if any of them is set. The variable spec in u is only allocated for
+ * CO_VARIABLE, see co_size.
  */
 struct cg_obj{
-    parse_tree        **co_ptvec;     /* Child parse-tree (see co_next macro below) */
-    int                 co_pt_len;    /* Length of parse-tree vector */
-    struct cg_obj      *co_prev;      /* Parent */
     enum cg_objtype     co_type;      /* Type of object: command, variable or tree
 					 reference */
-    char               *co_command;   /* malloc:ed matching string / name or type */
-    struct cg_callback *co_callbacks; /* linked list of callbacks and arguments */
-    cvec               *co_cvec;      /* List of cligen variables (XXX: not visible to
-					 callbacks) */
-    cvec               *co_helpvec;   /* Vector of CLIgen helptexts */
     uint32_t            co_flags;     /* General purpose flags, see CO_FLAGS_HIDE and others above */
-    struct cg_obj      *co_ref;       /* Ref to original (if this is expanded) */
-    struct cg_obj      *co_treeref_orig; /* Ref to original (if this is a tree reference) */
-    char               *co_value;     /* Expanded value can be a string with a constant. 
-					 Store the constant in the original variable. */
-    union {                           /* depends on co_type: */
+    char               *co_command;   /* Interned matching string / name or type, see co_command_set */
+    parse_tree        **co_ptvec;     /* Child parse-tree (see co_next macro below) */
+    int                 co_pt_len;    /* Length of parse-tree vector */
+    struct cg_obj      *co_prev;      /* Parent */
+    struct cg_obj_ext  *co_ext;       /* Rarely used fields, or NULL, see co_ext_alloc */
+    union {                           /* depends on co_type, must be last: */
 	struct {        } cou_cmd;    /* CO_COMMAND */
 	struct cg_varspec cou_var;    /* CO_VARIABLE */
 	//	struct cg_varspec cou_tree;   /* CO_REFERENCE */
@@ -187,9 +205,22 @@ struct cg_obj{
 
 typedef struct cg_obj cg_obj; 
 
+/* Collation of parse-tree levels, see co_collation */
+#define CO_COLLATE_STRCMP  0  /* strcmp */
+#define CO_COLLATE_CASE    1  /* strcasecmp, see cligen_ignorecase_set */
+#define CO_COLLATE_VERSION 2  /* strverscmp, see cligen_lexicalorder_set */
+
 /* Access macro to cligen object variable specification */
 #define co2varspec(co)  &(co)->u.cou_var
 
+/* Read access to fields in co_ext, NULL if not set. Set them via co_ext_alloc */
+#define co_callbacks_get(co)    ((co)->co_ext ? (co)->co_ext->ce_callbacks : NULL)
+#define co_cvec_get(co)         ((co)->co_ext ? (co)->co_ext->ce_cvec : NULL)
+#define co_helpvec_get(co)      ((co)->co_ext ? (co)->co_ext->ce_helpvec : NULL)
+#define co_ref_get(co)          ((co)->co_ext ? (co)->co_ext->ce_ref : NULL)
+#define co_treeref_orig_get(co) ((co)->co_ext ? (co)->co_ext->ce_treeref_orig : NULL)
+#define co_value_get(co)        ((co)->co_ext ? (co)->co_ext->ce_value : NULL)
+
 /* Access fields for code traversing parse tree */
 #define co_vtype         u.cou_var.cgs_vtype
 #define co_show          u.cou_var.cgs_show
@@ -203,8 +234,10 @@ typedef struct cg_obj cg_obj;
 #define co_rangelen	 u.cou_var.cgs_rangelen 
 #define co_rangecvv_low	 u.cou_var.cgs_rangecvv_low
 #define co_rangecvv_upp  u.cou_var.cgs_rangecvv_upp
+#define co_rangetab      u.cou_var.cgs_rangetab
 #define co_regex         u.cou_var.cgs_regex
 #define co_dec64_n       u.cou_var.cgs_dec64_n
+#define co_vpref         u.cou_var.cgs_pref
 
 /*
  * Prototypes
@@ -220,16 +253,26 @@ void        co_flags_reset(cg_obj *co, uint32_t flag);
 int         co_flags_get(cg_obj *co, uint32_t flag);
 int         co_sets_get(cg_obj *co);
 void        co_sets_set(cg_obj *co, int sets);
-cg_obj     *co_new_only(void);
+size_t      co_size(enum cg_objtype type);
+struct cg_obj_ext *co_ext_alloc(cg_obj *co);
+cg_obj     *co_new_only(enum cg_objtype type);
 cg_obj     *co_new(char *cmd, cg_obj *prev);
 cg_obj     *cov_new(enum cv_type cvtype, cg_obj *prev);
+int         cov_pref_update(cg_obj *co);
 int         co_pref(cg_obj *co, int exact);
+int         co_pref_shadow(cg_obj *co, int exact, int borrowed);
 int         co_callback_copy(struct cg_callback *cc0, struct cg_callback **ccn);
+int         co_callbacks_free(cg_obj *co);
 int         co_copy(cg_obj *co, cg_obj *parent, cg_obj **conp);
 int         co_eq(cg_obj *co1, cg_obj *co2);
 int         co_free(cg_obj *co, int recursive);
+int         co_memsize(cg_obj *co, cligen_memsize *cm);
 cg_obj     *co_insert(parse_tree *pt, cg_obj *co);
+int         co_insert_merge(parse_tree *pt, cg_obj *co1, int callbacks, cg_obj **cop);
+int         co_find_eq(parse_tree *pt, cg_obj *co1);
+int         co_collation(void);
 cg_obj     *co_find_one(parse_tree *pt, char *name);
+int         co_command_set(cg_obj *co, char *str);
 int         co_value_set(cg_obj *co, char *str);
 #if defined(__GNUC__) && __GNUC__ >= 3
 char       *cligen_reason(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
@@ -68,6 +68,9 @@ struct cligen_parse_yacc{
     char                 *cy_treename;     /* Name of syntax (for error string) */
     int                   cy_linenum;      /* Number of \n in parsed buffer */
     char                 *cy_parse_string; /* original (copy of) parse string */
+    size_t                cy_parse_len;    /* If set, cy_parse_string is followed by two NUL
+					      chars and is scanned in place, see cgl_init */
+    void                 *cy_scanner;      /* reentrant lex scanner of this parse */
     void                 *cy_lexbuf;       /* internal parse buffer from lex */
     cvec                 *cy_globals;      /* global variables after parsing */
     cvec                 *cy_cvec;         /* local variables (per-command) */
@@ -77,25 +80,28 @@ struct cligen_parse_yacc{
     struct cg_callback   *cy_callbacks; 
     int                   cy_lex_state;  /* lex start condition (ESCAPE/COMMENT) */
     int                   cy_lex_string_state; /* lex start condition (STRING) */
+    uint32_t              cy_order;        /* Creation order of objects, see pt_bulk_append */
+    int                   cy_private;      /* Keep parsed trees in cy_phvec, not in handle */
+    struct pt_head      **cy_phvec;        /* Headers of private trees, see cgy_tree_add */
+    int                   cy_phlen;        /* Length of cy_phvec */
 };
 typedef struct cligen_parse_yacc cligen_yacc;
 
-/*
- * Variables
- */
-extern char *cligen_parsetext;
-
 /*
  * Prototypes
  */
 
 int cgl_init(cligen_yacc *cy);
 int cgl_exit(cligen_yacc *cy);
+char *cgl_text(cligen_yacc *cy);
 
 int cgy_init(cligen_yacc *cy, cg_obj *co_top);
 int cgy_exit(cligen_yacc *cy);
+int cgy_tree_add(cligen_yacc *cy, char *name, parse_tree *pt);
 
-int cligen_parselex(void *_ya);
+#ifdef YYSTYPE_IS_DECLARED /* cligen_parse.tab.h included */
+int cligen_parselex(YYSTYPE *lvalp, void *_ya);
+#endif
 int cligen_parseparse(void *);
 void cligen_parseerror(void *_ya, char*);
 int cligen_parse_debug(int d);
@@ -62,6 +62,7 @@
 %type <string> typecast
 %type <intval> preline
 
+%define api.pure /* Reentrant parser, see cgl_init */
 %lex-param     {void *_cy} /* Add this argument to parse() and lex() function */
 %parse-param   {void *_cy}
 
@@ -107,8 +108,6 @@ static int debug = 0;
 #define _PARSE_DEBUG(s)
 #endif
 
-extern int cligen_parseget_lineno  (void);
-
 int 
 cligen_parse_debug(int d)
 {
@@ -128,7 +127,7 @@ void cligen_parseerror(void *_cy,
 	   ":" ,
 	  _CY->cy_linenum ,
 	  s, 
-	  cligen_parsetext); 
+	  cgl_text(_CY)); 
   return;
 }
 
@@ -197,6 +196,38 @@ cgy_flag(cligen_yacc *cy,
     return retval;
 }
 
+/*! Add a parsed tree with a name
+ * The tree is added to the handle, or, if the parse session is private, kept in 
+ * the session until all files are parsed, see cligen_parse_files
+ * @param[in]  cy   CLIgen yacc parse struct
+ * @param[in]  name Name of tree
+ * @param[in]  pt   Parse-tree
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+int
+cgy_tree_add(cligen_yacc *cy,
+	     char        *name,
+	     parse_tree  *pt)
+{
+    pt_head  *ph;
+    pt_head **phvec;
+
+    if (cy->cy_private){
+	if ((phvec = realloc(cy->cy_phvec, (cy->cy_phlen+1)*sizeof(pt_head *))) == NULL){
+	    fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	cy->cy_phvec = phvec;
+	if ((ph = cligen_ph_new(name)) == NULL)
+	    return -1;
+	cy->cy_phvec[cy->cy_phlen++] = ph;
+    }
+    else if ((ph = cligen_ph_add(cy->cy_handle, name)) == NULL)
+	return -1;
+    return cligen_ph_parsetree_set(ph, pt);
+}
+
 /*! Set a new treename. In fact registers the previous tree and creates a new .
  * Note that one could have used an assignment: treename = <name>; for this but
  * I decided to create special syntax for this so that assignments can use any
@@ -214,7 +245,6 @@ cgy_treename(cligen_yacc *cy,
     int                retval = -1;
     int                i;
     parse_tree        *pt;
-    pt_head           *ph;
     
     /* Get the first object */
     for (cl=cy->cy_list; cl; cl = cl->cl_next){
@@ -226,14 +256,15 @@ cgy_treename(cligen_yacc *cy,
     pt = co_pt_get(cot);
     /* If anything parsed */
     if (pt_len_get(pt)){ 
+	/* 1. Sort and merge what was parsed into the old parse-tree */
+	if (pt_coalesce(pt, PT_COALESCE_PARSE) < 0)
+	    goto done;
 	/* 2. Add the old parse-tree with old name*/
 	for (i=0; i<pt_len_get(pt); i++){
 	    if ((co=pt_vec_i_get(pt, i)) != NULL)
 		co_up_set(co, NULL);
 	}
-	if ((ph = cligen_ph_add(cy->cy_handle, cy->cy_treename)) == NULL)
-	    goto done;
-	if (cligen_ph_parsetree_set(ph, pt) < 0)
+	if (cgy_tree_add(cy, cy->cy_treename, pt) < 0)
 	    goto done;
 	/* 3. Create new parse-tree XXX */
 	if ((pt = pt_new()) == NULL)
@@ -470,7 +501,9 @@ cgy_var_create(cligen_yacc *cy)
 }
 
 /*! Set name and type on a (previously created) variable
- * @param[in]  cy  CLIgen yacc parse struct
+ * @param[in]  cy    CLIgen yacc parse struct
+ * @param[in]  name  Variable name, malloced and freed by this function (interned)
+ * @param[in]  type  Variable type, may be same as name
  * @see cgy_var_create
  */
 static int
@@ -478,13 +511,21 @@ cgy_var_name_type(cligen_yacc *cy,
 		  char        *name,
 		  char        *type)
 {
-    cy->cy_var->co_command = name; 
+    int retval = -1;
+
+    if (co_command_set(cy->cy_var, name) < 0){
+	cligen_parseerror1(cy, "Allocating variable name"); 
+	goto done;
+    }
     if ((cy->cy_var->co_vtype = cv_str2type(type)) == CGV_ERR){
 	cligen_parseerror1(cy, "Invalid type"); 
 	fprintf(stderr, "%s: Invalid type: %s\n", __FUNCTION__, type);
-	return -1;
+	goto done;
     }
-    return 0;
+    retval = 0;
+ done:
+    free(name);
+    return retval;
 }
 
 /*! Complete variable cligen object after parsing is complete,
@@ -500,7 +541,6 @@ cgy_var_post(cligen_yacc *cy)
     struct cgy_list *cl; 
     cg_obj          *coc = NULL; /* variable copy object */
     cg_obj          *coparent; /* parent */
-    cg_obj          *co;  /* new obj/sister */
     cg_obj          *coy = cy->cy_var;
 
 #if 0
@@ -515,6 +555,9 @@ cgy_var_post(cligen_yacc *cy)
 	cligen_parseerror1(cy, "Wrong or unassigned variable type"); 	
 	return -1;
     }
+    /* Type, ranges and regexps are set */
+    if (cov_pref_update(coy) < 0)
+	return -1;
 #if 0 /* XXX dont really know what i am doing but variables dont behave nice in choice */
     if (cy->cy_opt){     /* get coparent from stack */
 	if (cy->cy_stack == NULL){
@@ -535,9 +578,10 @@ cgy_var_post(cligen_yacc *cy)
 	else
 	    coc = coy; /* Dont copy if last in list */
 	co_up_set(coc, coparent);
-	if ((co = co_insert(co_pt_get(coparent), coc)) == NULL) /* coc may be deleted */
+	/* Equal objects are merged when the tree is coalesced, see pt_coalesce */
+	if (pt_bulk_append(co_pt_get(coparent), coc, ++cy->cy_order) < 0)
 	    return -1;
-	cl->cl_obj = co;
+	cl->cl_obj = coc;
     }
     return 0;
 }
@@ -557,7 +601,6 @@ cgy_cmd(cligen_yacc *cy,
     struct cgy_list *cl; 
     cg_obj          *cop; /* parent */
     cg_obj          *conew; /* new obj */
-    cg_obj          *co; /* new/sister */
 
     for (cl=cy->cy_list; cl; cl = cl->cl_next){
 	cop = cl->cl_obj;
@@ -568,9 +611,9 @@ cgy_cmd(cligen_yacc *cy,
 	    cligen_parseerror1(cy, "Allocating cligen object"); 
 	    return -1;
 	}
-	if ((co = co_insert(co_pt_get(cop), conew)) == NULL)  /* co_new may be deleted */
+	if (pt_bulk_append(co_pt_get(cop), conew, ++cy->cy_order) < 0)
 	    return -1;
-	cl->cl_obj = co; /* Replace parent in cgy_list */
+	cl->cl_obj = conew; /* Replace parent in cgy_list */
     }
     return 0;
 }
@@ -597,7 +640,7 @@ cgy_reference(cligen_yacc *cy,
 	    return -1;
 	}
 	cot->co_type    = CO_REFERENCE;
-	if ((cot = co_insert(co_pt_get(cop), cot)) == NULL)  /* cot may be deleted */
+	if (pt_bulk_append(co_pt_get(cop), cot, ++cy->cy_order) < 0)
 	    return -1;
 	/* Replace parent in cgy_list: not allowed after ref?
 	   but only way to add callbacks to it.
@@ -616,13 +659,16 @@ static int
 cgy_comment(cligen_yacc *cy,
 	    char        *comment)
 {
-    struct cgy_list *cl; 
-    cg_obj          *co; 
+    struct cgy_list   *cl; 
+    cg_obj            *co; 
+    struct cg_obj_ext *ext;
 
     for (cl = cy->cy_list; cl; cl = cl->cl_next){
 	co = cl->cl_obj;
-	if (co->co_helpvec == NULL && /* Why would it already have a comment? */
-	    cligen_txt2cvv(comment, &co->co_helpvec) < 0){ /* Or just append to existing? */
+	if (co_helpvec_get(co) != NULL) /* Why would it already have a comment? */
+	    continue;
+	if ((ext = co_ext_alloc(co)) == NULL ||
+	    cligen_txt2cvv(comment, &ext->ce_helpvec) < 0){ /* Or just append to existing? */
 	    cligen_parseerror1(cy, "Allocating comment");
 	    return -1;
 	}
@@ -673,11 +719,14 @@ cgy_terminal(cligen_yacc *cy)
     struct cg_callback **ccp;
     int                 retval = -1;
     parse_tree         *ptc;
+    struct cg_obj_ext  *ext;
     
     for (cl = cy->cy_list; cl; cl = cl->cl_next){
 	co  = cl->cl_obj;
 	if (cy->cy_callbacks){ /* callbacks */
-	    ccp = &co->co_callbacks;
+	    if ((ext = co_ext_alloc(co)) == NULL)
+		goto done;
+	    ccp = &ext->ce_callbacks;
 	    while (*ccp != NULL)
 		ccp = &((*ccp)->cc_next);
 	    if (co_callback_copy(cy->cy_callbacks, ccp) < 0)
@@ -694,7 +743,9 @@ cgy_terminal(cligen_yacc *cy)
             co_flags_set(co, CO_FLAGS_HIDE_DATABASE);
         }
 	    /* generic variables */
-	    if ((co->co_cvec = cvec_dup(cy->cy_cvec)) == NULL){
+	    if ((ext = co_ext_alloc(co)) == NULL)
+		goto done;
+	    if ((ext->ce_cvec = cvec_dup(cy->cy_cvec)) == NULL){
 		fprintf(stderr, "%s: cvec_dup: %s\n", __FUNCTION__, strerror(errno));
 		goto done;
 	    }
@@ -706,7 +757,8 @@ cgy_terminal(cligen_yacc *cy)
 		    break;
 	    }
 	    if (i == pt_len_get(ptc)) /* Insert empty child if ';' */
-		co_insert(co_pt_get(co), NULL);
+		if (pt_bulk_append(ptc, NULL, ++cy->cy_order) < 0)
+		    goto done;
 	}
 	else
 	    co_insert(co_pt_get(co), NULL);
@@ -1144,7 +1196,9 @@ cgy_exit(cligen_yacc *cy)
 
     cy->cy_var = NULL;
     cgy_list_delete(&cy->cy_list);
-    if((cs = cy->cy_stack) != NULL){
+    /* More than one level is left on a parse error */
+    while ((cs = cy->cy_stack) != NULL){
+	cy->cy_stack = cs->cs_next;
 	delete_stack_element(cs);
 #if 0
 	fprintf(stderr, "%s:%d: error: lacking () or [] at or before: '%s'\n", 
@@ -67,18 +67,638 @@
 #include "cligen_handle.h"
 #include "cligen_getline.h"
 
-/* Private definition of parsetree. Public is defined in cligen_parsetree.h 
+/*! Keyword lookup index of one parse-tree level, built on demand.
+ * Commands are sorted on their keyword so that exact and prefix matches can be
+ * found with binary search. All other children (variables, references, escaped
+ * commands) are kept in a separate list which always needs to be scanned.
+ * Keywords and positions of the commands are kept in separate vectors, so that the
+ * positions of a range of keywords can be returned in place, see pt_index_lookup.
+ */
+struct pt_index{
+    char                 **pi_cmdkey;   /* Keywords of commands, sorted (not copied) */
+    int                   *pi_cmdpos;   /* Positions of commands, duplicates in vector order */
+    int                    pi_cmdlen;   /* Length of pi_cmdkey and pi_cmdpos */
+    int                   *pi_othervec; /* Positions of non-indexed children */
+    int                    pi_otherlen; /* Length of pi_othervec */
+    int                    pi_size;     /* Allocated length of the vectors */
+};
+
+/*! Rendered help table of a static parse-tree level, see pt_help_get
+ * One table is kept per layout, eg TAB and '?' on the same level do not replace each other.
+ */
+struct pt_help{
+    pt_help_key  ph_key;      /* Settings of the rendering, zero hk_width if not set */
+    char         ph_hide;     /* Hidden commands excluded from the shadow level */
+    int         *ph_matchvec; /* Positions of matched commands in the shadow level */
+    int          ph_matchlen; /* Length of ph_matchvec */
+    char        *ph_buf;      /* Rendered table */
+    size_t       ph_len;      /* Length of ph_buf */
+};
+
+/* Private definition of parsetree. Public is defined in cligen_parsetree.h
  * @see parse_tree_list which is the upper level of a parse-tree
  */
 struct parse_tree{
     struct cg_obj     **pt_vec;    /* vector of pointers to parse-tree nodes */
     int                 pt_len;    /* length of vector */
+    int                 pt_size;   /* allocated length of vector, >= pt_len */
+    int                 pt_appended; /* Trailing nodes added by pt_bulk_append, not yet
+				       sorted and coalesced, see pt_coalesce */
+    uint32_t           *pt_order;  /* Creation order of appended nodes or NULL, see pt_bulk_append */
 #if 1 /* OBSOLETE but keep to after 4.8 */
     char               *pt_name;   /* XXX Should be removed, us ph_name instead but eg clixon uses it */
 #endif
-    char                pt_set;    /* Parse-tree is a SET */ 
+    char                pt_set;    /* Parse-tree is a SET */
+    char                pt_borrow; /* Shadow parse-tree where objects without co_ref are
+				      not owned, see pt_expand */
+    struct pt_index    *pt_index;  /* Keyword index, NULL if not built or invalidated */
+    char                pt_frozen; /* Read-only, may be shared between handles, see pt_freeze */
+    struct pt_help     *pt_help;   /* PT_HELP_MODES rendered help tables, or NULL, see pt_help_get */
+    uint32_t            pt_gen;    /* Incremented when the level is modified, see pt_index_reset */
+    parse_tree         *pt_source; /* Shadow parse-tree: static original level, see pt_help_source_set */
+    uint32_t            pt_source_gen;  /* Shadow parse-tree: pt_gen of original when expanded */
+    char                pt_source_hide; /* Shadow parse-tree: hidden commands excluded */
+    char                pt_shadow; /* Shadow parse-tree, no own keyword index, see pt_index_source_set */
+    parse_tree         *pt_mirror; /* Shadow parse-tree: original level with children in the
+				      same positions, whose keyword index is used */
+    uint32_t            pt_mirror_gen;  /* Shadow parse-tree: pt_gen of pt_mirror when expanded */
+    char                pt_sorted; /* Sorted in collation pt_sorted-1, or 0, see pt_sorted_get */
 };
 
+/*! Free rendered help tables of a parse-tree level
+ * @param[in]  pt  Parse tree
+ * @see pt_help_get
+ */
+static void
+pt_help_reset(parse_tree *pt)
+{
+    struct pt_help *ph;
+    int             i;
+
+    if ((ph = pt->pt_help) == NULL)
+	return;
+    for (i=0; i<PT_HELP_MODES; i++){
+	if (ph[i].ph_matchvec)
+	    free(ph[i].ph_matchvec);
+	if (ph[i].ph_buf)
+	    free(ph[i].ph_buf);
+    }
+    free(ph);
+    pt->pt_help = NULL;
+}
+
+/*! Mark a parse-tree level as modified, except its keyword index
+ * Rendered help tables are freed and the level may no longer be sorted.
+ * @param[in]  pt  Parse tree
+ * @see pt_index_reset
+ */
+static void
+pt_modified(parse_tree *pt)
+{
+    pt->pt_gen++;
+    pt->pt_sorted = 0;
+    pt_help_reset(pt);
+}
+
+/*! Free a keyword index
+ */
+static void
+pt_index_free(struct pt_index *pi)
+{
+    if (pi->pi_cmdkey)
+	free(pi->pi_cmdkey);
+    if (pi->pi_cmdpos)
+	free(pi->pi_cmdpos);
+    if (pi->pi_othervec)
+	free(pi->pi_othervec);
+    free(pi);
+}
+
+/*! Free keyword index and rendered help tables of a parse-tree level
+ * The index is rebuilt on next lookup, and help is rendered again when next shown.
+ * Must be called whenever the child vector is modified, except by pt_vec_i_insert and
+ * pt_vec_i_delete which keep the index up to date. Also call it if objects of the
+ * level are modified in place, eg their help texts.
+ * @param[in]  pt  Parse tree
+ * @see pt_index_lookup
+ * @see pt_help_get
+ */
+void
+pt_index_reset(parse_tree *pt)
+{
+    if (pt == NULL)
+	return;
+    pt_modified(pt);
+    if (pt->pt_index == NULL)
+	return;
+    pt_index_free(pt->pt_index);
+    pt->pt_index = NULL;
+}
+
+/*! Entry of a keyword index while it is built: the command string and its position
+ * @see pt_index_build
+ */
+struct pt_index_entry{
+    char               *pie_key;   /* co_command of child (not copied) */
+    int                 pie_pos;   /* Position of child in pt_vec */
+};
+
+/*! Help function to qsort for sorting keyword index entries
+ * Sort on keyword and then on position, so that duplicates keep vector order
+ */
+static int
+pie_cmp(const void *arg1,
+	const void *arg2)
+{
+    struct pt_index_entry *pie1 = (struct pt_index_entry *)arg1;
+    struct pt_index_entry *pie2 = (struct pt_index_entry *)arg2;
+    int                    eq;
+
+    if ((eq = strcmp(pie1->pie_key, pie2->pie_key)) != 0)
+	return eq;
+    return pie1->pie_pos - pie2->pie_pos;
+}
+
+/*! Check if a child of a parse-tree level is in the sorted part of the keyword index
+ * Escaped commands match differently depending on mode, see match_object
+ */
+static int
+pt_index_cmd(cg_obj *co)
+{
+    return co && co->co_type == CO_COMMAND && co->co_command && *co->co_command != '\"';
+}
+
+/*! Find the first command of a keyword index whose keyword is not less than a key
+ * @param[in]  pi   Keyword index
+ * @param[in]  key  Keyword or prefix
+ * @retval     i    Position in pi_cmdkey, pi_cmdlen if all keywords are less
+ */
+static int
+pt_index_first(struct pt_index *pi,
+	       char            *key)
+{
+    int low = 0;
+    int upp = pi->pi_cmdlen;
+    int mid;
+
+    while (low < upp){
+	mid = (low + upp) / 2;
+	if (strcmp(pi->pi_cmdkey[mid], key) < 0)
+	    low = mid + 1;
+	else
+	    upp = mid;
+    }
+    return low;
+}
+
+/*! Build keyword index of a parse-tree level
+ * @param[in]  pt  Parse tree
+ * @retval     0   OK
+ * @retval    -1   Error
+ */
+static int
+pt_index_build(parse_tree *pt)
+{
+    int                    retval = -1;
+    struct pt_index       *pi = NULL;
+    struct pt_index_entry *pie = NULL;
+    cg_obj                *co;
+    int                    i;
+
+    if ((pi = malloc(sizeof(*pi))) == NULL)
+	goto done;
+    memset(pi, 0, sizeof(*pi));
+    pi->pi_size = pt->pt_size;
+    if ((pi->pi_cmdkey = malloc(pi->pi_size*sizeof(char *))) == NULL ||
+	(pi->pi_cmdpos = malloc(pi->pi_size*sizeof(int))) == NULL ||
+	(pi->pi_othervec = malloc(pi->pi_size*sizeof(int))) == NULL ||
+	(pie = malloc(pi->pi_size*sizeof(struct pt_index_entry))) == NULL)
+	goto done;
+    for (i=0; i<pt->pt_len; i++){
+	if ((co = pt->pt_vec[i]) == NULL)
+	    continue;
+	if (pt_index_cmd(co)){
+	    pie[pi->pi_cmdlen].pie_key = co->co_command;
+	    pie[pi->pi_cmdlen].pie_pos = i;
+	    pi->pi_cmdlen++;
+	}
+	else
+	    pi->pi_othervec[pi->pi_otherlen++] = i;
+    }
+    qsort(pie, pi->pi_cmdlen, sizeof(struct pt_index_entry), pie_cmp);
+    for (i=0; i<pi->pi_cmdlen; i++){
+	pi->pi_cmdkey[i] = pie[i].pie_key;
+	pi->pi_cmdpos[i] = pie[i].pie_pos;
+    }
+    pt->pt_index = pi;
+    pi = NULL;
+    retval = 0;
+ done:
+    if (pie)
+	free(pie);
+    if (pi)
+	pt_index_free(pi);
+    return retval;
+}
+
+/*! Update the keyword index of a parse-tree level after a child is inserted
+ * Positions after the child are shifted, and the child is added in keyword order.
+ * @param[in]  pt   Parse tree, pt_vec and pt_len are updated
+ * @param[in]  pos  Position of the inserted child
+ * @param[in]  co   Inserted child (can be NULL)
+ * @retval     0    OK
+ * @retval    -1    Error, reset the index
+ */
+static int
+pt_index_insert(parse_tree *pt,
+		int         pos,
+		cg_obj     *co)
+{
+    struct pt_index *pi = pt->pt_index;
+    void            *p;
+    int              low;
+    int              upp;
+    int              mid;
+    int              eq;
+    int              i;
+
+    if (pi->pi_size < pt->pt_size){
+	if ((p = realloc(pi->pi_cmdkey, pt->pt_size*sizeof(char *))) == NULL)
+	    return -1;
+	pi->pi_cmdkey = p;
+	if ((p = realloc(pi->pi_cmdpos, pt->pt_size*sizeof(int))) == NULL)
+	    return -1;
+	pi->pi_cmdpos = p;
+	if ((p = realloc(pi->pi_othervec, pt->pt_size*sizeof(int))) == NULL)
+	    return -1;
+	pi->pi_othervec = p;
+	pi->pi_size = pt->pt_size;
+    }
+    for (i=0; i<pi->pi_cmdlen; i++)
+	if (pi->pi_cmdpos[i] >= pos)
+	    pi->pi_cmdpos[i]++;
+    for (i=0; i<pi->pi_otherlen; i++)
+	if (pi->pi_othervec[i] >= pos)
+	    pi->pi_othervec[i]++;
+    if (co == NULL)
+	return 0;
+    if (pt_index_cmd(co)){
+	/* Same order as pie_cmp */
+	low = 0;
+	upp = pi->pi_cmdlen;
+	while (low < upp){
+	    mid = (low + upp) / 2;
+	    if ((eq = strcmp(pi->pi_cmdkey[mid], co->co_command)) == 0)
+		eq = pi->pi_cmdpos[mid] - pos;
+	    if (eq < 0)
+		low = mid + 1;
+	    else
+		upp = mid;
+	}
+	memmove(&pi->pi_cmdkey[low+1], &pi->pi_cmdkey[low],
+		(pi->pi_cmdlen - low)*sizeof(char *));
+	memmove(&pi->pi_cmdpos[low+1], &pi->pi_cmdpos[low],
+		(pi->pi_cmdlen - low)*sizeof(int));
+	pi->pi_cmdkey[low] = co->co_command;
+	pi->pi_cmdpos[low] = pos;
+	pi->pi_cmdlen++;
+    }
+    else{
+	for (low=0; low<pi->pi_otherlen && pi->pi_othervec[low] < pos; low++)
+	    ;
+	memmove(&pi->pi_othervec[low+1], &pi->pi_othervec[low],
+		(pi->pi_otherlen - low)*sizeof(int));
+	pi->pi_othervec[low] = pos;
+	pi->pi_otherlen++;
+    }
+    return 0;
+}
+
+/*! Update the keyword index of a parse-tree level before a child is deleted
+ * The child is removed from the index and positions after it are shifted.
+ * @param[in]  pt   Parse tree, child still in pt_vec
+ * @param[in]  pos  Position of the child to delete
+ */
+static void
+pt_index_delete(parse_tree *pt,
+		int         pos)
+{
+    struct pt_index *pi = pt->pt_index;
+    cg_obj          *co = pt->pt_vec[pos];
+    int              i;
+    int              n;
+
+    if (pt_index_cmd(co)){
+	for (i=0, n=0; i<pi->pi_cmdlen; i++){
+	    if (pi->pi_cmdpos[i] == pos)
+		continue;
+	    pi->pi_cmdkey[n] = pi->pi_cmdkey[i];
+	    pi->pi_cmdpos[n] = pi->pi_cmdpos[i];
+	    if (pi->pi_cmdpos[n] > pos)
+		pi->pi_cmdpos[n]--;
+	    n++;
+	}
+	pi->pi_cmdlen = n;
+    }
+    else
+	for (i=0; i<pi->pi_cmdlen; i++)
+	    if (pi->pi_cmdpos[i] > pos)
+		pi->pi_cmdpos[i]--;
+    for (i=0, n=0; i<pi->pi_otherlen; i++){
+	if (pi->pi_othervec[i] == pos)
+	    continue;
+	pi->pi_othervec[n] = pi->pi_othervec[i];
+	if (pi->pi_othervec[n] > pos)
+	    pi->pi_othervec[n]--;
+	n++;
+    }
+    pi->pi_otherlen = n;
+}
+
+/*! Get the keyword index to use for a parse-tree level, build it if needed
+ *
+ * A shadow level made by pt_expand has no index of its own, since it is made for
+ * every token. It uses the index of its original level if it has the same children
+ * in the same positions, see pt_index_source_set.
+ * @param[in]  pt   Parse tree, at least PT_INDEX_MIN children
+ * @param[out] pip  Keyword index, if retval is 1
+ * @retval     1    OK, pip set
+ * @retval     0    No index, scan linearly
+ * @retval    -1    Error
+ */
+static int
+pt_index_get(parse_tree       *pt,
+	     struct pt_index **pip)
+{
+    parse_tree *pto = pt;
+
+    if (pt->pt_shadow){
+	if ((pto = pt->pt_mirror) == NULL ||
+	    pto->pt_gen != pt->pt_mirror_gen || pto->pt_len != pt->pt_len)
+	    return 0;
+    }
+    if (pto->pt_index == NULL){
+	if (pto->pt_frozen) /* May be shared between threads */
+	    return 0;
+	if (pt_index_build(pto) < 0)
+	    return -1;
+    }
+    *pip = pto->pt_index;
+    return 1;
+}
+
+/*! Find children of a parse-tree level that may match a token using the keyword index
+ *
+ * Returns the positions of all commands that have prefix as prefix, in keyword order,
+ * and of all children that are not indexed (eg variables), in vector order. Commands
+ * not returned cannot match the token. The positions are returned in place in the
+ * index and are valid until the level, or the original level of a shadow level, is
+ * modified.
+ * The index is built on first lookup and kept until the level is modified.
+ * @param[in]  pt      Parse tree
+ * @param[in]  prefix  Token to match
+ * @param[out] pir     Positions of commands and of other children
+ * @retval     1       OK, pir set
+ * @retval     0       Index not applicable (small level, shadow level that does not
+ *                     mirror its original, or empty prefix), scan linearly
+ * @retval    -1       Error
+ * @see PT_INDEX_MIN
+ */
+int
+pt_index_lookup(parse_tree     *pt,
+		char           *prefix,
+		pt_index_range *pir)
+{
+    struct pt_index *pi;
+    size_t           len;
+    int              low;
+    int              i;
+    int              ret;
+
+    if (pt == NULL || pir == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (pt->pt_len < PT_INDEX_MIN || prefix == NULL || (len = strlen(prefix)) == 0)
+	return 0;
+    if ((ret = pt_index_get(pt, &pi)) != 1)
+	return ret;
+    /* All keywords with prefix are consecutive from the first keyword >= prefix */
+    low = pt_index_first(pi, prefix);
+    for (i=low; i<pi->pi_cmdlen; i++)
+	if (strncmp(pi->pi_cmdkey[i], prefix, len) != 0)
+	    break;
+    pir->pir_cmdvec = &pi->pi_cmdpos[low];
+    pir->pir_cmdlen = i - low;
+    pir->pir_othervec = pi->pi_othervec;
+    pir->pir_otherlen = pi->pi_otherlen;
+    return 1;
+}
+
+/*! Find the unique command of a parse-tree level whose keyword is equal to a token
+ *
+ * Large levels use the keyword index, smaller levels are scanned linearly.
+ * Escaped commands are not considered.
+ * @param[in]  pt      Parse tree
+ * @param[in]  key     Token to match exactly
+ * @param[out] posp    Position of command in pt (if retval is 1)
+ * @retval     1       OK, unique command found
+ * @retval     0       No command, or several commands, with this keyword
+ * @retval    -1       Error
+ * @see pt_index_lookup
+ */
+int
+pt_index_exact(parse_tree *pt,
+	       char       *key,
+	       int        *posp)
+{
+    struct pt_index *pi = NULL;
+    cg_obj          *co;
+    int              n = 0;
+    int              low;
+    int              i;
+
+    if (pt == NULL || posp == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (key == NULL || *key == '\0')
+	return 0;
+    if (pt->pt_len >= PT_INDEX_MIN && pt_index_get(pt, &pi) < 0)
+	return -1;
+    if (pi == NULL){
+	for (i=0; i<pt->pt_len; i++){
+	    if ((co = pt->pt_vec[i]) == NULL)
+		continue;
+	    if (pt_index_cmd(co) && strcmp(co->co_command, key) == 0){
+		*posp = i;
+		n++;
+	    }
+	}
+	return n == 1;
+    }
+    low = pt_index_first(pi, key);
+    if (low == pi->pi_cmdlen || strcmp(pi->pi_cmdkey[low], key) != 0)
+	return 0;
+    /* Duplicates are consecutive */
+    if (low+1 < pi->pi_cmdlen && strcmp(pi->pi_cmdkey[low+1], key) == 0)
+	return 0;
+    *posp = pi->pi_cmdpos[low];
+    return 1;
+}
+
+/*! Let a shadow parse-tree use the keyword index of its original level
+ *
+ * The shadow level has no index of its own. If it has the same children in the same
+ * positions as the original level, ie no hidden commands were excluded and no
+ * variables were expanded, the index of the original is used, see pt_index_lookup.
+ * @param[in]  ptn   Shadow parse-tree, see pt_expand
+ * @param[in]  pt    Original level, or NULL if the children are not in the same positions
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+pt_index_source_set(parse_tree *ptn,
+		    parse_tree *pt)
+{
+    if (ptn == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    if (pt && pt->pt_len != ptn->pt_len)
+	pt = NULL;
+    ptn->pt_shadow = 1;
+    ptn->pt_mirror = pt;
+    ptn->pt_mirror_gen = pt ? pt->pt_gen : 0;
+    return 0;
+}
+
+/*! Mark a shadow parse-tree as an expansion of a static level
+ *
+ * A static level has no choice or expand variables, so that its expansion only depends
+ * on the level itself and on whether hidden commands are excluded. Help tables rendered
+ * from the shadow level can then be cached in the original level, see pt_help_get.
+ * Frozen levels are not marked, since they may be shared between threads.
+ * @param[in]  ptn   Shadow parse-tree, see pt_expand
+ * @param[in]  pt    Original level, or NULL if not static
+ * @param[in]  hide  Hidden commands are excluded from ptn
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+pt_help_source_set(parse_tree *ptn,
+		   parse_tree *pt,
+		   int         hide)
+{
+    if (ptn == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    if (pt && pt->pt_frozen)
+	pt = NULL;
+    ptn->pt_source = pt;
+    ptn->pt_source_gen = pt ? pt->pt_gen : 0;
+    ptn->pt_source_hide = hide;
+    return 0;
+}
+
+/*! Find the cached help table of a shadow parse-tree level in its original level
+ * @param[in]  ptn       Shadow parse-tree of matched commands, see pt_help_source_set
+ * @param[in]  hk        Settings of the rendering
+ * @param[in]  matchvec  Positions of matched commands in ptn
+ * @param[in]  matchlen  Length of matchvec
+ * @param[out] bufp      Rendered table, owned by the parse-tree (if retval is 1)
+ * @param[out] lenp      Length of rendered table (if retval is 1)
+ * @retval     1         Found
+ * @retval     0         Not found, not rendered with these settings or level not static
+ * @retval    -1         Error
+ * @see pt_help_set
+ */
+int
+pt_help_get(parse_tree  *ptn,
+	    pt_help_key *hk,
+	    int         *matchvec,
+	    int          matchlen,
+	    char       **bufp,
+	    size_t      *lenp)
+{
+    parse_tree     *pt;
+    struct pt_help *ph;
+
+    if (ptn == NULL || hk == NULL || bufp == NULL || lenp == NULL ||
+	hk->hk_mode >= PT_HELP_MODES){
+	errno = EINVAL;
+	return -1;
+    }
+    if ((pt = ptn->pt_source) == NULL || pt->pt_gen != ptn->pt_source_gen ||
+	pt->pt_help == NULL)
+	return 0;
+    ph = &pt->pt_help[hk->hk_mode];
+    if (ph->ph_buf == NULL ||
+	ph->ph_key.hk_width != hk->hk_width ||
+	ph->ph_key.hk_lines != hk->hk_lines ||
+	ph->ph_key.hk_truncate != hk->hk_truncate ||
+	ph->ph_hide != ptn->pt_source_hide ||
+	ph->ph_matchlen != matchlen ||
+	memcmp(ph->ph_matchvec, matchvec, matchlen*sizeof(int)) != 0)
+	return 0;
+    *bufp = ph->ph_buf;
+    *lenp = ph->ph_len;
+    return 1;
+}
+
+/*! Cache a help table rendered from a shadow parse-tree level in its original level
+ * Replaces an earlier table of the same layout. Nothing is cached if the level is not static.
+ * @param[in]  ptn       Shadow parse-tree of matched commands, see pt_help_source_set
+ * @param[in]  hk        Settings of the rendering
+ * @param[in]  matchvec  Positions of matched commands in ptn
+ * @param[in]  matchlen  Length of matchvec
+ * @param[in]  buf       Rendered table, copied
+ * @param[in]  len       Length of buf
+ * @retval     0         OK
+ * @retval    -1         Error
+ * @see pt_help_get
+ */
+int
+pt_help_set(parse_tree  *ptn,
+	    pt_help_key *hk,
+	    int         *matchvec,
+	    int          matchlen,
+	    char        *buf,
+	    size_t       len)
+{
+    parse_tree     *pt;
+    struct pt_help *ph;
+
+    if (ptn == NULL || hk == NULL || buf == NULL || hk->hk_mode >= PT_HELP_MODES){
+	errno = EINVAL;
+	return -1;
+    }
+    if ((pt = ptn->pt_source) == NULL || pt->pt_gen != ptn->pt_source_gen)
+	return 0;
+    if (pt->pt_help == NULL &&
+	(pt->pt_help = calloc(PT_HELP_MODES, sizeof(struct pt_help))) == NULL)
+	return -1;
+    ph = &pt->pt_help[hk->hk_mode];
+    if (ph->ph_matchvec)
+	free(ph->ph_matchvec);
+    if (ph->ph_buf)
+	free(ph->ph_buf);
+    memset(ph, 0, sizeof(*ph));
+    if ((ph->ph_matchvec = malloc(matchlen*sizeof(int) + 1)) == NULL)
+	return -1;
+    memcpy(ph->ph_matchvec, matchvec, matchlen*sizeof(int));
+    ph->ph_matchlen = matchlen;
+    if ((ph->ph_buf = malloc(len + 1)) == NULL)
+	return -1;
+    memcpy(ph->ph_buf, buf, len);
+    ph->ph_buf[len] = '\0';
+    ph->ph_len = len;
+    ph->ph_key = *hk;
+    ph->ph_hide = ptn->pt_source_hide;
+    return 0;
+}
+
 /*! Access function to get the i:th CLIgen object child of a parse-tree
  * @param[in]  pt  Parse tree
  * @param[in]  i   Which object to return
@@ -115,10 +735,12 @@ pt_vec_i_clear(parse_tree *pt,
 	return -1;
     }
     pt->pt_vec[i] = NULL;
+    pt_index_reset(pt);
     return 0;
 }
 
 /*! Insert the i:th CLIgen object child of a parse-tree
+ * A keyword index of the level is updated, not rebuilt.
  * @param[in]  pt  Parse tree
  * @param[in]  i   Which position to insert
  * @param[in]  co  Object to insert (can be NULL)
@@ -142,6 +764,10 @@ pt_vec_i_insert(parse_tree *pt,
 		&pt->pt_vec[i], 
 		size);
     pt->pt_vec[i] = co;
+    if (pt->pt_index && pt_index_insert(pt, i, co) == 0)
+	pt_modified(pt);
+    else
+	pt_index_reset(pt);
     retval = 0;
  done:
     return retval;
@@ -154,6 +780,49 @@ pt_vec_append(parse_tree *pt,
     return pt_vec_i_insert(pt, pt_len_get(pt), co);
 }
 
+/*! Append a CLIgen object to a parse-tree without sorting it or looking for duplicates
+ *
+ * Use this when adding many objects at once, followed by a single pt_coalesce() which
+ * sorts the parse-tree and merges equal objects, instead of calling co_insert() for 
+ * each object. Until then the parse-tree is unsorted and may contain duplicates, and
+ * should not be modified in other ways.
+ * Equal objects are merged into the one with lowest order, which need not be the first
+ * appended since objects may be moved between parse-trees when coalescing. 
+ * @param[in]  pt    Parse tree
+ * @param[in]  co    Object to append (can be NULL)
+ * @param[in]  order Creation order of co, or 0 to merge equal objects in append order
+ * @retval     0     OK
+ * @retval    -1     Error
+ * @see pt_coalesce
+ */
+int
+pt_bulk_append(parse_tree *pt,
+	       cg_obj     *co,
+	       uint32_t    order)
+{
+    if (pt == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    if (pt_realloc(pt) < 0)
+	return -1;
+    if (order && pt->pt_order == NULL &&
+	(pt->pt_order = calloc(pt->pt_size, sizeof(uint32_t))) == NULL)
+	return -1;
+    pt->pt_vec[pt_len_get(pt)-1] = co;
+    if (pt->pt_order)
+	pt->pt_order[pt_len_get(pt)-1] = order;
+    pt->pt_appended++;
+    return 0;
+}
+
+/*! Delete and free the i:th CLIgen object child of a parse-tree
+ * A keyword index of the level is updated, not rebuilt, and a sorted level stays sorted.
+ * @param[in]  pt  Parse tree
+ * @param[in]  i   Which position to delete
+ * @retval     0   OK
+ * @retval    -1   Error
+ */
 int
 pt_vec_i_delete(parse_tree *pt,
 		int         i)
@@ -161,6 +830,7 @@ pt_vec_i_delete(parse_tree *pt,
     int       retval = -1;
     size_t    size;
     cg_obj   *co;
+    char      sorted;
     
     if (pt == NULL){
        errno = EINVAL;
@@ -175,13 +845,22 @@ pt_vec_i_delete(parse_tree *pt,
 	goto done;
     }
     co = pt->pt_vec[i];
+    sorted = pt->pt_sorted;
+    if (pt->pt_index){
+	pt_index_delete(pt, i);
+	pt_modified(pt);
+    }
+    else
+	pt_index_reset(pt);
     pt->pt_vec[i] = NULL;
-    co_free(co, 1);
+    if (co)
+	co_free(co, 1);
     if ((size = (pt_len_get(pt) - (i+1))*sizeof(cg_obj*)) != 0)
 	memmove(&pt->pt_vec[i], 
 		&pt->pt_vec[i+1], 
 		size);
     pt->pt_len--;
+    pt->pt_sorted = sorted; /* Removing an object keeps the order */
     retval = 0;
  done:
     return retval;
@@ -253,6 +932,167 @@ pt_sets_set(parse_tree *pt,
     return 0;
 }
 
+/*! Get borrow flag of a shadow parse-tree
+ * @param[in]  pt   Parse tree
+ * @retval     1    Objects in pt without co_ref are not owned by pt
+ * @retval     0    All objects in pt are owned by pt
+ * @see pt_expand
+ */
+int
+pt_borrow_get(parse_tree *pt)
+{
+    if (pt == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    return pt->pt_borrow;
+}
+
+/*! Set borrow flag of a shadow parse-tree
+ * If set, objects in pt that have no co_ref are references to original objects
+ * and are not freed by pt_free
+ * @param[in]  pt     Parse tree
+ * @param[in]  borrow 0 or 1
+ * @see pt_expand
+ */
+int
+pt_borrow_set(parse_tree *pt,
+	      int         borrow)
+{
+    if (pt == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    pt->pt_borrow = borrow;
+    return 0;
+}
+
+/*! Check if a parse-tree level is known to be sorted in the current collation
+ * A level is sorted by cligen_parsetree_sort and pt_coalesce, and stays sorted when
+ * objects are added with co_insert or removed. Other modifications reset the flag.
+ * @param[in]  pt   Parse tree
+ * @retval     1    pt is sorted, see co_collation
+ * @retval     0    pt may not be sorted
+ * @see pt_expand_match  Original levels are sorted once, not on every expansion
+ */
+int
+pt_sorted_get(parse_tree *pt)
+{
+    if (pt == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    return pt->pt_sorted == co_collation() + 1;
+}
+
+/*! Mark a parse-tree level as sorted, or not, in the current collation
+ * @param[in]  pt     Parse tree
+ * @param[in]  sorted 0 or 1
+ * @see pt_sorted_get
+ */
+int
+pt_sorted_set(parse_tree *pt,
+	      int         sorted)
+{
+    if (pt == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    pt->pt_sorted = sorted ? co_collation() + 1 : 0;
+    return 0;
+}
+
+/*! Get frozen flag of a parse-tree
+ * @param[in]  pt   Parse tree
+ * @retval     1    pt is read-only and may be shared between handles
+ * @retval     0    pt is owned and modified by a single handle
+ * @see pt_freeze
+ */
+int
+pt_frozen_get(parse_tree *pt)
+{
+    if (pt == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    return pt->pt_frozen;
+}
+
+/*! Freeze the cvecs of an object given to callbacks, so that they are only read
+ * @param[in]  co   CLIgen object
+ * @see cvec_freeze
+ */
+static int
+co_freeze_cvecs(cg_obj *co)
+{
+    struct cg_callback *cc;
+
+    if (co_cvec_get(co) && cvec_freeze(co_cvec_get(co)) < 0)
+	return -1;
+    if (co->co_type == CO_VARIABLE && co->co_expand_fn_vec &&
+	cvec_freeze(co->co_expand_fn_vec) < 0)
+	return -1;
+    for (cc = co_callbacks_get(co); cc; cc = cc->cc_next)
+	if (cc->cc_cvec && cvec_freeze(cc->cc_cvec) < 0)
+	    return -1;
+    return 0;
+}
+
+/*! Freeze a parse-tree recursively so that it can be shared between handles
+ *
+ * The tree is sorted and all levels, objects and their argument cvecs are marked as
+ * read-only. 
+ * State that is otherwise built lazily on first use is built here, since a frozen
+ * tree is never modified: the keyword index of wide levels and the name index of
+ * large cvecs. Help tables are not cached in frozen levels, see pt_help_source_set.
+ * Thereafter the same tree can be installed in several handles, also in different
+ * threads, with cligen_ph_parsetree_set(). Matching and expansion does not modify a
+ * frozen tree, instead per-handle state such as match flags and tree reference 
+ * expansions are kept in private copies, see pt_expand_treeref.
+ * A frozen tree is not freed by cligen_ph_free(), it is owned by the application
+ * and freed with pt_free() after all handles using it have exited.
+ * @param[in]  pt   Parse tree. Must not have been expanded or be in use by a handle
+ * @retval     0    OK
+ * @retval    -1    Error
+ * @code
+ *   pt = pt_new();
+ *   clispec_parse_file(h0, f, "tree", NULL, pt, NULL);
+ *   cligen_callbackv_str2fn(pt, str2fn, NULL);
+ *   pt_freeze(pt);
+ *   ph = cligen_ph_add(h1, "tree");
+ *   cligen_ph_parsetree_set(ph, pt);
+ *   ... same for h2, ...
+ * @endcode
+ */
+int
+pt_freeze(parse_tree *pt)
+{
+    cg_obj *co;
+    int     i;
+
+    if (pt == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    if (pt->pt_frozen)
+	return 0;
+    cligen_parsetree_sort(pt, 0);
+    if (pt->pt_len >= PT_INDEX_MIN && pt->pt_index == NULL &&
+	pt_index_build(pt) < 0)
+	return -1;
+    pt->pt_frozen = 1;
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL)
+	    continue;
+	co_flags_set(co, CO_FLAGS_FROZEN);
+	if (co_freeze_cvecs(co) < 0)
+	    return -1;
+	if (co_pt_get(co) && pt_freeze(co_pt_get(co)) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
 /*! Allocate a new parsetree
  * @see pt_free
  */
@@ -287,10 +1127,26 @@ pt_new(void)
 int 
 pt_realloc(parse_tree *pt)
 {
+    cg_obj  **vec;
+    int       size;
+    uint32_t *order;
+
+    pt_index_reset(pt);
+    /* Allocate larger cg_obj vector, grow geometrically so that appending is linear */
+    if (pt->pt_len >= pt->pt_size){
+	size = pt->pt_size ? 2*pt->pt_size : 1;
+	if ((vec = realloc(pt->pt_vec, size*sizeof(cg_obj *))) == NULL)
+	    return -1;
+	pt->pt_vec = vec;
+	if (pt->pt_order){
+	    if ((order = realloc(pt->pt_order, size*sizeof(uint32_t))) == NULL)
+		return -1;
+	    memset(&order[pt->pt_size], 0, (size - pt->pt_size)*sizeof(uint32_t));
+	    pt->pt_order = order;
+	}
+	pt->pt_size = size;
+    }
     pt->pt_len++;
-    /* Allocate larger cg_obj vector */
-    if ((pt->pt_vec = realloc(pt->pt_vec, (pt->pt_len)*sizeof(cg_obj *))) == 0)
-	return -1;
     pt->pt_vec[pt->pt_len - 1] = NULL; /* init field */
     return 0;
 }
@@ -333,6 +1189,7 @@ pt_copy(parse_tree *pt,
 	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
 	goto done;
     }
+    ptn->pt_size = pt_len_get(ptn);
     j=0;
     for (i=0; i<pt_len_get(pt); i++){
 	if ((co = pt_vec_i_get(pt, i)) != NULL){
@@ -343,6 +1200,7 @@ pt_copy(parse_tree *pt,
 	else
 	    ptn->pt_vec[j++] = NULL;
     }
+    ptn->pt_sorted = pt->pt_sorted; /* Same order */
     retval = 0;
  done:
     return retval;
@@ -381,62 +1239,35 @@ pt_dup(parse_tree *pt,
  * @param[in]     pt1     parse-tree 1. Merge this into pt0
  * @retval        0       OK
  * @retval        -1      Error
+ * @see pt_coalesce which merges equal objects in a single pass
  */
 int
 cligen_parsetree_merge(parse_tree *pt0, 
 		       cg_obj     *parent, 
 		       parse_tree *pt1)
 {
-    cg_obj *co0=NULL;
     cg_obj *co1;
     cg_obj *co1c;
-    int     i;
     int     j;
     int     retval = -1;
-    int     exist;
 
+    if (pt0 == NULL){
+	errno = EINVAL;
+	goto done;
+    }
     for (j=0; j<pt_len_get(pt1); j++){ 
-	co1 = pt_vec_i_get(pt1, j);
-	exist = 0;
-	for (i=0; i<pt_len_get(pt0); i++){
-	    co0 = pt_vec_i_get(pt0, i);
-	    if (co0 == NULL && co1 == NULL){
-		exist = 1;
-		break;
-	    }
-	    if (co0 && co1 && co_eq(co0, co1)==0){
-		if (co0->co_callbacks == NULL && co1->co_callbacks != NULL){
-		    /* Cornercase: co0 callback is NULL and co1 callback is not 
-		     * Copy from co1 to co0
-		     */
-		    if (co_callback_copy(co1->co_callbacks, &co0->co_callbacks) < 0)
-			goto done;
-		}
-		exist = 1;
-		break;
-	    }
-	} 
-	if (co1==NULL){ /* empty */
-	    if (exist)
-		continue;
-	    if (pt_realloc(pt0) < 0)
-		goto done;
-	    pt0->pt_vec[pt_len_get(pt0)-1] = NULL;
-	    continue;
-	}
-	if (exist){
-	    if (cligen_parsetree_merge(co_pt_get(co0), co0, co_pt_get(co1)) < 0)
-		goto done;
-	}
-	else{
-	    if (pt_realloc(pt0) < 0)
-		goto done;
-	    if (co_copy(co1, parent, &co1c) < 0)
-		goto done;
-	    pt0->pt_vec[pt_len_get(pt0)-1] = co1c;
+	co1c = NULL;
+	if ((co1 = pt_vec_i_get(pt1, j)) != NULL &&
+	    co_copy(co1, parent, &co1c) < 0)
+	    goto done;
+	if (pt_bulk_append(pt0, co1c, 0) < 0){
+	    if (co1c)
+		co_free(co1c, 1);
+	    goto done;
 	}
     }
-    cligen_parsetree_sort(pt0, 0);
+    if (pt_coalesce(pt0, PT_COALESCE_MERGE) < 0)
+	goto done;
     retval = 0;
   done:
     return retval;
@@ -481,7 +1312,9 @@ cligen_parsetree_sort(parse_tree *pt,
     int         i;
     parse_tree *pt1;
     
+    pt_index_reset(pt);
     qsort(pt->pt_vec, pt_len_get(pt), sizeof(cg_obj*), co_cmp);
+    pt->pt_sorted = co_collation() + 1;
     for (i=0; i<pt_len_get(pt); i++){
 	if ((co = pt_vec_i_get(pt, i)) == NULL)
 	    continue;
@@ -496,6 +1329,525 @@ cligen_parsetree_sort(parse_tree *pt,
     }
 }
 
+/*! Sort objects of pt1 and merge them into the sorted parse-tree level pt
+ *
+ * Use this instead of cligen_parsetree_sort when a few unsorted objects are added to a
+ * level whose other objects are already in order: only pt1 is sorted.
+ * Equal objects are not merged, objects of pt are placed before equal objects of pt1.
+ * @param[in,out] pt   Parse-tree in sorted order, see pt_sorted_get
+ * @param[in,out] pt1  Objects to add, moved to pt. pt1 is empty on exit
+ * @retval        0    OK
+ * @retval       -1    Error
+ */
+int
+pt_sort_merge(parse_tree *pt,
+	      parse_tree *pt1)
+{
+    cg_obj **vec;
+    int      len;
+    int      len1;
+    int      i = 0;
+    int      j = 0;
+    int      k = 0;
+
+    if (pt == NULL || pt1 == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    if ((len1 = pt_len_get(pt1)) == 0)
+	return 0;
+    len = pt_len_get(pt);
+    if ((vec = malloc((len+len1)*sizeof(cg_obj *))) == NULL)
+	return -1;
+    qsort(pt1->pt_vec, len1, sizeof(cg_obj*), co_cmp);
+    while (i < len || j < len1){
+	if (j == len1 || (i < len && co_cmp(&pt->pt_vec[i], &pt1->pt_vec[j]) <= 0))
+	    vec[k++] = pt->pt_vec[i++];
+	else
+	    vec[k++] = pt1->pt_vec[j++];
+    }
+    if (pt->pt_vec)
+	free(pt->pt_vec);
+    if (pt->pt_order){ /* Creation order is not kept */
+	free(pt->pt_order);
+	pt->pt_order = NULL;
+    }
+    pt->pt_vec = vec;
+    pt->pt_len = pt->pt_size = len + len1;
+    pt_index_reset(pt);
+    pt->pt_sorted = co_collation() + 1;
+    pt1->pt_len = 0;
+    pt_index_reset(pt1);
+    return 0;
+}
+
+/*! Add the commands of a parse-tree fragment to a live parse-tree without rebuilding it
+ *
+ * Each object of pt1 is inserted in order into pt with co_insert_merge(): objects
+ * equal to an existing object are merged into it level by level, and new objects are
+ * moved into pt with their children. Only the levels that get new objects are
+ * modified: they stay sorted and their keyword indexes are updated in place.
+ * Callbacks of an added command are used if the existing command has none.
+ * pt1 is typically parsed from a clispec fragment with cligen_parse_str(). Its
+ * objects are moved, so it is empty on return and is freed by the caller.
+ * @param[in]  pt      Parse-tree, sorted, not frozen
+ * @param[in]  parent  Object whose children pt is, or NULL if pt is a top level
+ * @param[in]  pt1     Parse-tree fragment, emptied
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @code
+ *   parse_tree *pt1 = pt_new();
+ *   if (cligen_parse_str(h, "a b <x:int32>, cb();", "delta", pt1, NULL) < 0)
+ *      err;
+ *   if (cligen_callbackv_str2fn(pt1, str2fn, NULL) < 0)
+ *      err;
+ *   if (pt_delta_add(pt, NULL, pt1) < 0)
+ *      err;
+ *   pt_free(pt1, 1);
+ * @endcode
+ * @see pt_delta_del
+ * @see cligen_ph_delta_add  Also invalidates tree reference expansions
+ */
+int
+pt_delta_add(parse_tree *pt,
+	     cg_obj     *parent,
+	     parse_tree *pt1)
+{
+    cg_obj *co1;
+    int     i;
+
+    if (pt == NULL || pt1 == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (pt_frozen_get(pt) == 1){
+	errno = EPERM;
+	return -1;
+    }
+    if (pt_sorted_get(pt) != 1)
+	cligen_parsetree_sort(pt, 0);
+    for (i=0; i<pt_len_get(pt1); i++){
+	if ((co1 = pt1->pt_vec[i]) != NULL)
+	    co_up_set(co1, parent);
+	if (co_insert_merge(pt, co1, 1, NULL) < 0)
+	    return -1;
+	pt1->pt_vec[i] = NULL;
+    }
+    pt1->pt_len = 0;
+    pt_index_reset(pt1);
+    return 0;
+}
+
+/*! Remove the commands of a parse-tree fragment from a live parse-tree
+ *
+ * A command of pt1 is a path ending with an end of command (NULL child), as made by
+ * cligen_parse_str(). The end of the command is removed from pt with its callbacks,
+ * and objects of the path left without children are removed. An object of pt1
+ * without children removes the whole sub-tree of the equal object of pt.
+ * Only the levels that lose objects are modified: they stay sorted and their keyword
+ * indexes are updated in place. Commands of pt1 not in pt are ignored.
+ * @param[in]  pt      Parse-tree, sorted, not frozen
+ * @param[in]  pt1     Parse-tree fragment, not modified
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @see pt_delta_add
+ * @see cligen_ph_delta_del  Also invalidates tree reference expansions
+ */
+int
+pt_delta_del(parse_tree *pt,
+	     parse_tree *pt1)
+{
+    cg_obj     *co;
+    cg_obj     *co1;
+    parse_tree *ptc;
+    parse_tree *ptc1;
+    int         pos;
+    int         i;
+
+    if (pt == NULL || pt1 == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (pt_frozen_get(pt) == 1){
+	errno = EPERM;
+	return -1;
+    }
+    if (pt_sorted_get(pt) != 1)
+	cligen_parsetree_sort(pt, 0);
+    for (i=0; i<pt_len_get(pt1); i++){
+	co1 = pt1->pt_vec[i];
+	if ((pos = co_find_eq(pt, co1)) < 0)
+	    continue; /* Not in pt */
+	if ((co = pt->pt_vec[pos]) == NULL){ /* End of command */
+	    if (pt_vec_i_delete(pt, pos) < 0)
+		return -1;
+	    continue;
+	}
+	if ((ptc1 = co_pt_get(co1)) != NULL && pt_len_get(ptc1) > 0 &&
+	    (ptc = co_pt_get(co)) != NULL && pt_len_get(ptc) > 0){
+	    if (pt_delta_del(ptc, ptc1) < 0)
+		return -1;
+	    /* The command ending here is removed with its callbacks */
+	    if (co_find_eq(ptc, NULL) < 0)
+		co_callbacks_free(co);
+	    if (pt_len_get(ptc) > 0)
+		continue;
+	}
+	if (pt_vec_i_delete(pt, pos) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/* Entry used when sorting a parse-tree level in pt_coalesce */
+struct pt_coalesce_entry{
+    cg_obj  *pce_co;       /* Child, or NULL for the empty child */
+    int      pce_appended; /* Added with pt_bulk_append */
+    uint32_t pce_order;    /* Creation order, see pt_bulk_append */
+    int      pce_pos;      /* Position in the child vector before sorting */
+};
+
+/*! Order equal coalesce entries so that the one to keep is first
+ * Existing before appended, then on creation order and position
+ */
+static int
+pce_first(struct pt_coalesce_entry *pce1,
+	  struct pt_coalesce_entry *pce2)
+{
+    if (pce1->pce_appended != pce2->pce_appended)
+	return pce1->pce_appended - pce2->pce_appended;
+    if (pce1->pce_order != pce2->pce_order)
+	return pce1->pce_order < pce2->pce_order ? -1 : 1;
+    return pce1->pce_pos - pce2->pce_pos;
+}
+
+/*! Help function to qsort for grouping coalesce entries of the same type
+ * co_cmp is not transitive when objects of different types are compared (on name) and 
+ * variables of the same type are compared on other attributes. Group on type first so
+ * that equal objects of the same type are adjacent
+ */
+static int
+pce_type_cmp(const void *arg1,
+	     const void *arg2)
+{
+    struct pt_coalesce_entry *pce1 = (struct pt_coalesce_entry *)arg1;
+    struct pt_coalesce_entry *pce2 = (struct pt_coalesce_entry *)arg2;
+    int                       eq;
+
+    if (pce1->pce_co && pce2->pce_co && pce1->pce_co->co_type != pce2->pce_co->co_type)
+	return pce1->pce_co->co_type - pce2->pce_co->co_type;
+    if ((eq = co_cmp(&pce1->pce_co, &pce2->pce_co)) != 0)
+	return eq;
+    return pce_first(pce1, pce2);
+}
+
+/*! Help function to qsort for grouping coalesce entries with the same name
+ * Objects of different types are equal if they have the same name, see co_eq
+ */
+static int
+pce_name_cmp(const void *arg1,
+	     const void *arg2)
+{
+    struct pt_coalesce_entry *pce1 = (struct pt_coalesce_entry *)arg1;
+    struct pt_coalesce_entry *pce2 = (struct pt_coalesce_entry *)arg2;
+    char                     *s1;
+    char                     *s2;
+    int                       eq;
+
+    s1 = pce1->pce_co ? pce1->pce_co->co_command : NULL;
+    s2 = pce2->pce_co ? pce2->pce_co->co_command : NULL;
+    if (s1 == NULL || s2 == NULL)
+	eq = (s1 != NULL) - (s2 != NULL);
+    else
+	eq = strcmp(s1, s2);
+    if (eq != 0)
+	return eq;
+    return pce_first(pce1, pce2);
+}
+
+/*! Help function to qsort for the final order of coalesced entries, as cligen_parsetree_sort
+ */
+static int
+pce_cmp(const void *arg1,
+	const void *arg2)
+{
+    struct pt_coalesce_entry *pce1 = (struct pt_coalesce_entry *)arg1;
+    struct pt_coalesce_entry *pce2 = (struct pt_coalesce_entry *)arg2;
+    int                       eq;
+
+    if ((eq = co_cmp(&pce1->pce_co, &pce2->pce_co)) != 0)
+	return eq;
+    return pce1->pce_pos - pce2->pce_pos;
+}
+
+/*! Merge an appended object into an equal object of the same parse-tree level
+ *
+ * The attributes of co1 are merged into co0 according to mode, and the children of 
+ * co1 are moved to co0 where they are coalesced later.
+ * @param[in]  co0   Object that is kept
+ * @param[in]  co1   Equal object that is merged into co0. Freed by caller
+ * @param[in]  mode  How to merge attributes, see pt_coalesce
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+pt_coalesce_obj(cg_obj               *co0,
+		cg_obj               *co1,
+		enum pt_coalesce_mode mode)
+{
+    int                  retval = -1;
+    struct cg_callback **ccp;
+    parse_tree          *pt0;
+    parse_tree          *pt1;
+    cg_obj              *co;
+    int                  i;
+    struct cg_obj_ext   *ext0;
+    struct cg_obj_ext   *ext1;
+
+    switch (mode){
+    case PT_COALESCE_INSERT:
+	break;
+    case PT_COALESCE_MERGE:
+	/* Cornercase: co0 callback is NULL and co1 callback is not, take co1:s */
+	if (co_callbacks_get(co0) == NULL && co_callbacks_get(co1) != NULL){
+	    if ((ext0 = co_ext_alloc(co0)) == NULL)
+		goto done;
+	    ext1 = co1->co_ext;
+	    ext0->ce_callbacks = ext1->ce_callbacks;
+	    ext1->ce_callbacks = NULL;
+	}
+	break;
+    case PT_COALESCE_PARSE:
+	ext0 = co0->co_ext;
+	ext1 = co1->co_ext;
+	if (ext1 != NULL && ext0 == NULL){ /* Take all of co1:s */
+	    co0->co_ext = ext1;
+	    co1->co_ext = NULL;
+	}
+	else if (ext1 != NULL){
+	    /* Callbacks are added in statement order */
+	    ccp = &ext0->ce_callbacks;
+	    while (*ccp != NULL)
+		ccp = &((*ccp)->cc_next);
+	    *ccp = ext1->ce_callbacks;
+	    ext1->ce_callbacks = NULL;
+	    /* The first help string is kept */
+	    if (ext0->ce_helpvec == NULL){
+		ext0->ce_helpvec = ext1->ce_helpvec;
+		ext1->ce_helpvec = NULL;
+	    }
+	    /* The last variables are kept */
+	    if (ext1->ce_cvec){
+		if (ext0->ce_cvec)
+		    cvec_free(ext0->ce_cvec);
+		ext0->ce_cvec = ext1->ce_cvec;
+		ext1->ce_cvec = NULL;
+	    }
+	}
+	co_flags_set(co0, co1->co_flags);
+	if (co_sets_get(co1))
+	    co_sets_set(co0, 1);
+	break;
+    }
+    if ((pt1 = co_pt_get(co1)) == NULL || pt_len_get(pt1) == 0)
+	goto ok;
+    for (i=0; i<pt_len_get(pt1); i++)
+	if ((co = pt_vec_i_get(pt1, i)) != NULL)
+	    co_up_set(co, co0);
+    if ((pt0 = co_pt_get(co0)) == NULL){ /* Move the whole parse-tree */
+	pt1->pt_appended = pt_len_get(pt1);
+	if (co_pt_set(co0, pt1) < 0)
+	    goto done;
+	co_pt_clear(co1);
+	goto ok;
+    }
+    for (i=0; i<pt_len_get(pt1); i++){
+	if (pt_bulk_append(pt0, pt1->pt_vec[i], pt1->pt_order?pt1->pt_order[i]:0) < 0)
+	    goto done;
+	pt1->pt_vec[i] = NULL;
+    }
+    pt1->pt_len = 0;
+    pt1->pt_appended = 0;
+    pt_index_reset(pt1);
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Check if two sorted coalesce entries are in the same run of equal objects
+ * @param[in]  pce1  First entry
+ * @param[in]  pce2  Second entry
+ * @param[in]  name  If set, same name and both not NULL. Else equal and of same type
+ */
+static int
+pce_same(struct pt_coalesce_entry *pce1,
+	 struct pt_coalesce_entry *pce2,
+	 int                       name)
+{
+    cg_obj *co1 = pce1->pce_co;
+    cg_obj *co2 = pce2->pce_co;
+
+    if (name)
+	return co1 && co2 && co1->co_command && co2->co_command &&
+	    strcmp(co1->co_command, co2->co_command) == 0;
+    if (co1 == NULL || co2 == NULL)
+	return co1 == co2;
+    return co1->co_type == co2->co_type && co_eq(co1, co2) == 0;
+}
+
+/*! Merge appended coalesce entries into equal entries sorted before them
+ *
+ * @param[in,out] vec   Sorted entries, compacted on exit. Merged objects are freed
+ * @param[in,out] lenp  Length of vec
+ * @param[in]     mode  How to merge objects, see pt_coalesce
+ * @param[in]     name  If set vec is sorted with pce_name_cmp, else with pce_type_cmp
+ * @retval        0     OK
+ * @retval       -1     Error, vec contains all objects not yet freed
+ */
+static int
+pt_coalesce_vec(struct pt_coalesce_entry *vec,
+		int                      *lenp,
+		enum pt_coalesce_mode     mode,
+		int                       name)
+{
+    int     retval = -1;
+    cg_obj *co;
+    cg_obj *co0;
+    int     len = *lenp;
+    int     n = 0;      /* Number of entries kept */
+    int     first = 0;  /* First kept entry of current run */
+    int     i;
+    int     k;
+
+    for (i=0; i<len; i++){
+	co = vec[i].pce_co;
+	if (n == 0 || !pce_same(&vec[first], &vec[i], name)){ /* First of a run */
+	    first = n;
+	    vec[n++] = vec[i];
+	    continue;
+	}
+	if (!vec[i].pce_appended){
+	    vec[n++] = vec[i];
+	    continue;
+	}
+	co0 = vec[first].pce_co;
+	/* Appended and in same run: find object to merge into */
+	if (name){
+	    for (k=first; k<n; k++)
+		if (vec[k].pce_co->co_type != co->co_type && co_eq(vec[k].pce_co, co) == 0)
+		    break;
+	    if (k == n){
+		vec[n++] = vec[i];
+		continue;
+	    }
+	    co0 = vec[k].pce_co;
+	}
+	if (co != NULL){
+	    if (pt_coalesce_obj(co0, co, mode) < 0){
+		for (; i<len; i++)
+		    vec[n++] = vec[i];
+		goto done;
+	    }
+	    co_free(co, 1);
+	}
+    }
+    retval = 0;
+ done:
+    *lenp = n;
+    return retval;
+}
+
+/*! Sort a parse-tree and merge objects appended with pt_bulk_append into equal objects
+ *
+ * This is the bulk variant of calling co_insert() for every appended object: the 
+ * parse-tree level is sorted once, and each appended object that is equal to an earlier
+ * object is merged into it and freed. Objects that were in the parse-tree before the
+ * appended objects are kept as is.
+ * The children of merged objects are then coalesced recursively, as well as all children
+ * that have appended objects themselves, so a whole tree built with pt_bulk_append is
+ * coalesced with one call on its top.
+ * The mode determines how the attributes of two equal objects are merged:
+ * - PT_COALESCE_INSERT: as co_insert(), only the children of the appended object are merged,
+ *   and below that as PT_COALESCE_MERGE
+ * - PT_COALESCE_MERGE: as cligen_parsetree_merge(), callbacks of the appended object are 
+ *   used if the existing object has none
+ * - PT_COALESCE_PARSE: as repeated clispec statements, callbacks are appended, flags and
+ *   sets are added, the first help text and the last variables are used
+ * @param[in]  pt    Parse tree
+ * @param[in]  mode  How to merge equal objects, see enum pt_coalesce_mode
+ * @retval     0     OK
+ * @retval    -1     Error
+ * @see pt_bulk_append
+ */
+int
+pt_coalesce(parse_tree           *pt,
+	    enum pt_coalesce_mode mode)
+{
+    int                       retval = -1;
+    struct pt_coalesce_entry *vec = NULL;
+    cg_obj                   *co;
+    parse_tree               *ptc;
+    int                       from;
+    int                       len;
+    int                       i;
+    int                       ret = 0;
+
+    if (pt == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    if ((len = pt_len_get(pt)) == 0 || pt->pt_appended == 0)
+	goto children;
+    if (len == 1) /* Nothing to sort or merge */
+	goto sorted;
+    from = pt->pt_appended < len ? len - pt->pt_appended : 0;
+    if ((vec = malloc(len*sizeof(*vec))) == NULL)
+	goto done;
+    for (i=0; i<len; i++){
+	vec[i].pce_co = pt->pt_vec[i];
+	vec[i].pce_appended = i >= from;
+	vec[i].pce_order = pt->pt_order ? pt->pt_order[i] : 0;
+	vec[i].pce_pos = i;
+    }
+    pt_index_reset(pt);
+    /* Merge equal objects of same type, then of different types with same name */
+    qsort(vec, len, sizeof(*vec), pce_type_cmp);
+    if ((ret = pt_coalesce_vec(vec, &len, mode, 0)) == 0){
+	qsort(vec, len, sizeof(*vec), pce_name_cmp);
+	ret = pt_coalesce_vec(vec, &len, mode, 1);
+    }
+    qsort(vec, len, sizeof(*vec), pce_cmp);
+    for (i=0; i<len; i++)
+	pt->pt_vec[i] = vec[i].pce_co;
+    pt->pt_len = len;
+ sorted:
+    pt->pt_appended = 0;
+    if (ret == 0)
+	pt->pt_sorted = co_collation() + 1;
+    if (pt->pt_order){
+	free(pt->pt_order);
+	pt->pt_order = NULL;
+    }
+    if (ret < 0)
+	goto done;
+ children:
+    if (mode == PT_COALESCE_INSERT)
+	mode = PT_COALESCE_MERGE;
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL ||
+	    (ptc = co_pt_get(co)) == NULL)
+	    continue;
+	if (ptc->pt_appended && pt_coalesce(ptc, mode) < 0)
+	    goto done;
+    }
+    retval = 0;
+ done:
+    if (vec)
+	free(vec);
+    return retval;
+}
+
 /*! Free all parse-tree nodes of the parse-tree, 
  * @param[in]  pt         CLIgen parse-tree
  * @param[in]  recursive  If set free recursive
@@ -515,11 +1867,18 @@ pt_free(parse_tree *pt,
     }
     if (pt->pt_vec != NULL){
 	for (i=0; i<pt_len_get(pt); i++)
-	    if ((co = pt_vec_i_get(pt, i)) != NULL)
+	    if ((co = pt_vec_i_get(pt, i)) != NULL){
+		if (pt->pt_borrow && co_ref_get(co) == NULL)
+		    continue; /* Not owned, see pt_borrow_set */
 		co_free(co, recursive);
+	    }
 	free(pt->pt_vec);
     }
+    if (pt->pt_order)
+	free(pt->pt_order);
     pt->pt_len = 0;
+    pt->pt_size = 0;
+    pt_index_reset(pt);
     if (pt->pt_name){
 	free(pt->pt_name);
 	pt->pt_name = NULL;
@@ -535,6 +1894,84 @@ cligen_parsetree_free(parse_tree *pt,
     return pt_free(pt, recursive);
 }
 
+/*! Add the memory used by a parse-tree and its sub-trees to a memory breakdown
+ * Objects of a shadow tree that are borrowed from the original are not counted,
+ * as in pt_free.
+ * @param[in]     pt   CLIgen parse-tree
+ * @param[in,out] cm   Memory breakdown. Sizes are added, clear it before first call
+ * @retval        0    OK
+ * @retval       -1    Error
+ * @see cligen_memsize_total
+ */
+int
+pt_memsize(parse_tree     *pt,
+	   cligen_memsize *cm)
+{
+    struct pt_index *pi;
+    cg_obj          *co;
+    int              i;
+
+    if (pt == NULL || cm == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    cm->cm_ptvecs += sizeof(*pt) + pt->pt_size*sizeof(cg_obj *);
+    if (pt->pt_order)
+	cm->cm_ptvecs += pt->pt_size*sizeof(uint32_t);
+    if ((pi = pt->pt_index) != NULL)
+	cm->cm_ptvecs += sizeof(*pi) + pi->pi_cmdlen*(sizeof(char *)+sizeof(int)) +
+	    pi->pi_otherlen*sizeof(int);
+    if (pt->pt_help){
+	cm->cm_ptvecs += PT_HELP_MODES*sizeof(struct pt_help);
+	for (i=0; i<PT_HELP_MODES; i++)
+	    cm->cm_ptvecs += pt->pt_help[i].ph_matchlen*sizeof(int) + pt->pt_help[i].ph_len;
+    }
+    if (pt->pt_name)
+	cm->cm_strings += strlen(pt->pt_name)+1;
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL)
+	    continue;
+	if (pt->pt_borrow && co_ref_get(co) == NULL)
+	    continue; /* Not owned, see pt_borrow_set */
+	if (co_memsize(co, cm) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/*! Return sum of all fields of a memory breakdown
+ * @param[in]  cm   Memory breakdown
+ * @retval     sz   Total number of bytes
+ */
+size_t
+cligen_memsize_total(cligen_memsize *cm)
+{
+    return cm->cm_nodes + cm->cm_ptvecs + cm->cm_strings + cm->cm_interned +
+	cm->cm_varspecs + cm->cm_callbacks + cm->cm_cvecs + cm->cm_history + cm->cm_handle;
+}
+
+/*! Print a memory breakdown, one "name value" pair per line
+ * @param[in]  f    Output file
+ * @param[in]  cm   Memory breakdown
+ * @retval     0    OK
+ */
+int
+cligen_memsize_print(FILE           *f,
+		     cligen_memsize *cm)
+{
+    fprintf(f, "mem_nodes %zu\n", cm->cm_nodes);
+    fprintf(f, "mem_ptvecs %zu\n", cm->cm_ptvecs);
+    fprintf(f, "mem_strings %zu\n", cm->cm_strings);
+    fprintf(f, "mem_interned %zu\n", cm->cm_interned);
+    fprintf(f, "mem_varspecs %zu\n", cm->cm_varspecs);
+    fprintf(f, "mem_callbacks %zu\n", cm->cm_callbacks);
+    fprintf(f, "mem_cvecs %zu\n", cm->cm_cvecs);
+    fprintf(f, "mem_history %zu\n", cm->cm_history);
+    fprintf(f, "mem_handle %zu\n", cm->cm_handle);
+    fprintf(f, "mem_total %zu\n", cligen_memsize_total(cm));
+    return 0;
+}
+
 /*! Apply a function call recursively on all cg_obj:s in a parse-tree
  *
  * Recursively traverse all cg_obj in a parse-tree and apply fn(arg) for each
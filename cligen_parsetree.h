@@ -35,6 +35,24 @@
 #ifndef _CLIGEN_PARSETREE_H_
 #define _CLIGEN_PARSETREE_H_
 
+/*
+ * Constants
+ */
+/* Minimum number of children of a parse-tree level for a keyword index to be used 
+ * when matching. Smaller levels are scanned linearly.
+ * @see pt_index_lookup
+ */
+#define PT_INDEX_MIN 16
+
+/* How pt_coalesce() merges an appended object into an equal object
+ * @see pt_coalesce
+ */
+enum pt_coalesce_mode{
+    PT_COALESCE_INSERT, /* As co_insert(): keep existing object, merge children */
+    PT_COALESCE_MERGE,  /* As cligen_parsetree_merge(): also take callbacks if none */
+    PT_COALESCE_PARSE   /* As repeated clispec statements: add callbacks, flags etc */
+};
+
 /*
  * Types
  */
@@ -48,6 +66,31 @@
  * @endcode
  */
 /* Forward declarations for cg_obj declared in cligen_object.h */
+/*! Layout of a rendered help table, see pt_help_get */
+enum pt_help_mode{
+    PT_HELP_COLUMNS, /* Commands in columns, eg on TAB */
+    PT_HELP_LINES,   /* One line per command with its help text, eg on '?' */
+};
+#define PT_HELP_MODES 2
+
+/*! Settings a rendered help table depends on, in addition to the matched commands */
+typedef struct pt_help_key{
+    enum pt_help_mode hk_mode;     /* Layout */
+    int               hk_width;    /* Terminal width */
+    int               hk_lines;    /* Max help lines per command, see cligen_helpstring_lines */
+    int               hk_truncate; /* Truncate help lines, see cligen_helpstring_truncate */
+} pt_help_key;
+
+/*! Children of a parse-tree level that may match a token, see pt_index_lookup
+ * The vectors point into the keyword index and are not to be freed.
+ */
+typedef struct pt_index_range{
+    int              *pir_cmdvec;   /* Positions of commands with the token as prefix */
+    int               pir_cmdlen;   /* Length of pir_cmdvec */
+    int              *pir_othervec; /* Positions of non-indexed children, in vector order */
+    int               pir_otherlen; /* Length of pir_othervec */
+} pt_index_range;
+
 typedef struct cg_obj cg_obj;
 
 typedef struct parse_tree parse_tree; /* struct defined internally in cligen_parsetree.c */
@@ -61,6 +104,27 @@ typedef struct parse_tree parse_tree; /* struct defined internally in cligen_par
 */
 typedef int (cg_applyfn_t)(cg_obj *co, void *arg);
 
+/*! Memory used by parse-trees and handles, in bytes
+ * Filled in by co_memsize, pt_memsize, cligen_ph_memsize and cligen_handle_memsize which
+ * add to the fields, so that the use of several trees can be summed.
+ * @code
+ *   cligen_memsize cm = {0,};
+ *   pt_memsize(pt, &cm);
+ *   printf("%zu\n", cligen_memsize_total(&cm));
+ * @endcode
+ */
+typedef struct cligen_memsize {
+    size_t cm_nodes;     /* Parse-tree objects (cg_obj) and their extensions */
+    size_t cm_ptvecs;    /* Parse-tree levels, child vectors, keyword indexes and help tables */
+    size_t cm_strings;   /* Malloced strings: help and choice of variables, function and tree names */
+    size_t cm_interned;  /* Interned keyword strings, counted once per reference */
+    size_t cm_varspecs;  /* Range, regexp and expand argument vectors of variables */
+    size_t cm_callbacks; /* Callbacks, their names and argument vectors */
+    size_t cm_cvecs;     /* Variable and help text vectors of objects */
+    size_t cm_history;   /* History lines and their signatures */
+    size_t cm_handle;    /* Handle struct, line buffers, output buffer and arena */
+} cligen_memsize;
+
 /*
  * Prototypes
  * Note: pt_ vs cligen_parsetree_
@@ -69,21 +133,44 @@ cg_obj     *pt_vec_i_get(parse_tree *pt, int i);
 int         pt_vec_i_clear(parse_tree *pt, int i);
 int         pt_vec_i_insert(parse_tree *pt, int i, cg_obj *co);
 int         pt_vec_append(parse_tree *pt, cg_obj *co);
+int         pt_bulk_append(parse_tree *pt, cg_obj *co, uint32_t order);
 int         pt_vec_i_delete(parse_tree *pt, int i);
 int         pt_len_get(parse_tree *pt);
 char       *pt_name_get(parse_tree *pt);
 int         pt_name_set(parse_tree *pt, char *name);
 int         pt_sets_get(parse_tree *pt);
 int         pt_sets_set(parse_tree *pt, int sets);
+int         pt_borrow_get(parse_tree *pt);
+int         pt_borrow_set(parse_tree *pt, int borrow);
+int         pt_sorted_get(parse_tree *pt);
+int         pt_sorted_set(parse_tree *pt, int sorted);
+int         pt_frozen_get(parse_tree *pt);
+int         pt_freeze(parse_tree *pt);
 void        cligen_parsetree_sort(parse_tree *pt, int recursive);
+int         pt_sort_merge(parse_tree *pt, parse_tree *pt1);
+int         pt_delta_add(parse_tree *pt, cg_obj *parent, parse_tree *pt1);
+int         pt_delta_del(parse_tree *pt, parse_tree *pt1);
+int         pt_coalesce(parse_tree *pt, enum pt_coalesce_mode mode);
 int         pt_realloc(parse_tree *pt);
 int         pt_copy(parse_tree *pt, cg_obj *parent, parse_tree *ptn);
 parse_tree *pt_dup(parse_tree *pt, cg_obj *cop);
 int         cligen_parsetree_merge(parse_tree *pt0, cg_obj *parent0, parse_tree *pt1);
 int         pt_free(parse_tree *pt, int recurse);
 int         cligen_parsetree_free(parse_tree *pt, int recurse);
+int         pt_memsize(parse_tree *pt, cligen_memsize *cm);
+size_t      cligen_memsize_total(cligen_memsize *cm);
+int         cligen_memsize_print(FILE *f, cligen_memsize *cm);
 parse_tree *pt_new(void);
 int         pt_apply(parse_tree *pt, cg_applyfn_t fn, void *arg);
+void        pt_index_reset(parse_tree *pt);
+int         pt_index_lookup(parse_tree *pt, char *prefix, pt_index_range *pir);
+int         pt_index_exact(parse_tree *pt, char *key, int *posp);
+int         pt_index_source_set(parse_tree *ptn, parse_tree *pt);
+int         pt_help_source_set(parse_tree *ptn, parse_tree *pt, int hide);
+int         pt_help_get(parse_tree *ptn, pt_help_key *hk, int *matchvec, int matchlen,
+			char **bufp, size_t *lenp);
+int         pt_help_set(parse_tree *ptn, pt_help_key *hk, int *matchvec, int matchlen,
+			char *buf, size_t len);
 
 #endif /* _CLIGEN_PARSETREE_H_ */
 
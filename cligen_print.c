@@ -178,11 +178,11 @@ co2cbuf(cbuf   *cb,
 	break;
     }
     if (brief == 0){
-	if (co->co_helpvec){
+	if (co_helpvec_get(co)){
 	    cprintf(cb, "(\"");
 	    cv = NULL;
 	    i = 0;
-	    while ((cv = cvec_each(co->co_helpvec, cv)) != NULL) {
+	    while ((cv = cvec_each(co_helpvec_get(co), cv)) != NULL) {
 		if (i++)
 		    cprintf(cb, "\n");
 		cv2cbuf(cv, cb);
@@ -195,7 +195,7 @@ co2cbuf(cbuf   *cb,
 		cprintf(cb, ", hide-database");
 	if ((co_flags_get(co, CO_FLAGS_HIDE)) && (co_flags_get(co, CO_FLAGS_HIDE_DATABASE)))
 		cprintf(cb, ", hide-database-auto-completion");
-	for (cc = co->co_callbacks; cc; cc=cc->cc_next){
+	for (cc = co_callbacks_get(co); cc; cc=cc->cc_next){
 	    if (cc->cc_fn_str){
 		cprintf(cb, ", %s(", cc->cc_fn_str);
 		if (cc->cc_cvec){
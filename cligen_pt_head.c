@@ -69,6 +69,9 @@
 #include "cligen_history.h"
 #include "cligen_getline.h"
 #include "cligen_print.h"
+#include "cligen_expand.h"
+#include "cligen_match.h"
+#include "cligen_syntax.h"
 #include "cligen_handle_internal.h"
 
 /*
@@ -114,22 +117,48 @@ cligen_ph_name_set(pt_head *ph,
     return 0;
 }
 
-/*! Access function to the working point in a tree, shortcut to implement edit modes.
+/*! A parse-tree or working point of a header has changed
+ * Tree reference expansions and cached completions of the handle are invalidated,
+ * see cligen_ph_treeref_validate
+ * @param[in]  ph    Parse-tree header
+ */
+static void
+ph_changed(pt_head *ph)
+{
+    ph->ph_gen++;
+    if (ph->ph_handle)
+	handle(ph->ph_handle)->ch_tree_gen++;
+}
+
+/*! Access function to the parse-tree of a parse-tree header
+ * If the header has a loader and the tree is not loaded, it is loaded here.
  * @param[in]  ph   Parse tree header
  * @retval     pt   Parse tree
  * @retval     NULL Error or no parse tree
+ * @see cligen_ph_loader_set
  */
 parse_tree*
 cligen_ph_parsetree_get(pt_head *ph)
 {
+    int ret;
+
     if (ph == NULL){
        errno = EINVAL;
        return NULL;
     }
+    if (ph->ph_parsetree == NULL && ph->ph_loader != NULL && !ph->ph_loading){
+	ph->ph_loading = 1;
+	ret = ph->ph_loader(ph->ph_handle, ph, ph->ph_loader_arg);
+	ph->ph_loading = 0;
+	if (ret < 0)
+	    return NULL;
+    }
     return ph->ph_parsetree;
 }
 
 /*! Access function to set parsetree of parse-tree header
+ * A frozen parse-tree, see pt_freeze, may be set in several headers and is not
+ * freed by cligen_ph_free
  * @param[in]  ph    Parse-tree header
  * @param[in]  pt    parse-tree
  * @retval     0     OK
@@ -146,8 +175,10 @@ cligen_ph_parsetree_set(pt_head    *ph,
        goto done;
     }
     ph->ph_parsetree = pt; /* XXX not free if exists? */
+    ph_changed(ph); /* Invalidate tree reference expansions */
 #if 1 /* This is still used in clixon */
-    if (pt_name_set(pt, cligen_ph_name_get(ph)) < 0) /* XXX Is this even necessary ? */
+    if (pt != NULL && pt_frozen_get(pt) == 0 &&
+	pt_name_set(pt, cligen_ph_name_get(ph)) < 0) /* XXX Is this even necessary ? */
 	goto done;
 #endif
     retval = 0;
@@ -155,6 +186,175 @@ cligen_ph_parsetree_set(pt_head    *ph,
     return retval;
 }
 
+/*! Register a loader of the parse-tree of a header, instead of setting the tree
+ * The tree is loaded by cligen_ph_parsetree_get on first use, eg when a mode is
+ * activated or a tree reference to it is expanded. Startup time and memory then
+ * only depend on the trees actually used.
+ * @param[in]  ph    Parse-tree header
+ * @param[in]  fn    Loader function, or NULL to remove the loader
+ * @param[in]  arg   Argument to fn, eg a filename for cligen_ph_loader_file
+ * @retval     0     OK
+ * @retval    -1     Error
+ * @code
+ *   pt_head *ph = cligen_ph_add(h, "config");
+ *   cligen_ph_loader_set(ph, cligen_ph_loader_file, "/usr/share/app/config.cli");
+ * @endcode
+ * @see cligen_ph_evict
+ */
+int
+cligen_ph_loader_set(pt_head            *ph,
+		     cligen_ph_loader_t *fn,
+		     void               *arg)
+{
+    if (ph == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    ph->ph_loader = fn;
+    ph->ph_loader_arg = arg;
+    return 0;
+}
+
+/*! Loader of a parse-tree from a clispec file
+ * The file is parsed with cligen_parse_file. It should not contain treename
+ * statements or global assignments, those are ignored.
+ * Callback functions are not mapped, a loader that needs it calls this function and
+ * then cligen_callbackv_str2fn on the loaded tree.
+ * @param[in]  h    CLIgen handle
+ * @param[in]  ph   Parse-tree header
+ * @param[in]  arg  Clispec filename (char*)
+ * @retval     0    OK
+ * @retval    -1    Error, printed on stderr
+ * @see cligen_ph_loader_set
+ */
+int
+cligen_ph_loader_file(cligen_handle h,
+		      pt_head      *ph,
+		      void         *arg)
+{
+    int         retval = -1;
+    char       *filename = (char*)arg;
+    FILE       *f = NULL;
+    parse_tree *pt = NULL;
+
+    if (filename == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    if ((f = fopen(filename, "r")) == NULL){
+	fprintf(stderr, "CLIgen tree '%s': fopen(%s): %s\n",
+		ph->ph_name, filename, strerror(errno));
+	goto done;
+    }
+    if ((pt = pt_new()) == NULL)
+	goto done;
+    if (cligen_parse_file(h, f, filename, pt, NULL) < 0)
+	goto done;
+    if (cligen_ph_parsetree_set(ph, pt) < 0)
+	goto done;
+    pt = NULL;
+    retval = 0;
+ done:
+    if (pt)
+	pt_free(pt, 1);
+    if (f)
+	fclose(f);
+    return retval;
+}
+
+/*! Free a loaded parse-tree of a header with a loader, it is loaded again on next use
+ * Used to release memory of trees not in use, see cligen_ph_memsize.
+ * Tree reference expansions made from the tree are removed on next expansion.
+ * Must not be called while the tree is evaluated, eg from one of its callbacks.
+ * @param[in]  ph    Parse-tree header
+ * @retval     0     OK, or the tree was not loaded
+ * @retval    -1     Error, errno is EINVAL if there is no loader and EBUSY if the tree
+ *                   is frozen or has a working point
+ */
+int
+cligen_ph_evict(pt_head *ph)
+{
+    parse_tree *pt;
+
+    if (ph == NULL || ph->ph_loader == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if ((pt = ph->ph_parsetree) == NULL)
+	return 0;
+    if (pt_frozen_get(pt) || ph->ph_workpt != NULL){
+	errno = EBUSY;
+	return -1;
+    }
+    if (cligen_ph_parsetree_set(ph, NULL) < 0)
+	return -1;
+    pt_free(pt, 1);
+    return 0;
+}
+
+/*! Add the commands of a parse-tree fragment to the parse-tree of a header
+ * The tree is updated in place with pt_delta_add(), it is created if the header has
+ * none. Tree reference expansions in the tree are removed first, and expansions
+ * referencing the tree are invalidated.
+ * Must not be called while the tree is evaluated, eg from one of its callbacks.
+ * @param[in]  ph    Parse-tree header
+ * @param[in]  pt1   Parse-tree fragment, emptied, see pt_delta_add
+ * @retval     0     OK
+ * @retval    -1     Error, errno is EPERM if the tree is frozen
+ * @see cligen_ph_delta_del
+ */
+int
+cligen_ph_delta_add(pt_head    *ph,
+		    parse_tree *pt1)
+{
+    parse_tree *pt;
+
+    if (ph == NULL || pt1 == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if ((pt = cligen_ph_parsetree_get(ph)) == NULL){
+	if ((pt = pt_new()) == NULL)
+	    return -1;
+	if (cligen_ph_parsetree_set(ph, pt) < 0){
+	    pt_free(pt, 1);
+	    return -1;
+	}
+    }
+    if (pt_expand_treeref_cleanup(pt) < 0)
+	return -1;
+    ph_changed(ph); /* Invalidate tree reference expansions */
+    return pt_delta_add(pt, NULL, pt1);
+}
+
+/*! Remove the commands of a parse-tree fragment from the parse-tree of a header
+ * The tree is updated in place with pt_delta_del(). Tree reference expansions in the
+ * tree are removed first, and expansions referencing the tree are invalidated.
+ * Must not be called while the tree is evaluated, eg from one of its callbacks.
+ * @param[in]  ph    Parse-tree header
+ * @param[in]  pt1   Parse-tree fragment, see pt_delta_del
+ * @retval     0     OK, also if the header has no tree
+ * @retval    -1     Error, errno is EPERM if the tree is frozen
+ * @see cligen_ph_delta_add
+ */
+int
+cligen_ph_delta_del(pt_head    *ph,
+		    parse_tree *pt1)
+{
+    parse_tree *pt;
+
+    if (ph == NULL || pt1 == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if ((pt = cligen_ph_parsetree_get(ph)) == NULL)
+	return 0;
+    if (pt_expand_treeref_cleanup(pt) < 0)
+	return -1;
+    ph_changed(ph); /* Invalidate tree reference expansions */
+    return pt_delta_del(pt, pt1);
+}
+
 /*! Access function to the working point in a tree, shortcut to implement edit modes.
  * @param[in] h     CLIgen handle
  * @param[in] name  Name of tree
@@ -176,6 +376,8 @@ int
 cligen_ph_workpoint_set(pt_head *ph,
 			cg_obj  *wp)
 {
+    if (ph->ph_workpt != wp)
+	ph_changed(ph); /* Invalidate tree reference expansions */
     ph->ph_workpt = wp;
     return 0;
 }
@@ -214,12 +416,36 @@ cligen_ph_free(pt_head *ph)
     }
     if (ph->ph_name)
 	free(ph->ph_name);
-    if (ph->ph_parsetree)
+    if (ph->ph_parsetree && !pt_frozen_get(ph->ph_parsetree))
 	pt_free(ph->ph_parsetree, 1);
     free(ph);
     return 0;
 }
 
+/*! Add the memory used by a parsetree header and its parse-tree to a memory breakdown
+ * A frozen parse-tree shared by several handles is counted in each of them.
+ * @param[in]     ph   Parse-tree header
+ * @param[in,out] cm   Memory breakdown. Sizes are added, clear it before first call
+ * @retval        0    OK
+ * @retval       -1    Error
+ * @see pt_memsize
+ */
+int
+cligen_ph_memsize(pt_head        *ph,
+		  cligen_memsize *cm)
+{
+    if (ph == NULL || cm == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    cm->cm_ptvecs += sizeof(*ph);
+    if (ph->ph_name)
+	cm->cm_strings += strlen(ph->ph_name)+1;
+    if (ph->ph_parsetree && pt_memsize(ph->ph_parsetree, cm) < 0)
+	return -1;
+    return 0;
+}
+
 #ifdef NOTUSED
 /*! Delete a parsetree head and unlink it from the handle list
  * @param[in] h    CLIgen handle
@@ -247,19 +473,17 @@ cligen_ph_del(cligen_handle h,
 }
 #endif
 
-/*! Append a new parsetree header
- * @param[in]  h     CLIgen handle
+/*! Create a parsetree header that is not (yet) added to a handle
  * @param[in]  name  Name of this tree 
- * @retval     ph    The new parsetree header
+ * @retval     ph    The new parsetree header, add it with cligen_ph_append or free it
+ *                   with cligen_ph_free
  * @retval     NULL  Error
- * Note, if this is the first tree, it is activated by default
+ * @see cligen_ph_add
  */
 pt_head *
-cligen_ph_add(cligen_handle h, 
-	      char         *name)
+cligen_ph_new(char *name)
 {
     pt_head *ph;
-    pt_head *phlast;
     
     if ((ph = (pt_head *)malloc(sizeof(*ph))) == NULL)
 	goto done;
@@ -269,6 +493,29 @@ cligen_ph_add(cligen_handle h,
 	ph = NULL;
 	goto done;
     }
+ done:
+    return ph;
+}
+
+/*! Append a parsetree header created by cligen_ph_new to a handle
+ * @param[in]  h     CLIgen handle
+ * @param[in]  ph    Parsetree header, not added to any handle
+ * @retval     0     OK
+ * @retval    -1     Error
+ * Note, if this is the first tree, it is activated by default
+ */
+int
+cligen_ph_append(cligen_handle h, 
+		 pt_head      *ph)
+{
+    pt_head *phlast;
+
+    if (ph == NULL || ph->ph_next != NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    ph->ph_handle = h;
+    handle(h)->ch_tree_gen++; /* References to the tree may now be expanded */
     if ((phlast = cligen_pt_head_get(h)) == NULL){
 	ph->ph_active++;
 	cligen_pt_head_set(h, ph);
@@ -278,6 +525,29 @@ cligen_ph_add(cligen_handle h,
 	    phlast = phlast->ph_next;
 	phlast->ph_next = ph;
     }
+    return 0;
+}
+
+/*! Append a new parsetree header
+ * @param[in]  h     CLIgen handle
+ * @param[in]  name  Name of this tree 
+ * @retval     ph    The new parsetree header
+ * @retval     NULL  Error
+ * Note, if this is the first tree, it is activated by default
+ */
+pt_head *
+cligen_ph_add(cligen_handle h, 
+	      char         *name)
+{
+    pt_head *ph;
+    
+    if ((ph = cligen_ph_new(name)) == NULL)
+	goto done;
+    if (cligen_ph_append(h, ph) < 0){
+	cligen_ph_free(ph);
+	ph = NULL;
+	goto done;
+    }
  done:
     return ph;
 }
@@ -336,7 +606,7 @@ cligen_ph_active_get(cligen_handle h)
 
     for (ph = cligen_pt_head_get(h); ph; ph = ph->ph_next)
 	if (ph->ph_active)
-	    return ph->ph_parsetree;
+	    return cligen_ph_parsetree_get(ph); /* May be loaded on demand */
     return NULL;
 }
 
@@ -361,6 +631,41 @@ cligen_ph_active_set(cligen_handle h,
     return 0;
 }
 
+/*! Remove tree reference expansions if any parse-tree or working point has changed
+ *
+ * Expansions of tree references made by pt_expand_treeref() are kept in the
+ * parse-trees between evaluations. They are removed here from all parse-trees
+ * of the handle if any tree has been replaced with cligen_ph_parsetree_set(), changed
+ * working point with cligen_ph_workpoint_set(), or been added since they were made.
+ * Private copies of frozen parse-tree levels are freed.
+ * @param[in] h       CLIgen handle
+ * @retval    0       OK
+ * @retval   -1       Error
+ * @see pt_expand_treeref
+ * @note If a referenced parse-tree is modified in place, call
+ *       pt_expand_treeref_cleanup() on the referencing trees
+ */
+int
+cligen_ph_treeref_validate(cligen_handle h)
+{
+    int                   retval = -1;
+    struct cligen_handle *ch = handle(h);
+    pt_head              *ph;
+
+    if (ch->ch_tree_gen != ch->ch_treeref_gen){
+	match_cache_flush(h); /* Cached levels may reference expansions */
+	for (ph = cligen_pt_head_get(h); ph; ph = ph->ph_next)
+	    if (ph->ph_parsetree &&
+		pt_expand_treeref_cleanup(ph->ph_parsetree) < 0)
+		goto done;
+	pt_overlay_flush(h);
+	ch->ch_treeref_gen = ch->ch_tree_gen;
+    }
+    retval = 0;
+ done:
+    return retval;
+}
+
 /*
  * CLIgen parse-tree workpoint example:
  * @code
@@ -394,7 +699,7 @@ cligen_wp_set(cligen_handle h,
     treename = cv_string_get(cv);
     if ((ph = cligen_ph_find(h, treename)) != NULL &&
 	(co = cligen_co_match(h)) != NULL &&
-	(coorig = co->co_treeref_orig) != NULL){
+	(coorig = co_treeref_orig_get(co)) != NULL){
 	cligen_ph_workpoint_set(ph, coorig);
     }
     return 0;
@@ -41,6 +41,17 @@
  */
 typedef struct pt_head pt_head;  /* defined in cligen_handle_internal.h */
 
+/*! Loader of a parse-tree that is not parsed until first used
+ * Sets the tree of the header with cligen_ph_parsetree_set
+ * @param[in]  h    CLIgen handle
+ * @param[in]  ph   Parse-tree header to load
+ * @param[in]  arg  Argument given to cligen_ph_loader_set
+ * @retval     0    OK
+ * @retval    -1    Error
+ * @see cligen_ph_loader_file  Loader of a clispec file
+ */
+typedef int (cligen_ph_loader_t)(cligen_handle h, pt_head *ph, void *arg);
+
 
 /*
  * Prototypes
@@ -49,21 +60,30 @@ char       *cligen_ph_name_get(pt_head *ph);
 int         cligen_ph_name_set(pt_head *ph, char *name);
 parse_tree *cligen_ph_parsetree_get(pt_head *ph);
 int         cligen_ph_parsetree_set(pt_head *ph, parse_tree *pt);
+int         cligen_ph_loader_set(pt_head *ph, cligen_ph_loader_t *fn, void *arg);
+int         cligen_ph_loader_file(cligen_handle h, pt_head *ph, void *arg);
+int         cligen_ph_evict(pt_head *ph);
+int         cligen_ph_delta_add(pt_head *ph, parse_tree *pt1);
+int         cligen_ph_delta_del(pt_head *ph, parse_tree *pt1);
 
 cg_obj     *cligen_ph_workpoint_get(pt_head *ph);
 int         cligen_ph_workpoint_set(pt_head *ph, cg_obj *cow);
 
 pt_head    *cligen_ph_find(cligen_handle h, char *name);
 int         cligen_ph_free(pt_head *ph);
+int         cligen_ph_memsize(pt_head *ph, cligen_memsize *cm);
 #ifdef NOTUSED
 int         cligen_ph_del(cligen_handle h, char *name);
 #endif
+pt_head    *cligen_ph_new(char *name);
+int         cligen_ph_append(cligen_handle h, pt_head *ph);
 pt_head    *cligen_ph_add(cligen_handle h, char *name);
 pt_head    *cligen_ph_each(cligen_handle h, pt_head *ph);
 pt_head    *cligen_ph_i(cligen_handle h, int i);
 
 parse_tree *cligen_ph_active_get(cligen_handle h);
 int         cligen_ph_active_set(cligen_handle h, char *name);
+int         cligen_ph_treeref_validate(cligen_handle h);
 
 /* CLIgen callbacks */
 int         cligen_wp_set(cligen_handle h, cvec *cvv, cvec *argv);
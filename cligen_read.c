@@ -56,6 +56,7 @@
 #define __USE_GNU /* isblank() */
 #include <ctype.h>
 #include <assert.h>
+#include <pthread.h>
 
 #ifndef isblank
 #define isblank(c) (c==' ')
@@ -73,8 +74,14 @@
 #include "cligen_read.h"
 #include "cligen_match.h"
 #include "cligen_expand.h"
+#include "cligen_syntax.h"
 #include "cligen_history_internal.h"
 #include "cligen_getline.h"
+#include "cligen_stats.h"
+#include "cligen_trace.h"
+#include "cligen_handle_internal.h"
+#include "cligen_stats_internal.h"
+#include "cligen_trace_internal.h"
 
 /*
  * Local prototypes
@@ -83,6 +90,9 @@ static int show_help_columns(cligen_handle h, FILE *fout, char *s, parse_tree *p
 static int show_help_line(cligen_handle h, FILE *fout, char *s, parse_tree *pt, cvec *);
 static int cli_complete(cligen_handle h, int *lenp, parse_tree *pt, cvec *cvv);
 
+/* Shown after help if expand callbacks did not finish before the deadline */
+#define CLIGEN_EXPAND_PENDING_HINT "  <loading...>"
+
 /*! Show help strings 
  *
  * @param[in]  h       CLIgen handle Input string to match
@@ -101,7 +111,10 @@ cli_show_help_commands(cligen_handle h,
     parse_tree   *ptn = NULL;    /* Expanded */
     cvec         *cvv = NULL;
 
-    fputs("\n", stdout);
+    if (cligen_help_write(h, stdout, "\n", 1) < 0)
+	return -1;
+    handle(h)->ch_completing = 1;
+    handle(h)->ch_expand_pending = 0;
     if ((ptn = pt_new()) == NULL)
 	goto done;
     if ((pt = cligen_ph_active_get(h)) == NULL)
@@ -121,17 +134,20 @@ cli_show_help_commands(cligen_handle h,
     }
     else if (show_help_columns(h, stdout, cligen_buf(h), ptn, cvv) < 0)
 	    goto done;
+    if (cligen_expand_pending(h) &&
+	cligen_help_write(h, stdout, CLIGEN_EXPAND_PENDING_HINT "\n",
+			  strlen(CLIGEN_EXPAND_PENDING_HINT "\n")) < 0)
+	goto done;
  ok:
     retval = 0;
   done:
+    handle(h)->ch_completing = 0;
     if (cvv)
 	cvec_free(cvv);
     if (ptn && pt_free(ptn, 0) < 0)
 	return -1;
     if (pt && pt_expand_cleanup(pt) < 0) 
 	return -1;
-    if (pt && pt_expand_treeref_cleanup(pt) < 0) 
-	return -1;
     return retval;
 }
 
@@ -142,9 +158,10 @@ cli_show_help_commands(cligen_handle h,
  * @retval  0 OK: required by getline
  * @retval -1 Error
  * @note Flaw related to getline: Errors from sub-functions are ignored
+ * @note Also called by sessions, where help is written to the session
  * @see cli_tab_hook
  */
-static int
+int
 cli_qmark_hook(cligen_handle h,
 	       char         *string)
 {
@@ -160,9 +177,10 @@ cli_qmark_hook(cligen_handle h,
  * @retval  -1    Error
  * @retval  -2    (value != -1 required by getline)
  * @note Flaw related to getline: Errors from sub-functions are ignored
+ * @note Also called by sessions, where help is written to the session
  * @see cli_qmark_hook
  */
-static int 
+int 
 cli_tab_hook(cligen_handle h,
 	     int          *cursorp)
 {
@@ -172,6 +190,8 @@ cli_tab_hook(cligen_handle h,
     parse_tree   *ptn = NULL;    /* Expanded */
     cvec         *cvv = NULL;
 
+    handle(h)->ch_completing = 1;
+    handle(h)->ch_expand_pending = 0;
     if ((ptn = pt_new()) == NULL)
 	goto done;
     if ((pt = cligen_ph_active_get(h)) == NULL)
@@ -191,16 +211,22 @@ cli_tab_hook(cligen_handle h,
 	if (cli_complete(h, cursorp, ptn, cvv) < 0) /* XXX expand-cleanup must be done here before show commands */
 	    goto done;
     } while (cligen_tabmode(h)&CLIGEN_TABMODE_STEPS && prev_cursor != *cursorp);
-    fputs("\n", stdout);
+    if (cligen_help_write(h, stdout, "\n", 1) < 0)
+	goto done;
     if (cligen_tabmode(h) & CLIGEN_TABMODE_COLUMNS){
 	if (show_help_line(h, stdout, cligen_buf(h), ptn, cvv) <0)
 	goto done;
     }
     else if (show_help_columns(h, stdout, cligen_buf(h), ptn, cvv) < 0)
 	    goto done;
+    if (cligen_expand_pending(h) &&
+	cligen_help_write(h, stdout, CLIGEN_EXPAND_PENDING_HINT "\n",
+			  strlen(CLIGEN_EXPAND_PENDING_HINT "\n")) < 0)
+	goto done;
  ok:
     retval = 0; 
  done:
+    handle(h)->ch_completing = 0;
     if (cvv)
 	cvec_free(cvv);
     if (ptn && pt_free(ptn, 0) < 0)
@@ -208,8 +234,6 @@ cli_tab_hook(cligen_handle h,
     if (pt != NULL) {
 	if (pt_expand_cleanup(pt) < 0)
 	    return -1;
-	if (pt_expand_treeref_cleanup(pt) < 0)
-	    return -1;
     }
     return retval;	
 }
@@ -219,16 +243,17 @@ cli_tab_hook(cligen_handle h,
 void
 cliread_init(cligen_handle h)
 {
-    gl_qmark_hook = cli_qmark_hook;
-    gl_tab_hook = cli_tab_hook; /* XXX globals */
+    gl_qmark_hook_set(h, cli_qmark_hook);
+    gl_tab_hook_set(h, cli_tab_hook);
 }
 
 /*! Print columns
+ * @param[in]  cb   Buffer to render the columns in
  * @param[in]  cnr  Number of columns.
  * @param[in]  cw   Width of column
  */
 static int
-column_print(FILE            *fout, 
+column_print(cbuf            *cb, 
 	     int              cnr, 
 	     int              cw,
 	     struct cmd_help *chvec,
@@ -245,15 +270,14 @@ column_print(FILE            *fout,
     for (ci=0, li = 0; li < linenr; li++) {
 	while ((ci < cnr) && (li*cnr+ci < len)) {
 	    ch = &chvec[li*cnr+ci];
-	    fprintf(fout, " %*s", 
-		     -(cw-1), 
-		     ch->ch_cmd);
+	    cprintf(cb, " %*s", 
+		    -(cw-1), 
+		    ch->ch_cmd);
 	    ci++;
 	}
 	ci = 0;
-	fprintf(fout, "\n");  
+	cprintf(cb, "\n");  
     }  
-    fflush(fout);
     retval = 0;
     // done:
     return retval;
@@ -261,6 +285,7 @@ column_print(FILE            *fout,
 
 /*! Show briefly the commands available (show no help)
  * Typically called when TAB is pressed and there are multiple options.
+ * The columns of a static level are cached as in print_help_lines.
  * @param[in]  fout    This is where the output (help text) is shown.
  * @param[in]  string  Input string to match
  * @param[in]  pt      Vector of commands (array of cligen object pointers (cg_obj)
@@ -292,22 +317,26 @@ show_help_columns(cligen_handle h,
     int              column_width;
     int              column_nr;
     int              rest;
-    cvec            *cvt = NULL;      /* Tokenized string: vector of tokens */
-    cvec            *cvr = NULL;      /* Rest variant,  eg remaining string in each step */
+    cligen_tokens   *ct = NULL;       /* Tokenized string: tokens and rests */
     parse_tree      *ptmatch = NULL;
+    pt_help_key      hk = {PT_HELP_COLUMNS, 0, 0, 0};
+    cbuf            *cbh = NULL;
+    char            *buf;
+    size_t           len;
+    int              ret;
 
     if (string == NULL){
 	errno = EINVAL;
 	goto done;
     }
-    if ((cb = cbuf_new()) == NULL){
+    if ((cb = cbuf_new()) == NULL || (cbh = cbuf_new()) == NULL){
 	fprintf(stderr, "cbuf_new: %s\n", strerror(errno));
-	return -1;
+	goto done;
     }
-    /* Tokenize the string and transform it into two CLIgen vectors: tokens and rests */
-    if (cligen_str2cvv(string, &cvt, &cvr) < 0)
+    /* Tokenize the string into tokens and rests */
+    if (cligen_str2tokens(string, &ct) < 0)
 	goto done;
-    if (match_pattern(h, cvt, cvr,
+    if (match_pattern(h, ct,
 		      pt,
 		      0, /* best: Return all options, not only best, exclude hidden */
 		      &ptmatch, 
@@ -315,9 +344,18 @@ show_help_columns(cligen_handle h,
 		      cvv, NULL,
 		      NULL) < 0)
 	goto done;
-    if ((level = cligen_cvv_levels(cvt)) < 0)
+    if ((level = cligen_tokens_levels(ct)) < 0)
 	goto done;
-    if (matchlen > 0){ /* min, max only defined if matchlen > 0 */
+    hk.hk_width = cligen_terminal_width(h);
+    if (matchlen > 0 &&
+	(ret = pt_help_get(ptmatch, &hk, matchvec, matchlen, &buf, &len)) != 0){
+	if (ret < 0)
+	    goto done;
+	cligen_stats_inc(h, cs_help_cached);
+	if (cligen_help_write(h, fout, buf, len) < 0)
+	    goto done;
+    }
+    else if (matchlen > 0){ /* min, max only defined if matchlen > 0 */
 	/* Go through match vector and collect commands and helps */
 	if ((chvec = calloc(matchlen, sizeof(struct cmd_help))) ==NULL){
 	    fprintf(stderr, "%s calloc: %s\n", __FUNCTION__, strerror(errno));
@@ -363,13 +401,17 @@ show_help_columns(cligen_handle h,
 	    column_nr = 1;
 	rest = cligen_terminal_width(h)%column_width;
 	column_width += rest/column_nr;
-	if (column_print(fout, 
+	if (column_print(cbh, 
 			 column_nr,
 			 column_width,
 			 chvec, 
 			 nrcmd,
 			 level) < 0)
 	    goto done;
+	if (cligen_help_write(h, fout, cbuf_get(cbh), cbuf_len(cbh)) < 0)
+	    goto done;
+	if (pt_help_set(ptmatch, &hk, matchvec, matchlen, cbuf_get(cbh), cbuf_len(cbh)) < 0)
+	    goto done;
     } /* nr>0 */
 
     retval = 0;
@@ -381,14 +423,14 @@ show_help_columns(cligen_handle h,
 	}
 	free(chvec);
     }
-    if (ptmatch && ptmatch != pt)
+    if (ptmatch && ptmatch != pt && !match_cache_pt(h, ptmatch))
 	pt_free(ptmatch, 0);
-    if (cvt)
-	cvec_free(cvt);
-    if (cvr)
-	cvec_free(cvr);
+    if (ct)
+	cligen_tokens_free(ct);
     if (cb)
 	cbuf_free(cb);
+    if (cbh)
+	cbuf_free(cbh);
     if (matchvec)
 	free(matchvec);
     return retval;
@@ -426,10 +468,7 @@ show_help_line(cligen_handle h,
     int           level;
     int           matchlen = 0;
     int          *matchvec = NULL;
-    cvec         *cvt = NULL;      /* Tokenized string: vector of tokens */
-    cvec         *cvr = NULL;      /* Rest variant,  eg remaining string in each step */
-    cg_var       *cvlastt;         /* Last element in cvt */
-    cg_var       *cvlastr;         /* Last element in cvr */
+    cligen_tokens *ct = NULL;      /* Tokenized string: tokens and rests */
     cligen_result result;
     parse_tree   *ptmatch = NULL; 
 
@@ -437,11 +476,11 @@ show_help_line(cligen_handle h,
 	errno = EINVAL;
 	goto done;
     }
-    /* Tokenize the string and transform it into two CLIgen vectors: tokens and rests */
-    if (cligen_str2cvv(string, &cvt, &cvr) < 0) /* XXX cvr leaks memory */
+    /* Tokenize the string into tokens and rests */
+    if (cligen_str2tokens(string, &ct) < 0)
 	goto done;
     if (match_pattern(h,
-		      cvt, cvr, /* token string */
+		      ct,       /* token string */
 		      pt,       /* command vector */
 		      0,        /* best: Return all options, not only best, exclude hidden */
 		      &ptmatch,
@@ -451,7 +490,7 @@ show_help_line(cligen_handle h,
 	goto done;
     if (matchlen) /* sanity */
 	assert(matchvec!= NULL && ptmatch != NULL);
-    if ((level =  cligen_cvv_levels(cvt)) < 0)
+    if ((level =  cligen_tokens_levels(ct)) < 0)
 	goto done;
 
     /* If last char is blank, look for next level in parse-tree 
@@ -462,31 +501,22 @@ show_help_line(cligen_handle h,
      * This means we need to peek in next level and if that provides a unique solution,
      * then add a <cr>
      */
-    cvlastt = cvec_i(cvt, cvec_len(cvt)-1);
-    if (cvec_len(cvt) > 2 && strcmp(cv_string_get(cvlastt), "")==0){
+    if (cligen_tokens_len(ct) > 2 &&
+	strcmp(cligen_tokens_i(ct, cligen_tokens_len(ct)-1), "")==0){
 	/* if it is ok to <cr> here (at end of one mode) 
 	   Example: x [y|z] and we have typed 'x ', then show
 	   help for y and z and a 'cr' for 'x'.
 	*/
-
-	/* Remove the last elements. Awkward: first free the cv then truncate the cvec */
-	if (cvlastt)
-	    cv_reset(cvlastt);
-	cvec_del_i(cvt, cvec_len(cvt)-1); /* We really just want to truncate len-1 */
-
-	if ((cvlastr = cvec_i(cvr, cvec_len(cvr)-1)) != NULL)
-	    cv_reset(cvlastr);
-	cvec_del_i(cvr, cvec_len(cvr)-1);
-
-	if (match_pattern_exact(h, cvt, cvr, pt,
+	/* Remove the last element */
+	cligen_tokens_trunc(ct, cligen_tokens_len(ct)-1);
+	if (match_pattern_exact(h, ct, pt,
 				cvv, NULL,
 				NULL, NULL,
 				&result, NULL) < 0)
 	    goto done;
-	if (result == CG_MATCH || result == CG_MULTIPLE){
-	    fprintf(fout, "  <cr>\n");
-	    fflush(fout);
-	}
+	if ((result == CG_MATCH || result == CG_MULTIPLE) &&
+	    cligen_help_write(h, fout, "  <cr>\n", strlen("  <cr>\n")) < 0)
+	    goto done;
     }
     if (matchlen == 0){
 	retval = 0;
@@ -498,12 +528,10 @@ show_help_line(cligen_handle h,
 
     retval = 0;
   done:
-    if (ptmatch && pt != ptmatch)
+    if (ptmatch && pt != ptmatch && !match_cache_pt(h, ptmatch))
 	pt_free(ptmatch, 0);
-    if (cvt)
-	cvec_free(cvt);
-    if (cvr)
-	cvec_free(cvr);
+    if (ct)
+	cligen_tokens_free(ct);
     if (matchvec)
 	free(matchvec);
     return retval;
@@ -639,6 +667,8 @@ cli_trim(char **line,
  * @retval     0         OK
  * @retval    -1         Error
  *
+ * If a trace hook is set, the phases are timed in the trace record of the handle,
+ * which is reported by cligen_eval_parsed().
  * cvv should be created but empty on entry
  * On exit it contains the command string as 0th element, and one entry per element
  * Example: "aa <bb:str>" and inut string "aa 22" gives:
@@ -659,15 +689,19 @@ cliread_parse(cligen_handle  h,
     cg_obj     *match_obj;
     parse_tree *ptn = NULL;      /* Expanded */
     parse_tree *ptmatch = NULL;
-    cvec       *cvt = NULL;      /* Tokenized string: vector of tokens */
-    cvec       *cvr = NULL;      /* Rest variant,  eg remaining string in each step */
+    cligen_tokens *ct = NULL;    /* Tokenized string: tokens and rests */
     cg_var     *cv;
     cvec       *cvv = NULL;     /* Top-level vars/val vector with just command as 0th element */
+    cligen_trace *tr;            /* Trace record if a trace hook is set */
+    uint64_t    t = 0;
 
     if (cvvall == NULL || cvec_len(cvvall) != 0){
 	errno = EINVAL;
 	goto done;
     }
+    cligen_stats_inc(h, cs_eval);
+    if ((tr = cligen_trace_rec(h)) != NULL)
+	t = cligen_trace_start(tr);
     if ((ptn = pt_new()) == NULL)
 	goto done;
     if (cligen_logsyntax(h) > 0){
@@ -675,11 +709,15 @@ cliread_parse(cligen_handle  h,
 	pt_print(stderr, pt, 0);
     }
     cli_trim(&string, cligen_comment(h));
-    /* Tokenize the string and transform it into two CLIgen vectors: tokens and rests */
-    if (cligen_str2cvv(string, &cvt, &cvr) < 0)
+    /* Tokenize the string into tokens and rests */
+    if (cligen_str2tokens(string, &ct) < 0)
 	goto done;
+    if (tr)
+	t = cligen_trace_phase(tr, CT_TOKENIZE, t);
     if (pt_expand_treeref(h, NULL, pt) < 0) /* sub-tree expansion, ie @ */
 	goto done; 
+    if (tr)
+	t = cligen_trace_phase(tr, CT_TREEREF, t);
     if ((cv = cvec_add(cvvall, CGV_REST)) == NULL)
 	goto done;
     cv_name_set(cv, "cmd"); /* the whole command string */
@@ -692,24 +730,30 @@ cliread_parse(cligen_handle  h,
 		  0,  /* VARS are not expanded, eg ? <tab> */
 		  ptn) < 0) /* sub-tree expansion, ie choice, expand function */
 	goto done;
-    if (match_pattern_exact(h, cvt, cvr,
+    if (tr)
+	t = cligen_trace_phase(tr, CT_EXPAND, t);
+    if (match_pattern_exact(h, ct,
 			    ptn, cvv, cvvall,
 			    &match_obj, &ptmatch, 
 			    result, reason) < 0)
 	goto done;
     /* Map from ghost object match_obj to real object */
-    if (match_obj && match_obj->co_ref)
-	*co_orig = match_obj->co_ref;
+    if (match_obj && co_ref_get(match_obj))
+	*co_orig = co_ref_get(match_obj);
     else
 	*co_orig = match_obj;
+    if (tr){
+	tr->ct_end = cligen_trace_phase(tr, CT_MATCH, t);
+	tr->ct_cmd = string;
+	tr->ct_result = *result;
+	tr->ct_co = *result == CG_MATCH ? *co_orig : NULL;
+    }
     retval = 0;
   done:
     if (cvv)
 	cvec_free(cvv);
-    if (cvt)
-	cvec_free(cvt);
-    if (cvr)
-	cvec_free(cvr);
+    if (ct)
+	cligen_tokens_free(ct);
     if (ptmatch && ptmatch != ptn)
 	if (pt_free(ptmatch, 0) < 0)
 	    return -1;
@@ -722,6 +766,89 @@ cliread_parse(cligen_handle  h,
     return retval;
 }
 
+/*! Take the trace of the latest cliread_parse() from the trace record of a handle
+ * The record is marked as taken, so that a command is reported once
+ * @param[in]  h    CLIgen handle
+ * @param[out] tr   Copy of trace record
+ * @retval     tr   Trace of a parsed command
+ * @retval     NULL No trace hook is set or no command is parsed since last taken
+ */
+static cligen_trace *
+cligen_trace_take(cligen_handle h,
+		  cligen_trace *tr)
+{
+    cligen_trace *rec;
+
+    if ((rec = cligen_trace_rec(h)) == NULL || rec->ct_cmd == NULL)
+	return NULL;
+    *tr = *rec;
+    rec->ct_cmd = NULL;
+    return tr;
+}
+
+/*! Call callbacks of a matched command and add them to its trace
+ * @param[in]  h    CLIgen handle
+ * @param[in]  co   Matched object
+ * @param[in]  cvv  Variable vector
+ * @param[in]  tr   Trace of the command, or NULL
+ * @retval     int  Return value of cligen_eval()
+ */
+static int
+cligen_eval_trace(cligen_handle h,
+		  cg_obj       *co,
+		  cvec         *cvv,
+		  cligen_trace *tr)
+{
+    int      retval;
+    uint64_t t;
+
+    if (tr == NULL)
+	return cligen_eval(h, co, cvv);
+    t = cligen_stats_ns();
+    retval = cligen_eval(h, co, cvv);
+    tr->ct_end = cligen_trace_phase(tr, CT_CALLBACK, t);
+    tr->ct_cb_retval = retval;
+    return retval;
+}
+
+/*! Call callbacks of a command parsed by cliread_parse() and report it to the trace hook
+ *
+ * If the command matched, its callbacks are called with cligen_eval(). If a trace hook
+ * is set, it is then called with the phases timed by cliread_parse() and the callbacks.
+ * @param[in]  h         CLIgen handle
+ * @param[in]  result    Result of cliread_parse()
+ * @param[in]  co        Matched object of cliread_parse() (if result is CG_MATCH)
+ * @param[in]  cvv       Variable vector of cliread_parse()
+ * @param[out] cb_retval Return value of callbacks (if result is CG_MATCH)
+ * @retval     0         OK
+ * @retval    -1         Error, the trace hook returned -1
+ * @code
+ *   if (cliread_parse(h, line, pt, &co, cvv, &result, &reason) < 0)
+ *      err;
+ *   if (cligen_eval_parsed(h, result, co, cvv, &cb_retval) < 0)
+ *      err;
+ * @endcode
+ * @see cligen_trace_set
+ */
+int
+cligen_eval_parsed(cligen_handle h,
+		   cligen_result result,
+		   cg_obj       *co,
+		   cvec         *cvv,
+		   int          *cb_retval)
+{
+    cligen_trace  trace;
+    cligen_trace *tr;
+
+    /* Take the trace before callbacks, they may parse other commands */
+    tr = cligen_trace_take(h, &trace);
+    if (result == CG_MATCH)
+	*cb_retval = cligen_eval_trace(h, co, cvv, tr);
+    if (tr && cligen_trace_report(h, tr) < 0)
+	return -1;
+    return 0;
+}
+
 /*! Read line interactively from terminal using getline (completion, etc)
  *
  * @param[in]  h       CLIgen handle
@@ -746,8 +873,10 @@ cliread(cligen_handle h,
 	if (gl_getline(h, &buf) < 0)
 	    goto done;
 	cli_trim(&buf, cligen_comment(h));
-    } while (strlen(buf) == 0 && !gl_eof());
-    if (gl_eof())
+    } while (strlen(buf) == 0 && !gl_eof(h));
+    /* Completion state of this line is not reused on the next line */
+    match_cache_flush(h);
+    if (gl_eof(h))
 	goto eof;
     if (hist_add(h, buf) < 0)
 	goto done;
@@ -816,7 +945,7 @@ cliread_eval(cligen_handle  h,
 {
     int         retval = -1;
     cg_obj     *matchobj;    /* matching syntax node */
-    cvec       *cvv;
+    cvec       *cvv = NULL;
     parse_tree *pt = NULL;     /* Orig */
 
     if (h == NULL){
@@ -839,18 +968,680 @@ cliread_eval(cligen_handle  h,
     }
     if (cliread_parse(h, *line, pt, &matchobj, cvv, result, reason) < 0)
 	goto done;
-    if (*result == CG_MATCH)
-	*cb_retval = cligen_eval(h, matchobj, cvv);
-    cvec_free(cvv);	
+    if (cligen_eval_parsed(h, *result, matchobj, cvv, cb_retval) < 0)
+	goto done;
  ok:
     retval = 0;
  done:
-    /* XXX: Get parse-tree */
-    if (pt && pt_expand_treeref_cleanup(pt) < 0) 
-	retval = -1;
+    if (cvv)
+	cvec_free(cvv);	
     return retval;
 }
 	       
+/*! Default batch reporting function: print errors on stdout
+ * @see cligen_batch_cb_t
+ */
+static int
+cligen_batch_report(cligen_handle h,
+		    int           linenr,
+		    char         *line,
+		    cligen_result result,
+		    int           cb_retval,
+		    char         *reason,
+		    void         *arg)
+{
+    switch (result){
+    case CG_ERROR:
+	printf("%d: CLI read error\n", linenr);
+	break;
+    case CG_NOMATCH:
+	printf("%d: CLI syntax error in: \"%s\": %s\n", linenr, line, reason);
+	break;
+    case CG_MATCH:
+	if (cb_retval < 0)
+	    printf("%d: CLI callback error\n", linenr);
+	break;
+    default: /* multiple matches */
+	printf("%d: Ambiguous command\n", linenr);
+	break;
+    }
+    return 0;
+}
+
+/*! Parse and evaluate one line in a batch
+ * @param[in]     h      CLIgen handle
+ * @param[in]     linenr Line number, first line is 1
+ * @param[in]     line   Line, is modified (trimmed)
+ * @param[in]     cvv    Empty variable vector, reused between lines
+ * @param[in]     fn     Reporting function
+ * @param[in]     arg    Argument to fn
+ * @param[in,out] nerr   Incremented if line is not a match or callback fails
+ * @retval        0      OK, continue
+ * @retval       -1      Error, abort batch
+ */
+static int
+cligen_eval_batch_line(cligen_handle      h,
+		       int                linenr,
+		       char              *line,
+		       cvec              *cvv,
+		       cligen_batch_cb_t *fn,
+		       void              *arg,
+		       int               *nerr)
+{
+    int           retval = -1;
+    parse_tree   *pt;
+    cg_obj       *matchobj = NULL;
+    cligen_result result = CG_ERROR;
+    int           cb_retval = 0;
+    char         *reason = NULL;
+
+    cli_trim(&line, cligen_comment(h));
+    if (strlen(line) == 0){ /* Empty or comment line */
+	retval = 0;
+	goto done;
+    }
+    if ((pt = cligen_ph_active_get(h)) == NULL){
+	fprintf(stderr, "No active parse-tree found\n");
+	goto done;
+    }
+    if (cliread_parse(h, line, pt, &matchobj, cvv, &result, &reason) < 0)
+	goto done;
+    if (cligen_eval_parsed(h, result, matchobj, cvv, &cb_retval) < 0)
+	goto done;
+    if (result != CG_MATCH || cb_retval < 0)
+	(*nerr)++;
+    if ((*fn)(h, linenr, line, result, cb_retval, reason, arg) < 0)
+	goto done;
+    retval = 0;
+ done:
+    if (reason)
+	free(reason);
+    cvec_reset(cvv);
+    return retval;
+}
+
+/*! A line of a pipelined batch, parsed but not yet reported
+ * @see cligen_pipeline
+ */
+struct pipeline_line {
+    int           pl_linenr;    /* Line number given to cligen_pipeline_line */
+    char         *pl_buf;       /* Copy of line */
+    size_t        pl_buflen;    /* Allocated length of pl_buf */
+    char         *pl_line;      /* Trimmed line in pl_buf */
+    cligen_result pl_result;    /* Parse result */
+    char         *pl_reason;    /* Error reason if no match */
+    cg_obj       *pl_co;        /* Matched object if pl_result is CG_MATCH */
+    cvec         *pl_cvv;       /* Variables of matched command */
+    int           pl_eval;      /* Call callbacks of pl_co */
+    int           pl_cb_retval; /* Return value of callbacks */
+    int           pl_skip;      /* Not evaluated since a callback requested exit */
+    int           pl_traced;    /* pl_trace is set, ie a trace hook is set */
+    cligen_trace  pl_trace;     /* Trace of line, callbacks are added by the worker */
+};
+
+/*! Pipelined batch: lines are parsed by the caller while callbacks run in a worker
+ *
+ * Lines are numbered in the order they are given. Line i is in cp_vec[i % cp_depth].
+ * cp_reported <= cp_done <= cp_parsed <= cp_reported + cp_depth. The caller owns
+ * lines from cp_parsed (to parse) and below cp_done (to report), the worker owns the
+ * lines between cp_done and cp_parsed. The counters are changed with cp_mutex locked.
+ */
+struct cligen_pipeline {
+    cligen_handle          cp_h;
+    cligen_batch_cb_t     *cp_fn;      /* Reporting function */
+    void                  *cp_arg;     /* Argument to cp_fn */
+    int                    cp_depth;   /* Length of cp_vec */
+    struct pipeline_line  *cp_vec;     /* Ring of lines */
+    uint64_t               cp_parsed;  /* Lines parsed, given to worker */
+    uint64_t               cp_done;    /* Lines whose callbacks are done */
+    uint64_t               cp_reported;/* Lines reported by cp_fn */
+    int                    cp_nerr;    /* Lines not matching or where a callback failed */
+    int                    cp_exiting; /* A callback requested exit, see cligen_exiting */
+    int                    cp_abort;   /* cp_fn returned -1 */
+    int                    cp_stop;    /* Worker should exit when all lines are done */
+    int                    cp_running; /* Worker thread is started */
+    pthread_t              cp_tid;
+    pthread_mutex_t        cp_mutex;
+    pthread_cond_t         cp_work;    /* Signalled when a line is parsed or on stop */
+    pthread_cond_t         cp_cond;    /* Signalled when callbacks of a line are done */
+};
+
+/*! Call callbacks of a parsed line of a pipeline
+ * @param[in]  p       Pipeline
+ * @param[in]  pl      Parsed line
+ * @param[in]  exiting A callback of an earlier line has requested exit
+ * @retval     1       Exit is requested, by an earlier line or by a callback of this line
+ * @retval     0       No exit requested
+ */
+static int
+pipeline_eval(cligen_pipeline      *p,
+	      struct pipeline_line *pl,
+	      int                   exiting)
+{
+    pl->pl_skip = exiting;
+    if (pl->pl_eval && !exiting){
+	pl->pl_cb_retval = cligen_eval_trace(p->cp_h, pl->pl_co, pl->pl_cvv,
+					     pl->pl_traced ? &pl->pl_trace : NULL);
+	exiting = cligen_exiting(p->cp_h);
+    }
+    return exiting;
+}
+
+/*! Check if a parsed line changes the working point, see cligen_wp_set
+ * Such lines are not pipelined, their callbacks are called in the calling thread
+ * when the callbacks of all earlier lines are done.
+ * @param[in]  co      Matched object
+ */
+static int
+pipeline_serial(cg_obj *co)
+{
+    struct cg_callback *cc;
+
+    for (cc = co_callbacks_get(co); cc; cc = cc->cc_next)
+	if (cc->cc_fn_vec == cligen_wp_set ||
+	    cc->cc_fn_vec == cligen_wp_up ||
+	    cc->cc_fn_vec == cligen_wp_top)
+	    return 1;
+    return 0;
+}
+
+/*! Worker thread of a pipeline: call callbacks of parsed lines in order
+ *
+ * The matched object and callback name are kept in the worker, see cligen_eval_local
+ */
+static void *
+pipeline_worker(void *arg)
+{
+    cligen_pipeline      *p = (cligen_pipeline *)arg;
+    struct pipeline_line *pl;
+    int                   exiting;
+
+    cligen_eval_local(1);
+    pthread_mutex_lock(&p->cp_mutex);
+    while (1){
+	while (p->cp_done == p->cp_parsed && !p->cp_stop)
+	    pthread_cond_wait(&p->cp_work, &p->cp_mutex);
+	if (p->cp_done == p->cp_parsed)
+	    break;
+	pl = &p->cp_vec[p->cp_done % p->cp_depth];
+	exiting = p->cp_exiting;
+	pthread_mutex_unlock(&p->cp_mutex);
+	exiting = pipeline_eval(p, pl, exiting);
+	pthread_mutex_lock(&p->cp_mutex);
+	if (exiting)
+	    p->cp_exiting = 1;
+	p->cp_done++;
+	pthread_cond_signal(&p->cp_cond);
+    }
+    pthread_mutex_unlock(&p->cp_mutex);
+    cligen_eval_local(0);
+    return NULL;
+}
+
+/*! Report lines of a pipeline in order
+ * @param[in]  p     Pipeline
+ * @param[in]  min   Wait until at least this many lines are reported
+ * @retval     0     OK
+ * @retval    -1     Error, the reporting function returned -1
+ */
+static int
+pipeline_report(cligen_pipeline *p,
+		uint64_t         min)
+{
+    struct pipeline_line *pl;
+    uint64_t              done;
+
+    while (1){
+	pthread_mutex_lock(&p->cp_mutex);
+	while (p->cp_reported == p->cp_done && p->cp_reported < min)
+	    pthread_cond_wait(&p->cp_cond, &p->cp_mutex);
+	done = p->cp_done;
+	pthread_mutex_unlock(&p->cp_mutex);
+	if (p->cp_reported == done)
+	    break;
+	for (; p->cp_reported < done; p->cp_reported++){
+	    pl = &p->cp_vec[p->cp_reported % p->cp_depth];
+	    if (!pl->pl_skip && !p->cp_abort){
+		if (pl->pl_result != CG_MATCH || pl->pl_cb_retval < 0)
+		    p->cp_nerr++;
+		if (pl->pl_traced && cligen_trace_report(p->cp_h, &pl->pl_trace) < 0)
+		    p->cp_abort = 1;
+		else if ((*p->cp_fn)(p->cp_h, pl->pl_linenr, pl->pl_line, pl->pl_result,
+				pl->pl_cb_retval, pl->pl_reason, p->cp_arg) < 0)
+		    p->cp_abort = 1;
+	    }
+	    if (pl->pl_reason){
+		free(pl->pl_reason);
+		pl->pl_reason = NULL;
+	    }
+	    cvec_reset(pl->pl_cvv);
+	}
+    }
+    return p->cp_abort ? -1 : 0;
+}
+
+/*! Create a pipeline where callbacks of a line run while the following lines are parsed
+ *
+ * Lines given with cligen_pipeline_line() are parsed in the calling thread, and the
+ * callbacks of matching lines are called in order in a worker thread. Results are
+ * reported by fn in the calling thread, in line order, when the callbacks of the line
+ * are done.
+ * Pipelining is only valid for callbacks without side effects on the handle: callbacks
+ * run while the calling thread parses with the same handle, so a callback must not
+ * change parse-trees, the active tree, working points or other handle settings, and
+ * the reporting function must not use cligen_output.
+ * The matched object and callback name seen by callbacks are kept in the worker, see
+ * cligen_co_match(). Lines calling cligen_wp_set(), cligen_wp_up() or cligen_wp_top()
+ * are not pipelined: they are called in the calling thread when all earlier lines are
+ * done. An application giving lines with other such callbacks must call
+ * cligen_pipeline_barrier() before giving the line, and give the next line only when
+ * the barrier after it returns.
+ * Callback and expand functions are mapped in the calling thread,
+ * see cligen_str2fn_lazy_set.
+ * @param[in]  h      CLIgen handle
+ * @param[in]  depth  Max number of lines parsed but not yet reported, at least 1
+ * @param[in]  fn     Reporting function, or NULL to print errors on stdout
+ * @param[in]  arg    Argument to fn
+ * @retval     p      Pipeline, free with cligen_pipeline_free()
+ * @retval     NULL   Error
+ * @code
+ *   cligen_pipeline *p = cligen_pipeline_new(h, 16, NULL, NULL);
+ *   for (i=0; i<nlines; i++)
+ *      if (cligen_pipeline_line(p, i+1, lines[i]) < 0)
+ *         break;
+ *   cligen_pipeline_barrier(p, &nerr);
+ *   cligen_pipeline_free(p);
+ * @endcode
+ * @see cligen_batch_pipeline_set  to pipeline cligen_eval_batch()
+ */
+cligen_pipeline *
+cligen_pipeline_new(cligen_handle      h,
+		    int                depth,
+		    cligen_batch_cb_t *fn,
+		    void              *arg)
+{
+    cligen_pipeline *p = NULL;
+    int              i;
+
+    if (h == NULL || depth < 1){
+	errno = EINVAL;
+	return NULL;
+    }
+    if ((p = malloc(sizeof(*p))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    memset(p, 0, sizeof(*p));
+    p->cp_h = h;
+    p->cp_fn = fn ? fn : cligen_batch_report;
+    p->cp_arg = arg;
+    p->cp_depth = depth;
+    pthread_mutex_init(&p->cp_mutex, NULL);
+    pthread_cond_init(&p->cp_work, NULL);
+    pthread_cond_init(&p->cp_cond, NULL);
+    if ((p->cp_vec = calloc(depth, sizeof(struct pipeline_line))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	goto err;
+    }
+    for (i=0; i<depth; i++)
+	if ((p->cp_vec[i].pl_cvv = cvec_new(0)) == NULL)
+	    goto err;
+    if ((errno = pthread_create(&p->cp_tid, NULL, pipeline_worker, p)) != 0){
+	fprintf(stderr, "%s: pthread_create: %s\n", __FUNCTION__, strerror(errno));
+	goto err;
+    }
+    p->cp_running = 1;
+    return p;
+ err:
+    cligen_pipeline_free(p);
+    return NULL;
+}
+
+/*! Parse a line and queue its callbacks in a pipeline
+ *
+ * Waits if depth lines are parsed but not yet reported. Lines whose callbacks are
+ * done are reported before returning.
+ * Empty and comment lines are ignored. If a callback has requested exit, see
+ * cligen_exiting(), the line is ignored and callbacks of lines queued after that
+ * callback are not called.
+ * @param[in]  p      Pipeline
+ * @param[in]  linenr Line number, given to the reporting function
+ * @param[in]  line   Line, is not modified
+ * @retval     0      OK
+ * @retval    -1      Error, or a previous report returned -1
+ */
+int
+cligen_pipeline_line(cligen_pipeline *p,
+		     int              linenr,
+		     char            *line)
+{
+    int                   retval = -1;
+    cligen_handle         h;
+    struct pipeline_line *pl;
+    struct cg_callback   *cc;
+    parse_tree           *pt;
+    size_t                len;
+    int                   exiting;
+
+    if (p == NULL || line == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    h = p->cp_h;
+    if (p->cp_parsed - p->cp_reported == p->cp_depth &&
+	pipeline_report(p, p->cp_parsed - p->cp_depth + 1) < 0)
+	goto done;
+    if (p->cp_abort)
+	goto done;
+    pthread_mutex_lock(&p->cp_mutex);
+    if (p->cp_exiting){
+	pthread_mutex_unlock(&p->cp_mutex);
+	goto ok;
+    }
+    pthread_mutex_unlock(&p->cp_mutex);
+    pl = &p->cp_vec[p->cp_parsed % p->cp_depth];
+    len = strlen(line) + 1;
+    if (len > pl->pl_buflen){
+	if ((pl->pl_buf = realloc(pl->pl_buf, len)) == NULL){
+	    pl->pl_buflen = 0;
+	    fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	    goto done;
+	}
+	pl->pl_buflen = len;
+    }
+    memcpy(pl->pl_buf, line, len);
+    pl->pl_line = pl->pl_buf;
+    cli_trim(&pl->pl_line, cligen_comment(h));
+    if (strlen(pl->pl_line) == 0) /* Empty or comment line */
+	goto ok;
+    if ((pt = cligen_ph_active_get(h)) == NULL){
+	fprintf(stderr, "No active parse-tree found\n");
+	goto done;
+    }
+    pl->pl_linenr = linenr;
+    pl->pl_result = CG_ERROR;
+    pl->pl_co = NULL;
+    pl->pl_cb_retval = 0;
+    pl->pl_eval = 0;
+    if (cliread_parse(h, pl->pl_line, pt, &pl->pl_co, pl->pl_cvv,
+		      &pl->pl_result, &pl->pl_reason) < 0)
+	goto done;
+    pl->pl_traced = cligen_trace_take(h, &pl->pl_trace) != NULL;
+    if (pl->pl_result == CG_MATCH){
+	pl->pl_eval = 1;
+	/* Map functions here, the lazy mapping is not shared with the worker */
+	for (cc = co_callbacks_get(pl->pl_co); cc; cc = cc->cc_next)
+	    if (cc->cc_fn_vec == NULL && cligen_callbackv_bind(h, cc) < 0){
+		pl->pl_cb_retval = -1;
+		pl->pl_trace.ct_cb_retval = -1;
+		pl->pl_eval = 0;
+		break;
+	    }
+    }
+    if (pl->pl_eval && pipeline_serial(pl->pl_co)){
+	/* Barrier: the worker is idle while the callbacks are called here */
+	if (pipeline_report(p, p->cp_parsed) < 0)
+	    goto done;
+	pthread_mutex_lock(&p->cp_mutex);
+	exiting = p->cp_exiting;
+	pthread_mutex_unlock(&p->cp_mutex);
+	exiting = pipeline_eval(p, pl, exiting);
+	pthread_mutex_lock(&p->cp_mutex);
+	if (exiting)
+	    p->cp_exiting = 1;
+	p->cp_parsed++;
+	p->cp_done++;
+	pthread_mutex_unlock(&p->cp_mutex);
+    }
+    else {
+	pthread_mutex_lock(&p->cp_mutex);
+	p->cp_parsed++;
+	pthread_cond_signal(&p->cp_work);
+	pthread_mutex_unlock(&p->cp_mutex);
+    }
+    if (pipeline_report(p, 0) < 0)
+	goto done;
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Wait until callbacks of all lines given to a pipeline are done and reported
+ * @param[in]  p      Pipeline
+ * @param[out] nerr   Number of lines that did not match or where a callback failed,
+ *                    since the pipeline was created (if set)
+ * @retval     0      OK
+ * @retval    -1      Error, the reporting function returned -1
+ */
+int
+cligen_pipeline_barrier(cligen_pipeline *p,
+			int             *nerr)
+{
+    int retval;
+
+    if (p == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    retval = pipeline_report(p, p->cp_parsed);
+    if (nerr)
+	*nerr = p->cp_nerr;
+    return retval;
+}
+
+/*! Check if a callback called in a pipeline has requested exit
+ * @param[in]  p      Pipeline
+ * @retval     1      Exit requested, following lines are ignored
+ * @retval     0      No exit requested
+ */
+int
+cligen_pipeline_exiting(cligen_pipeline *p)
+{
+    int exiting;
+
+    pthread_mutex_lock(&p->cp_mutex);
+    exiting = p->cp_exiting;
+    pthread_mutex_unlock(&p->cp_mutex);
+    return exiting;
+}
+
+/*! Stop the worker thread and free a pipeline
+ * Waits for callbacks of lines already given. Lines not yet reported are dropped,
+ * call cligen_pipeline_barrier() first to report them.
+ * @param[in]  p      Pipeline
+ * @retval     0      OK
+ */
+int
+cligen_pipeline_free(cligen_pipeline *p)
+{
+    struct pipeline_line *pl;
+    int                   i;
+
+    if (p == NULL)
+	return 0;
+    if (p->cp_running){
+	pthread_mutex_lock(&p->cp_mutex);
+	p->cp_stop = 1;
+	pthread_cond_signal(&p->cp_work);
+	pthread_mutex_unlock(&p->cp_mutex);
+	pthread_join(p->cp_tid, NULL);
+    }
+    pthread_mutex_destroy(&p->cp_mutex);
+    pthread_cond_destroy(&p->cp_work);
+    pthread_cond_destroy(&p->cp_cond);
+    if (p->cp_vec){
+	for (i=0; i<p->cp_depth; i++){
+	    pl = &p->cp_vec[i];
+	    if (pl->pl_buf)
+		free(pl->pl_buf);
+	    if (pl->pl_reason)
+		free(pl->pl_reason);
+	    if (pl->pl_cvv)
+		cvec_free(pl->pl_cvv);
+	}
+	free(p->cp_vec);
+    }
+    free(p);
+    return 0;
+}
+
+/*! Parse and evaluate all lines of a file non-interactively
+ *
+ * Each line is parsed and its callback invoked in the active parse-tree, as
+ * with cliread_eval() but without terminal I/O and history. Scratch state,
+ * line buffer and variable vector, is reused between lines
+ * and tree references are expanded once unless the trees are changed.
+ * A syntax or callback error in one line does not stop the batch, it is
+ * reported by fn and counted in nerr.
+ * The batch stops at end-of-file, if a callback sets cligen_exiting(), or if
+ * fn returns -1.
+ * If cligen_batch_pipeline_set() is set, callbacks are called in a worker thread
+ * while the following lines are parsed, see cligen_pipeline_new(). Lines are still
+ * reported in order. There is no barrier between lines, so callbacks must not have
+ * side effects on the handle.
+ * @param[in]  h     CLIgen handle
+ * @param[in]  f     Open file to read lines from
+ * @param[in]  fn    Reporting function called for each non-empty line, or NULL to
+ *                   print errors on stdout
+ * @param[in]  arg   Argument to fn
+ * @param[out] nerr  Number of lines that did not match or where a callback failed (if set)
+ * @retval     0     OK
+ * @retval    -1     Error
+ * @see cligen_eval_batch_vec  for an array of lines
+ */
+int
+cligen_eval_batch(cligen_handle      h,
+		  FILE              *f,
+		  cligen_batch_cb_t *fn,
+		  void              *arg,
+		  int               *nerr)
+{
+    int     retval = -1;
+    char   *buf = NULL;
+    size_t  buflen = 0;
+    cvec   *cvv = NULL;
+    int     linenr = 0;
+    int     n = 0;
+    cligen_pipeline *p = NULL;
+
+    if (h == NULL || f == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    if (fn == NULL)
+	fn = cligen_batch_report;
+    if (cligen_batch_pipeline(h) > 0){
+	if ((p = cligen_pipeline_new(h, cligen_batch_pipeline(h), fn, arg)) == NULL)
+	    goto done;
+	while (!cligen_pipeline_exiting(p) && getline(&buf, &buflen, f) >= 0){
+	    linenr++;
+	    if (cligen_pipeline_line(p, linenr, buf) < 0)
+		goto done;
+	}
+	if (cligen_pipeline_barrier(p, &n) < 0)
+	    goto done;
+    }
+    else {
+	if ((cvv = cvec_new(0)) == NULL)
+	    goto done;
+	while (!cligen_exiting(h) && getline(&buf, &buflen, f) >= 0){
+	    linenr++;
+	    if (cligen_eval_batch_line(h, linenr, buf, cvv, fn, arg, &n) < 0)
+		goto done;
+	}
+    }
+    if (ferror(f))
+	goto done;
+    if (nerr)
+	*nerr = n;
+    retval = 0;
+ done:
+    if (p)
+	cligen_pipeline_free(p);
+    if (buf)
+	free(buf);
+    if (cvv)
+	cvec_free(cvv);
+    return retval;
+}
+
+/*! Parse and evaluate an array of lines non-interactively
+ *
+ * Same as cligen_eval_batch() but lines are given as an array. The lines are
+ * not modified.
+ * @param[in]  h      CLIgen handle
+ * @param[in]  lines  Vector of lines
+ * @param[in]  nlines Length of lines
+ * @param[in]  fn     Reporting function, or NULL to print errors on stdout
+ * @param[in]  arg    Argument to fn
+ * @param[out] nerr   Number of lines that did not match or where a callback failed (if set)
+ * @retval     0      OK
+ * @retval    -1      Error
+ * @see cligen_eval_batch
+ */
+int
+cligen_eval_batch_vec(cligen_handle      h,
+		      char             **lines,
+		      int                nlines,
+		      cligen_batch_cb_t *fn,
+		      void              *arg,
+		      int               *nerr)
+{
+    int     retval = -1;
+    char   *buf = NULL;
+    size_t  buflen = 0;
+    size_t  len;
+    cvec   *cvv = NULL;
+    int     i;
+    int     n = 0;
+    cligen_pipeline *p = NULL;
+
+    if (h == NULL || (lines == NULL && nlines)){
+	errno = EINVAL;
+	goto done;
+    }
+    if (fn == NULL)
+	fn = cligen_batch_report;
+    if (cligen_batch_pipeline(h) > 0){
+	if ((p = cligen_pipeline_new(h, cligen_batch_pipeline(h), fn, arg)) == NULL)
+	    goto done;
+	for (i=0; i<nlines && !cligen_pipeline_exiting(p); i++)
+	    if (lines[i] && cligen_pipeline_line(p, i+1, lines[i]) < 0)
+		goto done;
+	if (cligen_pipeline_barrier(p, &n) < 0)
+	    goto done;
+    }
+    else {
+	if ((cvv = cvec_new(0)) == NULL)
+	    goto done;
+	for (i=0; i<nlines && !cligen_exiting(h); i++){
+	    if (lines[i] == NULL)
+		continue;
+	    len = strlen(lines[i]) + 1;
+	    if (len > buflen){
+		if ((buf = realloc(buf, len)) == NULL)
+		    goto done;
+		buflen = len;
+	    }
+	    memcpy(buf, lines[i], len);
+	    if (cligen_eval_batch_line(h, i+1, buf, cvv, fn, arg, &n) < 0)
+		goto done;
+	}
+    }
+    if (nerr)
+	*nerr = n;
+    retval = 0;
+ done:
+    if (p)
+	cligen_pipeline_free(p);
+    if (buf)
+	free(buf);
+    if (cvv)
+	cvec_free(cvv);
+    return retval;
+}
+
 /*! Evaluate a matched CV and a cv variable list
  *
  * @param[in]  h    Application-specific pointer to a struct
@@ -872,10 +1663,18 @@ cligen_eval(cligen_handle h,
     struct cg_callback *cc;
     int                 retval = 0;
     cvec               *argv;
+    cligen_handle       h0;
 
-    if (h)
+    if (h){
 	cligen_co_match_set(h, co);
-    for (cc = co->co_callbacks; cc; cc=cc->cc_next){
+	handle(h)->ch_output_defer++; /* Output is written when command is done */
+    }
+    h0 = cligen_eval_handle_set(h); /* cligen_output() of callbacks, see cligen_output */
+    for (cc = co_callbacks_get(co); cc; cc=cc->cc_next){
+	if (cc->cc_fn_vec == NULL && cligen_callbackv_bind(h, cc) < 0){
+	    retval = -1;
+	    break;
+	}
 	/* Vector cvec argument to callback */
     	if (cc->cc_fn_vec){
 	    argv = cc->cc_cvec ? cvec_dup(cc->cc_cvec) : NULL;
@@ -894,6 +1693,10 @@ cligen_eval(cligen_handle h,
 	    cligen_fn_str_set(h, NULL);
 	}
     }
+    cligen_eval_handle_set(h0);
+    if (h && --handle(h)->ch_output_defer == 0 &&
+	cligen_output_flush(h) < 0)
+	retval = -1;
     return retval;
 }
 
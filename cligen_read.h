@@ -42,15 +42,44 @@
  * Constants
  */
 
+/*
+ * Types
+ */
+/*! Batch reporting function, called once for each evaluated line
+ * @param[in]  h         CLIgen handle
+ * @param[in]  linenr    Line number, first line is 1
+ * @param[in]  line      Trimmed line
+ * @param[in]  result    Parse result, see cligen_result
+ * @param[in]  cb_retval Return value of callback (if result is CG_MATCH)
+ * @param[in]  reason    Error reason if result is CG_NOMATCH, or NULL
+ * @param[in]  arg       Argument given to cligen_eval_batch
+ * @retval     0         OK, continue
+ * @retval    -1         Error, stop batch
+ */
+typedef int (cligen_batch_cb_t)(cligen_handle h, int linenr, char *line, cligen_result result, int cb_retval, char *reason, void *arg);
+
+/*! Pipelined batch, see cligen_pipeline_new */
+typedef struct cligen_pipeline cligen_pipeline;
+
 /*
  * Function Prototypes
  */
 void cliread_init(cligen_handle h);
+int  cli_tab_hook(cligen_handle h, int *cursorp);
+int  cli_qmark_hook(cligen_handle h, char *string);
 int  cliread(cligen_handle h, char **strinpg);
 void cli_trim (char **line, char comment);
 int cliread_parse(cligen_handle h, char *, parse_tree *pt, cg_obj **, cvec *cvv, cligen_result *result, char **reason);
 int cliread_eval(cligen_handle h, char **line, int *cb_ret, cligen_result *result, char **reason);
 int cligen_eval(cligen_handle h, cg_obj *co_match, cvec *vr);
+int cligen_eval_parsed(cligen_handle h, cligen_result result, cg_obj *co, cvec *cvv, int *cb_retval);
+int cligen_eval_batch(cligen_handle h, FILE *f, cligen_batch_cb_t *fn, void *arg, int *nerr);
+int cligen_eval_batch_vec(cligen_handle h, char **lines, int nlines, cligen_batch_cb_t *fn, void *arg, int *nerr);
+cligen_pipeline *cligen_pipeline_new(cligen_handle h, int depth, cligen_batch_cb_t *fn, void *arg);
+int cligen_pipeline_line(cligen_pipeline *p, int linenr, char *line);
+int cligen_pipeline_barrier(cligen_pipeline *p, int *nerr);
+int cligen_pipeline_exiting(cligen_pipeline *p);
+int cligen_pipeline_free(cligen_pipeline *p);
 void cligen_echo_on(void);
 void cligen_echo_off(void);
 
@@ -61,6 +61,23 @@
 #include "cligen_object.h"
 #include "cligen_handle.h"
 #include "cligen_regex.h"
+#include "cligen_stats.h"
+#include "cligen_handle_internal.h"
+#include "cligen_stats_internal.h"
+
+/*
+ * Types
+ */
+/*! Cache entry of a compiled regexp, keyed by pattern and regex engine
+ * An invalid pattern is also cached (rc_re is NULL) so it is not recompiled.
+ * @see match_regexp
+ */
+struct regex_cache{
+    struct regex_cache *rc_next;
+    char               *rc_pattern; /* Regexp pattern as given, malloc:d */
+    int                 rc_xsd;     /* 0: POSIX, 1: LIBXML2 XSD, see cligen_regex_xsd */
+    void               *rc_re;      /* Compiled regexp, or NULL if invalid */
+};
 
 /*-------------------------- POSIX -------------------------*/
 
@@ -114,8 +131,11 @@ cligen_regex_posix_compile(char  *regexp,
     if (regcomp(re, cbuf_get(cb), REG_NOSUB|REG_EXTENDED) != 0) 
 	goto fail;
     *recomp = re;
+    re = NULL;
     retval = 1;
  done:
+    if (re)
+	free(re);
     if (cb)
 	cbuf_free(cb);
     return retval;
@@ -246,6 +266,7 @@ cligen_regex_compile(cligen_handle h,
 {
     int   retval = -1;
 
+    cligen_stats_inc(h, cs_regex_compile);
     if (cligen_regex_xsd(h) == 0) 
 	retval = cligen_regex_posix_compile(regexp, recomp);
     else 
@@ -264,6 +285,7 @@ cligen_regex_exec(cligen_handle h,
 {
     int   retval = -1;
 
+    cligen_stats_inc(h, cs_regex_exec);
     if (cligen_regex_xsd(h) == 0) 
 	retval = cligen_regex_posix_exec(recomp, string);
     else 
@@ -290,8 +312,90 @@ cligen_regex_free(cligen_handle h,
     return retval;
 }
 
+/*! Free all compiled regexps cached in the handle
+ * Compiled regexps are cached by match_regexp and are otherwise kept until
+ * cligen_exit. Call this to release them earlier, eg after replacing parse-trees.
+ * @param[in]  h       Clicon handle
+ */
+int
+cligen_regex_cache_flush(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    struct regex_cache   *rc;
+
+    while ((rc = ch->ch_regex_cache) != NULL){
+	ch->ch_regex_cache = rc->rc_next;
+	if (rc->rc_re){
+	    if (rc->rc_xsd == 0){
+		cligen_regex_posix_free(rc->rc_re);
+		free(rc->rc_re);
+	    }
+	    else
+		cligen_regex_libxml2_free(rc->rc_re);
+	}
+	if (rc->rc_pattern)
+	    free(rc->rc_pattern);
+	free(rc);
+    }
+    return 0;
+}
+
+/*! Get compiled regexp of pattern from handle cache, compile and add if not found
+ * A found entry is moved first in the list.
+ * @param[in]  h       Clicon handle
+ * @param[in]  pattern Pattern string
+ * @param[out] recomp  Compiled regexp, owned by the cache, do not free
+ * @retval     1       OK
+ * @retval     0       Invalid regular expression
+ * @retval    -1       Error
+ */
+static int
+regex_cache_get(cligen_handle h,
+		char         *pattern,
+		void        **recomp)
+{
+    int                   retval = -1;
+    struct cligen_handle *ch = handle(h);
+    struct regex_cache   *rc;
+    struct regex_cache  **rcp;
+    int                   xsd;
+    int                   ret;
+
+    xsd = cligen_regex_xsd(h);
+    rcp = (struct regex_cache **)&ch->ch_regex_cache;
+    while ((rc = *rcp) != NULL){
+	if (rc->rc_xsd == xsd && strcmp(rc->rc_pattern, pattern) == 0){
+	    *rcp = rc->rc_next; /* Move to front */
+	    break;
+	}
+	rcp = &rc->rc_next;
+    }
+    if (rc == NULL){
+	if ((rc = malloc(sizeof(*rc))) == NULL)
+	    goto done;
+	memset(rc, 0, sizeof(*rc));
+	rc->rc_xsd = xsd;
+	if ((rc->rc_pattern = strdup(pattern)) == NULL){
+	    free(rc);
+	    goto done;
+	}
+	if ((ret = cligen_regex_compile(h, pattern, &rc->rc_re)) < 0){
+	    free(rc->rc_pattern);
+	    free(rc);
+	    goto done;
+	}
+    }
+    rc->rc_next = ch->ch_regex_cache;
+    ch->ch_regex_cache = rc;
+    *recomp = rc->rc_re;
+    retval = rc->rc_re ? 1 : 0;
+ done:
+    return retval;
+}
+
 /*! Makes a regexp check of <string> with <pattern>.
  *
+ * The compiled regexp is cached in the handle, see cligen_regex_cache_flush
  * @param[in] h       Clicon handle
  * @param[in] string  Content string to match
  * @param[in] pattern Pattern string to match
@@ -314,7 +418,7 @@ match_regexp(cligen_handle h,
 	errno = EINVAL;
 	goto done;
     }
-    if ((ret = cligen_regex_compile(h, pattern, &re)) < 0)
+    if ((ret = regex_cache_get(h, pattern, &re)) < 0)
 	goto done;
     if (ret == 0)
 	goto fail;
@@ -326,9 +430,6 @@ match_regexp(cligen_handle h,
 	goto fail;
     retval = 1;
  done:
-    if (re){
-	cligen_regex_free(h, re);
-    }
     return retval;
  fail:
     retval = 0;
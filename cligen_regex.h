@@ -48,6 +48,7 @@ int cligen_regex_libxml2_free(void *recomp);
 int cligen_regex_compile(cligen_handle h, char *regexp, void **recomp);
 int cligen_regex_exec(cligen_handle h, void *recomp, char *string);
 int cligen_regex_free(cligen_handle h, void *recomp);
+int cligen_regex_cache_flush(cligen_handle h);
 int match_regexp(cligen_handle h, char *string, char *pattern, int invert);
 
 #endif /* _CLIGEN_REGEX_H_ */
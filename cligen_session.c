@@ -0,0 +1,815 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+ *
+ *
+ * CLIgen sessions: many concurrent CLI users of one handle, see cligen_session.h
+ */
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <netinet/in.h>
+
+#include "cligen_buf.h"
+#include "cligen_cv.h"
+#include "cligen_cvec.h"
+#include "cligen_parsetree.h"
+#include "cligen_pt_head.h"
+#include "cligen_object.h"
+#include "cligen_handle.h"
+#include "cligen_read.h"
+#include "cligen_io.h"
+#include "cligen_match.h"
+#include "cligen_session.h"
+#include "cligen_handle_internal.h"
+
+/*
+ * Constants
+ */
+#define SESSION_BUFLEN_DEFAULT 64    /* Start size of line buffer, doubled when full */
+#define SESSION_OUTPUT_ALLOC   256   /* Start size of output buffer */
+#define SESSION_OUTPUT_KEEP    4096  /* Output buffer larger than this is freed when reset */
+
+/* Escape sequence state */
+#define SESSION_ESC_NONE   0
+#define SESSION_ESC_ESC    1  /* After ESC */
+#define SESSION_ESC_CSI    2  /* After ESC [ */
+
+/*
+ * Types
+ */
+/*! Per-user state of a CLI, the rest is in the handle */
+struct cligen_session {
+    cligen_handle  cs_h;          /* Handle with parse-trees, callbacks and config */
+    char          *cs_buf;        /* Line buffer, swapped with ch_buf while bound */
+    int            cs_buf_size;   /* Allocated length of cs_buf */
+    int            cs_len;        /* Length of line, cursor is at end of line */
+    char          *cs_prompt;     /* Prompt, swapped with ch_prompt while bound */
+    pt_head       *cs_ph;         /* Active parse-tree, or NULL for that of the handle */
+    cbuf          *cs_out;        /* Pending output, allocated on demand */
+    char         **cs_hist;       /* History ring, allocated on first line */
+    int            cs_hist_size;  /* Size of history ring */
+    int            cs_hist_len;   /* Lines in history ring */
+    int            cs_hist_next;  /* Next slot to write in ring */
+    int            cs_hist_cur;   /* Lines back when browsing history, 0: not browsing */
+    cligen_result  cs_result;     /* Result of latest command */
+    int            cs_cb_retval;  /* Callback return value of latest command */
+    void          *cs_arg;        /* Application argument */
+    char           cs_exiting;    /* Swapped with ch_exiting while bound */
+    char           cs_echo;       /* Echo input */
+    char           cs_esc;        /* Escape sequence state, SESSION_ESC_* */
+    char           cs_quote;      /* Previous char was '\', take next literally */
+    char           cs_cr;         /* Previous char was CR, ignore a LF after it */
+};
+
+/*! Create a session of a CLIgen handle
+ *
+ * The session gets the prompt and active parse-tree of the handle. Only the session
+ * struct and a line buffer are allocated, history and output buffers are allocated
+ * when used.
+ * @param[in] h   CLIgen handle, shared by all its sessions
+ * @retval    s   Session, free with cligen_session_free
+ * @retval    NULL Error
+ * @see cligen_session_start  to write the first prompt
+ */
+cligen_session *
+cligen_session_new(cligen_handle h)
+{
+    cligen_session *s;
+
+    if (h == NULL){
+	errno = EINVAL;
+	return NULL;
+    }
+    if ((s = calloc(1, sizeof(*s))) == NULL)
+	return NULL;
+    s->cs_h = h;
+    s->cs_buf_size = SESSION_BUFLEN_DEFAULT;
+    s->cs_hist_size = CLIGEN_SESSION_HISTSIZE_DEFAULT;
+    s->cs_echo = 1;
+    if ((s->cs_buf = calloc(1, s->cs_buf_size)) == NULL)
+	goto err;
+    if (cligen_prompt(h) && (s->cs_prompt = strdup(cligen_prompt(h))) == NULL)
+	goto err;
+    return s;
+ err:
+    cligen_session_free(s);
+    return NULL;
+}
+
+/*! Free a session
+ * @param[in] s   Session
+ * @note Free all sessions of a handle before cligen_exit(), and not from a callback
+ *       of the session itself
+ */
+int
+cligen_session_free(cligen_session *s)
+{
+    struct cligen_handle *ch;
+    int                   i;
+
+    if (s == NULL)
+	return 0;
+    ch = handle(s->cs_h);
+    if (ch->ch_session_last == s)
+	ch->ch_session_last = NULL;
+    if (s->cs_buf)
+	free(s->cs_buf);
+    if (s->cs_prompt)
+	free(s->cs_prompt);
+    if (s->cs_out)
+	cbuf_free(s->cs_out);
+    if (s->cs_hist){
+	for (i=0; i<s->cs_hist_size; i++)
+	    if (s->cs_hist[i])
+		free(s->cs_hist[i]);
+	free(s->cs_hist);
+    }
+    free(s);
+    return 0;
+}
+
+/*! Get the CLIgen handle of a session
+ * @param[in] s   Session
+ */
+cligen_handle
+cligen_session_handle(cligen_session *s)
+{
+    return s->cs_h;
+}
+
+/*! Get the session being fed, eg in a callback
+ * @param[in] h   CLIgen handle
+ * @retval    s   Session bound to the handle
+ * @retval    NULL No session is fed, eg cligen_loop is used
+ */
+cligen_session *
+cligen_session_active(cligen_handle h)
+{
+    return handle(h)->ch_session;
+}
+
+/*! Active parse-tree header of a handle
+ */
+static pt_head *
+session_ph_active(cligen_handle h)
+{
+    pt_head *ph;
+
+    for (ph = cligen_pt_head_get(h); ph; ph = ph->ph_next)
+	if (ph->ph_active)
+	    return ph;
+    return NULL;
+}
+
+/*! Make a parse-tree header the only active one, NULL keeps the active one
+ */
+static void
+session_ph_activate(cligen_handle h,
+		    pt_head      *ph0)
+{
+    pt_head *ph;
+
+    if (ph0 == NULL)
+	return;
+    for (ph = cligen_pt_head_get(h); ph; ph = ph->ph_next)
+	ph->ph_active = (ph == ph0);
+}
+
+/*! Swap the per-user state of a session into the handle
+ *
+ * Output buffered in the handle for another stream is written first. The completion
+ * state of the handle belongs to the latest bound session and is dropped when another
+ * session is bound.
+ * @param[in] s   Session
+ * @param[out] ph_save Active parse-tree header of the handle, restored by session_unbind
+ */
+static int
+session_bind(cligen_session *s,
+	     pt_head       **ph_save)
+{
+    struct cligen_handle *ch = handle(s->cs_h);
+    char                 *p;
+    int                   i;
+    char                  c;
+
+    if (ch->ch_session != NULL){ /* Eg a callback feeding another session */
+	errno = EBUSY;
+	return -1;
+    }
+    if (cligen_output_flush(s->cs_h) < 0)
+	return -1;
+    if (ch->ch_session_last != s){
+	match_cache_flush(s->cs_h);
+	ch->ch_session_last = s;
+    }
+    ch->ch_session = s;
+    p = ch->ch_buf; ch->ch_buf = s->cs_buf; s->cs_buf = p;
+    i = ch->ch_buf_size; ch->ch_buf_size = s->cs_buf_size; s->cs_buf_size = i;
+    p = ch->ch_prompt; ch->ch_prompt = s->cs_prompt; s->cs_prompt = p;
+    c = ch->ch_exiting; ch->ch_exiting = s->cs_exiting; s->cs_exiting = c;
+    *ph_save = session_ph_active(s->cs_h);
+    session_ph_activate(s->cs_h, s->cs_ph);
+    return 0;
+}
+
+/*! Swap back the state of a bound session and write pending output to it
+ * @param[in] s       Session
+ * @param[in] ph_save Active parse-tree header of the handle before session_bind
+ */
+static int
+session_unbind(cligen_session *s,
+	       pt_head        *ph_save)
+{
+    struct cligen_handle *ch = handle(s->cs_h);
+    int                   retval;
+    char                 *p;
+    int                   i;
+    char                  c;
+
+    retval = cligen_output_flush(s->cs_h);
+    s->cs_ph = session_ph_active(s->cs_h);
+    session_ph_activate(s->cs_h, ph_save);
+    p = ch->ch_buf; ch->ch_buf = s->cs_buf; s->cs_buf = p;
+    i = ch->ch_buf_size; ch->ch_buf_size = s->cs_buf_size; s->cs_buf_size = i;
+    p = ch->ch_prompt; ch->ch_prompt = s->cs_prompt; s->cs_prompt = p;
+    c = ch->ch_exiting; ch->ch_exiting = s->cs_exiting; s->cs_exiting = c;
+    ch->ch_session = NULL;
+    return retval;
+}
+
+/*! Append output to a session
+ *
+ * Used for output of callbacks and help while the session is bound, and may be used by
+ * the application, eg for a banner.
+ * @param[in] s    Session
+ * @param[in] buf  Output data
+ * @param[in] len  Length of buf
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+int
+cligen_session_write(cligen_session *s,
+		     const char     *buf,
+		     size_t          len)
+{
+    if (s->cs_out == NULL &&
+	(s->cs_out = cbuf_new_alloc(SESSION_OUTPUT_ALLOC)) == NULL)
+	return -1;
+    return cbuf_append_buf(s->cs_out, (void*)buf, len);
+}
+
+/*! Get pending output of a session
+ * @param[in]  s    Session
+ * @param[out] len  Length of output
+ * @retval     buf  Output, not null-terminated, valid until the session is fed or reset
+ * @see cligen_session_output_reset  after the output is sent
+ */
+char *
+cligen_session_output(cligen_session *s,
+		      size_t         *len)
+{
+    if (s->cs_out == NULL){
+	*len = 0;
+	return NULL;
+    }
+    *len = cbuf_len(s->cs_out);
+    return cbuf_get(s->cs_out);
+}
+
+/*! Drop pending output of a session, eg after it has been sent
+ * A large output buffer is freed to keep the size of idle sessions small
+ * @param[in]  s    Session
+ */
+int
+cligen_session_output_reset(cligen_session *s)
+{
+    if (s->cs_out == NULL)
+	return 0;
+    if (cbuf_buflen(s->cs_out) > SESSION_OUTPUT_KEEP){
+	cbuf_free(s->cs_out);
+	s->cs_out = NULL;
+    }
+    else
+	cbuf_reset(s->cs_out);
+    return 0;
+}
+
+/*! Write the prompt of the session
+ */
+static int
+session_prompt(cligen_session *s)
+{
+    char *prompt = cligen_prompt(s->cs_h); /* bound */
+
+    if (prompt == NULL)
+	prompt = CLIGEN_PROMPT_DEFAULT;
+    return cligen_session_write(s, prompt, strlen(prompt));
+}
+
+/*! Erase the line on the terminal and write prompt and line again
+ */
+static int
+session_redraw(cligen_session *s)
+{
+    if (cligen_session_write(s, "\r\033[K", 4) < 0)
+	return -1;
+    if (session_prompt(s) < 0)
+	return -1;
+    return cligen_session_write(s, cligen_buf(s->cs_h), s->cs_len);
+}
+
+/*! Write the first prompt of a session
+ * @param[in]  s    Session
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+int
+cligen_session_start(cligen_session *s)
+{
+    char *prompt = s->cs_prompt?s->cs_prompt:CLIGEN_PROMPT_DEFAULT;
+
+    return cligen_session_write(s, prompt, strlen(prompt));
+}
+
+/*! Replace the line of a bound session
+ * @param[in]  s    Session
+ * @param[in]  str  New line
+ */
+static int
+session_line_set(cligen_session *s,
+		 char           *str)
+{
+    size_t len = strlen(str);
+
+    if (cligen_buf_increase(s->cs_h, len) < 0)
+	return -1;
+    memcpy(cligen_buf(s->cs_h), str, len+1);
+    s->cs_len = len;
+    return s->cs_echo ? session_redraw(s) : 0;
+}
+
+/*! Add a line to the history ring of a session
+ */
+static int
+session_hist_add(cligen_session *s,
+		 char           *line)
+{
+    int   prev;
+    char *str;
+
+    if (s->cs_hist_size <= 0)
+	return 0;
+    if (s->cs_hist == NULL &&
+	(s->cs_hist = calloc(s->cs_hist_size, sizeof(char*))) == NULL)
+	return -1;
+    prev = (s->cs_hist_next + s->cs_hist_size - 1) % s->cs_hist_size;
+    if (s->cs_hist_len && strcmp(s->cs_hist[prev], line) == 0)
+	return 0;
+    if ((str = strdup(line)) == NULL)
+	return -1;
+    if (s->cs_hist[s->cs_hist_next])
+	free(s->cs_hist[s->cs_hist_next]);
+    s->cs_hist[s->cs_hist_next] = str;
+    s->cs_hist_next = (s->cs_hist_next + 1) % s->cs_hist_size;
+    if (s->cs_hist_len < s->cs_hist_size)
+	s->cs_hist_len++;
+    return 0;
+}
+
+/*! Step in history of a bound session and copy the line to the line buffer
+ * @param[in]  s    Session
+ * @param[in]  dir  1: older line, -1: newer line
+ */
+static int
+session_hist_step(cligen_session *s,
+		  int             dir)
+{
+    int cur = s->cs_hist_cur + dir;
+    int i;
+
+    if (cur < 0 || cur > s->cs_hist_len)
+	return 0;
+    s->cs_hist_cur = cur;
+    if (cur == 0)
+	return session_line_set(s, "");
+    i = (s->cs_hist_next + s->cs_hist_size - cur) % s->cs_hist_size;
+    return session_line_set(s, s->cs_hist[i]);
+}
+
+/*! Parse and evaluate the line of a bound session, and report errors to the session
+ */
+static int
+session_eval(cligen_session *s)
+{
+    int           retval = -1;
+    cligen_handle h = s->cs_h;
+    char         *line = NULL;
+    char         *str;
+    parse_tree   *pt;
+    cg_obj       *matchobj = NULL;
+    cvec         *cvv = NULL;
+    char         *reason = NULL;
+    cbuf         *cb = NULL;
+
+    if ((line = strdup(cligen_buf(h))) == NULL)
+	goto done;
+    s->cs_len = 0;
+    cligen_buf(h)[0] = '\0';
+    s->cs_hist_cur = 0;
+    match_cache_flush(h);
+    str = line;
+    cli_trim(&str, cligen_comment(h));
+    if (strlen(str) == 0){
+	retval = 0;
+	goto done;
+    }
+    if (session_hist_add(s, str) < 0)
+	goto done;
+    s->cs_result = CG_ERROR;
+    s->cs_cb_retval = 0;
+    if ((cb = cbuf_new_alloc(SESSION_OUTPUT_ALLOC)) == NULL)
+	goto done;
+    if ((pt = cligen_ph_active_get(h)) == NULL)
+	cprintf(cb, "No active parse-tree found\n");
+    else {
+	if ((cvv = cvec_new(0)) == NULL)
+	    goto done;
+	if (cliread_parse(h, str, pt, &matchobj, cvv, &s->cs_result, &reason) < 0)
+	    goto done;
+	if (cligen_eval_parsed(h, s->cs_result, matchobj, cvv, &s->cs_cb_retval) < 0)
+	    goto done;
+	switch (s->cs_result){
+	case CG_MATCH:
+	    if (s->cs_cb_retval < 0)
+		cprintf(cb, "CLI callback error\n");
+	    break;
+	case CG_NOMATCH:
+	    cprintf(cb, "CLI syntax error in: \"%s\": %s\n", str, reason);
+	    break;
+	case CG_ERROR:
+	    cprintf(cb, "CLI read error\n");
+	    break;
+	default: /* multiple matches */
+	    cprintf(cb, "Ambiguous command\n");
+	    break;
+	}
+    }
+    if (cbuf_len(cb) &&
+	cligen_session_write(s, cbuf_get(cb), cbuf_len(cb)) < 0)
+	goto done;
+    retval = 1;
+ done:
+    if (cb)
+	cbuf_free(cb);
+    if (reason)
+	free(reason);
+    if (cvv)
+	cvec_free(cvv);
+    if (line)
+	free(line);
+    return retval;
+}
+
+/*! Process one input char of a bound session
+ * @param[in]  s    Session
+ * @param[in]  c    Input char
+ * @param[out] ev   Events, CLIGEN_SESSION_*
+ */
+static int
+session_char(cligen_session *s,
+	     char            c,
+	     int            *ev)
+{
+    cligen_handle h = s->cs_h;
+    char         *buf;
+    int           cursor;
+    int           len;
+    int           ret;
+
+    if (s->cs_cr){
+	s->cs_cr = 0;
+	if (c == '\n')
+	    return 0;
+    }
+    if (s->cs_esc != SESSION_ESC_NONE){
+	if (s->cs_esc == SESSION_ESC_ESC)
+	    s->cs_esc = (c == '[' || c == 'O') ? SESSION_ESC_CSI : SESSION_ESC_NONE;
+	else if (c >= 0x40 && c <= 0x7e){ /* Final byte */
+	    s->cs_esc = SESSION_ESC_NONE;
+	    if (c == 'A')
+		return session_hist_step(s, 1);
+	    if (c == 'B')
+		return session_hist_step(s, -1);
+	}
+	return 0;
+    }
+    if (s->cs_quote || ((unsigned char)c >= ' ' && c != '\177' && c != '?' && c != '\\')){
+	s->cs_quote = 0;
+	if (cligen_buf_increase(h, s->cs_len+1) < 0)
+	    return -1;
+	buf = cligen_buf(h);
+	buf[s->cs_len++] = c;
+	buf[s->cs_len] = '\0';
+	if (s->cs_echo)
+	    return cligen_session_write(s, &c, 1);
+	return 0;
+    }
+    switch (c){
+    case '\\':
+	s->cs_quote++;
+	break;
+    case '?':
+	if (cli_qmark_hook(h, cligen_buf(h)) < 0)
+	    return -1;
+	return session_redraw(s);
+    case '\t':
+	cursor = s->cs_len;
+	if (cli_tab_hook(h, &cursor) < 0)
+	    return -1;
+	s->cs_len = strlen(cligen_buf(h));
+	return session_redraw(s);
+    case '\r':
+	s->cs_cr++;
+	/* fall through */
+    case '\n':
+	if (s->cs_echo && cligen_session_write(s, "\n", 1) < 0)
+	    return -1;
+	if ((ret = session_eval(s)) < 0)
+	    return -1;
+	if (ret == 1)
+	    *ev |= CLIGEN_SESSION_COMMAND;
+	if (cligen_exiting(h))
+	    break;
+	return session_prompt(s);
+    case '\010': case '\177': /* ^H and DEL */
+	if (s->cs_len == 0)
+	    break;
+	cligen_buf(h)[--s->cs_len] = '\0';
+	if (s->cs_echo)
+	    return cligen_session_write(s, "\b \b", 3);
+	break;
+    case '\025': /* ^U */
+	return session_line_set(s, "");
+    case '\027': /* ^W */
+	buf = cligen_buf(h);
+	len = s->cs_len;
+	while (len && buf[len-1] == ' ')
+	    len--;
+	while (len && buf[len-1] != ' ')
+	    len--;
+	buf[len] = '\0';
+	s->cs_len = len;
+	return s->cs_echo ? session_redraw(s) : 0;
+    case '\003': /* ^C */
+	s->cs_len = 0;
+	cligen_buf(h)[0] = '\0';
+	s->cs_hist_cur = 0;
+	if (cligen_session_write(s, "^C\n", 3) < 0)
+	    return -1;
+	return session_prompt(s);
+    case '\004': /* ^D */
+	if (s->cs_len == 0)
+	    cligen_exiting_set(h, 1);
+	break;
+    case '\014': /* ^L */
+	return session_redraw(s);
+    case '\020': /* ^P */
+	return session_hist_step(s, 1);
+    case '\016': /* ^N */
+	return session_hist_step(s, -1);
+    case '\033': /* ESC */
+	s->cs_esc = SESSION_ESC_ESC;
+	break;
+    default:
+	break;
+    }
+    return 0;
+}
+
+/*! Push input to a session
+ *
+ * The input is processed as typed on a terminal in raw mode: chars are echoed, a
+ * command is evaluated at end of line, and TAB and '?' show completions and help.
+ * All output, including output of callbacks made with cligen_output(), is collected in
+ * the session, see cligen_session_output.
+ * Input after the session has ended is ignored.
+ * @param[in]  s    Session
+ * @param[in]  buf  Input data, eg as read from a socket
+ * @param[in]  len  Length of buf
+ * @retval     ev   Events, OR of CLIGEN_SESSION_OUTPUT, CLIGEN_SESSION_COMMAND and
+ *                  CLIGEN_SESSION_EXIT
+ * @retval    -1    Error
+ * @note Only one session of a handle may be fed at a time
+ */
+int
+cligen_session_feed(cligen_session *s,
+		    const char     *buf,
+		    size_t          len)
+{
+    int      ev = 0;
+    pt_head *ph_save = NULL;
+    size_t   i;
+    int      ret = 0;
+
+    if (s == NULL || (buf == NULL && len)){
+	errno = EINVAL;
+	return -1;
+    }
+    if (s->cs_exiting)
+	return CLIGEN_SESSION_EXIT;
+    if (session_bind(s, &ph_save) < 0)
+	return -1;
+    for (i=0; i<len && ret == 0 && !cligen_exiting(s->cs_h); i++)
+	ret = session_char(s, buf[i], &ev);
+    if (session_unbind(s, ph_save) < 0)
+	ret = -1;
+    if (ret < 0)
+	return -1;
+    if (s->cs_exiting)
+	ev |= CLIGEN_SESSION_EXIT;
+    if (s->cs_out && cbuf_len(s->cs_out))
+	ev |= CLIGEN_SESSION_OUTPUT;
+    return ev;
+}
+
+/*! Get the result of the latest command of a session
+ * @param[in]  s          Session
+ * @param[out] result     Match result, see cligen_result
+ * @param[out] cb_retval  Return value of callback if result is CG_MATCH
+ */
+int
+cligen_session_result(cligen_session *s,
+		      cligen_result  *result,
+		      int            *cb_retval)
+{
+    if (result)
+	*result = s->cs_result;
+    if (cb_retval)
+	*cb_retval = s->cs_cb_retval;
+    return 0;
+}
+
+/*! Set the prompt of a session
+ * A callback changes the prompt of its session with cligen_prompt_set()
+ * @param[in]  s       Session
+ * @param[in]  prompt  Prompt string
+ */
+int
+cligen_session_prompt_set(cligen_session *s,
+			  char           *prompt)
+{
+    char *p = NULL;
+
+    if (handle(s->cs_h)->ch_session == s) /* bound: prompt is in the handle */
+	return cligen_prompt_set(s->cs_h, prompt);
+    if (prompt && (p = strdup(prompt)) == NULL)
+	return -1;
+    if (s->cs_prompt)
+	free(s->cs_prompt);
+    s->cs_prompt = p;
+    return 0;
+}
+
+/*! Set the active parse-tree of a session
+ * A callback changes the active parse-tree of its session with cligen_ph_active_set()
+ * @param[in]  s      Session
+ * @param[in]  name   Name of parse-tree, or NULL for the active parse-tree of the handle
+ * @retval     0      OK
+ * @retval    -1      No such parse-tree
+ */
+int
+cligen_session_mode_set(cligen_session *s,
+			char           *name)
+{
+    pt_head *ph = NULL;
+
+    if (name && (ph = cligen_ph_find(s->cs_h, name)) == NULL){
+	errno = ENOENT;
+	return -1;
+    }
+    if (handle(s->cs_h)->ch_session == s) /* bound: active flags are in the handle */
+	session_ph_activate(s->cs_h, ph);
+    else
+	s->cs_ph = ph;
+    return 0;
+}
+
+/*! Set the number of history lines of a session, 0 disables history
+ * Existing history is dropped
+ * @param[in]  s      Session
+ * @param[in]  lines  History lines
+ */
+int
+cligen_session_hist_size_set(cligen_session *s,
+			     int             lines)
+{
+    int i;
+
+    if (lines < 0){
+	errno = EINVAL;
+	return -1;
+    }
+    if (s->cs_hist){
+	for (i=0; i<s->cs_hist_size; i++)
+	    if (s->cs_hist[i])
+		free(s->cs_hist[i]);
+	free(s->cs_hist);
+	s->cs_hist = NULL;
+    }
+    s->cs_hist_size = lines;
+    s->cs_hist_len = 0;
+    s->cs_hist_next = 0;
+    s->cs_hist_cur = 0;
+    return 0;
+}
+
+/*! Set echo of input, on by default
+ * @param[in]  s      Session
+ * @param[in]  echo   0: do not write input chars to output, 1: echo
+ */
+int
+cligen_session_echo_set(cligen_session *s,
+			int             echo)
+{
+    s->cs_echo = echo?1:0;
+    return 0;
+}
+
+/*! Get application argument of a session
+ * @param[in]  s      Session
+ */
+void *
+cligen_session_arg(cligen_session *s)
+{
+    return s->cs_arg;
+}
+
+/*! Set application argument of a session, eg the connection it belongs to
+ * @param[in]  s      Session
+ * @param[in]  arg    Application argument
+ */
+int
+cligen_session_arg_set(cligen_session *s,
+		       void           *arg)
+{
+    s->cs_arg = arg;
+    return 0;
+}
+
+/*! Memory used by a session, not counting the shared handle
+ * @param[in]  s      Session
+ * @retval     size   Allocated bytes
+ */
+size_t
+cligen_session_memsize(cligen_session *s)
+{
+    size_t sz = sizeof(*s);
+    int    i;
+
+    sz += s->cs_buf_size;
+    if (s->cs_prompt)
+	sz += strlen(s->cs_prompt) + 1;
+    if (s->cs_out)
+	sz += cbuf_buflen(s->cs_out);
+    if (s->cs_hist){
+	sz += s->cs_hist_size*sizeof(char*);
+	for (i=0; i<s->cs_hist_size; i++)
+	    if (s->cs_hist[i])
+		sz += strlen(s->cs_hist[i]) + 1;
+    }
+    return sz;
+}
@@ -0,0 +1,103 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+ *
+ *
+ * CLIgen sessions: many concurrent CLI users of one handle
+ * A session is a small object with the per-user state of a CLI: line buffer, history,
+ * prompt, active parse-tree and pending output. The parse-trees, callbacks and
+ * configuration are shared in the CLIgen handle the sessions are created from.
+ * Input is pushed to a session instead of read by getline, and output is collected
+ * from it, so that one thread with an event loop can serve many sessions, eg one per
+ * SSH channel:
+ * @code
+ *   s = cligen_session_new(h);
+ *   cligen_session_start(s);                // prompt
+ *   ...
+ *   n = read(fd, buf, sizeof(buf));
+ *   if ((ev = cligen_session_feed(s, buf, n)) < 0)
+ *     err;
+ *   if (ev & CLIGEN_SESSION_OUTPUT){
+ *     out = cligen_session_output(s, &len);
+ *     write(fd, out, len);
+ *     cligen_session_output_reset(s);
+ *   }
+ *   if (ev & CLIGEN_SESSION_EXIT)
+ *     cligen_session_free(s);
+ * @endcode
+ * While a session processes input it is bound to the handle: callbacks are called with
+ * the handle as usual, cligen_output() is written to the session, and the prompt,
+ * exiting flag and active parse-tree of the handle are those of the session.
+ * Sessions of one handle must be fed from one thread at a time.
+ * Line editing is at end of line: insert, erase, ^U, ^W, ^C, ^D, ^P/^N and up/down
+ * arrows for history, TAB for completion and '?' for help.
+ */
+
+#ifndef _CLIGEN_SESSION_H_
+#define _CLIGEN_SESSION_H_
+
+/*
+ * Constants
+ */
+#define CLIGEN_SESSION_HISTSIZE_DEFAULT 16 /* History lines of a session */
+
+/* Events returned by cligen_session_feed, OR:ed */
+#define CLIGEN_SESSION_OUTPUT  0x01 /* Output is pending, see cligen_session_output */
+#define CLIGEN_SESSION_COMMAND 0x02 /* A command line was evaluated, see cligen_session_result */
+#define CLIGEN_SESSION_EXIT    0x04 /* Session ended with ^D or cligen_exiting_set() */
+
+/*
+ * Types
+ */
+typedef struct cligen_session cligen_session;
+
+/*
+ * Prototypes
+ */
+cligen_session *cligen_session_new(cligen_handle h);
+int    cligen_session_free(cligen_session *s);
+cligen_handle cligen_session_handle(cligen_session *s);
+cligen_session *cligen_session_active(cligen_handle h);
+int    cligen_session_start(cligen_session *s);
+int    cligen_session_feed(cligen_session *s, const char *buf, size_t len);
+char  *cligen_session_output(cligen_session *s, size_t *len);
+int    cligen_session_output_reset(cligen_session *s);
+int    cligen_session_write(cligen_session *s, const char *buf, size_t len);
+int    cligen_session_result(cligen_session *s, cligen_result *result, int *cb_retval);
+int    cligen_session_prompt_set(cligen_session *s, char *prompt);
+int    cligen_session_mode_set(cligen_session *s, char *name);
+int    cligen_session_hist_size_set(cligen_session *s, int lines);
+int    cligen_session_echo_set(cligen_session *s, int echo);
+void  *cligen_session_arg(cligen_session *s);
+int    cligen_session_arg_set(cligen_session *s, void *arg);
+size_t cligen_session_memsize(cligen_session *s);
+
+#endif /* _CLIGEN_SESSION_H_ */
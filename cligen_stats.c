@@ -0,0 +1,162 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+ *
+ * CLIgen hot-path counters, see cligen_stats.h
+ */
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+
+#include "cligen_buf.h"
+#include "cligen_cv.h"
+#include "cligen_cvec.h"
+#include "cligen_parsetree.h"
+#include "cligen_pt_head.h"
+#include "cligen_object.h"
+#include "cligen_handle.h"
+#include "cligen_intern.h"
+#include "cligen_stats.h"
+#include "cligen_handle_internal.h"
+#include "cligen_stats_internal.h"
+
+/*
+ * Variables
+ */
+uint64_t _cligen_stats_co_copy = 0;  /* Objects copied by co_copy */
+uint64_t _cligen_stats_cvec_new = 0; /* cvec allocations */
+uint64_t _cligen_stats_term_write = 0; /* terminal writes by getline */
+uint64_t _cligen_stats_term_read = 0; /* terminal reads by getline */
+uint64_t _cligen_stats_cv_scan = 0;   /* token scans by typed variable parsers */
+uint64_t _cligen_stats_cbuf_alloc = 0; /* cbufs allocated, not taken from a pool */
+uint64_t _cligen_stats_str2fn = 0;   /* function names mapped by str2fn functions */
+
+/*! Monotonic time in nanoseconds, used for timing callbacks
+ */
+uint64_t
+cligen_stats_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+/*! Get hot-path counters of a handle
+ * Process-wide counters (cs_co_copy, cs_cvec_new, cs_term_write, cs_term_read, cs_cv_scan,
+ * cs_cbuf_alloc, cs_str2fn and the cs_intern_* gauges) are the same for all handles
+ * @param[in]  h   CLIgen handle
+ * @param[out] st  Counters
+ * @retval     0   OK
+ * @see cligen_stats_reset
+ */
+int
+cligen_stats_get(cligen_handle h,
+		 cligen_stats *st)
+{
+    struct cligen_handle *ch = handle(h);
+
+    memcpy(st, ch->ch_stats, sizeof(*st));
+    st->cs_co_copy = _cligen_stats_co_copy;
+    st->cs_cvec_new = _cligen_stats_cvec_new;
+    st->cs_term_write = _cligen_stats_term_write;
+    st->cs_term_read = _cligen_stats_term_read;
+    st->cs_cv_scan = _cligen_stats_cv_scan;
+    st->cs_cbuf_alloc = _cligen_stats_cbuf_alloc;
+    st->cs_str2fn = _cligen_stats_str2fn;
+    cligen_intern_stats(&st->cs_intern_str, &st->cs_intern_bytes);
+    return 0;
+}
+
+/*! Reset hot-path counters of a handle, and the process-wide counters
+ * @param[in]  h   CLIgen handle
+ * @retval     0   OK
+ */
+int
+cligen_stats_reset(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    memset(ch->ch_stats, 0, sizeof(*ch->ch_stats));
+    _cligen_stats_co_copy = 0;
+    _cligen_stats_cvec_new = 0;
+    _cligen_stats_term_write = 0;
+    _cligen_stats_term_read = 0;
+    _cligen_stats_cv_scan = 0;
+    _cligen_stats_cbuf_alloc = 0;
+    _cligen_stats_str2fn = 0;
+    return 0;
+}
+
+/*! Print hot-path counters of a handle, one "name value" pair per line
+ * @param[in]  f   Output file
+ * @param[in]  h   CLIgen handle
+ * @retval     0   OK
+ */
+int
+cligen_stats_print(FILE         *f,
+		   cligen_handle h)
+{
+    cligen_stats st;
+
+    cligen_stats_get(h, &st);
+    fprintf(f, "eval %" PRIu64 "\n", st.cs_eval);
+    fprintf(f, "match_object %" PRIu64 "\n", st.cs_match_object);
+    fprintf(f, "match_resume %" PRIu64 "\n", st.cs_match_resume);
+    fprintf(f, "expand %" PRIu64 "\n", st.cs_expand);
+    fprintf(f, "expand_copy %" PRIu64 "\n", st.cs_expand_copy);
+    fprintf(f, "expand_borrow %" PRIu64 "\n", st.cs_expand_borrow);
+    fprintf(f, "expand_skip %" PRIu64 "\n", st.cs_expand_skip);
+    fprintf(f, "treeref %" PRIu64 "\n", st.cs_treeref);
+    fprintf(f, "treeref_copy %" PRIu64 "\n", st.cs_treeref_copy);
+    fprintf(f, "regex_compile %" PRIu64 "\n", st.cs_regex_compile);
+    fprintf(f, "regex_exec %" PRIu64 "\n", st.cs_regex_exec);
+    fprintf(f, "expand_cb %" PRIu64 "\n", st.cs_expand_cb);
+    fprintf(f, "expand_cb_ns %" PRIu64 "\n", st.cs_expand_cb_ns);
+    fprintf(f, "help_cached %" PRIu64 "\n", st.cs_help_cached);
+    fprintf(f, "co_copy %" PRIu64 "\n", st.cs_co_copy);
+    fprintf(f, "cvec_new %" PRIu64 "\n", st.cs_cvec_new);
+    fprintf(f, "term_write %" PRIu64 "\n", st.cs_term_write);
+    fprintf(f, "term_read %" PRIu64 "\n", st.cs_term_read);
+    fprintf(f, "cv_scan %" PRIu64 "\n", st.cs_cv_scan);
+    fprintf(f, "cbuf_alloc %" PRIu64 "\n", st.cs_cbuf_alloc);
+    fprintf(f, "str2fn %" PRIu64 "\n", st.cs_str2fn);
+    fprintf(f, "intern_str %" PRIu64 "\n", st.cs_intern_str);
+    fprintf(f, "intern_bytes %" PRIu64 "\n", st.cs_intern_bytes);
+    return 0;
+}
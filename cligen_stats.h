@@ -0,0 +1,87 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+ *
+ * CLIgen internal counters of hot paths, used to find out why an evaluation is slow
+ * Counters are plain increments and are always enabled.
+ * Most counters are kept per handle. Objects copied by co_copy and cvec allocations are
+ * counted process-wide since those functions have no handle.
+ * @code
+ *   cligen_stats st;
+ *   cligen_stats_reset(h);
+ *   cliread_eval(h, ...);
+ *   cligen_stats_get(h, &st);
+ *   printf("%" PRIu64 "\n", st.cs_match_object / st.cs_eval);
+ * @endcode
+ */
+
+#ifndef _CLIGEN_STATS_H
+#define _CLIGEN_STATS_H
+
+/*
+ * Types
+ */
+/*! Counters returned by cligen_stats_get */
+typedef struct cligen_stats {
+    uint64_t cs_eval;           /* Evaluations of a command string, ie cliread_parse calls */
+    uint64_t cs_match_object;   /* Calls to match_object, ie object/token comparisons */
+    uint64_t cs_match_resume;   /* Token levels reused from previous TAB/? on same line */
+    uint64_t cs_expand;         /* Calls to pt_expand */
+    uint64_t cs_expand_copy;    /* Objects copied into an expanded level by pt_expand */
+    uint64_t cs_expand_borrow;  /* Objects referenced (not copied) by a lazy pt_expand */
+    uint64_t cs_expand_skip;    /* Expanded values not copied since they cannot match */
+    uint64_t cs_treeref;        /* Tree references expanded by pt_expand_treeref */
+    uint64_t cs_treeref_copy;   /* Objects copied when expanding tree references */
+    uint64_t cs_regex_compile;  /* Regular expressions compiled */
+    uint64_t cs_regex_exec;     /* Regular expression executions */
+    uint64_t cs_expand_cb;      /* Expand callback invocations */
+    uint64_t cs_expand_cb_ns;   /* Wall time spent in expand callbacks in nanoseconds */
+    uint64_t cs_help_cached;    /* Help tables of TAB/? printed from cache, see pt_help_get */
+    uint64_t cs_co_copy;        /* Objects copied by co_copy/pt_dup (process-wide) */
+    uint64_t cs_cvec_new;       /* cvec allocations (process-wide) */
+    uint64_t cs_term_write;     /* write() calls to the terminal by getline (process-wide) */
+    uint64_t cs_term_read;      /* read() calls from the terminal by getline (process-wide) */
+    uint64_t cs_cv_scan;        /* Token scans by integer, address and MAC parsers (process-wide) */
+    uint64_t cs_cbuf_alloc;     /* cbufs allocated, not reused from a pool (process-wide) */
+    uint64_t cs_str2fn;         /* Function names mapped by str2fn functions (process-wide) */
+    uint64_t cs_intern_str;     /* Distinct interned strings, a gauge not reset (process-wide) */
+    uint64_t cs_intern_bytes;   /* Bytes of interned strings, a gauge not reset (process-wide) */
+} cligen_stats;
+
+/*
+ * Prototypes
+ */
+int cligen_stats_get(cligen_handle h, cligen_stats *st);
+int cligen_stats_reset(cligen_handle h);
+int cligen_stats_print(FILE *f, cligen_handle h);
+
+#endif /* _CLIGEN_STATS_H */
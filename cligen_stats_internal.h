@@ -0,0 +1,69 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+ *
+ * CLIgen hot-path counters, internal definitions
+ * A file using cligen_stats_inc() must include cligen_stats.h and cligen_handle_internal.h
+ */
+
+#ifndef _CLIGEN_STATS_INTERNAL_H
+#define _CLIGEN_STATS_INTERNAL_H
+
+/*
+ * Macros
+ */
+/* Increment a per-handle counter */
+#define cligen_stats_inc(h, field) (handle(h)->ch_stats->field++)
+
+/* Add to a per-handle counter */
+#define cligen_stats_add(h, field, n) (handle(h)->ch_stats->field += (n))
+
+/* Increment a process-wide counter, may be called from several threads */
+#define cligen_stats_global_inc(var) __atomic_add_fetch(&(var), 1, __ATOMIC_RELAXED)
+
+/*
+ * Variables
+ */
+/* Process-wide counters of functions without handle, incremented atomically */
+extern uint64_t _cligen_stats_co_copy;
+extern uint64_t _cligen_stats_cvec_new;
+extern uint64_t _cligen_stats_term_write;
+extern uint64_t _cligen_stats_term_read;
+extern uint64_t _cligen_stats_cv_scan;
+extern uint64_t _cligen_stats_cbuf_alloc;
+extern uint64_t _cligen_stats_str2fn;
+
+/*
+ * Prototypes
+ */
+uint64_t cligen_stats_ns(void);
+
+#endif /* _CLIGEN_STATS_INTERNAL_H */
@@ -37,6 +37,10 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <netinet/in.h>
 
 #include "cligen_buf.h"
@@ -49,29 +53,33 @@
 #include "cligen_handle.h"
 #include "cligen_read.h"
 #include "cligen_syntax.h"
+#include "cligen_stats.h"
+#include "cligen_handle_internal.h"
+#include "cligen_stats_internal.h"
 
-/*! Parse a string containing a CLIgen spec into a parse-tree
- * 
- * Syntax parsing. A string is input and a syntax-tree is returned (or error). 
- * A variable record is also returned containing a list of (global) variable values.
- * The string contains a hierarchy of syntax specs bounded by {} and semi-colon. Comma is used
- * to tag a syntax-spec with assignments or callbacks. Help strings are delimited with ("").
- * '#' anywhere on the line means the rest is comment.
- * @param[in]     h    CLIgen handle
- * @param[in]     str  String to parse containing CLIgen specification statements
- * @param[in]     name Debug string identifying the spec, typically a filename
- * @param[in,out] pt   Parse-tree, if set, add commands to this. Can be NULL
- * @param[out]    cvv  Global variables
- * @see cligen_parse_file
- * @note parse-trees can be added as side-effect:s using the treename clispec:s. The tree returned
- * in pt is only the "latest" one.
+/*! Parse a string containing a CLIgen spec, where the parsed trees are added to the
+ * handle, or to a private vector of parse-tree headers
+ * @param[in]     h      CLIgen handle
+ * @param[in]     str    String to parse containing CLIgen specification statements
+ * @param[in]     len    If set, length of str which is followed by two NUL chars and is
+ *                       scanned in place. If 0, the scanner copies str
+ * @param[in]     name   Debug string identifying the spec, typically a filename
+ * @param[in,out] ptp    Parse-tree, if set, add commands to this. Can be NULL
+ * @param[out]    cvv    Global variables
+ * @param[out]    phvecp If set, parsed trees are not added to the handle. Instead a malloced 
+ *                       vector of headers created with cligen_ph_new is returned
+ * @param[out]    phlenp Length of phvecp
+ * @see cligen_parse_str
  */
-int
-cligen_parse_str(cligen_handle h,
-		 char         *str,
-		 char         *name,
-		 parse_tree   *ptp,
-		 cvec         *cvv)
+static int
+parse_str(cligen_handle h,
+	  char         *str,
+	  size_t        len,
+	  char         *name,
+	  parse_tree   *ptp,
+	  cvec         *cvv,
+	  pt_head    ***phvecp,
+	  int          *phlenp)
 {
     int                retval = -1;
     int                i;
@@ -79,7 +87,6 @@ cligen_parse_str(cligen_handle h,
     cg_obj            *co;
     cg_obj            *cot = NULL;
     parse_tree        *pt = NULL; 
-    pt_head           *ph;
     
     /* "Fake" top-level object that is removed on exit */
     if ((cot = co_new(NULL, NULL)) == NULL)
@@ -89,7 +96,9 @@ cligen_parse_str(cligen_handle h,
     cy.cy_treename     = strdup(name); /* Use name as default tree name */
     cy.cy_linenum      = 1;
     cy.cy_parse_string = str;
+    cy.cy_parse_len    = len;
     cy.cy_stack        = NULL;
+    cy.cy_private      = (phvecp != NULL);
     if (ptp != NULL)
 	pt = ptp;
     else
@@ -103,23 +112,30 @@ cligen_parse_str(cligen_handle h,
 	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno)); 
 	    goto done;
 	}
-    if (strlen(str)){ /* Not empty */
+    if (*str != '\0'){ /* Not empty */
 	if (cgl_init(&cy) < 0)
 	    goto done;
 	if (cgy_init(&cy, cot) < 0)
 	    goto done;
 	if (cligen_parseparse(&cy) != 0) { /* yacc returns 1 on error */
+	    pt_coalesce(co_pt_get(cot), PT_COALESCE_PARSE);
 	    cgy_exit(&cy);
 	    cgl_exit(&cy);
+	    /* The tree being parsed is not added, free it unless given by caller */
+	    if ((pt = co_pt_get(cot)) != ptp){
+		co_pt_clear(cot);
+		pt_free(pt, 1);
+	    }
 	    goto done;
 	}
 	/* Note pt/ptp is stale after parsing due to treename that replaces cot->pt 
 	 * Add final tree */
 	pt = co_pt_get(cot);
+	/* Statements are appended unsorted while parsing, sort and merge them once */
+	if (pt_coalesce(pt, PT_COALESCE_PARSE) < 0)
+	    goto done;
 	if (ptp == NULL){
-	    if ((ph = cligen_ph_add(cy.cy_handle, cy.cy_treename)) == NULL)
-		goto done;
-	    if (cligen_ph_parsetree_set(ph, pt) < 0)
+	    if (cgy_tree_add(&cy, cy.cy_treename, pt) < 0)
 		goto done;
 	}
 	if (cgy_exit(&cy) < 0)
@@ -139,17 +155,178 @@ cligen_parse_str(cligen_handle h,
 	if ((co=pt_vec_i_get(pt, i)) != NULL)
 	    co_up_set(co, NULL);
     }
+    if (phvecp){
+	*phvecp = cy.cy_phvec;
+	*phlenp = cy.cy_phlen;
+	cy.cy_phvec = NULL;
+	cy.cy_phlen = 0;
+    }
     retval = 0;
   done:
     if (cot)
 	co_free(cot, 0);
     if (cy.cy_treename)
 	free (cy.cy_treename);
+    if (cy.cy_phvec){
+	for (i=0; i<cy.cy_phlen; i++)
+	    cligen_ph_free(cy.cy_phvec[i]);
+	free(cy.cy_phvec);
+    }
     return retval;
 }
 
+/*! Parse a string containing a CLIgen spec into a parse-tree
+ * 
+ * Syntax parsing. A string is input and a syntax-tree is returned (or error). 
+ * A variable record is also returned containing a list of (global) variable values.
+ * The string contains a hierarchy of syntax specs bounded by {} and semi-colon. Comma is used
+ * to tag a syntax-spec with assignments or callbacks. Help strings are delimited with ("").
+ * '#' anywhere on the line means the rest is comment.
+ * @param[in]     h    CLIgen handle
+ * @param[in]     str  String to parse containing CLIgen specification statements
+ * @param[in]     name Debug string identifying the spec, typically a filename
+ * @param[in,out] pt   Parse-tree, if set, add commands to this. Can be NULL
+ * @param[out]    cvv  Global variables
+ * @see cligen_parse_file
+ * @note parse-trees can be added as side-effect:s using the treename clispec:s. The tree returned
+ * in pt is only the "latest" one.
+ */
+int
+cligen_parse_str(cligen_handle h,
+		 char         *str,
+		 char         *name,
+		 parse_tree   *ptp,
+		 cvec         *cvv)
+{
+    return parse_str(h, str, 0, name, ptp, cvv, NULL, NULL);
+}
+
+/* Size of blocks read from a clispec file that cannot be mapped */
+#define FILE_READ_BLOCK (64*1024)
+
+/*! Contents of a clispec file, followed by two NUL chars so that it is scanned in place
+ * @see file_read
+ */
+struct spec_input{
+    char   *si_buf;    /* Contents of file */
+    size_t  si_len;    /* Length of contents, excluding the NUL chars */
+    size_t  si_maplen; /* Length of mapping if mapped, 0 if malloced */
+};
+
+/*! Map a regular clispec file into memory
+ *
+ * The file is mapped private and writable, since the scanner temporarily writes into
+ * its buffer, so only pages actually written are copied. An anonymous mapping is made
+ * first and the file is mapped over its start, so that the two bytes after the contents
+ * are zero also if the file size is a multiple of the page size.
+ * @param[in]  f     Open stdio file handle, not read from
+ * @param[out] si    Mapped contents
+ * @retval     1     Mapped
+ * @retval     0     Not mapped, eg not a regular file, empty or already read from
+ */
+static int
+file_map(FILE              *f,
+	 struct spec_input *si)
+{
+    struct stat st;
+    size_t      pagesize;
+    size_t      maplen;
+    void       *p;
+    int         fd;
+
+    if ((fd = fileno(f)) < 0 || ftello(f) != 0)
+	return 0;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+	return 0;
+    pagesize = sysconf(_SC_PAGESIZE);
+    maplen = ((size_t)st.st_size + 2 + pagesize - 1) & ~(pagesize - 1);
+    if ((p = mmap(NULL, maplen, PROT_READ|PROT_WRITE,
+		  MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+	return 0;
+    if (mmap(p, st.st_size, PROT_READ|PROT_WRITE,
+	     MAP_PRIVATE|MAP_FIXED, fd, 0) == MAP_FAILED){
+	munmap(p, maplen);
+	return 0;
+    }
+    madvise(p, maplen, MADV_SEQUENTIAL);
+    si->si_buf = p;
+    si->si_len = st.st_size;
+    si->si_maplen = maplen;
+    return 1;
+}
+
+/*! Read all of a clispec file into memory, followed by two NUL chars
+ *
+ * A regular file is mapped, see file_map. Other files, eg pipes, are read in large
+ * blocks into a malloced buffer.
+ * @param[in]  f     Open stdio file handle
+ * @param[out] si    Contents of file, free with file_release()
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+file_read(FILE              *f,
+	  struct spec_input *si)
+{
+    char   *buf;
+    char   *buf1;
+    size_t  size;
+    size_t  len = 0;
+    size_t  n;
+
+    memset(si, 0, sizeof(*si));
+    if (file_map(f, si) == 1)
+	return 0;
+    size = FILE_READ_BLOCK;
+    if ((buf = malloc(size)) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    while (1){ /* read the whole file */
+	if (size - len < FILE_READ_BLOCK/2 + 2){
+	    if ((buf1 = realloc(buf, 2*size)) == NULL){
+		fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+		free(buf);
+		return -1;
+	    }
+	    buf = buf1;
+	    size *= 2;
+	}
+	if ((n = fread(buf+len, 1, size-len-2, f)) == 0)
+	    break;
+	len += n;
+    }
+    if (ferror(f)){
+	fprintf(stderr, "%s: fread: %s\n", __FUNCTION__, strerror(errno));
+	free(buf);
+	return -1;
+    }
+    buf[len] = buf[len+1] = '\0';
+    si->si_buf = buf;
+    si->si_len = len;
+    return 0;
+}
+
+/*! Free the contents of a clispec file read by file_read
+ * @param[in]  si    Contents of file
+ */
+static void
+file_release(struct spec_input *si)
+{
+    if (si->si_buf == NULL)
+	return;
+    if (si->si_maplen)
+	munmap(si->si_buf, si->si_maplen);
+    else
+	free(si->si_buf);
+    si->si_buf = NULL;
+}
+
 /*! Parse a file containing a CLIgen spec into a parse-tree
  *
+ * A regular file is mapped into memory and scanned in place, other files are read in
+ * large blocks. The contents are not copied, so the memory used for the input is the
+ * size of the file.
  * @param[in]     h    CLIgen handle
  * @param[in]     f    Open stdio file handle
  * @param[in]     name Debug string identifying the spec, typically a filename
@@ -164,39 +341,438 @@ cligen_parse_file(cligen_handle h,
 		  parse_tree   *pt,  
 		  cvec         *cvv)
 {
-    char         *buf;
-    int           i;
-    int           c;
-    int           len;
-    int           retval = -1;
-
-    len = 1024; /* any number is fine */
-    if ((buf = malloc(len)) == NULL){
-	perror("pt_file malloc");
-	return -1;
+    struct spec_input si = {0,};
+    int               retval = -1;
+
+    if (file_read(f, &si) < 0)
+	goto done;
+    if (parse_str(h, si.si_buf, si.si_len, name, pt, cvv, NULL, NULL) < 0)
+	goto done;
+    retval = 0;
+  done:
+    file_release(&si);
+    return retval;
+}
+
+/*! A clispec file parsed by a worker of cligen_parse_files
+ */
+struct parse_job {
+    char        *pj_file;   /* Filename */
+    cvec        *pj_cvv;    /* Global variables of the file */
+    pt_head    **pj_phvec;  /* Parsed trees, not yet added to the handle */
+    int          pj_phlen;  /* Length of pj_phvec */
+    int          pj_retval; /* 0 if parsed and mapped, -1 on error */
+};
+
+/*! Shared state of the workers of cligen_parse_files
+ */
+struct parse_pool {
+    cligen_handle     pp_h;
+    struct parse_job *pp_jobs;
+    int               pp_njobs;
+    int               pp_next;      /* Next job to take, incremented atomically */
+    cgv_str2fn_t     *pp_cb_str2fn; /* Callback function mapper, or NULL */
+    expandv_str2fn_t *pp_ex_str2fn; /* Expand function mapper, or NULL */
+    void             *pp_arg;       /* Argument of the mappers */
+};
+
+/*! Parse a clispec file into private trees and map its functions
+ * @param[in]  pp   Parse pool
+ * @param[in]  pj   Job with the file to parse
+ * @retval     0    OK
+ * @retval    -1    Error and statement written on stderr
+ */
+static int
+parse_job_run(struct parse_pool *pp,
+	      struct parse_job  *pj)
+{
+    int               retval = -1;
+    FILE             *f = NULL;
+    struct spec_input si = {0,};
+    parse_tree       *pt;
+    int               i;
+
+    if ((f = fopen(pj->pj_file, "r")) == NULL){
+	fprintf(stderr, "fopen(%s): %s\n", pj->pj_file, strerror(errno));
+	goto done;
+    }
+    if (file_read(f, &si) < 0)
+	goto done;
+    if ((pj->pj_cvv = cvec_new(0)) == NULL)
+	goto done;
+    if (parse_str(pp->pp_h, si.si_buf, si.si_len, pj->pj_file, NULL, pj->pj_cvv,
+		  &pj->pj_phvec, &pj->pj_phlen) < 0)
+	goto done;
+    for (i=0; i<pj->pj_phlen; i++){
+	pt = cligen_ph_parsetree_get(pj->pj_phvec[i]);
+	if (pp->pp_cb_str2fn &&
+	    cligen_callbackv_str2fn(pt, pp->pp_cb_str2fn, pp->pp_arg) < 0)
+	    goto done;
+	if (pp->pp_ex_str2fn &&
+	    cligen_expandv_str2fn(pt, pp->pp_ex_str2fn, pp->pp_arg) < 0)
+	    goto done;
     }
-    memset(buf, 0, len);
+    retval = 0;
+ done:
+    file_release(&si);
+    if (f)
+	fclose(f);
+    return retval;
+}
 
-    i = 0; /* position in buf */
-    while (1){ /* read the whole file */
-	if ((c = fgetc(f)) == EOF)
-	    break;
-	if (i == len-1){
-	    if ((buf = realloc(buf, 2*len)) == NULL){
-		fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+/*! Worker thread of cligen_parse_files, parses files until none are left
+ * @param[in]  arg  Parse pool
+ */
+static void *
+parse_worker(void *arg)
+{
+    struct parse_pool *pp = (struct parse_pool *)arg;
+    int                i;
+
+    while ((i = __atomic_fetch_add(&pp->pp_next, 1, __ATOMIC_RELAXED)) < pp->pp_njobs)
+	pp->pp_jobs[i].pj_retval = parse_job_run(pp, &pp->pp_jobs[i]);
+    return NULL;
+}
+
+/*! Parse several clispec files in parallel and add their parse-trees to a handle
+ *
+ * The files are independent and are parsed concurrently by a pool of threads into 
+ * private parse-trees. Each worker also maps callback and expand function names of 
+ * the trees of its files with cb_str2fn and ex_str2fn.
+ * When all files are parsed, the trees are added to the handle in file order, which is
+ * the same as calling cligen_parse_file for each file in turn. Global variables of
+ * the files are appended to cvv in the same order.
+ * If a file cannot be read or parsed, no tree is added.
+ * @param[in]  h         CLIgen handle
+ * @param[in]  files     Vector of clispec filenames
+ * @param[in]  nfiles    Length of files
+ * @param[in]  nworkers  Number of threads, or 0 for the number of online processors
+ * @param[in]  cb_str2fn Translator of callback names, or NULL. Called in the workers
+ * @param[in]  ex_str2fn Translator of expand names, or NULL. Called in the workers
+ * @param[in]  arg       Argument to cb_str2fn and ex_str2fn
+ * @param[out] cvv       Global variables, or NULL
+ * @retval     0         OK
+ * @retval    -1         Error and statement written on stderr
+ * @note cb_str2fn and ex_str2fn must be thread-safe
+ * @see cligen_parse_file
+ */
+int
+cligen_parse_files(cligen_handle     h,
+		   char            **files,
+		   int               nfiles,
+		   int               nworkers,
+		   cgv_str2fn_t     *cb_str2fn,
+		   expandv_str2fn_t *ex_str2fn,
+		   void             *arg,
+		   cvec             *cvv)
+{
+    int               retval = -1;
+    struct parse_pool pp = {0,};
+    struct parse_job *pj;
+    pthread_t        *tids = NULL;
+    int               nthreads = 0;
+    cg_var           *cv;
+    int               i;
+    int               j;
+
+    if (files == NULL || nfiles < 0){
+	errno = EINVAL;
+	goto done;
+    }
+    if (nfiles == 0)
+	goto ok;
+    if ((pp.pp_jobs = calloc(nfiles, sizeof(struct parse_job))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    for (i=0; i<nfiles; i++)
+	pp.pp_jobs[i].pj_file = files[i];
+    pp.pp_h = h;
+    pp.pp_njobs = nfiles;
+    pp.pp_cb_str2fn = cb_str2fn;
+    pp.pp_ex_str2fn = ex_str2fn;
+    pp.pp_arg = arg;
+    if (nworkers <= 0 && (nworkers = sysconf(_SC_NPROCESSORS_ONLN)) <= 0)
+	nworkers = 1;
+    if (nworkers > nfiles)
+	nworkers = nfiles;
+    /* The calling thread is also a worker */
+    if (nworkers > 1){
+	if ((tids = calloc(nworkers-1, sizeof(pthread_t))) == NULL){
+	    fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	    goto done;
+	}
+	for (nthreads=0; nthreads<nworkers-1; nthreads++)
+	    if ((errno = pthread_create(&tids[nthreads], NULL, parse_worker, &pp)) != 0){
+		fprintf(stderr, "%s: pthread_create: %s\n", __FUNCTION__, strerror(errno));
+		break; /* Continue with the threads created so far */
+	    }
+    }
+    parse_worker(&pp);
+    for (i=0; i<nthreads; i++)
+	pthread_join(tids[i], NULL);
+    for (i=0; i<nfiles; i++)
+	if (pp.pp_jobs[i].pj_retval < 0)
+	    goto done;
+    /* Merge into the handle once all files are parsed */
+    for (i=0; i<nfiles; i++){
+	pj = &pp.pp_jobs[i];
+	for (j=0; j<pj->pj_phlen; j++){
+	    if (cligen_ph_append(h, pj->pj_phvec[j]) < 0)
+		goto done;
+	    pj->pj_phvec[j] = NULL;
+	}
+	if (cvv){
+	    cv = NULL;
+	    while ((cv = cvec_each(pj->pj_cvv, cv)) != NULL)
+		if (cvec_append_var(cvv, cv) == NULL)
+		    goto done;
+	}
+    }
+ ok:
+    retval = 0;
+ done:
+    if (tids)
+	free(tids);
+    if (pp.pp_jobs){
+	for (i=0; i<nfiles; i++){
+	    pj = &pp.pp_jobs[i];
+	    if (pj->pj_phvec){
+		for (j=0; j<pj->pj_phlen; j++)
+		    if (pj->pj_phvec[j])
+			cligen_ph_free(pj->pj_phvec[j]);
+		free(pj->pj_phvec);
+	    }
+	    if (pj->pj_cvv)
+		cvec_free(pj->pj_cvv);
+	}
+	free(pp.pp_jobs);
+    }
+    return retval;
+}
+
+/*! Functions resolved by a str2fn function, keyed by function name
+ * An open addressing hash table, so that each name is resolved once per walk of a
+ * parse-tree, or once per handle with lazy binding.
+ */
+struct str2fn_entry {
+    char    *se_name;  /* Function name, copied if sc_dup */
+    uint32_t se_hash;  /* Hash of se_name */
+    void    *se_fn;    /* Function returned by str2fn */
+};
+
+struct str2fn_cache {
+    int                  sc_len;   /* Number of entries */
+    int                  sc_size;  /* Number of slots, a power of 2, or 0 */
+    int                  sc_dup;   /* Names are copied, else they must outlive the cache */
+    struct str2fn_entry *sc_vec;   /* Slots, se_name is NULL if empty */
+};
+
+/*! Lazy binding of callbacks of a handle, see cligen_str2fn_lazy_set */
+struct str2fn_lazy {
+    cgv_str2fn_t       *sl_cb_str2fn; /* Callback function mapper, or NULL */
+    expandv_str2fn_t   *sl_ex_str2fn; /* Expand function mapper, or NULL */
+    void               *sl_arg;       /* Argument of the mappers */
+    struct str2fn_cache sl_cb_cache;  /* Resolved callback functions */
+    struct str2fn_cache sl_ex_cache;  /* Resolved expand functions */
+};
+
+/*! FNV-1a hash of a function name
+ */
+static uint32_t
+str2fn_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+
+    while (*name){
+	h ^= (uint8_t)*name++;
+	h *= 16777619u;
+    }
+    return h;
+}
+
+/*! Find a resolved function in a str2fn cache
+ * @param[in]  sc    Cache
+ * @param[in]  name  Function name
+ * @param[out] fnp   Function
+ * @retval     1     Found, fnp set
+ * @retval     0     Not found
+ */
+static int
+str2fn_cache_get(struct str2fn_cache *sc,
+		 char                *name,
+		 void               **fnp)
+{
+    struct str2fn_entry *se;
+    uint32_t             h;
+    int                  i;
+
+    if (sc->sc_len == 0)
+	return 0;
+    h = str2fn_hash(name);
+    for (i = h & (sc->sc_size-1); (se = &sc->sc_vec[i])->se_name != NULL; i = (i+1) & (sc->sc_size-1))
+	if (se->se_hash == h && strcmp(se->se_name, name) == 0){
+	    *fnp = se->se_fn;
+	    return 1;
+	}
+    return 0;
+}
+
+/*! Add a resolved function to a str2fn cache, name must not be in the cache
+ * @param[in]  sc    Cache
+ * @param[in]  name  Function name
+ * @param[in]  fn    Function
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+str2fn_cache_add(struct str2fn_cache *sc,
+		 char                *name,
+		 void                *fn)
+{
+    struct str2fn_entry *vec;
+    struct str2fn_entry *se;
+    int                  size;
+    int                  i;
+    int                  j;
+
+    if (2*(sc->sc_len+1) > sc->sc_size){ /* Keep load below 1/2 */
+	size = sc->sc_size ? 2*sc->sc_size : 16;
+	if ((vec = calloc(size, sizeof(*vec))) == NULL)
+	    return -1;
+	for (i=0; i<sc->sc_size; i++){
+	    if (sc->sc_vec[i].se_name == NULL)
+		continue;
+	    for (j = sc->sc_vec[i].se_hash & (size-1); vec[j].se_name; j = (j+1) & (size-1));
+	    vec[j] = sc->sc_vec[i];
+	}
+	if (sc->sc_vec)
+	    free(sc->sc_vec);
+	sc->sc_vec = vec;
+	sc->sc_size = size;
+    }
+    for (i = str2fn_hash(name) & (sc->sc_size-1); sc->sc_vec[i].se_name; i = (i+1) & (sc->sc_size-1));
+    se = &sc->sc_vec[i];
+    if (sc->sc_dup){
+	if ((se->se_name = strdup(name)) == NULL)
+	    return -1;
+    }
+    else
+	se->se_name = name;
+    se->se_hash = str2fn_hash(name);
+    se->se_fn = fn;
+    sc->sc_len++;
+    return 0;
+}
+
+/*! Free the slots of a str2fn cache, and names if copied
+ */
+static void
+str2fn_cache_free(struct str2fn_cache *sc)
+{
+    int i;
+
+    if (sc->sc_vec){
+	if (sc->sc_dup)
+	    for (i=0; i<sc->sc_size; i++)
+		if (sc->sc_vec[i].se_name)
+		    free(sc->sc_vec[i].se_name);
+	free(sc->sc_vec);
+    }
+    sc->sc_vec = NULL;
+    sc->sc_len = sc->sc_size = 0;
+}
+
+/*! Resolve a callback function name with a str2fn function, using a cache
+ * @param[in]  sc      Cache
+ * @param[in]  name    Function name
+ * @param[in]  str2fn  Translator function, called if name is not in cache
+ * @param[in]  arg     Argument to call str2fn with
+ * @param[out] fnp     Function, may be NULL
+ * @param[out] err     Error string from str2fn, not cached
+ * @retval     0       OK, fnp set or err set
+ * @retval    -1       Error
+ */
+static int
+callbackv_resolve(struct str2fn_cache *sc,
+		  char                *name,
+		  cgv_str2fn_t        *str2fn,
+		  void                *arg,
+		  cgv_fnstype_t      **fnp,
+		  char               **err)
+{
+    void *fn;
+
+    if (str2fn_cache_get(sc, name, &fn) == 1){
+	*fnp = (cgv_fnstype_t*)fn;
+	return 0;
+    }
+    cligen_stats_global_inc(_cligen_stats_str2fn);
+    *fnp = str2fn(name, arg, err);
+    if (*err != NULL)
+	return 0;
+    return str2fn_cache_add(sc, name, (void*)*fnp);
+}
+
+/*! Resolve an expand function name with a str2fn function, using a cache
+ * @see callbackv_resolve
+ */
+static int
+expandv_resolve(struct str2fn_cache *sc,
+		char                *name,
+		expandv_str2fn_t    *str2fn,
+		void                *arg,
+		expandv_cb         **fnp,
+		char               **err)
+{
+    void *fn;
+
+    if (str2fn_cache_get(sc, name, &fn) == 1){
+	*fnp = (expandv_cb*)fn;
+	return 0;
+    }
+    cligen_stats_global_inc(_cligen_stats_str2fn);
+    *fnp = str2fn(name, arg, err);
+    if (*err != NULL)
+	return 0;
+    return str2fn_cache_add(sc, name, (void*)*fnp);
+}
+
+/*! Recursive part of cligen_callbackv_str2fn
+ * @param[in]  sc  Functions resolved so far in this walk
+ */
+static int
+callbackv_str2fn1(parse_tree          *pt, 
+		  cgv_str2fn_t        *str2fn, 
+		  void                *arg,
+		  struct str2fn_cache *sc)
+{
+    int                 retval = -1;
+    cg_obj             *co;
+    char               *callback_err = NULL;   /* Error from str2fn callback */
+    struct cg_callback *cc;
+    int                 i;
+
+    for (i=0; i<pt_len_get(pt); i++)
+	if ((co = pt_vec_i_get(pt, i)) != NULL){
+	    for (cc = co_callbacks_get(co); cc; cc=cc->cc_next){
+		if (cc->cc_fn_str != NULL && cc->cc_fn_vec == NULL){
+		    if (callbackv_resolve(sc, cc->cc_fn_str, str2fn, arg,
+					  &cc->cc_fn_vec, &callback_err) < 0)
+			goto done;
+		    if (callback_err != NULL){
+			fprintf(stderr, "%s: error: No such function: %s (%s)\n",
+				"cligen_callbackv_str2fn", cc->cc_fn_str, callback_err);
+			goto done;
+		    }
+		}
+	    }
+	    /* recursive call to next level */
+	    if (callbackv_str2fn1(co_pt_get(co), str2fn, arg, sc) < 0)
 		goto done;
-	    }	    
-	    memset(buf+len, 0, len);
-	    len *= 2;
 	}
-	buf[i++] = (char)(c&0xff);
-    } /* read a line */
-    if (cligen_parse_str(h, buf, name, pt, cvv) < 0)
-	goto done;
     retval = 0;
   done:
-    if (buf)
-	free(buf);
     return retval;
 }
 
@@ -214,6 +790,7 @@ cligen_parse_file(cligen_handle h,
  * in the parse-tree to produce function pointers (eg fn) which is stored in the
  * parse-tree nodes. Later, at evaluation time, the actual function (fn) is
  * called when evaluating/interpreting the syntax.
+ * str2fn is called once for each distinct function name in the parse-tree.
  *
  * @param[in]  pt      Parse-tree. Recursively loop through and call str2fn
  * @param[in]  str2fn  Translator function from strings to function pointers for command 
@@ -225,36 +802,54 @@ cligen_parse_file(cligen_handle h,
  *
  * @see cligen_expandv_str2fn    For expansion/completion callbacks
  * @see cligen_callback_str2fn Same but for callback single argument
+ * @see cligen_str2fn_lazy_set   Map callbacks when they are first called instead
  * @note str2fn may return NULL on error and should then supply a (static) error string 
  */
 int
 cligen_callbackv_str2fn(parse_tree   *pt, 
 			cgv_str2fn_t *str2fn, 
 			void         *arg)
+{
+    struct str2fn_cache sc = {0,};
+    int                 retval;
+
+    retval = callbackv_str2fn1(pt, str2fn, arg, &sc);
+    str2fn_cache_free(&sc);
+    return retval;
+}
+
+/*! Recursive part of cligen_expandv_str2fn
+ * @param[in]  sc  Functions resolved so far in this walk
+ */
+static int
+expandv_str2fn1(parse_tree          *pt, 
+		expandv_str2fn_t    *str2fn, 
+		void                *arg,
+		struct str2fn_cache *sc)
 {
     int                 retval = -1;
     cg_obj             *co;
     char               *callback_err = NULL;   /* Error from str2fn callback */
-    struct cg_callback *cc;
     int                 i;
 
-    for (i=0; i<pt_len_get(pt); i++)
+    for (i=0; i<pt_len_get(pt); i++){    
 	if ((co = pt_vec_i_get(pt, i)) != NULL){
-	    for (cc = co->co_callbacks; cc; cc=cc->cc_next){
-		if (cc->cc_fn_str != NULL && cc->cc_fn_vec == NULL){
-		    /* Note str2fn is a function pointer */
-		    cc->cc_fn_vec = str2fn(cc->cc_fn_str, arg, &callback_err);
-		    if (callback_err != NULL){
-			fprintf(stderr, "%s: error: No such function: %s (%s)\n",
-				__FUNCTION__, cc->cc_fn_str, callback_err);
-			goto done;
-		    }
+	    if (co->co_type == CO_VARIABLE &&
+		co->co_expand_fn_str != NULL && co->co_expandv_fn == NULL){
+		if (expandv_resolve(sc, co->co_expand_fn_str, str2fn, arg,
+				    &co->co_expandv_fn, &callback_err) < 0)
+		    goto done;
+		if (callback_err != NULL){
+		    fprintf(stderr, "%s: error: No such function: %s\n",
+			    "cligen_expandv_str2fn", co->co_expand_fn_str);
+		    goto done;
 		}
 	    }
 	    /* recursive call to next level */
-	    if (cligen_callbackv_str2fn(co_pt_get(co), str2fn, arg) < 0)
+	    if (expandv_str2fn1(co_pt_get(co), str2fn, arg, sc) < 0)
 		goto done;
 	}
+    }
     retval = 0;
   done:
     return retval;
@@ -274,6 +869,7 @@ cligen_callbackv_str2fn(parse_tree   *pt,
  * in the parse-tree to produce function pointers (eg fn) which is stored in the
  * parse-tree nodes. Later, at evaluation time, the actual function (fn) is
  * called when evaluating/interpreting the syntax.
+ * str2fn is called once for each distinct function name in the parse-tree.
  *
  * @param[in]  pt      parse-tree. Recursively loop thru this
  * @param[in]  str2fn  Translator from strings to function pointers for expand variable
@@ -285,25 +881,52 @@ int
 cligen_expandv_str2fn(parse_tree       *pt, 
 		      expandv_str2fn_t *str2fn, 
 		      void             *arg)
+{
+    struct str2fn_cache sc = {0,};
+    int                 retval;
+
+    retval = expandv_str2fn1(pt, str2fn, arg, &sc);
+    str2fn_cache_free(&sc);
+    return retval;
+}
+
+/*! Recursive part of cligen_translate_str2fn
+ * @param[in]  sc  Functions resolved so far in this walk
+ */
+static int
+translate_str2fn1(parse_tree          *pt, 
+		  translate_str2fn_t  *str2fn, 
+		  void                *arg,
+		  struct str2fn_cache *sc)
 {
     int                 retval = -1;
     cg_obj             *co;
     char               *callback_err = NULL;   /* Error from str2fn callback */
+    void               *fn;
     int                 i;
 
     for (i=0; i<pt_len_get(pt); i++){    
 	if ((co = pt_vec_i_get(pt, i)) != NULL){
-	    if (co->co_expand_fn_str != NULL && co->co_expandv_fn == NULL){
-		/* Note str2fn is a function pointer */
-		co->co_expandv_fn = str2fn(co->co_expand_fn_str, arg, &callback_err);
-		if (callback_err != NULL){
-		    fprintf(stderr, "%s: error: No such function: %s\n",
-			    __FUNCTION__, co->co_expand_fn_str);
-		    goto done;
+	    if (co->co_type == CO_VARIABLE &&
+		co->co_translate_fn_str != NULL && co->co_translate_fn == NULL){
+		if (str2fn_cache_get(sc, co->co_translate_fn_str, &fn) == 1)
+		    co->co_translate_fn = (translate_cb_t*)fn;
+		else {
+		    /* Note str2fn is a function pointer */
+		    cligen_stats_global_inc(_cligen_stats_str2fn);
+		    co->co_translate_fn = str2fn(co->co_translate_fn_str, arg, &callback_err);
+		    if (callback_err != NULL){
+			fprintf(stderr, "%s: error: No such function: %s\n",
+				"cligen_translate_str2fn", co->co_translate_fn_str);
+			goto done;
+		    }
+		    if (str2fn_cache_add(sc, co->co_translate_fn_str,
+					 (void*)co->co_translate_fn) < 0)
+			goto done;
 		}
 	    }
 	    /* recursive call to next level */
-	    if (cligen_expandv_str2fn(co_pt_get(co), str2fn, arg) < 0)
+	    if (translate_str2fn1(co_pt_get(co), str2fn, arg, sc) < 0)
 		goto done;
 	}
     }
@@ -314,6 +937,7 @@ cligen_expandv_str2fn(parse_tree       *pt,
 
 /*! Assign functions for translation of variables using a mapper function
  * The mapping is done from string to C-function. This is done recursively.
+ * str2fn is called once for each distinct function name in the parse-tree.
  * @param[in]  pt      Parse-tree. Recursively loop through and call str2fn
  * @param[in]  str2fn  Translator function from strings to function pointers
  * @param[in]  arg     Argument to call str2fn with
@@ -323,28 +947,128 @@ cligen_translate_str2fn(parse_tree         *pt,
 			translate_str2fn_t *str2fn, 
 			void               *arg)
 {
-    int                 retval = -1;
-    cg_obj             *co;
-    char               *callback_err = NULL;   /* Error from str2fn callback */
-    int                 i;
+    struct str2fn_cache sc = {0,};
+    int                 retval;
 
-    for (i=0; i<pt_len_get(pt); i++){    
-	if ((co = pt_vec_i_get(pt, i)) != NULL){
-	    if (co->co_translate_fn_str != NULL && co->co_translate_fn == NULL){
-		/* Note str2fn is a function pointer */
-		co->co_translate_fn = str2fn(co->co_translate_fn_str, arg, &callback_err);
-		if (callback_err != NULL){
-		    fprintf(stderr, "%s: error: No such function: %s\n",
-			    __FUNCTION__, co->co_translate_fn_str);
-		    goto done;
-		}
-	    }
-	    /* recursive call to next level */
-	    if (cligen_translate_str2fn(co_pt_get(co), str2fn, arg) < 0)
-		goto done;
-	}
-    }
-    retval = 0;
-  done:
+    retval = translate_str2fn1(pt, str2fn, arg, &sc);
+    str2fn_cache_free(&sc);
     return retval;
 }
+
+/*! Map callback and expand functions of a handle when they are first called
+ *
+ * Instead of cligen_callbackv_str2fn() and cligen_expandv_str2fn() walking all
+ * parse-trees when loaded, a callback function name is mapped by cb_str2fn when
+ * a command with the callback is first evaluated, and an expand function name by
+ * ex_str2fn when the variable is first expanded. Each function name is mapped once
+ * per handle. This cuts startup time of large parse-trees where few commands are used.
+ * An unknown function is reported when the command is evaluated.
+ * @param[in]  h          CLIgen handle
+ * @param[in]  cb_str2fn  Translator of callback names, or NULL
+ * @param[in]  ex_str2fn  Translator of expand names, or NULL
+ * @param[in]  arg        Argument to cb_str2fn and ex_str2fn
+ * @retval     0          OK
+ * @retval    -1          Error
+ * @note Functions are stored in the parse-tree objects when first called, also if the
+ *       parse-tree is frozen and shared by several handles: set the same translators in
+ *       all of them.
+ * @see cligen_str2fn_lazy_flush
+ */
+int
+cligen_str2fn_lazy_set(cligen_handle     h,
+		       cgv_str2fn_t     *cb_str2fn,
+		       expandv_str2fn_t *ex_str2fn,
+		       void             *arg)
+{
+    struct cligen_handle *ch = handle(h);
+    struct str2fn_lazy   *sl;
+
+    cligen_str2fn_lazy_flush(h);
+    if (cb_str2fn == NULL && ex_str2fn == NULL)
+	return 0;
+    if ((sl = calloc(1, sizeof(*sl))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    sl->sl_cb_str2fn = cb_str2fn;
+    sl->sl_ex_str2fn = ex_str2fn;
+    sl->sl_arg = arg;
+    sl->sl_cb_cache.sc_dup = 1;
+    sl->sl_ex_cache.sc_dup = 1;
+    ch->ch_str2fn_lazy = sl;
+    return 0;
+}
+
+/*! Stop lazy mapping of functions of a handle and free its resolved functions
+ * @param[in]  h          CLIgen handle
+ * @retval     0          OK
+ * @see cligen_str2fn_lazy_set
+ */
+int
+cligen_str2fn_lazy_flush(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    struct str2fn_lazy   *sl;
+
+    if ((sl = ch->ch_str2fn_lazy) != NULL){
+	str2fn_cache_free(&sl->sl_cb_cache);
+	str2fn_cache_free(&sl->sl_ex_cache);
+	free(sl);
+	ch->ch_str2fn_lazy = NULL;
+    }
+    return 0;
+}
+
+/*! Map the function of a callback if not done, see cligen_str2fn_lazy_set
+ * @param[in]  h   CLIgen handle
+ * @param[in]  cc  Callback
+ * @retval     0   OK, or no lazy mapping
+ * @retval    -1   Error, or no such function, statement written on stderr
+ */
+int
+cligen_callbackv_bind(cligen_handle       h,
+		      struct cg_callback *cc)
+{
+    struct str2fn_lazy *sl;
+    char               *callback_err = NULL;
+
+    if (cc->cc_fn_vec != NULL || cc->cc_fn_str == NULL || h == NULL ||
+	(sl = handle(h)->ch_str2fn_lazy) == NULL || sl->sl_cb_str2fn == NULL)
+	return 0;
+    if (callbackv_resolve(&sl->sl_cb_cache, cc->cc_fn_str, sl->sl_cb_str2fn, sl->sl_arg,
+			  &cc->cc_fn_vec, &callback_err) < 0)
+	return -1;
+    if (callback_err != NULL){
+	fprintf(stderr, "%s: error: No such function: %s (%s)\n",
+		__FUNCTION__, cc->cc_fn_str, callback_err);
+	return -1;
+    }
+    return 0;
+}
+
+/*! Map the expand function of a variable if not done, see cligen_str2fn_lazy_set
+ * @param[in]  h   CLIgen handle
+ * @param[in]  co  Variable object
+ * @retval     0   OK, or no lazy mapping
+ * @retval    -1   Error, or no such function, statement written on stderr
+ */
+int
+cligen_expandv_bind(cligen_handle h,
+		    cg_obj       *co)
+{
+    struct str2fn_lazy *sl;
+    char               *callback_err = NULL;
+
+    if (co->co_expandv_fn != NULL || co->co_expand_fn_str == NULL || h == NULL ||
+	(sl = handle(h)->ch_str2fn_lazy) == NULL || sl->sl_ex_str2fn == NULL)
+	return 0;
+    if (expandv_resolve(&sl->sl_ex_cache, co->co_expand_fn_str, sl->sl_ex_str2fn, sl->sl_arg,
+			&co->co_expandv_fn, &callback_err) < 0)
+	return -1;
+    if (callback_err != NULL){
+	fprintf(stderr, "%s: error: No such function: %s\n",
+		__FUNCTION__, co->co_expand_fn_str);
+	return -1;
+    }
+    return 0;
+}
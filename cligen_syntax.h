@@ -74,10 +74,25 @@ cligen_parse_file(cligen_handle h,
 		  parse_tree   *obsolete,
 		  cvec         *globals);
 
+int
+cligen_parse_files(cligen_handle     h,
+		   char            **files,
+		   int               nfiles,
+		   int               nworkers,
+		   cgv_str2fn_t     *cb_str2fn,
+		   expandv_str2fn_t *ex_str2fn,
+		   void             *arg,
+		   cvec             *globals);
+
 int cligen_callback_str2fn(parse_tree *pt, cg_str2fn_t *str2fn, void *arg);
 int cligen_callbackv_str2fn(parse_tree *pt, cgv_str2fn_t *str2fn, void *arg);
 int cligen_expandv_str2fn(parse_tree *pt, expandv_str2fn_t *str2fn, void *arg);
 int cligen_translate_str2fn(parse_tree *pt, translate_str2fn_t *str2fn, void *arg);
+int cligen_str2fn_lazy_set(cligen_handle h, cgv_str2fn_t *cb_str2fn,
+			   expandv_str2fn_t *ex_str2fn, void *arg);
+int cligen_str2fn_lazy_flush(cligen_handle h);
+int cligen_callbackv_bind(cligen_handle h, struct cg_callback *cc);
+int cligen_expandv_bind(cligen_handle h, cg_obj *co);
 int cligen_parse_debug(int d); 
 
 #endif /* _CLIGEN_SYNTAX_H_ */
@@ -0,0 +1,179 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+ *
+ *
+ * CLIgen latency tracing of command evaluation, see cligen_trace.h
+ */
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <netinet/in.h>
+
+#include "cligen_buf.h"
+#include "cligen_cv.h"
+#include "cligen_cvec.h"
+#include "cligen_parsetree.h"
+#include "cligen_pt_head.h"
+#include "cligen_object.h"
+#include "cligen_handle.h"
+#include "cligen_read.h"
+#include "cligen_trace.h"
+#include "cligen_handle_internal.h"
+#include "cligen_stats_internal.h"
+#include "cligen_trace_internal.h"
+
+/* Names of phases, indexed by enum cligen_trace_phase */
+static const char *trace_phase_names[CT_NPHASES] = {
+    "tokenize",
+    "treeref",
+    "expand",
+    "match",
+    "validate",
+    "translate",
+    "callback",
+};
+
+/*! Register a trace hook called for each evaluated command
+ * Replaces a previous hook. Phases of evaluations are timed only while a hook is set.
+ * @param[in]  h    CLIgen handle
+ * @param[in]  fn   Trace hook, or NULL to stop tracing
+ * @param[in]  arg  Argument given to fn
+ * @retval     0    OK
+ * @retval    -1    Error
+ * @see cligen_trace_cb
+ */
+int
+cligen_trace_set(cligen_handle    h,
+		 cligen_trace_cb *fn,
+		 void            *arg)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (fn == NULL){
+	if (ch->ch_trace){
+	    free(ch->ch_trace);
+	    ch->ch_trace = NULL;
+	}
+    }
+    else if (ch->ch_trace == NULL){
+	if ((ch->ch_trace = calloc(1, sizeof(*ch->ch_trace))) == NULL){
+	    fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+    }
+    ch->ch_trace_fn = fn;
+    ch->ch_trace_arg = arg;
+    return 0;
+}
+
+/*! Get the trace hook of a handle
+ * @param[in]  h    CLIgen handle
+ * @param[out] arg  Argument of the hook (if set)
+ * @retval     fn   Trace hook
+ * @retval     NULL No trace hook is set
+ */
+cligen_trace_cb *
+cligen_trace_get(cligen_handle h,
+		 void        **arg)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (arg)
+	*arg = ch->ch_trace_arg;
+    return ch->ch_trace_fn;
+}
+
+/*! Name of a trace phase, eg for exporting spans
+ * @param[in]  phase  Phase
+ * @retval     name   Name of phase, eg "match"
+ * @retval     NULL   Unknown phase
+ */
+const char *
+cligen_trace_phase2str(enum cligen_trace_phase phase)
+{
+    if ((int)phase < 0 || phase >= CT_NPHASES)
+	return NULL;
+    return trace_phase_names[phase];
+}
+
+/*! Start tracing a command in the trace record of a handle
+ * @param[in]  ct   Trace record, see cligen_trace_rec
+ * @retval     t    Start time
+ */
+uint64_t
+cligen_trace_start(cligen_trace *ct)
+{
+    memset(ct, 0, sizeof(*ct));
+    ct->ct_start = cligen_stats_ns();
+    return ct->ct_start;
+}
+
+/*! Add the time from t0 until now to a phase of a trace
+ * @param[in]  ct     Trace record
+ * @param[in]  phase  Phase
+ * @param[in]  t0     Start of phase
+ * @retval     t      Now, ie start of the next phase
+ */
+uint64_t
+cligen_trace_phase(cligen_trace *ct,
+		   int           phase,
+		   uint64_t      t0)
+{
+    uint64_t t = cligen_stats_ns();
+
+    if (ct->ct_phase_start[phase] == 0)
+	ct->ct_phase_start[phase] = t0;
+    ct->ct_ns[phase] += t - t0;
+    return t;
+}
+
+/*! Call the trace hook of a handle with a finished trace
+ * @param[in]  h    CLIgen handle
+ * @param[in]  ct   Trace, a copy of the trace record of the handle
+ * @retval     0    OK, also if no hook is set
+ * @retval    -1    Error, the hook returned -1
+ */
+int
+cligen_trace_report(cligen_handle h,
+		    cligen_trace *ct)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_trace_fn == NULL)
+	return 0;
+    return (*ch->ch_trace_fn)(h, ct, ch->ch_trace_arg);
+}
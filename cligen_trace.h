@@ -0,0 +1,106 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+ *
+ *
+ * CLIgen latency tracing of command evaluation
+ * A trace hook registered on a handle is called once for each evaluated command with
+ * the command string, the parse result, the matched object and the time spent in
+ * each phase of the evaluation, eg to export spans or to keep a latency histogram
+ * per command path. Phases are only timed while a hook is registered.
+ * @code
+ *   static int
+ *   trace_cb(cligen_handle h, cligen_trace *ct, void *arg)
+ *   {
+ *       if (ct->ct_result == CG_MATCH)
+ *           histogram_add(ct->ct_co, ct->ct_end - ct->ct_start);
+ *       return 0;
+ *   }
+ *   cligen_trace_set(h, trace_cb, NULL);
+ * @endcode
+ * The hook is called by cliread_eval(), cligen_eval_batch(), pipelines and sessions,
+ * and by cligen_eval_parsed() for applications calling cliread_parse() themselves.
+ * It is called in the thread evaluating the command, also for pipelined batches where
+ * the callbacks run in a worker thread.
+ */
+
+#ifndef _CLIGEN_TRACE_H_
+#define _CLIGEN_TRACE_H_
+
+/*
+ * Types
+ */
+/*! Phases of an evaluation, see cligen_trace */
+enum cligen_trace_phase{
+    CT_TOKENIZE = 0, /* Trim and split the command string into tokens */
+    CT_TREEREF,      /* Expand tree references, pt_expand_treeref */
+    CT_EXPAND,       /* Expand choices and expand callbacks of top level, pt_expand */
+    CT_MATCH,        /* Match tokens, match_pattern_exact, incl CT_VALIDATE and CT_TRANSLATE */
+    CT_VALIDATE,     /* Validate variable values, cv_validate */
+    CT_TRANSLATE,    /* Translate callbacks of variables */
+    CT_CALLBACK,     /* Callbacks of the matched command, cligen_eval */
+};
+#define CT_NPHASES (CT_CALLBACK+1)
+
+/*! Trace of one evaluated command given to a trace hook
+ * Times are CLOCK_MONOTONIC in nanoseconds. A phase that is not run, eg callbacks of a
+ * command that did not match, has ct_phase_start and ct_ns 0. Validation and
+ * translation are run several times while matching: ct_phase_start is the first
+ * start and ct_ns the sum.
+ */
+typedef struct cligen_trace {
+    char         *ct_cmd;       /* Command string, trimmed */
+    cligen_result ct_result;    /* Parse result */
+    cg_obj       *ct_co;        /* Matched object if ct_result is CG_MATCH */
+    int           ct_cb_retval; /* Return value of callbacks if they are called */
+    uint64_t      ct_start;     /* Start of evaluation */
+    uint64_t      ct_end;       /* End of evaluation */
+    uint64_t      ct_phase_start[CT_NPHASES]; /* Start of each phase */
+    uint64_t      ct_ns[CT_NPHASES];          /* Time spent in each phase */
+} cligen_trace;
+
+/*! Trace hook, called when a command is evaluated
+ * @param[in]  h    CLIgen handle
+ * @param[in]  ct   Trace of the command, only valid during the call
+ * @param[in]  arg  Argument given to cligen_trace_set
+ * @retval     0    OK
+ * @retval    -1    Error, returned by the evaluating function
+ */
+typedef int (cligen_trace_cb)(cligen_handle h, cligen_trace *ct, void *arg);
+
+/*
+ * Prototypes
+ */
+int   cligen_trace_set(cligen_handle h, cligen_trace_cb *fn, void *arg);
+cligen_trace_cb *cligen_trace_get(cligen_handle h, void **arg);
+const char *cligen_trace_phase2str(enum cligen_trace_phase phase);
+
+#endif /* _CLIGEN_TRACE_H_ */
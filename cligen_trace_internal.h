@@ -0,0 +1,53 @@
+/*
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+ *
+ * CLIgen latency tracing, internal definitions
+ * A file using cligen_trace_rec() must include cligen_trace.h and cligen_handle_internal.h
+ */
+
+#ifndef _CLIGEN_TRACE_INTERNAL_H
+#define _CLIGEN_TRACE_INTERNAL_H
+
+/*
+ * Macros
+ */
+/* Trace record of the command being parsed, NULL if no trace hook is set */
+#define cligen_trace_rec(h) (handle(h)->ch_trace)
+
+/*
+ * Prototypes
+ */
+uint64_t cligen_trace_start(cligen_trace *ct);
+uint64_t cligen_trace_phase(cligen_trace *ct, int phase, uint64_t t0);
+int      cligen_trace_report(cligen_handle h, cligen_trace *ct);
+
+#endif /* _CLIGEN_TRACE_INTERNAL_H */
@@ -57,5 +57,9 @@ println "Mem test cligen begin"
 memonce $cmd1
 println "Mem test cligen done"
 
+# Memory breakdown of the tutorial parse-trees in bytes, see cligen_handle_memsize
+println "Mem use of tutorial"
+../cligen_file -b -M -f ../tutorial.cli < /dev/null
+
 
 unset pattern
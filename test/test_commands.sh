@@ -17,6 +17,7 @@ cat > $fspec <<EOF
     a,callback();
     b,callback();
   }
+  f,fail();
 EOF
 
 newtest "$cligen_file -f $fspec"
@@ -39,6 +40,217 @@ expectpart "$(echo "abc" | $cligen_file -f $fspec 2>&1)" 0 "1 name:abc type:stri
 newtest "abd incomplete"
 expectpart "$(echo "abd" | $cligen_file -f $fspec 2>&1)" 0 'CLI syntax error in: "abd": Incomplete command'
 
+# Same with all objects copied when expanding (lazy expansion disabled)
+newtest "abc ok, no lazy expansion"
+expectpart "$(echo "abc" | $cligen_file -L 0 -f $fspec 2>&1)" 0 "1 name:abc type:string value:abc"
+
+newtest "abd b ok, no lazy expansion"
+expectpart "$(echo "abd b" | $cligen_file -L 0 -f $fspec 2>&1)" 0 "2 name:b type:string value:b"
+
+newtest "ab ambiguous, no lazy expansion"
+expectpart "$(echo "ab" | $cligen_file -L 0 -f $fspec)" 0 "Ambiguous command"
+
+# Lazy expansion: a keyword that is a prefix of a borrowed sibling is preferred
+# as with all objects copied
+fspec8=$dir/spec8.cli
+cat > $fspec8 <<EOF
+  prompt="cli> ";
+  val <v:int32>, callback();
+  value, callback();
+  kw1 <n:int32>, callback();
+  kw10, callback();
+  show interface <name:string>, callback();
+  show interfaces, callback();
+EOF
+
+newtest "lazy expansion: prefix of sibling"
+expectpart "$(printf "val 5\nkw1 7\nshow interface exp1\n" | $cligen_file -f $fspec8 2>&1)" 0 "2 name:v type:int32 value:5" "2 name:n type:int32 value:7" "3 name:name type:string value:exp1" --not-- "Unknown command"
+
+newtest "lazy expansion: prefix of sibling, invalid variable"
+expectpart "$(echo "kw1 x" | $cligen_file -f $fspec8 2>&1)" 0 "'x' is not a number"
+
+newtest "lazy expansion: prefix of sibling ?"
+expectpart "$(printf "val ?\nshow interface ?\n" | $cligen_file -f $fspec8 2>&1)" 0 "<v>" "<name>"
+
+# Batch mode: all lines are evaluated, errors are reported per line
+newtest "batch mode"
+expectpart "$(printf "a\nb\nabd b\n\nab\nabc # comment\n" | $cligen_file -b -f $fspec 2>&1)" 0 "1 name:a type:string value:a" '2: CLI syntax error in: "b": Unknown command' "2 name:b type:string value:b" "5: Ambiguous command" "1 name:abc type:string value:abc" "2 errors"
+
+# Pipelined batch mode: same reports in line order, callback errors point at their line
+newtest "batch mode pipelined"
+expectpart "$(printf "a\nf\nb\nabd b\nf\nab\nabc\n" | $cligen_file -b -l 4 -f $fspec 2>&1)" 0 "1 name:a type:string value:a" "2: CLI callback error" '3: CLI syntax error in: "b": Unknown command' "2 name:b type:string value:b" "5: CLI callback error" "6: Ambiguous command" "1 name:abc type:string value:abc" "4 errors"
+
+newtest "batch mode pipelined, same output as not pipelined"
+lines=$(for i in $(seq 1 50); do printf "a\nf\nb\nabd b\n\nab\n"; done)
+ret0=$(echo "$lines" | $cligen_file -b -f $fspec 2>/dev/null)
+ret1=$(echo "$lines" | $cligen_file -b -l 3 -f $fspec 2>/dev/null)
+if [ "$ret0" != "$ret1" ]; then
+    err "$ret0" "$ret1"
+fi
+
+# Working point changes are not pipelined: the next line is parsed in the new mode
+fspec3=$dir/spec3.cli
+cat > $fspec3 <<EOF
+  treename="top";
+  edit, cligen_wp_set("working");{
+    @working, cligen_wp_set("working");
+  }
+  up, cligen_wp_up("working");
+  do @working, callback();
+  treename="working";
+  a; {
+    b <v:int32>, callback();
+  }
+EOF
+
+newtest "batch mode pipelined, working point"
+lines=$(for i in $(seq 1 100); do printf "edit a\ndo b 23\nup\ndo a b 24\n"; done)
+expectpart "$(echo "$lines" | $cligen_file -b -l 4 -f $fspec3 2>&1)" 0 "3 name:v type:int32 value:23" "4 name:v type:int32 value:24" --not-- "syntax error"
+
+# Trace hook: one line per command with path and time of each phase, callbacks
+# only if the command matched
+newtest "trace: phases of each command"
+expectpart "$(printf "abd b\nb\nf\n" | $cligen_file -b -r -f $fspec 2>&1)" 0 'trace "abd b" result 1 path abd b tokenize' 'trace "b" result 0 tokenize' 'trace "f" result 1 path f tokenize' "treeref" "expand" "match" "callback" --not-- 'result 0 tokenize [0-9]* treeref [0-9]* expand [0-9]* match [0-9]* callback'
+
+newtest "trace: pipelined batch mode"
+expectpart "$(printf "abd b\nb\nf\n" | $cligen_file -b -l 4 -r -f $fspec 2>&1)" 0 'trace "abd b" result 1 path abd b tokenize' 'trace "b" result 0 tokenize' 'trace "f" result 1 path f tokenize' "callback"
+
+newtest "trace: interactive"
+expectpart "$(printf "abd b\nab\n" | $cligen_file -r -f $fspec 2>&1)" 0 'trace "abd b" result 1 path abd b tokenize' 'trace "ab" result 2 tokenize'
+
+# Buffers used while evaluating are reused from the cbuf pool
+newtest "batch mode: cbufs from pool"
+expectpart "$(for i in $(seq 1 100); do echo "abd"; echo "ab"; done | $cligen_file -b -S -f $fspec 2>&1)" 0 "200 errors" "cbuf_alloc 0"
+
+# Wide level with more children than PT_INDEX_MIN: uses keyword index
+fspec2=$dir/spec2.cli
+echo '  prompt="cli> ";' > $fspec2
+for i in $(seq 1 40); do
+    echo "  cmd$i,callback();" >> $fspec2
+done
+cat >> $fspec2 <<EOF
+  cmd,callback();
+  cmdx <v:int32>,callback();
+  <s:string regexp:"z.*">,callback();
+EOF
+
+newtest "wide: exact match among prefixes"
+expectpart "$(echo "cmd" | $cligen_file -f $fspec2 2>&1)" 0 "1 name:cmd type:string value:cmd"
+
+newtest "wide: unique keyword"
+expectpart "$(echo "cmd17" | $cligen_file -f $fspec2 2>&1)" 0 "1 name:cmd17 type:string value:cmd17"
+
+newtest "wide: exact match also prefix of others"
+expectpart "$(echo "cmd1" | $cligen_file -f $fspec2 2>&1)" 0 "1 name:cmd1 type:string value:cmd1"
+
+newtest "wide: ambiguous prefix"
+expectpart "$(echo "cm" | $cligen_file -f $fspec2 2>&1)" 0 "Ambiguous command"
+
+newtest "wide: keyword with variable"
+expectpart "$(echo "cmdx 42" | $cligen_file -f $fspec2 2>&1)" 0 "2 name:v type:int32 value:42"
+
+newtest "wide: variable"
+expectpart "$(echo "zoo" | $cligen_file -f $fspec2 2>&1)" 0 "1 name:s type:string value:zoo"
+
+newtest "wide: invalid variable"
+expectpart "$(echo "foo" | $cligen_file -f $fspec2 2>&1)" 0 "is invalid input for cli command"
+
+# Frozen tree shared with a second handle: keyword index is built by pt_freeze
+newtest "wide frozen: keyword index"
+expectpart "$(printf "cmd1\ncmd17\ncmdx 42\ncm\nzoo\n" | $cligen_file -F -f $fspec2 2>&1)" 0 "1 name:cmd1 type:string value:cmd1" "1 name:cmd17 type:string value:cmd17" "2 name:v type:int32 value:42" "Ambiguous command" "1 name:s type:string value:zoo"
+
+# Hot-path counters: the regexp is compiled once and cached
+newtest "stats: counters"
+expectpart "$(printf "zoo\nzap\ncmd17\n" | $cligen_file -b -S -f $fspec2 2>&1)" 0 "eval 3" "regex_compile 1" "match_object"
+
+# Callbacks mapped when first called: all commands share one function name
+newtest "lazy bind: callback mapped once"
+expectpart "$(printf "cmd1\ncmd17\ncmd1\n" | $cligen_file -b -S -B -f $fspec2 2>&1)" 0 "1 name:cmd1 type:string value:cmd1" "1 name:cmd17 type:string value:cmd17" "str2fn 1"
+
+# More global variables than CVEC_INDEX_MIN: cvec_find uses a name index
+fspec5=$dir/spec5.cli
+for i in $(seq 1 40); do
+    echo "  g$i=\"$i\";" >> $fspec5
+done
+cat >> $fspec5 <<EOF
+  prompt="wide> ";
+  comment="#";
+  prompt="not used> ";
+  cmd,callback();
+EOF
+
+newtest "wide globals: first of each name"
+expectpart "$(printf "cmd # comment\n" | $cligen_file -f $fspec5 2>&1)" 0 "wide> cmd # comment" "1 name:cmd type:string value:cmd" --not-- "not used>"
+
+# Repeated statements are merged into one command when the parse-tree is built
+fspec3=$dir/spec3.cli
+cat > $fspec3 <<EOF
+  prompt="cli> ";
+  x("first help") y, callback();
+  x("second help") z, callback();
+  x, callback();
+EOF
+
+newtest "merge: first help and children of all statements"
+expectpart "$($cligen_file -b -p -f $fspec3 < /dev/null 2>&1)" 0 'x("first help"), callback();{' "y, callback();" "z, callback();"
+
+newtest "merge: command of last statement"
+expectpart "$(echo "x" | $cligen_file -f $fspec3 2>&1)" 0 "1 name:x type:string value:x"
+
+newtest "merge: command of second statement"
+expectpart "$(echo "x z" | $cligen_file -f $fspec3 2>&1)" 0 "2 name:z type:string value:z"
+
+# Wide level where every command is declared twice, in reverse order the second time
+fspec4=$dir/spec4.cli
+echo '  prompt="cli> ";' > $fspec4
+for i in $(seq 1 200); do
+    echo "  key${i}x a,callback();" >> $fspec4
+done
+for i in $(seq 200 -1 1); do
+    echo "  key${i}x b,callback();" >> $fspec4
+done
+
+newtest "wide merge: one command per keyword"
+expectpart "$($cligen_file -b -p -f $fspec4 < /dev/null 2>&1)" 0 "key17x{" "key200x{" --not-- "key17x a" "key17x b"
+
+newtest "wide merge: children of both statements"
+expectpart "$(printf "key17x a\nkey17x b\nkey200x b\n" | $cligen_file -b -f $fspec4 2>&1)" 0 "2 name:a type:string value:a" "2 name:b type:string value:b" --not-- "error"
+
+# 200 keywords plus a and b, each string is stored once however many objects use it
+newtest "wide merge: keywords interned once"
+expectpart "$(echo "key17x a" | $cligen_file -b -S -f $fspec4 2>&1)" 0 "intern_str 202"
+
+# Memory breakdown: 200 keywords of 5-7 chars, each with the children a and b
+newtest "memsize: breakdown of handle and parse-trees"
+ret=$($cligen_file -b -M -f $fspec4 < /dev/null 2>&1)
+expectpart "$ret" 0 "mem_nodes" "mem_ptvecs" "mem_callbacks" "mem_history" "mem_total"
+nr=$(echo "$ret" | grep "mem_interned" | awk '{print $2}')
+if [ -z "$nr" ] || [ "$nr" -lt 2000 ]; then
+    err "mem_interned >= 2000" "$nr"
+fi
+
+# Spec files are mapped, other files such as pipes are read in blocks
+fspec6=$dir/spec6.cli
+echo '  prompt="cli> ";' > $fspec6
+for i in $(seq 1 5000); do
+    echo "  command${i}x a,callback();" >> $fspec6
+done
+
+newtest "spec read from pipe in blocks"
+expectpart "$(printf "command1x a\ncommand5000x a\n" | $cligen_file -b -f <(cat $fspec6) 2>&1)" 0 "1 name:command1x type:string value:command1x" "1 name:command5000x type:string value:command5000x" --not-- "error"
+
+# The mapped file ends on a page boundary, the scanner must still find two NUL chars after it
+fspec7=$dir/spec7.cli
+line='  pagex,callback();'
+pagesize=$(getconf PAGESIZE)
+printf "#%0$((pagesize - ${#line} - 3))d\n%s\n" 0 "$line" > $fspec7
+
+newtest "spec file size is a page"
+expectpart "$(echo "pagex" | $cligen_file -b -f $fspec7 2>&1)" 0 "1 name:pagex type:string value:pagex" --not-- "error"
+if [ $(stat -c %s $fspec7) -ne $pagesize ]; then
+    err "$pagesize" "$(stat -c %s $fspec7)"
+fi
+
 endtest
 
 rm -rf $dir
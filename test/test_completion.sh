@@ -40,6 +40,33 @@ expectpart "$(echo "v	a	" | $cligen_file -f $fspec)" 0  "values
 newtest "v<tab>a<tab>42 OK"
 expectpart "$(echo "v	a	42" | $cligen_file -f $fspec 2>&1)" 0  "cli> values 42" "1 name:values type:string value:values" "2 name:int32 type:int32 value:42" 
 
+# Repeated TAB on the same line continues matching after the unchanged tokens
+fspec2=$dir/spec2.cli
+cat > $fspec2 <<EOF
+  prompt="cli> ";
+  set a b c {
+     <x:string>,callback();
+     d <y:int32>, callback();
+     e, callback();
+  }
+  sh (x|y), callback();
+EOF
+
+newtest "deep line: repeated tab reuses matched tokens"
+expectpart "$(printf "set a b c \t\td 4\t\t2\n" | $cligen_file -S -f $fspec2 2>&1)" 0 "d                         e" "<y>" "5 name:d type:string value:d" "6 name:y type:int32 value:42" --not-- "match_resume 0"
+
+newtest "deep line: modified tokens are matched again"
+expectpart "$(printf "set a b c \t\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7fsh \t\tx\n" | $cligen_file -f $fspec2 2>&1)" 0 "x                         y" "1 name:sh type:string value:sh" "2 name:x type:string value:x"
+
+newtest "help: repeated ? prints help from cache"
+expectpart "$(printf "set a b c ??\n" | $cligen_file -S -f $fspec2 2>&1)" 0 "d" "e" "<x>" "help_cached 1"
+
+newtest "help: repeated tab prints columns from cache"
+expectpart "$(printf "sh \t\tx\n" | $cligen_file -S -f $fspec2 2>&1)" 0 "x                         y" "help_cached 1" "2 name:x type:string value:x"
+
+newtest "help: other prefix is not cached"
+expectpart "$(printf "set a b c ?d?\n" | $cligen_file -S -f $fspec2 2>&1)" 0 "<x>" "help_cached 0" "Incomplete command"
+
 endtest
 
 rm -rf $dir
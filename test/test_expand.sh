@@ -73,6 +73,60 @@ expectpart "$(echo "a foo y" | $cligen_file -e -f $fspec 2>&1)" 0 "1 name:a type
 newtest "a exp1 y"
 expectpart "$(echo "a exp1 y" | $cligen_file -e -f $fspec 2>&1)" 0 "1 name:a type:string value:a" "2 name:x type:string value:exp1" "3 name:y type:string value:y"
 
+# With expand cache, each of the two callbacks is called once for the whole command line
+newtest "a ex<tab><tab>?1 y expand cache"
+expectpart "$(printf "a ex\t\t?1 y\n" | $cligen_file -e -S -x -1 -f $fspec 2>&1)" 0 "2 name:x type:string value:exp1" "expand_cb 2"
+
+# Repeated ? calls the expand callbacks again unless their results are cached
+newtest "a exp1 ??? no expand cache"
+expectpart "$(printf "a exp1 ???\n" | $cligen_file -e -S -f $fspec 2>&1)" 0 "expand_cb 14" "match_resume 0"
+
+newtest "a exp1 ??? expand cache"
+expectpart "$(printf "a exp1 ???\n" | $cligen_file -e -S -x -1 -f $fspec 2>&1)" 0 "expand_cb 4" "match_resume 4"
+
+newtest "a exp1 y, a exp3 y batch expand cache"
+expectpart "$(printf "a exp1 y\na exp3 y\n" | $cligen_file -e -S -b -x 10000 -f $fspec 2>&1)" 0 "2 name:x type:string value:exp1" "2 name:x type:string value:exp3" "expand_cb 2"
+
+# Expand and callback functions mapped when first used, one str2fn call per name
+newtest "a exp1 y, a exp3 y lazy bind"
+expectpart "$(printf "a exp1 y\na exp3 y\n" | $cligen_file -e -S -b -B -f $fspec 2>&1)" 0 "2 name:x type:string value:exp1" "2 name:x type:string value:exp3" "str2fn 3"
+
+# Large expand set (cligen_file many() returns if0..if999): only values that may
+# match the next token are expanded, with and without expand cache
+cat > $fspec <<EOF
+  prompt="cli> ";
+  a <x:string many()> y, callback();
+EOF
+
+newtest "a if17 y large expand set"
+expectpart "$(printf "a if17 y\na if1 y\n" | $cligen_file -e -S -b -f $fspec 2>&1)" 0 "2 name:x type:string value:if17" "2 name:x type:string value:if1" "expand_copy 122" "expand_skip 1878"
+
+newtest "a if17 y large expand set cached"
+expectpart "$(printf "a if17 y\na if1 y\na foo y\n" | $cligen_file -e -S -b -x 10000 -f $fspec 2>&1)" 0 "2 name:x type:string value:if17" "2 name:x type:string value:if1" "Unknown command" "expand_cb 1" "expand_skip 2877"
+
+newtest "a if99<tab> large expand set"
+expectpart "$(printf "a if99\t\t\n" | $cligen_file -e -f $fspec 2>&1)" 0 "if990" "if999" --not-- "if989"
+
+# Expanded values are merged into the sorted level (cligen_file uses lexical order)
+cat > $fspec <<EOF
+  prompt="cli> ";
+  a {
+    if10, callback();
+    if2, callback();
+    if02, callback();
+    exp10, callback();
+    ex, callback();
+    <x:string exp()>, callback();
+    iF1, callback();
+  }
+EOF
+
+newtest "a ? expanded values merged in lexical order"
+expectpart "$(printf "a ?\n" | $cligen_file -e -f $fspec 2>&1 | tr -s ' \n' ' ')" 0 "ex exp1 Help exp1 exp2 Help exp2 exp3 Help exp3 exp10 iF1 if02 if2 if10"
+
+newtest "a ? expanded values merged in lexical order, not lazy"
+expectpart "$(printf "a ?\n" | $cligen_file -e -L 0 -f $fspec 2>&1 | tr -s ' \n' ' ')" 0 "ex exp1 Help exp1 exp2 Help exp2 exp3 Help exp3 exp10 iF1 if02 if2 if10"
+
 # XXX: this does not work as expected, you get unknown command,
 # It is a known issue and tricky to fix
 if false; then
@@ -80,6 +134,39 @@ if false; then
     expectpart "$(echo "a exp2 y" | $cligen_file -e -f $fspec 2>&1)" 0 "1 name:a type:string value:a" "2 name:x type:string value:exp2" "3 name:y type:string value:y"
 fi
 
+# Expand callback with slow backend (cligen_file slow() replies after 200ms)
+cat > $fspec <<EOF
+  prompt="cli> ";
+  b <x:string slow()>, callback();
+EOF
+
+newtest "b ? no deadline"
+expectpart "$(printf "b ?slow2\n" | $cligen_file -e -f $fspec 2>&1)" 0 "slow1                 Help slow1" "slow2                 Help slow2" "2 name:x type:string value:slow2" --not-- "<loading...>"
+
+newtest "b ? deadline shows partial result"
+expectpart "$(printf "b ?slow2\n" | $cligen_file -e -D 50 -f $fspec 2>&1)" 0 "slow1                 Help slow1" "<loading...>" "2 name:x type:string value:slow2" --not-- "slow2                 Help slow2"
+
+newtest "b ? long deadline"
+expectpart "$(printf "b ?slow2\n" | $cligen_file -e -D 2000 -f $fspec 2>&1)" 0 "slow2                 Help slow2" "2 name:x type:string value:slow2" --not-- "<loading...>"
+
+# Late result is cached when it arrives, second ? does not call the callback
+newtest "b ? deadline, late result cached"
+expectpart "$( (printf "b ?"; sleep 0.5; printf "?slow2\n") | $cligen_file -e -S -x -1 -D 50 -f $fspec 2>&1)" 0 "<loading...>" "slow2                 Help slow2" "2 name:x type:string value:slow2" "expand_cb 2"
+
+# Pending callback replies with a new request on another file descriptor (slowhop), or
+# fails (slowfail)
+cat > $fspec <<EOF
+  prompt="cli> ";
+  b <x:string slowhop()>, callback();
+  c <x:string slowfail()>, callback();
+EOF
+
+newtest "b ? deadline, pending on a new file descriptor"
+expectpart "$( (printf "b ?"; sleep 0.7; printf "?slow2\n") | $cligen_file -e -S -x -1 -D 50 -f $fspec 2>&1)" 0 "<loading...>" "slow2                 Help slow2" "2 name:x type:string value:slow2" "expand_cb 3"
+
+newtest "c ? deadline, late callback fails"
+expectpart "$( (printf "c ?"; sleep 0.5) | $cligen_file -e -S -D 50 -f $fspec 2>&1)" 0 "<loading...>" "expand_cb 2" --not-- "invalid file descriptor"
+
 # Tab modes
 # See description in cligen_handle.c
 cat > $fspec <<EOF
@@ -32,10 +32,14 @@ newtest "<esc>f,^f"
 expectpart "$(echo -n "ruled over thebf" | $cligen_file -f $fspec 2>&1)" 0 "ruled over the"
 
 newtest "^p"
-expectpart "$(echo -n "ruled over the" | $cligen_file -f $fspec 2>&1)" 0 "ruled over the"
+expectpart "$(echo -n "ruled
+ over the" | $cligen_file -f $fspec 2>&1)" 0 "ruled over the"
 
 newtest "^pn"
-expectpart "$(echo -n "ruledTheo				" | $cligen_file -f $fspec)" 0 "Theodoric the bold "
+expectpart "$(echo -n "ruled
+Theo
+				
+" | $cligen_file -f $fspec)" 0 "Theodoric the bold "
 
 newtest "^ut"
 expectpart "$(echo -n "the Theodorcib		bold" | $cligen_file -f $fspec)" 0 ""
@@ -47,11 +51,68 @@ newtest "^Y page scroll"
 expectpart "$(echo -n "ruled over the shores of the Hreiðsea" | $cligen_file -s 0 -f $fspec)" 0 "the shores of the Hreisea"
 
 newtest "search ^R"
-expectpart "$(echo -n "Theodoric ruledTheo 		" | $cligen_file -f $fspec)" 0 "Theodoric the bold"
+expectpart "$(echo -n "Theodoric 
+ruled
+Theo 		" | $cligen_file -f $fspec)" 0 "Theodoric the bold"
 
 newtest "^W"
 expectpart "$(echo -n "TheodoricThe			" | $cligen_file -f $fspec)" 0 "Theodoric the bold"
 
+# Terminal output is written once per keystroke, and a recalled line
+# is not redrawn where it equals the line on screen
+newtest "batched redraw"
+ret=$(echo -n "Theodoric the bold
+chief of sea-warriors
+" | $cligen_file -S -f $fspec 2>&1)
+expectpart "$ret" 0 "Theodoric the bold"
+nr=$(echo "$ret" | grep "term_write" | awk '{print $2}')
+if [ -z "$nr" ] || [ "$nr" -gt 55 ]; then
+    err "term_write <= 55" "$nr"
+fi
+
+# A paste of several lines is read in bulk, not one read per char
+newtest "bulk read of paste"
+ret=$(printf "Theodoric the bold\nchief of sea-warriors\nruled over\n" | $cligen_file -S -f $fspec 2>&1)
+expectpart "$ret" 0 "Theodoric the bold" "chief of sea-warriors" "ruled over"
+nr=$(echo "$ret" | grep "term_read" | awk '{print $2}')
+if [ -z "$nr" ] || [ "$nr" -gt 5 ]; then
+    err "term_read <= 5" "$nr"
+fi
+
+# History file in append mode
+fhist=$dir/history
+
+newtest "history file append"
+rm -f $fhist
+printf "chief of sea-warriors\nTheodoric the bold\n" | $cligen_file -H $fhist -f $fspec > /dev/null 2>&1
+expectpart "$(cat $fhist)" 0 "chief of sea-warriors" "Theodoric the bold"
+
+newtest "history file load and search ^R"
+expectpart "$(printf "\022chief\n" | $cligen_file -H $fhist -f $fspec 2>&1)" 0 "cli> chief of sea-warriors"
+
+newtest "history file compact"
+printf "ruled over\nTheodoric the bold\nruled over\n" | $cligen_file -n 2 -H $fhist -f $fspec > /dev/null 2>&1
+expectpart "$(wc -l < $fhist)" 0 "3"
+expectpart "$(cat $fhist)" 0 "ruled over" --not-- "chief of sea-warriors"
+
+# Blank and repeated lines are not added, the history is filled from the end of the file
+newtest "history file load fills from end"
+printf "chief of sea-warriors\nruled over\nruled over\n\n" > $fhist
+expectpart "$(printf "\022chief\n" | $cligen_file -n 2 -H $fhist -f $fspec 2>&1)" 0 "cli> chief of sea-warriors"
+
+# Sessions sharing a history file: appends and compactions are locked
+newtest "history file shared by sessions"
+rm -f $fhist
+for p in 1 2 3 4; do
+    (for i in $(seq 1 200); do echo "p$p line$i"; done | $cligen_file -n 20 -H $fhist -f $fspec > /dev/null 2>&1) &
+done
+wait
+nr=$(grep -cv "^p[1-4] line[0-9]*$" $fhist)
+if [ "$nr" -ne 0 ]; then
+    err "0 garbled lines" "$nr"
+fi
+expectpart "$(tail -1 $fhist)" 0 "line200"
+
 endtest
 
 rm -rf $dir
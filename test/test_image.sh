@@ -0,0 +1,91 @@
+#!/usr/bin/env bash
+# Precompiled parse-tree images: compile a clispec with cligen_file -c and load it with -i
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+fimage=$dir/spec.img
+
+cat > $fspec <<EOF
+  prompt="img> ";              # Assignment of prompt
+  comment="#";                 # Same comment as in syntax
+  treename="example";          # Name of syntax (used when referencing)
+
+  a <int32>, callback();
+  b <b:int32 range[-10:100]>("A number"), callback("arg1", 42);
+  c <c:string regexp:"[a-z]+" regexp:!"x.*" show:"name">, callback();
+  d <d:decimal64 fraction-digits:3 range[0.1:10]>, callback();
+  e <e:string length[2:4]>, hide, callback();
+  f ("help f"){
+    g, callback();
+    h <h:ipv4prefix>, callback();
+  }
+  interface <ifname:string choice:eth0|eth1>("Interface name"), callback();
+  values (<int64> | @subtree), callback();
+  s @{
+    x, callback();
+    y, callback();
+  }
+
+  treename="subtree";           
+  xx{
+    yy, callback();
+  }
+EOF
+
+newtest "$cligen_file -f $fspec -c $fimage"
+expectpart "$($cligen_file -b -f $fspec -c $fimage < /dev/null 2>&1)" 0 ""
+
+newtest "image syntax equal to clispec syntax"
+spec=$($cligen_file -b -p -f $fspec < /dev/null 2>&1)
+img=$($cligen_file -b -p -i $fimage < /dev/null 2>&1)
+if [ "$spec" != "$img" ]; then
+    err "$spec" "$img"
+fi
+
+newtest "image: prompt"
+expectpart "$(echo "a 42" | $cligen_file -i $fimage 2>&1)" 0 "img> " "1 name:a type:string value:a" "2 name:int32 type:int32 value:42"
+
+newtest "image: range"
+expectpart "$(printf "b 42\nb 101\n" | $cligen_file -i $fimage 2>&1)" 0 "2 name:b type:int32 value:42" "Number 101 out of range"
+
+newtest "image: regexp"
+expectpart "$(printf "c abc\nc xyz\n" | $cligen_file -i $fimage 2>&1)" 0 "2 name:c type:string value:abc" "is invalid input for cli command"
+
+newtest "image: decimal64"
+expectpart "$(echo "d 3.142" | $cligen_file -i $fimage 2>&1)" 0 "2 name:d type:decimal64 value:3.142"
+
+newtest "image: choice"
+expectpart "$(echo "interface eth1" | $cligen_file -i $fimage 2>&1)" 0 "2 name:ifname type:string value:eth1"
+
+newtest "image: tree reference"
+expectpart "$(echo "values xx yy" | $cligen_file -i $fimage 2>&1)" 0 "2 name:xx type:string value:xx" "3 name:yy type:string value:yy"
+
+newtest "image: sets"
+expectpart "$(echo "s y x" | $cligen_file -i $fimage 2>&1)" 0 "2 name:y type:string value:y" "3 name:x type:string value:x"
+
+newtest "image: invalid image"
+expectpart "$($cligen_file -1 -i $fspec 2>&1)" 255 "Not a CLIgen image"
+
+# Hand-made images: magic, version 1, no globals, one tree named "x"
+hdr='CLIGENIM\x01\x00\x01\x02x'
+
+newtest "image: invalid variable type"
+# One variable object of type 127
+printf "$hdr"'\x00\x01\x01\x01\x00\x02v\x00\x00\x00\x7f\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00' > $fimage
+expectpart "$($cligen_file -1 -p -i $fimage 2>&1)" 255 "Invalid CLIgen image"
+
+newtest "image: range length exceeds ranges"
+# One int32 variable object with 5 ranges but no range vectors
+printf "$hdr"'\x00\x01\x01\x01\x00\x02v\x00\x00\x00\x03\x00\x00\x00\x00\x00\x05\x00\x00\x00\x00\x00' > $fimage
+expectpart "$($cligen_file -1 -p -i $fimage 2>&1)" 255 "Invalid CLIgen image"
+
+newtest "image: too deep nesting"
+# 100000 nested command objects
+{ printf "$hdr"; for i in $(seq 1 100000); do printf '\x00\x01\x01\x00\x00\x02a\x00\x00\x00\x01'; done; printf '\x00\x00'; } > $fimage
+expectpart "$($cligen_file -1 -p -i $fimage 2>&1)" 255 "Invalid CLIgen image"
+
+endtest
+
+rm -rf $dir
@@ -84,6 +84,18 @@ EOF
 newtest "cligen edit a b <int> top"
 expectpart "$(cat $fin | $cligen_tutorial -q -f $fspec 2>&1)" 0 "a;{" "b <v>;{" "d;" "c;"
 
+# Tree reference expansion is kept between commands and redone when working point changes
+cat <<EOF > $fin
+edit a
+top
+edit a
+edit b 23
+show
+EOF
+
+newtest "cligen edit a top edit a b <int>"
+expectpart "$(cat $fin | $cligen_tutorial -q -f $fspec 2>&1)" 0 "d;" --not-- "b <v>;{" "c;"  "a;{"
+
 endtest
 
 rm -rf $dir
@@ -33,6 +33,88 @@ expectpart "$(echo "values xx?" | $cligen_file -f $fspec 2>&1)" 0 "cli> values x
 newtest "cligen ref xx y<tab>"
 expectpart "$(echo "values xx y	" | $cligen_file -f $fspec 2>&1)" 0 "cli> values xx yy" "2 name:xx type:string value:xx" "3 name:yy type:string value:yy"
 
+# Reference expansion is re-used between commands
+newtest "cligen ref several commands"
+expectpart "$(printf "values xx yy\nvalues 42\nvalues xx yy\n" | $cligen_file -f $fspec 2>&1)" 0 "3 name:yy type:string value:yy" "2 name:int64 type:int64 value:42" --not-- "CLI syntax error"
+
+# Frozen parse-trees shared with a second handle: references expanded in private copy
+newtest "cligen ref frozen tree"
+expectpart "$(printf "values xx yy\nvalues 42\nvalues xx yy\n" | $cligen_file -F -f $fspec 2>&1)" 0 "3 name:yy type:string value:yy" "2 name:int64 type:int64 value:42" --not-- "CLI syntax error"
+
+newtest "cligen ref frozen tree ?"
+expectpart "$(echo "values ? 42" | $cligen_file -F -f $fspec 2>&1)" 0 "cli> values" "<int64>" "xx" "2 name:int64 type:int64 value:42"
+
+# Referenced tree loaded from its own clispec file on first use
+fspec2=$dir/spec2.cli
+cat > $fspec2 <<EOF
+  prompt="cli> ";
+  values (<int64> | @lazy), callback();
+  other, callback();
+EOF
+
+flazy=$dir/lazy.cli
+cat > $flazy <<EOF
+  zz{
+    ww, callback();
+  }
+EOF
+
+newtest "cligen ref loaded on demand"
+expectpart "$(printf "values zz ww\nvalues 42\n" | $cligen_file -f $fspec2 -T lazy=$flazy 2>&1)" 0 "3 name:ww type:string value:ww" "2 name:int64 type:int64 value:42"
+
+newtest "cligen ref not loaded if not used"
+expectpart "$(echo "other" | $cligen_file -f $fspec2 -T lazy=$dir/none.cli 2>&1)" 0 "1 name:other type:string value:other" --not-- "fopen"
+
+newtest "cligen ref load error on use"
+expectpart "$(echo "values 42" | $cligen_file -f $fspec2 -T lazy=$dir/none.cli 2>&1)" 255 "CLIgen tree 'lazy' could not be loaded"
+
+# The referenced tree is in another file, files are parsed in parallel
+fsub=$dir/sub.cli
+cat > $fsub <<EOF
+  treename="lazy";
+  zz{
+    ww, callback();
+  }
+  treename="other";
+  yy, callback();
+EOF
+
+fbad=$dir/bad.cli
+cat > $fbad <<EOF
+  treename="bad";
+  aa {
+EOF
+
+newtest "cligen ref files parsed in parallel"
+expectpart "$(printf "values zz ww\nother\n" | $cligen_file -j 2 -f $fspec2 -f $fsub 2>&1)" 0 "3 name:ww type:string value:ww" "1 name:other type:string value:other" "cli>"
+
+newtest "cligen ref files parsed in parallel, one thread per processor"
+expectpart "$(printf "values zz ww\n" | $cligen_file -j 0 -f $fspec2 -f $fsub 2>&1)" 0 "3 name:ww type:string value:ww"
+
+newtest "cligen ref files parsed in parallel, syntax error"
+expectpart "$(echo "values 42" | $cligen_file -j 2 -f $fspec2 -f $fbad -f $fsub 2>&1)" 255 "bad.cli:3: Error: syntax error"
+
+# Commands added to and removed from a live tree, references to it are updated
+fdelta=$dir/delta.cli
+cat > $fdelta <<EOF
+  prompt="cli> ";
+  treename="main";
+  values @dyn, callback();
+  delta add <spec:rest>, delta_add("dyn");
+  delta del <spec:rest>, delta_del("dyn");
+  treename="dyn";
+  xx, callback();
+EOF
+
+newtest "cligen ref delta: add command"
+expectpart "$(printf "values xx\ndelta add yy zz, callback();\nvalues yy zz\nvalues xx\n" | $cligen_file -b -f $fdelta 2>&1)" 0 "3 name:zz type:string value:zz" "2 name:xx type:string value:xx" --not-- "error"
+
+newtest "cligen ref delta: merge into existing command"
+expectpart "$(printf "delta add xx ww, callback();\nvalues xx ww\nvalues xx\n" | $cligen_file -b -f $fdelta 2>&1)" 0 "3 name:ww type:string value:ww" "2 name:xx type:string value:xx" --not-- "error"
+
+newtest "cligen ref delta: remove command"
+expectpart "$(printf "delta add yy zz, callback();\ndelta del yy zz;\nvalues yy zz\ndelta del xx;\nvalues xx\n" | $cligen_file -b -f $fdelta 2>&1)" 0 '3: CLI syntax error in: "values yy zz": Unknown command' '5: CLI syntax error in: "values xx": Unknown command'
+
 endtest
 
 rm -rf $dir
@@ -34,6 +34,10 @@ expectpart "$(echo "values aab" | $cligen_file -f $fspec 2>&1)" 0 "1 name:values
 newtest "cligen values aab foo rest"
 expectpart "$(echo "values aab cde" | $cligen_file -f $fspec 2>&1)" 0 "1 name:values type:string value:values" "2 name:x type:rest value:aab cde"
 
+# Rest starts at the token, including quotes
+newtest "cligen xxx quoted rest"
+expectpart "$(echo 'xxx "a b" c' | $cligen_file -f $fspec 2>&1)" 0 "1 name:xxx type:string value:xxx" '2 name:x type:rest value:"a b" c'
+
 endtest
 
 rm -rf $dir
@@ -0,0 +1,57 @@
+#!/usr/bin/env bash
+# CLI sessions: several users of one handle, input pushed with cligen_session_feed
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+
+cat > $fspec <<EOF
+  prompt="cli> ";              # Assignment of prompt
+  comment="#";                 # Same comment as in syntax
+  treename="tutorial";         # Name of syntax (used when referencing)
+
+  abc,callback();
+  abd <x:int32>("a number"),callback();
+EOF
+
+newtest "$cligen_file -m 2 -f $fspec"
+
+newtest "sessions: callback output is written to the session"
+expectpart "$(printf "abc\nabd 42\n" | $cligen_file -m 2 -f $fspec 2>&1)" 0 "cli> abc" "1 name:abc type:string value:abc" "cli> abd 42" "2 name:x type:int32 value:42"
+
+newtest "sessions: errors are reported to the session"
+expectpart "$(printf "ab\nbad\nabd\n" | $cligen_file -m 2 -f $fspec 2>&1)" 0 "Ambiguous command" 'CLI syntax error in: "bad": Unknown command' 'CLI syntax error in: "abd": Incomplete command'
+
+# Lines go to session 0, 1, 0, 1: ^P recalls the latest line of the same session
+newtest "sessions: history per session"
+ret=$(printf "abc\nabd 7\n\020\n\020\n" | $cligen_file -m 2 -f $fspec 2>&1)
+expectpart "$ret" 0 "2 name:x type:int32 value:7"
+nr=$(echo "$ret" | grep -c "1 name:abc")
+if [ "$nr" -ne 2 ]; then
+    err "2 abc commands" "$nr"
+fi
+nr=$(echo "$ret" | grep -c "2 name:x")
+if [ "$nr" -ne 2 ]; then
+    err "2 abd commands" "$nr"
+fi
+
+newtest "sessions: question mark shows help"
+expectpart "$(printf "abd ?\n" | $cligen_file -m 1 -f $fspec 2>&1)" 0 "<x>" "a number"
+
+newtest "sessions: TAB shows completions"
+expectpart "$(printf "ab\t\n" | $cligen_file -m 1 -f $fspec 2>&1)" 0 "abc" "abd"
+
+newtest "sessions: ^D ends session"
+expectpart "$(printf "\004\nabc\n" | $cligen_file -m 1 -f $fspec 2>&1)" 0 --not-- "name:abc"
+
+newtest "sessions: small footprint"
+ret=$(printf "abc\n" | $cligen_file -m 100 -f $fspec 2>&1 >/dev/null)
+nr=$(echo "$ret" | grep "session_mem" | awk '{print $2}')
+if [ -z "$nr" ] || [ "$nr" -gt 2048 ]; then
+    err "session_mem <= 2048" "$nr"
+fi
+
+endtest
+
+rm -rf $dir
@@ -130,6 +130,45 @@ expectpart "$(echo "b f c d e ?" | $cligen_file -f $fspec 2>&1)" 0 "1 name:b typ
 newtest "b c d d: Already matched"
 expectpart "$(echo "b c d d" | $cligen_file -f $fspec 2>&1)" 0 "Already matched"
 
+# Matched positions are kept per evaluation, nothing is left in the tree
+newtest "a d twice: not matched from previous command"
+expectpart "$(printf "a d\na d c\na d d\n" | $cligen_file -f $fspec 2>&1)" 0 "2 name:d type:string value:d" "3 name:c type:string value:c" "Already matched"
+
+# Frozen parse-trees shared with a second handle: match flags are not kept in the tree
+newtest "frozen: a c d ?"
+expectpart "$(echo "a c d ?" | $cligen_file -F -f $fspec  2>&1)" 0 "cli>" "  b" "  e" "<v>" --not-- "  c" "  d"
+
+newtest "frozen: b c d d: Already matched"
+expectpart "$(printf "b c d d\nb c d e\n" | $cligen_file -F -f $fspec 2>&1)" 0 "Already matched" "3 name:d type:string value:d" "4 name:e type:string value:e"
+
+newtest "frozen: c xx yy"
+expectpart "$(printf "c xx yy\nc d\nc xx yy\n" | $cligen_file -F -f $fspec 2>&1)" 0 "2 name:xx type:string value:xx" "3 name:yy type:string value:yy" "2 name:d type:string value:d" --not-- "CLI syntax error"
+
+# Wide set where keywords are prefixes of other keywords (opt1, opt10,...)
+fspec2=$dir/spec2.cli
+echo 'prompt="cli> ";' > $fspec2
+echo "x @{" >> $fspec2
+for i in $(seq 0 39); do
+    echo "  opt$i <v$i:int32>, callback();" >> $fspec2
+done
+echo "}" >> $fspec2
+
+newtest "wide set: exact keyword also prefix of others"
+expectpart "$(echo "x opt1 1 opt10 10 opt0 0" | $cligen_file -f $fspec2 2>&1)" 0 "3 name:v1 type:int32 value:1" "5 name:v10 type:int32 value:10" "7 name:v0 type:int32 value:0" --not-- "CLI syntax error"
+
+newtest "wide set: all elements in reverse order"
+cmd="x"
+for i in $(seq 39 -1 0); do
+    cmd="$cmd opt$i $i"
+done
+expectpart "$(echo "$cmd" | $cligen_file -f $fspec2 2>&1)" 0 "3 name:v39 type:int32 value:39" "81 name:v0 type:int32 value:0" --not-- "CLI syntax error"
+
+newtest "wide set: opt1 1 opt1: Already matched"
+expectpart "$(echo "x opt1 1 opt1 2" | $cligen_file -f $fspec2 2>&1)" 0 "CLI syntax error" --not-- "4 name:opt1"
+
+newtest "wide set: opt2 2 opt1?"
+expectpart "$(echo "x opt2 2 opt1?" | $cligen_file -f $fspec2 2>&1)" 0 "  opt1 " "  opt10" "  opt19" --not-- "  opt2 " "  opt20"
+
 endtest
 
 rm -rf $dir
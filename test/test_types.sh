@@ -48,6 +48,10 @@ for x in 0 1 2 3 4 5; do
     expectpart "$(echo "r$x ax42" | $cligen_file -f $fspec)" 0 "cli> r$x ax42" "is invalid input for cli command"
 done
 
+# Compiled regexps are cached: reuse within a session
+newtest "regexp reuse"
+expectpart "$(printf "r0 a42\nr0 ax42\nr0 b7\nr1 b7\n" | $cligen_file -f $fspec)" 0 "cli> r0 a42" '"ax42" is invalid input for cli command' "cli> r0 b7" "cli> r1 b7" --not-- '"b7" is invalid input'
+
 for x in 0 1 2 3; do
     newtest "int i$x"
     expectpart "$(echo "i$x -77" | $cligen_file -f $fspec)" 0 "cli> i$x -77" --not-- "CLI syntax error" 
@@ -103,6 +107,86 @@ expectpart "$(echo "u1 550e8400-e29b-41d4-a716-446655440000" | $cligen_file -f $
 newtest "time t0"
 expectpart "$(echo "t0 2008-09-21T18:57:21.003" | $cligen_file -f $fspec)" 0 "cli> t0 2008-09-21T18:57:21.003" --not-- "regexp match fail"
 
+# Many typed variables on one level: the token is scanned once per class
+fspec2=$dir/spec2.cli
+cat > $fspec2 <<EOF
+  prompt="cli> ";
+  n (<a:int8>|<b:int16>|<c:int32>|<d:int64>|<e:uint8>|<f:uint16>|<g:uint32>|<h:uint64>|<i:ipv4addr>|<j:macaddr>), callback();
+EOF
+
+newtest "classify once: int16"
+ret=$(echo "n 300" | $cligen_file -b -S -f $fspec2 2>&1)
+expectpart "$ret" 0 "2 name:b type:int16 value:300"
+nr=$(echo "$ret" | grep "cv_scan" | awk '{print $2}')
+if [ -z "$nr" ] || [ "$nr" -gt 6 ]; then
+    err "cv_scan <= 6" "$nr"
+fi
+
+newtest "classify once: address"
+expectpart "$(echo "n 1.2.3.4" | $cligen_file -b -f $fspec2 2>&1)" 0 "2 name:i type:ipv4addr value:1.2.3.4"
+
+newtest "classify once: mac"
+expectpart "$(echo "n a4:4e:31:c9:d7:f4" | $cligen_file -b -f $fspec2 2>&1)" 0 "2 name:j type:macaddr value:a4:4e:31:c9:d7:f4"
+
+newtest "classify once: reason"
+expectpart "$(echo "n -300" | $cligen_file -b -f $fspec2 2>&1)" 0 "2 name:b type:int16 value:-300"
+expectpart "$(echo "n x" | $cligen_file -b -f $fspec2 2>&1)" 0 "'x' is not a number"
+
+# Variables are matched in falling preference: a better match ends the scan of a level
+fspec5=$dir/spec5.cli
+cat > $fspec5 <<EOF
+  prompt="cli> ";
+  x (<a:string>|<b:int32>|<c:ipv4addr>|<d:string regexp:"z.*">|<e:rest>|show), callback();
+  x <u:uint8 range[1:10]>, callback();
+EOF
+
+newtest "preference order: keyword before variables"
+ret=$(echo "x show" | $cligen_file -b -S -f $fspec5 2>&1)
+expectpart "$ret" 0 "2 name:show type:string value:show"
+nr=$(echo "$ret" | grep "match_object" | awk '{print $2}')
+if [ -z "$nr" ] || [ "$nr" -gt 2 ]; then
+    err "match_object <= 2" "$nr"
+fi
+
+newtest "preference order: best variable"
+expectpart "$(printf "x 5\nx 300\nx 1.2.3.4\nx zz\nx foo\n" | $cligen_file -b -f $fspec5 2>&1)" 0 "2 name:u type:uint8 value:5" "2 name:b type:int32 value:300" "2 name:c type:ipv4addr value:1.2.3.4" "2 name:d type:string value:zz" "2 name:a type:string value:foo" --not-- "error"
+
+# Range and length intervals are compiled into a sorted table on first use
+fspec3=$dir/spec3.cli
+cat > $fspec3 <<EOF
+  prompt="cli> ";
+  r <v:int32 range[20:30] range[-10:-5] range[25:40] range[100]>, callback();
+  s <s:string length[6:8] length[1:2] length[3]>, callback();
+EOF
+
+newtest "range table: merged interval"
+expectpart "$(printf "r 35\nr -7\nr 21\n" | $cligen_file -b -f $fspec3 2>&1)" 0 "value:35" "value:-7" "value:21" --not-- "errors"
+
+newtest "range table: min of type"
+expectpart "$(echo "r -2000" | $cligen_file -b -f $fspec3 2>&1)" 0 "value:-2000" --not-- "errors"
+
+newtest "range table: out of range"
+expectpart "$(echo "r 101" | $cligen_file -b -f $fspec3 2>&1)" 0 "Number 101 out of range: 20 - 30, -10 - -5, 25 - 40,  - 100"
+
+newtest "length table"
+expectpart "$(printf "s abc\ns abcdefg\ns abcd\n" | $cligen_file -b -f $fspec3 2>&1)" 0 "value:abc" "value:abcdefg" "String length 4 out of range" "1 errors"
+
+# Values are printed back by the callback with cv2str, the reverse of parsing
+fspec4=$dir/spec4.cli
+cat > $fspec4 <<EOF
+  prompt="cli> ";
+  p (<d:decimal64 fraction-digits:3>|<a:ipv4prefix>|<b:ipv6addr>|<c:ipv6prefix>|<u:uuid>|<t:bool>), callback();
+EOF
+
+newtest "print values: dec64"
+expectpart "$(printf "p -0.5\np 12.25\n" | $cligen_file -b -f $fspec4 2>&1)" 0 "value:-0.500" "value:12.250"
+
+newtest "print values: addresses"
+expectpart "$(printf "p 10.0.0.0/8\np 2001:DB8:0:0:1:0:0:1\np ::ffff:1.2.3.4\np 2001:db8::/32\n" | $cligen_file -b -f $fspec4 2>&1)" 0 "value:10.0.0.0/8" "value:2001:db8::1:0:0:1" "value:::ffff:1.2.3.4" "value:2001:db8::/32"
+
+newtest "print values: uuid and bool"
+expectpart "$(printf "p 550E8400-E29B-41D4-A716-446655440000\np true\n" | $cligen_file -b -f $fspec4 2>&1)" 0 "value:550e8400-e29b-41d4-a716-446655440000" "value:true"
+
 endtest
 
 rm -rf $dir
@@ -23,6 +23,9 @@ cat > $fspec <<EOF
 
 # * Choice with variable
   extra (<crypto:string>|<crypto:string choice:mc:aes|mc:foo|des:des|des:des3>), callback();
+
+# Many variables: cvec grows beyond its inline storage
+  many <v1:int32> <v2:int32> <v3:int32> <v4:int32> <v5:int32> <v6:int32> <v7:int32> <v8:int32> <v9:int32>, callback();
 EOF
 
 newtest "$cligen_file -f $fspec"
@@ -87,6 +90,9 @@ expectpart "$(echo -n "extra ?" | $cligen_file -f $fspec 2>&1)" 0 "<crypto>" "de
 newtest "extra des:?"
 expectpart "$(echo -n "extra des:?" | $cligen_file -f $fspec 2>&1)" 0 "<crypto>" "des:des" "des:des3" --not-- "mc:aes" "mc:foo"
 
+newtest "many variables"
+expectpart "$(echo "many 1 2 3 4 5 6 7 8 9" | $cligen_file -f $fspec 2>&1)" 0 "1 name:many type:string value:many" "5 name:v4 type:int32 value:4" "6 name:v5 type:int32 value:5" "10 name:v9 type:int32 value:9"
+
 endtest
 
 rm -rf $dir